@@ -1651,6 +1651,17 @@ extern List slurmdb_job_modify(void *db_conn,
  */
 extern List slurmdb_jobs_get(void *db_conn, slurmdb_job_cond_t *job_cond);
 
+/*
+ * get info from the storage in chunks of bounded size
+ * IN:  job_cond - condition of a new query, NULL to get the next chunk of
+ *                 the query in progress on db_conn
+ * returns List of slurmdb_job_rec_t *, empty once all the jobs were
+ *         returned, NULL on error
+ * note List needs to be freed with slurm_list_destroy() when called
+ */
+extern List slurmdb_jobs_get_chunk(void *db_conn,
+				   slurmdb_job_cond_t *job_cond);
+
 /*
  * Fix runaway jobs
  * IN: jobs, a list of all the runaway jobs
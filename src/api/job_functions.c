@@ -70,6 +70,21 @@ extern List slurmdb_jobs_get(void *db_conn, slurmdb_job_cond_t *job_cond)
 	return jobacct_storage_g_get_jobs_cond(db_conn, db_api_uid, job_cond);
 }
 
+/*
+ * get info from the storage in chunks of bounded size
+ * returns List of slurmdb_job_rec_t *, empty once all the jobs were returned
+ * note List needs to be freed when called
+ */
+extern List slurmdb_jobs_get_chunk(void *db_conn,
+				   slurmdb_job_cond_t *job_cond)
+{
+	if (db_api_uid == -1)
+		db_api_uid = getuid();
+
+	return jobacct_storage_g_get_jobs_chunk(db_conn, db_api_uid,
+						job_cond);
+}
+
 /*
  * Fix runaway jobs
  * IN: jobs, a list of all the runaway jobs
@@ -52,6 +52,17 @@
 
 #define ASSOC_HASH_SIZE 1000
 #define ASSOC_HASH_ID_INX(_assoc_id)	(_assoc_id % ASSOC_HASH_SIZE)
+#define USER_HASH_SIZE 1000
+#define WCKEY_HASH_SIZE 1000
+
+/*
+ * Entry of the user and wckey hash tables. Unlike associations those records
+ * have no link of their own to chain them with.
+ */
+typedef struct hash_ent {
+	void *rec;
+	struct hash_ent *next;
+} hash_ent_t;
 
 slurmdb_assoc_rec_t *assoc_mgr_root_assoc = NULL;
 uint32_t g_qos_max_priority = 0;
@@ -76,8 +87,24 @@ static pthread_mutex_t assoc_lock_init = PTHREAD_MUTEX_INITIALIZER;
 static assoc_init_args_t init_setup;
 static slurmdb_assoc_rec_t **assoc_hash_id = NULL;
 static slurmdb_assoc_rec_t **assoc_hash = NULL;
+static hash_ent_t **user_hash_uid = NULL;
+static hash_ent_t **user_hash_name = NULL;
+static hash_ent_t **wckey_hash_id = NULL;
+static hash_ent_t **wckey_hash = NULL;
 static int *assoc_mgr_tres_old_pos = NULL;
 
+/*
+ * Version of the lists: the last update of the update log of the slurmdbd
+ * applied to them, see DBD_GET_UPDATES. A state_epoch of 0 means the version
+ * is not known. Protected by the file lock. It is saved apart from the lists,
+ * in assoc_mgr_state_version, so the assoc_mgr_state format does not change.
+ */
+static uint32_t state_epoch = 0;
+static uint64_t state_gen = 0;
+static uint64_t state_gen_next = 0;
+
+static int _load_assoc_mgr_state(bool only_tres, bool from_cache);
+
 static bool _running_cache(void)
 {
 	if (init_setup.running_cache &&
@@ -324,6 +351,295 @@ static void _delete_assoc_hash(slurmdb_assoc_rec_t *assoc)
 		*assoc_pptr = assoc_ptr->assoc_next;
 }
 
+/* Add rec at the tail of its chain, so chains keep the order of the list */
+static void _add_hash_ent(hash_ent_t **hash, int inx, void *rec)
+{
+	hash_ent_t **ent_pptr = &hash[inx];
+
+	while (*ent_pptr)
+		ent_pptr = &(*ent_pptr)->next;
+
+	*ent_pptr = xmalloc(sizeof(hash_ent_t));
+	(*ent_pptr)->rec = rec;
+}
+
+static bool _delete_hash_ent(hash_ent_t **hash, int inx, void *rec)
+{
+	hash_ent_t **ent_pptr = &hash[inx];
+	hash_ent_t *ent;
+
+	while ((ent = *ent_pptr)) {
+		if (ent->rec == rec) {
+			*ent_pptr = ent->next;
+			xfree(ent);
+			return true;
+		}
+		ent_pptr = &ent->next;
+	}
+
+	return false;
+}
+
+static void _free_hash(hash_ent_t ***hash_ptr, int size)
+{
+	hash_ent_t **hash = *hash_ptr;
+	hash_ent_t *ent, *next;
+
+	if (!hash)
+		return;
+
+	for (int i = 0; i < size; i++) {
+		for (ent = hash[i]; ent; ent = next) {
+			next = ent->next;
+			xfree(ent);
+		}
+	}
+	xfree(*hash_ptr);
+}
+
+static int _user_hash_name_index(char *name)
+{
+	int index = _get_str_inx(name) % USER_HASH_SIZE;
+
+	if (index < 0)
+		index += USER_HASH_SIZE;
+
+	return index;
+}
+
+/* The hash is only set up by _build_user_hash() */
+static void _add_user_hash(slurmdb_user_rec_t *user)
+{
+	if (!user_hash_uid)
+		return;
+
+	_add_hash_ent(user_hash_uid, user->uid % USER_HASH_SIZE, user);
+	_add_hash_ent(user_hash_name, _user_hash_name_index(user->name), user);
+}
+
+/* Call before changing the uid or name of the user */
+static void _delete_user_hash(slurmdb_user_rec_t *user)
+{
+	if (!user_hash_uid)
+		return;
+
+	if (!_delete_hash_ent(user_hash_uid, user->uid % USER_HASH_SIZE,
+			      user) ||
+	    !_delete_hash_ent(user_hash_name,
+			      _user_hash_name_index(user->name), user))
+		error("%s: user %s(%u) not found in hash",
+		      __func__, user->name, user->uid);
+}
+
+/* Index assoc_mgr_user_list again, the user write lock must be held */
+static void _build_user_hash(void)
+{
+	slurmdb_user_rec_t *user;
+	ListIterator itr;
+
+	_free_hash(&user_hash_uid, USER_HASH_SIZE);
+	_free_hash(&user_hash_name, USER_HASH_SIZE);
+
+	if (!assoc_mgr_user_list)
+		return;
+
+	user_hash_uid = xcalloc(USER_HASH_SIZE, sizeof(hash_ent_t *));
+	user_hash_name = xcalloc(USER_HASH_SIZE, sizeof(hash_ent_t *));
+	itr = list_iterator_create(assoc_mgr_user_list);
+	while ((user = list_next(itr)))
+		_add_user_hash(user);
+	list_iterator_destroy(itr);
+}
+
+static int _list_find_uid(void *x, void *key)
+{
+	slurmdb_user_rec_t *user = (slurmdb_user_rec_t *) x;
+	uint32_t uid = *(uint32_t *) key;
+
+	if (user->uid == uid)
+		return 1;
+	return 0;
+}
+
+static slurmdb_user_rec_t *_find_user_rec_uid(uint32_t uid)
+{
+	hash_ent_t *ent;
+
+	if (!user_hash_uid)
+		return list_find_first(assoc_mgr_user_list, _list_find_uid,
+				       &uid);
+
+	for (ent = user_hash_uid[uid % USER_HASH_SIZE]; ent; ent = ent->next) {
+		slurmdb_user_rec_t *user = ent->rec;
+
+		if (user->uid == uid)
+			return user;
+	}
+
+	return NULL;
+}
+
+static int _list_find_user_name(void *x, void *key)
+{
+	slurmdb_user_rec_t *user = (slurmdb_user_rec_t *) x;
+
+	if (!xstrcasecmp(user->name, (char *) key))
+		return 1;
+	return 0;
+}
+
+static slurmdb_user_rec_t *_find_user_rec_name(char *name)
+{
+	hash_ent_t *ent;
+
+	if (!name)
+		return NULL;
+
+	if (!user_hash_name)
+		return list_find_first(assoc_mgr_user_list,
+				       _list_find_user_name, name);
+
+	for (ent = user_hash_name[_user_hash_name_index(name)]; ent;
+	     ent = ent->next) {
+		slurmdb_user_rec_t *user = ent->rec;
+
+		if (!xstrcasecmp(user->name, name))
+			return user;
+	}
+
+	return NULL;
+}
+
+static int _wckey_hash_index(slurmdb_wckey_rec_t *wckey)
+{
+	int index = wckey->uid % WCKEY_HASH_SIZE;
+
+	/* only set on the slurmdbd */
+	if (slurmdbd_conf && wckey->cluster)
+		index += _get_str_inx(wckey->cluster);
+
+	index += _get_str_inx(wckey->name);
+
+	index %= WCKEY_HASH_SIZE;
+	if (index < 0)
+		index += WCKEY_HASH_SIZE;
+
+	return index;
+}
+
+/* The hash is only set up by _build_wckey_hash() */
+static void _add_wckey_hash(slurmdb_wckey_rec_t *wckey)
+{
+	if (!wckey_hash_id)
+		return;
+
+	_add_hash_ent(wckey_hash_id, wckey->id % WCKEY_HASH_SIZE, wckey);
+	_add_hash_ent(wckey_hash, _wckey_hash_index(wckey), wckey);
+}
+
+/* Call before changing the id, uid, name or cluster of the wckey */
+static void _delete_wckey_hash(slurmdb_wckey_rec_t *wckey)
+{
+	if (!wckey_hash_id)
+		return;
+
+	if (!_delete_hash_ent(wckey_hash_id, wckey->id % WCKEY_HASH_SIZE,
+			      wckey) ||
+	    !_delete_hash_ent(wckey_hash, _wckey_hash_index(wckey), wckey))
+		error("%s: wckey %u not found in hash", __func__, wckey->id);
+}
+
+/* Index assoc_mgr_wckey_list again, the wckey write lock must be held */
+static void _build_wckey_hash(void)
+{
+	slurmdb_wckey_rec_t *wckey;
+	ListIterator itr;
+
+	_free_hash(&wckey_hash_id, WCKEY_HASH_SIZE);
+	_free_hash(&wckey_hash, WCKEY_HASH_SIZE);
+
+	if (!assoc_mgr_wckey_list)
+		return;
+
+	wckey_hash_id = xcalloc(WCKEY_HASH_SIZE, sizeof(hash_ent_t *));
+	wckey_hash = xcalloc(WCKEY_HASH_SIZE, sizeof(hash_ent_t *));
+
+	itr = list_iterator_create(assoc_mgr_wckey_list);
+	while ((wckey = list_next(itr)))
+		_add_wckey_hash(wckey);
+	list_iterator_destroy(itr);
+}
+
+static bool _wckey_match(slurmdb_wckey_rec_t *wckey,
+			 slurmdb_wckey_rec_t *found_wckey)
+{
+	/* only and always check for on the slurmdbd */
+	if (slurmdbd_conf &&
+	    xstrcasecmp(wckey->cluster, found_wckey->cluster)) {
+		debug4("not the right cluster");
+		return false;
+	}
+
+	if (wckey->id)
+		return (wckey->id == found_wckey->id);
+
+	if (wckey->uid != NO_VAL) {
+		if (wckey->uid != found_wckey->uid) {
+			debug4("not the right user %u != %u",
+			       wckey->uid, found_wckey->uid);
+			return false;
+		}
+	} else if (wckey->user && xstrcasecmp(wckey->user, found_wckey->user))
+		return false;
+
+	if (wckey->name && (!found_wckey->name ||
+			    xstrcasecmp(wckey->name, found_wckey->name))) {
+		debug4("not the right name %s != %s",
+		       wckey->name, found_wckey->name);
+		return false;
+	}
+
+	return true;
+}
+
+/*
+ * _find_wckey_rec - return a pointer to the wckey of assoc_mgr_wckey_list
+ * matching the id, or else the user and name of wckey. Lookups by user name
+ * or without a wckey name walk the list.
+ * IN wckey - requested wckey info
+ * RET pointer to the wckey's record, NULL if not found
+ */
+static slurmdb_wckey_rec_t *_find_wckey_rec(slurmdb_wckey_rec_t *wckey)
+{
+	slurmdb_wckey_rec_t *found_wckey = NULL;
+	hash_ent_t *ent;
+	ListIterator itr;
+
+	if (slurmdbd_conf && !wckey->cluster)
+		return NULL;
+
+	if (wckey_hash_id && wckey->id)
+		ent = wckey_hash_id[wckey->id % WCKEY_HASH_SIZE];
+	else if (wckey_hash && (wckey->uid != NO_VAL) && wckey->name)
+		ent = wckey_hash[_wckey_hash_index(wckey)];
+	else {
+		itr = list_iterator_create(assoc_mgr_wckey_list);
+		while ((found_wckey = list_next(itr))) {
+			if (_wckey_match(wckey, found_wckey))
+				break;
+		}
+		list_iterator_destroy(itr);
+		return found_wckey;
+	}
+
+	for (; ent; ent = ent->next) {
+		if (_wckey_match(wckey, ent->rec))
+			return ent->rec;
+	}
+
+	return NULL;
+}
+
 
 static void _normalize_assoc_shares_fair_tree(
 	slurmdb_assoc_rec_t *assoc)
@@ -573,9 +889,11 @@ static int _change_user_name(slurmdb_user_rec_t *user)
 		itr = list_iterator_create(assoc_mgr_wckey_list);
 		while ((wckey = list_next(itr))) {
 			if (!xstrcmp(user->old_name, wckey->user)) {
+				_delete_wckey_hash(wckey);
 				xfree(wckey->user);
 				wckey->user = xstrdup(user->name);
 				wckey->uid = user->uid;
+				_add_wckey_hash(wckey);
 				debug3("changing wckey %d", wckey->id);
 			}
 		}
@@ -675,16 +993,6 @@ static int _local_update_assoc_qos_list(slurmdb_assoc_rec_t *assoc,
 	return SLURM_SUCCESS;
 }
 
-static int _list_find_uid(void *x, void *key)
-{
-	slurmdb_user_rec_t *user = (slurmdb_user_rec_t *) x;
-	uint32_t uid = *(uint32_t *) key;
-
-	if (user->uid == uid)
-		return 1;
-	return 0;
-}
-
 /* locks should be put in place before calling this function USER_WRITE */
 static void _set_user_default_acct(slurmdb_assoc_rec_t *assoc)
 {
@@ -694,8 +1002,7 @@ static void _set_user_default_acct(slurmdb_assoc_rec_t *assoc)
 
 	/* set up the default if this is it */
 	if ((assoc->is_def == 1) && (assoc->uid != NO_VAL)) {
-		slurmdb_user_rec_t *user = list_find_first(
-			assoc_mgr_user_list, _list_find_uid, &assoc->uid);
+		slurmdb_user_rec_t *user = _find_user_rec_uid(assoc->uid);
 
 		if (!user)
 			return;
@@ -721,8 +1028,7 @@ static void _set_user_default_wckey(slurmdb_wckey_rec_t *wckey)
 
 	/* set up the default if this is it */
 	if ((wckey->is_def == 1) && (wckey->uid != NO_VAL)) {
-		slurmdb_user_rec_t *user = list_find_first(
-			assoc_mgr_user_list, _list_find_uid, &wckey->uid);
+		slurmdb_user_rec_t *user = _find_user_rec_uid(wckey->uid);
 
 		if (!user)
 			return;
@@ -1093,6 +1399,7 @@ static int _post_wckey_list(List wckey_list)
 	ListIterator itr = list_iterator_create(wckey_list);
 	//START_TIMER;
 
+	xassert(verify_assoc_lock(USER_LOCK, WRITE_LOCK));
 	xassert(assoc_mgr_user_list);
 
 	while ((wckey = list_next(itr))) {
@@ -1668,6 +1975,7 @@ static int _get_assoc_mgr_user_list(void *db_conn, int enforce)
 	assoc_mgr_user_list = acct_storage_g_get_users(db_conn, uid, &user_q);
 
 	if (!assoc_mgr_user_list) {
+		_build_user_hash();
 		assoc_mgr_unlock(&locks);
 		if (enforce & ACCOUNTING_ENFORCE_ASSOCS) {
 			error("%s: no list was made.", __func__);
@@ -1678,6 +1986,7 @@ static int _get_assoc_mgr_user_list(void *db_conn, int enforce)
 	}
 
 	_post_user_list(assoc_mgr_user_list);
+	_build_user_hash();
 
 	assoc_mgr_unlock(&locks);
 	return SLURM_SUCCESS;
@@ -1714,6 +2023,7 @@ static int _get_assoc_mgr_wckey_list(void *db_conn, int enforce)
 		/* create list so we don't keep calling this if there
 		   isn't anything there */
 		assoc_mgr_wckey_list = list_create(slurmdb_destroy_wckey_rec);
+		_build_wckey_hash();
 		assoc_mgr_unlock(&locks);
 		if (enforce & ACCOUNTING_ENFORCE_WCKEYS) {
 			error("%s: no list was made.", __func__);
@@ -1726,6 +2036,7 @@ static int _get_assoc_mgr_wckey_list(void *db_conn, int enforce)
 	}
 
 	_post_wckey_list(assoc_mgr_wckey_list);
+	_build_wckey_hash();
 
 	assoc_mgr_unlock(&locks);
 
@@ -1934,6 +2245,7 @@ static int _refresh_assoc_mgr_user_list(void *db_conn, int enforce)
 	FREE_NULL_LIST(assoc_mgr_user_list);
 
 	assoc_mgr_user_list = current_users;
+	_build_user_hash();
 
 	assoc_mgr_unlock(&locks);
 
@@ -1969,21 +2281,235 @@ static int _refresh_assoc_wckey_list(void *db_conn, int enforce)
 		return SLURM_ERROR;
 	}
 
-	_post_wckey_list(current_wckeys);
-
 	assoc_mgr_lock(&locks);
+	/* needs the user lock to look up the users */
+	_post_wckey_list(current_wckeys);
 	FREE_NULL_LIST(assoc_mgr_wckey_list);
 
 	assoc_mgr_wckey_list = current_wckeys;
+	_build_wckey_hash();
 	assoc_mgr_unlock(&locks);
 
 	return SLURM_SUCCESS;
 }
 
+/* Lists are saved to, and can be read back from, the StateSaveLocation */
+static bool _use_saved_state(void)
+{
+	return (init_setup.state_save_location &&
+		*init_setup.state_save_location);
+}
+
+/*
+ * Read the version of the lists saved in assoc_mgr_state at state_time.
+ * A missing file, or one written for another assoc_mgr_state, gives an
+ * unknown version.
+ */
+static void _read_state_version(time_t state_time,
+				uint32_t *epoch, uint64_t *gen)
+{
+	char *state_file;
+	buf_t *buffer;
+	uint16_t ver;
+	time_t buf_time;
+
+	*epoch = 0;
+	*gen = 0;
+
+	state_file = xstrdup_printf("%s/assoc_mgr_state_version",
+				    *init_setup.state_save_location);
+	buffer = create_mmap_buf(state_file);
+	xfree(state_file);
+	if (!buffer)
+		return;
+
+	safe_unpack16(&ver, buffer);
+	if ((ver > SLURM_PROTOCOL_VERSION) || (ver < SLURM_MIN_PROTOCOL_VERSION))
+		goto unpack_error;
+	safe_unpack_time(&buf_time, buffer);
+	if (buf_time != state_time)
+		goto unpack_error;
+	safe_unpack32(epoch, buffer);
+	safe_unpack64(gen, buffer);
+	free_buf(buffer);
+	return;
+
+unpack_error:
+	debug2("%s: ignoring association state version", __func__);
+	*epoch = 0;
+	*gen = 0;
+	free_buf(buffer);
+}
+
+/* Save the version of the lists just saved in assoc_mgr_state */
+static int _dump_state_version(time_t state_time)
+{
+	char *reg_file, *new_file, *data;
+	buf_t *buffer;
+	int error_code = SLURM_SUCCESS, log_fd, pos = 0, nwrite, amount;
+
+	/* An unknown version is not saved, see _read_state_version() */
+	if (!state_epoch)
+		return SLURM_SUCCESS;
+
+	buffer = init_buf(BUF_SIZE);
+	pack16(SLURM_PROTOCOL_VERSION, buffer);
+	pack_time(state_time, buffer);
+	pack32(state_epoch, buffer);
+	pack64(state_gen, buffer);
+
+	reg_file = xstrdup_printf("%s/assoc_mgr_state_version",
+				  *init_setup.state_save_location);
+	new_file = xstrdup_printf("%s.new", reg_file);
+	log_fd = creat(new_file, 0600);
+	if (log_fd < 0) {
+		error("Can't save state, create file %s error %m",
+		      new_file);
+		error_code = errno;
+	} else {
+		nwrite = get_buf_offset(buffer);
+		data = get_buf_data(buffer);
+		while (nwrite > 0) {
+			amount = write(log_fd, &data[pos], nwrite);
+			if ((amount < 0) && (errno != EINTR)) {
+				error("Error writing file %s, %m", new_file);
+				error_code = errno;
+				break;
+			}
+			nwrite -= amount;
+			pos    += amount;
+		}
+		fsync(log_fd);
+		close(log_fd);
+	}
+	if (error_code)
+		(void) unlink(new_file);
+	else if (rename(new_file, reg_file)) {
+		error("Can't save state, rename %s to %s error %m",
+		      new_file, reg_file);
+		error_code = errno;
+		(void) unlink(new_file);
+	}
+	xfree(reg_file);
+	xfree(new_file);
+	free_buf(buffer);
+
+	return error_code;
+}
+
+/* Get the version of the saved state without reading the lists */
+static void _get_saved_state_version(uint32_t *epoch, uint64_t *gen)
+{
+	char *state_file;
+	buf_t *buffer;
+	uint16_t ver;
+	time_t buf_time;
+
+	*epoch = 0;
+	*gen = 0;
+
+	state_file = xstrdup_printf("%s/assoc_mgr_state",
+				    *init_setup.state_save_location);
+	buffer = create_mmap_buf(state_file);
+	xfree(state_file);
+	if (!buffer)
+		return;
+
+	safe_unpack16(&ver, buffer);
+	safe_unpack_time(&buf_time, buffer);
+	free_buf(buffer);
+
+	_read_state_version(buf_time, epoch, gen);
+	return;
+
+unpack_error:
+	free_buf(buffer);
+}
+
+static void _set_state_version(uint32_t epoch, uint64_t gen)
+{
+	assoc_mgr_lock_t locks = { .file = WRITE_LOCK };
+
+	assoc_mgr_lock(&locks);
+	state_epoch = epoch;
+	state_gen = gen;
+	state_gen_next = 0;
+	assoc_mgr_unlock(&locks);
+
+	debug2("%s: association state at %u:%"PRIu64, __func__, epoch, gen);
+}
+
+/* Forget the lists read from the saved state, not the TRES */
+static void _free_state_lists(void)
+{
+	assoc_mgr_lock_t locks = { .assoc = WRITE_LOCK, .qos = WRITE_LOCK,
+				   .res = WRITE_LOCK, .user = WRITE_LOCK,
+				   .wckey = WRITE_LOCK };
+
+	assoc_mgr_lock(&locks);
+	FREE_NULL_LIST(assoc_mgr_assoc_list);
+	FREE_NULL_LIST(assoc_mgr_res_list);
+	FREE_NULL_LIST(assoc_mgr_qos_list);
+	FREE_NULL_LIST(assoc_mgr_user_list);
+	FREE_NULL_LIST(assoc_mgr_wckey_list);
+	assoc_mgr_root_assoc = NULL;
+	xfree(assoc_hash_id);
+	xfree(assoc_hash);
+	_build_user_hash();
+	_build_wckey_hash();
+	assoc_mgr_unlock(&locks);
+}
+
+/*
+ * Read the lists from the saved state and apply the updates the slurmdbd
+ * committed since it was saved. The lists not read here are read from the
+ * database by the caller.
+ */
+static void _load_saved_state(List update_list)
+{
+	int update_cnt = list_count(update_list);
+	DEF_TIMERS;
+
+	START_TIMER;
+	if (_load_assoc_mgr_state(false, false) != SLURM_SUCCESS) {
+		info("%s: unable to read the saved association state, reading it from the database",
+		     __func__);
+		_free_state_lists();
+		return;
+	}
+
+	/* The cache level might have changed since the state was saved */
+	if (!(init_setup.cache_level & ASSOC_MGR_CACHE_WCKEY) &&
+	    assoc_mgr_wckey_list) {
+		assoc_mgr_lock_t locks = { .wckey = WRITE_LOCK };
+
+		assoc_mgr_lock(&locks);
+		FREE_NULL_LIST(assoc_mgr_wckey_list);
+		_build_wckey_hash();
+		assoc_mgr_unlock(&locks);
+	}
+
+	if (update_cnt && (assoc_mgr_update(update_list, 0) != SLURM_SUCCESS)) {
+		info("%s: unable to apply the updates to the saved association state, reading it from the database",
+		     __func__);
+		_free_state_lists();
+		return;
+	}
+	END_TIMER2(__func__);
+
+	verbose("%s: read the saved association state and %d updates from the slurmdbd %s",
+		__func__, update_cnt, TIME_STR);
+}
+
 extern int assoc_mgr_init(void *db_conn, assoc_init_args_t *args,
 			  int db_conn_errno)
 {
 	static uint16_t checked_prio = 0;
+	uint32_t epoch = 0;
+	uint64_t gen = 0;
+	List update_list = NULL;
+	bool state_known = false;
+	int rc = SLURM_ERROR;
 
 	if (!checked_prio) {
 		if (xstrcmp(slurm_conf.priority_type, "priority/basic"))
@@ -2009,33 +2535,51 @@ extern int assoc_mgr_init(void *db_conn, assoc_init_args_t *args,
 	if (db_conn_errno != SLURM_SUCCESS)
 		return SLURM_ERROR;
 
+	/*
+	 * Get the version of the database before reading anything from it,
+	 * so any update committed meanwhile is applied again rather than
+	 * missed. If the lists were saved at a version the slurmdbd still has
+	 * the updates since, they are read from the saved state instead.
+	 */
+	if (_use_saved_state() && !assoc_mgr_assoc_list &&
+	    !assoc_mgr_qos_list && !assoc_mgr_res_list &&
+	    !assoc_mgr_user_list && !assoc_mgr_wckey_list) {
+		_get_saved_state_version(&epoch, &gen);
+		state_known = (acct_storage_g_get_updates(
+				       db_conn, getuid(), &epoch, &gen,
+				       &update_list) == SLURM_SUCCESS);
+	}
+
 	/* get tres before association and qos since it is used there */
 	if ((!assoc_mgr_tres_list)
 	    && (init_setup.cache_level & ASSOC_MGR_CACHE_TRES)) {
 		if (_get_assoc_mgr_tres_list(db_conn, init_setup.enforce)
 		    == SLURM_ERROR)
-			return SLURM_ERROR;
+			goto end_it;
 	}
 
+	if (update_list && g_tres_count)
+		_load_saved_state(update_list);
+
 	/* get qos before association since it is used there */
 	if ((!assoc_mgr_qos_list)
 	    && (init_setup.cache_level & ASSOC_MGR_CACHE_QOS))
 		if (_get_assoc_mgr_qos_list(db_conn, init_setup.enforce) ==
 		    SLURM_ERROR)
-			return SLURM_ERROR;
+			goto end_it;
 
 	/* get user before association/wckey since it is used there */
 	if ((!assoc_mgr_user_list)
 	    && (init_setup.cache_level & ASSOC_MGR_CACHE_USER))
 		if (_get_assoc_mgr_user_list(db_conn, init_setup.enforce) ==
 		    SLURM_ERROR)
-			return SLURM_ERROR;
+			goto end_it;
 
 	if ((!assoc_mgr_assoc_list)
 	    && (init_setup.cache_level & ASSOC_MGR_CACHE_ASSOC))
 		if (_get_assoc_mgr_assoc_list(db_conn, init_setup.enforce)
 		    == SLURM_ERROR)
-			return SLURM_ERROR;
+			goto end_it;
 
 	if (assoc_mgr_assoc_list && !setup_children) {
 		slurmdb_assoc_rec_t *assoc = NULL;
@@ -2051,15 +2595,21 @@ extern int assoc_mgr_init(void *db_conn, assoc_init_args_t *args,
 	    && (init_setup.cache_level & ASSOC_MGR_CACHE_WCKEY))
 		if (_get_assoc_mgr_wckey_list(db_conn, init_setup.enforce) ==
 		    SLURM_ERROR)
-			return SLURM_ERROR;
+			goto end_it;
 
 	if ((!assoc_mgr_res_list)
 	    && (init_setup.cache_level & ASSOC_MGR_CACHE_RES))
 		if (_get_assoc_mgr_res_list(db_conn, init_setup.enforce) ==
 		    SLURM_ERROR)
-			return SLURM_ERROR;
+			goto end_it;
 
-	return SLURM_SUCCESS;
+	if (state_known)
+		_set_state_version(epoch, gen);
+	rc = SLURM_SUCCESS;
+
+end_it:
+	FREE_NULL_LIST(update_list);
+	return rc;
 }
 
 extern int assoc_mgr_fini(bool save_state)
@@ -2100,6 +2650,8 @@ extern int assoc_mgr_fini(bool save_state)
 
 	xfree(assoc_hash_id);
 	xfree(assoc_hash);
+	_build_user_hash();
+	_build_wckey_hash();
 
 	assoc_mgr_unlock(&locks);
 
@@ -2604,7 +3156,6 @@ extern int assoc_mgr_fill_in_user(void *db_conn, slurmdb_user_rec_t *user,
 				  slurmdb_user_rec_t **user_pptr,
 				  bool locked)
 {
-	ListIterator itr = NULL;
 	slurmdb_user_rec_t * found_user = NULL;
 	assoc_mgr_lock_t locks = { .user = READ_LOCK };
 
@@ -2632,16 +3183,10 @@ extern int assoc_mgr_fill_in_user(void *db_conn, slurmdb_user_rec_t *user,
 		return SLURM_SUCCESS;
 	}
 
-	itr = list_iterator_create(assoc_mgr_user_list);
-	while ((found_user = list_next(itr))) {
-		if (user->uid != NO_VAL) {
-			if (user->uid == found_user->uid)
-				break;
-		} else if (user->name
-			   && !xstrcasecmp(user->name, found_user->name))
-			break;
-	}
-	list_iterator_destroy(itr);
+	if (user->uid != NO_VAL)
+		found_user = _find_user_rec_uid(user->uid);
+	else
+		found_user = _find_user_rec_name(user->name);
 
 	if (!found_user) {
 		if (!locked)
@@ -2836,8 +3381,6 @@ extern int assoc_mgr_fill_in_wckey(void *db_conn, slurmdb_wckey_rec_t *wckey,
 				   slurmdb_wckey_rec_t **wckey_pptr,
 				   bool locked)
 {
-	ListIterator itr = NULL;
-	slurmdb_wckey_rec_t * found_wckey = NULL;
 	slurmdb_wckey_rec_t * ret_wckey = NULL;
 	assoc_mgr_lock_t locks = { .wckey = READ_LOCK };
 
@@ -2921,53 +3464,9 @@ extern int assoc_mgr_fill_in_wckey(void *db_conn, slurmdb_wckey_rec_t *wckey,
 
 	xassert(verify_assoc_lock(WCKEY_LOCK, READ_LOCK));
 
-	itr = list_iterator_create(assoc_mgr_wckey_list);
-	while ((found_wckey = list_next(itr))) {
-		/* only and always check for on the slurmdbd */
-		if (slurmdbd_conf) {
-			if (!wckey->cluster) {
-				error("No cluster name was given "
-				      "to check against, "
-				      "we need one to get a wckey.");
-				continue;
-			}
-
-			if (xstrcasecmp(wckey->cluster, found_wckey->cluster)) {
-				debug4("not the right cluster");
-				continue;
-			}
-		}
-
-		if (wckey->id) {
-			if (wckey->id == found_wckey->id) {
-				ret_wckey = found_wckey;
-				break;
-			}
-			continue;
-		} else {
-			if (wckey->uid != NO_VAL) {
-				if (wckey->uid != found_wckey->uid) {
-					debug4("not the right user %u != %u",
-					       wckey->uid, found_wckey->uid);
-					continue;
-				}
-			} else if (wckey->user &&
-				   xstrcasecmp(wckey->user, found_wckey->user))
-				continue;
-
-			if (wckey->name
-			    && (!found_wckey->name
-				|| xstrcasecmp(wckey->name,
-					       found_wckey->name))) {
-				debug4("not the right name %s != %s",
-				       wckey->name, found_wckey->name);
-				continue;
-			}
-		}
-		ret_wckey = found_wckey;
-		break;
-	}
-	list_iterator_destroy(itr);
+	if (slurmdbd_conf && !wckey->cluster)
+		error("No cluster name was given to check against, we need one to get a wckey.");
+	ret_wckey = _find_wckey_rec(wckey);
 
 	if (!ret_wckey) {
 		if (!locked)
@@ -3018,7 +3517,7 @@ extern slurmdb_admin_level_t assoc_mgr_get_admin_level(void *db_conn,
 		return SLURMDB_ADMIN_NOTSET;
 	}
 
-	found_user = list_find_first(assoc_mgr_user_list, _list_find_uid, &uid);
+	found_user = _find_user_rec_uid(uid);
 
 	if (found_user)
 		level = found_user->admin_level;
@@ -3050,8 +3549,7 @@ extern bool assoc_mgr_is_user_acct_coord(void *db_conn,
 		return false;
 	}
 
-	found_user = list_find_first(assoc_mgr_user_list, _list_find_uid,
-				     &uid);
+	found_user = _find_user_rec_uid(uid);
 
 	if (!found_user || !found_user->coord_accts) {
 		assoc_mgr_unlock(&locks);
@@ -3655,6 +4153,37 @@ extern int assoc_mgr_update(List update_list, bool locked)
 	return rc;
 }
 
+extern int assoc_mgr_update_state(List update_list, uint32_t epoch,
+				  uint64_t gen)
+{
+	assoc_mgr_lock_t locks = { .file = WRITE_LOCK };
+	bool in_order;
+	int rc;
+
+	/*
+	 * The state saved while the lists are updated has no known version.
+	 * It is known again after this update only if it directly follows the
+	 * version of the lists, and no other update started meanwhile.
+	 */
+	assoc_mgr_lock(&locks);
+	in_order = (epoch && (epoch == state_epoch) && (gen == state_gen + 1));
+	state_gen_next = in_order ? gen : 0;
+	state_epoch = 0;
+	assoc_mgr_unlock(&locks);
+
+	rc = assoc_mgr_update(update_list, 0);
+
+	assoc_mgr_lock(&locks);
+	if (in_order && (rc == SLURM_SUCCESS) && (state_gen_next == gen)) {
+		state_epoch = epoch;
+		state_gen = gen;
+	}
+	state_gen_next = 0;
+	assoc_mgr_unlock(&locks);
+
+	return rc;
+}
+
 extern int assoc_mgr_update_assocs(slurmdb_update_object_t *update, bool locked)
 {
 	slurmdb_assoc_rec_t * rec = NULL;
@@ -4154,7 +4683,6 @@ extern int assoc_mgr_update_wckeys(slurmdb_update_object_t *update, bool locked)
 {
 	slurmdb_wckey_rec_t * rec = NULL;
 	slurmdb_wckey_rec_t * object = NULL;
-	ListIterator itr = NULL;
 	int rc = SLURM_SUCCESS;
 	uid_t pw_uid;
 	assoc_mgr_lock_t locks = { .user = WRITE_LOCK, .wckey = WRITE_LOCK };
@@ -4167,7 +4695,6 @@ extern int assoc_mgr_update_wckeys(slurmdb_update_object_t *update, bool locked)
 		return SLURM_SUCCESS;
 	}
 
-	itr = list_iterator_create(assoc_mgr_wckey_list);
 	while ((object = list_pop(update->objects))) {
 		if (object->cluster && !slurmdbd_conf) {
 			/* only update the local clusters assocs */
@@ -4182,35 +4709,7 @@ extern int assoc_mgr_update_wckeys(slurmdb_update_object_t *update, bool locked)
 			continue;
 		}
 
-		list_iterator_reset(itr);
-		while ((rec = list_next(itr))) {
-			/* only and always check for on the slurmdbd */
-			if (slurmdbd_conf &&
-			    xstrcasecmp(object->cluster, rec->cluster)) {
-				debug4("not the right cluster");
-				continue;
-			}
-			if (object->id) {
-				if (object->id == rec->id) {
-					break;
-				}
-				continue;
-			} else {
-				if (object->uid != rec->uid) {
-					debug4("not the right user");
-					continue;
-				}
-
-				if (object->name
-				    && (!rec->name
-					|| xstrcasecmp(object->name,
-						       rec->name))) {
-					debug4("not the right wckey");
-					continue;
-				}
-				break;
-			}
-		}
+		rec = _find_wckey_rec(object);
 		//info("%d WCKEY %u", update->type, object->id);
 		switch(update->type) {
 		case SLURMDB_MODIFY_WCKEY:
@@ -4249,6 +4748,7 @@ extern int assoc_mgr_update_wckeys(slurmdb_update_object_t *update, bool locked)
 			else
 				object->is_def = 0;
 			list_append(assoc_mgr_wckey_list, object);
+			_add_wckey_hash(object);
 			object = NULL;
 			break;
 		case SLURMDB_REMOVE_WCKEY:
@@ -4256,7 +4756,8 @@ extern int assoc_mgr_update_wckeys(slurmdb_update_object_t *update, bool locked)
 				//rc = SLURM_ERROR;
 				break;
 			}
-			list_delete_item(itr);
+			_delete_wckey_hash(rec);
+			list_delete_ptr(assoc_mgr_wckey_list, rec);
 			break;
 		default:
 			break;
@@ -4264,7 +4765,6 @@ extern int assoc_mgr_update_wckeys(slurmdb_update_object_t *update, bool locked)
 
 		slurmdb_destroy_wckey_rec(object);
 	}
-	list_iterator_destroy(itr);
 	if (!locked)
 		assoc_mgr_unlock(&locks);
 
@@ -4276,7 +4776,6 @@ extern int assoc_mgr_update_users(slurmdb_update_object_t *update, bool locked)
 	slurmdb_user_rec_t * rec = NULL;
 	slurmdb_user_rec_t * object = NULL;
 
-	ListIterator itr = NULL;
 	int rc = SLURM_SUCCESS;
 	uid_t pw_uid;
 	assoc_mgr_lock_t locks = { .assoc = WRITE_LOCK, .user = WRITE_LOCK,
@@ -4290,18 +4789,11 @@ extern int assoc_mgr_update_users(slurmdb_update_object_t *update, bool locked)
 		return SLURM_SUCCESS;
 	}
 
-	itr = list_iterator_create(assoc_mgr_user_list);
 	while ((object = list_pop(update->objects))) {
-		list_iterator_reset(itr);
-		while ((rec = list_next(itr))) {
-			char *name;
-			if (object->old_name)
-				name = object->old_name;
-			else
-				name = object->name;
-			if (!xstrcasecmp(name, rec->name))
-				break;
-		}
+		if (object->old_name)
+			rec = _find_user_rec_name(object->old_name);
+		else
+			rec = _find_user_rec_name(object->name);
 
 		//info("%d user %s", update->type, object->name);
 		switch(update->type) {
@@ -4321,11 +4813,13 @@ extern int assoc_mgr_update_users(slurmdb_update_object_t *update, bool locked)
 					      rec->name);
 					break;
 				}
+				_delete_user_hash(rec);
 				xfree(rec->old_name);
 				rec->old_name = rec->name;
 				rec->name = object->name;
 				object->name = NULL;
 				rc = _change_user_name(rec);
+				_add_user_hash(rec);
 			}
 
 			if (object->default_acct) {
@@ -4356,6 +4850,7 @@ extern int assoc_mgr_update_users(slurmdb_update_object_t *update, bool locked)
 			} else
 				object->uid = pw_uid;
 			list_append(assoc_mgr_user_list, object);
+			_add_user_hash(object);
 			object = NULL;
 			break;
 		case SLURMDB_REMOVE_USER:
@@ -4363,7 +4858,8 @@ extern int assoc_mgr_update_users(slurmdb_update_object_t *update, bool locked)
 				//rc = SLURM_ERROR;
 				break;
 			}
-			list_delete_item(itr);
+			_delete_user_hash(rec);
+			list_delete_ptr(assoc_mgr_user_list, rec);
 			break;
 		case SLURMDB_ADD_COORD:
 			/* same as SLURMDB_REMOVE_COORD */
@@ -4388,7 +4884,6 @@ extern int assoc_mgr_update_users(slurmdb_update_object_t *update, bool locked)
 
 		slurmdb_destroy_user_rec(object);
 	}
-	list_iterator_destroy(itr);
 	if (!locked)
 		assoc_mgr_unlock(&locks);
 
@@ -5300,6 +5795,7 @@ extern int dump_assoc_mgr_state(void)
 		*tmp_char = NULL;
 	dbd_list_msg_t msg;
 	buf_t *buffer = NULL;
+	time_t state_time;
 	assoc_mgr_lock_t locks = { .assoc = READ_LOCK, .file = WRITE_LOCK,
 				   .qos = READ_LOCK, .res = READ_LOCK,
 				   .tres = READ_LOCK, .user = READ_LOCK,
@@ -5377,7 +5873,8 @@ extern int dump_assoc_mgr_state(void)
 
 	/* write header: version, time */
 	pack16(SLURM_PROTOCOL_VERSION, buffer);
-	pack_time(time(NULL), buffer);
+	state_time = time(NULL);
+	pack_time(state_time, buffer);
 
 	if (assoc_mgr_user_list) {
 		memset(&msg, 0, sizeof(dbd_list_msg_t));
@@ -5456,6 +5953,10 @@ extern int dump_assoc_mgr_state(void)
 	if (error_code)
 		(void) unlink(new_file);
 	else {			/* file shuffle */
+		/* The old version must never go with the new lists */
+		tmp_char = xstrdup_printf("%s_version", reg_file);
+		(void) unlink(tmp_char);
+		xfree(tmp_char);
 		(void) unlink(old_file);
 		if (link(reg_file, old_file))
 			debug4("unable to create link for %s -> %s: %m",
@@ -5465,6 +5966,7 @@ extern int dump_assoc_mgr_state(void)
 			debug4("unable to create link for %s -> %s: %m",
 			       new_file, reg_file);
 		(void) unlink(new_file);
+		(void) _dump_state_version(state_time);
 	}
 	xfree(old_file);
 	xfree(reg_file);
@@ -5886,7 +6388,11 @@ unpack_error:
 	return SLURM_ERROR;
 }
 
-extern int load_assoc_mgr_state(bool only_tres)
+/*
+ * IN from_cache - the lists are only read from the state, not from the
+ *		   database, see running_cache. Else errors are not fatal.
+ */
+static int _load_assoc_mgr_state(bool only_tres, bool from_cache)
 {
 	int error_code = SLURM_SUCCESS;
 	uint16_t type = 0;
@@ -5894,8 +6400,10 @@ extern int load_assoc_mgr_state(bool only_tres)
 	char *state_file;
 	buf_t *buffer = NULL;
 	time_t buf_time;
+	uint32_t epoch = 0;
+	uint64_t gen = 0;
 	dbd_list_msg_t *msg = NULL;
-	assoc_mgr_lock_t locks = { .assoc = WRITE_LOCK, .file = READ_LOCK,
+	assoc_mgr_lock_t locks = { .assoc = WRITE_LOCK, .file = WRITE_LOCK,
 				   .qos = WRITE_LOCK, .res = WRITE_LOCK,
 				   .tres = WRITE_LOCK, .user = WRITE_LOCK,
 				   .wckey = WRITE_LOCK };
@@ -5920,7 +6428,7 @@ extern int load_assoc_mgr_state(bool only_tres)
 	safe_unpack16(&ver, buffer);
 	debug3("Version in assoc_mgr_state header is %u", ver);
 	if (ver > SLURM_PROTOCOL_VERSION || ver < SLURM_MIN_PROTOCOL_VERSION) {
-		if (!ignore_state_errors)
+		if (from_cache && !ignore_state_errors)
 			fatal("Can not recover assoc_mgr state, incompatible version, "
 			      "got %u need >= %u <= %u, start with '-i' to ignore this. Warning: using -i will lose the data that can't be recovered.",
 			      ver, SLURM_MIN_PROTOCOL_VERSION, SLURM_PROTOCOL_VERSION);
@@ -5935,6 +6443,8 @@ extern int load_assoc_mgr_state(bool only_tres)
 	}
 
 	safe_unpack_time(&buf_time, buffer);
+	if (!only_tres)
+		_read_state_version(buf_time, &epoch, &gen);
 	while (remaining_buf(buffer) > 0) {
 		safe_unpack16(&type, buffer);
 		switch(type) {
@@ -5973,6 +6483,7 @@ extern int load_assoc_mgr_state(bool only_tres)
 			FREE_NULL_LIST(assoc_mgr_user_list);
 			assoc_mgr_user_list = msg->my_list;
 			_post_user_list(assoc_mgr_user_list);
+			_build_user_hash();
 			debug("Recovered %u users",
 			      list_count(assoc_mgr_user_list));
 			msg->my_list = NULL;
@@ -6028,6 +6539,7 @@ extern int load_assoc_mgr_state(bool only_tres)
 			}
 			FREE_NULL_LIST(assoc_mgr_wckey_list);
 			assoc_mgr_wckey_list = msg->my_list;
+			_build_wckey_hash();
 			debug("Recovered %u wckeys",
 			      list_count(assoc_mgr_wckey_list));
 			msg->my_list = NULL;
@@ -6043,15 +6555,21 @@ extern int load_assoc_mgr_state(bool only_tres)
 			break;
 	}
 
-	if (!only_tres && init_setup.running_cache)
-		*init_setup.running_cache = RUNNING_CACHE_STATE_RUNNING;
+	if (!only_tres) {
+		state_epoch = epoch;
+		state_gen = gen;
+		state_gen_next = 0;
+		if (from_cache && init_setup.running_cache)
+			*init_setup.running_cache =
+				RUNNING_CACHE_STATE_RUNNING;
+	}
 
 	free_buf(buffer);
 	assoc_mgr_unlock(&locks);
 	return SLURM_SUCCESS;
 
 unpack_error:
-	if (!ignore_state_errors)
+	if (from_cache && !ignore_state_errors)
 		fatal("Incomplete assoc mgr state file, start with '-i' to ignore this. Warning: using -i will lose the data that can't be recovered.");
 	error("Incomplete assoc mgr state file");
 
@@ -6061,15 +6579,32 @@ unpack_error:
 	return SLURM_ERROR;
 }
 
+extern int load_assoc_mgr_state(bool only_tres)
+{
+	return _load_assoc_mgr_state(only_tres, true);
+}
+
 extern int assoc_mgr_refresh_lists(void *db_conn, uint16_t cache_level)
 {
 	bool partial_list = 1;
+	bool state_known = false;
+	uint32_t epoch = 0;
+	uint64_t gen = 0;
+	List update_list = NULL;
 
 	if (!cache_level) {
 		cache_level = init_setup.cache_level;
 		partial_list = 0;
 	}
 
+	/* All the lists are read again, get their version first */
+	if (!partial_list && _use_saved_state()) {
+		state_known = (acct_storage_g_get_updates(
+				       db_conn, getuid(), &epoch, &gen,
+				       &update_list) == SLURM_SUCCESS);
+		FREE_NULL_LIST(update_list);
+	}
+
 	/* get tres before association and qos since it is used there */
 	if (cache_level & ASSOC_MGR_CACHE_TRES) {
 		if (_refresh_assoc_mgr_tres_list(
@@ -6106,6 +6641,9 @@ extern int assoc_mgr_refresh_lists(void *db_conn, uint16_t cache_level)
 	if (!partial_list && _running_cache())
 		*init_setup.running_cache = RUNNING_CACHE_STATE_LISTS_REFRESHED;
 
+	if (state_known)
+		_set_state_version(epoch, gen);
+
 	return SLURM_SUCCESS;
 }
 
@@ -6153,8 +6691,11 @@ extern int assoc_mgr_set_missing_uids()
 					debug2("refresh wckey "
 					       "couldn't get a uid for user %s",
 					       object->user);
-				} else
+				} else {
+					_delete_wckey_hash(object);
 					object->uid = pw_uid;
+					_add_wckey_hash(object);
+				}
 			}
 		}
 		list_iterator_destroy(itr);
@@ -6172,7 +6713,9 @@ extern int assoc_mgr_set_missing_uids()
 				} else {
 					debug5("%s: found uid %u for user %s",
 					       __func__, pw_uid, object->name);
+					_delete_user_hash(object);
 					object->uid = pw_uid;
+					_add_user_hash(object);
 				}
 			}
 		}
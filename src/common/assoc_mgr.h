@@ -331,6 +331,19 @@ extern int assoc_mgr_info_unpack_msg(assoc_mgr_info_msg_t **object,
  */
 extern int assoc_mgr_update(List update_list, bool locked);
 
+/*
+ * assoc_mgr_update_state - update the association manager with the updates of
+ *	a commit of the slurmdbd, keeping track of the version of the lists
+ *	saved in the state, see DBD_GET_UPDATES.
+ * IN update_list: updates to perform
+ * IN epoch: update log of the slurmdbd the updates are from, 0 if none
+ * IN gen: generation of the updates in that log
+ * RET: error code
+ * NOTE: the items in update_list are not deleted
+ */
+extern int assoc_mgr_update_state(List update_list, uint32_t epoch,
+				  uint64_t gen);
+
 /*
  * update associations in cache
  * IN:  slurmdb_update_object_t *object
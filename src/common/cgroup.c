@@ -564,6 +564,19 @@ extern int cgroup_g_fini(void)
 	return rc;
 }
 
+/*
+ * Is the loaded plugin managing the unified (v2) hierarchy?
+ *
+ * Returns true if so, false otherwise or if no plugin could be loaded.
+ */
+extern bool cgroup_g_unified_hierarchy(void)
+{
+	if (cgroup_g_init() < 0)
+		return false;
+
+	return !xstrcmp(g_context->type, "cgroup/v2");
+}
+
 extern int cgroup_g_initialize(cgroup_ctl_type_t sub)
 {
 	if (cgroup_g_init() < 0)
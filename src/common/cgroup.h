@@ -130,6 +130,9 @@ typedef struct {
 	uint64_t ssec;
 	uint64_t total_rss;
 	uint64_t total_pgmajfault;
+	uint64_t memory_peak;	/* NO_VAL64 if not kept by the kernel */
+	uint64_t total_read_bytes;
+	uint64_t total_write_bytes;
 } cgroup_acct_t;
 
 /* Slurm cgroup plugins configuration parameters */
@@ -167,6 +170,7 @@ typedef struct {
 extern void cgroup_free_limits(cgroup_limits_t *limits);
 extern int cgroup_g_init(void);
 extern int cgroup_g_fini(void);
+extern bool cgroup_g_unified_hierarchy(void);
 extern int cgroup_g_initialize(cgroup_ctl_type_t sub);
 extern int cgroup_g_system_create(cgroup_ctl_type_t sub);
 extern int cgroup_g_system_addto(cgroup_ctl_type_t sub, pid_t *pids, int npids);
@@ -48,6 +48,7 @@
 #include "src/common/read_config.h"
 #include "src/common/timers.h"
 #include "src/common/xassert.h"
+#include "src/common/xhash.h"
 #include "src/common/xmalloc.h"
 #include "src/common/xstring.h"
 
@@ -75,6 +76,10 @@ typedef struct {
 	int (*serialize)(char **dest, const data_t *src,
 			 data_serializer_flags_t flags);
 	int (*deserialize)(data_t **dest, const char *src, size_t length);
+	/* optional: loaded from SERIALIZER_STREAM_SYM */
+	int (*serialize_stream)(const data_t *src,
+				data_serializer_flags_t flags,
+				data_serializer_write_t writer, void *arg);
 } serializer_funcs_t;
 
 /*
@@ -86,6 +91,7 @@ static const char *syms[] = {
 };
 
 #define SERIALIZER_MIME_TYPES_SYM "mime_types"
+#define SERIALIZER_STREAM_SYM "serializer_p_serialize_stream"
 /* serializer plugin state */
 static serializer_funcs_t *plugins = NULL;
 static int g_context_cnt = -1;
@@ -111,13 +117,16 @@ static List mime_types_list = NULL;
 #define DATA_LIST_MAGIC 0x1992F89F
 #define DATA_LIST_NODE_MAGIC 0x1921F89F
 
+/* Dictionaries with more entries than this get a hash index of their keys */
+#define DATA_DICT_INDEX_MIN 16
+
 typedef struct data_list_node_s data_list_node_t;
 struct data_list_node_s {
 	int magic;
 	data_list_node_t *next;
 
 	data_t *data;
-	char *key; /* key for dictionary (only) */
+	char *key; /* key for dictionary (only), allocated with node */
 };
 
 /* single forward linked list */
@@ -127,6 +136,8 @@ struct data_list_s {
 
 	data_list_node_t *begin;
 	data_list_node_t *end;
+
+	xhash_t *index; /* dictionary key -> node for large dictionaries */
 };
 
 static void _check_magic(const data_t *data);
@@ -366,6 +377,10 @@ static void _load_plugins(void)
 		    < ARRAY_SIZE(syms))
 			fatal("Incomplete plugin detected");
 
+		plugins[g_context_cnt].serialize_stream =
+			plugin_get_sym(plugin_handles[i],
+				       SERIALIZER_STREAM_SYM);
+
 		mime_types = plugin_get_sym(plugin_handles[i],
 					    SERIALIZER_MIME_TYPES_SYM);
 		if (!mime_types)
@@ -506,14 +521,16 @@ static void _release_data_list_node(data_list_t *dl, data_list_node_t *dn)
 	_check_data_list_magic(dl);
 	_check_data_list_node_magic(dn);
 	_check_data_list_node_parent(dl, dn);
-	data_list_node_t *prev;
+	data_list_node_t *prev = NULL;
 
-	/* walk list to find new previous */
-	for (prev = dl->begin; prev && prev->next != dn; ) {
-		_check_data_list_node_magic(prev);
-		prev = prev->next;
-		if (prev)
+	/* walk list to find new previous (there is none for the first node) */
+	if (dn != dl->begin) {
+		for (prev = dl->begin; prev && prev->next != dn; ) {
 			_check_data_list_node_magic(prev);
+			prev = prev->next;
+			if (prev)
+				_check_data_list_node_magic(prev);
+		}
 	}
 
 	if (dn == dl->begin) {
@@ -542,8 +559,9 @@ static void _release_data_list_node(data_list_t *dl, data_list_node_t *dn)
 	}
 
 	dl->count--;
+	if (dl->index && dn->key)
+		(void) xhash_pop_str(dl->index, dn->key);
 	FREE_NULL_DATA(dn->data);
-	xfree(dn->key);
 
 	dn->magic = ~DATA_LIST_NODE_MAGIC;
 	xfree(dn);
@@ -559,6 +577,9 @@ static void _release_data_list(data_list_t *dl)
 
 	_check_data_list_magic(dl);
 
+	/* all nodes are going away: no need to keep the index current */
+	xhash_free(dl->index);
+
 	if (!n) {
 		xassert(!dl->count);
 		xassert(!dl->end);
@@ -593,13 +614,17 @@ finish:
  */
 static data_list_node_t *_new_data_list_node(data_t *d, const char *key)
 {
-	data_list_node_t *dn = xmalloc(sizeof(*dn));
+	const size_t key_bytes = key ? (strlen(key) + 1) : 0;
+	/* key is stored after the node to avoid another allocation */
+	data_list_node_t *dn = xmalloc(sizeof(*dn) + key_bytes);
 	dn->magic = DATA_LIST_NODE_MAGIC;
 	_check_magic(d);
 
 	dn->data = d;
-	if (key)
-		dn->key = xstrdup(key);
+	if (key) {
+		dn->key = (char *) (dn + 1);
+		memcpy(dn->key, key, key_bytes);
+	}
 
 	log_flag(DATA, "%s: new data list node (0x%"PRIXPTR")",
 		 __func__, (uintptr_t) dn);
@@ -607,6 +632,49 @@ static data_list_node_t *_new_data_list_node(data_t *d, const char *key)
 	return dn;
 }
 
+static void _dict_node_identify(void *item, const char **key,
+				uint32_t *key_len)
+{
+	data_list_node_t *dn = item;
+
+	*key = dn->key;
+	*key_len = strlen(dn->key);
+}
+
+/* Add new dictionary node to the index, creating the index if needed */
+static void _index_data_list_node(data_list_t *dl, data_list_node_t *dn)
+{
+	if (!dn->key)
+		return;
+
+	if (dl->index) {
+		xhash_add(dl->index, dn);
+	} else if (dl->count > DATA_DICT_INDEX_MIN) {
+		dl->index = xhash_init(_dict_node_identify, NULL);
+		for (data_list_node_t *i = dl->begin; i; i = i->next)
+			xhash_add(dl->index, i);
+	}
+}
+
+/* Find dictionary node by key or NULL if not found */
+static data_list_node_t *_find_data_list_node(const data_list_t *dl,
+					      const char *key)
+{
+	data_list_node_t *i;
+
+	if (dl->index)
+		return xhash_get_str(dl->index, key);
+
+	for (i = dl->begin; i; i = i->next) {
+		_check_data_list_node_magic(i);
+
+		if (!xstrcmp(key, i->key))
+			break;
+	}
+
+	return i;
+}
+
 static void _data_list_append(data_list_t *dl, data_t *d, const char *key)
 {
 	data_list_node_t *n = _new_data_list_node(d, key);
@@ -627,6 +695,7 @@ static void _data_list_append(data_list_t *dl, data_t *d, const char *key)
 	}
 
 	dl->count++;
+	_index_data_list_node(dl, n);
 }
 
 static void _data_list_prepend(data_list_t *dl, data_t *d, const char *key)
@@ -646,6 +715,7 @@ static void _data_list_prepend(data_list_t *dl, data_t *d, const char *key)
 	}
 
 	dl->count++;
+	_index_data_list_node(dl, n);
 }
 
 data_t *data_new(void)
@@ -938,18 +1008,7 @@ const data_t *data_key_get_const(const data_t *data, const char *key)
 	if (!data->data.dict_u->count)
 		return NULL;
 
-	_check_data_list_magic(data->data.dict_u);
-	i = data->data.dict_u->begin;
-	while (i) {
-		_check_data_list_node_magic(i);
-
-		if (!xstrcmp(key, i->key))
-			break;
-
-		i = i->next;
-	}
-
-	if (i)
+	if ((i = _find_data_list_node(data->data.dict_u, key)))
 		return i->data;
 	else
 		return NULL;
@@ -971,18 +1030,7 @@ data_t *data_key_get(data_t *data, const char *key)
 	if (!data->data.dict_u->count)
 		return NULL;
 
-	_check_data_list_magic(data->data.dict_u);
-	i = data->data.dict_u->begin;
-	while (i) {
-		_check_data_list_node_magic(i);
-
-		if (!xstrcmp(key, i->key))
-			break;
-
-		i = i->next;
-	}
-
-	if (i)
+	if ((i = _find_data_list_node(data->data.dict_u, key)))
 		return i->data;
 	else
 		return NULL;
@@ -1039,16 +1087,7 @@ bool data_key_unset(data_t *data, const char *key)
 	if (!key || data->type != DATA_TYPE_DICT)
 		return NULL;
 
-	_check_data_list_magic(data->data.dict_u);
-	i = data->data.dict_u->begin;
-	while (i) {
-		_check_data_list_node_magic(i);
-
-		if (!xstrcmp(key, i->key))
-			break;
-
-		i = i->next;
-	}
+	i = _find_data_list_node(data->data.dict_u, key);
 
 	if (!i) {
 		log_flag(DATA, "%s: remove non-existent key in data (0x%"PRIXPTR") key: %s",
@@ -1312,10 +1351,16 @@ extern int data_list_for_each(data_t *d, DataListForF f, void *arg)
 
 		switch (cmd) {
 		case DATA_FOR_EACH_CONT:
+			i = i->next;
 			break;
 		case DATA_FOR_EACH_DELETE:
+		{
+			data_list_node_t *next = i->next;
+
 			_release_data_list_node(d->data.list_u, i);
+			i = next;
 			break;
+		}
 		case DATA_FOR_EACH_FAIL:
 			count *= -1;
 			/* fall through */
@@ -1325,9 +1370,6 @@ extern int data_list_for_each(data_t *d, DataListForF f, void *arg)
 		default:
 			fatal_abort("%s: invalid cmd", __func__);
 		}
-
-		if (i)
-			i = i->next;
 	}
 
 	return count;
@@ -1409,10 +1451,16 @@ extern int data_dict_for_each(data_t *d, DataDictForF f, void *arg)
 
 		switch (cmd) {
 		case DATA_FOR_EACH_CONT:
+			i = i->next;
 			break;
 		case DATA_FOR_EACH_DELETE:
+		{
+			data_list_node_t *next = i->next;
+
 			_release_data_list_node(d->data.dict_u, i);
+			i = next;
 			break;
+		}
 		case DATA_FOR_EACH_FAIL:
 			count *= -1;
 			/* fall through */
@@ -1422,9 +1470,6 @@ extern int data_dict_for_each(data_t *d, DataDictForF f, void *arg)
 		default:
 			fatal_abort("%s: invalid cmd", __func__);
 		}
-
-		if (i)
-			i = i->next;
 	}
 
 	return count;
@@ -2118,6 +2163,10 @@ static int _find_serializer_full_type(void *x, void *key)
 
 static plugin_mime_type_t *_find_serializer(const char *mime_type)
 {
+	/* no serializer plugins loaded */
+	if (!mime_types_list)
+		return NULL;
+
 	if (!xstrcmp("*/*", mime_type)) {
 		/*
 		 * default to JSON if client will accept anything to avoid
@@ -2170,6 +2219,64 @@ extern int data_g_serialize(char **dest, const data_t *src,
 	return rc;
 }
 
+typedef struct {
+	char *buf;
+	size_t length;
+} serialized_t;
+
+static int _append_serialized(const char *buffer, size_t length, void *arg)
+{
+	serialized_t *out = arg;
+
+	/* xrealloc() zero fills so the string stays terminated */
+	if (!out->buf || (xsize(out->buf) <= (out->length + length)))
+		xrealloc(out->buf, MAX((out->length + length + 1),
+				       (out->length * 2)));
+
+	memcpy((out->buf + out->length), buffer, length);
+	out->length += length;
+
+	return SLURM_SUCCESS;
+}
+
+extern int data_g_serialize_length(char **dest, size_t *length,
+				   const data_t *src, const char *mime_type,
+				   data_serializer_flags_t flags)
+{
+	DEF_TIMERS;
+	int rc;
+	plugin_mime_type_t *pmt = NULL;
+	serializer_funcs_t *funcs;
+
+	xassert(dest && (*dest == NULL));
+	xassert(length);
+
+	pmt = _find_serializer(mime_type);
+	if (!pmt)
+		return ESLURM_DATA_UNKNOWN_MIME_TYPE;
+
+	xassert(pmt->magic == PMT_MAGIC);
+	funcs = &plugins[pmt->index];
+
+	START_TIMER;
+	if (funcs->serialize_stream) {
+		/* only binary formats stream, their output may hold NULs */
+		serialized_t out = { 0 };
+
+		if ((rc = funcs->serialize_stream(src, flags,
+						  _append_serialized, &out)))
+			xfree(out.buf);
+		*dest = out.buf;
+		*length = out.length;
+	} else {
+		rc = funcs->serialize(dest, src, flags);
+		*length = (*dest ? strlen(*dest) : 0);
+	}
+	END_TIMER2(__func__);
+
+	return rc;
+}
+
 extern int data_g_deserialize(data_t **dest, const char *src, size_t length,
 			      const char *mime_type)
 {
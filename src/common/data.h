@@ -560,11 +560,15 @@ typedef enum {
 #define MIME_TYPE_JSON_PLUGIN "serializer/json"
 #define MIME_TYPE_URL_ENCODED "application/x-www-form-urlencoded"
 #define MIME_TYPE_URL_ENCODED_PLUGIN "serializer/url-encoded"
+#define MIME_TYPE_MSGPACK "application/x-msgpack"
+#define MIME_TYPE_MSGPACK_PLUGIN "serializer/msgpack"
 
 /*
  * Serialize data in src into string dest
  * IN/OUT dest - ptr to NULL string ptr to set with output data.
  * 	caller must xfree(dest) if set.
+ * 	Output of binary formats (MIME_TYPE_MSGPACK) may contain NUL bytes.
+ * 	Use data_g_serialize_length() when the length is needed.
  * IN src - populated data ptr to serialize
  * IN mime_type - serialize data into the given mime_type
  * IN flags - optional flags to specify to serilzier to change presentation of
@@ -575,6 +579,32 @@ extern int data_g_serialize(char **dest, const data_t *src,
 			    const char *mime_type,
 			    data_serializer_flags_t flags);
 
+/*
+ * Serialize data in src into string dest and its length
+ * IN/OUT dest - ptr to NULL string ptr to set with output data.
+ * 	caller must xfree(dest) if set.
+ * OUT length - number of bytes in dest, which may contain NUL bytes
+ * IN src - populated data ptr to serialize
+ * IN mime_type - serialize data into the given mime_type
+ * IN flags - optional flags to specify to serilzier to change presentation of
+ * 	data
+ * RET SLURM_SUCCESS or error
+ */
+extern int data_g_serialize_length(char **dest, size_t *length,
+				   const data_t *src, const char *mime_type,
+				   data_serializer_flags_t flags);
+
+/*
+ * Callback of the optional serializer_p_serialize_stream() plugin function
+ * to receive serialized output as it is generated
+ * IN buffer - next bytes of output (not NUL terminated)
+ * IN length - number of bytes in buffer
+ * IN arg - arg handed to serializer_p_serialize_stream()
+ * RET SLURM_SUCCESS or error to abort serialization
+ */
+typedef int (*data_serializer_write_t)(const char *buffer, size_t length,
+				       void *arg);
+
 /*
  * Deserialize string in src into data dest
  * IN/OUT dest - ptr to NULL data ptr to set with output data.
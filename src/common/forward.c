@@ -52,9 +52,30 @@
 #include "src/common/slurm_route.h"
 #include "src/common/read_config.h"
 #include "src/common/slurm_protocol_interface.h"
+#include "src/common/timers.h"
+#include "src/common/xhash.h"
 #include "src/common/xmalloc.h"
 #include "src/common/xstring.h"
 
+/*
+ * Number of nodes at the front of a branch considered when picking the node
+ * that will forward the message to the rest of the branch.
+ */
+#define FWD_HEAD_CANDIDATES 8
+/* Seconds a node that failed to forward is kept out of the head position */
+#define FWD_FAIL_HOLDOFF 300
+/* Minimum round trip difference in usec worth changing a branch head for */
+#define FWD_RTT_SLACK 10000
+
+/* Per node forwarding history, used to choose the head of each branch */
+typedef struct {
+	char *node_name;
+	uint32_t rtt_usec;	/* smoothed round trip time, per tree level for
+				 * nodes that forwarded the message */
+	uint32_t fail_cnt;	/* consecutive failures to send or forward */
+	time_t last_fail;
+} fwd_node_stat_t;
+
 typedef struct {
 	pthread_cond_t *notify;
 	int            *p_thr_count;
@@ -65,6 +86,9 @@ typedef struct {
 	pthread_mutex_t *tree_mutex;
 } fwd_tree_t;
 
+static pthread_mutex_t fwd_stat_mutex = PTHREAD_MUTEX_INITIALIZER;
+static xhash_t *fwd_stat_hash = NULL;
+
 static void _start_msg_tree_internal(hostlist_t hl, hostlist_t* sp_hl,
 				     fwd_tree_t *fwd_tree_in,
 				     int hl_count);
@@ -73,6 +97,177 @@ static void _forward_msg_internal(hostlist_t hl, hostlist_t* sp_hl,
 				  header_t *header, int timeout,
 				  int hl_count);
 
+static void _fwd_stat_identity(void *item, const char **key,
+			       uint32_t *key_len)
+{
+	fwd_node_stat_t *stat = item;
+
+	*key = stat->node_name;
+	*key_len = strlen(stat->node_name);
+}
+
+static void _fwd_stat_free(void *item)
+{
+	fwd_node_stat_t *stat = item;
+
+	if (stat) {
+		xfree(stat->node_name);
+		xfree(stat);
+	}
+}
+
+/*
+ * Record the outcome of sending a message to a node.
+ * IN name - node the message was sent to
+ * IN usec - round trip time, see _fwd_hop_usec() (0 to skip)
+ * IN failed - true if the node could not be reached or failed to forward
+ */
+static void _fwd_stat_update(const char *name, long usec, bool failed)
+{
+	fwd_node_stat_t *stat;
+
+	if (!name)
+		return;
+
+	slurm_mutex_lock(&fwd_stat_mutex);
+	if (!fwd_stat_hash)
+		fwd_stat_hash = xhash_init(_fwd_stat_identity, _fwd_stat_free);
+	if (!(stat = xhash_get_str(fwd_stat_hash, name))) {
+		stat = xmalloc(sizeof(*stat));
+		stat->node_name = xstrdup(name);
+		xhash_add(fwd_stat_hash, stat);
+	}
+
+	if (failed) {
+		stat->fail_cnt++;
+		stat->last_fail = time(NULL);
+	} else {
+		stat->fail_cnt = 0;
+		stat->last_fail = 0;
+		if (usec > 0) {
+			/* exponentially weighted, new sample counts 1/4 */
+			if (!stat->rtt_usec)
+				stat->rtt_usec = usec;
+			else
+				stat->rtt_usec = (stat->rtt_usec * 3 + usec) / 4;
+		}
+	}
+	slurm_mutex_unlock(&fwd_stat_mutex);
+}
+
+/*
+ * Estimate the round trip time to a node from the time it took to get the
+ * replies of the node and of the fwd_cnt nodes it forwarded the message to,
+ * counting one round trip per level of the tree below it. The slowest node
+ * of that tree still weighs on the estimate.
+ */
+static long _fwd_hop_usec(long usec, int fwd_cnt, uint16_t tree_width)
+{
+	long level_cnt = 1;
+	int levels = 1;
+
+	if (!tree_width)
+		tree_width = MAX(slurm_conf.tree_width, 1);
+
+	while (fwd_cnt > 0) {
+		level_cnt *= tree_width;
+		fwd_cnt -= level_cnt;
+		levels++;
+	}
+
+	return usec / levels;
+}
+
+/*
+ * Score a node as a candidate to head a branch, lower is better.
+ * Nodes without history score 0 so the route plugin ordering is kept until
+ * there is evidence against it. Call with fwd_stat_mutex locked.
+ */
+static uint64_t _fwd_stat_score(const char *name, time_t now)
+{
+	fwd_node_stat_t *stat;
+
+	if (!fwd_stat_hash || !(stat = xhash_get_str(fwd_stat_hash, name)))
+		return 0;
+
+	if (stat->fail_cnt &&
+	    ((now - stat->last_fail) < (FWD_FAIL_HOLDOFF * stat->fail_cnt)))
+		return ((uint64_t) stat->fail_cnt << 32) + stat->rtt_usec;
+
+	return stat->rtt_usec;
+}
+
+/*
+ * Move the node best suited to forward the message to the front of a branch.
+ * Nodes which recently failed to forward or answer are pushed out of the head
+ * position in favor of the quickest responder among the first
+ * FWD_HEAD_CANDIDATES nodes, so a slow or dead node ends up as a leaf instead
+ * of stalling its whole branch until MessageTimeout.
+ *
+ * IN/OUT hl - branch hostlist, replaced if reordered
+ */
+static void _fwd_order_branch(hostlist_t *hl)
+{
+	hostlist_iterator_t itr;
+	hostlist_t new_hl;
+	char *name, *best_name = NULL;
+	uint64_t score, best_score = 0, first_score = 0;
+	time_t now = time(NULL);
+	int i = 0;
+
+	if (hostlist_count(*hl) < 2)
+		return;
+
+	slurm_mutex_lock(&fwd_stat_mutex);
+	if (!fwd_stat_hash) {
+		slurm_mutex_unlock(&fwd_stat_mutex);
+		return;
+	}
+	itr = hostlist_iterator_create(*hl);
+	while ((i < FWD_HEAD_CANDIDATES) && (name = hostlist_next(itr))) {
+		score = _fwd_stat_score(name, now);
+		if (!i)
+			first_score = score;
+		if (!best_name || (score < best_score)) {
+			free(best_name);
+			best_name = name;
+			best_score = score;
+		} else
+			free(name);
+		i++;
+	}
+	hostlist_iterator_destroy(itr);
+	slurm_mutex_unlock(&fwd_stat_mutex);
+
+	/*
+	 * Only reorder if the current head is known bad or at least twice as
+	 * slow (and FWD_RTT_SLACK usec slower) than the best candidate, this
+	 * avoids churning between nodes of similar latency.
+	 */
+	if (best_name && (first_score > (best_score * 2)) &&
+	    ((first_score - best_score) > FWD_RTT_SLACK)) {
+		new_hl = hostlist_create(best_name);
+		hostlist_delete_host(*hl, best_name);
+		hostlist_push_list(new_hl, *hl);
+		hostlist_destroy(*hl);
+		*hl = new_hl;
+		log_flag(ROUTE, "%s: %s selected to head branch",
+			 __func__, best_name);
+	}
+	free(best_name);
+}
+
+static int _count_fwd_failed(void *x, void *arg)
+{
+	ret_data_info_t *ret_data_info = x;
+	int *fail_cnt = arg;
+
+	if (ret_data_info->type == RESPONSE_FORWARD_FAILED)
+		(*fail_cnt)++;
+
+	return 0;
+}
+
 void _destroy_tree_fwd(fwd_tree_t *fwd_tree)
 {
 	if (fwd_tree) {
@@ -106,6 +301,7 @@ void *_forward_thread(void *arg)
 	char *buf = NULL;
 	int steps = 0;
 	int start_timeout = fwd_msg->timeout;
+	DEF_TIMERS;
 
 	/* repeat until we are sure the message was sent */
 	while ((name = hostlist_shift(hl))) {
@@ -125,6 +321,7 @@ void *_forward_thread(void *arg)
 		}
 		if ((fd = slurm_open_msg_conn(&addr)) < 0) {
 			error("forward_thread to %s: %m", name);
+			_fwd_stat_update(name, 0, true);
 
 			slurm_mutex_lock(&fwd_struct->forward_mutex);
 			mark_as_failed_forward(
@@ -179,10 +376,12 @@ void *_forward_thread(void *arg)
 		/*
 		 * forward message
 		 */
+		START_TIMER;
 		if (slurm_msg_sendto(fd,
 				     get_buf_data(buffer),
 				     get_buf_offset(buffer)) < 0) {
 			error("forward_thread: slurm_msg_sendto: %m");
+			_fwd_stat_update(name, 0, true);
 
 			slurm_mutex_lock(&fwd_struct->forward_mutex);
 			mark_as_failed_forward(&fwd_struct->ret_list, name,
@@ -244,11 +443,13 @@ void *_forward_thread(void *arg)
 		}
 
 		ret_list = slurm_receive_msgs(fd, steps, fwd_msg->timeout);
+		END_TIMER;
 		/* info("sent %d forwards got %d back", */
 		/*      fwd_msg->header.forward.cnt, list_count(ret_list)); */
 
 		if (!ret_list || (fwd_msg->header.forward.cnt != 0
 				  && list_count(ret_list) <= 1)) {
+			_fwd_stat_update(name, 0, true);
 			slurm_mutex_lock(&fwd_struct->forward_mutex);
 			mark_as_failed_forward(&fwd_struct->ret_list, name,
 					       errno);
@@ -275,6 +476,7 @@ void *_forward_thread(void *arg)
 			int first_node_found = 0;
 			hostlist_iterator_t host_itr
 				= hostlist_iterator_create(hl);
+			_fwd_stat_update(name, 0, true);
 			error("We shouldn't be here.  We forwarded to %d "
 			      "but only got %d back",
 			      (fwd_msg->header.forward.cnt+1),
@@ -310,6 +512,12 @@ void *_forward_thread(void *arg)
 					name,
 					SLURM_COMMUNICATIONS_CONNECTION_ERROR);
 			}
+		} else {
+			_fwd_stat_update(name, _fwd_hop_usec(
+						 DELTA_TIMER,
+						 fwd_msg->header.forward.cnt,
+						 fwd_msg->header.forward.tree_width),
+					 false);
 		}
 		break;
 	}
@@ -346,6 +554,7 @@ void *_fwd_tree_thread(void *arg)
 	char *name = NULL;
 	char *buf = NULL;
 	slurm_msg_t send_msg;
+	DEF_TIMERS;
 
 	slurm_msg_t_init(&send_msg);
 	send_msg.msg_type = fwd_tree->orig_msg->msg_type;
@@ -383,13 +592,23 @@ void *_fwd_tree_thread(void *arg)
 		} else
 			debug3("Tree sending to %s", name);
 
+		START_TIMER;
 		ret_list = slurm_send_addr_recv_msgs(&send_msg, name,
 						     fwd_tree->timeout);
+		END_TIMER;
 
 		xfree(send_msg.forward.nodelist);
 
 		if (ret_list) {
 			int ret_cnt = list_count(ret_list);
+			bool fwd_failed = (ret_cnt <= send_msg.forward.cnt) ||
+				(errno == SLURM_COMMUNICATIONS_CONNECTION_ERROR);
+
+			_fwd_stat_update(name,
+					 _fwd_hop_usec(DELTA_TIMER,
+						       send_msg.forward.cnt,
+						       send_msg.forward.tree_width),
+					 fwd_failed);
 			/* This is most common if a slurmd is running
 			   an older version of Slurm than the
 			   originator of the message.
@@ -444,6 +663,7 @@ void *_fwd_tree_thread(void *arg)
 			error("fwd_tree_thread: no return list given from "
 			      "slurm_send_addr_recv_msgs spawned for %s",
 			      name);
+			_fwd_stat_update(name, 0, true);
 			slurm_mutex_lock(fwd_tree->tree_mutex);
 			mark_as_failed_forward(
 				&fwd_tree->ret_list, name,
@@ -495,6 +715,7 @@ static void _start_msg_tree_internal(hostlist_t hl, hostlist_t* sp_hl,
 		memcpy(fwd_tree, fwd_tree_in, sizeof(fwd_tree_t));
 
 		if (sp_hl) {
+			_fwd_order_branch(&sp_hl[j]);
 			fwd_tree->tree_hl = sp_hl[j];
 			sp_hl[j] = NULL;
 		} else if (hl) {
@@ -550,6 +771,7 @@ static void _forward_msg_internal(hostlist_t hl, hostlist_t* sp_hl,
 		fwd_msg->header.ret_cnt = 0;
 
 		if (sp_hl) {
+			_fwd_order_branch(&sp_hl[j]);
 			buf = hostlist_ranged_string_xmalloc(sp_hl[j]);
 			hostlist_destroy(sp_hl[j]);
 		} else {
@@ -564,11 +786,22 @@ static void _forward_msg_internal(hostlist_t hl, hostlist_t* sp_hl,
 	}
 }
 
+/*
+ * forward_fini    - free the forwarding history used to order branches
+ */
+extern void forward_fini(void)
+{
+	slurm_mutex_lock(&fwd_stat_mutex);
+	xhash_free(fwd_stat_hash);
+	slurm_mutex_unlock(&fwd_stat_mutex);
+}
+
 /*
  * forward_init    - initialize forward structure
  * IN: forward     - forward_t *   - struct to store forward info
  * RET: VOID
  */
+
 extern void forward_init(forward_t *forward)
 {
 	memset(forward, 0, sizeof(forward_t));
@@ -638,10 +871,12 @@ extern List start_msg_tree(hostlist_t hl, slurm_msg_t *msg, int timeout)
 	int host_count = 0;
 	hostlist_t* sp_hl;
 	int hl_count = 0;
+	DEF_TIMERS;
 
 	xassert(hl);
 	xassert(msg);
 
+	START_TIMER;
 	hostlist_uniq(hl);
 	host_count = hostlist_count(hl);
 
@@ -679,6 +914,15 @@ extern List start_msg_tree(hostlist_t hl, slurm_msg_t *msg, int timeout)
 	xassert(count >= host_count);	/* Tree head did not get all responses,
 					 * but no more active fwd threads!*/
 	slurm_mutex_unlock(&tree_mutex);
+	END_TIMER;
+
+	if (slurm_conf.debug_flags & DEBUG_FLAG_ROUTE) {
+		int fail_cnt = 0;
+		(void) list_for_each(ret_list, _count_fwd_failed, &fail_cnt);
+		log_flag(ROUTE, "%s: %s sent to %d nodes over %d branches, %d responses, %d failed, %s",
+			 __func__, rpc_num2string(msg->msg_type), host_count,
+			 hl_count, count, fail_cnt, TIME_STR);
+	}
 
 	slurm_mutex_destroy(&tree_mutex);
 	slurm_cond_destroy(&notify);
@@ -49,6 +49,11 @@
  */
 extern void forward_init(forward_t *forward);
 
+/*
+ * forward_fini    - free the forwarding history used to order branches
+ */
+extern void forward_fini(void);
+
 /*
  * forward_msg	      - logic to forward a message which has been received and
  *			accumulate the return codes from processes getting the
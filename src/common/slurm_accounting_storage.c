@@ -64,6 +64,7 @@ typedef struct slurm_acct_storage_ops {
 				    bool rollback, char *cluster_name);
 	int  (*close_conn)         (void **db_conn);
 	int  (*commit)             (void *db_conn, bool commit);
+	int  (*batch)              (void *db_conn, bool start);
 	int  (*add_users)          (void *db_conn, uint32_t uid,
 				    List user_list);
 	int  (*add_coord)          (void *db_conn, uint32_t uid,
@@ -164,6 +165,9 @@ typedef struct slurm_acct_storage_ops {
 				    slurmdb_reservation_cond_t *resv_cond);
 	List (*get_txn)            (void *db_conn, uint32_t uid,
 				    slurmdb_txn_cond_t *txn_cond);
+	int  (*get_updates)        (void *db_conn, uint32_t uid,
+				    uint32_t *epoch, uint64_t *gen,
+				    List *update_list);
 	int  (*get_usage)          (void *db_conn, uint32_t uid,
 				    void *in, int type,
 				    time_t start,
@@ -192,6 +196,8 @@ typedef struct slurm_acct_storage_ops {
 	int  (*job_suspend)        (void *db_conn, job_record_t *job_ptr);
 	List (*get_jobs_cond)      (void *db_conn, uint32_t uid,
 				    slurmdb_job_cond_t *job_cond);
+	List (*get_jobs_chunk)     (void *db_conn, uint32_t uid,
+				    slurmdb_job_cond_t *job_cond);
 	int (*archive_dump)        (void *db_conn,
 				    slurmdb_archive_cond_t *arch_cond);
 	int (*archive_load)        (void *db_conn,
@@ -216,6 +222,7 @@ static const char *syms[] = {
 	"acct_storage_p_get_connection",
 	"acct_storage_p_close_connection",
 	"acct_storage_p_commit",
+	"acct_storage_p_batch",
 	"acct_storage_p_add_users",
 	"acct_storage_p_add_coord",
 	"acct_storage_p_add_accts",
@@ -261,6 +268,7 @@ static const char *syms[] = {
 	"acct_storage_p_get_wckeys",
 	"acct_storage_p_get_reservations",
 	"acct_storage_p_get_txn",
+	"acct_storage_p_get_updates",
 	"acct_storage_p_get_usage",
 	"acct_storage_p_roll_usage",
 	"acct_storage_p_fix_runaway_jobs",
@@ -276,6 +284,7 @@ static const char *syms[] = {
 	"jobacct_storage_p_step_complete",
 	"jobacct_storage_p_suspend",
 	"jobacct_storage_p_get_jobs_cond",
+	"jobacct_storage_p_get_jobs_chunk",
 	"jobacct_storage_p_archive",
 	"jobacct_storage_p_archive_load",
 	"acct_storage_p_update_shares_used",
@@ -379,6 +388,13 @@ extern int acct_storage_g_commit(void *db_conn, bool commit)
 
 }
 
+extern int acct_storage_g_batch(void *db_conn, bool start)
+{
+	if (slurm_acct_storage_init() < 0)
+		return SLURM_ERROR;
+	return (*(ops.batch))(db_conn, start);
+}
+
 extern int acct_storage_g_add_users(void *db_conn, uint32_t uid,
 				    List user_list)
 {
@@ -755,6 +771,16 @@ extern List acct_storage_g_get_txn(void *db_conn,  uint32_t uid,
 	return (*(ops.get_txn))(db_conn, uid, txn_cond);
 }
 
+extern int acct_storage_g_get_updates(void *db_conn, uint32_t uid,
+				      uint32_t *epoch, uint64_t *gen,
+				      List *update_list)
+{
+	*update_list = NULL;
+	if (slurm_acct_storage_init() < 0)
+		return SLURM_ERROR;
+	return (*(ops.get_updates))(db_conn, uid, epoch, gen, update_list);
+}
+
 extern int acct_storage_g_get_usage(void *db_conn,  uint32_t uid,
 				    void *in, int type,
 				    time_t start, time_t end)
@@ -966,6 +992,27 @@ extern List jobacct_storage_g_get_jobs_cond(void *db_conn, uint32_t uid,
 	return ret_list;
 }
 
+/*
+ * get info from the storage in chunks of bounded size
+ * returns List of job_rec_t *, empty once all the jobs were returned
+ * note List needs to be freed when called
+ */
+extern List jobacct_storage_g_get_jobs_chunk(void *db_conn, uint32_t uid,
+					     slurmdb_job_cond_t *job_cond)
+{
+	List ret_list;
+
+	if (slurm_acct_storage_init() < 0)
+		return NULL;
+	ret_list = (*(ops.get_jobs_chunk))(db_conn, uid, job_cond);
+
+	/* A chunk can hold the jobs of several clusters */
+	if (ret_list && (list_count(ret_list) > 1))
+		list_sort(ret_list, (ListCmpF)_sort_desc_submit_time);
+
+	return ret_list;
+}
+
 /*
  * expire old info from the storage
  */
@@ -90,6 +90,16 @@ extern int acct_storage_g_close_connection(void **db_conn);
  */
 extern int acct_storage_g_commit(void *db_conn, bool commit);
 
+/*
+ * start or end a batch of job and step records, the records sent while the
+ * batch is open may only be written when it ends, in fewer statements
+ * IN: void * pointer returned from acct_storage_g_get_connection()
+ * IN: bool - true will start the batch false will write and end it
+ * RET: SLURM_SUCCESS if all the records of the batch were written
+ *      SLURM_ERROR else
+ */
+extern int acct_storage_g_batch(void *db_conn, bool start);
+
 /*
  * add users to accounting system
  * IN:  user_list List of slurmdb_user_rec_t *
@@ -490,6 +500,20 @@ extern List acct_storage_g_get_reservations(
 extern List acct_storage_g_get_txn(void *db_conn,  uint32_t uid,
 				   slurmdb_txn_cond_t *txn_cond);
 
+/*
+ * get the updates committed since a version of the association state
+ * IN/OUT: epoch - update log the state was read from, set to the current one
+ * IN/OUT: gen - last update applied to the state, set to the last update
+ *		 returned
+ * OUT: update_list - List of slurmdb_update_object_t *, NULL if the updates
+ *		      are no longer known and the state must be read in full
+ * RET: SLURM_SUCCESS on success SLURM_ERROR else
+ * note List needs to be freed when called
+ */
+extern int acct_storage_g_get_updates(void *db_conn, uint32_t uid,
+				      uint32_t *epoch, uint64_t *gen,
+				      List *update_list);
+
 /*
  * get info from the storage
  * IN/OUT:  in void * (acct_assoc_rec_t *) or
@@ -644,6 +668,17 @@ extern int jobacct_storage_g_job_suspend(void *db_conn,
 extern List jobacct_storage_g_get_jobs_cond(void *db_conn, uint32_t uid,
 					    slurmdb_job_cond_t *job_cond);
 
+/*
+ * get info from the storage in chunks of bounded size
+ * IN:  job_cond - condition of a new query, NULL to get the next chunk of
+ *                 the query in progress on db_conn
+ * returns List of jobacct_job_rec_t *, empty once all the jobs were
+ *         returned, NULL on error
+ * note List needs to be freed when called
+ */
+extern List jobacct_storage_g_get_jobs_chunk(void *db_conn, uint32_t uid,
+					     slurmdb_job_cond_t *job_cond);
+
 /*
  * expire old info from the storage
  */
@@ -63,6 +63,7 @@
 #include "src/common/uid.h"
 #include "src/common/xassert.h"
 #include "src/common/xmalloc.h"
+#include "src/common/xhash.h"
 #include "src/common/xstring.h"
 
 #ifndef __sbcast_cred_t_defined
@@ -84,6 +85,9 @@ typedef struct sbcast_cred sbcast_cred_t;		/* opaque data type */
 
 #define MAX_TIME 0x7fffffff
 
+/* Length of the step_id+ctime key used to index cred_state_t records */
+#define CRED_STATE_KEY_LEN (sizeof(slurm_step_id_t) + sizeof(time_t))
+
 /*
  * slurm job credential state
  *
@@ -92,6 +96,7 @@ typedef struct {
 	time_t   ctime;		/* Time that the cred was created	*/
 	time_t   expiration;    /* Time at which cred is no longer good	*/
 	slurm_step_id_t step_id; /* Slurm step id for this credential	*/
+	char     key[CRED_STATE_KEY_LEN]; /* step_id+ctime, state_hash key */
 } cred_state_t;
 
 /*
@@ -148,6 +153,8 @@ struct slurm_cred_context {
 	void *key;		/* private or public key		*/
 	List job_list;		/* List of used jobids (for verifier)	*/
 	List state_list;	/* List of cred states (for verifier)	*/
+	xhash_t *job_hash;	/* job_list records indexed by jobid	*/
+	xhash_t *state_hash;	/* state_list records by step_id+ctime	*/
 
 	int expiry_window;	/* expiration window for cached creds	*/
 
@@ -271,7 +278,11 @@ static void           _job_state_destroy(job_state_t   *js);
 
 static job_state_t  * _find_job_state(slurm_cred_ctx_t ctx, uint32_t jobid);
 static job_state_t  * _insert_job_state(slurm_cred_ctx_t ctx,  uint32_t jobid);
-static int _list_find_cred_state(void *x, void *key);
+static void _job_state_identify(void *item, const char **key,
+				uint32_t *key_len);
+static void _cred_state_key(char *key, slurm_step_id_t *step_id, time_t ctime);
+static void _cred_state_identify(void *item, const char **key,
+				 uint32_t *key_len);
 
 static void _insert_cred_state(slurm_cred_ctx_t ctx, slurm_cred_t *cred);
 static void _clear_expired_job_states(slurm_cred_ctx_t ctx);
@@ -486,6 +497,9 @@ slurm_cred_ctx_destroy(slurm_cred_ctx_t ctx)
 		(*(ops.cred_destroy_key))(ctx->exkey);
 	if (ctx->key)
 		(*(ops.cred_destroy_key))(ctx->key);
+	/* The hashes only index records owned by the lists */
+	xhash_free(ctx->job_hash);
+	xhash_free(ctx->state_hash);
 	FREE_NULL_LIST(ctx->job_list);
 	FREE_NULL_LIST(ctx->state_list);
 
@@ -1157,6 +1171,8 @@ slurm_cred_insert_jobid(slurm_cred_ctx_t ctx, uint32_t jobid)
 int
 slurm_cred_rewind(slurm_cred_ctx_t ctx, slurm_cred_t *cred)
 {
+	char key[CRED_STATE_KEY_LEN];
+	cred_state_t *s;
 	int rc = 0;
 
 	xassert(ctx != NULL);
@@ -1166,7 +1182,9 @@ slurm_cred_rewind(slurm_cred_ctx_t ctx, slurm_cred_t *cred)
 	xassert(ctx->magic == CRED_CTX_MAGIC);
 	xassert(ctx->type  == SLURM_CRED_VERIFIER);
 
-	rc = list_delete_all(ctx->state_list, _list_find_cred_state, cred);
+	_cred_state_key(key, &cred->step_id, cred->ctime);
+	if ((s = xhash_pop(ctx->state_hash, key, sizeof(key))))
+		rc = list_delete_ptr(ctx->state_list, s);
 
 	slurm_mutex_unlock(&ctx->mutex);
 
@@ -1809,6 +1827,8 @@ _verifier_ctx_init(slurm_cred_ctx_t ctx)
 
 	ctx->job_list   = list_create((ListDelF) _job_state_destroy);
 	ctx->state_list = list_create(xfree_ptr);
+	ctx->job_hash   = xhash_init(_job_state_identify, NULL);
+	ctx->state_hash = xhash_init(_cred_state_identify, NULL);
 
 	return;
 }
@@ -2136,27 +2156,31 @@ static void _pack_cred(slurm_cred_t *cred, buf_t *buffer,
 	}
 }
 
-static int _list_find_cred_state(void *x, void *key)
+static void _cred_state_key(char *key, slurm_step_id_t *step_id, time_t ctime)
 {
-	cred_state_t *s = (cred_state_t *) x;
-	slurm_cred_t *cred = (slurm_cred_t *) key;
+	memcpy(key, step_id, sizeof(*step_id));
+	memcpy(key + sizeof(*step_id), &ctime, sizeof(ctime));
+}
 
-	if (!memcmp(&s->step_id, &cred->step_id, sizeof(s->step_id)) &&
-	    (s->ctime == cred->ctime))
-		return 1;
+static void _cred_state_identify(void *item, const char **key,
+				 uint32_t *key_len)
+{
+	cred_state_t *s = item;
 
-	return 0;
+	*key = s->key;
+	*key_len = sizeof(s->key);
 }
 
-
 static bool
 _credential_replayed(slurm_cred_ctx_t ctx, slurm_cred_t *cred)
 {
+	char key[CRED_STATE_KEY_LEN];
 	cred_state_t *s = NULL;
 
 	_clear_expired_credential_states(ctx);
 
-	s = list_find_first(ctx->state_list, _list_find_cred_state, cred);
+	_cred_state_key(key, &cred->step_id, cred->ctime);
+	s = xhash_get(ctx->state_hash, key, sizeof(key));
 
 	/*
 	 * If we found a match, this credential is being replayed.
@@ -2236,31 +2260,29 @@ _credential_revoked(slurm_cred_ctx_t ctx, slurm_cred_t *cred)
 	return false;
 }
 
-static int _list_find_job_state(void *x, void *key)
+static void _job_state_identify(void *item, const char **key,
+				uint32_t *key_len)
 {
-	job_state_t *j = (job_state_t *) x;
-	uint32_t jobid = *(uint32_t *) key;
-	if (j->jobid == jobid)
-		return 1;
-	return 0;
+	job_state_t *j = item;
+
+	*key = (const char *) &j->jobid;
+	*key_len = sizeof(j->jobid);
 }
 
 static job_state_t *
 _find_job_state(slurm_cred_ctx_t ctx, uint32_t jobid)
 {
-	job_state_t *j =
-		list_find_first(ctx->job_list, _list_find_job_state, &jobid);
-	return j;
+	return xhash_get(ctx->job_hash, (const char *) &jobid, sizeof(jobid));
 }
 
 static job_state_t *
 _insert_job_state(slurm_cred_ctx_t ctx, uint32_t jobid)
 {
-	job_state_t *j = list_find_first(
-		ctx->job_list, _list_find_job_state, &jobid);;
+	job_state_t *j = _find_job_state(ctx, jobid);
 	if (!j) {
 		j = _job_state_create(jobid);
 		list_append(ctx->job_list, j);
+		xhash_add(ctx->job_hash, j);
 	} else
 		debug2("%s: we already have a job state for job %u.  No big deal, just an FYI.",
 		       __func__, jobid);
@@ -2306,6 +2328,8 @@ _clear_expired_job_states(slurm_cred_ctx_t ctx)
 		debug3("state for jobid %u: ctime:%ld revoked:%ld expires:%ld",
 		       j->jobid, j->ctime, j->revoked, j->expiration);
 		if (j->revoked && (now > j->expiration)) {
+			xhash_delete(ctx->job_hash, (const char *) &j->jobid,
+				     sizeof(j->jobid));
 			list_delete_item(i);
 		}
 	}
@@ -2313,27 +2337,26 @@ _clear_expired_job_states(slurm_cred_ctx_t ctx)
 	list_iterator_destroy(i);
 }
 
-static int _list_find_expired(void *x, void *key)
-{
-	cred_state_t *s = (cred_state_t *)x;
-	time_t curr_time = *(time_t *)key;
-
-	if (curr_time > s->expiration)
-		return 1;
-	return 0;
-}
-
 static void
 _clear_expired_credential_states(slurm_cred_ctx_t ctx)
 {
 	static time_t last_scan = 0;
 	time_t        now = time(NULL);
+	ListIterator  i   = NULL;
+	cred_state_t *s   = NULL;
 
 	if ((now - last_scan) < 2)	/* Reduces slurmd overhead */
 		return;
 	last_scan = now;
 
-	list_delete_all(ctx->state_list, _list_find_expired, &now);
+	i = list_iterator_create(ctx->state_list);
+	while ((s = list_next(i))) {
+		if (now > s->expiration) {
+			xhash_delete(ctx->state_hash, s->key, sizeof(s->key));
+			list_delete_item(i);
+		}
+	}
+	list_iterator_destroy(i);
 }
 
 
@@ -2342,6 +2365,7 @@ _insert_cred_state(slurm_cred_ctx_t ctx, slurm_cred_t *cred)
 {
 	cred_state_t *s = _cred_state_create(ctx, cred);
 	list_append(ctx->state_list, s);
+	xhash_add(ctx->state_hash, s);
 }
 
 
@@ -2353,6 +2377,7 @@ _cred_state_create(slurm_cred_ctx_t ctx, slurm_cred_t *cred)
 	memcpy(&s->step_id, &cred->step_id, sizeof(s->step_id));
 	s->ctime      = cred->ctime;
 	s->expiration = cred->ctime + ctx->expiry_window;
+	_cred_state_key(s->key, &s->step_id, s->ctime);
 
 	return s;
 }
@@ -2374,6 +2399,7 @@ static cred_state_t *_cred_state_unpack_one(buf_t *buffer)
 		goto unpack_error;
 	safe_unpack_time(&s->ctime, buffer);
 	safe_unpack_time(&s->expiration, buffer);
+	_cred_state_key(s->key, &s->step_id, s->ctime);
 	return s;
 
 unpack_error:
@@ -2445,9 +2471,11 @@ static void _cred_state_unpack(slurm_cred_ctx_t ctx, buf_t *buffer)
 		if (!(s = _cred_state_unpack_one(buffer)))
 			goto unpack_error;
 
-		if (now < s->expiration)
+		if ((now < s->expiration) &&
+		    !xhash_get(ctx->state_hash, s->key, sizeof(s->key))) {
 			list_append(ctx->state_list, s);
-		else
+			xhash_add(ctx->state_hash, s);
+		} else
 			xfree(s);
 	}
 
@@ -2488,9 +2516,15 @@ static void _job_state_unpack(slurm_cred_ctx_t ctx, buf_t *buffer)
 		if (!(j = _job_state_unpack_one(buffer)))
 			goto unpack_error;
 
-		if (!j->revoked || (j->revoked && (now < j->expiration)))
+		if (_find_job_state(ctx, j->jobid)) {
+			debug3("not appending duplicate job %u state",
+			       j->jobid);
+			_job_state_destroy(j);
+		} else if (!j->revoked ||
+			   (j->revoked && (now < j->expiration))) {
 			list_append(ctx->job_list, j);
-		else {
+			xhash_add(ctx->job_hash, j);
+		} else {
 			debug3 ("not appending expired job %u state",
 			        j->jobid);
 			_job_state_destroy(j);
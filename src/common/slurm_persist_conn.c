@@ -220,110 +220,129 @@ static void _persist_free_msg_members(slurm_persist_conn_t *persist_conn,
 		slurm_free_msg_data(persist_msg->msg_type, persist_msg->data);
 }
 
-static int _process_service_connection(
-	slurm_persist_conn_t *persist_conn, void *arg)
+/*
+ * Read and process one message of a connection, sending back the response.
+ * IN/OUT first - set if no message was received on the connection yet
+ * IN/OUT uid - user who sent the messages of the connection
+ * OUT rc - return code of the callback processing the message
+ * RET false if the connection should be closed
+ */
+static bool _process_service_msg(slurm_persist_conn_t *persist_conn,
+				 void *arg, bool *first, uint32_t *uid,
+				 int *rc)
 {
-	uint32_t nw_size = 0, msg_size = 0, uid = NO_VAL;
+	uint32_t nw_size = 0, msg_size = 0;
 	char *msg_char = NULL;
 	ssize_t msg_read = 0, offset = 0;
-	bool first = true, fini = false;
+	bool fini = false;
 	buf_t *buffer = NULL;
-	int rc = SLURM_SUCCESS;
-
-	xassert(persist_conn->callback_proc);
-	xassert(persist_conn->shutdown);
-
-	log_flag(NET, "%s: Opened connection %d from %s",
-		 __func__, persist_conn->fd, persist_conn->rem_host);
 
-	if (persist_conn->flags & PERSIST_FLAG_ALREADY_INITED)
-		first = false;
+	if (!_conn_readable(persist_conn))
+		return false;		/* problem with this socket */
+	msg_read = read(persist_conn->fd, &nw_size, sizeof(nw_size));
+	if (msg_read == 0)	/* EOF */
+		return false;
+	if (msg_read != sizeof(nw_size)) {
+		error("Could not read msg_size from "
+		      "connection %d(%s) uid(%d)",
+		      persist_conn->fd, persist_conn->rem_host, *uid);
+		return false;
+	}
+	msg_size = ntohl(nw_size);
+	if ((msg_size < 2) || (msg_size > MAX_MSG_SIZE)) {
+		error("Invalid msg_size (%u) from "
+		      "connection %d(%s) uid(%d)",
+		      msg_size, persist_conn->fd,
+		      persist_conn->rem_host, *uid);
+		return false;
+	}
 
-	while (!(*persist_conn->shutdown) && !fini) {
+	msg_char = xmalloc(msg_size);
+	offset = 0;
+	while (msg_size > offset) {
 		if (!_conn_readable(persist_conn))
 			break;		/* problem with this socket */
-		msg_read = read(persist_conn->fd, &nw_size, sizeof(nw_size));
-		if (msg_read == 0)	/* EOF */
-			break;
-		if (msg_read != sizeof(nw_size)) {
-			error("Could not read msg_size from "
-			      "connection %d(%s) uid(%d)",
-			      persist_conn->fd, persist_conn->rem_host, uid);
-			break;
-		}
-		msg_size = ntohl(nw_size);
-		if ((msg_size < 2) || (msg_size > MAX_MSG_SIZE)) {
-			error("Invalid msg_size (%u) from "
-			      "connection %d(%s) uid(%d)",
-			      msg_size, persist_conn->fd,
-			      persist_conn->rem_host, uid);
+		msg_read = read(persist_conn->fd, (msg_char + offset),
+				(msg_size - offset));
+		if (msg_read <= 0) {
+			error("read(%d): %m", persist_conn->fd);
 			break;
 		}
+		offset += msg_read;
+	}
+	if (msg_size == offset) {
+		persist_msg_t msg;
 
-		msg_char = xmalloc(msg_size);
-		offset = 0;
-		while (msg_size > offset) {
-			if (!_conn_readable(persist_conn))
-				break;		/* problem with this socket */
-			msg_read = read(persist_conn->fd, (msg_char + offset),
-					(msg_size - offset));
-			if (msg_read <= 0) {
-				error("read(%d): %m", persist_conn->fd);
-				break;
-			}
-			offset += msg_read;
-		}
-		if (msg_size == offset) {
-			persist_msg_t msg;
-
-			rc = slurm_persist_conn_process_msg(
-				persist_conn, &msg,
-				msg_char, msg_size,
-				&buffer, first);
-
-			if (rc == SLURM_SUCCESS) {
-				rc = (persist_conn->callback_proc)(
-					arg, &msg, &buffer, &uid);
-				_persist_free_msg_members(persist_conn, &msg);
-				if (rc != SLURM_SUCCESS &&
-				    rc != ACCOUNTING_FIRST_REG &&
-				    rc != ACCOUNTING_TRES_CHANGE_DB &&
-				    rc != ACCOUNTING_NODES_CHANGE_DB) {
-					error("Processing last message from "
-					      "connection %d(%s) uid(%d)",
-					      persist_conn->fd,
-					      persist_conn->rem_host, uid);
-					if (rc == ESLURM_ACCESS_DENIED ||
-					    rc == SLURM_PROTOCOL_VERSION_ERROR)
-						fini = true;
-				}
+		*rc = slurm_persist_conn_process_msg(
+			persist_conn, &msg,
+			msg_char, msg_size,
+			&buffer, *first);
+
+		if (*rc == SLURM_SUCCESS) {
+			*rc = (persist_conn->callback_proc)(
+				arg, &msg, &buffer, uid);
+			_persist_free_msg_members(persist_conn, &msg);
+			if (*rc != SLURM_SUCCESS &&
+			    *rc != ACCOUNTING_FIRST_REG &&
+			    *rc != ACCOUNTING_TRES_CHANGE_DB &&
+			    *rc != ACCOUNTING_NODES_CHANGE_DB) {
+				error("Processing last message from "
+				      "connection %d(%s) uid(%d)",
+				      persist_conn->fd,
+				      persist_conn->rem_host, *uid);
+				if (*rc == ESLURM_ACCESS_DENIED ||
+				    *rc == SLURM_PROTOCOL_VERSION_ERROR)
+					fini = true;
 			}
-			first = false;
-		} else {
-			buffer = slurm_persist_make_rc_msg(
-				persist_conn, SLURM_ERROR, "Bad offset", 0);
-			fini = true;
 		}
+		*first = false;
+	} else {
+		buffer = slurm_persist_make_rc_msg(
+			persist_conn, SLURM_ERROR, "Bad offset", 0);
+		fini = true;
+	}
 
-		xfree(msg_char);
-		if (buffer) {
-			if (slurm_persist_send_msg(persist_conn, buffer)
-			    != SLURM_SUCCESS) {
-				/* This is only an issue on persistent
-				 * connections, and really isn't that big of a
-				 * deal as the slurmctld will just send the
-				 * message again. */
-				if (persist_conn->rem_port)
-					log_flag(NET, "%s: Problem sending response to connection host:%s fd:%d uid:%d",
-						 __func__,
-						 persist_conn->rem_host,
-						 persist_conn->fd, uid);
-				fini = true;
-			}
-			free_buf(buffer);
+	xfree(msg_char);
+	if (buffer) {
+		if (slurm_persist_send_msg(persist_conn, buffer)
+		    != SLURM_SUCCESS) {
+			/* This is only an issue on persistent
+			 * connections, and really isn't that big of a
+			 * deal as the slurmctld will just send the
+			 * message again. */
+			if (persist_conn->rem_port)
+				log_flag(NET, "%s: Problem sending response to connection host:%s fd:%d uid:%d",
+					 __func__,
+					 persist_conn->rem_host,
+					 persist_conn->fd, *uid);
+			fini = true;
 		}
+		free_buf(buffer);
 	}
 
+	return !fini;
+}
+
+static int _process_service_connection(
+	slurm_persist_conn_t *persist_conn, void *arg)
+{
+	uint32_t uid = NO_VAL;
+	bool first = true;
+	int rc = SLURM_SUCCESS;
+
+	xassert(persist_conn->callback_proc);
+	xassert(persist_conn->shutdown);
+
+	log_flag(NET, "%s: Opened connection %d from %s",
+		 __func__, persist_conn->fd, persist_conn->rem_host);
+
+	if (persist_conn->flags & PERSIST_FLAG_ALREADY_INITED)
+		first = false;
+
+	while (!(*persist_conn->shutdown) &&
+	       _process_service_msg(persist_conn, arg, &first, &uid, &rc))
+		;
+
 	log_flag(NET, "%s: Closed connection host:%s fd:%d uid:%d",
 		 __func__, persist_conn->rem_host, persist_conn->fd, uid);
 
@@ -464,6 +483,29 @@ extern void slurm_persist_conn_recv_thread_init(slurm_persist_conn_t *persist_co
 			    _service_connection, service_conn);
 }
 
+extern int slurm_persist_conn_process_one(slurm_persist_conn_t *persist_conn,
+					  void *arg, uint32_t *uid)
+{
+	bool first = !(persist_conn->flags & PERSIST_FLAG_ALREADY_INITED);
+	int rc = SLURM_SUCCESS;
+
+	xassert(persist_conn->callback_proc);
+	xassert(persist_conn->shutdown);
+
+	if (*persist_conn->shutdown ||
+	    !_process_service_msg(persist_conn, arg, &first, uid, &rc)) {
+		log_flag(NET, "%s: Closed connection host:%s fd:%d uid:%d",
+			 __func__, persist_conn->rem_host, persist_conn->fd,
+			 *uid);
+		return SLURM_ERROR;
+	}
+
+	if (!first)
+		persist_conn->flags |= PERSIST_FLAG_ALREADY_INITED;
+
+	return SLURM_SUCCESS;
+}
+
 /* Increment thread_count and don't return until its value is no larger
  *	than MAX_THREAD_COUNT,
  * RET index of free index in persist_service_conn or -1 to exit */
@@ -122,6 +122,19 @@ extern void slurm_persist_conn_recv_server_fini(void);
 extern void slurm_persist_conn_recv_thread_init(slurm_persist_conn_t *persist_conn,
 						int thread_loc, void *arg);
 
+/*
+ * Read and process the next message of a persistent connection, for servers
+ * waiting on their connections themselves instead of with
+ * slurm_persist_conn_recv_thread_init(). Call it once the connection is
+ * readable.
+ * IN - persist_conn - persistent connection to read from
+ * IN - arg - arbitrary argument sent to the callback of the persist_conn
+ * IN/OUT - uid - user of the connection, NO_VAL before the first message
+ * RET SLURM_SUCCESS, or SLURM_ERROR if the connection must now be closed
+ */
+extern int slurm_persist_conn_process_one(slurm_persist_conn_t *persist_conn,
+					  void *arg, uint32_t *uid);
+
 /* Increment thread_count and don't return until its value is no larger
  *	than MAX_THREAD_COUNT,
  * RET index of free index in persist_pthread_id or -1 to exit */
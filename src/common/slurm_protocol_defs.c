@@ -1635,6 +1635,16 @@ extern void slurm_free_epilog_complete_msg(epilog_complete_msg_t * msg)
 	}
 }
 
+extern void slurm_free_composite_epilog_msg(composite_epilog_msg_t *msg)
+{
+	if (msg) {
+		xfree(msg->job_id);
+		xfree(msg->return_code);
+		xfree(msg->node_name);
+		xfree(msg);
+	}
+}
+
 extern void slurm_free_srun_job_complete_msg(
 		srun_job_complete_msg_t * msg)
 {
@@ -4963,6 +4973,9 @@ extern int slurm_free_msg_data(slurm_msg_type_t type, void *data)
 	case MESSAGE_EPILOG_COMPLETE:
 		slurm_free_epilog_complete_msg(data);
 		break;
+	case MESSAGE_COMPOSITE_EPILOG_COMPLETE:
+		slurm_free_composite_epilog_msg(data);
+		break;
 	case REQUEST_KILL_JOB:
 	case REQUEST_CANCEL_JOB_STEP:
 	case SRUN_STEP_SIGNAL:
@@ -5194,6 +5207,7 @@ extern int slurm_free_msg_data(slurm_msg_type_t type, void *data)
 		slurm_free_reboot_msg(data);
 		break;
 	case ACCOUNTING_UPDATE_MSG:
+	case ACCOUNTING_UPDATE_LOG_MSG:
 		slurm_free_accounting_update_msg(data);
 		break;
 	case RESPONSE_TOPO_INFO:
@@ -5756,6 +5770,8 @@ rpc_num2string(uint16_t opcode)
 		return "REQUEST_COMPLETE_PROLOG";
 	case RESPONSE_PROLOG_EXECUTING:				/* 6019 */
 		return "RESPONSE_PROLOG_EXECUTING";
+	case MESSAGE_COMPOSITE_EPILOG_COMPLETE:
+		return "MESSAGE_COMPOSITE_EPILOG_COMPLETE";
 
 	case SRUN_PING:						/* 7001 */
 		return "SRUN_PING";
@@ -5806,6 +5822,8 @@ rpc_num2string(uint16_t opcode)
 		return "ACCOUNTING_TRES_CHANGE_DB";
 	case ACCOUNTING_NODES_CHANGE_DB:
 		return "ACCOUNTING_NODES_CHANGE_DB";
+	case ACCOUNTING_UPDATE_LOG_MSG:
+		return "ACCOUNTING_UPDATE_LOG_MSG";
 
 	case REQUEST_PERSIST_INIT:
 		return "REQUEST_PERSIST_INIT";
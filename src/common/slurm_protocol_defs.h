@@ -422,6 +422,7 @@ typedef enum {
 	REQUEST_LAUNCH_PROLOG,
 	REQUEST_COMPLETE_PROLOG,
 	RESPONSE_PROLOG_EXECUTING,	/* 6019 */
+	MESSAGE_COMPOSITE_EPILOG_COMPLETE,
 
 	REQUEST_PERSIST_INIT = 6500,
 
@@ -453,6 +454,7 @@ typedef enum {
 	ACCOUNTING_REGISTER_CTLD,
 	ACCOUNTING_TRES_CHANGE_DB,
 	ACCOUNTING_NODES_CHANGE_DB,
+	ACCOUNTING_UPDATE_LOG_MSG,
 } slurm_msg_type_t;
 
 /*****************************************************************************\
@@ -719,6 +721,14 @@ typedef struct epilog_complete_msg {
 	char    *node_name;
 } epilog_complete_msg_t;
 
+/* Several MESSAGE_EPILOG_COMPLETE from one node packed into one message */
+typedef struct composite_epilog_msg {
+	uint32_t job_cnt;
+	uint32_t *job_id;	/* job_cnt elements */
+	uint32_t *return_code;	/* job_cnt elements */
+	char    *node_name;
+} composite_epilog_msg_t;
+
 #define REBOOT_FLAGS_ASAP 0x0001	/* Drain to reboot ASAP */
 typedef struct reboot_msg {
 	char *features;
@@ -1364,6 +1374,9 @@ typedef struct {
 \*****************************************************************************/
 
 typedef struct {
+	uint32_t epoch;	  /* update log of the slurmdbd, 0 if not logged, only
+			   * sent with ACCOUNTING_UPDATE_LOG_MSG */
+	uint64_t gen;	  /* generation of the update in the log */
 	List update_list; /* of type slurmdb_update_object_t *'s */
 	uint16_t rpc_version;
 } accounting_update_msg_t;
@@ -1510,6 +1523,7 @@ extern void slurm_free_reattach_tasks_response_msg(
 extern void slurm_free_kill_job_msg(kill_job_msg_t * msg);
 extern void slurm_free_job_step_kill_msg(job_step_kill_msg_t * msg);
 extern void slurm_free_epilog_complete_msg(epilog_complete_msg_t * msg);
+extern void slurm_free_composite_epilog_msg(composite_epilog_msg_t *msg);
 extern void slurm_free_srun_job_complete_msg(srun_job_complete_msg_t * msg);
 extern void slurm_free_srun_exec_msg(srun_exec_msg_t *msg);
 extern void slurm_free_srun_ping_msg(srun_ping_msg_t * msg);
@@ -2969,6 +2969,49 @@ unpack_error:
 	return SLURM_ERROR;
 }
 
+static void _pack_composite_epilog_msg(composite_epilog_msg_t *msg,
+				       buf_t *buffer,
+				       uint16_t protocol_version)
+{
+	xassert(msg);
+	if (protocol_version >= SLURM_21_08_PROTOCOL_VERSION) {
+		pack32_array(msg->job_id, msg->job_cnt, buffer);
+		pack32_array(msg->return_code, msg->job_cnt, buffer);
+		packstr(msg->node_name, buffer);
+	}
+}
+
+static int _unpack_composite_epilog_msg(composite_epilog_msg_t **msg,
+					buf_t *buffer,
+					uint16_t protocol_version)
+{
+	composite_epilog_msg_t *tmp_ptr;
+	uint32_t uint32_tmp;
+
+	xassert(msg);
+	tmp_ptr = xmalloc(sizeof(composite_epilog_msg_t));
+	*msg = tmp_ptr;
+
+	if (protocol_version >= SLURM_21_08_PROTOCOL_VERSION) {
+		safe_unpack32_array(&tmp_ptr->job_id, &tmp_ptr->job_cnt,
+				    buffer);
+		safe_unpack32_array(&tmp_ptr->return_code, &uint32_tmp,
+				    buffer);
+		if (uint32_tmp != tmp_ptr->job_cnt)
+			goto unpack_error;
+		safe_unpackstr_xmalloc(&tmp_ptr->node_name, &uint32_tmp,
+				       buffer);
+	} else
+		goto unpack_error;
+
+	return SLURM_SUCCESS;
+
+unpack_error:
+	slurm_free_composite_epilog_msg(tmp_ptr);
+	*msg = NULL;
+	return SLURM_ERROR;
+}
+
 extern void _pack_job_step_create_response_msg(
 	job_step_create_response_msg_t *msg, buf_t *buffer,
 	uint16_t protocol_version)
@@ -12483,6 +12526,45 @@ unpack_error:
 	return SLURM_ERROR;
 }
 
+/*
+ * Same as ACCOUNTING_UPDATE_MSG, followed by the position of the update in
+ * the update log of the slurmdbd. Only sent to a slurmctld that asked for
+ * updates from that log, so older peers never see it.
+ */
+static void _pack_accounting_update_log_msg(accounting_update_msg_t *msg,
+					    buf_t *buffer,
+					    uint16_t protocol_version)
+{
+	_pack_accounting_update_msg(msg, buffer, protocol_version);
+
+	if (protocol_version >= SLURM_MIN_PROTOCOL_VERSION) {
+		pack32(msg->epoch, buffer);
+		pack64(msg->gen, buffer);
+	}
+}
+
+static int _unpack_accounting_update_log_msg(accounting_update_msg_t **msg,
+					     buf_t *buffer,
+					     uint16_t protocol_version)
+{
+	accounting_update_msg_t *msg_ptr;
+
+	if (_unpack_accounting_update_msg(msg, buffer, protocol_version) !=
+	    SLURM_SUCCESS)
+		return SLURM_ERROR;
+	msg_ptr = *msg;
+
+	safe_unpack32(&msg_ptr->epoch, buffer);
+	safe_unpack64(&msg_ptr->gen, buffer);
+
+	return SLURM_SUCCESS;
+
+unpack_error:
+	slurm_free_accounting_update_msg(msg_ptr);
+	*msg = NULL;
+	return SLURM_ERROR;
+}
+
 static void _pack_topo_info_msg(topo_info_response_msg_t *msg, buf_t *buffer,
 				uint16_t protocol_version)
 {
@@ -13558,6 +13640,10 @@ pack_msg(slurm_msg_t const *msg, buf_t *buffer)
 				      buffer,
 				      msg->protocol_version);
 		break;
+	case MESSAGE_COMPOSITE_EPILOG_COMPLETE:
+		_pack_composite_epilog_msg(msg->data, buffer,
+					   msg->protocol_version);
+		break;
 	case RESPONSE_JOB_STEP_INFO:
 		_pack_job_step_info_msg((slurm_msg_t *) msg, buffer);
 		break;
@@ -13766,6 +13852,12 @@ pack_msg(slurm_msg_t const *msg, buf_t *buffer)
 			buffer,
 			msg->protocol_version);
 		break;
+	case ACCOUNTING_UPDATE_LOG_MSG:
+		_pack_accounting_update_log_msg(
+			(accounting_update_msg_t *)msg->data,
+			buffer,
+			msg->protocol_version);
+		break;
 	case RESPONSE_TOPO_INFO:
 		_pack_topo_info_msg(
 			(topo_info_response_msg_t *)msg->data, buffer,
@@ -14216,6 +14308,11 @@ unpack_msg(slurm_msg_t * msg, buf_t *buffer)
 					     & (msg->data), buffer,
 					     msg->protocol_version);
 		break;
+	case MESSAGE_COMPOSITE_EPILOG_COMPLETE:
+		rc = _unpack_composite_epilog_msg(
+			(composite_epilog_msg_t **) &msg->data, buffer,
+			msg->protocol_version);
+		break;
 	case RESPONSE_JOB_STEP_INFO:
 		rc = _unpack_job_step_info_response_msg(
 			(job_step_info_response_msg_t **)
@@ -14449,6 +14546,12 @@ unpack_msg(slurm_msg_t * msg, buf_t *buffer)
 			buffer,
 			msg->protocol_version);
 		break;
+	case ACCOUNTING_UPDATE_LOG_MSG:
+		rc = _unpack_accounting_update_log_msg(
+			(accounting_update_msg_t **)&msg->data,
+			buffer,
+			msg->protocol_version);
+		break;
 	case RESPONSE_TOPO_INFO:
 		rc = _unpack_topo_info_msg(
 			(topo_info_response_msg_t **)&msg->data, buffer,
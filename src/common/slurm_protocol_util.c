@@ -125,6 +125,7 @@ void init_header(header_t *header, slurm_msg_t *msg, uint16_t flags)
 		msg->protocol_version = header->version =
 			working_cluster_rec->rpc_version;
 	else if ((msg->msg_type == ACCOUNTING_UPDATE_MSG) ||
+		 (msg->msg_type == ACCOUNTING_UPDATE_LOG_MSG) ||
 	         (msg->msg_type == ACCOUNTING_FIRST_REG)) {
 		uint16_t rpc_version =
 			((accounting_update_msg_t *)msg->data)->rpc_version;
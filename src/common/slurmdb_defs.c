@@ -3017,11 +3017,14 @@ end_it:
  * IN host: control host of cluster
  * IN port: control port of cluster
  * IN rpc_version: rpc version of cluster
+ * IN epoch: update log of the slurmdbd the updates are from, 0 if none
+ * IN gen: generation of the updates in that log
  * RET:  error code
  */
 extern int slurmdb_send_accounting_update(List update_list, char *cluster,
 					  char *host, uint16_t port,
-					  uint16_t rpc_version)
+					  uint16_t rpc_version,
+					  uint32_t epoch, uint64_t gen)
 {
 	accounting_update_msg_t msg;
 	slurm_msg_t req;
@@ -3034,6 +3037,8 @@ extern int slurmdb_send_accounting_update(List update_list, char *cluster,
 	}
 	memset(&msg, 0, sizeof(accounting_update_msg_t));
 	msg.rpc_version = rpc_version;
+	msg.epoch = epoch;
+	msg.gen = gen;
 	msg.update_list = update_list;
 
 	debug("sending updates to %s at %s(%hu) ver %hu",
@@ -3044,7 +3049,11 @@ extern int slurmdb_send_accounting_update(List update_list, char *cluster,
 
 	req.protocol_version = rpc_version;
 
-	req.msg_type = ACCOUNTING_UPDATE_MSG;
+	/* Only a slurmctld that asked for the update log knows epoch/gen */
+	if (epoch)
+		req.msg_type = ACCOUNTING_UPDATE_LOG_MSG;
+	else
+		req.msg_type = ACCOUNTING_UPDATE_MSG;
 	if (slurmdbd_conf)
 		req.flags = SLURM_GLOBAL_AUTH_KEY;
 	req.data = &msg;
@@ -0,0 +1,1340 @@
+/*****************************************************************************\
+ *  slurmdb_export.c - columnar export of job accounting records
+ *****************************************************************************
+ *  Copyright (C) 2021 SchedMD LLC.
+ *
+ *  This file is part of Slurm, a resource management program.
+ *  For details, see <https://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  Slurm is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  Slurm is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with Slurm; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+/*
+ * File layout, all integers in network byte order:
+ *
+ *   header:	magic, protocol version, job column types, step column types
+ *   row group:	size, job count, step count, string dictionary, columns
+ *   ...
+ *   index:	offset and time range of each row group, TRES and QOS tables
+ *   trailer:	offset of the index, magic
+ *
+ * Each column is preceded by its size so a reader can skip the columns it
+ * does not know. Columns are only ever appended to the tables below, never
+ * reordered.
+ */
+
+#include "config.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "src/common/fd.h"
+#include "src/common/hostlist.h"
+#include "src/common/log.h"
+#include "src/common/pack.h"
+#include "src/common/slurm_protocol_defs.h"
+#include "src/common/slurm_protocol_pack.h"
+#include "src/common/slurmdb_defs.h"
+#include "src/common/slurmdb_export.h"
+#include "src/common/slurmdb_pack.h"
+#include "src/common/timers.h"
+#include "src/common/xhash.h"
+#include "src/common/xmalloc.h"
+#include "src/common/xstring.h"
+
+#define EXPORT_MAGIC		0x534c4a58	/* "SLJX" */
+#define EXPORT_ROW_GROUP	1024		/* max jobs in a row group */
+#define EXPORT_MAX_THREADS	16
+#define EXPORT_MAX_TRES		64		/* else stored as a string */
+#define EXPORT_TRAILER_SIZE	12
+
+typedef enum {
+	EXPORT_UINT16,
+	EXPORT_UINT32,
+	EXPORT_UINT64,
+	EXPORT_TIME,
+	EXPORT_DOUBLE,
+	EXPORT_STR,	/* index in the row group dictionary */
+	EXPORT_TRES,	/* id=count pairs of a TRES string */
+} export_type_t;
+
+typedef struct {
+	uint16_t type;
+	size_t offset;
+} export_col_t;
+
+#define JOB_COL(t, f) { EXPORT_##t, offsetof(slurmdb_job_rec_t, f) }
+#define STEP_COL(t, f) { EXPORT_##t, offsetof(slurmdb_step_rec_t, f) }
+#define STATS_COLS(C)					\
+	C(DOUBLE, stats.act_cpufreq),			\
+	C(UINT64, stats.consumed_energy),		\
+	C(TRES, stats.tres_usage_in_ave),		\
+	C(TRES, stats.tres_usage_in_max),		\
+	C(TRES, stats.tres_usage_in_max_nodeid),	\
+	C(TRES, stats.tres_usage_in_max_taskid),	\
+	C(TRES, stats.tres_usage_in_min),		\
+	C(TRES, stats.tres_usage_in_min_nodeid),	\
+	C(TRES, stats.tres_usage_in_min_taskid),	\
+	C(TRES, stats.tres_usage_in_tot),		\
+	C(TRES, stats.tres_usage_out_ave),		\
+	C(TRES, stats.tres_usage_out_max),		\
+	C(TRES, stats.tres_usage_out_max_nodeid),	\
+	C(TRES, stats.tres_usage_out_max_taskid),	\
+	C(TRES, stats.tres_usage_out_min),		\
+	C(TRES, stats.tres_usage_out_min_nodeid),	\
+	C(TRES, stats.tres_usage_out_min_taskid),	\
+	C(TRES, stats.tres_usage_out_tot)
+
+static const export_col_t job_cols[] = {
+	JOB_COL(STR, account),
+	JOB_COL(STR, admin_comment),
+	JOB_COL(UINT32, alloc_nodes),
+	JOB_COL(UINT32, array_job_id),
+	JOB_COL(UINT32, array_max_tasks),
+	JOB_COL(UINT32, array_task_id),
+	JOB_COL(STR, array_task_str),
+	JOB_COL(UINT32, associd),
+	JOB_COL(STR, blockid),
+	JOB_COL(STR, cluster),
+	JOB_COL(STR, constraints),
+	JOB_COL(STR, container),
+	JOB_COL(UINT64, db_index),
+	JOB_COL(UINT32, derived_ec),
+	JOB_COL(STR, derived_es),
+	JOB_COL(UINT32, elapsed),
+	JOB_COL(TIME, eligible),
+	JOB_COL(TIME, end),
+	JOB_COL(STR, env),
+	JOB_COL(UINT32, exitcode),
+	JOB_COL(UINT32, flags),
+	JOB_COL(UINT32, gid),
+	JOB_COL(UINT32, het_job_id),
+	JOB_COL(UINT32, het_job_offset),
+	JOB_COL(UINT32, jobid),
+	JOB_COL(STR, jobname),
+	JOB_COL(UINT32, lft),
+	JOB_COL(STR, mcs_label),
+	JOB_COL(STR, nodes),
+	JOB_COL(STR, partition),
+	JOB_COL(UINT32, priority),
+	JOB_COL(UINT32, qosid),
+	JOB_COL(UINT32, req_cpus),
+	JOB_COL(UINT64, req_mem),
+	JOB_COL(UINT32, requid),
+	JOB_COL(UINT32, resvid),
+	JOB_COL(STR, resv_name),
+	JOB_COL(STR, script),
+	JOB_COL(UINT32, show_full),
+	JOB_COL(TIME, start),
+	JOB_COL(UINT32, state),
+	JOB_COL(UINT32, state_reason_prev),
+	STATS_COLS(JOB_COL),
+	JOB_COL(TIME, submit),
+	JOB_COL(STR, submit_line),
+	JOB_COL(UINT32, suspended),
+	JOB_COL(STR, system_comment),
+	JOB_COL(UINT64, sys_cpu_sec),
+	JOB_COL(UINT64, sys_cpu_usec),
+	JOB_COL(UINT32, timelimit),
+	JOB_COL(UINT64, tot_cpu_sec),
+	JOB_COL(UINT64, tot_cpu_usec),
+	JOB_COL(UINT16, track_steps),
+	JOB_COL(TRES, tres_alloc_str),
+	JOB_COL(TRES, tres_req_str),
+	JOB_COL(UINT32, uid),
+	JOB_COL(STR, used_gres),
+	JOB_COL(STR, user),
+	JOB_COL(UINT64, user_cpu_sec),
+	JOB_COL(UINT64, user_cpu_usec),
+	JOB_COL(STR, wckey),
+	JOB_COL(UINT32, wckeyid),
+	JOB_COL(STR, work_dir),
+};
+
+static const export_col_t step_cols[] = {
+	STEP_COL(STR, container),
+	STEP_COL(UINT32, elapsed),
+	STEP_COL(TIME, end),
+	STEP_COL(UINT32, exitcode),
+	STEP_COL(UINT32, nnodes),
+	STEP_COL(STR, nodes),
+	STEP_COL(UINT32, ntasks),
+	STEP_COL(STR, pid_str),
+	STEP_COL(UINT32, req_cpufreq_min),
+	STEP_COL(UINT32, req_cpufreq_max),
+	STEP_COL(UINT32, req_cpufreq_gov),
+	STEP_COL(UINT32, requid),
+	STEP_COL(TIME, start),
+	STEP_COL(UINT32, state),
+	STATS_COLS(STEP_COL),
+	STEP_COL(UINT32, step_id.job_id),
+	STEP_COL(UINT32, step_id.step_het_comp),
+	STEP_COL(UINT32, step_id.step_id),
+	STEP_COL(STR, stepname),
+	STEP_COL(STR, submit_line),
+	STEP_COL(UINT32, suspended),
+	STEP_COL(UINT64, sys_cpu_sec),
+	STEP_COL(UINT32, sys_cpu_usec),
+	STEP_COL(UINT32, task_dist),
+	STEP_COL(UINT64, tot_cpu_sec),
+	STEP_COL(UINT32, tot_cpu_usec),
+	STEP_COL(TRES, tres_alloc_str),
+	STEP_COL(UINT64, user_cpu_sec),
+	STEP_COL(UINT32, user_cpu_usec),
+};
+
+#define JOB_COL_CNT (sizeof(job_cols) / sizeof(job_cols[0]))
+#define STEP_COL_CNT (sizeof(step_cols) / sizeof(step_cols[0]))
+
+/* Index entry of a row group */
+typedef struct {
+	uint64_t offset;
+	uint32_t jobs;
+	time_t min_time;	/* earliest submit, eligible, start or end,
+				 * 0 if none is set */
+	time_t max_end;		/* latest end */
+	bool running;		/* some jobs have no end */
+} export_rg_t;
+
+struct slurmdb_export {
+	char *file;
+	int fd;
+	uint64_t offset;
+	export_rg_t *rgs;
+	uint32_t rg_cnt;
+};
+
+/* String dictionary of a row group being written */
+typedef struct {
+	char *str;
+	uint32_t inx;
+} export_str_t;
+
+typedef struct {
+	xhash_t *hash;
+	char **strs;
+	uint32_t cnt;
+} export_dict_t;
+
+/* Memory mapped export file */
+struct slurmdb_export_file {
+	char *data;
+	size_t size;
+	uint32_t job_col_cnt;
+	uint32_t step_col_cnt;
+	export_rg_t *rgs;
+	uint32_t rg_cnt;
+};
+
+/* State shared by the threads decoding the row groups */
+typedef struct {
+	slurmdb_export_file_t *ef;
+	slurmdb_job_cond_t *job_cond;
+	List *rg_jobs;		/* jobs of each row group */
+	uint32_t next_rg;
+	int rc;
+	pthread_mutex_t mutex;
+} export_load_t;
+
+static void _pack_varint(uint64_t val, buf_t *buffer)
+{
+	uint8_t bytes[10];
+	int i = 0;
+
+	while (val >= 0x80) {
+		bytes[i++] = (val & 0x7f) | 0x80;
+		val >>= 7;
+	}
+	bytes[i++] = val;
+	packmem_array((char *) bytes, i, buffer);
+}
+
+static int _unpack_varint(uint64_t *valp, buf_t *buffer)
+{
+	uint64_t val = 0;
+	uint8_t byte;
+	int shift;
+
+	for (shift = 0; shift < 64; shift += 7) {
+		if (!remaining_buf(buffer))
+			return SLURM_ERROR;
+		byte = buffer->head[buffer->processed++];
+		val |= (uint64_t) (byte & 0x7f) << shift;
+		if (!(byte & 0x80)) {
+			*valp = val;
+			return SLURM_SUCCESS;
+		}
+	}
+
+	return SLURM_ERROR;
+}
+
+/*
+ * Consecutive values of a column are mostly close to each other (ids, times)
+ * or equal (flags, NO_VAL). Store the zigzag encoded difference to the
+ * previous value so they take one or two bytes.
+ */
+static void _pack_delta(uint64_t val, uint64_t *prev, buf_t *buffer)
+{
+	int64_t delta = (int64_t) (val - *prev);
+
+	*prev = val;
+	_pack_varint(((uint64_t) delta << 1) ^ (uint64_t) (delta >> 63),
+		     buffer);
+}
+
+static int _unpack_delta(uint64_t *valp, uint64_t *prev, buf_t *buffer)
+{
+	uint64_t zigzag;
+
+	if (_unpack_varint(&zigzag, buffer))
+		return SLURM_ERROR;
+
+	*prev += (zigzag >> 1) ^ -(zigzag & 1);
+	*valp = *prev;
+	return SLURM_SUCCESS;
+}
+
+static void _dict_str_id(void *item, const char **key, uint32_t *key_len)
+{
+	export_str_t *str = item;
+
+	*key = str->str;
+	*key_len = strlen(str->str);
+}
+
+/* Pack the dictionary index of a string, 0 being NULL */
+static void _pack_dict_str(char *str, export_dict_t *dict, buf_t *buffer)
+{
+	export_str_t *ent;
+
+	if (!str) {
+		_pack_varint(0, buffer);
+		return;
+	}
+
+	if (!(ent = xhash_get(dict->hash, str, strlen(str)))) {
+		ent = xmalloc(sizeof(*ent));
+		ent->str = str;
+		ent->inx = dict->cnt;
+		xhash_add(dict->hash, ent);
+		if (!(dict->cnt % 64))
+			xrecalloc(dict->strs, dict->cnt + 64, sizeof(char *));
+		dict->strs[dict->cnt++] = str;
+	}
+	_pack_varint(ent->inx + 1, buffer);
+}
+
+/*
+ * Pack a TRES string ("id=count,id=count") as its count of pairs + 2 followed
+ * by the pairs. 0 is NULL, and 1 a string which would not be rendered back
+ * the same way, kept in the dictionary.
+ */
+static void _pack_tres(char *str, export_dict_t *dict, buf_t *buffer)
+{
+	uint64_t ids[EXPORT_MAX_TRES], counts[EXPORT_MAX_TRES];
+	char *p = str, *end;
+	int cnt = 0;
+
+	if (!str) {
+		_pack_varint(0, buffer);
+		return;
+	}
+
+	while (*p) {
+		if (cnt == EXPORT_MAX_TRES)
+			goto fallback;
+		/* only accept what "%u=%"PRIu64 would have printed */
+		if (!isdigit((int) p[0]) ||
+		    ((p[0] == '0') && isdigit((int) p[1])))
+			goto fallback;
+		errno = 0;
+		ids[cnt] = strtoull(p, &end, 10);
+		if (errno || (ids[cnt] > UINT32_MAX) || (*end != '='))
+			goto fallback;
+		p = end + 1;
+		if (!isdigit((int) p[0]) ||
+		    ((p[0] == '0') && isdigit((int) p[1])))
+			goto fallback;
+		counts[cnt] = strtoull(p, &end, 10);
+		if (errno || ((*end != ',') && *end) ||
+		    ((*end == ',') && !end[1]))
+			goto fallback;
+		p = (*end == ',') ? end + 1 : end;
+		cnt++;
+	}
+
+	_pack_varint(cnt + 2, buffer);
+	for (int i = 0; i < cnt; i++) {
+		_pack_varint(ids[i], buffer);
+		_pack_varint(counts[i], buffer);
+	}
+	return;
+
+fallback:
+	_pack_varint(1, buffer);
+	_pack_dict_str(str, dict, buffer);
+}
+
+static void _pack_cols(const export_col_t *cols, int col_cnt, void **recs,
+		       uint32_t rec_cnt, export_dict_t *dict, buf_t *buffer)
+{
+	for (int c = 0; c < col_cnt; c++) {
+		uint32_t size_offset = get_buf_offset(buffer), end_offset;
+		uint64_t prev = 0;
+
+		pack32(0, buffer);
+		for (uint32_t r = 0; r < rec_cnt; r++) {
+			void *ptr = (char *) recs[r] + cols[c].offset;
+
+			switch (cols[c].type) {
+			case EXPORT_UINT16:
+				_pack_delta(*(uint16_t *) ptr, &prev, buffer);
+				break;
+			case EXPORT_UINT32:
+				_pack_delta(*(uint32_t *) ptr, &prev, buffer);
+				break;
+			case EXPORT_UINT64:
+				_pack_delta(*(uint64_t *) ptr, &prev, buffer);
+				break;
+			case EXPORT_TIME:
+				_pack_delta(*(time_t *) ptr, &prev, buffer);
+				break;
+			case EXPORT_DOUBLE:
+				packdouble(*(double *) ptr, buffer);
+				break;
+			case EXPORT_STR:
+				_pack_dict_str(*(char **) ptr, dict, buffer);
+				break;
+			case EXPORT_TRES:
+				_pack_tres(*(char **) ptr, dict, buffer);
+				break;
+			}
+		}
+
+		end_offset = get_buf_offset(buffer);
+		set_buf_offset(buffer, size_offset);
+		pack32(end_offset - size_offset - sizeof(uint32_t), buffer);
+		set_buf_offset(buffer, end_offset);
+	}
+}
+
+static void _pack_col_types(const export_col_t *cols, int col_cnt,
+			    buf_t *buffer)
+{
+	pack32(col_cnt, buffer);
+	for (int c = 0; c < col_cnt; c++)
+		pack16(cols[c].type, buffer);
+}
+
+static int _write_buf(slurmdb_export_t *exp, buf_t *buffer)
+{
+	char *data = get_buf_data(buffer);
+	uint32_t size = get_buf_offset(buffer);
+
+	safe_write(exp->fd, data, size);
+	exp->offset += size;
+	return SLURM_SUCCESS;
+
+rwfail:
+	error("%s: write to %s failed: %m", __func__, exp->file);
+	return SLURM_ERROR;
+}
+
+extern slurmdb_export_t *slurmdb_export_create(const char *file)
+{
+	slurmdb_export_t *exp;
+	buf_t *buffer;
+	int rc;
+
+	exp = xmalloc(sizeof(*exp));
+	exp->file = xstrdup(file);
+	if ((exp->fd = open(file, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+			    0644)) < 0) {
+		error("%s: could not create %s: %m", __func__, file);
+		xfree(exp->file);
+		xfree(exp);
+		return NULL;
+	}
+
+	buffer = init_buf(BUF_SIZE);
+	pack32(EXPORT_MAGIC, buffer);
+	pack16(SLURM_PROTOCOL_VERSION, buffer);
+	_pack_col_types(job_cols, JOB_COL_CNT, buffer);
+	_pack_col_types(step_cols, STEP_COL_CNT, buffer);
+	rc = _write_buf(exp, buffer);
+	FREE_NULL_BUFFER(buffer);
+
+	if (rc != SLURM_SUCCESS) {
+		slurmdb_export_destroy(exp);
+		return NULL;
+	}
+
+	return exp;
+}
+
+static int _add_row_group(slurmdb_export_t *exp, slurmdb_job_rec_t **jobs,
+			  uint32_t job_cnt)
+{
+	export_dict_t dict = { 0 };
+	export_rg_t *rg;
+	void **steps = NULL;
+	uint32_t step_cnt = 0, *step_counts;
+	buf_t *cols, *buffer;
+	uint64_t prev = 0;
+	uint32_t size;
+	int rc;
+
+	if (!(exp->rg_cnt % 64))
+		xrecalloc(exp->rgs, exp->rg_cnt + 64, sizeof(export_rg_t));
+	rg = &exp->rgs[exp->rg_cnt];
+	rg->offset = exp->offset;
+	rg->jobs = job_cnt;
+
+	step_counts = xcalloc(job_cnt, sizeof(uint32_t));
+	for (uint32_t i = 0; i < job_cnt; i++) {
+		slurmdb_job_rec_t *job = jobs[i];
+		time_t times[] = { job->submit, job->eligible, job->start,
+				   job->end };
+
+		for (int t = 0; t < ARRAY_SIZE(times); t++)
+			if (times[t] &&
+			    (!rg->min_time || (times[t] < rg->min_time)))
+				rg->min_time = times[t];
+		if (!job->end)
+			rg->running = true;
+		else if (job->end > rg->max_end)
+			rg->max_end = job->end;
+
+		if (job->steps)
+			step_counts[i] = list_count(job->steps);
+		step_cnt += step_counts[i];
+	}
+
+	steps = xcalloc(step_cnt, sizeof(void *));
+	step_cnt = 0;
+	for (uint32_t i = 0; i < job_cnt; i++) {
+		slurmdb_step_rec_t *step;
+		ListIterator itr;
+
+		if (!step_counts[i])
+			continue;
+		itr = list_iterator_create(jobs[i]->steps);
+		while ((step = list_next(itr)))
+			steps[step_cnt++] = step;
+		list_iterator_destroy(itr);
+	}
+
+	dict.hash = xhash_init(_dict_str_id, xfree_ptr);
+	cols = init_buf(BUF_SIZE);
+	for (uint32_t i = 0; i < job_cnt; i++)
+		_pack_delta(step_counts[i], &prev, cols);
+	_pack_cols(job_cols, JOB_COL_CNT, (void **) jobs, job_cnt, &dict, cols);
+	_pack_cols(step_cols, STEP_COL_CNT, steps, step_cnt, &dict, cols);
+
+	buffer = init_buf(get_buf_offset(cols) + BUF_SIZE);
+	pack32(0, buffer);
+	pack32(job_cnt, buffer);
+	pack32(step_cnt, buffer);
+	pack32(dict.cnt, buffer);
+	for (uint32_t i = 0; i < dict.cnt; i++)
+		packstr(dict.strs[i], buffer);
+	packmem_array(get_buf_data(cols), get_buf_offset(cols), buffer);
+	size = get_buf_offset(buffer);
+	set_buf_offset(buffer, 0);
+	pack32(size - sizeof(uint32_t), buffer);
+	set_buf_offset(buffer, size);
+
+	if ((rc = _write_buf(exp, buffer)) == SLURM_SUCCESS)
+		exp->rg_cnt++;
+
+	FREE_NULL_BUFFER(buffer);
+	FREE_NULL_BUFFER(cols);
+	xhash_free(dict.hash);
+	xfree(dict.strs);
+	xfree(steps);
+	xfree(step_counts);
+
+	return rc;
+}
+
+extern int slurmdb_export_add_jobs(slurmdb_export_t *exp, List jobs)
+{
+	slurmdb_job_rec_t *rg_jobs[EXPORT_ROW_GROUP];
+	slurmdb_job_rec_t *job;
+	ListIterator itr;
+	uint32_t cnt = 0;
+	int rc = SLURM_SUCCESS;
+
+	xassert(exp);
+
+	if (!jobs)
+		return SLURM_SUCCESS;
+
+	itr = list_iterator_create(jobs);
+	while ((job = list_next(itr))) {
+		rg_jobs[cnt++] = job;
+		if (cnt < EXPORT_ROW_GROUP)
+			continue;
+		if ((rc = _add_row_group(exp, rg_jobs, cnt)))
+			break;
+		cnt = 0;
+	}
+	list_iterator_destroy(itr);
+
+	if (!rc && cnt)
+		rc = _add_row_group(exp, rg_jobs, cnt);
+
+	return rc;
+}
+
+extern int slurmdb_export_finish(slurmdb_export_t *exp, List tres_list,
+				 List qos_list)
+{
+	buf_t *buffer;
+	uint64_t index_offset = exp->offset;
+	int rc;
+
+	xassert(exp);
+
+	buffer = init_buf(BUF_SIZE);
+	pack32(exp->rg_cnt, buffer);
+	for (uint32_t i = 0; i < exp->rg_cnt; i++) {
+		pack64(exp->rgs[i].offset, buffer);
+		pack32(exp->rgs[i].jobs, buffer);
+		pack_time(exp->rgs[i].min_time, buffer);
+		pack_time(exp->rgs[i].max_end, buffer);
+		packbool(exp->rgs[i].running, buffer);
+	}
+	slurm_pack_list(tres_list, slurmdb_pack_tres_rec, buffer,
+			SLURM_PROTOCOL_VERSION);
+	slurm_pack_list(qos_list, slurmdb_pack_qos_rec, buffer,
+			SLURM_PROTOCOL_VERSION);
+	pack64(index_offset, buffer);
+	pack32(EXPORT_MAGIC, buffer);
+
+	if ((rc = _write_buf(exp, buffer)) == SLURM_SUCCESS) {
+		if (fsync_and_close(exp->fd, "export"))
+			rc = SLURM_ERROR;
+		exp->fd = -1;
+	}
+	FREE_NULL_BUFFER(buffer);
+
+	if (rc != SLURM_SUCCESS) {
+		slurmdb_export_destroy(exp);
+		return rc;
+	}
+
+	xfree(exp->rgs);
+	xfree(exp->file);
+	xfree(exp);
+	return rc;
+}
+
+extern void slurmdb_export_destroy(slurmdb_export_t *exp)
+{
+	if (!exp)
+		return;
+
+	if (exp->fd >= 0)
+		close(exp->fd);
+	if (exp->file && (unlink(exp->file) < 0) && (errno != ENOENT))
+		error("%s: unable to remove %s: %m", __func__, exp->file);
+	xfree(exp->rgs);
+	xfree(exp->file);
+	xfree(exp);
+}
+
+/* Read-only buffer over part of the mapped file */
+static void _map_buf(buf_t *buffer, char *data, uint32_t size)
+{
+	buffer->magic = BUF_MAGIC;
+	buffer->head = data;
+	buffer->size = size;
+	buffer->processed = 0;
+	buffer->mmaped = false;
+}
+
+static int _unpack_col_types(const export_col_t *cols, uint32_t col_cnt,
+			     uint32_t *file_col_cnt, buf_t *buffer)
+{
+	uint16_t type;
+
+	safe_unpack32(file_col_cnt, buffer);
+	for (uint32_t c = 0; c < *file_col_cnt; c++) {
+		safe_unpack16(&type, buffer);
+		if ((c < col_cnt) && (type != cols[c].type))
+			goto unpack_error;
+	}
+	return SLURM_SUCCESS;
+
+unpack_error:
+	return SLURM_ERROR;
+}
+
+static int _unpack_dict_str(char **valp, char **strs, uint32_t str_cnt,
+			    buf_t *buffer)
+{
+	uint64_t inx;
+
+	if (_unpack_varint(&inx, buffer) || (inx > str_cnt))
+		return SLURM_ERROR;
+
+	*valp = inx ? xstrdup(strs[inx - 1]) : NULL;
+	return SLURM_SUCCESS;
+}
+
+static int _unpack_tres(char **valp, char **strs, uint32_t str_cnt,
+			buf_t *buffer)
+{
+	char *str = NULL, *pos = NULL, *sep = "";
+	uint64_t cnt, id, count;
+
+	*valp = NULL;
+	if (_unpack_varint(&cnt, buffer))
+		return SLURM_ERROR;
+
+	if (!cnt)
+		return SLURM_SUCCESS;
+	if (cnt == 1)
+		return _unpack_dict_str(valp, strs, str_cnt, buffer);
+
+	str = xstrdup("");
+	for (cnt -= 2; cnt > 0; cnt--) {
+		if (_unpack_varint(&id, buffer) ||
+		    _unpack_varint(&count, buffer)) {
+			xfree(str);
+			return SLURM_ERROR;
+		}
+		xstrfmtcatat(str, &pos, "%s%"PRIu64"=%"PRIu64, sep, id, count);
+		sep = ",";
+	}
+	*valp = str;
+	return SLURM_SUCCESS;
+}
+
+static int _unpack_cols(const export_col_t *cols, uint32_t col_cnt,
+			uint32_t file_col_cnt, void **recs, uint32_t rec_cnt,
+			char **strs, uint32_t str_cnt, buf_t *buffer)
+{
+	for (uint32_t c = 0; c < file_col_cnt; c++) {
+		uint64_t prev = 0, val;
+		uint32_t size;
+		buf_t col;
+
+		safe_unpack32(&size, buffer);
+		if (size > remaining_buf(buffer))
+			goto unpack_error;
+		_map_buf(&col, get_buf_data(buffer) + get_buf_offset(buffer),
+			 size);
+		buffer->processed += size;
+
+		/* a column added after this version of Slurm */
+		if (c >= col_cnt)
+			continue;
+
+		for (uint32_t r = 0; r < rec_cnt; r++) {
+			void *ptr = (char *) recs[r] + cols[c].offset;
+
+			switch (cols[c].type) {
+			case EXPORT_UINT16:
+			case EXPORT_UINT32:
+			case EXPORT_UINT64:
+			case EXPORT_TIME:
+				if (_unpack_delta(&val, &prev, &col))
+					goto unpack_error;
+				if (cols[c].type == EXPORT_UINT16)
+					*(uint16_t *) ptr = val;
+				else if (cols[c].type == EXPORT_UINT32)
+					*(uint32_t *) ptr = val;
+				else if (cols[c].type == EXPORT_UINT64)
+					*(uint64_t *) ptr = val;
+				else
+					*(time_t *) ptr = val;
+				break;
+			case EXPORT_DOUBLE:
+				safe_unpackdouble((double *) ptr, &col);
+				break;
+			case EXPORT_STR:
+				if (_unpack_dict_str(ptr, strs, str_cnt, &col))
+					goto unpack_error;
+				break;
+			case EXPORT_TRES:
+				if (_unpack_tres(ptr, strs, str_cnt, &col))
+					goto unpack_error;
+				break;
+			}
+		}
+	}
+	return SLURM_SUCCESS;
+
+unpack_error:
+	return SLURM_ERROR;
+}
+
+static bool _match_str(List list, char *str)
+{
+	if (!list || !list_count(list))
+		return true;
+	return list_find_first(list, slurm_find_char_in_list, str);
+}
+
+static bool _match_uint(List list, uint32_t val)
+{
+	char str[16];
+
+	if (!list || !list_count(list))
+		return true;
+	snprintf(str, sizeof(str), "%u", val);
+	return list_find_first(list, slurm_find_char_in_list, str);
+}
+
+static bool _match_range(uint32_t val, uint32_t min, uint32_t max)
+{
+	if (!min)
+		return true;
+	if (max)
+		return ((val >= min) && (val <= max));
+	return (val == min);
+}
+
+static int _match_selected_step(void *x, void *arg)
+{
+	slurm_selected_step_t *selected_step = x;
+	slurmdb_job_rec_t *job = arg;
+	uint32_t job_id = selected_step->step_id.job_id;
+
+	if (selected_step->array_task_id != NO_VAL)
+		return ((job->array_job_id == job_id) &&
+			(job->array_task_id == selected_step->array_task_id));
+	if (selected_step->het_job_offset != NO_VAL)
+		return ((job->het_job_id == job_id) &&
+			(job->het_job_offset == selected_step->het_job_offset));
+	return ((job->jobid == job_id) || (job->het_job_id == job_id) ||
+		(job->array_job_id == job_id));
+}
+
+/* Same as _state_time_string() of the accounting_storage/mysql plugin */
+static bool _match_state_time(slurmdb_job_rec_t *job, uint32_t state,
+			      slurmdb_job_cond_t *job_cond)
+{
+	time_t usage_start = job_cond->usage_start;
+	time_t usage_end = job_cond->usage_end;
+
+	if (!usage_start && !usage_end)
+		return (job->state == state);
+
+	switch (state) {
+	case JOB_PENDING:
+		return (job->eligible &&
+			((job->start && (usage_start < job->start)) ||
+			 (!job->start && job->end &&
+			  (usage_start < job->end)) ||
+			 (!job->start && !job->end && (job->state == state))) &&
+			(usage_end > job->eligible));
+	case JOB_SUSPENDED:
+		/* The suspend periods are not exported, only their total */
+		return (job->suspended && job->start &&
+			(job->start <= (usage_end ? usage_end : usage_start)) &&
+			(!job->end || (job->end >= usage_start)));
+	case JOB_RUNNING:
+		return (job->start &&
+			((usage_start < job->end) ||
+			 (!job->end && (job->state == state))) &&
+			(usage_end > job->start));
+	default:
+		if (state >= JOB_END)
+			return (job->state == state);
+		return ((job->state == state) && job->end &&
+			(job->end >= usage_start) && (job->end <= usage_end));
+	}
+}
+
+/*
+ * Same conditions as setup_job_cond_limits() of the accounting_storage/mysql
+ * plugin, except for cpus_min and cpus_max.
+ */
+static bool _match_job(slurmdb_job_rec_t *job, slurmdb_job_cond_t *job_cond)
+{
+	ListIterator itr;
+	char *object;
+	bool match;
+
+	if (!job_cond)
+		return true;
+
+	if (!_match_str(job_cond->cluster_list, job->cluster) ||
+	    !_match_str(job_cond->acct_list, job->account) ||
+	    !_match_uint(job_cond->associd_list, job->associd) ||
+	    !_match_uint(job_cond->reason_list, job->state_reason_prev) ||
+	    !_match_uint(job_cond->userid_list, job->uid) ||
+	    !_match_uint(job_cond->groupid_list, job->gid) ||
+	    !_match_str(job_cond->jobname_list, job->jobname) ||
+	    !_match_str(job_cond->partition_list, job->partition) ||
+	    !_match_uint(job_cond->qos_list, job->qosid) ||
+	    !_match_uint(job_cond->resvid_list, job->resvid) ||
+	    !_match_str(job_cond->wckey_list, job->wckey) ||
+	    !_match_range(job->alloc_nodes, job_cond->nodes_min,
+			  job_cond->nodes_max) ||
+	    !_match_range(job->timelimit, job_cond->timelimit_min,
+			  job_cond->timelimit_max))
+		return false;
+
+	if ((job_cond->db_flags != SLURMDB_JOB_FLAG_NOTSET) &&
+	    ((job_cond->db_flags == SLURMDB_JOB_FLAG_NONE) ?
+	     (job->flags != job_cond->db_flags) :
+	     !(job->flags & job_cond->db_flags)))
+		return false;
+
+	if (job_cond->constraint_list) {
+		itr = list_iterator_create(job_cond->constraint_list);
+		while ((object = list_next(itr))) {
+			if (object[0] ? !xstrcasestr(job->constraints, object) :
+			    (job->constraints && job->constraints[0]))
+				break;
+		}
+		list_iterator_destroy(itr);
+		if (object)
+			return false;
+	}
+
+	if (job_cond->step_list && list_count(job_cond->step_list) &&
+	    !list_find_first(job_cond->step_list, _match_selected_step, job))
+		return false;
+
+	if (job_cond->used_nodes) {
+		hostset_t hs = hostset_create(job_cond->used_nodes);
+
+		match = hs && job->nodes && hostset_intersects(hs, job->nodes);
+		if (hs)
+			hostset_destroy(hs);
+		if (!match)
+			return false;
+	}
+
+	if (job_cond->state_list && list_count(job_cond->state_list)) {
+		match = false;
+		itr = list_iterator_create(job_cond->state_list);
+		while (!match && (object = list_next(itr)))
+			match = _match_state_time(job, slurm_atoul(object),
+						  job_cond);
+		list_iterator_destroy(itr);
+		return match;
+	}
+
+	/* Time window is exclusive of the end time, ie [start,end) */
+	if (job_cond->step_list && list_count(job_cond->step_list)) {
+		if (!(job_cond->flags & JOBCOND_FLAG_NO_DEFAULT_USAGE))
+			return ((job->submit < job_cond->usage_end) &&
+				((job->end >= job_cond->usage_start) ||
+				 !job->end));
+	} else if (job_cond->usage_start) {
+		if (!job_cond->usage_end)
+			return ((job->end >= job_cond->usage_start) ||
+				!job->end);
+		return (job->eligible &&
+			(job->eligible < job_cond->usage_end) &&
+			((job->end >= job_cond->usage_start) || !job->end));
+	} else if (job_cond->usage_end) {
+		return (job->eligible && (job->eligible < job_cond->usage_end));
+	}
+
+	return true;
+}
+
+static int _find_step_id(void *x, void *arg)
+{
+	slurm_selected_step_t *selected_step = x;
+	slurmdb_step_rec_t *step = arg;
+
+	return (selected_step->step_id.step_id == step->step_id.step_id);
+}
+
+/*
+ * Keep only the steps selected with job_cond->step_list, showing the job
+ * itself unless only some of its steps were selected. Same as
+ * _cluster_get_jobs() of the accounting_storage/mysql plugin.
+ */
+static void _select_steps(slurmdb_job_rec_t *job, slurmdb_job_cond_t *job_cond)
+{
+	slurm_selected_step_t *selected_step;
+	slurmdb_step_rec_t *step;
+	List step_list = NULL;
+	ListIterator itr;
+
+	job->show_full = 1;
+
+	if (job_cond->flags & JOBCOND_FLAG_NO_STEP) {
+		list_flush(job->steps);
+		job->first_step_ptr = NULL;
+		return;
+	}
+
+	if (!job_cond->step_list)
+		return;
+
+	itr = list_iterator_create(job_cond->step_list);
+	while ((selected_step = list_next(itr))) {
+		if (!_match_selected_step(selected_step, job))
+			continue;
+		if (selected_step->step_id.step_id == NO_VAL) {
+			FREE_NULL_LIST(step_list);
+			break;
+		}
+		if (!step_list)
+			step_list = list_create(NULL);
+		list_append(step_list, selected_step);
+	}
+	list_iterator_destroy(itr);
+
+	if (!step_list)
+		return;
+
+	job->show_full = 0;
+	job->first_step_ptr = NULL;
+	itr = list_iterator_create(job->steps);
+	while ((step = list_next(itr))) {
+		if (!list_find_first(step_list, _find_step_id, step))
+			list_delete_item(itr);
+		else if (!job->first_step_ptr)
+			job->first_step_ptr = step;
+	}
+	list_iterator_destroy(itr);
+	FREE_NULL_LIST(step_list);
+}
+
+/* Whether some jobs of the row group may be in the time window */
+static bool _match_row_group(export_rg_t *rg, slurmdb_job_cond_t *job_cond)
+{
+	if (!job_cond)
+		return true;
+
+	if ((job_cond->flags & JOBCOND_FLAG_NO_DEFAULT_USAGE) &&
+	    job_cond->step_list && list_count(job_cond->step_list) &&
+	    (!job_cond->state_list || !list_count(job_cond->state_list)))
+		return true;
+
+	if (job_cond->usage_start && !rg->running &&
+	    (rg->max_end < job_cond->usage_start))
+		return false;
+	if (job_cond->usage_end && rg->min_time &&
+	    (rg->min_time > job_cond->usage_end))
+		return false;
+
+	return true;
+}
+
+static List _load_row_group(slurmdb_export_file_t *ef, export_rg_t *rg,
+			    slurmdb_job_cond_t *job_cond)
+{
+	slurmdb_job_rec_t **jobs = NULL;
+	slurmdb_step_rec_t **steps = NULL;
+	char **strs = NULL;
+	uint32_t size, job_cnt, step_cnt, str_cnt, step_inx = 0, uint32_tmp;
+	uint64_t prev = 0, step_count;
+	List job_list = NULL;
+	buf_t buffer;
+
+	if (rg->offset > ef->size - sizeof(uint32_t))
+		goto unpack_error;
+	_map_buf(&buffer, ef->data + rg->offset, sizeof(uint32_t));
+	safe_unpack32(&size, &buffer);
+	if (size > ef->size - rg->offset - sizeof(uint32_t))
+		goto unpack_error;
+	_map_buf(&buffer, ef->data + rg->offset + sizeof(uint32_t), size);
+
+	safe_unpack32(&job_cnt, &buffer);
+	safe_unpack32(&step_cnt, &buffer);
+	safe_unpack32(&str_cnt, &buffer);
+	if ((job_cnt > size) || (step_cnt > size) || (str_cnt > size))
+		goto unpack_error;
+
+	strs = xcalloc(str_cnt, sizeof(char *));
+	for (uint32_t i = 0; i < str_cnt; i++) {
+		safe_unpackmem_ptr(&strs[i], &uint32_tmp, &buffer);
+		if (!uint32_tmp || strs[i][uint32_tmp - 1])
+			goto unpack_error;
+	}
+
+	job_list = list_create(slurmdb_destroy_job_rec);
+	jobs = xcalloc(job_cnt, sizeof(*jobs));
+	steps = xcalloc(step_cnt, sizeof(*steps));
+	for (uint32_t i = 0; i < job_cnt; i++) {
+		jobs[i] = xmalloc(sizeof(slurmdb_job_rec_t));
+		jobs[i]->steps = list_create(slurmdb_destroy_step_rec);
+		list_append(job_list, jobs[i]);
+
+		if (_unpack_delta(&step_count, &prev, &buffer) ||
+		    (step_count > step_cnt - step_inx))
+			goto unpack_error;
+		for (; step_count; step_count--) {
+			slurmdb_step_rec_t *step = xmalloc(sizeof(*step));
+
+			step->job_ptr = jobs[i];
+			if (!jobs[i]->first_step_ptr)
+				jobs[i]->first_step_ptr = step;
+			list_append(jobs[i]->steps, step);
+			steps[step_inx++] = step;
+		}
+	}
+	if (step_inx != step_cnt)
+		goto unpack_error;
+
+	if (_unpack_cols(job_cols, JOB_COL_CNT, ef->job_col_cnt,
+			 (void **) jobs, job_cnt, strs, str_cnt, &buffer) ||
+	    _unpack_cols(step_cols, STEP_COL_CNT, ef->step_col_cnt,
+			 (void **) steps, step_cnt, strs, str_cnt, &buffer))
+		goto unpack_error;
+
+	xfree(jobs);
+	xfree(steps);
+	xfree(strs);
+
+	if (job_cond) {
+		slurmdb_job_rec_t *job;
+		ListIterator itr = list_iterator_create(job_list);
+
+		while ((job = list_next(itr))) {
+			if (!_match_job(job, job_cond))
+				list_delete_item(itr);
+			else
+				_select_steps(job, job_cond);
+		}
+		list_iterator_destroy(itr);
+	}
+
+	return job_list;
+
+unpack_error:
+	error("%s: row group at offset %"PRIu64" is corrupted",
+	      __func__, rg->offset);
+	FREE_NULL_LIST(job_list);
+	xfree(jobs);
+	xfree(steps);
+	xfree(strs);
+	return NULL;
+}
+
+static void *_load_thread(void *arg)
+{
+	export_load_t *load = arg;
+	export_rg_t *rg;
+	List jobs;
+	uint32_t inx;
+
+	while (true) {
+		slurm_mutex_lock(&load->mutex);
+		if ((load->rc != SLURM_SUCCESS) ||
+		    (load->next_rg >= load->ef->rg_cnt)) {
+			slurm_mutex_unlock(&load->mutex);
+			break;
+		}
+		inx = load->next_rg++;
+		slurm_mutex_unlock(&load->mutex);
+
+		rg = &load->ef->rgs[inx];
+		if (!_match_row_group(rg, load->job_cond))
+			continue;
+
+		jobs = _load_row_group(load->ef, rg, load->job_cond);
+
+		slurm_mutex_lock(&load->mutex);
+		if (!jobs)
+			load->rc = SLURM_ERROR;
+		load->rg_jobs[inx] = jobs;
+		slurm_mutex_unlock(&load->mutex);
+	}
+
+	return NULL;
+}
+
+static int _load_index(slurmdb_export_file_t *ef, List *tres_list,
+		       List *qos_list)
+{
+	uint64_t index_offset;
+	uint32_t magic;
+	uint16_t protocol_version;
+	buf_t buffer;
+
+	if (ef->size < EXPORT_TRAILER_SIZE)
+		goto unpack_error;
+	_map_buf(&buffer, ef->data + ef->size - EXPORT_TRAILER_SIZE,
+		 EXPORT_TRAILER_SIZE);
+	safe_unpack64(&index_offset, &buffer);
+	safe_unpack32(&magic, &buffer);
+	if ((magic != EXPORT_MAGIC) ||
+	    (index_offset > ef->size - EXPORT_TRAILER_SIZE))
+		goto unpack_error;
+
+	_map_buf(&buffer, ef->data, MIN(index_offset, MAX_BUF_SIZE));
+	safe_unpack32(&magic, &buffer);
+	safe_unpack16(&protocol_version, &buffer);
+	if ((magic != EXPORT_MAGIC) ||
+	    (protocol_version < SLURM_MIN_PROTOCOL_VERSION))
+		goto unpack_error;
+	if (_unpack_col_types(job_cols, JOB_COL_CNT, &ef->job_col_cnt,
+			      &buffer) ||
+	    _unpack_col_types(step_cols, STEP_COL_CNT, &ef->step_col_cnt,
+			      &buffer))
+		goto unpack_error;
+
+	_map_buf(&buffer, ef->data + index_offset,
+		 ef->size - EXPORT_TRAILER_SIZE - index_offset);
+	safe_unpack32(&ef->rg_cnt, &buffer);
+	if (ef->rg_cnt > (buffer.size - buffer.processed))
+		goto unpack_error;
+	ef->rgs = xcalloc(ef->rg_cnt, sizeof(export_rg_t));
+	for (uint32_t i = 0; i < ef->rg_cnt; i++) {
+		safe_unpack64(&ef->rgs[i].offset, &buffer);
+		safe_unpack32(&ef->rgs[i].jobs, &buffer);
+		safe_unpack_time(&ef->rgs[i].min_time, &buffer);
+		safe_unpack_time(&ef->rgs[i].max_end, &buffer);
+		safe_unpackbool(&ef->rgs[i].running, &buffer);
+		if (ef->rgs[i].offset >= index_offset)
+			goto unpack_error;
+	}
+
+	if (slurm_unpack_list(tres_list, slurmdb_unpack_tres_rec,
+			      slurmdb_destroy_tres_rec, &buffer,
+			      protocol_version) ||
+	    slurm_unpack_list(qos_list, slurmdb_unpack_qos_rec,
+			      slurmdb_destroy_qos_rec, &buffer,
+			      protocol_version))
+		goto unpack_error;
+
+	/* the lists were not available when the file was written */
+	if (!*tres_list)
+		*tres_list = list_create(slurmdb_destroy_tres_rec);
+	if (!*qos_list)
+		*qos_list = list_create(slurmdb_destroy_qos_rec);
+
+	return SLURM_SUCCESS;
+
+unpack_error:
+	FREE_NULL_LIST(*tres_list);
+	return SLURM_ERROR;
+}
+
+extern slurmdb_export_file_t *slurmdb_export_open(const char *file,
+						  List *tres_list,
+						  List *qos_list)
+{
+	slurmdb_export_file_t *ef;
+	struct stat stat_buf;
+	int fd;
+
+	*tres_list = NULL;
+	*qos_list = NULL;
+
+	if ((fd = open(file, O_RDONLY | O_CLOEXEC)) < 0) {
+		error("%s: could not open %s: %m", __func__, file);
+		return NULL;
+	}
+	if (fstat(fd, &stat_buf) < 0) {
+		error("%s: could not stat %s: %m", __func__, file);
+		close(fd);
+		return NULL;
+	}
+
+	ef = xmalloc(sizeof(*ef));
+	ef->size = stat_buf.st_size;
+	ef->data = mmap(NULL, ef->size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (ef->data == MAP_FAILED) {
+		error("%s: could not mmap %s: %m", __func__, file);
+		xfree(ef);
+		return NULL;
+	}
+
+	if (_load_index(ef, tres_list, qos_list)) {
+		error("%s: %s is not a valid export file", __func__, file);
+		slurmdb_export_close(ef);
+		return NULL;
+	}
+
+	return ef;
+}
+
+extern List slurmdb_export_get_jobs(slurmdb_export_file_t *ef,
+				    slurmdb_job_cond_t *job_cond)
+{
+	export_load_t load = { 0 };
+	pthread_t *threads;
+	List jobs = NULL;
+	int thread_cnt;
+	DEF_TIMERS;
+
+	xassert(ef);
+
+	START_TIMER;
+	load.ef = ef;
+	load.job_cond = job_cond;
+	load.rg_jobs = xcalloc(ef->rg_cnt, sizeof(List));
+	slurm_mutex_init(&load.mutex);
+
+	thread_cnt = MIN(sysconf(_SC_NPROCESSORS_ONLN), EXPORT_MAX_THREADS);
+	thread_cnt = MAX(MIN(thread_cnt, ef->rg_cnt), 1);
+	threads = xcalloc(thread_cnt, sizeof(pthread_t));
+	for (int i = 0; i < thread_cnt; i++)
+		slurm_thread_create(&threads[i], _load_thread, &load);
+	for (int i = 0; i < thread_cnt; i++)
+		pthread_join(threads[i], NULL);
+	xfree(threads);
+	slurm_mutex_destroy(&load.mutex);
+
+	if (load.rc == SLURM_SUCCESS)
+		jobs = list_create(slurmdb_destroy_job_rec);
+	for (uint32_t i = 0; i < ef->rg_cnt; i++) {
+		if (jobs && load.rg_jobs[i])
+			list_transfer(jobs, load.rg_jobs[i]);
+		FREE_NULL_LIST(load.rg_jobs[i]);
+	}
+	xfree(load.rg_jobs);
+
+	END_TIMER2(__func__);
+	debug("%s: loaded %d jobs with %d threads in %s", __func__,
+	      jobs ? list_count(jobs) : 0, thread_cnt, TIME_STR);
+
+	return jobs;
+}
+
+extern void slurmdb_export_close(slurmdb_export_file_t *ef)
+{
+	if (!ef)
+		return;
+
+	munmap(ef->data, ef->size);
+	xfree(ef->rgs);
+	xfree(ef);
+}
@@ -0,0 +1,106 @@
+/*****************************************************************************\
+ *  slurmdb_export.h - columnar export of job accounting records
+ *****************************************************************************
+ *  Copyright (C) 2021 SchedMD LLC.
+ *
+ *  This file is part of Slurm, a resource management program.
+ *  For details, see <https://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  Slurm is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  Slurm is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with Slurm; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+#ifndef _SLURMDB_EXPORT_H
+#define _SLURMDB_EXPORT_H
+
+#include "slurm/slurmdb.h"
+
+/*
+ * An export file holds job records (with their steps) as returned by
+ * slurmdb_jobs_get(), together with the TRES and QOS tables needed to print
+ * them. The jobs are stored in row groups of up to 1024 jobs. Within a row
+ * group every field is stored as a column, integers delta and varint encoded,
+ * strings through a dictionary of the row group and TRES strings as arrays of
+ * id/count pairs.
+ */
+typedef struct slurmdb_export slurmdb_export_t;
+
+/*
+ * Create an export file, truncating any existing file of that name.
+ * RET export handle or NULL on error
+ */
+extern slurmdb_export_t *slurmdb_export_create(const char *file);
+
+/*
+ * Append jobs to an export file.
+ * IN jobs - list of slurmdb_job_rec_t, as returned by slurmdb_jobs_get()
+ *	     and before any step aggregation.
+ * RET SLURM_SUCCESS or SLURM_ERROR
+ */
+extern int slurmdb_export_add_jobs(slurmdb_export_t *exp, List jobs);
+
+/*
+ * Write the index and tables of an export file, then close it and free the
+ * handle.
+ * IN tres_list - list of slurmdb_tres_rec_t, may be NULL
+ * IN qos_list - list of slurmdb_qos_rec_t, may be NULL
+ * RET SLURM_SUCCESS or SLURM_ERROR
+ */
+extern int slurmdb_export_finish(slurmdb_export_t *exp, List tres_list,
+				 List qos_list);
+
+/*
+ * Abandon an export file, removing it, and free the handle.
+ */
+extern void slurmdb_export_destroy(slurmdb_export_t *exp);
+
+typedef struct slurmdb_export_file slurmdb_export_file_t;
+
+/*
+ * Open an export file for reading. The file is memory mapped, only its index
+ * and tables are read.
+ * OUT tres_list - list of slurmdb_tres_rec_t stored in the file
+ * OUT qos_list - list of slurmdb_qos_rec_t stored in the file
+ * RET file handle or NULL on error
+ */
+extern slurmdb_export_file_t *slurmdb_export_open(const char *file,
+						  List *tres_list,
+						  List *qos_list);
+
+/*
+ * Get the jobs of an export file. The row groups are decoded by several
+ * threads, skipping the ones with no job in the time window of job_cond.
+ * IN job_cond - only return jobs matching these conditions, may be NULL.
+ *		 The time window must already be set, see
+ *		 slurmdb_job_cond_def_start_end().
+ * RET list of slurmdb_job_rec_t or NULL on error
+ */
+extern List slurmdb_export_get_jobs(slurmdb_export_file_t *ef,
+				    slurmdb_job_cond_t *job_cond);
+
+extern void slurmdb_export_close(slurmdb_export_file_t *ef);
+
+#endif
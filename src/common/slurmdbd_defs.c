@@ -179,6 +179,14 @@ extern slurmdbd_msg_type_t str_2_slurmdbd_msg_type(char *msg_type)
 		return DBD_STEP_START;
 	} else if (!xstrcasecmp(msg_type, "Get Jobs Conditional")) {
 		return DBD_GET_JOBS_COND;
+	} else if (!xstrcasecmp(msg_type, "Get Jobs Chunk")) {
+		return DBD_GET_JOBS_CHUNK;
+	} else if (!xstrcasecmp(msg_type, "Get Jobs Next")) {
+		return DBD_GET_JOBS_NEXT;
+	} else if (!xstrcasecmp(msg_type, "Get Updates")) {
+		return DBD_GET_UPDATES;
+	} else if (!xstrcasecmp(msg_type, "Got Updates")) {
+		return DBD_GOT_UPDATES;
 	} else if (!xstrcasecmp(msg_type, "Get Transactions")) {
 		return DBD_GET_TXN;
 	} else if (!xstrcasecmp(msg_type, "Got Transactions")) {
@@ -618,6 +626,30 @@ extern char *slurmdbd_msg_type_2_str(slurmdbd_msg_type_t msg_type, int get_enum)
 		} else
 			return "Get Jobs Conditional";
 		break;
+	case DBD_GET_JOBS_CHUNK:
+		if (get_enum) {
+			return "DBD_GET_JOBS_CHUNK";
+		} else
+			return "Get Jobs Chunk";
+		break;
+	case DBD_GET_JOBS_NEXT:
+		if (get_enum) {
+			return "DBD_GET_JOBS_NEXT";
+		} else
+			return "Get Jobs Next";
+		break;
+	case DBD_GET_UPDATES:
+		if (get_enum) {
+			return "DBD_GET_UPDATES";
+		} else
+			return "Get Updates";
+		break;
+	case DBD_GOT_UPDATES:
+		if (get_enum) {
+			return "DBD_GOT_UPDATES";
+		} else
+			return "Got Updates";
+		break;
 	case DBD_GET_TXN:
 		if (get_enum) {
 			return "DBD_GET_TXN";
@@ -875,6 +907,7 @@ extern void slurmdbd_free_msg(persist_msg_t *msg)
 	case DBD_GET_EVENTS:
 	case DBD_GET_FEDERATIONS:
 	case DBD_GET_JOBS_COND:
+	case DBD_GET_JOBS_CHUNK:
 	case DBD_GET_PROBS:
 	case DBD_GET_QOS:
 	case DBD_GET_RESVS:
@@ -935,6 +968,10 @@ extern void slurmdbd_free_msg(persist_msg_t *msg)
 	case DBD_REGISTER_CTLD:
 		slurmdbd_free_register_ctld_msg(msg->data);
 		break;
+	case DBD_GET_UPDATES:
+	case DBD_GOT_UPDATES:
+		slurmdbd_free_updates_msg(msg->data);
+		break;
 	case DBD_ROLL_USAGE:
 		slurmdbd_free_roll_usage_msg(msg->data);
 		break;
@@ -948,6 +985,7 @@ extern void slurmdbd_free_msg(persist_msg_t *msg)
 	case DBD_GET_STATS:
 	case DBD_CLEAR_STATS:
 	case DBD_SHUTDOWN:
+	case DBD_GET_JOBS_NEXT:
 		break;
 	case SLURM_PERSIST_INIT:
 		slurm_free_msg(msg->data);
@@ -1010,6 +1048,7 @@ extern void slurmdbd_free_cond_msg(dbd_cond_msg_t *msg,
 			my_destroy = slurmdb_destroy_federation_cond;
 			break;
 		case DBD_GET_JOBS_COND:
+		case DBD_GET_JOBS_CHUNK:
 			my_destroy = slurmdb_destroy_job_cond;
 			break;
 		case DBD_GET_QOS:
@@ -1207,6 +1246,14 @@ extern void slurmdbd_free_step_start_msg(dbd_step_start_msg_t *msg)
 	}
 }
 
+extern void slurmdbd_free_updates_msg(dbd_updates_msg_t *msg)
+{
+	if (msg) {
+		FREE_NULL_LIST(msg->update_list);
+		xfree(msg);
+	}
+}
+
 extern void slurmdbd_free_usage_msg(dbd_usage_msg_t *msg,
 				    slurmdbd_msg_type_t type)
 {
@@ -152,6 +152,10 @@ typedef enum {
 	DBD_GOT_FEDERATIONS,	/* Response to DBD_GET_FEDERATIONS 	*/
 	DBD_MODIFY_FEDERATIONS, /* Modify existing federation 		*/
 	DBD_REMOVE_FEDERATIONS, /* Removing existing federation 	*/
+	DBD_GET_JOBS_CHUNK,	/* Get job information in chunks	*/
+	DBD_GET_JOBS_NEXT,	/* Get next chunk of DBD_GET_JOBS_CHUNK	*/
+	DBD_GET_UPDATES,	/* Get updates since a state version	*/
+	DBD_GOT_UPDATES,	/* Response to DBD_GET_UPDATES		*/
 
 	SLURM_PERSIST_INIT = 6500, /* So we don't use the
 				    * REQUEST_PERSIST_INIT also used here.
@@ -345,6 +349,18 @@ typedef struct dbd_register_ctld_msg {
 	uint16_t port;		/* slurmctld's comm port */
 } dbd_register_ctld_msg_t;
 
+/*
+ * Version of the association state, see DBD_GET_UPDATES. Every commit sending
+ * updates to the slurmctlds is given the next generation number of the update
+ * log of the slurmdbd, identified by its epoch.
+ */
+typedef struct dbd_updates_msg {
+	uint32_t epoch;		/* update log of the slurmdbd, 0 if unknown */
+	uint64_t gen;		/* last update applied to the state */
+	List update_list;	/* list of slurmdb_update_object_t *'s, NULL
+				 * if the state must be read in full */
+} dbd_updates_msg_t;
+
 typedef struct dbd_step_comp_msg {
 	uint32_t assoc_id;	/* accounting association id */
 	uint64_t db_index;	/* index into the db for this job */
@@ -420,6 +436,7 @@ extern void slurmdbd_free_register_ctld_msg(dbd_register_ctld_msg_t *msg);
 extern void slurmdbd_free_roll_usage_msg(dbd_roll_usage_msg_t *msg);
 extern void slurmdbd_free_step_complete_msg(dbd_step_comp_msg_t *msg);
 extern void slurmdbd_free_step_start_msg(dbd_step_start_msg_t *msg);
+extern void slurmdbd_free_updates_msg(dbd_updates_msg_t *msg);
 extern void slurmdbd_free_usage_msg(dbd_usage_msg_t *msg,
 				    slurmdbd_msg_type_t type);
 
@@ -249,6 +249,7 @@ static void _pack_cond_msg(dbd_cond_msg_t *msg, uint16_t rpc_version,
 		my_function = slurmdb_pack_federation_cond;
 		break;
 	case DBD_GET_JOBS_COND:
+	case DBD_GET_JOBS_CHUNK:
 		my_function = slurmdb_pack_job_cond;
 		break;
 	case DBD_GET_QOS:
@@ -315,6 +316,7 @@ static int _unpack_cond_msg(dbd_cond_msg_t **msg, uint16_t rpc_version,
 		my_function = slurmdb_unpack_federation_cond;
 		break;
 	case DBD_GET_JOBS_COND:
+	case DBD_GET_JOBS_CHUNK:
 		my_function = slurmdb_unpack_job_cond;
 		break;
 	case DBD_GET_QOS:
@@ -1566,6 +1568,68 @@ unpack_error:
 	return SLURM_ERROR;
 }
 
+extern void slurmdbd_pack_updates_msg(dbd_updates_msg_t *msg,
+				      uint16_t rpc_version, buf_t *buffer)
+{
+	uint32_t count = NO_VAL;
+	ListIterator itr;
+	slurmdb_update_object_t *object;
+
+	if (rpc_version >= SLURM_MIN_PROTOCOL_VERSION) {
+		pack32(msg->epoch, buffer);
+		pack64(msg->gen, buffer);
+
+		/* NO_VAL tells the state must be read in full */
+		if (msg->update_list)
+			count = list_count(msg->update_list);
+		pack32(count, buffer);
+		if ((count == NO_VAL) || !count)
+			return;
+
+		itr = list_iterator_create(msg->update_list);
+		while ((object = list_next(itr)))
+			slurmdb_pack_update_object(object, rpc_version, buffer);
+		list_iterator_destroy(itr);
+	}
+}
+
+extern int slurmdbd_unpack_updates_msg(dbd_updates_msg_t **msg,
+				       uint16_t rpc_version, buf_t *buffer)
+{
+	uint32_t count, i;
+	slurmdb_update_object_t *object;
+	dbd_updates_msg_t *msg_ptr = xmalloc(sizeof(dbd_updates_msg_t));
+
+	*msg = msg_ptr;
+
+	if (rpc_version >= SLURM_MIN_PROTOCOL_VERSION) {
+		safe_unpack32(&msg_ptr->epoch, buffer);
+		safe_unpack64(&msg_ptr->gen, buffer);
+
+		safe_unpack32(&count, buffer);
+		if (count != NO_VAL) {
+			if (count > remaining_buf(buffer))
+				goto unpack_error;
+			msg_ptr->update_list =
+				list_create(slurmdb_destroy_update_object);
+			for (i = 0; i < count; i++) {
+				if (slurmdb_unpack_update_object(
+					    &object, rpc_version, buffer) !=
+				    SLURM_SUCCESS)
+					goto unpack_error;
+				list_append(msg_ptr->update_list, object);
+			}
+		}
+	}
+
+	return SLURM_SUCCESS;
+
+unpack_error:
+	slurmdbd_free_updates_msg(msg_ptr);
+	*msg = NULL;
+	return SLURM_ERROR;
+}
+
 extern buf_t *pack_slurmdbd_msg(persist_msg_t *req, uint16_t rpc_version)
 {
 	buf_t *buffer;
@@ -1642,6 +1706,7 @@ extern buf_t *pack_slurmdbd_msg(persist_msg_t *req, uint16_t rpc_version)
 	case DBD_GET_EVENTS:
 	case DBD_GET_FEDERATIONS:
 	case DBD_GET_JOBS_COND:
+	case DBD_GET_JOBS_CHUNK:
 	case DBD_GET_PROBS:
 	case DBD_GET_QOS:
 	case DBD_GET_RESVS:
@@ -1724,6 +1789,11 @@ extern buf_t *pack_slurmdbd_msg(persist_msg_t *req, uint16_t rpc_version)
 			(dbd_register_ctld_msg_t *)req->data, rpc_version,
 			buffer);
 		break;
+	case DBD_GET_UPDATES:
+	case DBD_GOT_UPDATES:
+		slurmdbd_pack_updates_msg((dbd_updates_msg_t *)req->data,
+					  rpc_version, buffer);
+		break;
 	case DBD_ROLL_USAGE:
 		_pack_roll_usage_msg((dbd_roll_usage_msg_t *)req->data,
 				     rpc_version,
@@ -1743,6 +1813,7 @@ extern buf_t *pack_slurmdbd_msg(persist_msg_t *req, uint16_t rpc_version)
 	case DBD_GET_STATS:
 	case DBD_CLEAR_STATS:
 	case DBD_SHUTDOWN:
+	case DBD_GET_JOBS_NEXT:
 		break;
 	default:
 		error("slurmdbd: Invalid message type pack %u(%s:%u)",
@@ -1843,6 +1914,7 @@ extern int unpack_slurmdbd_msg(persist_msg_t *resp, uint16_t rpc_version,
 	case DBD_GET_EVENTS:
 	case DBD_GET_FEDERATIONS:
 	case DBD_GET_JOBS_COND:
+	case DBD_GET_JOBS_CHUNK:
 	case DBD_GET_PROBS:
 	case DBD_GET_QOS:
 	case DBD_GET_RESVS:
@@ -1930,6 +2002,12 @@ extern int unpack_slurmdbd_msg(persist_msg_t *resp, uint16_t rpc_version,
 			(dbd_register_ctld_msg_t **)&resp->data,
 			rpc_version, buffer);
 		break;
+	case DBD_GET_UPDATES:
+	case DBD_GOT_UPDATES:
+		rc = slurmdbd_unpack_updates_msg(
+			(dbd_updates_msg_t **)&resp->data,
+			rpc_version, buffer);
+		break;
 	case DBD_ROLL_USAGE:
 		rc = _unpack_roll_usage_msg(
 			(dbd_roll_usage_msg_t **)&resp->data, rpc_version,
@@ -1950,6 +2028,7 @@ extern int unpack_slurmdbd_msg(persist_msg_t *resp, uint16_t rpc_version,
 	case DBD_GET_STATS:
 	case DBD_CLEAR_STATS:
 	case DBD_SHUTDOWN:
+	case DBD_GET_JOBS_NEXT:
 		/* No message to unpack */
 		break;
 	case DBD_GOT_STATS:
@@ -74,6 +74,11 @@ extern void slurmdbd_pack_list_msg(dbd_list_msg_t *msg, uint16_t rpc_version,
 extern int slurmdbd_unpack_list_msg(dbd_list_msg_t **msg, uint16_t rpc_version,
 				    slurmdbd_msg_type_t type, buf_t *buffer);
 
+extern void slurmdbd_pack_updates_msg(dbd_updates_msg_t *msg,
+				      uint16_t rpc_version, buf_t *buffer);
+extern int slurmdbd_unpack_updates_msg(dbd_updates_msg_t **msg,
+				       uint16_t rpc_version, buf_t *buffer);
+
 extern buf_t *pack_slurmdbd_msg(persist_msg_t *req, uint16_t rpc_version);
 extern int unpack_slurmdbd_msg(persist_msg_t *resp, uint16_t rpc_version,
 			       buf_t *buffer);
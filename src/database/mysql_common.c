@@ -49,6 +49,8 @@
 #include "src/common/read_config.h"
 
 #define MAX_DEADLOCK_ATTEMPTS 10
+/* Size of the deferred statements at which they are written */
+#define MAX_BATCH_SIZE (1024 * 1024)
 
 static char *table_defs_table = "table_defs_table";
 
@@ -57,6 +59,51 @@ typedef struct {
 	char *columns;
 } db_key_t;
 
+typedef struct {
+	MYSQL *db_conn;
+	char *key;		/* pool_key of the connection it was on */
+} db_pool_t;
+
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static List pool_list = NULL;	/* db_pool_t of idle handles */
+static int pool_size = 0;
+
+/* Set on the threads which used the client library, see _thread_attach() */
+static pthread_key_t thread_end_key;
+static pthread_once_t thread_end_once = PTHREAD_ONCE_INIT;
+
+static void _thread_end(void *arg)
+{
+	mysql_thread_end();
+}
+
+static void _thread_end_key_create(void)
+{
+	if (pthread_key_create(&thread_end_key, _thread_end))
+		fatal("%s: pthread_key_create: %m", __func__);
+}
+
+/*
+ * Connections are used by whichever thread processes their current request
+ * and live longer than any of them, so the client library state of a thread
+ * is set up the first time it uses a connection and released only when the
+ * thread exits.
+ */
+static void _thread_attach(void)
+{
+	if (!mysql_thread_safe())
+		return;
+
+	pthread_once(&thread_end_once, _thread_end_key_create);
+	if (pthread_getspecific(thread_end_key))
+		return;
+
+	if (mysql_thread_init())
+		error("%s: mysql_thread_init failed", __func__);
+	else
+		pthread_setspecific(thread_end_key, (void *) 1);
+}
+
 static void _destroy_db_key(void *arg)
 {
 	db_key_t *db_key = (db_key_t *)arg;
@@ -68,6 +115,48 @@ static void _destroy_db_key(void *arg)
 	}
 }
 
+static void _destroy_db_pool(void *arg)
+{
+	db_pool_t *db_pool = arg;
+
+	mysql_close(db_pool->db_conn);
+	xfree(db_pool->key);
+	xfree(db_pool);
+}
+
+static int _find_db_pool(void *x, void *key)
+{
+	db_pool_t *db_pool = x;
+
+	return !xstrcmp(db_pool->key, key);
+}
+
+/* RET an idle handle still connected the way key says, or NULL */
+static MYSQL *_pool_get(char *key)
+{
+	db_pool_t *db_pool;
+	MYSQL *db_conn = NULL;
+
+	while (!db_conn) {
+		slurm_mutex_lock(&pool_lock);
+		db_pool = pool_list ?
+			list_remove_first(pool_list, _find_db_pool, key) : NULL;
+		slurm_mutex_unlock(&pool_lock);
+		if (!db_pool)
+			break;
+
+		/* The server may have closed it while it was idle */
+		if (!mysql_ping(db_pool->db_conn)) {
+			db_conn = db_pool->db_conn;
+			xfree(db_pool->key);
+			xfree(db_pool);
+		} else
+			_destroy_db_pool(db_pool);
+	}
+
+	return db_conn;
+}
+
 /* NOTE: Ensure that mysql_conn->lock is set on function entry */
 static int _clear_results(MYSQL *db_conn)
 {
@@ -93,6 +182,39 @@ static int _clear_results(MYSQL *db_conn)
 	return SLURM_SUCCESS;
 }
 
+/*
+ * Keep the handle of a connection being closed for the next connection.
+ * NOTE: Ensure that mysql_conn->lock is set on function entry
+ * RET true if the handle was kept
+ */
+static bool _pool_put(mysql_conn_t *mysql_conn)
+{
+	db_pool_t *db_pool;
+	bool kept = false;
+
+	if (!pool_size || !mysql_conn->pool_key)
+		return false;
+
+	/* Nothing of this connection must be seen by the next one */
+	_clear_results(mysql_conn->db_conn);
+	if (mysql_rollback(mysql_conn->db_conn))
+		return false;
+
+	slurm_mutex_lock(&pool_lock);
+	if (!pool_list)
+		pool_list = list_create(_destroy_db_pool);
+	if (list_count(pool_list) < pool_size) {
+		db_pool = xmalloc(sizeof(*db_pool));
+		db_pool->db_conn = mysql_conn->db_conn;
+		db_pool->key = xstrdup(mysql_conn->pool_key);
+		list_append(pool_list, db_pool);
+		kept = true;
+	}
+	slurm_mutex_unlock(&pool_lock);
+
+	return kept;
+}
+
 /* NOTE: Ensure that mysql_conn->lock is set on function entry */
 static MYSQL_RES *_get_first_result(MYSQL *db_conn)
 {
@@ -143,6 +265,8 @@ try_again:
 	if (!db_conn)
 		fatal("You haven't inited this storage yet.");
 
+	_thread_attach();
+
 	/* clear out the old results so we don't get a 2014 error */
 	_clear_results(db_conn);
 	if (mysql_query(db_conn, query)) {
@@ -670,8 +794,6 @@ static int _create_db(char *db_name, mysql_db_info_t *db_info)
 				      mysql_error(mysql_db), create_line);
 			}
 			xfree(create_line);
-			if (mysql_thread_safe())
-				mysql_thread_end();
 			mysql_close(mysql_db);
 		} else {
 			info("Connection failed to host = %s "
@@ -689,6 +811,78 @@ static int _create_db(char *db_name, mysql_db_info_t *db_info)
 	return rc;
 }
 
+/*
+ * Finish the multi-row insert the next deferred row can not be added to.
+ * NOTE: Ensure that mysql_conn->lock is set on function entry
+ */
+static void _batch_close_insert(mysql_conn_t *mysql_conn)
+{
+	if (!mysql_conn->batch_header)
+		return;
+
+	if (mysql_conn->batch_suffix)
+		xstrfmtcatat(mysql_conn->batch_query, &mysql_conn->batch_pos,
+			     "%s", mysql_conn->batch_suffix);
+	xfree(mysql_conn->batch_header);
+	xfree(mysql_conn->batch_suffix);
+}
+
+/*
+ * Drop the deferred statements, remembering they were not written.
+ * NOTE: Ensure that mysql_conn->lock is set on function entry
+ */
+static void _batch_discard(mysql_conn_t *mysql_conn)
+{
+	if (!mysql_conn->batch_query)
+		return;
+
+	debug("%s: dropping %d deferred rows and statements",
+	      __func__, mysql_conn->batch_cnt);
+	xfree(mysql_conn->batch_header);
+	xfree(mysql_conn->batch_query);
+	xfree(mysql_conn->batch_suffix);
+	mysql_conn->batch_pos = NULL;
+	mysql_conn->batch_cnt = 0;
+	if (!mysql_conn->batch_rc)
+		mysql_conn->batch_rc = SLURM_ERROR;
+}
+
+/*
+ * Write the deferred statements in one multi-statement query.
+ * NOTE: Ensure that mysql_conn->lock is set on function entry
+ */
+static void _batch_flush(mysql_conn_t *mysql_conn)
+{
+	int rc;
+	DEF_TIMERS;
+
+	if (!mysql_conn->batch_query)
+		return;
+
+	_batch_close_insert(mysql_conn);
+
+	START_TIMER;
+	if ((rc = _mysql_query_internal(mysql_conn->db_conn,
+					mysql_conn->batch_query)) !=
+	    SLURM_ERROR)
+		rc = _clear_results(mysql_conn->db_conn);
+	END_TIMER;
+
+	if (rc != SLURM_SUCCESS) {
+		error("%s: could not write %d deferred rows and statements",
+		      __func__, mysql_conn->batch_cnt);
+		if (!mysql_conn->batch_rc)
+			mysql_conn->batch_rc = rc;
+	} else {
+		log_flag(DB_QUERY, "%s: wrote %d deferred rows and statements in %s",
+			 __func__, mysql_conn->batch_cnt, TIME_STR);
+	}
+
+	xfree(mysql_conn->batch_query);
+	mysql_conn->batch_pos = NULL;
+	mysql_conn->batch_cnt = 0;
+}
+
 extern mysql_conn_t *create_mysql_conn(int conn_num, bool rollback,
 				       char *cluster_name)
 {
@@ -707,6 +901,10 @@ extern int destroy_mysql_conn(mysql_conn_t *mysql_conn)
 {
 	if (mysql_conn) {
 		mysql_db_close_db_connection(mysql_conn);
+		xfree(mysql_conn->batch_header);
+		xfree(mysql_conn->batch_query);
+		xfree(mysql_conn->batch_suffix);
+		xfree(mysql_conn->pool_key);
 		xfree(mysql_conn->pre_commit_query);
 		xfree(mysql_conn->cluster_name);
 		slurm_mutex_destroy(&mysql_conn->lock);
@@ -770,8 +968,21 @@ extern int mysql_db_get_db_connection(mysql_conn_t *mysql_conn, char *db_name,
 
 	xassert(mysql_conn);
 
+	_thread_attach();
 	slurm_mutex_lock(&mysql_conn->lock);
 
+	xfree(mysql_conn->pool_key);
+	mysql_conn->pool_key = xstrdup_printf("%s@%s:%u/%s",
+					      db_info->user, db_info->host,
+					      db_info->port, db_name);
+	if (!mysql_conn->db_conn &&
+	    (mysql_conn->db_conn = _pool_get(mysql_conn->pool_key))) {
+		mysql_autocommit(mysql_conn->db_conn, !mysql_conn->rollback);
+		slurm_mutex_unlock(&mysql_conn->lock);
+		errno = SLURM_SUCCESS;
+		return SLURM_SUCCESS;
+	}
+
 	if (!(mysql_conn->db_conn = mysql_init(mysql_conn->db_conn))) {
 		slurm_mutex_unlock(&mysql_conn->lock);
 		fatal("mysql_init failed: %s",
@@ -848,20 +1059,35 @@ extern int mysql_db_get_db_connection(mysql_conn_t *mysql_conn, char *db_name,
 extern int mysql_db_close_db_connection(mysql_conn_t *mysql_conn)
 {
 	slurm_mutex_lock(&mysql_conn->lock);
+	_batch_discard(mysql_conn);
 	if (mysql_conn && mysql_conn->db_conn) {
-		if (mysql_thread_safe())
-			mysql_thread_end();
-		mysql_close(mysql_conn->db_conn);
+		_thread_attach();
+		if (!_pool_put(mysql_conn))
+			mysql_close(mysql_conn->db_conn);
 		mysql_conn->db_conn = NULL;
 	}
 	slurm_mutex_unlock(&mysql_conn->lock);
 	return SLURM_SUCCESS;
 }
 
+extern void mysql_db_set_pool_size(int size)
+{
+	slurm_mutex_lock(&pool_lock);
+	pool_size = size;
+	while (pool_list && (list_count(pool_list) > pool_size))
+		_destroy_db_pool(list_pop(pool_list));
+	slurm_mutex_unlock(&pool_lock);
+}
+
 extern int mysql_db_cleanup()
 {
 	debug3("starting mysql cleaning up");
 
+	slurm_mutex_lock(&pool_lock);
+	FREE_NULL_LIST(pool_list);
+	pool_size = 0;
+	slurm_mutex_unlock(&pool_lock);
+
 #ifdef mysql_library_end
 	mysql_library_end();
 #else
@@ -880,6 +1106,7 @@ extern int mysql_db_query(mysql_conn_t *mysql_conn, char *query)
 		return 0;	/* For CLANG false positive */
 	}
 	slurm_mutex_lock(&mysql_conn->lock);
+	_batch_flush(mysql_conn);
 	rc = _mysql_query_internal(mysql_conn->db_conn, query);
 	slurm_mutex_unlock(&mysql_conn->lock);
 	return rc;
@@ -898,6 +1125,7 @@ extern int mysql_db_delete_affected_rows(mysql_conn_t *mysql_conn, char *query)
 		return 0;	/* For CLANG false positive */
 	}
 	slurm_mutex_lock(&mysql_conn->lock);
+	_batch_flush(mysql_conn);
 	if (!(rc = _mysql_query_internal(mysql_conn->db_conn, query)))
 		rc = mysql_affected_rows(mysql_conn->db_conn);
 	slurm_mutex_unlock(&mysql_conn->lock);
@@ -911,6 +1139,7 @@ extern int mysql_db_ping(mysql_conn_t *mysql_conn)
 	if (!mysql_conn->db_conn)
 		return -1;
 
+	_thread_attach();
 	/* clear out the old results so we don't get a 2014 error */
 	slurm_mutex_lock(&mysql_conn->lock);
 	_clear_results(mysql_conn->db_conn);
@@ -932,7 +1161,9 @@ extern int mysql_db_commit(mysql_conn_t *mysql_conn)
 	if (!mysql_conn->db_conn)
 		return SLURM_ERROR;
 
+	_thread_attach();
 	slurm_mutex_lock(&mysql_conn->lock);
+	_batch_flush(mysql_conn);
 	/* clear out the old results so we don't get a 2014 error */
 	_clear_results(mysql_conn->db_conn);
 	if (mysql_commit(mysql_conn->db_conn)) {
@@ -953,7 +1184,9 @@ extern int mysql_db_rollback(mysql_conn_t *mysql_conn)
 	if (!mysql_conn->db_conn)
 		return SLURM_ERROR;
 
+	_thread_attach();
 	slurm_mutex_lock(&mysql_conn->lock);
+	_batch_discard(mysql_conn);
 	/* clear out the old results so we don't get a 2014 error */
 	_clear_results(mysql_conn->db_conn);
 	if (mysql_rollback(mysql_conn->db_conn)) {
@@ -980,6 +1213,7 @@ extern MYSQL_RES *mysql_db_query_ret(mysql_conn_t *mysql_conn,
 	MYSQL_RES *result = NULL;
 
 	slurm_mutex_lock(&mysql_conn->lock);
+	_batch_flush(mysql_conn);
 	if (_mysql_query_internal(mysql_conn->db_conn, query) != SLURM_ERROR)  {
 		if (mysql_errno(mysql_conn->db_conn) == ER_NO_SUCH_TABLE)
 			goto fini;
@@ -1009,6 +1243,7 @@ extern int mysql_db_query_check_after(mysql_conn_t *mysql_conn, char *query)
 	int rc = SLURM_SUCCESS;
 
 	slurm_mutex_lock(&mysql_conn->lock);
+	_batch_flush(mysql_conn);
 	if ((rc = _mysql_query_internal(
 		     mysql_conn->db_conn, query)) != SLURM_ERROR)
 		rc = _clear_results(mysql_conn->db_conn);
@@ -1021,6 +1256,7 @@ extern uint64_t mysql_db_insert_ret_id(mysql_conn_t *mysql_conn, char *query)
 	uint64_t new_id = 0;
 
 	slurm_mutex_lock(&mysql_conn->lock);
+	_batch_flush(mysql_conn);
 	if (_mysql_query_internal(mysql_conn->db_conn, query) != SLURM_ERROR)  {
 		new_id = mysql_insert_id(mysql_conn->db_conn);
 		if (!new_id) {
@@ -1034,6 +1270,69 @@ extern uint64_t mysql_db_insert_ret_id(mysql_conn_t *mysql_conn, char *query)
 
 }
 
+extern int mysql_db_batch_query(mysql_conn_t *mysql_conn, char *header,
+				char *values, char *suffix)
+{
+	char *query;
+	int rc;
+
+	if (!mysql_conn || !mysql_conn->db_conn) {
+		fatal("You haven't inited this storage yet.");
+		return 0;	/* For CLANG false positive */
+	}
+
+	slurm_mutex_lock(&mysql_conn->lock);
+	if (!mysql_conn->batch) {
+		slurm_mutex_unlock(&mysql_conn->lock);
+		query = xstrdup_printf("%s%s%s", header ? header : "", values,
+				       suffix ? suffix : "");
+		rc = mysql_db_query(mysql_conn, query);
+		xfree(query);
+		return rc;
+	}
+
+	if (header && mysql_conn->batch_header &&
+	    !xstrcmp(header, mysql_conn->batch_header) &&
+	    !xstrcmp(suffix, mysql_conn->batch_suffix)) {
+		xstrfmtcatat(mysql_conn->batch_query, &mysql_conn->batch_pos,
+			     ", %s", values);
+	} else {
+		_batch_close_insert(mysql_conn);
+		if (mysql_conn->batch_query)
+			xstrfmtcatat(mysql_conn->batch_query,
+				     &mysql_conn->batch_pos, ";");
+		if (header) {
+			xstrfmtcatat(mysql_conn->batch_query,
+				     &mysql_conn->batch_pos, "%s", header);
+			mysql_conn->batch_header = xstrdup(header);
+			mysql_conn->batch_suffix = xstrdup(suffix);
+		}
+		xstrfmtcatat(mysql_conn->batch_query, &mysql_conn->batch_pos,
+			     "%s", values);
+	}
+	mysql_conn->batch_cnt++;
+
+	if ((mysql_conn->batch_pos - mysql_conn->batch_query) >=
+	    MAX_BATCH_SIZE)
+		_batch_flush(mysql_conn);
+	slurm_mutex_unlock(&mysql_conn->lock);
+
+	return SLURM_SUCCESS;
+}
+
+extern int mysql_db_batch_flush(mysql_conn_t *mysql_conn)
+{
+	int rc;
+
+	slurm_mutex_lock(&mysql_conn->lock);
+	_batch_flush(mysql_conn);
+	rc = mysql_conn->batch_rc;
+	mysql_conn->batch_rc = SLURM_SUCCESS;
+	slurm_mutex_unlock(&mysql_conn->lock);
+
+	return rc;
+}
+
 extern int mysql_db_create_table(mysql_conn_t *mysql_conn, char *table_name,
 				 storage_field_t *fields, char *ending)
 {
@@ -59,10 +59,20 @@ typedef enum {
 } slurm_mysql_plugin_type_t;
 
 typedef struct {
+	bool batch;		/* defer statements, see mysql_db_batch_query() */
+	int batch_cnt;		/* rows and statements deferred */
+	char *batch_header;	/* header of the open multi-row insert */
+	char *batch_query;	/* deferred statements */
+	char *batch_pos;	/* end of batch_query */
+	int batch_rc;		/* first error writing deferred statements */
+	char *batch_suffix;	/* end of the open multi-row insert */
 	bool cluster_deleted;
 	char *cluster_name;
 	MYSQL *db_conn;
+	void *job_cursor;	/* job query returned in chunks */
 	pthread_mutex_t lock;
+	char *pool_key;		/* handles connected the same way can be
+				 * reused, see mysql_db_set_pool_size() */
 	char *pre_commit_query;
 	bool rollback;
 	List update_list;
@@ -93,6 +103,13 @@ extern int mysql_db_get_db_connection(mysql_conn_t *mysql_conn, char *db_name,
 				   mysql_db_info_t *db_info);
 extern int mysql_db_close_db_connection(mysql_conn_t *mysql_conn);
 extern int mysql_db_cleanup();
+
+/*
+ * Keep up to size database handles of closed connections to reuse them for
+ * the next connections instead of connecting again. The transaction of a
+ * handle is rolled back before it is kept. 0, the default, closes them.
+ */
+extern void mysql_db_set_pool_size(int size);
 extern int mysql_db_query(mysql_conn_t *mysql_conn, char *query);
 extern int mysql_db_delete_affected_rows(mysql_conn_t *mysql_conn, char *query);
 extern int mysql_db_ping(mysql_conn_t *mysql_conn);
@@ -105,6 +122,27 @@ extern int mysql_db_query_check_after(mysql_conn_t *mysql_conn, char *query);
 
 extern uint64_t mysql_db_insert_ret_id(mysql_conn_t *mysql_conn, char *query);
 
+/*
+ * Run a statement, deferring it while mysql_conn->batch is set. Consecutive
+ * rows deferred with the same header and suffix are merged into one
+ * multi-row insert. Deferred statements are written together by
+ * mysql_db_batch_flush(), or before any other statement run on the
+ * connection so the order of the statements is kept.
+ * IN header - "insert into ... values" part of an insert, NULL otherwise
+ * IN values - one "(...)" row of the insert, or the whole statement
+ * IN suffix - end of the insert ("on duplicate key update ..."), or NULL
+ * RET SLURM_SUCCESS or the error of the statement if it was not deferred
+ */
+extern int mysql_db_batch_query(mysql_conn_t *mysql_conn, char *header,
+				char *values, char *suffix);
+
+/*
+ * Write the statements deferred by mysql_db_batch_query().
+ * RET SLURM_SUCCESS or the first error of the deferred statements since the
+ *     last call
+ */
+extern int mysql_db_batch_flush(mysql_conn_t *mysql_conn);
+
 extern int mysql_db_create_table(mysql_conn_t *mysql_conn, char *table_name,
 				 storage_field_t *fields, char *ending);
 
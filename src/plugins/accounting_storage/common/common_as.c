@@ -879,56 +879,37 @@ static char *_make_archive_name(time_t period_start, time_t period_end,
 	return fullname;
 }
 
-extern int archive_write_file(buf_t *buffer, char *cluster_name,
-			      time_t period_start, time_t period_end,
-			      char *arch_dir, char *arch_type,
-			      uint32_t archive_period)
+extern int archive_open_file(char *cluster_name,
+			     time_t period_start, time_t period_end,
+			     char *arch_dir, char *arch_type,
+			     uint32_t archive_period, char **file_name)
 {
-	int fd = 0;
-	int rc = SLURM_SUCCESS;
+	int fd;
 	char *new_file = NULL;
 	static pthread_mutex_t local_file_lock = PTHREAD_MUTEX_INITIALIZER;
 
-	xassert(buffer);
-
 	slurm_mutex_lock(&local_file_lock);
 
-	/* write the buffer to file */
 	new_file = _make_archive_name(period_start, period_end,
 				      cluster_name, arch_dir,
 				      arch_type, archive_period);
 	if (!new_file) {
 		error("%s: Unable to make archive file name.", __func__);
-		return SLURM_ERROR;
+		slurm_mutex_unlock(&local_file_lock);
+		return -1;
 	}
 
 	debug("Storing %s archive for %s at %s",
 	      arch_type, cluster_name, new_file);
 
-	fd = creat(new_file, 0600);
+	fd = open(new_file, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
 	if (fd < 0) {
 		error("Can't save archive, create file %s error %m", new_file);
-		rc = SLURM_ERROR;
-	} else {
-		int amount;
-		uint32_t pos = 0, nwrite = get_buf_offset(buffer);
-		char *data = (char *)get_buf_data(buffer);
-		while (nwrite > 0) {
-			amount = write(fd, &data[pos], nwrite);
-			if ((amount < 0) && (errno != EINTR)) {
-				error("Error writing file %s, %m", new_file);
-				rc = SLURM_ERROR;
-				break;
-			}
-			nwrite -= amount;
-			pos    += amount;
-		}
-		fsync(fd);
-		close(fd);
+		xfree(new_file);
 	}
+	*file_name = new_file;
 
-	xfree(new_file);
 	slurm_mutex_unlock(&local_file_lock);
 
-	return rc;
+	return fd;
 }
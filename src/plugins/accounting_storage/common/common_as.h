@@ -80,9 +80,15 @@ extern char* acct_get_db_name(void);
 extern time_t archive_setup_end_time(time_t last_submit, uint32_t purge);
 extern int archive_run_script(slurmdb_archive_cond_t *arch_cond,
 			      char *cluster_name, time_t last_submit);
-extern int archive_write_file(buf_t *buffer, char *cluster_name,
-			      time_t period_start, time_t period_end,
-			      char *arch_dir, char *arch_type,
-			      uint32_t archive_period);
+/*
+ * Create a new archive file for the given period, the name is made unique
+ * if one already exists.
+ * RET open file descriptor or -1 on error, set *file_name to the name of the
+ * file which must be xfree'd
+ */
+extern int archive_open_file(char *cluster_name,
+			     time_t period_start, time_t period_end,
+			     char *arch_dir, char *arch_type,
+			     uint32_t archive_period, char **file_name);
 
 #endif
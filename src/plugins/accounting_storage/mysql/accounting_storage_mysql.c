@@ -61,7 +61,9 @@
 #include "as_mysql_resv.h"
 #include "as_mysql_rollup.h"
 #include "as_mysql_txn.h"
+#include "as_mysql_update_log.h"
 #include "as_mysql_usage.h"
+#include "as_mysql_usage_cache.h"
 #include "as_mysql_user.h"
 #include "as_mysql_wckey.h"
 
@@ -2631,6 +2633,8 @@ extern int init(void)
 
 	mysql_db_info = create_mysql_db_info(SLURM_MYSQL_PLUGIN_AS);
 	mysql_db_name = acct_get_db_name();
+	/* Reuse the handles of closed client connections */
+	mysql_db_set_pool_size(slurmdbd_conf->rpc_threads);
 
 	debug2("mysql_connect() called for db %s", mysql_db_name);
 	mysql_conn = create_mysql_conn(0, 1, NULL);
@@ -2674,6 +2678,8 @@ extern int fini ( void )
 	destroy_mysql_db_info(mysql_db_info);
 	xfree(mysql_db_name);
 	xfree(default_qos_str);
+	as_mysql_usage_cache_fini();
+	as_mysql_update_log_fini();
 
 	mysql_db_cleanup();
 	return SLURM_SUCCESS;
@@ -2752,6 +2758,7 @@ extern int acct_storage_p_close_connection(mysql_conn_t **mysql_conn)
 		return SLURM_SUCCESS;
 
 	acct_storage_p_commit((*mysql_conn), 0);
+	as_mysql_jobacct_process_free_cursor(*mysql_conn);
 	rc = destroy_mysql_conn(*mysql_conn);
 	*mysql_conn = NULL;
 
@@ -2805,9 +2812,13 @@ extern int acct_storage_p_commit(mysql_conn_t *mysql_conn, bool commit)
 			} else {
 				if (mysql_db_commit(mysql_conn))
 					error("commit failed");
+				else
+					as_mysql_usage_cache_commit(mysql_conn,
+								    true);
 			}
 		}
 	}
+	as_mysql_usage_cache_commit(mysql_conn, false);
 
 	if (commit && list_count(update_list)) {
 		char *query = NULL;
@@ -2815,6 +2826,12 @@ extern int acct_storage_p_commit(mysql_conn_t *mysql_conn, bool commit)
 		MYSQL_ROW row;
 		ListIterator itr = NULL;
 		slurmdb_update_object_t *object = NULL;
+		uint32_t epoch;
+		uint64_t gen;
+		bool logged;
+
+		/* Let the slurmctlds missing these get them later */
+		gen = as_mysql_update_log_add(update_list, &epoch);
 
 		xstrfmtcat(query, "select control_host, control_port, "
 			   "name, rpc_version, flags "
@@ -2829,11 +2846,14 @@ extern int acct_storage_p_commit(mysql_conn_t *mysql_conn, bool commit)
 		while ((row = mysql_fetch_row(result))) {
 			if (slurm_atoul(row[4]) & CLUSTER_FLAG_EXT)
 				continue;
+			/* Older slurmctlds don't know where updates are */
+			logged = as_mysql_update_log_wanted(row[2]);
 			(void) slurmdb_send_accounting_update(
 				update_list,
 				row[2], row[0],
 				slurm_atoul(row[1]),
-				slurm_atoul(row[3]));
+				slurm_atoul(row[3]),
+				logged ? epoch : 0, logged ? gen : 0);
 		}
 		mysql_free_result(result);
 	skip:
@@ -2844,7 +2864,7 @@ extern int acct_storage_p_commit(mysql_conn_t *mysql_conn, bool commit)
 		while ((object = list_next(itr))) {
 			if (!object->objects || !list_count(object->objects))
 				continue;
-			/* We only care about clusters removed here. */
+			/* We only care about clusters and assocs changed here. */
 			switch (object->type) {
 			case SLURMDB_REMOVE_CLUSTER:
 			{
@@ -2855,10 +2875,16 @@ extern int acct_storage_p_commit(mysql_conn_t *mysql_conn, bool commit)
 					list_delete_all(as_mysql_cluster_list,
 							slurm_find_char_in_list,
 							rem_cluster);
+					as_mysql_usage_cache_clear(rem_cluster);
 				}
 				list_iterator_destroy(rem_itr);
 				break;
 			}
+			case SLURMDB_ADD_ASSOC:
+			case SLURMDB_MODIFY_ASSOC:
+			case SLURMDB_REMOVE_ASSOC:
+				as_mysql_usage_cache_assocs_changed();
+				break;
 			default:
 				break;
 			}
@@ -2872,6 +2898,21 @@ extern int acct_storage_p_commit(mysql_conn_t *mysql_conn, bool commit)
 	return SLURM_SUCCESS;
 }
 
+extern int acct_storage_p_batch(mysql_conn_t *mysql_conn, bool start)
+{
+	int rc;
+
+	if (!mysql_conn)
+		return ESLURM_DB_CONNECTION;
+
+	/* write anything left from a previous batch before starting one */
+	mysql_conn->batch = false;
+	rc = mysql_db_batch_flush(mysql_conn);
+	mysql_conn->batch = start;
+
+	return rc;
+}
+
 extern int acct_storage_p_add_users(mysql_conn_t *mysql_conn, uint32_t uid,
 				    List user_list)
 {
@@ -3192,6 +3233,18 @@ extern List acct_storage_p_get_txn(mysql_conn_t *mysql_conn, uid_t uid,
 	return as_mysql_get_txn(mysql_conn, uid, txn_cond);
 }
 
+extern int acct_storage_p_get_updates(mysql_conn_t *mysql_conn, uid_t uid,
+				      uint32_t *epoch, uint64_t *gen,
+				      List *update_list)
+{
+	if (!is_user_min_admin_level(mysql_conn, uid, SLURMDB_ADMIN_SUPER_USER))
+		return ESLURM_ACCESS_DENIED;
+
+	as_mysql_update_log_get(mysql_conn->cluster_name, epoch, gen,
+				update_list);
+	return SLURM_SUCCESS;
+}
+
 extern int acct_storage_p_get_usage(mysql_conn_t *mysql_conn, uid_t uid,
 				    void *in, slurmdbd_msg_type_t type,
 				    time_t start, time_t end)
@@ -3236,6 +3289,8 @@ extern int clusteracct_storage_p_node_up(mysql_conn_t *mysql_conn,
 extern int clusteracct_storage_p_register_ctld(mysql_conn_t *mysql_conn,
 					       uint16_t port)
 {
+	/* It asks again for the update log if it reads it */
+	as_mysql_update_log_forget(mysql_conn->cluster_name);
 	return as_mysql_register_ctld(
 		mysql_conn, mysql_conn->cluster_name, port);
 }
@@ -3308,6 +3363,7 @@ extern int clusteracct_storage_p_fini_ctld(mysql_conn_t *mysql_conn,
 	if (!cluster_rec->name)
 		cluster_rec->name = mysql_conn->cluster_name;
 
+	as_mysql_update_log_forget(cluster_rec->name);
 	return as_mysql_fini_ctld(mysql_conn, cluster_rec);
 }
 
@@ -3386,6 +3442,22 @@ extern List jobacct_storage_p_get_jobs_cond(mysql_conn_t *mysql_conn,
 	return job_list;
 }
 
+/*
+ * get info from the storage in chunks
+ * returns List of job_rec_t *, empty once all the jobs were returned
+ * note List needs to be freed when called
+ */
+extern List jobacct_storage_p_get_jobs_chunk(mysql_conn_t *mysql_conn,
+					     uid_t uid,
+					     slurmdb_job_cond_t *job_cond)
+{
+	if (check_connection(mysql_conn) != SLURM_SUCCESS)
+		return NULL;
+
+	return as_mysql_jobacct_process_get_jobs_chunk(mysql_conn, uid,
+						       job_cond);
+}
+
 /*
  * expire old info from the storage
  */
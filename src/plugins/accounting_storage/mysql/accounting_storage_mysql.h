@@ -173,6 +173,7 @@ extern int get_cluster_dims(mysql_conn_t *mysql_conn, char *cluster_name,
 
 /*local api functions */
 extern int acct_storage_p_commit(mysql_conn_t *mysql_conn, bool commit);
+extern int acct_storage_p_batch(mysql_conn_t *mysql_conn, bool start);
 
 extern int acct_storage_p_add_assocs(mysql_conn_t *mysql_conn,
 					   uint32_t uid,
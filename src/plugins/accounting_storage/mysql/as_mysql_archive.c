@@ -36,12 +36,18 @@
  *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
 \*****************************************************************************/
 
+#include <arpa/inet.h>
 #include <fcntl.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <unistd.h>
 
+#if HAVE_LZ4
+# include <lz4.h>
+#endif
+
 #include "as_mysql_archive.h"
+#include "as_mysql_usage_cache.h"
 #include "src/common/env.h"
 #include "src/common/slurm_time.h"
 #include "src/common/slurmdbd_defs.h"
@@ -63,8 +69,21 @@
 #define SLURMDBD_2_6_VERSION   12	/* slurm version 2.6 */
 #define SLURMDBD_2_5_VERSION   11	/* slurm version 2.5 */
 
-#define MAX_PURGE_LIMIT 50000 /* Number of records that are purged at a time
-				 so that locks can be periodically released. */
+#define ARCHIVE_CHUNK_SIZE 10000 /* Number of records archived at a time,
+				    each chunk is a section of the file. */
+#define PURGE_BATCH_SIZE 1000	/* Number of records purged per transaction
+				   so that locks can be periodically released. */
+#define PURGE_MAX_DELAY 1000000	/* Max usecs to wait between purge batches */
+
+/*
+ * Archive files start with ARCHIVE_MAGIC followed by sections, each one a
+ * header of three uint32_t in network order (flags, size of the section
+ * and size stored in the file) and the section data. A section holds the
+ * same data as the whole of an older archive file.
+ */
+#define ARCHIVE_MAGIC 0xff534152	/* "\xffSAR" */
+#define ARCHIVE_SECTION_LZ4 0x0001	/* section is lz4 compressed */
+
 #define MAX_ARCHIVE_AGE (60 * 60 * 24 * 60) /* If archive data is older than
 					       this then archive by month to
 					       handle large datasets. */
@@ -811,10 +830,41 @@ typedef enum {
 	PURGE_CLUSTER_USAGE
 } purge_type_t;
 
-static uint32_t _archive_table(purge_type_t type, mysql_conn_t *mysql_conn,
-			       char *cluster_name, time_t period_end,
-			       char *arch_dir, uint32_t archive_period,
-			       char *sql_table, uint32_t usage_info);
+/*
+ * Columns records are archived in order of, the first one being the column
+ * the purge is based on, and primary key records are purged by.
+ */
+typedef struct {
+	char *order;
+	char *pk;
+} archive_key_t;
+
+static archive_key_t archive_keys[] = {
+	[PURGE_EVENT] = { "time_start, node_name", "node_name, time_start" },
+	[PURGE_SUSPEND] = { "time_start, job_db_inx",
+			    "job_db_inx, time_start" },
+	[PURGE_RESV] = { "time_start, id_resv", "id_resv, time_start" },
+	[PURGE_JOB] = { "time_submit, job_db_inx", "job_db_inx" },
+	[PURGE_STEP] = { "time_start, job_db_inx, id_step, step_het_comp",
+			 "job_db_inx, id_step, step_het_comp" },
+	[PURGE_TXN] = { "timestamp, id", "id" },
+	[PURGE_USAGE] = { "time_start, id, id_tres",
+			  "id, id_tres, time_start" },
+	[PURGE_CLUSTER_USAGE] = { "time_start, id_tres",
+				  "id_tres, time_start" },
+};
+
+typedef struct {
+	buf_t *buffer;		/* section being written */
+	pthread_cond_t cond;
+	int fd;
+	char *file_name;
+	pthread_mutex_t mutex;
+	int rc;			/* set if a section failed to be written */
+	uint32_t sections;	/* sections written */
+	bool shutdown;
+	pthread_t tid;
+} archive_writer_t;
 
 static uint32_t high_buffer_size = (1024 * 1024);
 
@@ -3989,115 +4039,406 @@ static char *_load_cluster_usage(uint16_t rpc_version, buf_t *buffer,
 	return insert;
 }
 
-/* returns count of events archived or SLURM_ERROR on error */
-static uint32_t _archive_table(purge_type_t type, mysql_conn_t *mysql_conn,
-			       char *cluster_name, time_t period_end,
-			       char *arch_dir, uint32_t archive_period,
-			       char *sql_table, uint32_t usage_info)
+/* Delete the records of a chunk, one committed transaction per batch */
+static int _purge_chunk(mysql_conn_t *mysql_conn, char *table, char *pk,
+			List batches)
 {
-	MYSQL_RES *result = NULL;
-	char *cols = NULL, *query = NULL;
-	time_t period_start = 0;
-	uint32_t cnt = 0;
+	char *keys, *query;
+	int rc, purged = 0;
+	DEF_TIMERS;
+
+	while ((keys = list_pop(batches))) {
+		START_TIMER;
+		query = xstrdup_printf("delete from %s where (%s) in (%s)",
+				       table, pk, keys);
+		xfree(keys);
+		DB_DEBUG(DB_ARCHIVE, mysql_conn->conn, "query\n%s", query);
+		rc = mysql_db_delete_affected_rows(mysql_conn, query);
+		xfree(query);
+		if (rc < 0) {
+			error("Couldn't remove old data from %s table", table);
+			return SLURM_ERROR;
+		} else if (mysql_db_commit(mysql_conn)) {
+			error("Couldn't commit purge of %s table", table);
+			return SLURM_ERROR;
+		}
+		purged += rc;
+		END_TIMER;
+
+		/*
+		 * Leave the table to other queries for as long as we held it,
+		 * so the purge uses at most half of the database time.
+		 */
+		usleep(MIN(DELTA_TIMER, PURGE_MAX_DELAY));
+	}
+
+	return purged;
+}
+
+/* Compress a section and append it to the archive file */
+static int _write_archive_section(int fd, buf_t *buffer)
+{
+	uint32_t hdr[3], flags = 0;
+	uint32_t raw_size = get_buf_offset(buffer), stored_size = raw_size;
+	char *stored = get_buf_data(buffer), *lz4_data = NULL;
+	off_t offset = lseek(fd, 0, SEEK_CUR);
+#if HAVE_LZ4
+	int bound = LZ4_compressBound(raw_size), lz4_size;
+
+	lz4_data = xmalloc_nz(bound);
+	lz4_size = LZ4_compress_default(stored, lz4_data, raw_size, bound);
+	if ((lz4_size > 0) && (lz4_size < raw_size)) {
+		flags |= ARCHIVE_SECTION_LZ4;
+		stored = lz4_data;
+		stored_size = lz4_size;
+	}
+#endif
+
+	hdr[0] = htonl(flags);
+	hdr[1] = htonl(raw_size);
+	hdr[2] = htonl(stored_size);
+	safe_write(fd, hdr, sizeof(hdr));
+	safe_write(fd, stored, stored_size);
+	if (fsync(fd) < 0)
+		goto rwfail;
+
+	xfree(lz4_data);
+	return SLURM_SUCCESS;
+
+rwfail:
+	error("Error writing archive section: %m");
+	/* Don't leave a partial section behind */
+	if ((offset >= 0) && ftruncate(fd, offset))
+		error("Unable to truncate archive file: %m");
+	xfree(lz4_data);
+	return SLURM_ERROR;
+}
+
+static void *_archive_writer(void *arg)
+{
+	archive_writer_t *writer = arg;
 	buf_t *buffer;
-	int error_code = 0;
+	int rc;
+
+	slurm_mutex_lock(&writer->mutex);
+	while (1) {
+		while (!writer->buffer && !writer->shutdown)
+			slurm_cond_wait(&writer->cond, &writer->mutex);
+		if (!(buffer = writer->buffer))
+			break;
+		slurm_mutex_unlock(&writer->mutex);
+
+		rc = _write_archive_section(writer->fd, buffer);
+
+		slurm_mutex_lock(&writer->mutex);
+		free_buf(writer->buffer);
+		writer->buffer = NULL;
+		if (rc == SLURM_SUCCESS)
+			writer->sections++;
+		else
+			writer->rc = rc;
+		slurm_cond_broadcast(&writer->cond);
+	}
+	slurm_mutex_unlock(&writer->mutex);
+
+	return NULL;
+}
+
+static int _archive_writer_start(archive_writer_t *writer, char *cluster_name,
+				 time_t period_start, time_t period_end,
+				 char *arch_dir, char *arch_type,
+				 uint32_t archive_period)
+{
+	uint32_t magic = htonl(ARCHIVE_MAGIC);
+
+	writer->fd = archive_open_file(cluster_name, period_start, period_end,
+				       arch_dir, arch_type, archive_period,
+				       &writer->file_name);
+	if (writer->fd < 0)
+		return SLURM_ERROR;
+
+	safe_write(writer->fd, &magic, sizeof(magic));
+
+	slurm_mutex_init(&writer->mutex);
+	slurm_cond_init(&writer->cond, NULL);
+	slurm_thread_create(&writer->tid, _archive_writer, writer);
+
+	return SLURM_SUCCESS;
+
+rwfail:
+	error("Error writing archive file %s: %m", writer->file_name);
+	(void) close(writer->fd);
+	(void) unlink(writer->file_name);
+	xfree(writer->file_name);
+	writer->fd = -1;
+	return SLURM_ERROR;
+}
+
+/* Hand a section to the writer, the previous one must be done */
+static void _archive_writer_submit(archive_writer_t *writer, buf_t *buffer)
+{
+	slurm_mutex_lock(&writer->mutex);
+	xassert(!writer->buffer);
+	writer->buffer = buffer;
+	slurm_cond_broadcast(&writer->cond);
+	slurm_mutex_unlock(&writer->mutex);
+}
+
+/* Wait until the last section handed to the writer is on disk */
+static int _archive_writer_wait(archive_writer_t *writer)
+{
+	int rc;
+
+	slurm_mutex_lock(&writer->mutex);
+	while (writer->buffer)
+		slurm_cond_wait(&writer->cond, &writer->mutex);
+	rc = writer->rc;
+	slurm_mutex_unlock(&writer->mutex);
+
+	return rc;
+}
+
+static void _archive_writer_stop(archive_writer_t *writer)
+{
+	if (writer->fd < 0)
+		return;
+
+	slurm_mutex_lock(&writer->mutex);
+	writer->shutdown = true;
+	slurm_cond_broadcast(&writer->cond);
+	slurm_mutex_unlock(&writer->mutex);
+	pthread_join(writer->tid, NULL);
+
+	(void) close(writer->fd);
+	if (!writer->sections)
+		(void) unlink(writer->file_name);
+	xfree(writer->file_name);
+	slurm_mutex_destroy(&writer->mutex);
+	slurm_cond_destroy(&writer->cond);
+	writer->fd = -1;
+}
+
+static int _count_cols(char *cols)
+{
+	int cnt = 1;
+
+	while ((cols = strchr(cols, ','))) {
+		cols++;
+		cnt++;
+	}
+
+	return cnt;
+}
+
+/*
+ * Archive and purge the records of a table up to period_end.
+ *
+ * Records are read in chunks of ARCHIVE_CHUNK_SIZE ordered by the keyset of
+ * the table, each chunk continuing after the last key of the previous one.
+ * When archiving, each chunk is packed into a section of the archive file
+ * which is compressed and written by a separate thread while the next chunk
+ * is read, and a chunk is only purged once its section is on disk. Chunks
+ * are purged by primary key in batches of PURGE_BATCH_SIZE records.
+ *
+ * An interrupted archive leaves every purged record in a complete section,
+ * and the next run starts again with the oldest record left.
+ *
+ * Returns the number of records purged or SLURM_ERROR on error.
+ */
+static int _archive_purge_period(purge_type_t type, mysql_conn_t *mysql_conn,
+				 char *cluster_name, char *sql_table,
+				 char *col_name, time_t period_end,
+				 char *arch_dir, uint32_t archive_period,
+				 uint32_t usage_info)
+{
+	MYSQL_RES *result = NULL;
+	MYSQL_ROW row;
+	archive_writer_t writer;
+	List batches = NULL, prev_batches = NULL, tmp_list;
+	char *cols = NULL, *query = NULL, *table = NULL, *where = NULL;
+	char *keyset = NULL, *keys = NULL, *keys_pos = NULL;
+	char *order = archive_keys[type].order, *pk = archive_keys[type].pk;
+	int fields, i, key_cnt, pk_cnt, rc = SLURM_SUCCESS, purged = 0;
+	uint32_t cnt, in_batch;
+	time_t period_start;
+	buf_t *buffer = NULL;
 	buf_t *(*pack_func)(MYSQL_RES *result, char *cluster_name,
 			    uint32_t cnt, uint32_t usage_info,
-			    time_t *period_start);
+			    time_t *period_start) = NULL;
 
-	cols = _get_archive_columns(type);
+	memset(&writer, 0, sizeof(writer));
+	writer.fd = -1;
 
-	switch (type) {
-	case PURGE_EVENT:
-		pack_func = &_pack_archive_events;
-		break;
-	case PURGE_SUSPEND:
-		pack_func = &_pack_archive_suspends;
-		break;
-	case PURGE_RESV:
-		pack_func = &_pack_archive_resvs;
-		break;
-	case PURGE_JOB:
-		pack_func = &_pack_archive_jobs;
-		break;
-	case PURGE_STEP:
-		pack_func = &_pack_archive_steps;
-		break;
-	case PURGE_TXN:
-		pack_func = &_pack_archive_txns;
-		break;
-	case PURGE_USAGE:
-		pack_func = &_pack_archive_usage;
-		break;
-	case PURGE_CLUSTER_USAGE:
-		pack_func = &_pack_archive_cluster_usage;
-		break;
-	default:
-		fatal("Unknown purge type: %d", type);
-		return SLURM_ERROR;
+	if (arch_dir) {
+		switch (type) {
+		case PURGE_EVENT:
+			pack_func = &_pack_archive_events;
+			break;
+		case PURGE_SUSPEND:
+			pack_func = &_pack_archive_suspends;
+			break;
+		case PURGE_RESV:
+			pack_func = &_pack_archive_resvs;
+			break;
+		case PURGE_JOB:
+			pack_func = &_pack_archive_jobs;
+			break;
+		case PURGE_STEP:
+			pack_func = &_pack_archive_steps;
+			break;
+		case PURGE_TXN:
+			pack_func = &_pack_archive_txns;
+			break;
+		case PURGE_USAGE:
+			pack_func = &_pack_archive_usage;
+			break;
+		case PURGE_CLUSTER_USAGE:
+			pack_func = &_pack_archive_cluster_usage;
+			break;
+		default:
+			fatal("Unknown purge type: %d", type);
+			return SLURM_ERROR;
+		}
+		cols = _get_archive_columns(type);
+		xstrcat(cols, ", ");
 	}
 
+	/*
+	 * The where clause must be the same as the one of
+	 * _get_oldest_record().
+	 */
 	switch (type) {
 	case PURGE_TXN:
-		query = xstrdup_printf("select %s from \"%s\" where "
-				       "timestamp <= %ld && cluster='%s' "
-				       "order by timestamp asc LIMIT %d",
-				       cols, sql_table,
-				       period_end, cluster_name,
-				       MAX_PURGE_LIMIT);
+		xstrfmtcat(table, "\"%s\"", sql_table);
+		xstrfmtcat(where, "%s <= %ld && cluster='%s'",
+			   col_name, period_end, cluster_name);
 		break;
 	case PURGE_USAGE:
 	case PURGE_CLUSTER_USAGE:
-		query = xstrdup_printf("select %s from \"%s_%s\" where "
-				       "time_start <= %ld "
-				       "order by time_start asc LIMIT %d",
-				       cols, cluster_name, sql_table,
-				       period_end, MAX_PURGE_LIMIT);
-		break;
-	case PURGE_JOB:
-		query = xstrdup_printf("select %s from \"%s_%s\" where "
-				       "time_submit <= %ld && time_end != 0 "
-				       "order by time_submit asc LIMIT %d",
-				       cols, cluster_name, job_table,
-				       period_end, MAX_PURGE_LIMIT);
+		xstrfmtcat(table, "\"%s_%s\"", cluster_name, sql_table);
+		xstrfmtcat(where, "%s <= %ld", col_name, period_end);
 		break;
 	default:
-		query = xstrdup_printf("select %s from \"%s_%s\" where "
-				       "time_start <= %ld && time_end != 0 "
-				       "order by time_start asc LIMIT %d",
-				       cols, cluster_name, sql_table,
-				       period_end, MAX_PURGE_LIMIT);
+		xstrfmtcat(table, "\"%s_%s\"", cluster_name, sql_table);
+		xstrfmtcat(where, "%s <= %ld && time_end != 0",
+			   col_name, period_end);
 		break;
 	}
 
-	xfree(cols);
+	/* The keyset and primary key are selected after the archive columns */
+	key_cnt = _count_cols(order);
+	pk_cnt = _count_cols(pk);
 
-	DB_DEBUG(DB_ARCHIVE, mysql_conn->conn, "query\n%s", query);
-	if (!(result = mysql_db_query_ret(mysql_conn, query, 0))) {
+	while (1) {
+		query = xstrdup_printf("select %s%s, %s from %s where %s%s "
+				       "order by %s LIMIT %d",
+				       cols ? cols : "", order, pk, table,
+				       where, keyset ? keyset : "", order,
+				       ARCHIVE_CHUNK_SIZE);
+		DB_DEBUG(DB_ARCHIVE, mysql_conn->conn, "query\n%s", query);
+		if (!(result = mysql_db_query_ret(mysql_conn, query, 0))) {
+			xfree(query);
+			rc = SLURM_ERROR;
+			break;
+		}
 		xfree(query);
-		return SLURM_ERROR;
-	}
-	xfree(query);
 
-	if (!(cnt = mysql_num_rows(result))) {
+		if ((cnt = mysql_num_rows(result))) {
+			fields = mysql_num_fields(result);
+
+			batches = list_create(xfree_ptr);
+			in_batch = 0;
+			while ((row = mysql_fetch_row(result))) {
+				xstrfmtcatat(keys, &keys_pos, "%s('%s'",
+					     in_batch ? ", " : "",
+					     row[fields - pk_cnt]);
+				for (i = fields - pk_cnt + 1; i < fields; i++)
+					xstrfmtcatat(keys, &keys_pos, ", '%s'",
+						     row[i]);
+				xstrfmtcatat(keys, &keys_pos, ")");
+				if (++in_batch == PURGE_BATCH_SIZE) {
+					list_append(batches, keys);
+					keys = keys_pos = NULL;
+					in_batch = 0;
+				}
+			}
+			if (keys) {
+				list_append(batches, keys);
+				keys = keys_pos = NULL;
+			}
+
+			/* The next chunk starts after the last record */
+			mysql_data_seek(result, cnt - 1);
+			row = mysql_fetch_row(result);
+			i = fields - pk_cnt - key_cnt;
+			xfree(keyset);
+			xstrfmtcat(keyset, " && %s >= '%s' && (%s) > ('%s'",
+				   col_name, row[i], order, row[i]);
+			for (i++; i < (fields - pk_cnt); i++)
+				xstrfmtcat(keyset, ", '%s'", row[i]);
+			xstrcat(keyset, ")");
+
+			if (pack_func) {
+				mysql_data_seek(result, 0);
+				period_start = 0;
+				buffer = (*pack_func)(result, cluster_name, cnt,
+						      usage_info,
+						      &period_start);
+			}
+		}
 		mysql_free_result(result);
-		return 0;
-	}
 
-	buffer = (*pack_func)(result, cluster_name, cnt, usage_info,
-			      &period_start);
-	mysql_free_result(result);
+		if (pack_func) {
+			/*
+			 * The section of the previous chunk has to be on disk
+			 * before its records are purged.
+			 */
+			if ((writer.fd >= 0) &&
+			    (rc = _archive_writer_wait(&writer)))
+				break;
+			if (buffer) {
+				if ((writer.fd < 0) &&
+				    (rc = _archive_writer_start(
+					    &writer, cluster_name,
+					    period_start, period_end,
+					    arch_dir, sql_table,
+					    archive_period)))
+					break;
+				_archive_writer_submit(&writer, buffer);
+				buffer = NULL;
+			}
+			/* Purge the previous chunk, keep this one for later */
+			tmp_list = prev_batches;
+			prev_batches = batches;
+			batches = tmp_list;
+		}
 
-	error_code = archive_write_file(buffer, cluster_name,
-					period_start, period_end,
-					arch_dir, sql_table,
-					archive_period);
-	free_buf(buffer);
+		if (batches) {
+			rc = _purge_chunk(mysql_conn, table, pk, batches);
+			FREE_NULL_LIST(batches);
+			if (rc == SLURM_ERROR)
+				break;
+			purged += rc;
+			rc = SLURM_SUCCESS;
+		}
 
-	if (error_code != SLURM_SUCCESS)
-		return error_code;
+		if (!cnt)
+			break;
+	}
 
-	return cnt;
+	_archive_writer_stop(&writer);
+	FREE_NULL_BUFFER(buffer);
+	FREE_NULL_LIST(batches);
+	FREE_NULL_LIST(prev_batches);
+	xfree(cols);
+	xfree(keyset);
+	xfree(table);
+	xfree(where);
+
+	if (rc != SLURM_SUCCESS)
+		return SLURM_ERROR;
+
+	return purged;
 }
 
 uint32_t _get_begin_next_month(time_t start)
@@ -4192,8 +4533,7 @@ static int _archive_purge_table(purge_type_t purge_type, uint32_t usage_info,
 	uint16_t type, period;
 	time_t   last_submit = time(NULL);
 	time_t   curr_end    = 0, tmp_end = 0, record_start = 0;
-	char    *query = NULL, *sql_table = NULL,
-		*col_name = NULL;
+	char    *sql_table = NULL, *col_name = NULL;
 	uint32_t tmp_archive_period;
 
 	switch (purge_type) {
@@ -4330,80 +4670,18 @@ static int _archive_purge_table(purge_type_t purge_type, uint32_t usage_info,
 		log_flag(DB_ARCHIVE, "Purging %s_%s before %ld",
 			 cluster_name, sql_table, tmp_end);
 
-		/* Do archive */
-		if (SLURMDB_PURGE_ARCHIVE_SET(purge_attr)) {
-			rc = _archive_table(purge_type, mysql_conn,
-					    cluster_name, tmp_end,
-					    arch_cond->archive_dir,
-					    tmp_archive_period,
-					    sql_table, usage_info);
-			if (!rc) { /* no records archived */
-				error("%s: No records archived for %s before %ld but we found some records",
-				      __func__, sql_table, tmp_end);
-				return SLURM_ERROR;
-			} else if (rc == SLURM_ERROR)
-				return rc;
-		}
-
-		/*
-		 * The purge query should have the same where clause as the
-		 * archive query. The order by is very important so we get
-		 * records in the same order as we do when archiving, since we
-		 * only want to delete records that have been archived (if
-		 * archiving is enabled).
-		 */
-		switch (purge_type) {
-		case PURGE_TXN:
-			query = xstrdup_printf(
-				"delete from \"%s\" where "
-				"%s <= %ld && cluster='%s' order by %s asc LIMIT %d",
-				sql_table, col_name, tmp_end, cluster_name,
-				col_name, MAX_PURGE_LIMIT);
-			break;
-		case PURGE_USAGE:
-		case PURGE_CLUSTER_USAGE:
-			query = xstrdup_printf(
-				"delete from \"%s_%s\" where "
-				"%s <= %ld order by %s asc LIMIT %d",
-				cluster_name, sql_table, col_name,
-				tmp_end, col_name, MAX_PURGE_LIMIT);
-			break;
-		default:
-			query = xstrdup_printf(
-				"delete from \"%s_%s\" where "
-				"%s <= %ld && time_end != 0 order by %s asc LIMIT %d",
-				cluster_name, sql_table, col_name,
-				tmp_end, col_name, MAX_PURGE_LIMIT);
-			break;
-		}
-		DB_DEBUG(DB_ARCHIVE, mysql_conn->conn, "query\n%s", query);
-
-		/*
-		 * Don't loop this query, just do it once, since we are only
-		 * archiving and purging MAX_PURGE_LIMIT rows at a time.
-		 * mysql_db_delete_affected_rows will return < 0 on failure or
-		 * 0 if no records are affected.
-		 */
-		if ((rc = mysql_db_delete_affected_rows(
-				mysql_conn, query)) > 0) {
-			/* Commit here every time since this could create a huge
-			 * transaction.
-			 */
-			if ((rc = mysql_db_commit(mysql_conn)))
-				error("Couldn't commit cluster (%s) purge",
-				      cluster_name);
-		}
-
-		xfree(query);
-		if (rc != SLURM_SUCCESS) {
-			error("Couldn't remove old data from %s table",
-			      sql_table);
+		rc = _archive_purge_period(
+			purge_type, mysql_conn, cluster_name, sql_table,
+			col_name, tmp_end,
+			SLURMDB_PURGE_ARCHIVE_SET(purge_attr) ?
+			arch_cond->archive_dir : NULL,
+			tmp_archive_period, usage_info);
+		if (!rc) { /* no records purged */
+			error("%s: No records purged for %s before %ld but we found some records",
+			      __func__, sql_table, tmp_end);
 			return SLURM_ERROR;
-		} else if (mysql_db_commit(mysql_conn)) {
-			error("Couldn't commit cluster (%s) purge",
-			      cluster_name);
-			break;
-		}
+		} else if (rc == SLURM_ERROR)
+			return rc;
 	}
 
 	return SLURM_SUCCESS;
@@ -4467,20 +4745,24 @@ static int _execute_archive(mysql_conn_t *mysql_conn,
 				     PURGE_USAGE,
 				     usage_info + DBD_GOT_ASSOC_USAGE,
 				     mysql_conn, cluster_name, arch_cond)))
-			return rc;
+				break;
 
 			if ((rc = _archive_purge_table(
 				     PURGE_USAGE,
 				     usage_info + DBD_GOT_WCKEY_USAGE,
 				     mysql_conn, cluster_name, arch_cond)))
-			return rc;
+				break;
 
 			if ((rc = _archive_purge_table(
 				     PURGE_CLUSTER_USAGE,
 				     usage_info + DBD_GOT_CLUSTER_USAGE,
 				     mysql_conn, cluster_name, arch_cond)))
-			return rc;
+				break;
 		}
+		/* Some usage may be gone even if a table failed */
+		as_mysql_usage_cache_clear(cluster_name);
+		if (rc)
+			return rc;
 	}
 
 	return SLURM_SUCCESS;
@@ -4533,91 +4815,16 @@ extern int as_mysql_jobacct_process_archive(mysql_conn_t *mysql_conn,
 	return rc;
 }
 
-extern int as_mysql_jobacct_process_archive_load(
-	mysql_conn_t *mysql_conn, slurmdb_archive_rec_t *arch_rec)
+/* Load the records of an archive buffer, returns SLURM_SUCCESS or error */
+static int _load_archive_buffer(mysql_conn_t *mysql_conn, buf_t *buffer)
 {
 	char *data = NULL, *cluster_name = NULL;
 	int error_code = SLURM_SUCCESS;
-	buf_t *buffer = NULL;
 	time_t buf_time;
 	uint16_t type = 0, ver = 0, period = 0;
-	uint32_t data_size = 0, rec_cnt = 0, tmp32 = 0;
+	uint32_t rec_cnt = 0, tmp32 = 0;
 	uint32_t rec_cnt_total = 0, rec_cnt_left = 0, pass_cnt = 0;
 
-	/* Ensure that the connection is not set in autocommit mode. */
-	xassert(mysql_conn->rollback);
-
-	if (!arch_rec) {
-		error("We need a slurmdb_archive_rec to load anything.");
-		return SLURM_ERROR;
-	}
-
-	if (arch_rec->insert) {
-		data = xstrdup(arch_rec->insert);
-	} else if (arch_rec->archive_file) {
-		int data_allocated, data_read = 0;
-		int state_fd = open(arch_rec->archive_file, O_RDONLY);
-		if (state_fd < 0) {
-			info("Could not open archive file `%s`: %m",
-			     arch_rec->archive_file);
-			error_code = errno;
-		} else {
-			data_allocated = BUF_SIZE + 1;
-			data = xmalloc_nz(data_allocated);
-			while (1) {
-				data_read = read(state_fd, &data[data_size],
-						 BUF_SIZE);
-				if (data_read < 0) {
-					data[data_size] = '\0';
-					if (errno == EINTR)
-						continue;
-					else {
-						error("Read error on %s: %m",
-						      arch_rec->archive_file);
-						break;
-					}
-				}
-				data[data_size + data_read] = '\0';
-				if (data_read == 0)	/* eof */
-					break;
-				data_size      += data_read;
-				data_allocated += data_read;
-				xrealloc_nz(data, data_allocated);
-			}
-			close(state_fd);
-		}
-		if (error_code != SLURM_SUCCESS) {
-			xfree(data);
-			return error_code;
-		}
-	} else {
-		error("Nothing was set in your "
-		      "slurmdb_archive_rec so I am unable to process.");
-		xfree(data);
-		return SLURM_ERROR;
-	}
-
-	if (!data) {
-		error("It doesn't appear we have anything to load.");
-		return SLURM_ERROR;
-	}
-
-	/*
-	 * this is the old version of an archive file where the file
-	 * was straight sql.
-	 */
-	if ((strlen(data) >= 12)
-	    && (!xstrncmp("insert into ", data, 12)
-		|| !xstrncmp("delete from ", data, 12)
-		|| !xstrncmp("drop table ", data, 11)
-		|| !xstrncmp("truncate table ", data, 15))) {
-		_process_old_sql(&data);
-		goto got_sql;
-	}
-
-	buffer = create_buf(data, data_size);
-	data = NULL;	/* Moved to "buffer" */
-
 	safe_unpack16(&ver, buffer);
 	DB_DEBUG(DB_ARCHIVE, mysql_conn->conn,
 	         "Version in archive header is %u", ver);
@@ -4632,7 +4839,6 @@ extern int as_mysql_jobacct_process_archive_load(
 		      "got %u need <= %u", ver,
 		      SLURM_PROTOCOL_VERSION);
 		error("***********************************************");
-		FREE_NULL_BUFFER(buffer);
 		return EFAULT;
 	}
 	safe_unpack_time(&buf_time, buffer);
@@ -4718,6 +4924,228 @@ unpack_error:
 
 cleanup:
 	xfree(cluster_name);
+
+	return error_code;
+}
+
+/* Read up to size bytes, RET bytes read (less only at EOF) or -1 on error */
+static ssize_t _read_archive(int fd, void *buf, size_t size)
+{
+	ssize_t rd;
+	size_t total = 0;
+
+	while (total < size) {
+		rd = read(fd, (char *) buf + total, size - total);
+		if (rd < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		} else if (!rd)
+			break;
+		total += rd;
+	}
+
+	return total;
+}
+
+/*
+ * Load an archive file made of sections, one section at a time. A section
+ * cut short by an interrupted archive is ignored, its records were not
+ * purged.
+ */
+static int _load_archive_sections(mysql_conn_t *mysql_conn, int fd,
+				  char *file_name)
+{
+	uint32_t hdr[3], flags, raw_size, stored_size, sections = 0;
+	char *raw = NULL, *stored = NULL;
+	buf_t *buffer;
+	ssize_t rd;
+	int rc = SLURM_SUCCESS;
+
+	while ((rd = _read_archive(fd, hdr, sizeof(hdr)))) {
+		if (rd < 0) {
+			error("Read error on %s: %m", file_name);
+			rc = SLURM_ERROR;
+			break;
+		} else if (rd != sizeof(hdr)) {
+			error("Ignoring truncated section at the end of %s",
+			      file_name);
+			break;
+		}
+
+		flags = ntohl(hdr[0]);
+		raw_size = ntohl(hdr[1]);
+		stored_size = ntohl(hdr[2]);
+		if (!raw_size || !stored_size || (raw_size > MAX_BUF_SIZE) ||
+		    (stored_size > raw_size)) {
+			error("Invalid section %u in %s", sections, file_name);
+			rc = SLURM_ERROR;
+			break;
+		}
+
+		stored = xmalloc_nz(stored_size);
+		if ((rd = _read_archive(fd, stored, stored_size)) < 0) {
+			error("Read error on %s: %m", file_name);
+			rc = SLURM_ERROR;
+			break;
+		} else if (rd != stored_size) {
+			error("Ignoring truncated section at the end of %s",
+			      file_name);
+			break;
+		}
+
+		if (flags & ARCHIVE_SECTION_LZ4) {
+#if HAVE_LZ4
+			raw = xmalloc_nz(raw_size);
+			if (LZ4_decompress_safe(stored, raw, stored_size,
+						raw_size) != raw_size) {
+				error("lz4 decompression error in section %u of %s",
+				      sections, file_name);
+				rc = SLURM_ERROR;
+				break;
+			}
+			xfree(stored);
+#else
+			error("%s is lz4 compressed, lz4 is not supported",
+			      file_name);
+			rc = SLURM_ERROR;
+			break;
+#endif
+		} else {
+			raw = stored;
+			stored = NULL;
+		}
+
+		buffer = create_buf(raw, raw_size);
+		raw = NULL;	/* Moved to "buffer" */
+		rc = _load_archive_buffer(mysql_conn, buffer);
+		free_buf(buffer);
+		if (rc != SLURM_SUCCESS)
+			break;
+		sections++;
+	}
+
+	xfree(raw);
+	xfree(stored);
+
+	if ((rc == SLURM_SUCCESS) && !sections) {
+		error("It doesn't appear we have anything to load.");
+		rc = SLURM_ERROR;
+	}
+
+	return rc;
+}
+
+extern int as_mysql_jobacct_process_archive_load(
+	mysql_conn_t *mysql_conn, slurmdb_archive_rec_t *arch_rec)
+{
+	char *data = NULL;
+	int error_code = SLURM_SUCCESS;
+	buf_t *buffer = NULL;
+	uint32_t data_size = 0, magic = 0;
+
+	/* Ensure that the connection is not set in autocommit mode. */
+	xassert(mysql_conn->rollback);
+
+	/* Usage may be loaded for any cluster */
+	as_mysql_usage_cache_clear_on_commit(mysql_conn, NULL);
+
+	if (!arch_rec) {
+		error("We need a slurmdb_archive_rec to load anything.");
+		return SLURM_ERROR;
+	}
+
+	if (arch_rec->insert) {
+		data = xstrdup(arch_rec->insert);
+	} else if (arch_rec->archive_file) {
+		int data_allocated, data_read = 0;
+		int state_fd = open(arch_rec->archive_file, O_RDONLY);
+		if (state_fd < 0) {
+			info("Could not open archive file `%s`: %m",
+			     arch_rec->archive_file);
+			error_code = errno;
+		} else if ((_read_archive(state_fd, &magic, sizeof(magic)) ==
+			    sizeof(magic)) && (ntohl(magic) == ARCHIVE_MAGIC)) {
+			error_code = _load_archive_sections(
+				mysql_conn, state_fd, arch_rec->archive_file);
+			close(state_fd);
+			goto cleanup;
+		} else if (lseek(state_fd, 0, SEEK_SET) < 0) {
+			error("Unable to seek in %s: %m",
+			      arch_rec->archive_file);
+			error_code = errno;
+			close(state_fd);
+		} else {
+			data_allocated = BUF_SIZE + 1;
+			data = xmalloc_nz(data_allocated);
+			while (1) {
+				data_read = read(state_fd, &data[data_size],
+						 BUF_SIZE);
+				if (data_read < 0) {
+					data[data_size] = '\0';
+					if (errno == EINTR)
+						continue;
+					else {
+						error("Read error on %s: %m",
+						      arch_rec->archive_file);
+						break;
+					}
+				}
+				data[data_size + data_read] = '\0';
+				if (data_read == 0)	/* eof */
+					break;
+				data_size      += data_read;
+				data_allocated += data_read;
+				xrealloc_nz(data, data_allocated);
+			}
+			close(state_fd);
+		}
+		if (error_code != SLURM_SUCCESS) {
+			xfree(data);
+			return error_code;
+		}
+	} else {
+		error("Nothing was set in your "
+		      "slurmdb_archive_rec so I am unable to process.");
+		xfree(data);
+		return SLURM_ERROR;
+	}
+
+	if (!data) {
+		error("It doesn't appear we have anything to load.");
+		return SLURM_ERROR;
+	}
+
+	/*
+	 * this is the old version of an archive file where the file
+	 * was straight sql.
+	 */
+	if ((strlen(data) >= 12)
+	    && (!xstrncmp("insert into ", data, 12)
+		|| !xstrncmp("delete from ", data, 12)
+		|| !xstrncmp("drop table ", data, 11)
+		|| !xstrncmp("truncate table ", data, 15))) {
+		_process_old_sql(&data);
+		if (!data) {
+			error("No data to load");
+			error_code = SLURM_ERROR;
+			goto cleanup;
+		}
+		if (slurm_conf.debug_flags & DEBUG_FLAG_DB_ARCHIVE)
+			DB_DEBUG(DB_QUERY, mysql_conn->conn, "query\n%s", data);
+		error_code = mysql_db_query_check_after(mysql_conn, data);
+		xfree(data);
+		if (error_code != SLURM_SUCCESS)
+			error("Couldn't load old data");
+		goto cleanup;
+	}
+
+	buffer = create_buf(data, data_size);
+	data = NULL;	/* Moved to "buffer" */
+
+	error_code = _load_archive_buffer(mysql_conn, buffer);
+
+cleanup:
 	FREE_NULL_BUFFER(buffer);
 
 	if (error_code)
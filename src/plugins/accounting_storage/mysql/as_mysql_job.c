@@ -50,6 +50,22 @@
 
 #define MAX_FLUSH_JOBS 500
 
+/*
+ * Update clause of the step start inserts, a submit_line or container only
+ * replaces the stored one when set.
+ */
+static char *step_start_suffix =
+	" on duplicate key update "
+	"nodes_alloc=VALUES(nodes_alloc), task_cnt=VALUES(task_cnt), "
+	"time_end=0, state=VALUES(state), nodelist=VALUES(nodelist), "
+	"node_inx=VALUES(node_inx), task_dist=VALUES(task_dist), "
+	"req_cpufreq=VALUES(req_cpufreq), "
+	"req_cpufreq_min=VALUES(req_cpufreq_min), "
+	"req_cpufreq_gov=VALUES(req_cpufreq_gov), "
+	"tres_alloc=VALUES(tres_alloc), "
+	"submit_line=IFNULL(VALUES(submit_line), submit_line), "
+	"container=IFNULL(VALUES(container), container)";
+
 typedef struct {
 	char *cluster;
 	uint32_t new;
@@ -1168,7 +1184,7 @@ extern int as_mysql_step_start(mysql_conn_t *mysql_conn,
 	char *node_list = NULL;
 	char *node_inx = NULL;
 	time_t start_time, submit_time;
-	char *query = NULL;
+	char *header = NULL, *query = NULL;
 
 	if (!step_ptr->job_ptr->db_index
 	    && ((!step_ptr->job_ptr->details
@@ -1267,24 +1283,23 @@ extern int as_mysql_step_start(mysql_conn_t *mysql_conn,
 		}
 	}
 
-	/* we want to print a -1 for the requid so leave it a
-	   %d */
-	/* The stepid could be negative so use %d not %u */
-	query = xstrdup_printf(
+	/*
+	 * Every step is written with the same columns and update clause so
+	 * the rows of a batch can be merged into a single insert, see
+	 * mysql_db_batch_query().
+	 */
+	header = xstrdup_printf(
 		"insert into \"%s_%s\" (job_db_inx, id_step, step_het_comp, "
 		"time_start, step_name, state, tres_alloc, "
 		"nodes_alloc, task_cnt, nodelist, node_inx, "
-		"task_dist, req_cpufreq, req_cpufreq_min, req_cpufreq_gov",
+		"task_dist, req_cpufreq, req_cpufreq_min, req_cpufreq_gov, "
+		"submit_line, container) values ",
 		mysql_conn->cluster_name, step_table);
 
-	if (step_ptr->submit_line)
-		xstrcat(query, ", submit_line");
-	if (step_ptr->container)
-		xstrcat(query, ", container");
-
+	/* The stepid could be negative so use %d not %u */
 	xstrfmtcat(query,
-		   ") values (%"PRIu64", %d, %u, %d, '%s', %d, '%s', %d, %d, "
-		   "'%s', '%s', %d, %u, %u, %u",
+		   "(%"PRIu64", %d, %u, %d, '%s', %d, '%s', %d, %d, "
+		   "'%s', '%s', %d, %u, %u, %u, ",
 		   step_ptr->job_ptr->db_index,
 		   step_ptr->step_id.step_id,
 		   step_ptr->step_id.step_het_comp,
@@ -1295,29 +1310,19 @@ extern int as_mysql_step_start(mysql_conn_t *mysql_conn,
 		   step_ptr->cpu_freq_gov);
 
 	if (step_ptr->submit_line)
-		xstrfmtcat(query, ", '%s'", step_ptr->submit_line);
-	if (step_ptr->container)
-		xstrfmtcat(query, ", '%s'", step_ptr->container);
-
-	xstrfmtcat(query,
-		   ") on duplicate key update "
-		   "nodes_alloc=%d, task_cnt=%d, time_end=0, state=%d, "
-		   "nodelist='%s', node_inx='%s', task_dist=%d, "
-		   "req_cpufreq=%u, req_cpufreq_min=%u, req_cpufreq_gov=%u,"
-		   "tres_alloc='%s'",
-		   nodes, tasks, JOB_RUNNING,
-		   node_list, node_inx, task_dist, step_ptr->cpu_freq_max,
-		   step_ptr->cpu_freq_min, step_ptr->cpu_freq_gov,
-		   step_ptr->tres_alloc_str);
-
-	if (step_ptr->submit_line)
-		xstrfmtcat(query, ", submit_line='%s'", step_ptr->submit_line);
-
+		xstrfmtcat(query, "'%s', ", step_ptr->submit_line);
+	else
+		xstrcat(query, "NULL, ");
 	if (step_ptr->container)
-		xstrfmtcat(query, ", container='%s'", step_ptr->container);
+		xstrfmtcat(query, "'%s')", step_ptr->container);
+	else
+		xstrcat(query, "NULL)");
 
-	DB_DEBUG(DB_STEP, mysql_conn->conn, "query\n%s", query);
-	rc = mysql_db_query(mysql_conn, query);
+	DB_DEBUG(DB_STEP, mysql_conn->conn, "query\n%s%s%s",
+		 header, query, step_start_suffix);
+	rc = mysql_db_batch_query(mysql_conn, header, query,
+				  step_start_suffix);
+	xfree(header);
 	xfree(query);
 
 	return rc;
@@ -1566,7 +1571,7 @@ extern int as_mysql_step_complete(mysql_conn_t *mysql_conn,
 		   step_ptr->job_ptr->db_index, step_ptr->step_id.step_id,
 		   step_ptr->step_id.step_het_comp);
 	DB_DEBUG(DB_STEP, mysql_conn->conn, "query\n%s", query);
-	rc = mysql_db_query(mysql_conn, query);
+	rc = mysql_db_batch_query(mysql_conn, NULL, query, NULL);
 	xfree(query);
 
 	/* set the energy for the entire job. */
@@ -1578,7 +1583,7 @@ extern int as_mysql_step_complete(mysql_conn_t *mysql_conn,
 			step_ptr->job_ptr->tres_alloc_str,
 			step_ptr->job_ptr->db_index);
 		DB_DEBUG(DB_STEP, mysql_conn->conn, "query\n%s", query);
-		rc = mysql_db_query(mysql_conn, query);
+		rc = mysql_db_batch_query(mysql_conn, NULL, query, NULL);
 		xfree(query);
 	}
 
@@ -43,6 +43,9 @@
 
 #include "as_mysql_jobacct_process.h"
 
+/* Number of job records in a chunk of a job query */
+#define JOB_CHUNK_SIZE 1000
+
 typedef struct {
 	hostlist_t hl;
 	time_t start;
@@ -50,6 +53,27 @@ typedef struct {
 	bitstr_t *asked_bitmap;
 } local_cluster_t;
 
+/* Parts of a job query common to all the clusters */
+typedef struct {
+	char *extra;
+	int is_admin;
+	char *job_fields;
+	int only_pending;
+	char *step_fields;
+	slurmdb_user_rec_t user;
+} job_query_t;
+
+/*
+ * Position of a job query returned in chunks, kept on the connection
+ * between the chunks.
+ */
+typedef struct {
+	List cluster_list;		/* clusters left, first one in use */
+	slurmdb_job_cond_t *job_cond;	/* copy of the query condition */
+	uint32_t next_id;		/* first job id of the next chunk */
+	uid_t uid;
+} job_cursor_t;
+
 /* if this changes you will need to edit the corresponding
  * enum below also t1 is job_table */
 char *job_req_inx[] = {
@@ -470,9 +494,10 @@ static int _cluster_get_jobs(mysql_conn_t *mysql_conn,
 			     char *cluster_name,
 			     char *job_fields, char *step_fields,
 			     char *sent_extra,
-			     bool is_admin, int only_pending, List sent_list)
+			     bool is_admin, int only_pending, List sent_list,
+			     uint32_t *next_id, int limit)
 {
-	char *query = NULL;
+	char *query = NULL, *tables = NULL;
 	char *extra = xstrdup(sent_extra);
 	slurm_selected_step_t *selected_step = NULL;
 	MYSQL_RES *result = NULL, *step_result = NULL;
@@ -548,6 +573,8 @@ static int _cluster_get_jobs(mysql_conn_t *mysql_conn,
 			      "so not returning any jobs.", user->name);
 			/* This user has no valid associations, so
 			 * they will not have any jobs. */
+			if (next_id)
+				*next_id = NO_VAL;
 			goto end_it;
 		}
 	}
@@ -555,23 +582,23 @@ static int _cluster_get_jobs(mysql_conn_t *mysql_conn,
 	setup_job_cluster_cond_limits(mysql_conn, job_cond,
 				      cluster_name, &extra);
 
-	query = xstrdup_printf("select %s from \"%s_%s\" as t1 "
-			       "left join \"%s_%s\" as t2 "
-			       "on t1.id_assoc=t2.id_assoc "
-			       "left join \"%s_%s\" as t3 "
-			       "on t1.id_resv=t3.id_resv && "
-			       "((t1.time_start && "
-			       "(t3.time_start < t1.time_start && "
-			       "(t3.time_end >= t1.time_start || "
-			       "t3.time_end = 0))) || "
-			       "(t1.time_start = 0 && "
-			       "((t3.time_start < t1.time_submit && "
-			       "(t3.time_end >= t1.time_submit || "
-			       "t3.time_end = 0)) || "
-			       "(t3.time_start > t1.time_submit))))",
-			       job_fields, cluster_name, job_table,
-			       cluster_name, assoc_table,
-			       cluster_name, resv_table);
+	tables = xstrdup_printf("\"%s_%s\" as t1 "
+				"left join \"%s_%s\" as t2 "
+				"on t1.id_assoc=t2.id_assoc "
+				"left join \"%s_%s\" as t3 "
+				"on t1.id_resv=t3.id_resv && "
+				"((t1.time_start && "
+				"(t3.time_start < t1.time_start && "
+				"(t3.time_end >= t1.time_start || "
+				"t3.time_end = 0))) || "
+				"(t1.time_start = 0 && "
+				"((t3.time_start < t1.time_submit && "
+				"(t3.time_end >= t1.time_submit || "
+				"t3.time_end = 0)) || "
+				"(t3.time_start > t1.time_submit))))",
+				cluster_name, job_table,
+				cluster_name, assoc_table,
+				cluster_name, resv_table);
 
 	if (job_cond->flags & JOBCOND_FLAG_RUNAWAY) {
 		if (extra)
@@ -580,6 +607,35 @@ static int _cluster_get_jobs(mysql_conn_t *mysql_conn,
 			xstrcat(extra, " where (t1.time_end=0)");
 	}
 
+	if (next_id) {
+		/*
+		 * Only get the next limit records. The chunk ends on a job
+		 * id so the records of a job, which are compared with each
+		 * other below, always come in the same chunk.
+		 */
+		xstrfmtcat(extra, "%s t1.id_job >= %u",
+			   extra ? " &&" : " where", *next_id);
+		query = xstrdup_printf("select t1.id_job from %s%s "
+				       "order by t1.id_job limit 1 offset %d",
+				       tables, extra, limit - 1);
+		DB_DEBUG(DB_JOB, mysql_conn->conn, "query\n%s", query);
+		if (!(result = mysql_db_query_ret(mysql_conn, query, 0))) {
+			xfree(extra);
+			xfree(query);
+			rc = SLURM_ERROR;
+			goto end_it;
+		}
+		xfree(query);
+		if ((row = mysql_fetch_row(result))) {
+			*next_id = slurm_atoul(row[0]);
+			xstrfmtcat(extra, " && t1.id_job <= %u", *next_id);
+			(*next_id)++;
+		} else
+			*next_id = NO_VAL;
+		mysql_free_result(result);
+	}
+
+	query = xstrdup_printf("select %s from %s", job_fields, tables);
 	if (extra) {
 		xstrcat(query, extra);
 		xfree(extra);
@@ -1134,6 +1190,7 @@ end_it:
 	if (itr2)
 		list_iterator_destroy(itr2);
 
+	xfree(tables);
 	FREE_NULL_LIST(local_cluster_list);
 
 	if (rc == SLURM_SUCCESS)
@@ -1700,49 +1757,42 @@ extern int setup_job_cond_limits(slurmdb_job_cond_t *job_cond,
 	return set;
 }
 
-extern List as_mysql_jobacct_process_get_jobs(mysql_conn_t *mysql_conn,
-					      uid_t uid,
-					      slurmdb_job_cond_t *job_cond)
+/*
+ * Set up the parts of the job query of uid common to all the clusters.
+ * RET SLURM_SUCCESS, or SLURM_ERROR if no job can be returned.
+ */
+static int _setup_job_query(mysql_conn_t *mysql_conn, uid_t uid,
+			    slurmdb_job_cond_t *job_cond,
+			    job_query_t *job_query)
 {
-	char *extra = NULL;
-	char *tmp = NULL, *tmp2 = NULL;
-	ListIterator itr = NULL;
-	int is_admin=1;
 	int i;
-	List job_list = NULL;
-	slurmdb_user_rec_t user;
-	int only_pending = 0;
-	List use_cluster_list = NULL;
-	char *cluster_name;
-	bool locked = false;
-	assoc_mgr_lock_t locks = { NO_LOCK, NO_LOCK, NO_LOCK, NO_LOCK,
-				   READ_LOCK, NO_LOCK, NO_LOCK };
 
-	memset(&user, 0, sizeof(slurmdb_user_rec_t));
-	user.uid = uid;
+	memset(job_query, 0, sizeof(job_query_t));
+	job_query->is_admin = 1;
+	job_query->user.uid = uid;
 
 	if ((slurm_conf.private_data & PRIVATE_DATA_JOBS) ||
 	    (job_cond->flags & JOBCOND_FLAG_SCRIPT) ||
 	    (job_cond->flags & JOBCOND_FLAG_ENV)) {
-		if (!(is_admin = is_user_min_admin_level(
+		if (!(job_query->is_admin = is_user_min_admin_level(
 			      mysql_conn, uid, SLURMDB_ADMIN_OPERATOR))) {
 			/*
 			 * Only fill in the coordinator accounts here we will
 			 * check them later when we actually try to get the jobs
 			 */
-			(void) is_user_any_coord(mysql_conn, &user);
+			(void) is_user_any_coord(mysql_conn, &job_query->user);
 		}
-		if (!is_admin && !user.name) {
+		if (!job_query->is_admin && !job_query->user.name) {
 			debug("User %u has no associations, and is not admin, "
-			      "so not returning any jobs.", user.uid);
-			return NULL;
+			      "so not returning any jobs.", uid);
+			return SLURM_ERROR;
 		}
 	}
 
 	if (job_cond
 	    && job_cond->state_list && (list_count(job_cond->state_list) == 1)
 	    && (slurm_atoul(list_peek(job_cond->state_list)) == JOB_PENDING))
-		only_pending = 1;
+		job_query->only_pending = 1;
 
 	if (job_cond &&
 	    (!job_cond->step_list || !list_count(job_cond->step_list))) {
@@ -1756,30 +1806,138 @@ extern List as_mysql_jobacct_process_get_jobs(mysql_conn_t *mysql_conn,
 
 		if (reason) {
 			error("User %u is requesting %s, but no job requested, this is not allowed",
-			      user.uid, reason);
-			return NULL;
+			      uid, reason);
+			return SLURM_ERROR;
 		}
 	}
 
-	setup_job_cond_limits(job_cond, &extra);
+	setup_job_cond_limits(job_cond, &job_query->extra);
 
-	xfree(tmp);
-	xstrfmtcat(tmp, "%s", job_req_inx[0]);
+	xstrfmtcat(job_query->job_fields, "%s", job_req_inx[0]);
 	for (i = 1; i < JOB_REQ_COUNT; i++) {
 		/* Only get the script if requesting it */
 		if (((i == JOB_REQ_SCRIPT) &&
 		     (!job_cond || !(job_cond->flags & JOBCOND_FLAG_SCRIPT))) ||
 		    ((i == JOB_REQ_ENV) &&
 		     (!job_cond || !(job_cond->flags & JOBCOND_FLAG_ENV))))
-			xstrcat(tmp, ", ''");
+			xstrcat(job_query->job_fields, ", ''");
 		else
-			xstrfmtcat(tmp, ", %s", job_req_inx[i]);
+			xstrfmtcat(job_query->job_fields, ", %s",
+				   job_req_inx[i]);
 	}
 
-	xfree(tmp2);
-	xstrfmtcat(tmp2, "%s", step_req_inx[0]);
+	xstrfmtcat(job_query->step_fields, "%s", step_req_inx[0]);
 	for (i = 1; i < STEP_REQ_COUNT; i++) {
-		xstrfmtcat(tmp2, ", %s", step_req_inx[i]);
+		xstrfmtcat(job_query->step_fields, ", %s", step_req_inx[i]);
+	}
+
+	return SLURM_SUCCESS;
+}
+
+static void _free_job_query(job_query_t *job_query)
+{
+	xfree(job_query->extra);
+	xfree(job_query->job_fields);
+	xfree(job_query->step_fields);
+}
+
+/*
+ * Get the jobs of a cluster, all of them if next_id is NULL, else the
+ * ones from *next_id on, see _cluster_get_jobs().
+ */
+static int _job_query_cluster(mysql_conn_t *mysql_conn,
+			      job_query_t *job_query,
+			      slurmdb_job_cond_t *job_cond,
+			      char *cluster_name, List job_list,
+			      uint32_t *next_id, int limit)
+{
+	char *extra = xstrdup(job_query->extra);
+	int rc;
+
+	_setup_job_cond_selected_steps(job_cond, cluster_name, &extra);
+	if ((rc = _cluster_get_jobs(mysql_conn, &job_query->user, job_cond,
+				    cluster_name, job_query->job_fields,
+				    job_query->step_fields, extra,
+				    job_query->is_admin,
+				    job_query->only_pending, job_list,
+				    next_id, limit))
+	    != SLURM_SUCCESS)
+		error("Problem getting jobs for cluster %s",
+		      cluster_name);
+	xfree(extra);
+
+	return rc;
+}
+
+static void _destroy_job_cursor(job_cursor_t *cursor)
+{
+	if (!cursor)
+		return;
+
+	FREE_NULL_LIST(cursor->cluster_list);
+	slurmdb_destroy_job_cond(cursor->job_cond);
+	xfree(cursor);
+}
+
+static job_cursor_t *_create_job_cursor(uid_t uid,
+					slurmdb_job_cond_t *job_cond)
+{
+	job_cursor_t *cursor = xmalloc(sizeof(job_cursor_t));
+	buf_t *buffer = init_buf(BUF_SIZE);
+	ListIterator itr;
+	char *cluster_name;
+
+	cursor->uid = uid;
+
+	/* The condition is only valid during the request, keep a copy */
+	slurmdb_pack_job_cond(job_cond, SLURM_PROTOCOL_VERSION, buffer);
+	set_buf_offset(buffer, 0);
+	if (slurmdb_unpack_job_cond((void **)&cursor->job_cond,
+				    SLURM_PROTOCOL_VERSION, buffer)
+	    != SLURM_SUCCESS) {
+		free_buf(buffer);
+		_destroy_job_cursor(cursor);
+		return NULL;
+	}
+	free_buf(buffer);
+
+	cursor->cluster_list = list_create(xfree_ptr);
+	if (job_cond->cluster_list && list_count(job_cond->cluster_list)) {
+		itr = list_iterator_create(job_cond->cluster_list);
+		while ((cluster_name = list_next(itr)))
+			list_append(cursor->cluster_list,
+				    xstrdup(cluster_name));
+		list_iterator_destroy(itr);
+	} else {
+		slurm_rwlock_rdlock(&as_mysql_cluster_list_lock);
+		itr = list_iterator_create(as_mysql_cluster_list);
+		while ((cluster_name = list_next(itr)))
+			list_append(cursor->cluster_list,
+				    xstrdup(cluster_name));
+		list_iterator_destroy(itr);
+		slurm_rwlock_unlock(&as_mysql_cluster_list_lock);
+	}
+
+	return cursor;
+}
+
+extern List as_mysql_jobacct_process_get_jobs(mysql_conn_t *mysql_conn,
+					      uid_t uid,
+					      slurmdb_job_cond_t *job_cond)
+{
+	ListIterator itr = NULL;
+	List job_list = NULL;
+	job_query_t job_query;
+	List use_cluster_list = NULL;
+	char *cluster_name;
+	bool locked = false;
+	assoc_mgr_lock_t locks = { NO_LOCK, NO_LOCK, NO_LOCK, NO_LOCK,
+				   READ_LOCK, NO_LOCK, NO_LOCK };
+
+	if (_setup_job_query(mysql_conn, uid, job_cond, &job_query)
+	    != SLURM_SUCCESS) {
+		_free_job_query(&job_query);
+		return NULL;
 	}
 
 	if (job_cond
@@ -1795,16 +1953,9 @@ extern List as_mysql_jobacct_process_get_jobs(mysql_conn_t *mysql_conn,
 
 	job_list = list_create(slurmdb_destroy_job_rec);
 	itr = list_iterator_create(use_cluster_list);
-	while ((cluster_name = list_next(itr))) {
-		int rc;
-		_setup_job_cond_selected_steps(job_cond, cluster_name, &extra);
-		if ((rc = _cluster_get_jobs(mysql_conn, &user, job_cond,
-					    cluster_name, tmp, tmp2, extra,
-					    is_admin, only_pending, job_list))
-		    != SLURM_SUCCESS)
-			error("Problem getting jobs for cluster %s",
-			      cluster_name);
-	}
+	while ((cluster_name = list_next(itr)))
+		(void) _job_query_cluster(mysql_conn, &job_query, job_cond,
+					  cluster_name, job_list, NULL, 0);
 	list_iterator_destroy(itr);
 
 	assoc_mgr_unlock(&locks);
@@ -1814,9 +1965,77 @@ extern List as_mysql_jobacct_process_get_jobs(mysql_conn_t *mysql_conn,
 		slurm_rwlock_unlock(&as_mysql_cluster_list_lock);
 	}
 
-	xfree(tmp);
-	xfree(tmp2);
-	xfree(extra);
+	_free_job_query(&job_query);
 
 	return job_list;
 }
+
+extern List as_mysql_jobacct_process_get_jobs_chunk(
+	mysql_conn_t *mysql_conn, uid_t uid, slurmdb_job_cond_t *job_cond)
+{
+	job_cursor_t *cursor;
+	job_query_t job_query;
+	List job_list = NULL;
+	char *cluster_name;
+	assoc_mgr_lock_t locks = { NO_LOCK, NO_LOCK, NO_LOCK, NO_LOCK,
+				   READ_LOCK, NO_LOCK, NO_LOCK };
+
+	if (job_cond) {
+		as_mysql_jobacct_process_free_cursor(mysql_conn);
+		if (!(mysql_conn->job_cursor =
+		      _create_job_cursor(uid, job_cond))) {
+			error("%s: couldn't copy the job condition", __func__);
+			return NULL;
+		}
+	}
+
+	/* Nothing left */
+	if (!(cursor = mysql_conn->job_cursor))
+		return list_create(slurmdb_destroy_job_rec);
+
+	/*
+	 * The permissions are checked again for each chunk as the
+	 * associations may have changed in between.
+	 */
+	if (_setup_job_query(mysql_conn, cursor->uid, cursor->job_cond,
+			     &job_query) != SLURM_SUCCESS) {
+		_free_job_query(&job_query);
+		as_mysql_jobacct_process_free_cursor(mysql_conn);
+		return NULL;
+	}
+
+	assoc_mgr_lock(&locks);
+
+	job_list = list_create(slurmdb_destroy_job_rec);
+	while ((list_count(job_list) < JOB_CHUNK_SIZE) &&
+	       (cluster_name = list_peek(cursor->cluster_list))) {
+		if (_job_query_cluster(mysql_conn, &job_query,
+				       cursor->job_cond, cluster_name,
+				       job_list, &cursor->next_id,
+				       JOB_CHUNK_SIZE - list_count(job_list))
+		    != SLURM_SUCCESS)
+			cursor->next_id = NO_VAL;
+
+		if (cursor->next_id == NO_VAL) {
+			/* Done with this cluster */
+			cluster_name = list_pop(cursor->cluster_list);
+			xfree(cluster_name);
+			cursor->next_id = 0;
+		}
+	}
+
+	assoc_mgr_unlock(&locks);
+
+	_free_job_query(&job_query);
+
+	if (!list_count(cursor->cluster_list))
+		as_mysql_jobacct_process_free_cursor(mysql_conn);
+
+	return job_list;
+}
+
+extern void as_mysql_jobacct_process_free_cursor(mysql_conn_t *mysql_conn)
+{
+	_destroy_job_cursor(mysql_conn->job_cursor);
+	mysql_conn->job_cursor = NULL;
+}
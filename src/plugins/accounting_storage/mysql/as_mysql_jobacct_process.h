@@ -60,4 +60,16 @@ extern int setup_job_cond_limits(slurmdb_job_cond_t *job_cond,
 extern List as_mysql_jobacct_process_get_jobs(mysql_conn_t *mysql_conn, uid_t uid,
 					   slurmdb_job_cond_t *job_cond);
 
+/*
+ * Get the jobs matching job_cond in chunks. A job_cond starts a new query
+ * whose position is kept on the connection, NULL gets the next chunk.
+ * RET List of slurmdb_job_rec_t *, empty once all the jobs were returned,
+ *     NULL on error.
+ */
+extern List as_mysql_jobacct_process_get_jobs_chunk(
+	mysql_conn_t *mysql_conn, uid_t uid, slurmdb_job_cond_t *job_cond);
+
+/* Forget the job query in progress on the connection */
+extern void as_mysql_jobacct_process_free_cursor(mysql_conn_t *mysql_conn);
+
 #endif
@@ -42,6 +42,7 @@
 #include "as_mysql_archive.h"
 #include "src/common/parse_time.h"
 #include "src/common/slurm_time.h"
+#include "src/common/xhash.h"
 
 enum {
 	TIME_ALLOC,
@@ -89,9 +90,40 @@ typedef struct {
 	List loc_tres;
 	time_t orig_start;
 	time_t start;
+	/*
+	 * The unused wall of the reservation at the end of the hour is
+	 * MAX(unused_min, unused_wall + unused_add), with unused_wall the
+	 * value at the start of the hour. Keeping it in this form lets the
+	 * hours be rolled up independently, see _update_resv_unused_wall().
+	 */
+	double unused_add;
+	double unused_min;
+	bool unused_reset; /* reservation started this hour */
 	double unused_wall;
 } local_resv_usage_t;
 
+typedef struct {
+	time_t begin;		/* when the rollup started */
+	char *cluster_name;
+	pthread_cond_t cond;
+	int conn;		/* connection number for the logs */
+	int dims;
+	int hours;		/* number of hours to roll up */
+	int hours_done;
+	char *job_str;
+	time_t last_log;	/* last progress message */
+	pthread_mutex_t lock;
+	int next_hour;		/* next hour to give to a thread */
+	time_t now;
+	int rc;
+	List *resv_usage;	/* reservations of each hour */
+	time_t start;
+	char *suspend_str;
+	int threads;		/* threads still running */
+	uint16_t track_wckey;
+	pthread_mutex_t write_lock;
+} hourly_rollup_t;
+
 static void _destroy_local_tres_usage(void *object)
 {
 	local_tres_usage_t *a_usage = (local_tres_usage_t *)object;
@@ -139,12 +171,22 @@ static int _find_loc_tres(void *x, void *key)
 	return 0;
 }
 
-static int _find_id_usage(void *x, void *key)
+static void _id_usage_hash_id(void *item, const char **key,
+			      uint32_t *key_len)
+{
+	local_id_usage_t *usage = (local_id_usage_t *)item;
+
+	*key = (const char *)&usage->id;
+	*key_len = sizeof(usage->id);
+}
+
+static int _find_resv_usage(void *x, void *key)
 {
-	local_id_usage_t *loc = (local_id_usage_t *)x;
-	uint32_t id = *(uint32_t *)key;
+	local_resv_usage_t *r_usage = (local_resv_usage_t *)x;
+	local_resv_usage_t *r_key = (local_resv_usage_t *)key;
 
-	if (loc->id == id)
+	if ((r_usage->id == r_key->id) &&
+	    (r_usage->orig_start == r_key->orig_start))
 		return 1;
 	return 0;
 }
@@ -254,7 +296,7 @@ static int _update_unused_wall(local_resv_usage_t *r_usage, List job_tres,
 	local_tres_usage_t *loc_tres;
 	uint32_t resv_tres_id;
 	uint64_t resv_tres_count;
-	double tres_ratio = 0.0;
+	double job_wall, tres_ratio = 0.0;
 
 	/* Get TRES counts. Make sure the TRES types match. */
 	resv_itr = list_iterator_create(r_usage->loc_tres);
@@ -277,18 +319,15 @@ static int _update_unused_wall(local_resv_usage_t *r_usage, List job_tres,
 	/*
 	 * Here we are converting TRES seconds to wall seconds.  This is needed
 	 * to determine how much time is actually idle in the reservation.
+	 * The unused wall never goes below zero, whatever it was at the start
+	 * of the hour.
 	 */
-	r_usage->unused_wall -=	(double)job_seconds * tres_ratio;
+	job_wall = (double)job_seconds * tres_ratio;
+	r_usage->unused_add -= job_wall;
+	r_usage->unused_min -= job_wall;
+	if (r_usage->unused_min < 0)
+		r_usage->unused_min = 0;
 
-	if (r_usage->unused_wall < 0) {
-		/*
-		 * With a Flex reservation you can easily have more time than is
-		 * possible.  Just print this debug3 warning if it happens.
-		 */
-		debug3("WARNING: Unused wall is less than zero; this should never happen outside a Flex reservation. Setting it to zero for resv id = %d, start = %ld.",
-		       r_usage->id, r_usage->orig_start);
-		r_usage->unused_wall = 0;
-	}
 	return SLURM_SUCCESS;
 }
 
@@ -1155,21 +1194,9 @@ extern int _setup_resv_usage(mysql_conn_t *mysql_conn,
 	while ((row = mysql_fetch_row(result))) {
 		time_t row_start = slurm_atoul(row[RESV_REQ_START]);
 		time_t row_end = slurm_atoul(row[RESV_REQ_END]);
-		int unused;
 		int resv_seconds;
 		time_t orig_start = row_start;
 
-		if (row_start >= curr_start) {
-			/*
-			 * This is the first time we are seeing this
-			 * reservation, so set our unused to be 0.
-			 * This is mostly helpful when
-			 * rerolling set it back to 0.
-			 */
-			unused = 0;
-		} else
-			unused = slurm_atoul(row[RESV_REQ_UNUSED]);
-
 		if (row_start <= curr_start)
 			row_start = curr_start;
 
@@ -1202,7 +1229,23 @@ extern int _setup_resv_usage(mysql_conn_t *mysql_conn,
 		r_usage->orig_start = orig_start;
 		r_usage->start = row_start;
 		r_usage->end = row_end;
-		r_usage->unused_wall = unused + resv_seconds;
+		if (orig_start >= curr_start) {
+			/*
+			 * This is the first time we are seeing this
+			 * reservation, so set our unused to be 0.
+			 * This is mostly helpful when
+			 * rerolling set it back to 0.
+			 */
+			r_usage->unused_reset = true;
+		} else {
+			/*
+			 * Only right for the first hour rolled up, the
+			 * following ones get it from the previous hour.
+			 */
+			r_usage->unused_wall =
+				slurm_atoul(row[RESV_REQ_UNUSED]);
+		}
+		r_usage->unused_add = resv_seconds;
 		r_usage->hl = hostlist_create_dims(row[RESV_REQ_NODES], dims);
 		list_append(resv_usage_list, r_usage);
 	}
@@ -1211,51 +1254,89 @@ extern int _setup_resv_usage(mysql_conn_t *mysql_conn,
 	return SLURM_SUCCESS;
 }
 
-extern int as_mysql_hourly_rollup(mysql_conn_t *mysql_conn,
-				  char *cluster_name,
-				  time_t start, time_t end,
-				  uint16_t archive_data)
+static int _write_hour_usage(mysql_conn_t *mysql_conn,
+			     hourly_rollup_t *rollup,
+			     time_t curr_start, time_t curr_end,
+			     local_cluster_usage_t *c_usage,
+			     List assoc_usage_list, List wckey_usage_list)
 {
 	int rc = SLURM_SUCCESS;
-	int add_sec = 3600;
-	int i=0, dims;
-	time_t now = time(NULL);
-	time_t curr_start = start;
-	time_t curr_end = curr_start + add_sec;
+	char *query = NULL;
+	ListIterator itr;
+	local_id_usage_t *id_usage;
+
+	if (c_usage &&
+	    ((rc = _process_cluster_usage(mysql_conn, rollup->cluster_name,
+					  curr_start, curr_end, rollup->now,
+					  c_usage)) != SLURM_SUCCESS))
+		return rc;
+
+	itr = list_iterator_create(assoc_usage_list);
+	while ((id_usage = list_next(itr)))
+		_create_id_usage_insert(rollup->cluster_name, ASSOC_TABLES,
+					curr_start, rollup->now,
+					id_usage, &query);
+	list_iterator_destroy(itr);
+	if (query) {
+		DB_DEBUG(DB_USAGE, mysql_conn->conn, "query\n%s", query);
+		rc = mysql_db_query(mysql_conn, query);
+		xfree(query);
+		if (rc != SLURM_SUCCESS) {
+			error("Couldn't add assoc hour rollup");
+			return rc;
+		}
+	}
+
+	if (!rollup->track_wckey)
+		return rc;
+
+	itr = list_iterator_create(wckey_usage_list);
+	while ((id_usage = list_next(itr)))
+		_create_id_usage_insert(rollup->cluster_name, WCKEY_TABLES,
+					curr_start, rollup->now,
+					id_usage, &query);
+	list_iterator_destroy(itr);
+	if (query) {
+		DB_DEBUG(DB_USAGE, mysql_conn->conn, "query\n%s", query);
+		rc = mysql_db_query(mysql_conn, query);
+		xfree(query);
+		if (rc != SLURM_SUCCESS)
+			error("Couldn't add wckey hour rollup");
+	}
+
+	return rc;
+}
+
+/*
+ * Roll up hour number "hour" of the rollup on the given connection,
+ * committing it if "commit" is set.
+ */
+static int _hourly_rollup_hour(mysql_conn_t *mysql_conn,
+			       hourly_rollup_t *rollup, int hour, bool commit)
+{
+	int rc = SLURM_SUCCESS;
+	char *cluster_name = rollup->cluster_name;
+	time_t curr_start = rollup->start + (hour * 3600);
+	time_t curr_end = curr_start + 3600;
 	char *query = NULL;
 	MYSQL_RES *result = NULL;
 	MYSQL_ROW row;
-	ListIterator a_itr = NULL;
 	ListIterator c_itr = NULL;
-	ListIterator w_itr = NULL;
 	ListIterator r_itr = NULL;
 	List assoc_usage_list = list_create(_destroy_local_id_usage);
 	List cluster_down_list = list_create(_destroy_local_cluster_usage);
 	List wckey_usage_list = list_create(_destroy_local_id_usage);
 	List resv_usage_list = list_create(_destroy_local_resv_usage);
-	uint16_t track_wckey = slurm_get_track_wckey();
+	xhash_t *assoc_usage_hash = xhash_init(_id_usage_hash_id, NULL);
+	xhash_t *wckey_usage_hash = xhash_init(_id_usage_hash_id, NULL);
 	local_cluster_usage_t *loc_c_usage = NULL;
 	local_cluster_usage_t *c_usage = NULL;
 	local_resv_usage_t *r_usage = NULL;
 	local_id_usage_t *a_usage = NULL;
 	local_id_usage_t *w_usage = NULL;
-	/* char start_char[20], end_char[20]; */
+	int last_id = -1;
+	int last_wckeyid = -1;
 
-	char *job_req_inx[] = {
-		"job.job_db_inx",
-//		"job.id_job",
-		"job.id_assoc",
-		"job.id_wckey",
-		"job.array_task_pending",
-		"job.time_eligible",
-		"job.time_start",
-		"job.time_end",
-		"job.time_suspended",
-		"job.cpus_req",
-		"job.id_resv",
-		"job.tres_alloc"
-	};
-	char *job_str = NULL;
 	enum {
 		JOB_REQ_DB_INX,
 //		JOB_REQ_JOBID,
@@ -1272,583 +1353,749 @@ extern int as_mysql_hourly_rollup(mysql_conn_t *mysql_conn,
 		JOB_REQ_COUNT
 	};
 
-	char *suspend_req_inx[] = {
-		"time_start",
-		"time_end"
-	};
-	char *suspend_str = NULL;
 	enum {
 		SUSPEND_REQ_START,
 		SUSPEND_REQ_END,
 		SUSPEND_REQ_COUNT
 	};
 
-	i=0;
-	xstrfmtcat(job_str, "%s", job_req_inx[i]);
-	for(i=1; i<JOB_REQ_COUNT; i++) {
-		xstrfmtcat(job_str, ", %s", job_req_inx[i]);
-	}
+	c_itr = list_iterator_create(cluster_down_list);
+	r_itr = list_iterator_create(resv_usage_list);
 
-	i=0;
-	xstrfmtcat(suspend_str, "%s", suspend_req_inx[i]);
-	for(i=1; i<SUSPEND_REQ_COUNT; i++) {
-		xstrfmtcat(suspend_str, ", %s", suspend_req_inx[i]);
-	}
+	DB_DEBUG(DB_USAGE, mysql_conn->conn,
+		 "%s curr hour is now %ld-%ld",
+		 cluster_name, curr_start, curr_end);
+/* 	info("start %s", slurm_ctime2(&curr_start)); */
+/* 	info("end %s", slurm_ctime2(&curr_end)); */
 
-	/* We need to figure out the dimensions of this cluster */
-	query = xstrdup_printf("select dimensions from %s where name='%s'",
-			       cluster_table, cluster_name);
-	DB_DEBUG(DB_USAGE, mysql_conn->conn, "query\n%s", query);
-	result = mysql_db_query_ret(mysql_conn, query, 0);
-	xfree(query);
-
-	if (!result) {
-		error("%s: error querying cluster_table", __func__);
-		rc = SLURM_ERROR;
+	if ((rc = _setup_resv_usage(mysql_conn, cluster_name,
+				    curr_start, curr_end,
+				    resv_usage_list, rollup->dims))
+	    != SLURM_SUCCESS)
 		goto end_it;
-	}
-	row = mysql_fetch_row(result);
 
-	if (!row) {
-		error("%s: no cluster by name %s known",
-		      __func__, cluster_name);
+	c_usage = _setup_cluster_usage(mysql_conn, cluster_name,
+				       curr_start, curr_end,
+				       resv_usage_list,
+				       cluster_down_list,
+				       rollup->dims);
+
+	if (c_usage)
+		xassert(c_usage->loc_tres);
+
+	/* now get the jobs during this time only  */
+	query = xstrdup_printf("select %s from \"%s_%s\" as job "
+			       "where (job.time_eligible && "
+			       "job.time_eligible < %ld && "
+			       "(job.time_end >= %ld || "
+			       "job.time_end = 0)) "
+			       "group by job.job_db_inx "
+			       "order by job.id_assoc, "
+			       "job.time_eligible",
+			       rollup->job_str, cluster_name, job_table,
+			       curr_end, curr_start);
+
+	DB_DEBUG(DB_USAGE, mysql_conn->conn, "query\n%s", query);
+	if (!(result = mysql_db_query_ret(
+		      mysql_conn, query, 0))) {
 		rc = SLURM_ERROR;
 		goto end_it;
 	}
+	xfree(query);
 
-	dims = atoi(row[0]);
-	mysql_free_result(result);
-
-/* 	info("begin start %s", slurm_ctime2(&curr_start)); */
-/* 	info("begin end %s", slurm_ctime2(&curr_end)); */
-	a_itr = list_iterator_create(assoc_usage_list);
-	c_itr = list_iterator_create(cluster_down_list);
-	w_itr = list_iterator_create(wckey_usage_list);
-	r_itr = list_iterator_create(resv_usage_list);
-	while (curr_start < end) {
-		int last_id = -1;
-		int last_wckeyid = -1;
-
-		DB_DEBUG(DB_USAGE, mysql_conn->conn,
-		         "%s curr hour is now %ld-%ld",
-		         cluster_name, curr_start, curr_end);
-/* 		info("start %s", slurm_ctime2(&curr_start)); */
-/* 		info("end %s", slurm_ctime2(&curr_end)); */
+	while ((row = mysql_fetch_row(result))) {
+		//uint32_t job_id = slurm_atoul(row[JOB_REQ_JOBID]);
+		uint32_t assoc_id = slurm_atoul(row[JOB_REQ_ASSOCID]);
+		uint32_t wckey_id = slurm_atoul(row[JOB_REQ_WCKEYID]);
+		uint32_t array_pending =
+			slurm_atoul(row[JOB_REQ_ARRAY_PENDING]);
+		uint32_t resv_id = slurm_atoul(row[JOB_REQ_RESVID]);
+		time_t row_eligible = slurm_atoul(row[JOB_REQ_ELG]);
+		time_t row_start = slurm_atoul(row[JOB_REQ_START]);
+		time_t row_end = slurm_atoul(row[JOB_REQ_END]);
+		uint32_t row_rcpu = slurm_atoul(row[JOB_REQ_RCPU]);
+		List loc_tres = NULL;
+		int loc_seconds = 0;
+		int seconds = 0, suspend_seconds = 0;
+
+		if (row_start && (row_start < curr_start))
+			row_start = curr_start;
 
-		if ((rc = _setup_resv_usage(mysql_conn, cluster_name,
-					    curr_start, curr_end,
-					    resv_usage_list, dims))
-		    != SLURM_SUCCESS)
-			goto end_it;
-
-		c_usage = _setup_cluster_usage(mysql_conn, cluster_name,
-					       curr_start, curr_end,
-					       resv_usage_list,
-					       cluster_down_list,
-					       dims);
-
-		if (c_usage)
-			xassert(c_usage->loc_tres);
-
-		/* now get the jobs during this time only  */
-		query = xstrdup_printf("select %s from \"%s_%s\" as job "
-				       "where (job.time_eligible && "
-				       "job.time_eligible < %ld && "
-				       "(job.time_end >= %ld || "
-				       "job.time_end = 0)) "
-				       "group by job.job_db_inx "
-				       "order by job.id_assoc, "
-				       "job.time_eligible",
-				       job_str, cluster_name, job_table,
-				       curr_end, curr_start);
+		if (!row_start && row_end)
+			row_start = row_end;
 
-		DB_DEBUG(DB_USAGE, mysql_conn->conn, "query\n%s", query);
-		if (!(result = mysql_db_query_ret(
-			      mysql_conn, query, 0))) {
-			rc = SLURM_ERROR;
-			goto end_it;
-		}
-		xfree(query);
-
-		while ((row = mysql_fetch_row(result))) {
-			//uint32_t job_id = slurm_atoul(row[JOB_REQ_JOBID]);
-			uint32_t assoc_id = slurm_atoul(row[JOB_REQ_ASSOCID]);
-			uint32_t wckey_id = slurm_atoul(row[JOB_REQ_WCKEYID]);
-			uint32_t array_pending =
-				slurm_atoul(row[JOB_REQ_ARRAY_PENDING]);
-			uint32_t resv_id = slurm_atoul(row[JOB_REQ_RESVID]);
-			time_t row_eligible = slurm_atoul(row[JOB_REQ_ELG]);
-			time_t row_start = slurm_atoul(row[JOB_REQ_START]);
-			time_t row_end = slurm_atoul(row[JOB_REQ_END]);
-			uint32_t row_rcpu = slurm_atoul(row[JOB_REQ_RCPU]);
-			List loc_tres = NULL;
-			int loc_seconds = 0;
-			int seconds = 0, suspend_seconds = 0;
-
-			if (row_start && (row_start < curr_start))
-				row_start = curr_start;
-
-			if (!row_start && row_end)
-				row_start = row_end;
-
-			if (!row_end || row_end > curr_end)
-				row_end = curr_end;
-
-			if (!row_start || ((row_end - row_start) < 1))
-				goto calc_cluster;
-
-			seconds = (row_end - row_start);
-
-			if (slurm_atoul(row[JOB_REQ_SUSPENDED])) {
-				MYSQL_RES *result2 = NULL;
-				MYSQL_ROW row2;
-				/* get the suspended time for this job */
-				query = xstrdup_printf(
-					"select %s from \"%s_%s\" where "
-					"(time_start < %ld && (time_end >= %ld "
-					"|| time_end = 0)) && job_db_inx=%s "
-					"order by time_start",
-					suspend_str, cluster_name,
-					suspend_table,
-					curr_end, curr_start,
-					row[JOB_REQ_DB_INX]);
-
-				debug4("%d(%s:%d) query\n%s",
-				       mysql_conn->conn, THIS_FILE,
-				       __LINE__, query);
-				if (!(result2 = mysql_db_query_ret(
-					      mysql_conn,
-					      query, 0))) {
-					rc = SLURM_ERROR;
-					mysql_free_result(result);
-					goto end_it;
-				}
-				xfree(query);
-				while ((row2 = mysql_fetch_row(result2))) {
-					int tot_time = 0;
-					time_t local_start = slurm_atoul(
-						row2[SUSPEND_REQ_START]);
-					time_t local_end = slurm_atoul(
-						row2[SUSPEND_REQ_END]);
-
-					if (!local_start)
-						continue;
-
-					if (row_start > local_start)
-						local_start = row_start;
-					if (!local_end || row_end < local_end)
-						local_end = row_end;
-					tot_time = (local_end - local_start);
-
-					if (tot_time > 0)
-						suspend_seconds += tot_time;
-				}
-				mysql_free_result(result2);
-			}
+		if (!row_end || row_end > curr_end)
+			row_end = curr_end;
 
-			if (last_id != assoc_id) {
-				a_usage = xmalloc(sizeof(local_id_usage_t));
-				a_usage->id = assoc_id;
-				list_append(assoc_usage_list, a_usage);
-				last_id = assoc_id;
-				/* a_usage->loc_tres is made later,
-				   don't do it here.
-				*/
+		if (!row_start || ((row_end - row_start) < 1))
+			goto calc_cluster;
+
+		seconds = (row_end - row_start);
+
+		if (slurm_atoul(row[JOB_REQ_SUSPENDED])) {
+			MYSQL_RES *result2 = NULL;
+			MYSQL_ROW row2;
+			/* get the suspended time for this job */
+			query = xstrdup_printf(
+				"select %s from \"%s_%s\" where "
+				"(time_start < %ld && (time_end >= %ld "
+				"|| time_end = 0)) && job_db_inx=%s "
+				"order by time_start",
+				rollup->suspend_str, cluster_name,
+				suspend_table,
+				curr_end, curr_start,
+				row[JOB_REQ_DB_INX]);
+
+			debug4("%d(%s:%d) query\n%s",
+			       mysql_conn->conn, THIS_FILE,
+			       __LINE__, query);
+			if (!(result2 = mysql_db_query_ret(
+				      mysql_conn,
+				      query, 0))) {
+				rc = SLURM_ERROR;
+				mysql_free_result(result);
+				goto end_it;
 			}
+			xfree(query);
+			while ((row2 = mysql_fetch_row(result2))) {
+				int tot_time = 0;
+				time_t local_start = slurm_atoul(
+					row2[SUSPEND_REQ_START]);
+				time_t local_end = slurm_atoul(
+					row2[SUSPEND_REQ_END]);
+
+				if (!local_start)
+					continue;
 
-			/* Short circuit this so so we don't get a pointer. */
-			if (!track_wckey)
-				last_wckeyid = wckey_id;
+				if (row_start > local_start)
+					local_start = row_start;
+				if (!local_end || row_end < local_end)
+					local_end = row_end;
+				tot_time = (local_end - local_start);
 
-			/* do the wckey calculation */
-			if (last_wckeyid != wckey_id) {
-				list_iterator_reset(w_itr);
-				while ((w_usage = list_next(w_itr)))
-					if (w_usage->id == wckey_id)
-						break;
+				if (tot_time > 0)
+					suspend_seconds += tot_time;
+			}
+			mysql_free_result(result2);
+		}
 
-				if (!w_usage) {
-					w_usage = xmalloc(
-						sizeof(local_id_usage_t));
-					w_usage->id = wckey_id;
-					list_append(wckey_usage_list,
-						    w_usage);
-					w_usage->loc_tres = list_create(
-						_destroy_local_tres_usage);
-				}
-				last_wckeyid = wckey_id;
+		if ((last_id != assoc_id) &&
+		    !(a_usage = xhash_get(assoc_usage_hash,
+					  (const char *)&assoc_id,
+					  sizeof(assoc_id)))) {
+			a_usage = xmalloc(sizeof(local_id_usage_t));
+			a_usage->id = assoc_id;
+			list_append(assoc_usage_list, a_usage);
+			xhash_add(assoc_usage_hash, a_usage);
+			/* a_usage->loc_tres is made later,
+			   don't do it here.
+			*/
+		}
+		last_id = assoc_id;
+
+		/* Short circuit this so so we don't get a pointer. */
+		if (!rollup->track_wckey)
+			last_wckeyid = wckey_id;
+
+		/* do the wckey calculation */
+		if (last_wckeyid != wckey_id) {
+			if (!(w_usage = xhash_get(wckey_usage_hash,
+						  (const char *)&wckey_id,
+						  sizeof(wckey_id)))) {
+				w_usage = xmalloc(
+					sizeof(local_id_usage_t));
+				w_usage->id = wckey_id;
+				list_append(wckey_usage_list,
+					    w_usage);
+				xhash_add(wckey_usage_hash, w_usage);
+				w_usage->loc_tres = list_create(
+					_destroy_local_tres_usage);
 			}
+			last_wckeyid = wckey_id;
+		}
 
-			/* do the cluster allocated calculation */
-		calc_cluster:
+		/* do the cluster allocated calculation */
+	calc_cluster:
 
-			/*
-			 * We need to have this clean for each job
-			 * since we add the time to the cluster individually.
-			 */
-			loc_tres = list_create(_destroy_local_tres_usage);
-
-			_add_tres_time_2_list(loc_tres, row[JOB_REQ_TRES],
+		/*
+		 * We need to have this clean for each job
+		 * since we add the time to the cluster individually.
+		 */
+		loc_tres = list_create(_destroy_local_tres_usage);
+
+		_add_tres_time_2_list(loc_tres, row[JOB_REQ_TRES],
+				      TIME_ALLOC, seconds,
+				      suspend_seconds, 0);
+		if (w_usage)
+			_add_tres_time_2_list(w_usage->loc_tres,
+					      row[JOB_REQ_TRES],
 					      TIME_ALLOC, seconds,
 					      suspend_seconds, 0);
-			if (w_usage)
-				_add_tres_time_2_list(w_usage->loc_tres,
-						      row[JOB_REQ_TRES],
-						      TIME_ALLOC, seconds,
-						      suspend_seconds, 0);
 
+		/*
+		 * Now figure out there was a disconnected
+		 * slurmctld during this job.
+		 */
+		list_iterator_reset(c_itr);
+		while ((loc_c_usage = list_next(c_itr))) {
+			int temp_end = row_end;
+			int temp_start = row_start;
+			if (loc_c_usage->start > temp_start)
+				temp_start = loc_c_usage->start;
+			if (loc_c_usage->end < temp_end)
+				temp_end = loc_c_usage->end;
+			loc_seconds = (temp_end - temp_start);
+			if (loc_seconds < 1)
+				continue;
+
+			_remove_job_tres_time_from_cluster(
+				loc_c_usage->loc_tres,
+				loc_tres,
+				loc_seconds);
+			/* info("Job %u was running for " */
+			/*      "%d seconds while " */
+			/*      "cluster %s's slurmctld " */
+			/*      "wasn't responding", */
+			/*      job_id, loc_seconds, cluster_name); */
+		}
+
+		/* first figure out the reservation */
+		if (resv_id) {
+			if (seconds <= 0) {
+				_transfer_loc_tres(&loc_tres, a_usage);
+				continue;
+			}
 			/*
-			 * Now figure out there was a disconnected
-			 * slurmctld during this job.
+			 * Since we have already added the entire
+			 * reservation as used time on the cluster we
+			 * only need to calculate the used time for the
+			 * reservation and then divy up the unused time
+			 * over the associations able to run in the
+			 * reservation. Since the job was to run, or ran
+			 * a reservation we don't care about eligible
+			 * time since that could totally skew the
+			 * clusters reserved time since the job may be
+			 * able to run outside of the reservation.
 			 */
-			list_iterator_reset(c_itr);
-			while ((loc_c_usage = list_next(c_itr))) {
-				int temp_end = row_end;
-				int temp_start = row_start;
-				if (loc_c_usage->start > temp_start)
-					temp_start = loc_c_usage->start;
-				if (loc_c_usage->end < temp_end)
-					temp_end = loc_c_usage->end;
-				loc_seconds = (temp_end - temp_start);
-				if (loc_seconds < 1)
+			list_iterator_reset(r_itr);
+			while ((r_usage = list_next(r_itr))) {
+				int temp_end, temp_start;
+				/*
+				 * since the reservation could have
+				 * changed in some way, thus making a
+				 * new reservation record in the
+				 * database, we have to make sure all
+				 * of the reservations are checked to
+				 * see if such a thing has happened
+				 */
+				if (r_usage->id != resv_id)
 					continue;
+				temp_end = row_end;
+				temp_start = row_start;
+				if (r_usage->start > temp_start)
+					temp_start =
+						r_usage->start;
+				if (r_usage->end < temp_end)
+					temp_end = r_usage->end;
 
-				_remove_job_tres_time_from_cluster(
-					loc_c_usage->loc_tres,
-					loc_tres,
-					loc_seconds);
-				/* info("Job %u was running for " */
-				/*      "%d seconds while " */
-				/*      "cluster %s's slurmctld " */
-				/*      "wasn't responding", */
-				/*      job_id, loc_seconds, cluster_name); */
-			}
+				loc_seconds = (temp_end - temp_start);
 
-			/* first figure out the reservation */
-			if (resv_id) {
-				if (seconds <= 0) {
-					_transfer_loc_tres(&loc_tres, a_usage);
+				if (loc_seconds <= 0)
 					continue;
-				}
-				/*
-				 * Since we have already added the entire
-				 * reservation as used time on the cluster we
-				 * only need to calculate the used time for the
-				 * reservation and then divy up the unused time
-				 * over the associations able to run in the
-				 * reservation. Since the job was to run, or ran
-				 * a reservation we don't care about eligible
-				 * time since that could totally skew the
-				 * clusters reserved time since the job may be
-				 * able to run outside of the reservation.
-				 */
-				list_iterator_reset(r_itr);
-				while ((r_usage = list_next(r_itr))) {
-					int temp_end, temp_start;
+
+				if (c_usage &&
+				    (r_usage->flags &
+				     RESERVE_FLAG_IGN_JOBS))
 					/*
-					 * since the reservation could have
-					 * changed in some way, thus making a
-					 * new reservation record in the
-					 * database, we have to make sure all
-					 * of the reservations are checked to
-					 * see if such a thing has happened
+					 * job usage was not
+					 * bundled with resv
+					 * usage so need to
+					 * account for it
+					 * individually here
 					 */
-					if (r_usage->id != resv_id)
-						continue;
-					temp_end = row_end;
-					temp_start = row_start;
-					if (r_usage->start > temp_start)
-						temp_start =
-							r_usage->start;
-					if (r_usage->end < temp_end)
-						temp_end = r_usage->end;
-
-					loc_seconds = (temp_end - temp_start);
-
-					if (loc_seconds <= 0)
-						continue;
-
-					if (c_usage &&
-					    (r_usage->flags &
-					     RESERVE_FLAG_IGN_JOBS))
-						/*
-						 * job usage was not
-						 * bundled with resv
-						 * usage so need to
-						 * account for it
-						 * individually here
-						 */
-						_add_tres_time_2_list(
-							c_usage->loc_tres,
-							row[JOB_REQ_TRES],
-							TIME_ALLOC,
-							loc_seconds,
-							0, 0);
-
-					_add_time_tres_list(
-						r_usage->loc_tres,
-						loc_tres, TIME_ALLOC,
-						loc_seconds, 1);
-					if ((rc = _update_unused_wall(
-						     r_usage,
-						     loc_tres,
-						     loc_seconds))
-					    != SLURM_SUCCESS)
-						goto end_it;
+					_add_tres_time_2_list(
+						c_usage->loc_tres,
+						row[JOB_REQ_TRES],
+						TIME_ALLOC,
+						loc_seconds,
+						0, 0);
+
+				_add_time_tres_list(
+					r_usage->loc_tres,
+					loc_tres, TIME_ALLOC,
+					loc_seconds, 1);
+				if ((rc = _update_unused_wall(
+					     r_usage,
+					     loc_tres,
+					     loc_seconds))
+				    != SLURM_SUCCESS) {
+					FREE_NULL_LIST(loc_tres);
+					mysql_free_result(result);
+					goto end_it;
 				}
-
-				_transfer_loc_tres(&loc_tres, a_usage);
-				continue;
 			}
 
-			/*
-			 * only record time for the clusters that have
-			 * registered.  This continue should rarely if
-			 * ever happen.
-			 */
-			if (!c_usage) {
-				_transfer_loc_tres(&loc_tres, a_usage);
-				continue;
-			}
+			_transfer_loc_tres(&loc_tres, a_usage);
+			continue;
+		}
+
+		/*
+		 * only record time for the clusters that have
+		 * registered.  This continue should rarely if
+		 * ever happen.
+		 */
+		if (!c_usage) {
+			_transfer_loc_tres(&loc_tres, a_usage);
+			continue;
+		}
+
+		if (row_start && (seconds > 0)) {
+			/* info("%d assoc %d adds " */
+			/*      "(%d)(%d-%d) * %d = %d " */
+			/*      "to %d", */
+			/*      job_id, */
+			/*      a_usage->id, */
+			/*      seconds, */
+			/*      row_end, row_start, */
+			/*      row_acpu, */
+			/*      seconds * row_acpu, */
+			/*      row_acpu); */
+
+			_add_job_alloc_time_to_cluster(
+				c_usage->loc_tres,
+				loc_tres);
+		}
+
+		/*
+		 * The loc_tres isn't needed after this so transfer to
+		 * the association and go on our merry way.
+		 */
+		_transfer_loc_tres(&loc_tres, a_usage);
+
+		/* now reserved time */
+		if (!row_start || (row_start >= c_usage->start)) {
+			int temp_end = row_start;
+			int temp_start = row_eligible;
+			if (c_usage->start > temp_start)
+				temp_start = c_usage->start;
+			if (c_usage->end < temp_end)
+				temp_end = c_usage->end;
+			loc_seconds = (temp_end - temp_start);
+			if (loc_seconds > 0) {
+				/*
+				 * If we have pending jobs in an array
+				 * they haven't been inserted into the
+				 * database yet as proper job records,
+				 * so handle them here.
+				 */
+				if (array_pending)
+					loc_seconds *= array_pending;
 
-			if (row_start && (seconds > 0)) {
-				/* info("%d assoc %d adds " */
-				/*      "(%d)(%d-%d) * %d = %d " */
+				/* info("%d assoc %d reserved " */
+				/*      "(%d)(%d-%d) * %d * %d = %d " */
 				/*      "to %d", */
 				/*      job_id, */
-				/*      a_usage->id, */
-				/*      seconds, */
-				/*      row_end, row_start, */
-				/*      row_acpu, */
-				/*      seconds * row_acpu, */
-				/*      row_acpu); */
-
-				_add_job_alloc_time_to_cluster(
-					c_usage->loc_tres,
-					loc_tres);
+				/*      assoc_id, */
+				/*      temp_end - temp_start, */
+				/*      temp_end, temp_start, */
+				/*      row_rcpu, */
+				/*      array_pending, */
+				/*      loc_seconds, */
+				/*      row_rcpu); */
+
+				_add_time_tres(c_usage->loc_tres,
+					       TIME_RESV, TRES_CPU,
+					       loc_seconds *
+					       (uint64_t) row_rcpu,
+					       0);
 			}
+		}
+	}
+	mysql_free_result(result);
 
-			/*
-			 * The loc_tres isn't needed after this so transfer to
-			 * the association and go on our merry way.
-			 */
-			_transfer_loc_tres(&loc_tres, a_usage);
+	/* now figure out how much more to add to the
+	   associations that could had run in the reservation
+	*/
+	list_iterator_reset(r_itr);
+	while ((r_usage = list_next(r_itr))) {
+		ListIterator t_itr;
+		local_tres_usage_t *loc_tres;
 
-			/* now reserved time */
-			if (!row_start || (row_start >= c_usage->start)) {
-				int temp_end = row_start;
-				int temp_start = row_eligible;
-				if (c_usage->start > temp_start)
-					temp_start = c_usage->start;
-				if (c_usage->end < temp_end)
-					temp_end = c_usage->end;
-				loc_seconds = (temp_end - temp_start);
-				if (loc_seconds > 0) {
-					/*
-					 * If we have pending jobs in an array
-					 * they haven't been inserted into the
-					 * database yet as proper job records,
-					 * so handle them here.
-					 */
-					if (array_pending)
-						loc_seconds *= array_pending;
-
-					/* info("%d assoc %d reserved " */
-					/*      "(%d)(%d-%d) * %d * %d = %d " */
-					/*      "to %d", */
-					/*      job_id, */
-					/*      assoc_id, */
-					/*      temp_end - temp_start, */
-					/*      temp_end, temp_start, */
-					/*      row_rcpu, */
-					/*      array_pending, */
-					/*      loc_seconds, */
-					/*      row_rcpu); */
-
-					_add_time_tres(c_usage->loc_tres,
-						       TIME_RESV, TRES_CPU,
-						       loc_seconds *
-						       (uint64_t) row_rcpu,
-						       0);
+		if (!r_usage->loc_tres ||
+		    !list_count(r_usage->loc_tres))
+			continue;
+
+		t_itr = list_iterator_create(r_usage->loc_tres);
+		while ((loc_tres = list_next(t_itr))) {
+			int64_t idle = loc_tres->total_time -
+				loc_tres->time_alloc;
+			char *assoc = NULL;
+			ListIterator tmp_itr = NULL;
+			int assoc_cnt, resv_unused_secs;
+
+			if (idle <= 0)
+				break; /* since this will be
+					* the same for all TRES	*/
+
+			/* now divide that time by the number of
+			   associations in the reservation and add
+			   them to each association */
+			resv_unused_secs = idle;
+			assoc_cnt = list_count(r_usage->local_assocs);
+			if (assoc_cnt)
+				resv_unused_secs /= assoc_cnt;
+			/* info("resv %d got %d seconds for TRES %u " */
+			/*      "for %d assocs", */
+			/*      r_usage->id, resv_unused_secs, */
+			/*      loc_tres->id, */
+			/*      list_count(r_usage->local_assocs)); */
+			tmp_itr = list_iterator_create(
+				r_usage->local_assocs);
+			while ((assoc = list_next(tmp_itr))) {
+				uint32_t associd = slurm_atoul(assoc);
+				if (!(a_usage = xhash_get(
+					      assoc_usage_hash,
+					      (const char *)&associd,
+					      sizeof(associd)))) {
+					a_usage = xmalloc(
+						sizeof(local_id_usage_t));
+					a_usage->id = associd;
+					list_append(assoc_usage_list,
+						    a_usage);
+					xhash_add(assoc_usage_hash, a_usage);
 				}
+				if (!a_usage->loc_tres)
+					a_usage->loc_tres = list_create(
+						_destroy_local_tres_usage);
+
+				_add_time_tres(a_usage->loc_tres,
+					       TIME_ALLOC, loc_tres->id,
+					       resv_unused_secs, 0);
 			}
+			list_iterator_destroy(tmp_itr);
 		}
-		mysql_free_result(result);
+		list_iterator_destroy(t_itr);
+	}
 
-		/* now figure out how much more to add to the
-		   associations that could had run in the reservation
-		*/
-		query = NULL;
-		list_iterator_reset(r_itr);
-		while ((r_usage = list_next(r_itr))) {
-			ListIterator t_itr;
+	/* now apply the down time from the slurmctld disconnects */
+	if (c_usage) {
+		list_iterator_reset(c_itr);
+		while ((loc_c_usage = list_next(c_itr))) {
 			local_tres_usage_t *loc_tres;
+			ListIterator tmp_itr = list_iterator_create(
+				loc_c_usage->loc_tres);
+			while ((loc_tres = list_next(tmp_itr)))
+				_add_time_tres(c_usage->loc_tres,
+					       TIME_DOWN,
+					       loc_tres->id,
+					       loc_tres->total_time,
+					       0);
+			list_iterator_destroy(tmp_itr);
+		}
+	}
 
-			xstrfmtcat(query, "update \"%s_%s\" set unused_wall=%f where id_resv=%u and time_start=%ld;",
-				   cluster_name, resv_table,
-				   r_usage->unused_wall, r_usage->id,
-				   r_usage->orig_start);
+	/*
+	 * Only one thread writes at a time, the inserts of concurrent
+	 * transactions in the same tables could deadlock each other.
+	 */
+	slurm_mutex_lock(&rollup->write_lock);
+	rc = _write_hour_usage(mysql_conn, rollup, curr_start, curr_end,
+			       c_usage, assoc_usage_list, wckey_usage_list);
+	if ((rc == SLURM_SUCCESS) && commit && mysql_db_commit(mysql_conn)) {
+		error("Couldn't commit cluster (%s) hour rollup for %ld",
+		      cluster_name, curr_start);
+		rc = SLURM_ERROR;
+	}
+	slurm_mutex_unlock(&rollup->write_lock);
 
-			if (!r_usage->loc_tres ||
-			    !list_count(r_usage->loc_tres))
-				continue;
+end_it:
+	xfree(query);
+	_destroy_local_cluster_usage(c_usage);
 
-			t_itr = list_iterator_create(r_usage->loc_tres);
-			while ((loc_tres = list_next(t_itr))) {
-				int64_t idle = loc_tres->total_time -
-					loc_tres->time_alloc;
-				char *assoc = NULL;
-				ListIterator tmp_itr = NULL;
-				int assoc_cnt, resv_unused_secs;
-
-				if (idle <= 0)
-					break; /* since this will be
-						* the same for all TRES	*/
-
-				/* now divide that time by the number of
-				   associations in the reservation and add
-				   them to each association */
-				resv_unused_secs = idle;
-				assoc_cnt = list_count(r_usage->local_assocs);
-				if (assoc_cnt)
-					resv_unused_secs /= assoc_cnt;
-				/* info("resv %d got %d seconds for TRES %u " */
-				/*      "for %d assocs", */
-				/*      r_usage->id, resv_unused_secs, */
-				/*      loc_tres->id, */
-				/*      list_count(r_usage->local_assocs)); */
-				tmp_itr = list_iterator_create(
-					r_usage->local_assocs);
-				while ((assoc = list_next(tmp_itr))) {
-					uint32_t associd = slurm_atoul(assoc);
-					if ((last_id != associd) &&
-					    !(a_usage = list_find_first(
-						      assoc_usage_list,
-						      _find_id_usage,
-						      &associd))) {
-						a_usage = xmalloc(
-							sizeof(local_id_usage_t));
-						a_usage->id = associd;
-						list_append(assoc_usage_list,
-							    a_usage);
-						last_id = associd;
-						a_usage->loc_tres = list_create(
-							_destroy_local_tres_usage);
-					}
-
-					_add_time_tres(a_usage->loc_tres,
-						       TIME_ALLOC, loc_tres->id,
-						       resv_unused_secs, 0);
-				}
-				list_iterator_destroy(tmp_itr);
-			}
-			list_iterator_destroy(t_itr);
-		}
+	list_iterator_destroy(c_itr);
+	list_iterator_destroy(r_itr);
 
-		if (query) {
-			DB_DEBUG(DB_USAGE, mysql_conn->conn, "query\n%s",
-			         query);
-			rc = mysql_db_query(mysql_conn, query);
-			xfree(query);
-			if (rc != SLURM_SUCCESS) {
-				error("couldn't update reservations with unused time");
-				goto end_it;
-			}
-		}
+	xhash_free(assoc_usage_hash);
+	xhash_free(wckey_usage_hash);
+	FREE_NULL_LIST(assoc_usage_list);
+	FREE_NULL_LIST(cluster_down_list);
+	FREE_NULL_LIST(wckey_usage_list);
 
-		/* now apply the down time from the slurmctld disconnects */
-		if (c_usage) {
-			list_iterator_reset(c_itr);
-			while ((loc_c_usage = list_next(c_itr))) {
-				local_tres_usage_t *loc_tres;
-				ListIterator tmp_itr = list_iterator_create(
-					loc_c_usage->loc_tres);
-				while ((loc_tres = list_next(tmp_itr)))
-					_add_time_tres(c_usage->loc_tres,
-						       TIME_DOWN,
-						       loc_tres->id,
-						       loc_tres->total_time,
-						       0);
-				list_iterator_destroy(tmp_itr);
-			}
+	/* The unused wall of the reservations is written once all is done */
+	if (rc == SLURM_SUCCESS)
+		rollup->resv_usage[hour] = resv_usage_list;
+	else
+		FREE_NULL_LIST(resv_usage_list);
 
-			if ((rc = _process_cluster_usage(
-				     mysql_conn, cluster_name, curr_start,
-				     curr_end, now, c_usage))
-			    != SLURM_SUCCESS) {
-				goto end_it;
-			}
+	return rc;
+}
+
+/* Roll up the hours not taken by another thread yet. */
+static int _hourly_rollup_hours(mysql_conn_t *mysql_conn,
+				hourly_rollup_t *rollup, bool commit)
+{
+	int hour, rc = SLURM_SUCCESS;
+	time_t now;
+
+	while (rc == SLURM_SUCCESS) {
+		slurm_mutex_lock(&rollup->lock);
+		if ((rollup->rc != SLURM_SUCCESS) ||
+		    (rollup->next_hour >= rollup->hours)) {
+			slurm_mutex_unlock(&rollup->lock);
+			break;
 		}
+		hour = rollup->next_hour++;
+		slurm_mutex_unlock(&rollup->lock);
 
-		list_iterator_reset(a_itr);
-		while ((a_usage = list_next(a_itr)))
-			_create_id_usage_insert(cluster_name, ASSOC_TABLES,
-						curr_start, now,
-						a_usage, &query);
-		if (query) {
-			DB_DEBUG(DB_USAGE, mysql_conn->conn, "query\n%s",
-			         query);
-			rc = mysql_db_query(mysql_conn, query);
-			xfree(query);
-			if (rc != SLURM_SUCCESS) {
-				error("Couldn't add assoc hour rollup");
-				goto end_it;
-			}
+		rc = _hourly_rollup_hour(mysql_conn, rollup, hour, commit);
+
+		slurm_mutex_lock(&rollup->lock);
+		if (rc != SLURM_SUCCESS) {
+			if (rollup->rc == SLURM_SUCCESS)
+				rollup->rc = rc;
+		} else if ((++rollup->hours_done < rollup->hours) &&
+			   ((now = time(NULL)) >=
+			    (rollup->last_log + 60))) {
+			time_t left = (now - rollup->begin) *
+				(rollup->hours - rollup->hours_done) /
+				rollup->hours_done;
+
+			info("Hourly rollup of cluster %s: %d of %d hours done, about %ld seconds left",
+			     rollup->cluster_name, rollup->hours_done,
+			     rollup->hours, left);
+			rollup->last_log = now;
 		}
+		slurm_mutex_unlock(&rollup->lock);
+	}
 
-		if (!track_wckey)
-			goto end_loop;
-
-		list_iterator_reset(w_itr);
-		while ((w_usage = list_next(w_itr)))
-			_create_id_usage_insert(cluster_name, WCKEY_TABLES,
-						curr_start, now,
-						w_usage, &query);
-		if (query) {
-			DB_DEBUG(DB_USAGE, mysql_conn->conn, "query\n%s",
-			         query);
-			rc = mysql_db_query(mysql_conn, query);
-			xfree(query);
-			if (rc != SLURM_SUCCESS) {
-				error("Couldn't add wckey hour rollup");
-				goto end_it;
+	return rc;
+}
+
+static void *_hourly_rollup_thread(void *arg)
+{
+	hourly_rollup_t *rollup = (hourly_rollup_t *)arg;
+	mysql_conn_t mysql_conn;
+	int rc;
+
+	memset(&mysql_conn, 0, sizeof(mysql_conn_t));
+	mysql_conn.rollback = 1;
+	mysql_conn.conn = rollup->conn;
+	slurm_mutex_init(&mysql_conn.lock);
+
+	/* Each thread needs it's own connection, it commits each hour */
+	if (((rc = check_connection(&mysql_conn)) == SLURM_SUCCESS) &&
+	    ((rc = _hourly_rollup_hours(&mysql_conn, rollup, true)) !=
+	     SLURM_SUCCESS) &&
+	    mysql_db_rollback(&mysql_conn))
+		error("rollback failed");
+
+	mysql_db_close_db_connection(&mysql_conn);
+	slurm_mutex_destroy(&mysql_conn.lock);
+
+	slurm_mutex_lock(&rollup->lock);
+	if ((rc != SLURM_SUCCESS) && (rollup->rc == SLURM_SUCCESS))
+		rollup->rc = rc;
+	rollup->threads--;
+	slurm_cond_signal(&rollup->cond);
+	slurm_mutex_unlock(&rollup->lock);
+
+	return NULL;
+}
+
+/*
+ * Write the unused wall of the reservations at the end of the rollup,
+ * carrying it from one hour to the next in order.
+ */
+static int _update_resv_unused_wall(mysql_conn_t *mysql_conn,
+				    hourly_rollup_t *rollup)
+{
+	List last_usage = list_create(NULL);
+	local_resv_usage_t *r_usage, *prev_usage;
+	ListIterator itr;
+	char *query = NULL;
+	double unused_wall;
+	int hour, rc = SLURM_SUCCESS;
+
+	for (hour = 0; hour < rollup->hours; hour++) {
+		if (!rollup->resv_usage[hour])
+			continue;
+
+		itr = list_iterator_create(rollup->resv_usage[hour]);
+		while ((r_usage = list_next(itr))) {
+			if ((prev_usage = list_remove_first(
+				     last_usage, _find_resv_usage, r_usage)))
+				unused_wall = prev_usage->unused_wall;
+			else
+				unused_wall = r_usage->unused_wall;
+			if (r_usage->unused_reset)
+				unused_wall = 0;
+
+			unused_wall += r_usage->unused_add;
+			if (unused_wall < r_usage->unused_min) {
+				/*
+				 * With a Flex reservation you can easily have
+				 * more time than is possible.  Just print this
+				 * debug3 warning if it happens.
+				 */
+				debug3("WARNING: Unused wall is less than zero; this should never happen outside a Flex reservation. Setting it to zero for resv id = %d, start = %ld.",
+				       r_usage->id, r_usage->orig_start);
+				unused_wall = r_usage->unused_min;
 			}
+			r_usage->unused_wall = unused_wall;
+			list_append(last_usage, r_usage);
 		}
+		list_iterator_destroy(itr);
+	}
 
-	end_loop:
-		_destroy_local_cluster_usage(c_usage);
+	itr = list_iterator_create(last_usage);
+	while ((r_usage = list_next(itr)))
+		xstrfmtcat(query, "update \"%s_%s\" set unused_wall=%f where id_resv=%u and time_start=%ld;",
+			   rollup->cluster_name, resv_table,
+			   r_usage->unused_wall, r_usage->id,
+			   r_usage->orig_start);
+	list_iterator_destroy(itr);
+	FREE_NULL_LIST(last_usage);
 
-		c_usage     = NULL;
-		r_usage     = NULL;
-		a_usage     = NULL;
-		w_usage     = NULL;
+	if (query) {
+		DB_DEBUG(DB_USAGE, mysql_conn->conn, "query\n%s", query);
+		rc = mysql_db_query(mysql_conn, query);
+		xfree(query);
+		if (rc != SLURM_SUCCESS)
+			error("couldn't update reservations with unused time");
+	}
 
-		list_flush(assoc_usage_list);
-		list_flush(cluster_down_list);
-		list_flush(wckey_usage_list);
-		list_flush(resv_usage_list);
-		curr_start = curr_end;
-		curr_end = curr_start + add_sec;
+	return rc;
+}
+
+extern int as_mysql_hourly_rollup(mysql_conn_t *mysql_conn,
+				  char *cluster_name,
+				  time_t start, time_t end,
+				  uint16_t archive_data)
+{
+	int rc = SLURM_SUCCESS;
+	int i = 0, threads;
+	char *query = NULL;
+	MYSQL_RES *result = NULL;
+	MYSQL_ROW row;
+	hourly_rollup_t rollup;
+	time_t curr_start = start;
+	time_t curr_end = end;
+
+	char *job_req_inx[] = {
+		"job.job_db_inx",
+//		"job.id_job",
+		"job.id_assoc",
+		"job.id_wckey",
+		"job.array_task_pending",
+		"job.time_eligible",
+		"job.time_start",
+		"job.time_end",
+		"job.time_suspended",
+		"job.cpus_req",
+		"job.id_resv",
+		"job.tres_alloc"
+	};
+
+	char *suspend_req_inx[] = {
+		"time_start",
+		"time_end"
+	};
+
+	memset(&rollup, 0, sizeof(rollup));
+	rollup.begin = rollup.last_log = rollup.now = time(NULL);
+	rollup.cluster_name = cluster_name;
+	rollup.conn = mysql_conn->conn;
+	rollup.start = start;
+	rollup.track_wckey = slurm_get_track_wckey();
+	slurm_mutex_init(&rollup.lock);
+	slurm_cond_init(&rollup.cond, NULL);
+	slurm_mutex_init(&rollup.write_lock);
+
+	xstrfmtcat(rollup.job_str, "%s", job_req_inx[i]);
+	for (i = 1; i < ARRAY_SIZE(job_req_inx); i++) {
+		xstrfmtcat(rollup.job_str, ", %s", job_req_inx[i]);
 	}
-end_it:
+
+	i = 0;
+	xstrfmtcat(rollup.suspend_str, "%s", suspend_req_inx[i]);
+	for (i = 1; i < ARRAY_SIZE(suspend_req_inx); i++) {
+		xstrfmtcat(rollup.suspend_str, ", %s", suspend_req_inx[i]);
+	}
+
+	/* We need to figure out the dimensions of this cluster */
+	query = xstrdup_printf("select dimensions from %s where name='%s'",
+			       cluster_table, cluster_name);
+	DB_DEBUG(DB_USAGE, mysql_conn->conn, "query\n%s", query);
+	result = mysql_db_query_ret(mysql_conn, query, 0);
 	xfree(query);
-	xfree(suspend_str);
-	xfree(job_str);
-	_destroy_local_cluster_usage(c_usage);
 
-	if (a_itr)
-		list_iterator_destroy(a_itr);
-	if (c_itr)
-		list_iterator_destroy(c_itr);
-	if (w_itr)
-		list_iterator_destroy(w_itr);
-	if (r_itr)
-		list_iterator_destroy(r_itr);
+	if (!result) {
+		error("%s: error querying cluster_table", __func__);
+		rc = SLURM_ERROR;
+		goto end_it;
+	}
+	row = mysql_fetch_row(result);
 
-	FREE_NULL_LIST(assoc_usage_list);
-	FREE_NULL_LIST(cluster_down_list);
-	FREE_NULL_LIST(wckey_usage_list);
-	FREE_NULL_LIST(resv_usage_list);
+	if (!row) {
+		error("%s: no cluster by name %s known",
+		      __func__, cluster_name);
+		mysql_free_result(result);
+		rc = SLURM_ERROR;
+		goto end_it;
+	}
+
+	rollup.dims = atoi(row[0]);
+	mysql_free_result(result);
+
+	while ((rollup.start + (rollup.hours * 3600)) < end)
+		rollup.hours++;
+	rollup.resv_usage = xcalloc(rollup.hours, sizeof(List));
+
+/* 	info("begin start %s", slurm_ctime2(&curr_start)); */
+/* 	info("begin end %s", slurm_ctime2(&curr_end)); */
+
+	/*
+	 * The hours are independent from each other, after an outage roll
+	 * them up on several connections at once. The threads commit each
+	 * hour, if one fails the last rollup time is not updated and the
+	 * hours are all rolled up again next time.
+	 */
+	threads = MIN(rollup.hours,
+		      slurmdbd_conf ? slurmdbd_conf->rollup_threads : 1);
+	if (threads <= 1) {
+		rc = _hourly_rollup_hours(mysql_conn, &rollup, false);
+	} else {
+		debug("%s: rolling up %d hours of cluster %s with %d threads",
+		      __func__, rollup.hours, cluster_name, threads);
+		slurm_mutex_lock(&rollup.lock);
+		for (i = 0; i < threads; i++) {
+			slurm_thread_create_detached(NULL,
+						     _hourly_rollup_thread,
+						     &rollup);
+			rollup.threads++;
+		}
+		while (rollup.threads)
+			slurm_cond_wait(&rollup.cond, &rollup.lock);
+		rc = rollup.rc;
+		slurm_mutex_unlock(&rollup.lock);
+	}
+
+	if (rc == SLURM_SUCCESS)
+		rc = _update_resv_unused_wall(mysql_conn, &rollup);
+
+	if (rollup.hours > 1)
+		debug("%s: rolled up %d hours of cluster %s in %ld seconds",
+		      __func__, rollup.hours_done, cluster_name,
+		      time(NULL) - rollup.begin);
+end_it:
+	for (i = 0; i < rollup.hours; i++)
+		FREE_NULL_LIST(rollup.resv_usage[i]);
+	xfree(rollup.resv_usage);
+	xfree(rollup.suspend_str);
+	xfree(rollup.job_str);
+	slurm_mutex_destroy(&rollup.lock);
+	slurm_cond_destroy(&rollup.cond);
+	slurm_mutex_destroy(&rollup.write_lock);
 
 /* 	info("stop start %s", slurm_ctime2(&curr_start)); */
 /* 	info("stop end %s", slurm_ctime2(&curr_end)); */
@@ -1870,6 +2117,7 @@ end_it:
 
 	return rc;
 }
+
 extern int as_mysql_nonhour_rollup(mysql_conn_t *mysql_conn,
 				   bool run_month,
 				   char *cluster_name,
@@ -0,0 +1,227 @@
+/*****************************************************************************\
+ *  as_mysql_update_log.c - log of the updates sent to the slurmctlds.
+ *****************************************************************************
+ *  Copyright (C) 2021 SchedMD LLC.
+ *
+ *  This file is part of Slurm, a resource management program.
+ *  For details, see <https://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  Slurm is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  Slurm is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with Slurm; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+/*
+ * Every commit sending updates to the slurmctlds is given the next generation
+ * number and its update list is kept, packed, in memory. A slurmctld that
+ * saved its association state at some generation can then get the updates it
+ * missed since, instead of reading all the associations, QOS, users and
+ * wckeys again. The epoch identifies the log of this slurmdbd run, the log is
+ * not saved when the slurmdbd stops. Only the last UPDATE_LOG_MAX_CNT commits
+ * or UPDATE_LOG_MAX_SIZE bytes of updates are kept.
+ *
+ * Only the clusters whose slurmctld asked for updates from the log are sent
+ * the epoch and generation of an update (ACCOUNTING_UPDATE_LOG_MSG), older
+ * slurmctlds do not know that message.
+ */
+
+#include <unistd.h>
+
+#include "as_mysql_update_log.h"
+#include "src/common/slurmdb_pack.h"
+
+#define UPDATE_LOG_MAX_CNT 1024
+#define UPDATE_LOG_MAX_SIZE (64 * 1024 * 1024)
+
+typedef struct {
+	uint64_t gen;
+	buf_t *buffer;		/* packed update list */
+	uint32_t size;		/* bytes packed in buffer */
+} update_log_entry_t;
+
+static pthread_mutex_t log_lock = PTHREAD_MUTEX_INITIALIZER;
+static uint32_t log_epoch = 0;
+static uint64_t log_gen = 0;
+static List log_list = NULL;	/* list of update_log_entry_t, oldest first */
+static uint64_t log_size = 0;
+static List log_clusters = NULL; /* clusters reading the log, list of char * */
+
+static void _destroy_entry(void *x)
+{
+	update_log_entry_t *entry = x;
+
+	if (entry) {
+		free_buf(entry->buffer);
+		xfree(entry);
+	}
+}
+
+static void _init_log(void)
+{
+	if (log_list)
+		return;
+
+	log_list = list_create(_destroy_entry);
+	log_clusters = list_create(xfree_ptr);
+	/* Any value will do, as long as it is not used by another run */
+	log_epoch = (uint32_t) time(NULL) ^ ((uint32_t) getpid() << 16);
+	if (!log_epoch)
+		log_epoch = 1;
+}
+
+/* Append the updates of an entry to update_list */
+static int _unpack_entry(update_log_entry_t *entry, List update_list)
+{
+	slurmdb_update_object_t *object;
+	uint32_t count, i;
+	int rc = SLURM_SUCCESS;
+
+	set_buf_offset(entry->buffer, 0);
+	safe_unpack32(&count, entry->buffer);
+	for (i = 0; i < count; i++) {
+		if (slurmdb_unpack_update_object(&object,
+						 SLURM_PROTOCOL_VERSION,
+						 entry->buffer) != SLURM_SUCCESS)
+			goto unpack_error;
+		list_append(update_list, object);
+	}
+	goto end_it;
+
+unpack_error:
+	error("%s: unable to unpack updates of generation %"PRIu64,
+	      __func__, entry->gen);
+	rc = SLURM_ERROR;
+end_it:
+	set_buf_offset(entry->buffer, entry->size);
+	return rc;
+}
+
+extern uint64_t as_mysql_update_log_add(List update_list, uint32_t *epoch)
+{
+	update_log_entry_t *entry = xmalloc(sizeof(*entry));
+	slurmdb_update_object_t *object;
+	ListIterator itr;
+	uint64_t gen;
+
+	entry->buffer = init_buf(BUF_SIZE);
+	pack32(list_count(update_list), entry->buffer);
+	itr = list_iterator_create(update_list);
+	while ((object = list_next(itr)))
+		slurmdb_pack_update_object(object, SLURM_PROTOCOL_VERSION,
+					   entry->buffer);
+	list_iterator_destroy(itr);
+	entry->size = get_buf_offset(entry->buffer);
+
+	slurm_mutex_lock(&log_lock);
+	_init_log();
+	entry->gen = gen = ++log_gen;
+	*epoch = log_epoch;
+	log_size += entry->size;
+	list_append(log_list, entry);
+
+	while ((list_count(log_list) > UPDATE_LOG_MAX_CNT) ||
+	       (log_size > UPDATE_LOG_MAX_SIZE)) {
+		entry = list_pop(log_list);
+		log_size -= entry->size;
+		_destroy_entry(entry);
+	}
+	slurm_mutex_unlock(&log_lock);
+
+	return gen;
+}
+
+extern void as_mysql_update_log_get(char *cluster,
+				    uint32_t *epoch, uint64_t *gen,
+				    List *update_list)
+{
+	update_log_entry_t *entry;
+	ListIterator itr;
+	uint32_t req_epoch = *epoch;
+	uint64_t req_gen = *gen;
+
+	*update_list = NULL;
+
+	slurm_mutex_lock(&log_lock);
+	_init_log();
+	*epoch = log_epoch;
+	*gen = log_gen;
+
+	if (cluster && !list_find_first(log_clusters, slurm_find_char_in_list,
+					cluster))
+		list_append(log_clusters, xstrdup(cluster));
+
+	if ((req_epoch != log_epoch) || (req_gen > log_gen))
+		goto end_it;
+
+	/* Is the oldest update the caller misses still there? */
+	if ((req_gen < log_gen) &&
+	    (!(entry = list_peek(log_list)) || (entry->gen > req_gen + 1)))
+		goto end_it;
+
+	*update_list = list_create(slurmdb_destroy_update_object);
+	itr = list_iterator_create(log_list);
+	while ((entry = list_next(itr))) {
+		if ((entry->gen > req_gen) &&
+		    (_unpack_entry(entry, *update_list) != SLURM_SUCCESS)) {
+			FREE_NULL_LIST(*update_list);
+			break;
+		}
+	}
+	list_iterator_destroy(itr);
+
+end_it:
+	slurm_mutex_unlock(&log_lock);
+}
+
+extern bool as_mysql_update_log_wanted(char *cluster)
+{
+	bool wanted = false;
+
+	slurm_mutex_lock(&log_lock);
+	if (log_clusters && cluster)
+		wanted = list_find_first(log_clusters, slurm_find_char_in_list,
+					 cluster);
+	slurm_mutex_unlock(&log_lock);
+
+	return wanted;
+}
+
+extern void as_mysql_update_log_forget(char *cluster)
+{
+	slurm_mutex_lock(&log_lock);
+	if (log_clusters && cluster)
+		list_delete_all(log_clusters, slurm_find_char_in_list,
+				cluster);
+	slurm_mutex_unlock(&log_lock);
+}
+
+extern void as_mysql_update_log_fini(void)
+{
+	slurm_mutex_lock(&log_lock);
+	FREE_NULL_LIST(log_list);
+	FREE_NULL_LIST(log_clusters);
+	log_size = 0;
+	slurm_mutex_unlock(&log_lock);
+}
@@ -0,0 +1,71 @@
+/*****************************************************************************\
+ *  as_mysql_update_log.h - log of the updates sent to the slurmctlds.
+ *****************************************************************************
+ *  Copyright (C) 2021 SchedMD LLC.
+ *
+ *  This file is part of Slurm, a resource management program.
+ *  For details, see <https://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  Slurm is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  Slurm is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with Slurm; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+#ifndef _HAVE_MYSQL_UPDATE_LOG_H
+#define _HAVE_MYSQL_UPDATE_LOG_H
+
+#include "accounting_storage_mysql.h"
+
+/*
+ * Log the updates of a commit before sending them to the slurmctlds.
+ * IN update_list - list of slurmdb_update_object_t *
+ * OUT epoch - epoch of the log
+ * RET generation given to the updates
+ */
+extern uint64_t as_mysql_update_log_add(List update_list, uint32_t *epoch);
+
+/*
+ * Get the updates logged since a generation, see acct_storage_p_get_updates().
+ * IN cluster - cluster of the caller, sent the epoch and generation of the
+ *		updates from now on
+ * IN/OUT epoch, gen - version of the state of the caller, set to the current
+ *		       version of the log
+ * OUT update_list - list of slurmdb_update_object_t *, NULL if the log no
+ *		     longer holds all the updates since that version
+ */
+extern void as_mysql_update_log_get(char *cluster,
+				    uint32_t *epoch, uint64_t *gen,
+				    List *update_list);
+
+/* Does the slurmctld of the cluster read the log? */
+extern bool as_mysql_update_log_wanted(char *cluster);
+
+/* The slurmctld of the cluster registered or stopped, it may not be one
+ * reading the log anymore. */
+extern void as_mysql_update_log_forget(char *cluster);
+
+extern void as_mysql_update_log_fini(void);
+
+#endif
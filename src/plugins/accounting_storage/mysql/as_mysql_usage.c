@@ -38,6 +38,7 @@
 
 #include "as_mysql_cluster.h"
 #include "as_mysql_usage.h"
+#include "as_mysql_usage_cache.h"
 #include "as_mysql_rollup.h"
 #include "src/common/macros.h"
 #include "src/common/slurm_time.h"
@@ -81,6 +82,7 @@ static void *_cluster_rollup_usage(void *arg)
 	time_t day_end;
 	time_t month_start;
 	time_t month_end;
+	time_t cache_start[DBD_ROLLUP_COUNT] = { 0 };
 	DEF_TIMERS;
 
 	char *update_req_inx[] = {
@@ -308,6 +310,7 @@ static void *_cluster_rollup_usage(void *arg)
 		rollup_stats->timestamp[DBD_ROLLUP_HOUR] = hour_end;
 		if (rc != SLURM_SUCCESS)
 			goto end_it;
+		cache_start[DBD_ROLLUP_HOUR] = hour_start;
 	}
 
 	if ((day_end - day_start) > 0) {
@@ -324,6 +327,7 @@ static void *_cluster_rollup_usage(void *arg)
 		rollup_stats->timestamp[DBD_ROLLUP_DAY] = day_end;
 		if (rc != SLURM_SUCCESS)
 			goto end_it;
+		cache_start[DBD_ROLLUP_DAY] = day_start;
 	}
 
 	if ((month_end - month_start) > 0) {
@@ -340,6 +344,7 @@ static void *_cluster_rollup_usage(void *arg)
 		rollup_stats->timestamp[DBD_ROLLUP_MONTH] = month_end;
 		if (rc != SLURM_SUCCESS)
 			goto end_it;
+		cache_start[DBD_ROLLUP_MONTH] = month_start;
 	}
 
 	if ((hour_end - hour_start) > 0) {
@@ -388,7 +393,10 @@ end_it:
 			error("Couldn't commit rollup of cluster %s",
 			      local_rollup->cluster_name);
 			rc = SLURM_ERROR;
-		}
+		} else
+			as_mysql_usage_cache_rolled(&mysql_conn,
+						    local_rollup->cluster_name,
+						    cache_start);
 	} else {
 		error("Cluster %s rollup failed", local_rollup->cluster_name);
 		if (mysql_db_rollback(&mysql_conn))
@@ -414,6 +422,7 @@ end_it:
 static int _get_object_usage(mysql_conn_t *mysql_conn,
 			     slurmdbd_msg_type_t type, char *my_usage_table,
 			     char *cluster_name, char *id_str,
+			     uint32_t *ids, int id_cnt,
 			     time_t start, time_t end, List *usage_list)
 {
 	char *tmp = NULL;
@@ -438,6 +447,11 @@ static int _get_object_usage(mysql_conn_t *mysql_conn,
 		USAGE_COUNT
 	};
 
+	if (as_mysql_usage_cache_get(mysql_conn, type, my_usage_table,
+				     cluster_name, ids, id_cnt, start, end,
+				     usage_list) == SLURM_SUCCESS)
+		return SLURM_SUCCESS;
+
 	if (type == DBD_GET_WCKEY_USAGE)
 		usage_req_inx[0] = "t1.id";
 
@@ -563,6 +577,11 @@ static int _get_cluster_usage(mysql_conn_t *mysql_conn, uid_t uid,
 		return SLURM_ERROR;
 	}
 
+	if (as_mysql_usage_cache_get_cluster(mysql_conn, cluster_rec,
+					     my_usage_table, start, end) ==
+	    SLURM_SUCCESS)
+		return SLURM_SUCCESS;
+
 	xfree(tmp);
 	i=0;
 	xstrfmtcat(tmp, "%s", cluster_req_inx[i]);
@@ -631,6 +650,8 @@ extern int get_usage_for_list(mysql_conn_t *mysql_conn,
 	char *my_usage_table = NULL;
 	List usage_list = NULL;
 	char *id_str = NULL, *name_char = NULL;
+	uint32_t *ids = NULL;
+	int id_cnt = 0;
 	ListIterator itr = NULL, u_itr = NULL;
 	void *object = NULL;
 	slurmdb_assoc_rec_t *assoc = NULL;
@@ -645,6 +666,7 @@ extern int get_usage_for_list(mysql_conn_t *mysql_conn,
 	if (check_connection(mysql_conn) != SLURM_SUCCESS)
 		return ESLURM_DB_CONNECTION;
 
+	ids = xcalloc(list_count(object_list), sizeof(uint32_t));
 	switch (type) {
 	case DBD_GET_ASSOC_USAGE:
 		name_char = "t3.id_assoc";
@@ -655,6 +677,7 @@ extern int get_usage_for_list(mysql_conn_t *mysql_conn,
 			else
 				xstrfmtcat(id_str, "%s in (%u",
 					   name_char, assoc->id);
+			ids[id_cnt++] = assoc->id;
 		}
 		list_iterator_destroy(itr);
 		my_usage_table = assoc_day_table;
@@ -668,12 +691,14 @@ extern int get_usage_for_list(mysql_conn_t *mysql_conn,
 			else
 				xstrfmtcat(id_str, "%s in (%u",
 					   name_char, wckey->id);
+			ids[id_cnt++] = wckey->id;
 		}
 		list_iterator_destroy(itr);
 		my_usage_table = wckey_day_table;
 		break;
 	default:
 		error("Unknown usage type %d", type);
+		xfree(ids);
 		return SLURM_ERROR;
 		break;
 	}
@@ -684,17 +709,20 @@ extern int get_usage_for_list(mysql_conn_t *mysql_conn,
 	if (set_usage_information(&my_usage_table, type, &start, &end)
 	    != SLURM_SUCCESS) {
 		xfree(id_str);
+		xfree(ids);
 		return SLURM_ERROR;
 	}
 
 	if (_get_object_usage(mysql_conn, type, my_usage_table, cluster_name,
-			      id_str, start, end, &usage_list)
+			      id_str, ids, id_cnt, start, end, &usage_list)
 	    != SLURM_SUCCESS) {
 		xfree(id_str);
+		xfree(ids);
 		return SLURM_ERROR;
 	}
 
 	xfree(id_str);
+	xfree(ids);
 
 	if (!usage_list) {
 		error("No usage given back?  This should never happen");
@@ -777,6 +805,7 @@ extern int as_mysql_get_usage(mysql_conn_t *mysql_conn, uid_t uid,
 	List *my_list = NULL;
 	char *cluster_name = NULL;
 	char *id_str = NULL;
+	uint32_t id = 0;
 
 	if (check_connection(mysql_conn) != SLURM_SUCCESS)
 		return ESLURM_DB_CONNECTION;
@@ -788,6 +817,7 @@ extern int as_mysql_get_usage(mysql_conn_t *mysql_conn, uid_t uid,
 			return SLURM_ERROR;
 		}
 		id_str = xstrdup_printf("t3.id_assoc=%u", slurmdb_assoc->id);
+		id = slurmdb_assoc->id;
 		cluster_name = slurmdb_assoc->cluster;
 		username = slurmdb_assoc->user;
 		my_list = &slurmdb_assoc->accounting_list;
@@ -799,6 +829,7 @@ extern int as_mysql_get_usage(mysql_conn_t *mysql_conn, uid_t uid,
 			return SLURM_ERROR;
 		}
 		id_str = xstrdup_printf("id=%d", slurmdb_wckey->id);
+		id = slurmdb_wckey->id;
 		cluster_name = slurmdb_wckey->cluster;
 		username = slurmdb_wckey->user;
 		my_list = &slurmdb_wckey->accounting_list;
@@ -878,7 +909,7 @@ is_user:
 	}
 
 	_get_object_usage(mysql_conn, type, my_usage_table, cluster_name,
-			  id_str, start, end, my_list);
+			  id_str, &id, 1, start, end, my_list);
 	xfree(id_str);
 
 	return rc;
@@ -0,0 +1,995 @@
+/*****************************************************************************\
+ *  as_mysql_usage_cache.c - in memory copy of the usage tables.
+ *****************************************************************************
+ *  Copyright (C) 2021 SchedMD LLC.
+ *
+ *  This file is part of Slurm, a resource management program.
+ *  For details, see <https://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  Slurm is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  Slurm is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with Slurm; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+/*
+ * The rows of the hour, day and month usage tables starting in the last
+ * UsageCacheDays days (since the start of that month for the day and month
+ * tables) are kept in memory, indexed by cluster, association or wckey id,
+ * TRES and period, so usage queries of sreport or slurmrestd don't scan the
+ * usage tables. A table is read the first time it is queried and is reloaded
+ * from the start of each rollup once the rollup is committed. Queries starting
+ * before the rows kept in memory go to the database.
+ *
+ * As from the database, the usage of an association is returned as the rows
+ * of it and its children, found through the lft/rgt of the association table,
+ * also kept in memory and reloaded when associations are added, moved or
+ * removed.
+ */
+
+#include "as_mysql_usage_cache.h"
+#include "src/common/slurm_time.h"
+#include "src/common/xhash.h"
+
+enum {
+	CACHE_ASSOC,
+	CACHE_WCKEY,
+	CACHE_CLUSTER,
+	CACHE_TYPE_COUNT
+};
+
+typedef struct {
+	time_t period_start;
+	uint32_t tres_id;
+	uint64_t alloc_secs;
+} cache_usage_t;
+
+typedef struct {
+	uint32_t id;
+	cache_usage_t *usage;	/* sorted by period_start and tres_id */
+	uint32_t usage_cnt;
+	uint32_t usage_size;
+} cache_obj_t;
+
+typedef struct {
+	time_t period_start;
+	uint32_t tres_id;
+	uint64_t count;
+	uint64_t alloc_secs;
+	uint64_t down_secs;
+	uint64_t pdown_secs;
+	uint64_t idle_secs;
+	uint64_t resv_secs;
+	uint64_t over_secs;
+} cache_cluster_usage_t;
+
+typedef struct {
+	bool loaded;
+	time_t start;		/* rows starting before are not in memory */
+	xhash_t *objs;		/* cache_obj_t of assoc and wckey tables */
+	cache_cluster_usage_t *usage; /* rows of cluster tables, sorted by
+				       * period_start and tres_id */
+	uint32_t usage_cnt;
+	uint32_t usage_size;
+} cache_table_t;
+
+typedef struct {
+	uint32_t id;
+	uint32_t lft;
+	uint32_t rgt;
+} cache_assoc_t;
+
+typedef struct {
+	char *cluster_name;
+	pthread_rwlock_t lock;
+	cache_table_t tables[CACHE_TYPE_COUNT][DBD_ROLLUP_COUNT];
+	cache_assoc_t *assocs;	/* sorted by lft */
+	uint32_t assoc_cnt;
+	xhash_t *assoc_hash;	/* cache_assoc_t of assocs by id */
+	uint32_t assoc_gen;	/* assoc_gen the assocs were read at */
+	/* incremented every time a table is read or cleared */
+	uint32_t table_gen[CACHE_TYPE_COUNT][DBD_ROLLUP_COUNT];
+} cache_cluster_t;
+
+typedef struct {
+	mysql_conn_t *mysql_conn;
+	char *cluster_name;
+} cache_pending_t;
+
+static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
+static List cache_clusters = NULL;	/* cache_cluster_t, never removed */
+static List cache_pending = NULL;	/* cache_pending_t */
+static uint32_t assoc_gen = 1;
+
+static void _obj_id(void *item, const char **key, uint32_t *key_len)
+{
+	cache_obj_t *obj = item;
+
+	*key = (const char *) &obj->id;
+	*key_len = sizeof(obj->id);
+}
+
+static void _assoc_id(void *item, const char **key, uint32_t *key_len)
+{
+	cache_assoc_t *assoc = item;
+
+	*key = (const char *) &assoc->id;
+	*key_len = sizeof(assoc->id);
+}
+
+static void _free_obj(void *item)
+{
+	cache_obj_t *obj = item;
+
+	xfree(obj->usage);
+	xfree(obj);
+}
+
+static void _free_table(cache_table_t *table)
+{
+	xhash_free_ptr(&table->objs);
+	xfree(table->usage);
+	memset(table, 0, sizeof(*table));
+}
+
+static void _free_assocs(cache_cluster_t *cluster)
+{
+	xhash_free_ptr(&cluster->assoc_hash);
+	xfree(cluster->assocs);
+	cluster->assoc_cnt = 0;
+	cluster->assoc_gen = 0;
+}
+
+static void _destroy_cluster(void *object)
+{
+	cache_cluster_t *cluster = object;
+
+	for (int i = 0; i < CACHE_TYPE_COUNT; i++)
+		for (int j = 0; j < DBD_ROLLUP_COUNT; j++)
+			_free_table(&cluster->tables[i][j]);
+	_free_assocs(cluster);
+	slurm_rwlock_destroy(&cluster->lock);
+	xfree(cluster->cluster_name);
+	xfree(cluster);
+}
+
+static void _destroy_pending(void *object)
+{
+	cache_pending_t *pending = object;
+
+	xfree(pending->cluster_name);
+	xfree(pending);
+}
+
+static int _find_cluster(void *x, void *key)
+{
+	cache_cluster_t *cluster = x;
+
+	return !xstrcmp(cluster->cluster_name, key);
+}
+
+static int _find_pending(void *x, void *key)
+{
+	cache_pending_t *pending = x;
+
+	return (pending->mysql_conn == key);
+}
+
+static bool _enabled(void)
+{
+	return (slurmdbd_conf && slurmdbd_conf->usage_cache_days);
+}
+
+/* Find the type and period of a usage table */
+static bool _find_table(char *my_usage_table, int *type, int *period)
+{
+	char *tables[CACHE_TYPE_COUNT][DBD_ROLLUP_COUNT] = {
+		{ assoc_hour_table, assoc_day_table, assoc_month_table },
+		{ wckey_hour_table, wckey_day_table, wckey_month_table },
+		{ cluster_hour_table, cluster_day_table, cluster_month_table },
+	};
+
+	for (int i = 0; i < CACHE_TYPE_COUNT; i++) {
+		for (int j = 0; j < DBD_ROLLUP_COUNT; j++) {
+			if (!xstrcmp(my_usage_table, tables[i][j])) {
+				*type = i;
+				*period = j;
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+static char *_table_name(int type, int period)
+{
+	char *table_name = NULL;
+
+	switch (type) {
+	case CACHE_ASSOC:
+		table_name = (period == DBD_ROLLUP_HOUR) ? assoc_hour_table :
+			(period == DBD_ROLLUP_DAY) ? assoc_day_table :
+			assoc_month_table;
+		break;
+	case CACHE_WCKEY:
+		table_name = (period == DBD_ROLLUP_HOUR) ? wckey_hour_table :
+			(period == DBD_ROLLUP_DAY) ? wckey_day_table :
+			wckey_month_table;
+		break;
+	case CACHE_CLUSTER:
+		table_name = (period == DBD_ROLLUP_HOUR) ? cluster_hour_table :
+			(period == DBD_ROLLUP_DAY) ? cluster_day_table :
+			cluster_month_table;
+		break;
+	}
+
+	return table_name;
+}
+
+/* Start of the rows of a period kept in memory */
+static time_t _cutoff(int period)
+{
+	time_t cutoff = time(NULL) -
+		((time_t) slurmdbd_conf->usage_cache_days * 86400);
+	struct tm cutoff_tm;
+
+	if (!localtime_r(&cutoff, &cutoff_tm))
+		return time(NULL);
+	cutoff_tm.tm_sec = 0;
+	cutoff_tm.tm_min = 0;
+	cutoff_tm.tm_hour = 0;
+	if (period != DBD_ROLLUP_HOUR)
+		cutoff_tm.tm_mday = 1;
+
+	return slurm_mktime(&cutoff_tm);
+}
+
+static uint32_t _get_assoc_gen(void)
+{
+	uint32_t gen;
+
+	slurm_mutex_lock(&cache_lock);
+	gen = assoc_gen;
+	slurm_mutex_unlock(&cache_lock);
+
+	return gen;
+}
+
+static cache_cluster_t *_get_cluster(char *cluster_name, bool create)
+{
+	cache_cluster_t *cluster;
+
+	slurm_mutex_lock(&cache_lock);
+	if (!cache_clusters)
+		cache_clusters = list_create(_destroy_cluster);
+	if (!(cluster = list_find_first(cache_clusters, _find_cluster,
+					cluster_name)) && create) {
+		cluster = xmalloc(sizeof(*cluster));
+		cluster->cluster_name = xstrdup(cluster_name);
+		slurm_rwlock_init(&cluster->lock);
+		list_append(cache_clusters, cluster);
+	}
+	slurm_mutex_unlock(&cache_lock);
+
+	return cluster;
+}
+
+/* Index of the first usage of obj starting at or after period_start */
+static uint32_t _first_obj_usage(cache_obj_t *obj, time_t period_start)
+{
+	uint32_t lo = 0, hi = obj->usage_cnt;
+
+	while (lo < hi) {
+		uint32_t mid = lo + ((hi - lo) / 2);
+
+		if (obj->usage[mid].period_start < period_start)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+static uint32_t _first_cluster_usage(cache_table_t *table,
+				     time_t period_start)
+{
+	uint32_t lo = 0, hi = table->usage_cnt;
+
+	while (lo < hi) {
+		uint32_t mid = lo + ((hi - lo) / 2);
+
+		if (table->usage[mid].period_start < period_start)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+typedef struct {
+	time_t cutoff;
+	time_t from;
+} cache_trim_t;
+
+/* Drop the usage before cutoff and from "from" on */
+static void _trim_obj(void *item, void *arg)
+{
+	cache_obj_t *obj = item;
+	cache_trim_t *trim = arg;
+	uint32_t first = _first_obj_usage(obj, trim->cutoff);
+
+	obj->usage_cnt = _first_obj_usage(obj, trim->from);
+	if (!first)
+		return;
+	obj->usage_cnt -= first;
+	memmove(obj->usage, obj->usage + first,
+		sizeof(cache_usage_t) * obj->usage_cnt);
+}
+
+static void _trim_table(cache_table_t *table, int type, time_t cutoff,
+			time_t from)
+{
+	if (type == CACHE_CLUSTER) {
+		uint32_t first = _first_cluster_usage(table, cutoff);
+
+		table->usage_cnt = _first_cluster_usage(table, from);
+		table->usage_cnt -= first;
+		memmove(table->usage, table->usage + first,
+			sizeof(cache_cluster_usage_t) * table->usage_cnt);
+	} else {
+		cache_trim_t trim = { .cutoff = cutoff, .from = from };
+
+		xhash_walk(table->objs, _trim_obj, &trim);
+	}
+}
+
+static void _add_obj_row(cache_table_t *table, cache_obj_t **obj_ptr,
+			 MYSQL_ROW row)
+{
+	uint32_t id = slurm_atoul(row[0]);
+	cache_obj_t *obj = *obj_ptr;
+	cache_usage_t *usage;
+
+	if (!obj || (obj->id != id)) {
+		if (!(obj = xhash_get(table->objs, (char *) &id, sizeof(id)))) {
+			obj = xmalloc(sizeof(*obj));
+			obj->id = id;
+			xhash_add(table->objs, obj);
+		}
+		*obj_ptr = obj;
+	}
+
+	if (obj->usage_cnt >= obj->usage_size) {
+		obj->usage_size = obj->usage_size ? (obj->usage_size * 2) : 32;
+		xrealloc(obj->usage, sizeof(cache_usage_t) * obj->usage_size);
+	}
+	usage = &obj->usage[obj->usage_cnt++];
+	usage->tres_id = slurm_atoul(row[1]);
+	usage->period_start = slurm_atoul(row[2]);
+	usage->alloc_secs = slurm_atoull(row[3]);
+}
+
+static void _add_cluster_row(cache_table_t *table, MYSQL_ROW row)
+{
+	cache_cluster_usage_t *usage;
+
+	if (table->usage_cnt >= table->usage_size) {
+		table->usage_size = table->usage_size ?
+			(table->usage_size * 2) : 256;
+		xrealloc(table->usage,
+			 sizeof(cache_cluster_usage_t) * table->usage_size);
+	}
+	usage = &table->usage[table->usage_cnt++];
+	usage->tres_id = slurm_atoul(row[0]);
+	usage->alloc_secs = slurm_atoull(row[1]);
+	usage->down_secs = slurm_atoull(row[2]);
+	usage->pdown_secs = slurm_atoull(row[3]);
+	usage->idle_secs = slurm_atoull(row[4]);
+	usage->resv_secs = slurm_atoull(row[5]);
+	usage->over_secs = slurm_atoull(row[6]);
+	usage->count = slurm_atoul(row[7]);
+	usage->period_start = slurm_atoul(row[8]);
+}
+
+/*
+ * Read the rows of a usage table starting at or after "from" into rows.
+ * No lock is held, the rows are merged by _merge_table().
+ */
+static int _read_table(mysql_conn_t *mysql_conn, char *cluster_name,
+		       int type, int period, time_t from, cache_table_t *rows)
+{
+	char *table_name = _table_name(type, period);
+	cache_obj_t *obj = NULL;
+	MYSQL_RES *result;
+	MYSQL_ROW row;
+	uint64_t row_cnt = 0;
+	char *query;
+	DEF_TIMERS;
+
+	START_TIMER;
+	if (type == CACHE_CLUSTER)
+		query = xstrdup_printf(
+			"select id_tres, alloc_secs, down_secs, pdown_secs, "
+			"idle_secs, resv_secs, over_secs, count, time_start "
+			"from \"%s_%s\" where time_start >= %ld "
+			"order by time_start, id_tres",
+			cluster_name, table_name, from);
+	else
+		query = xstrdup_printf(
+			"select id, id_tres, time_start, alloc_secs "
+			"from \"%s_%s\" where time_start >= %ld "
+			"order by id, time_start, id_tres",
+			cluster_name, table_name, from);
+
+	DB_DEBUG(DB_USAGE, mysql_conn->conn, "query\n%s", query);
+	result = mysql_db_query_ret(mysql_conn, query, 0);
+	xfree(query);
+	if (!result)
+		return SLURM_ERROR;
+
+	if (type != CACHE_CLUSTER)
+		rows->objs = xhash_init(_obj_id, _free_obj);
+	while ((row = mysql_fetch_row(result))) {
+		if (type == CACHE_CLUSTER)
+			_add_cluster_row(rows, row);
+		else
+			_add_obj_row(rows, &obj, row);
+		row_cnt++;
+	}
+	mysql_free_result(result);
+
+	END_TIMER;
+	DB_DEBUG(DB_USAGE, mysql_conn->conn,
+		 "read %"PRIu64" rows of %s_%s starting at %ld in %s",
+		 row_cnt, cluster_name, table_name, from, TIME_STR);
+
+	return SLURM_SUCCESS;
+}
+
+/* Append the usage of a cache_obj_t of the rows read to the table */
+static void _merge_obj(void *item, void *arg)
+{
+	cache_obj_t *rows_obj = item, *obj;
+	cache_table_t *table = arg;
+
+	if (!(obj = xhash_get(table->objs, (char *) &rows_obj->id,
+			      sizeof(rows_obj->id)))) {
+		obj = xmalloc(sizeof(*obj));
+		obj->id = rows_obj->id;
+		xhash_add(table->objs, obj);
+	}
+
+	if ((obj->usage_cnt + rows_obj->usage_cnt) > obj->usage_size) {
+		obj->usage_size = obj->usage_cnt + rows_obj->usage_cnt;
+		xrealloc(obj->usage, sizeof(cache_usage_t) * obj->usage_size);
+	}
+	memcpy(obj->usage + obj->usage_cnt, rows_obj->usage,
+	       sizeof(cache_usage_t) * rows_obj->usage_cnt);
+	obj->usage_cnt += rows_obj->usage_cnt;
+}
+
+/*
+ * Replace the rows of the table starting at or after "from" by the ones read
+ * by _read_table(), which are consumed. cluster->lock must be write locked.
+ */
+static void _merge_table(cache_table_t *table, int type, cache_table_t *rows,
+			 time_t cutoff, time_t from)
+{
+	if (!table->loaded) {
+		*table = *rows;
+		memset(rows, 0, sizeof(*rows));
+	} else {
+		_trim_table(table, type, cutoff, from);
+		if (type != CACHE_CLUSTER) {
+			xhash_walk(rows->objs, _merge_obj, table);
+		} else if (rows->usage_cnt) {
+			uint32_t cnt = table->usage_cnt + rows->usage_cnt;
+
+			if (cnt > table->usage_size) {
+				table->usage_size = cnt;
+				xrealloc(table->usage,
+					 sizeof(cache_cluster_usage_t) * cnt);
+			}
+			memcpy(table->usage + table->usage_cnt, rows->usage,
+			       sizeof(cache_cluster_usage_t) *
+			       rows->usage_cnt);
+			table->usage_cnt = cnt;
+		}
+		_free_table(rows);
+	}
+
+	table->start = cutoff;
+	table->loaded = true;
+}
+
+/*
+ * Read the rows of a usage table starting at or after "from", replacing the
+ * ones in memory. The whole table is read if it is not in memory yet.
+ * The database is read without cluster->lock held so queries of the other
+ * tables, and of this one when reloading it after a rollup, are not blocked.
+ * cluster->lock must not be locked.
+ */
+static int _load_table(mysql_conn_t *mysql_conn, cache_cluster_t *cluster,
+		       int type, int period, time_t from)
+{
+	cache_table_t *table = &cluster->tables[type][period];
+	cache_table_t rows = { 0 };
+	time_t cutoff = _cutoff(period);
+	uint32_t table_gen;
+	bool loaded;
+	int rc;
+
+	slurm_rwlock_rdlock(&cluster->lock);
+	loaded = table->loaded;
+	table_gen = cluster->table_gen[type][period];
+	slurm_rwlock_unlock(&cluster->lock);
+
+	from = loaded ? MAX(from, cutoff) : cutoff;
+	rc = _read_table(mysql_conn, cluster->cluster_name, type, period, from,
+			 &rows);
+
+	slurm_rwlock_wrlock(&cluster->lock);
+	if (!rc && !loaded && table->loaded) {
+		/* another query read the whole table meanwhile */
+		_free_table(&rows);
+	} else if (!rc && (table_gen == cluster->table_gen[type][period])) {
+		_merge_table(table, type, &rows, cutoff, from);
+		cluster->table_gen[type][period]++;
+	} else {
+		/*
+		 * The read failed or the table changed while it was read, so
+		 * the rows in memory may be stale. Read it again when queried.
+		 */
+		_free_table(&rows);
+		_free_table(table);
+		cluster->table_gen[type][period]++;
+		rc = SLURM_ERROR;
+	}
+	slurm_rwlock_unlock(&cluster->lock);
+
+	return rc;
+}
+
+/* Read the association hierarchy, cluster->lock must not be locked */
+static int _load_assocs(mysql_conn_t *mysql_conn, cache_cluster_t *cluster)
+{
+	uint32_t gen = _get_assoc_gen();
+	uint32_t assoc_size = 0, assoc_cnt = 0;
+	cache_assoc_t *assocs;
+	MYSQL_RES *result;
+	MYSQL_ROW row;
+	char *query;
+
+	query = xstrdup_printf("select id_assoc, lft, rgt from \"%s_%s\" "
+			       "order by lft",
+			       cluster->cluster_name, assoc_table);
+	DB_DEBUG(DB_USAGE, mysql_conn->conn, "query\n%s", query);
+	result = mysql_db_query_ret(mysql_conn, query, 0);
+	xfree(query);
+	if (!result)
+		return SLURM_ERROR;
+
+	assoc_size = mysql_num_rows(result);
+	assocs = xcalloc(MAX(assoc_size, 1), sizeof(cache_assoc_t));
+	while ((row = mysql_fetch_row(result)) && (assoc_cnt < assoc_size)) {
+		cache_assoc_t *assoc = &assocs[assoc_cnt++];
+
+		assoc->id = slurm_atoul(row[0]);
+		assoc->lft = slurm_atoul(row[1]);
+		assoc->rgt = slurm_atoul(row[2]);
+	}
+	mysql_free_result(result);
+
+	/*
+	 * A change made while reading leaves assoc_gen behind _get_assoc_gen()
+	 * so the hierarchy is read again by the next query.
+	 */
+	slurm_rwlock_wrlock(&cluster->lock);
+	_free_assocs(cluster);
+	cluster->assocs = assocs;
+	cluster->assoc_cnt = assoc_cnt;
+	cluster->assoc_hash = xhash_init(_assoc_id, NULL);
+	for (uint32_t i = 0; i < cluster->assoc_cnt; i++)
+		xhash_add(cluster->assoc_hash, &cluster->assocs[i]);
+	cluster->assoc_gen = gen;
+	slurm_rwlock_unlock(&cluster->lock);
+
+	return SLURM_SUCCESS;
+}
+
+static bool _table_ready(cache_cluster_t *cluster, int type, int period,
+			 time_t start)
+{
+	cache_table_t *table = &cluster->tables[type][period];
+
+	if (!table->loaded || (start < table->start))
+		return false;
+	if ((type == CACHE_ASSOC) && (cluster->assoc_gen != _get_assoc_gen()))
+		return false;
+
+	return true;
+}
+
+/*
+ * Read lock the cluster with the table ready to be queried, reading it from
+ * the database first if needed.
+ */
+static int _rdlock_table(mysql_conn_t *mysql_conn, cache_cluster_t *cluster,
+			 int type, int period, time_t start)
+{
+	int rc = SLURM_SUCCESS;
+	bool loaded, assocs_changed;
+
+	slurm_rwlock_rdlock(&cluster->lock);
+	if (_table_ready(cluster, type, period, start))
+		return SLURM_SUCCESS;
+	loaded = cluster->tables[type][period].loaded;
+	assocs_changed = ((type == CACHE_ASSOC) &&
+			  (cluster->assoc_gen != _get_assoc_gen()));
+	slurm_rwlock_unlock(&cluster->lock);
+
+	if (!loaded)
+		rc = _load_table(mysql_conn, cluster, type, period, 0);
+	if ((rc == SLURM_SUCCESS) && assocs_changed)
+		rc = _load_assocs(mysql_conn, cluster);
+	if (rc != SLURM_SUCCESS)
+		return rc;
+
+	/* The associations may have changed again, let the database answer */
+	slurm_rwlock_rdlock(&cluster->lock);
+	if (_table_ready(cluster, type, period, start))
+		return SLURM_SUCCESS;
+	slurm_rwlock_unlock(&cluster->lock);
+
+	return SLURM_ERROR;
+}
+
+static int _sort_usage(const void *a, const void *b)
+{
+	const cache_usage_t *usage_a = a;
+	const cache_usage_t *usage_b = b;
+
+	if (usage_a->period_start != usage_b->period_start)
+		return (usage_a->period_start < usage_b->period_start) ? -1 : 1;
+	if (usage_a->tres_id != usage_b->tres_id)
+		return (usage_a->tres_id < usage_b->tres_id) ? -1 : 1;
+	return 0;
+}
+
+/* Append the usage of an object in [start, end) to sums */
+static void _add_obj_usage(cache_table_t *table, uint32_t id,
+			   time_t start, time_t end, cache_usage_t **sums,
+			   uint32_t *sum_cnt, uint32_t *sum_size)
+{
+	cache_obj_t *obj;
+	uint32_t first, last;
+
+	if (!(obj = xhash_get(table->objs, (char *) &id, sizeof(id))))
+		return;
+
+	first = _first_obj_usage(obj, start);
+	last = _first_obj_usage(obj, end);
+	if (first >= last)
+		return;
+
+	if ((*sum_cnt + (last - first)) > *sum_size) {
+		*sum_size = MAX(*sum_size * 2, *sum_cnt + (last - first));
+		xrealloc(*sums, sizeof(cache_usage_t) * (*sum_size));
+	}
+	memcpy(*sums + *sum_cnt, obj->usage + first,
+	       sizeof(cache_usage_t) * (last - first));
+	*sum_cnt += last - first;
+}
+
+/* Index of the first association with a lft at or after lft */
+static uint32_t _first_assoc(cache_cluster_t *cluster, uint32_t lft)
+{
+	uint32_t lo = 0, hi = cluster->assoc_cnt;
+
+	while (lo < hi) {
+		uint32_t mid = lo + ((hi - lo) / 2);
+
+		if (cluster->assocs[mid].lft < lft)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+static void _set_tres_rec(slurmdb_tres_rec_t *tres_rec, uint32_t tres_id)
+{
+	slurmdb_tres_rec_t *tres;
+
+	tres_rec->id = tres_id;
+	if ((tres = list_find_first(assoc_mgr_tres_list,
+				    slurmdb_find_tres_in_list, &tres_id))) {
+		tres_rec->name = xstrdup(tres->name);
+		tres_rec->type = xstrdup(tres->type);
+	}
+}
+
+extern int as_mysql_usage_cache_get(mysql_conn_t *mysql_conn,
+				    slurmdbd_msg_type_t type,
+				    char *my_usage_table, char *cluster_name,
+				    uint32_t *ids, int id_cnt,
+				    time_t start, time_t end,
+				    List *usage_list)
+{
+	cache_cluster_t *cluster;
+	cache_table_t *table;
+	cache_usage_t *sums = NULL;
+	uint32_t sum_cnt = 0, sum_size = 0;
+	int cache_type, period;
+	assoc_mgr_lock_t locks = { NO_LOCK, NO_LOCK, NO_LOCK, NO_LOCK,
+				   READ_LOCK, NO_LOCK, NO_LOCK };
+
+	if (!_enabled() || !cluster_name ||
+	    !_find_table(my_usage_table, &cache_type, &period) ||
+	    (cache_type != ((type == DBD_GET_ASSOC_USAGE) ?
+			    CACHE_ASSOC : CACHE_WCKEY)) ||
+	    (start < _cutoff(period)))
+		return SLURM_ERROR;
+
+	cluster = _get_cluster(cluster_name, true);
+	if (_rdlock_table(mysql_conn, cluster, cache_type, period, start) !=
+	    SLURM_SUCCESS)
+		return SLURM_ERROR;
+	table = &cluster->tables[cache_type][period];
+
+	if (!(*usage_list))
+		(*usage_list) = list_create(slurmdb_destroy_accounting_rec);
+
+	assoc_mgr_lock(&locks);
+	for (int i = 0; i < id_cnt; i++) {
+		sum_cnt = 0;
+		if (cache_type == CACHE_ASSOC) {
+			cache_assoc_t *parent;
+			uint32_t inx;
+
+			if (!(parent = xhash_get(cluster->assoc_hash,
+						 (char *) &ids[i],
+						 sizeof(ids[i]))))
+				continue;
+
+			/* Children are the assocs with a lft in lft..rgt */
+			for (inx = _first_assoc(cluster, parent->lft);
+			     (inx < cluster->assoc_cnt) &&
+			     (cluster->assocs[inx].lft <= parent->rgt); inx++)
+				_add_obj_usage(table, cluster->assocs[inx].id,
+					       start, end, &sums, &sum_cnt,
+					       &sum_size);
+			qsort(sums, sum_cnt, sizeof(cache_usage_t),
+			      _sort_usage);
+		} else {
+			_add_obj_usage(table, ids[i], start, end, &sums,
+				       &sum_cnt, &sum_size);
+		}
+
+		for (uint32_t j = 0; j < sum_cnt; j++) {
+			slurmdb_accounting_rec_t *accounting_rec =
+				xmalloc(sizeof(*accounting_rec));
+
+			_set_tres_rec(&accounting_rec->tres_rec,
+				      sums[j].tres_id);
+			accounting_rec->id = ids[i];
+			accounting_rec->period_start = sums[j].period_start;
+			accounting_rec->alloc_secs = sums[j].alloc_secs;
+			list_append(*usage_list, accounting_rec);
+		}
+	}
+	assoc_mgr_unlock(&locks);
+	slurm_rwlock_unlock(&cluster->lock);
+	xfree(sums);
+
+	DB_DEBUG(DB_USAGE, mysql_conn->conn,
+		 "usage of %d objects of %s_%s read from memory",
+		 id_cnt, cluster_name, my_usage_table);
+
+	return SLURM_SUCCESS;
+}
+
+extern int as_mysql_usage_cache_get_cluster(
+	mysql_conn_t *mysql_conn, slurmdb_cluster_rec_t *cluster_rec,
+	char *my_usage_table, time_t start, time_t end)
+{
+	cache_cluster_t *cluster;
+	cache_table_t *table;
+	int cache_type, period;
+	uint32_t first, last;
+	assoc_mgr_lock_t locks = { NO_LOCK, NO_LOCK, NO_LOCK, NO_LOCK,
+				   READ_LOCK, NO_LOCK, NO_LOCK };
+
+	if (!_enabled() ||
+	    !_find_table(my_usage_table, &cache_type, &period) ||
+	    (cache_type != CACHE_CLUSTER) || (start < _cutoff(period)))
+		return SLURM_ERROR;
+
+	cluster = _get_cluster(cluster_rec->name, true);
+	if (_rdlock_table(mysql_conn, cluster, cache_type, period, start) !=
+	    SLURM_SUCCESS)
+		return SLURM_ERROR;
+	table = &cluster->tables[cache_type][period];
+
+	if (!cluster_rec->accounting_list)
+		cluster_rec->accounting_list =
+			list_create(slurmdb_destroy_cluster_accounting_rec);
+
+	first = _first_cluster_usage(table, start);
+	last = _first_cluster_usage(table, end);
+
+	assoc_mgr_lock(&locks);
+	for (uint32_t i = first; i < last; i++) {
+		cache_cluster_usage_t *usage = &table->usage[i];
+		slurmdb_cluster_accounting_rec_t *accounting_rec =
+			xmalloc(sizeof(*accounting_rec));
+
+		_set_tres_rec(&accounting_rec->tres_rec, usage->tres_id);
+		accounting_rec->tres_rec.count = usage->count;
+		accounting_rec->alloc_secs = usage->alloc_secs;
+		accounting_rec->down_secs = usage->down_secs;
+		accounting_rec->pdown_secs = usage->pdown_secs;
+		accounting_rec->idle_secs = usage->idle_secs;
+		accounting_rec->over_secs = usage->over_secs;
+		accounting_rec->resv_secs = usage->resv_secs;
+		accounting_rec->period_start = usage->period_start;
+		list_append(cluster_rec->accounting_list, accounting_rec);
+	}
+	assoc_mgr_unlock(&locks);
+	slurm_rwlock_unlock(&cluster->lock);
+
+	DB_DEBUG(DB_USAGE, mysql_conn->conn,
+		 "usage of %s_%s read from memory",
+		 cluster_rec->name, my_usage_table);
+
+	return SLURM_SUCCESS;
+}
+
+extern void as_mysql_usage_cache_rolled(mysql_conn_t *mysql_conn,
+					char *cluster_name,
+					time_t *period_start)
+{
+	cache_cluster_t *cluster;
+
+	if (!_enabled() || !(cluster = _get_cluster(cluster_name, false)))
+		return;
+
+	for (int i = 0; i < CACHE_TYPE_COUNT; i++) {
+		for (int j = 0; j < DBD_ROLLUP_COUNT; j++) {
+			bool loaded;
+
+			if (!period_start[j])
+				continue;
+
+			slurm_rwlock_rdlock(&cluster->lock);
+			loaded = cluster->tables[i][j].loaded;
+			slurm_rwlock_unlock(&cluster->lock);
+			if (!loaded)
+				continue;
+
+			if (_load_table(mysql_conn, cluster, i, j,
+					period_start[j]) != SLURM_SUCCESS)
+				error("%s: couldn't reload %s_%s, it will be read again when queried",
+				      __func__, cluster_name,
+				      _table_name(i, j));
+		}
+	}
+}
+
+static int _clear_cluster(void *x, void *key)
+{
+	cache_cluster_t *cluster = x;
+
+	if (key && xstrcmp(cluster->cluster_name, key))
+		return 0;
+
+	slurm_rwlock_wrlock(&cluster->lock);
+	for (int i = 0; i < CACHE_TYPE_COUNT; i++) {
+		for (int j = 0; j < DBD_ROLLUP_COUNT; j++) {
+			_free_table(&cluster->tables[i][j]);
+			cluster->table_gen[i][j]++;
+		}
+	}
+	_free_assocs(cluster);
+	slurm_rwlock_unlock(&cluster->lock);
+
+	return 0;
+}
+
+extern void as_mysql_usage_cache_clear(char *cluster_name)
+{
+	List clusters;
+
+	/* Don't hold cache_lock while waiting on the cluster locks */
+	slurm_mutex_lock(&cache_lock);
+	if (!cache_clusters) {
+		slurm_mutex_unlock(&cache_lock);
+		return;
+	}
+	clusters = list_shallow_copy(cache_clusters);
+	slurm_mutex_unlock(&cache_lock);
+
+	list_for_each(clusters, _clear_cluster, cluster_name);
+	FREE_NULL_LIST(clusters);
+}
+
+extern void as_mysql_usage_cache_clear_on_commit(mysql_conn_t *mysql_conn,
+						 char *cluster_name)
+{
+	cache_pending_t *pending = xmalloc(sizeof(*pending));
+
+	pending->mysql_conn = mysql_conn;
+	pending->cluster_name = xstrdup(cluster_name);
+
+	slurm_mutex_lock(&cache_lock);
+	if (!cache_pending)
+		cache_pending = list_create(_destroy_pending);
+	list_append(cache_pending, pending);
+	slurm_mutex_unlock(&cache_lock);
+}
+
+extern void as_mysql_usage_cache_commit(mysql_conn_t *mysql_conn,
+					bool commit)
+{
+	cache_pending_t *pending;
+	List pending_list;
+
+	slurm_mutex_lock(&cache_lock);
+	if (!cache_pending || !list_count(cache_pending)) {
+		slurm_mutex_unlock(&cache_lock);
+		return;
+	}
+	pending_list = list_create(_destroy_pending);
+	while ((pending = list_remove_first(cache_pending, _find_pending,
+					    mysql_conn)))
+		list_append(pending_list, pending);
+	slurm_mutex_unlock(&cache_lock);
+
+	while (commit && (pending = list_pop(pending_list))) {
+		as_mysql_usage_cache_clear(pending->cluster_name);
+		_destroy_pending(pending);
+	}
+	FREE_NULL_LIST(pending_list);
+}
+
+extern void as_mysql_usage_cache_assocs_changed(void)
+{
+	slurm_mutex_lock(&cache_lock);
+	/* 0 is never a valid generation */
+	if (!++assoc_gen)
+		assoc_gen = 1;
+	slurm_mutex_unlock(&cache_lock);
+}
+
+extern void as_mysql_usage_cache_fini(void)
+{
+	slurm_mutex_lock(&cache_lock);
+	FREE_NULL_LIST(cache_clusters);
+	FREE_NULL_LIST(cache_pending);
+	slurm_mutex_unlock(&cache_lock);
+}
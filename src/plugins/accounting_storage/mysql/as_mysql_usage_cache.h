@@ -0,0 +1,95 @@
+/*****************************************************************************\
+ *  as_mysql_usage_cache.h - in memory copy of the usage tables.
+ *****************************************************************************
+ *  Copyright (C) 2021 SchedMD LLC.
+ *
+ *  This file is part of Slurm, a resource management program.
+ *  For details, see <https://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  Slurm is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  Slurm is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with Slurm; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+#ifndef _HAVE_MYSQL_USAGE_CACHE_H
+#define _HAVE_MYSQL_USAGE_CACHE_H
+
+#include "accounting_storage_mysql.h"
+
+/*
+ * Get the usage of associations or wckeys from memory, same as
+ * _get_object_usage().
+ * IN type - DBD_GET_ASSOC_USAGE or DBD_GET_WCKEY_USAGE
+ * IN my_usage_table - usage table picked by set_usage_information()
+ * IN ids - ids of the associations or wckeys
+ * IN/OUT usage_list - list of slurmdb_accounting_rec_t to append to
+ * RET SLURM_SUCCESS, or SLURM_ERROR if the usage has to be read from the
+ *     database.
+ */
+extern int as_mysql_usage_cache_get(mysql_conn_t *mysql_conn,
+				    slurmdbd_msg_type_t type,
+				    char *my_usage_table, char *cluster_name,
+				    uint32_t *ids, int id_cnt,
+				    time_t start, time_t end,
+				    List *usage_list);
+
+/*
+ * Get the usage of a cluster from memory, same as _get_cluster_usage().
+ * RET SLURM_SUCCESS, or SLURM_ERROR if the usage has to be read from the
+ *     database.
+ */
+extern int as_mysql_usage_cache_get_cluster(
+	mysql_conn_t *mysql_conn, slurmdb_cluster_rec_t *cluster_rec,
+	char *my_usage_table, time_t start, time_t end);
+
+/*
+ * Reload the usage of a cluster after a rollup, once it is committed.
+ * IN period_start - per DBD_ROLLUP_*, start of the usage that was rolled up
+ *		     or 0 if none was.
+ */
+extern void as_mysql_usage_cache_rolled(mysql_conn_t *mysql_conn,
+					char *cluster_name,
+					time_t *period_start);
+
+/* Forget the usage of a cluster, or of all clusters if cluster_name is NULL */
+extern void as_mysql_usage_cache_clear(char *cluster_name);
+
+/*
+ * Forget the usage of a cluster once the current transaction of mysql_conn
+ * is committed, see as_mysql_usage_cache_commit().
+ */
+extern void as_mysql_usage_cache_clear_on_commit(mysql_conn_t *mysql_conn,
+						 char *cluster_name);
+
+/* The current transaction of mysql_conn was committed or rolled back */
+extern void as_mysql_usage_cache_commit(mysql_conn_t *mysql_conn,
+					bool commit);
+
+/* The association hierarchy changed, reload it on the next query */
+extern void as_mysql_usage_cache_assocs_changed(void);
+
+extern void as_mysql_usage_cache_fini(void);
+
+#endif
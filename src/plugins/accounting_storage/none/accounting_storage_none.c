@@ -100,6 +100,11 @@ extern int acct_storage_p_commit(void *db_conn, bool commit)
 	return SLURM_SUCCESS;
 }
 
+extern int acct_storage_p_batch(void *db_conn, bool start)
+{
+	return SLURM_SUCCESS;
+}
+
 extern int acct_storage_p_add_users(void *db_conn, uint32_t uid,
 				    List user_list)
 {
@@ -381,6 +386,13 @@ extern List acct_storage_p_get_txn(void *db_conn, uid_t uid,
 	return NULL;
 }
 
+extern int acct_storage_p_get_updates(void *db_conn, uid_t uid,
+				      uint32_t *epoch, uint64_t *gen,
+				      List *update_list)
+{
+	return SLURM_ERROR;
+}
+
 extern int acct_storage_p_get_usage(void *db_conn, uid_t uid,
 				    void *in, int type,
 				    time_t start, time_t end)
@@ -498,6 +510,17 @@ extern List jobacct_storage_p_get_jobs_cond(void *db_conn, uid_t uid,
 	return NULL;
 }
 
+/*
+ * get info from the storage in chunks
+ * returns List of slurmdb_job_rec_t *
+ * note List needs to be freed when called
+ */
+extern List jobacct_storage_p_get_jobs_chunk(void *db_conn, uid_t uid,
+					     void *job_cond)
+{
+	return NULL;
+}
+
 /*
  * expire old info from the storage
  */
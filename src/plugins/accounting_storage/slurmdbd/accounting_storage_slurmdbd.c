@@ -584,6 +584,15 @@ extern int acct_storage_p_commit(void *db_conn, bool commit)
 	return rc;
 }
 
+/*
+ * Records are already sent to the slurmdbd in batches by the agent, see
+ * DBD_SEND_MULT_MSG.
+ */
+extern int acct_storage_p_batch(void *db_conn, bool start)
+{
+	return SLURM_SUCCESS;
+}
+
 extern int acct_storage_p_add_users(void *db_conn, uint32_t uid,
 				    List user_list)
 {
@@ -2366,6 +2375,48 @@ extern List acct_storage_p_get_txn(void *db_conn, uid_t uid,
 	return ret_list;
 }
 
+extern int acct_storage_p_get_updates(void *db_conn, uid_t uid,
+				      uint32_t *epoch, uint64_t *gen,
+				      List *update_list)
+{
+	persist_msg_t req = {0}, resp = {0};
+	dbd_updates_msg_t get_msg;
+	dbd_updates_msg_t *got_msg;
+	int rc;
+
+	memset(&get_msg, 0, sizeof(dbd_updates_msg_t));
+	get_msg.epoch = *epoch;
+	get_msg.gen = *gen;
+
+	req.msg_type = DBD_GET_UPDATES;
+	req.conn = db_conn;
+	req.data = &get_msg;
+	rc = dbd_conn_send_recv(SLURM_PROTOCOL_VERSION, &req, &resp);
+
+	if (rc != SLURM_SUCCESS)
+		error("DBD_GET_UPDATES failure: %m");
+	else if (resp.msg_type == PERSIST_RC) {
+		persist_rc_msg_t *msg = resp.data;
+		/* A slurmdbd without an update log, read everything */
+		debug("DBD_GET_UPDATES: %s", msg->comment);
+		rc = msg->rc ? msg->rc : SLURM_ERROR;
+		slurm_persist_free_rc_msg(msg);
+	} else if (resp.msg_type != DBD_GOT_UPDATES) {
+		error("response type not DBD_GOT_UPDATES: %u",
+		      resp.msg_type);
+		rc = SLURM_ERROR;
+	} else {
+		got_msg = (dbd_updates_msg_t *) resp.data;
+		*epoch = got_msg->epoch;
+		*gen = got_msg->gen;
+		*update_list = got_msg->update_list;
+		got_msg->update_list = NULL;
+		slurmdbd_free_updates_msg(got_msg);
+	}
+
+	return rc;
+}
+
 extern int acct_storage_p_get_usage(void *db_conn, uid_t uid,
 				    void *in, slurmdbd_msg_type_t type,
 				    time_t start, time_t end)
@@ -2945,36 +2996,36 @@ extern int jobacct_storage_p_suspend(void *db_conn, job_record_t *job_ptr)
 	return SLURM_SUCCESS;
 }
 
+/* Send a request for jobs and return the List of the response */
 /*
- * get info from the storage
- * returns List of job_rec_t *
- * note List needs to be freed when called
+ * IN/OUT rejected - if not NULL, set to true instead of logging an error if
+ *	slurmdbd fails the request with SLURM_ERROR or EINVAL, as it does for
+ *	a message type it doesn't know.
  */
-extern List jobacct_storage_p_get_jobs_cond(void *db_conn, uid_t uid,
-					    slurmdb_job_cond_t *job_cond)
+static List _get_jobs(persist_msg_t *req, bool *rejected)
 {
-	persist_msg_t req = {0}, resp = {0};
-	dbd_cond_msg_t get_msg;
+	persist_msg_t resp = {0};
 	dbd_list_msg_t *got_msg;
 	int rc;
 	List my_job_list = NULL;
 
-	memset(&get_msg, 0, sizeof(dbd_cond_msg_t));
-
-	get_msg.cond = job_cond;
-
-	req.msg_type = DBD_GET_JOBS_COND;
-	req.conn = db_conn;
-	req.data = &get_msg;
-	rc = dbd_conn_send_recv(SLURM_PROTOCOL_VERSION, &req, &resp);
+	rc = dbd_conn_send_recv(SLURM_PROTOCOL_VERSION, req, &resp);
 
 	if (rc != SLURM_SUCCESS)
-		error("DBD_GET_JOBS_COND failure: %s", slurm_strerror(rc));
+		error("%s failure: %s",
+		      slurmdbd_msg_type_2_str(req->msg_type, 1),
+		      slurm_strerror(rc));
 	else if (resp.msg_type == PERSIST_RC) {
 		persist_rc_msg_t *msg = resp.data;
 		if (msg->rc == SLURM_SUCCESS) {
 			info("%s", msg->comment);
 			my_job_list = list_create(NULL);
+		} else if (rejected &&
+			   ((msg->rc == SLURM_ERROR) || (msg->rc == EINVAL))) {
+			debug("%s: %s rejected: %s", __func__,
+			      slurmdbd_msg_type_2_str(req->msg_type, 1),
+			      msg->comment);
+			*rejected = true;
 		} else {
 			slurm_seterrno(msg->rc);
 			error("%s", msg->comment);
@@ -2997,6 +3048,80 @@ extern List jobacct_storage_p_get_jobs_cond(void *db_conn, uid_t uid,
 	return my_job_list;
 }
 
+/*
+ * get info from the storage
+ * returns List of job_rec_t *
+ * note List needs to be freed when called
+ */
+extern List jobacct_storage_p_get_jobs_cond(void *db_conn, uid_t uid,
+					    slurmdb_job_cond_t *job_cond)
+{
+	persist_msg_t req = {0};
+	dbd_cond_msg_t get_msg;
+
+	memset(&get_msg, 0, sizeof(dbd_cond_msg_t));
+
+	get_msg.cond = job_cond;
+
+	req.msg_type = DBD_GET_JOBS_COND;
+	req.conn = db_conn;
+	req.data = &get_msg;
+
+	return _get_jobs(&req, NULL);
+}
+
+/*
+ * get info from the storage in chunks, the slurmdbd keeps the position
+ * of the query on the connection
+ * returns List of job_rec_t *, empty once all the jobs were returned
+ * note List needs to be freed when called
+ */
+extern List jobacct_storage_p_get_jobs_chunk(void *db_conn, uid_t uid,
+					     slurmdb_job_cond_t *job_cond)
+{
+	/* connection whose first chunk was the whole list */
+	static void *single_chunk_conn = NULL;
+	persist_msg_t req = {0};
+	dbd_cond_msg_t get_msg;
+	bool rejected = false;
+	List my_job_list;
+
+	req.conn = db_conn;
+	if (!job_cond) {
+		if (db_conn && (db_conn == single_chunk_conn)) {
+			single_chunk_conn = NULL;
+			return list_create(NULL);
+		}
+		req.msg_type = DBD_GET_JOBS_NEXT;
+		return _get_jobs(&req, NULL);
+	}
+
+	single_chunk_conn = NULL;
+
+	/*
+	 * Older slurmdbds, including ones of this version from before the
+	 * chunks, get the whole list at once.
+	 */
+	if (db_conn && (((slurm_persist_conn_t *) db_conn)->version >=
+			SLURM_21_08_PROTOCOL_VERSION)) {
+		memset(&get_msg, 0, sizeof(dbd_cond_msg_t));
+		get_msg.cond = job_cond;
+
+		req.msg_type = DBD_GET_JOBS_CHUNK;
+		req.data = &get_msg;
+
+		my_job_list = _get_jobs(&req, &rejected);
+		if (!rejected)
+			return my_job_list;
+	}
+
+	if ((my_job_list = jobacct_storage_p_get_jobs_cond(db_conn, uid,
+							   job_cond)))
+		single_chunk_conn = db_conn;
+
+	return my_job_list;
+}
+
 /*
  * Expire old info from the storage
  * Not applicable for any database
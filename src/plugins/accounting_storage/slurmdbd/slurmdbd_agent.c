@@ -37,6 +37,8 @@
  *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
 \*****************************************************************************/
 
+#include <dirent.h>
+
 #include "src/common/slurm_xlator.h"
 
 #include "src/common/fd.h"
@@ -48,7 +50,8 @@
 
 enum {
 	MAX_DBD_ACTION_DISCARD,
-	MAX_DBD_ACTION_EXIT
+	MAX_DBD_ACTION_EXIT,
+	MAX_DBD_ACTION_SPOOL
 };
 
 slurm_persist_conn_t *slurmdbd_conn = NULL;
@@ -57,6 +60,8 @@ slurm_persist_conn_t *slurmdbd_conn = NULL;
 #define DBD_MAGIC		0xDEAD3219
 #define DEBUG_PRINT_MAX_MSG_TYPES 10
 #define MAX_DBD_DEFAULT_ACTION MAX_DBD_ACTION_DISCARD
+#define DBD_SPOOL_PREFIX	"dbd.messages."
+#define MAX_DBD_SPOOL_SEGMENT_SIZE (16 * 1024 * 1024)
 
 static pthread_mutex_t agent_lock = PTHREAD_MUTEX_INITIALIZER;
 static pthread_cond_t  agent_cond = PTHREAD_COND_INITIALIZER;
@@ -71,6 +76,21 @@ static pthread_cond_t  slurmdbd_cond = PTHREAD_COND_INITIALIZER;
 
 static int max_dbd_msg_action = MAX_DBD_DEFAULT_ACTION;
 
+/*
+ * Disk spool of pending messages, segment files named DBD_SPOOL_PREFIX<seq>
+ * in StateSaveLocation. Segments spool_first through spool_last exist,
+ * spool_first > spool_last means the spool is empty. spool_fd is open on
+ * spool_last while messages are appended to it. All protected by agent_lock.
+ */
+static uint32_t  spool_first    = 1;
+static uint32_t  spool_last     = 0;
+static int       spool_fd       = -1;
+static uint32_t  spool_size     = 0;	/* bytes written to spool_fd */
+static bool      spool_dirty    = false; /* spool_fd has unsynced records */
+static int       spool_sync_fd  = -1;	/* closed segment not synced yet */
+static uint32_t  spool_msgs     = 0;	/* messages in segments not loaded */
+static bool      spool_loaded   = false; /* spool_first is in agent_list */
+
 static int _unpack_return_code(uint16_t rpc_version, buf_t *buffer)
 {
 	uint16_t msg_type = -1;
@@ -292,14 +312,16 @@ static buf_t *_load_dbd_rec(int fd)
 	return buffer;
 }
 
-static void _load_dbd_state(void)
+/*
+ * Enqueue the messages saved in dbd_fname to list.
+ * RET number of messages recovered or -1 if the file could not be opened
+ */
+static int _load_dbd_file(char *dbd_fname, List list)
 {
-	char *dbd_fname = NULL;
 	buf_t *buffer;
-	int fd, recovered = 0;
+	int fd, recovered = -1;
 	uint16_t rpc_version = 0;
 
-	xstrfmtcat(dbd_fname, "%s/dbd.messages", slurm_conf.state_save_location);
 	fd = open(dbd_fname, O_RDONLY);
 	if (fd < 0) {
 		/* don't print an error message if there is no file */
@@ -313,6 +335,7 @@ static void _load_dbd_state(void)
 		char *ver_str = NULL;
 		uint32_t ver_str_len;
 
+		recovered = 0;
 		buffer = _load_dbd_rec(fd);
 		if (buffer == NULL)
 			goto end_it;
@@ -360,16 +383,27 @@ static void _load_dbd_state(void)
 				error("no buffer given");
 				continue;
 			}
-			if (!list_enqueue(agent_list, buffer))
+			if (!list_enqueue(list, buffer))
 				fatal("list_enqueue, no memory");
 			recovered++;
 			buffer = NULL;
 		}
 
 	end_it:
-		verbose("recovered %d pending RPCs", recovered);
 		(void) close(fd);
 	}
+
+	return recovered;
+}
+
+static void _load_dbd_state(void)
+{
+	char *dbd_fname = NULL;
+	int recovered;
+
+	xstrfmtcat(dbd_fname, "%s/dbd.messages", slurm_conf.state_save_location);
+	if ((recovered = _load_dbd_file(dbd_fname, agent_list)) >= 0)
+		verbose("recovered %d pending RPCs", recovered);
 	xfree(dbd_fname);
 }
 
@@ -411,11 +445,278 @@ static int _save_dbd_rec(int fd, buf_t *buffer)
 	return SLURM_SUCCESS;
 }
 
+static int _save_dbd_ver_rec(int fd)
+{
+	char curr_ver_str[10];
+	buf_t *buffer;
+	int rc;
+
+	snprintf(curr_ver_str, sizeof(curr_ver_str),
+		 "VER%d", SLURM_PROTOCOL_VERSION);
+	buffer = init_buf(strlen(curr_ver_str));
+	packstr(curr_ver_str, buffer);
+	rc = _save_dbd_rec(fd, buffer);
+	free_buf(buffer);
+
+	return rc;
+}
+
+static char *_spool_fname(uint32_t seq)
+{
+	char *fname = NULL;
+
+	xstrfmtcat(fname, "%s/%s%u",
+		   slurm_conf.state_save_location, DBD_SPOOL_PREFIX, seq);
+	return fname;
+}
+
+/* Flush and close a segment that is no longer appended to */
+static void _spool_sync_close(int fd)
+{
+	if (fsync_and_close(fd, "dbd spool"))
+		error("error from fsync_and_close");
+}
+
+/*
+ * Stop appending to the current segment. Unsynced records are left for the
+ * agent to flush in _spool_sync(), outside of agent_lock.
+ */
+static void _spool_close(void)
+{
+	if (spool_fd < 0)
+		return;
+
+	/* Only when segments fill up faster than the agent loops */
+	if (spool_sync_fd >= 0)
+		_spool_sync_close(spool_sync_fd);
+	if (spool_dirty)
+		spool_sync_fd = spool_fd;
+	else {
+		(void) close(spool_fd);
+		spool_sync_fd = -1;
+	}
+	spool_fd = -1;
+	spool_size = 0;
+	spool_dirty = false;
+}
+
+/*
+ * Flush the records spooled since the last call. Called by the agent without
+ * agent_lock, the fsync is done on a duplicate of spool_fd so
+ * slurmdbd_agent_send() is not blocked behind the disk.
+ */
+static void _spool_sync(void)
+{
+	int fd = -1, closed_fd;
+
+	slurm_mutex_lock(&agent_lock);
+	closed_fd = spool_sync_fd;
+	spool_sync_fd = -1;
+	if ((spool_fd >= 0) && spool_dirty) {
+		if ((fd = dup(spool_fd)) < 0)
+			error("Unable to dup spool file: %m");
+		else
+			spool_dirty = false;
+	}
+	slurm_mutex_unlock(&agent_lock);
+
+	if (closed_fd >= 0)
+		_spool_sync_close(closed_fd);
+	if (fd < 0)
+		return;
+
+	if (fsync(fd) < 0)
+		error("Unable to sync spool file: %m");
+	(void) close(fd);
+}
+
+/* Remove the oldest segment, all its messages were sent or saved */
+static void _spool_remove_first(void)
+{
+	char *fname = _spool_fname(spool_first);
+
+	if ((unlink(fname) < 0) && (errno != ENOENT))
+		error("Unable to remove spool file %s: %m", fname);
+	xfree(fname);
+	spool_first++;
+	spool_loaded = false;
+}
+
+/*
+ * Append a message to the disk spool, starting a new segment when there is
+ * no open one or it is full.
+ * RET SLURM_SUCCESS or SLURM_ERROR if the message was not spooled
+ */
+static int _spool_save_rec(buf_t *buffer)
+{
+	if ((spool_fd >= 0) && (spool_size >= MAX_DBD_SPOOL_SEGMENT_SIZE))
+		_spool_close();
+
+	if (spool_fd < 0) {
+		char *fname = _spool_fname(spool_last + 1);
+
+		spool_fd = open(fname, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+				0600);
+		if (spool_fd < 0) {
+			error("Creating spool file %s: %m", fname);
+			xfree(fname);
+			return SLURM_ERROR;
+		}
+		if (_save_dbd_ver_rec(spool_fd) != SLURM_SUCCESS) {
+			(void) close(spool_fd);
+			spool_fd = -1;
+			(void) unlink(fname);
+			xfree(fname);
+			return SLURM_ERROR;
+		}
+		log_flag(AGENT, "spooling pending RPCs to %s", fname);
+		xfree(fname);
+		spool_last++;
+		spool_size = lseek(spool_fd, 0, SEEK_CUR);
+	}
+
+	if (_save_dbd_rec(spool_fd, buffer) != SLURM_SUCCESS) {
+		/* Drop any partial record, the segment is not used again */
+		if (ftruncate(spool_fd, spool_size) < 0)
+			error("Unable to truncate spool file: %m");
+		_spool_close();
+		return SLURM_ERROR;
+	}
+
+	spool_size += (2 * sizeof(uint32_t)) + get_buf_offset(buffer);
+	spool_msgs++;
+	spool_dirty = true;
+
+	return SLURM_SUCCESS;
+}
+
+/*
+ * Called by the agent without agent_lock. When agent_list is empty remove
+ * the segment whose messages have all been sent and load the next one into
+ * agent_list. The segment is read without agent_lock, only the agent removes
+ * segments so spool_first can not move meanwhile.
+ */
+static void _spool_load(void)
+{
+	List list;
+	char *fname;
+	uint32_t seq;
+	int loaded;
+
+	slurm_mutex_lock(&agent_lock);
+	if (!agent_list || list_count(agent_list)) {
+		slurm_mutex_unlock(&agent_lock);
+		return;
+	}
+	if (spool_loaded)
+		_spool_remove_first();
+
+	while ((spool_first <= spool_last) && slurmdbd_conn_active()) {
+		/* The segment being sent must not be appended to */
+		if (spool_first == spool_last)
+			_spool_close();
+		seq = spool_first;
+		slurm_mutex_unlock(&agent_lock);
+
+		fname = _spool_fname(seq);
+		list = list_create(slurmdbd_free_buffer);
+		loaded = _load_dbd_file(fname, list);
+
+		slurm_mutex_lock(&agent_lock);
+		if (!agent_list || (seq != spool_first)) {
+			/* saved or shut down meanwhile, the segment stays */
+			FREE_NULL_LIST(list);
+			xfree(fname);
+			break;
+		}
+		if (loaded > 0) {
+			log_flag(AGENT, "replaying %d spooled RPCs from %s",
+				 loaded, fname);
+			/* keep anything queued meanwhile after the segment */
+			list_transfer(list, agent_list);
+			list_transfer(agent_list, list);
+			FREE_NULL_LIST(list);
+			xfree(fname);
+			spool_msgs -= MIN(spool_msgs, loaded);
+			spool_loaded = true;
+			break;
+		}
+		FREE_NULL_LIST(list);
+		xfree(fname);
+		_spool_remove_first();
+	}
+	slurm_mutex_unlock(&agent_lock);
+}
+
+/* Count the messages of a segment without reading them */
+static uint32_t _spool_count(uint32_t seq)
+{
+	char *fname = _spool_fname(seq);
+	uint32_t msg_size, cnt = 0;
+	int fd;
+
+	fd = open(fname, O_RDONLY);
+	xfree(fname);
+	if (fd < 0)
+		return 0;
+
+	while (read(fd, &msg_size, sizeof(msg_size)) == sizeof(msg_size)) {
+		if (lseek(fd, msg_size + sizeof(uint32_t), SEEK_CUR) < 0)
+			break;
+		cnt++;
+	}
+	(void) close(fd);
+
+	/* The first record is the version header */
+	return cnt ? (cnt - 1) : 0;
+}
+
+/* Find the segments left in StateSaveLocation by a previous agent */
+static void _spool_recover(void)
+{
+	DIR *dir;
+	struct dirent *ent;
+	char *end;
+	int prefix_len = strlen(DBD_SPOOL_PREFIX);
+	uint32_t seq, first = NO_VAL, last = 0;
+
+	spool_msgs = 0;
+	spool_loaded = false;
+	spool_first = 1;
+	spool_last = 0;
+
+	if (!(dir = opendir(slurm_conf.state_save_location))) {
+		error("Unable to open StateSaveLocation %s: %m",
+		      slurm_conf.state_save_location);
+		return;
+	}
+	while ((ent = readdir(dir))) {
+		if (strncmp(ent->d_name, DBD_SPOOL_PREFIX, prefix_len))
+			continue;
+		seq = strtoul(ent->d_name + prefix_len, &end, 10);
+		if (*end || !seq)
+			continue;
+		first = MIN(first, seq);
+		last = MAX(last, seq);
+	}
+	closedir(dir);
+
+	if (!last)
+		return;
+
+	spool_first = first;
+	spool_last = last;
+	for (seq = first; seq <= last; seq++)
+		spool_msgs += _spool_count(seq);
+	verbose("recovered %u spooled RPCs in %u segments",
+		spool_msgs, (last - first + 1));
+}
+
 static void _save_dbd_state(void)
 {
 	char *dbd_fname = NULL;
 	buf_t *buffer;
-	int fd, rc, wrote = 0;
+	int fd, rc = SLURM_SUCCESS, wrote = 0;
 	uint16_t msg_type;
 	uint32_t offset;
 
@@ -425,13 +726,7 @@ static void _save_dbd_state(void)
 	if (fd < 0) {
 		error("Creating state save file %s", dbd_fname);
 	} else if (list_count(agent_list)) {
-		char curr_ver_str[10];
-		snprintf(curr_ver_str, sizeof(curr_ver_str),
-			 "VER%d", SLURM_PROTOCOL_VERSION);
-		buffer = init_buf(strlen(curr_ver_str));
-		packstr(curr_ver_str, buffer);
-		rc = _save_dbd_rec(fd, buffer);
-		free_buf(buffer);
+		rc = _save_dbd_ver_rec(fd);
 		if (rc != SLURM_SUCCESS)
 			goto end_it;
 
@@ -466,11 +761,25 @@ static void _save_dbd_state(void)
 end_it:
 	if (fd >= 0) {
 		verbose("saved %d pending RPCs", wrote);
-		rc = fsync_and_close(fd, "dbd.messages");
-		if (rc)
+		if (fsync_and_close(fd, "dbd.messages")) {
 			error("error from fsync_and_close");
+			rc = SLURM_ERROR;
+		}
 	}
 	xfree(dbd_fname);
+
+	_spool_close();
+	if (spool_sync_fd >= 0) {
+		_spool_sync_close(spool_sync_fd);
+		spool_sync_fd = -1;
+	}
+	/*
+	 * What was left of a loaded segment is now in dbd.messages, which is
+	 * recovered before the rest of the spool.
+	 */
+	if (spool_loaded && (fd >= 0) && (rc == SLURM_SUCCESS))
+		_spool_remove_first();
+	spool_loaded = false;
 }
 
 /* Purge queued step records from the agent queue
@@ -532,6 +841,13 @@ static int _purge_job_start_req(void)
 
 static void _max_dbd_msg_action(uint32_t *msg_cnt)
 {
+	/*
+	 * Spooled messages are never purged, a loaded segment may hold more
+	 * than MaxDBDMsgs and is removed once agent_list has been sent.
+	 */
+	if (max_dbd_msg_action == MAX_DBD_ACTION_SPOOL)
+		return;
+
 	if (max_dbd_msg_action == MAX_DBD_ACTION_EXIT) {
 		if (*msg_cnt < slurm_conf.max_dbd_msgs)
 			return;
@@ -646,6 +962,9 @@ static void *_agent(void *x)
 			}
 		}
 
+		_spool_sync();
+		_spool_load();
+
 		slurm_mutex_lock(&agent_lock);
 		cnt = list_count(agent_list);
 		if ((cnt == 0) || (slurmdbd_conn->fd < 0) ||
@@ -794,6 +1113,7 @@ static void _create_agent(void)
 	if (agent_list == NULL) {
 		agent_list = list_create(slurmdbd_free_buffer);
 		_load_dbd_state();
+		_spool_recover();
 	}
 
 	if (agent_tid == 0) {
@@ -932,16 +1252,33 @@ extern int slurmdbd_agent_send(uint16_t rpc_version, persist_msg_t *req)
 		}
 	}
 	cnt = list_count(agent_list);
-	if ((cnt >= (slurm_conf.max_dbd_msgs / 2)) &&
+	if (((cnt + spool_msgs) >= (slurm_conf.max_dbd_msgs / 2)) &&
 	    (difftime(time(NULL), syslog_time) > 120)) {
 		/* Record critical error every 120 seconds */
 		syslog_time = time(NULL);
 		error("agent queue filling (%u), MaxDBDMsgs=%u, RESTART SLURMDBD NOW",
-		      cnt, slurm_conf.max_dbd_msgs);
+		      (cnt + spool_msgs), slurm_conf.max_dbd_msgs);
 		syslog(LOG_CRIT, "*** RESTART SLURMDBD NOW ***");
 		(slurmdbd_conn->trigger_callbacks.dbd_fail)();
 	}
 
+	/*
+	 * Spool to disk while the slurmdbd is unreachable or the queue is
+	 * full. Once anything is spooled new messages have to follow it to
+	 * be sent in order. If the spool can not be written the message is
+	 * queued in memory as usual.
+	 */
+	if ((max_dbd_msg_action == MAX_DBD_ACTION_SPOOL) &&
+	    (req->msg_type != DBD_REGISTER_CTLD) &&
+	    ((spool_first <= spool_last) || !slurmdbd_conn_active() ||
+	     (cnt >= slurm_conf.max_dbd_msgs)) &&
+	    (_spool_save_rec(buffer) == SLURM_SUCCESS)) {
+		free_buf(buffer);
+		slurm_cond_broadcast(&agent_cond);
+		slurm_mutex_unlock(&agent_lock);
+		return rc;
+	}
+
 	/* Handle action */
 	_max_dbd_msg_action(&cnt);
 
@@ -974,7 +1311,13 @@ extern bool slurmdbd_conn_active(void)
 
 extern int slurmdbd_agent_queue_count(void)
 {
-	return list_count(agent_list);
+	int cnt;
+
+	slurm_mutex_lock(&agent_lock);
+	cnt = list_count(agent_list) + spool_msgs;
+	slurm_mutex_unlock(&agent_lock);
+
+	return cnt;
 }
 
 extern void slurmdbd_agent_config_setup(void)
@@ -1001,6 +1344,8 @@ extern void slurmdbd_agent_config_setup(void)
 			max_dbd_msg_action = MAX_DBD_ACTION_DISCARD;
 		else if (!xstrcasecmp(type, "exit"))
 			max_dbd_msg_action = MAX_DBD_ACTION_EXIT;
+		else if (!xstrcasecmp(type, "spool"))
+			max_dbd_msg_action = MAX_DBD_ACTION_SPOOL;
 		else
 			fatal("Unknown SlurmctldParameters option for max_dbd_msg_action '%s'",
 			      type);
@@ -0,0 +1,480 @@
+/*****************************************************************************\
+ *  acct_gather_profile_columnar.c - slurm profile plugin writing columnar,
+ *                                   compressed time-series files.
+ *****************************************************************************
+ *  Copyright (C) 2021 SchedMD LLC.
+ *
+ *  This file is part of Slurm, a resource management program.
+ *  For details, see <https://slurm.schedmd.com>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  Slurm is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  Slurm is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  with Slurm; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "src/common/slurm_xlator.h"
+#include "src/common/slurm_acct_gather_profile.h"
+#include "src/common/slurm_protocol_api.h"
+#include "src/common/slurm_protocol_defs.h"
+#include "src/common/xstring.h"
+#include "src/slurmd/slurmstepd/slurmstepd_job.h"
+
+#include "columnar_api.h"
+
+/*
+ * These variables are required by the generic plugin interface.  If they
+ * are not found in the plugin, the plugin loader will ignore it.
+ *
+ * plugin_name - a string giving a human-readable description of the
+ * plugin.  There is no maximum length, but the symbol must refer to
+ * a valid string.
+ *
+ * plugin_type - a string suggesting the type of the plugin or its
+ * applicability to a particular form of data or method of data handling.
+ * If the low-level plugin API is used, the contents of this string are
+ * unimportant and may be anything.  Slurm uses the higher-level plugin
+ * interface which requires this string to be of the form
+ *
+ *	<application>/<method>
+ *
+ * where <application> is a description of the intended application of
+ * the plugin (e.g., "jobacct" for Slurm job completion logging) and <method>
+ * is a description of how this plugin satisfies that application.  Slurm will
+ * only load job completion logging plugins if the plugin_type string has a
+ * prefix of "jobacct/".
+ *
+ * plugin_version - an unsigned 32-bit integer containing the Slurm version
+ * (major.minor.micro combined into a single number).
+ */
+const char plugin_name[] = "AcctGatherProfile columnar plugin";
+const char plugin_type[] = "acct_gather_profile/columnar";
+const uint32_t plugin_version = SLURM_VERSION_NUMBER;
+
+typedef struct {
+	uint32_t chunk_rows;
+	uint32_t def;
+	char *dir;
+} slurm_columnar_conf_t;
+
+/*
+ * The writer stays open for the duration of the step. Samples are buffered
+ * per dataset and only encoded and written once ProfileColumnarChunkRows
+ * of them have been collected, or at the end of the step.
+ */
+static columnar_writer_t *writer = NULL;
+static pthread_mutex_t writer_mutex = PTHREAD_MUTEX_INITIALIZER;
+static slurm_columnar_conf_t columnar_conf;
+static uint32_t g_profile_running = ACCT_GATHER_PROFILE_NOT_SET;
+static stepd_step_rec_t *g_job = NULL;
+static time_t step_start_time;
+
+static char **groups = NULL;
+static size_t groups_len = 0;
+
+static void _reset_slurm_profile_conf(void)
+{
+	xfree(columnar_conf.dir);
+	columnar_conf.def = ACCT_GATHER_PROFILE_NONE;
+	columnar_conf.chunk_rows = COLUMNAR_CHUNK_ROWS;
+}
+
+static uint32_t _determine_profile(void)
+{
+	uint32_t profile;
+	xassert(g_job);
+
+	if (g_profile_running != ACCT_GATHER_PROFILE_NOT_SET)
+		profile = g_profile_running;
+	else if (g_job->profile >= ACCT_GATHER_PROFILE_NONE)
+		profile = g_job->profile;
+	else
+		profile = columnar_conf.def;
+
+	return profile;
+}
+
+static void _create_directories(void)
+{
+	char *user_dir = NULL;
+
+	xassert(g_job);
+	xassert(columnar_conf.dir);
+
+	xstrfmtcat(user_dir, "%s/%s", columnar_conf.dir, g_job->user_name);
+
+	/*
+	 * To avoid race conditions (TOCTOU) with stat() calls, always
+	 * attempt to create the ProfileColumnarDir and the user directory
+	 * within.
+	 */
+	if (((mkdir(columnar_conf.dir, 0755)) < 0) && (errno != EEXIST))
+		fatal("mkdir(%s): %m", columnar_conf.dir);
+	if (chmod(columnar_conf.dir, 0755) < 0)
+		fatal("chmod(%s): %m", columnar_conf.dir);
+
+	if (((mkdir(user_dir, 0700)) < 0) && (errno != EEXIST))
+		fatal("mkdir(%s): %m", user_dir);
+	if (chmod(user_dir, 0700) < 0)
+		fatal("chmod(%s): %m", user_dir);
+	if (chown(user_dir, g_job->uid, g_job->gid) < 0)
+		fatal("chown(%s): %m", user_dir);
+
+	xfree(user_dir);
+}
+
+static void _free_groups(void)
+{
+	for (size_t i = 0; i < groups_len; i++)
+		xfree(groups[i]);
+	xfree(groups);
+	groups_len = 0;
+}
+
+/*
+ * init() is called when the plugin is loaded, before any other functions
+ * are called.  Put global initialization here.
+ */
+extern int init(void)
+{
+	return SLURM_SUCCESS;
+}
+
+extern int fini(void)
+{
+	slurm_mutex_lock(&writer_mutex);
+	columnar_writer_close(writer);
+	writer = NULL;
+	slurm_mutex_unlock(&writer_mutex);
+
+	_free_groups();
+	xfree(columnar_conf.dir);
+	return SLURM_SUCCESS;
+}
+
+extern void acct_gather_profile_p_conf_options(s_p_options_t **full_options,
+					       int *full_options_cnt)
+{
+	s_p_options_t options[] = {
+		{"ProfileColumnarChunkRows", S_P_UINT32},
+		{"ProfileColumnarDir", S_P_STRING},
+		{"ProfileColumnarDefault", S_P_STRING},
+		{NULL} };
+
+	transfer_s_p_options(full_options, options, full_options_cnt);
+	return;
+}
+
+extern void acct_gather_profile_p_conf_set(s_p_hashtbl_t *tbl)
+{
+	char *tmp = NULL;
+	_reset_slurm_profile_conf();
+	if (tbl) {
+		s_p_get_string(&columnar_conf.dir, "ProfileColumnarDir", tbl);
+
+		if (s_p_get_string(&tmp, "ProfileColumnarDefault", tbl)) {
+			columnar_conf.def =
+				acct_gather_profile_from_string(tmp);
+			if (columnar_conf.def == ACCT_GATHER_PROFILE_NOT_SET) {
+				fatal("ProfileColumnarDefault can not be "
+				      "set to %s, please specify a valid "
+				      "option", tmp);
+			}
+			xfree(tmp);
+		}
+
+		if (s_p_get_uint32(&columnar_conf.chunk_rows,
+				   "ProfileColumnarChunkRows", tbl) &&
+		    !columnar_conf.chunk_rows)
+			fatal("ProfileColumnarChunkRows must be greater "
+			      "than 0");
+	}
+
+	if (!columnar_conf.dir)
+		fatal("No ProfileColumnarDir in your acct_gather.conf file.  "
+		      "This is required to use the %s plugin", plugin_type);
+
+	debug("%s loaded", plugin_name);
+}
+
+extern void acct_gather_profile_p_get(enum acct_gather_profile_info info_type,
+				      void *data)
+{
+	uint32_t *uint32 = (uint32_t *) data;
+	char **tmp_char = (char **) data;
+
+	switch (info_type) {
+	case ACCT_GATHER_PROFILE_DIR:
+		*tmp_char = xstrdup(columnar_conf.dir);
+		break;
+	case ACCT_GATHER_PROFILE_DEFAULT:
+		*uint32 = columnar_conf.def;
+		break;
+	case ACCT_GATHER_PROFILE_RUNNING:
+		*uint32 = g_profile_running;
+		break;
+	default:
+		debug2("acct_gather_profile_p_get info_type %d invalid",
+		       info_type);
+	}
+}
+
+extern int acct_gather_profile_p_node_step_start(stepd_step_rec_t* job)
+{
+	columnar_node_t node;
+	char *profile_file_name;
+
+	xassert(running_in_slurmstepd());
+
+	g_job = job;
+
+	xassert(columnar_conf.dir);
+
+	log_flag(PROFILE, "PROFILE: option --profile=%s",
+		 acct_gather_profile_to_string(g_job->profile));
+
+	if (g_profile_running == ACCT_GATHER_PROFILE_NOT_SET)
+		g_profile_running = _determine_profile();
+
+	if (g_profile_running <= ACCT_GATHER_PROFILE_NONE)
+		return SLURM_SUCCESS;
+
+	_create_directories();
+
+	/*
+	 * Use a more user friendly string "batch" rather
+	 * then 4294967294.
+	 */
+	if (g_job->step_id.step_id == SLURM_BATCH_SCRIPT) {
+		profile_file_name = xstrdup_printf("%s/%s/%u_%s_%s.%s",
+						   columnar_conf.dir,
+						   g_job->user_name,
+						   g_job->step_id.job_id,
+						   "batch",
+						   g_job->node_name,
+						   COLUMNAR_SUFFIX);
+	} else {
+		profile_file_name = xstrdup_printf(
+			"%s/%s/%u_%u_%s.%s",
+			columnar_conf.dir, g_job->user_name,
+			g_job->step_id.job_id, g_job->step_id.step_id,
+			g_job->node_name, COLUMNAR_SUFFIX);
+	}
+
+	log_flag(PROFILE, "PROFILE: node_step_start, opt=%s file=%s",
+		 acct_gather_profile_to_string(g_profile_running),
+		 profile_file_name);
+
+	step_start_time = time(NULL);
+
+	node.cpus_per_task = g_job->cpus_per_task;
+	node.job_id = g_job->step_id.job_id;
+	node.node_name = g_job->node_name;
+	node.nodeid = g_job->nodeid;
+	node.ntasks = g_job->node_tasks;
+	node.start_time = step_start_time;
+	node.step_id = g_job->step_id.step_id;
+
+	slurm_mutex_lock(&writer_mutex);
+	writer = columnar_writer_open(profile_file_name, &node,
+				      columnar_conf.chunk_rows);
+	slurm_mutex_unlock(&writer_mutex);
+
+	if (!writer) {
+		xfree(profile_file_name);
+		return SLURM_ERROR;
+	}
+
+	if (chown(profile_file_name, (uid_t)g_job->uid,
+		  (gid_t)g_job->gid) < 0)
+		error("chown(%s): %m", profile_file_name);
+	xfree(profile_file_name);
+
+	return SLURM_SUCCESS;
+}
+
+extern int acct_gather_profile_p_child_forked(void)
+{
+	/* Samples buffered in the parent are written out by the parent */
+	columnar_writer_abandon(writer);
+	writer = NULL;
+
+	return SLURM_SUCCESS;
+}
+
+extern int acct_gather_profile_p_node_step_end(void)
+{
+	int rc = SLURM_SUCCESS;
+
+	xassert(running_in_slurmstepd());
+
+	xassert(g_profile_running != ACCT_GATHER_PROFILE_NOT_SET);
+
+	if (g_profile_running <= ACCT_GATHER_PROFILE_NONE)
+		return rc;
+
+	log_flag(PROFILE, "PROFILE: node_step_end (shutdown)");
+
+	slurm_mutex_lock(&writer_mutex);
+	rc = columnar_writer_close(writer);
+	writer = NULL;
+	slurm_mutex_unlock(&writer_mutex);
+
+	_free_groups();
+
+	return rc;
+}
+
+extern int acct_gather_profile_p_task_start(uint32_t taskid)
+{
+	int rc = SLURM_SUCCESS;
+
+	xassert(running_in_slurmstepd());
+	xassert(g_job);
+
+	xassert(g_profile_running != ACCT_GATHER_PROFILE_NOT_SET);
+
+	if (g_profile_running <= ACCT_GATHER_PROFILE_NONE)
+		return rc;
+
+	log_flag(PROFILE, "PROFILE: task_start");
+
+	return rc;
+}
+
+extern int acct_gather_profile_p_task_end(pid_t taskpid)
+{
+	log_flag(PROFILE, "PROFILE: task_end");
+	return SLURM_SUCCESS;
+}
+
+/*
+ * Groups only exist as a name attached to the datasets created in them, the
+ * returned id is an index into the groups array.
+ */
+extern int64_t acct_gather_profile_p_create_group(const char* name)
+{
+	xrecalloc(groups, groups_len + 1, sizeof(char *));
+	groups[groups_len] = xstrdup(name);
+
+	return groups_len++;
+}
+
+extern int acct_gather_profile_p_create_dataset(
+	const char* name, int64_t parent,
+	acct_gather_profile_dataset_t *dataset)
+{
+	const char *group = NULL;
+	int rc;
+
+	if (g_profile_running <= ACCT_GATHER_PROFILE_NONE)
+		return SLURM_ERROR;
+
+	debug("acct_gather_profile_p_create_dataset %s", name);
+
+	if ((parent >= 0) && (parent < groups_len))
+		group = groups[parent];
+
+	slurm_mutex_lock(&writer_mutex);
+	if (writer)
+		rc = columnar_writer_add_dataset(writer, group, name, dataset);
+	else
+		rc = SLURM_ERROR;
+	slurm_mutex_unlock(&writer_mutex);
+
+	if (rc == SLURM_ERROR)
+		error("PROFILE: Impossible to create the table %s", name);
+
+	return rc;
+}
+
+extern int acct_gather_profile_p_add_sample_data(int table_id, void *data,
+						 time_t sample_time)
+{
+	int rc = SLURM_SUCCESS;
+
+	log_flag(PROFILE, "PROFILE: %s %d", __func__, table_id);
+
+	/* ensure that we have to record something */
+	xassert(running_in_slurmstepd());
+	xassert(g_job);
+	xassert(g_profile_running != ACCT_GATHER_PROFILE_NOT_SET);
+
+	if (g_profile_running <= ACCT_GATHER_PROFILE_NONE)
+		return SLURM_ERROR;
+
+	slurm_mutex_lock(&writer_mutex);
+	if (!writer) {
+		debug("PROFILE: Trying to add data but profiling is over");
+	} else if (columnar_writer_append(writer, table_id, sample_time,
+					  data)) {
+		error("PROFILE: Impossible to add data to the table %d; "
+		      "maybe the table has not been created?", table_id);
+		rc = SLURM_ERROR;
+	}
+	slurm_mutex_unlock(&writer_mutex);
+
+	return rc;
+}
+
+extern void acct_gather_profile_p_conf_values(List *data)
+{
+	config_key_pair_t *key_pair;
+
+	xassert(*data);
+
+	key_pair = xmalloc(sizeof(config_key_pair_t));
+	key_pair->name = xstrdup("ProfileColumnarChunkRows");
+	key_pair->value = xstrdup_printf("%u", columnar_conf.chunk_rows);
+	list_append(*data, key_pair);
+
+	key_pair = xmalloc(sizeof(config_key_pair_t));
+	key_pair->name = xstrdup("ProfileColumnarDir");
+	key_pair->value = xstrdup(columnar_conf.dir);
+	list_append(*data, key_pair);
+
+	key_pair = xmalloc(sizeof(config_key_pair_t));
+	key_pair->name = xstrdup("ProfileColumnarDefault");
+	key_pair->value =
+		xstrdup(acct_gather_profile_to_string(columnar_conf.def));
+	list_append(*data, key_pair);
+
+	return;
+}
+
+extern bool acct_gather_profile_p_is_active(uint32_t type)
+{
+	if (g_profile_running <= ACCT_GATHER_PROFILE_NONE)
+		return false;
+	return (type == ACCT_GATHER_PROFILE_NOT_SET)
+		|| (g_profile_running & type);
+}
@@ -0,0 +1,989 @@
+/*****************************************************************************\
+ *  columnar_api.c - columnar time-series store for acct_gather_profile
+ *****************************************************************************
+ *  Copyright (C) 2021 SchedMD LLC.
+ *
+ *  This file is part of Slurm, a resource management program.
+ *  For details, see <https://slurm.schedmd.com>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  Slurm is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  Slurm is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with Slurm; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "src/common/log.h"
+#include "src/common/macros.h"
+#include "src/common/pack.h"
+#include "src/common/slurm_protocol_defs.h"
+#include "src/common/xmalloc.h"
+#include "src/common/xstring.h"
+
+#include "columnar_api.h"
+
+#define MAGIC_LEN 4
+#define REC_HDR_LEN 5	/* uint8 type + uint32 length */
+#define TASK_GROUP "Tasks"
+
+typedef struct {
+	uint8_t *data;
+	uint32_t size;		/* allocated bytes */
+	uint64_t bits;		/* bits written or available */
+	uint64_t pos;		/* next bit to read */
+} bit_stream_t;
+
+typedef struct {
+	columnar_dataset_t ds;
+	uint64_t **columns;	/* columns[field][row] */
+	uint32_t rows;
+	uint64_t *time;
+} writer_dataset_t;
+
+struct columnar_writer {
+	uint32_t chunk_rows;
+	uint32_t dataset_cnt;
+	writer_dataset_t *datasets;
+	int fd;
+};
+
+struct columnar_reader {
+	buf_t *buf;			/* payload of the current record */
+	columnar_dataset_t *cur_ds;	/* of the current record */
+	uint32_t *col_len;		/* time column first */
+	char **col_ptr;
+	uint32_t chunk_rows;
+	uint32_t dataset_cnt;
+	columnar_dataset_t **datasets;	/* indexed by dataset id */
+	int fd;
+	int filter;			/* dataset id of chunks to return */
+	bool have_node;
+	columnar_node_t node;
+	off_t offset;			/* of the current record */
+	bool own_fd;
+	off_t pos;			/* of the next record */
+	uint8_t rec_hdr[REC_HDR_LEN];
+};
+
+/*
+ * Bit level stream, most significant bit first. Buffers are grown with
+ * xrealloc() which zero fills, so writes only need to OR bits in.
+ */
+static void _put_bits(bit_stream_t *bs, uint64_t val, int nbits)
+{
+	while (nbits > 0) {
+		uint32_t byte = bs->bits >> 3;
+		int avail = 8 - (bs->bits & 7);
+		int n = MIN(avail, nbits);
+		uint8_t chunk = (val >> (nbits - n)) & ((1 << n) - 1);
+
+		if (byte >= bs->size) {
+			bs->size = (bs->size * 2) + 64;
+			xrealloc(bs->data, bs->size);
+		}
+		bs->data[byte] |= chunk << (avail - n);
+		bs->bits += n;
+		nbits -= n;
+	}
+}
+
+static int _get_bits(bit_stream_t *bs, int nbits, uint64_t *val)
+{
+	uint64_t v = 0;
+
+	if ((bs->pos + nbits) > bs->bits)
+		return SLURM_ERROR;
+
+	while (nbits > 0) {
+		uint32_t byte = bs->pos >> 3;
+		int avail = 8 - (bs->pos & 7);
+		int n = MIN(avail, nbits);
+
+		v = (v << n) | ((bs->data[byte] >> (avail - n)) &
+				((1 << n) - 1));
+		bs->pos += n;
+		nbits -= n;
+	}
+
+	*val = v;
+	return SLURM_SUCCESS;
+}
+
+static uint8_t *_bits_done(bit_stream_t *bs, uint32_t *len)
+{
+	*len = (bs->bits + 7) >> 3;
+	return bs->data;
+}
+
+static uint64_t _zigzag(int64_t val)
+{
+	return ((uint64_t) val << 1) ^ (uint64_t) (val >> 63);
+}
+
+static int64_t _unzigzag(uint64_t val)
+{
+	return (int64_t) (val >> 1) ^ -(int64_t) (val & 1);
+}
+
+/*
+ * Timestamps: the first value verbatim, then the delta of deltas using the
+ * Gorilla prefix code. Samples taken at a fixed frequency cost one bit.
+ */
+static uint8_t *_encode_time(uint64_t *values, uint32_t cnt, uint32_t *len)
+{
+	bit_stream_t bs = { 0 };
+	uint64_t prev_delta = 0;
+
+	for (uint32_t i = 0; i < cnt; i++) {
+		uint64_t delta, dod;
+
+		if (!i) {
+			_put_bits(&bs, values[0], 64);
+			continue;
+		}
+
+		delta = values[i] - values[i - 1];
+		dod = _zigzag((int64_t) (delta - prev_delta));
+		prev_delta = delta;
+
+		if (!dod) {
+			_put_bits(&bs, 0, 1);
+		} else if (dod < (1 << 7)) {
+			_put_bits(&bs, 0x2, 2);
+			_put_bits(&bs, dod, 7);
+		} else if (dod < (1 << 9)) {
+			_put_bits(&bs, 0x6, 3);
+			_put_bits(&bs, dod, 9);
+		} else if (dod < (1 << 12)) {
+			_put_bits(&bs, 0xe, 4);
+			_put_bits(&bs, dod, 12);
+		} else {
+			_put_bits(&bs, 0xf, 4);
+			_put_bits(&bs, dod, 64);
+		}
+	}
+
+	return _bits_done(&bs, len);
+}
+
+static int _decode_time(char *data, uint32_t len, uint32_t cnt,
+			uint64_t *out)
+{
+	bit_stream_t bs = { .data = (uint8_t *) data, .bits = len * 8 };
+	uint64_t delta = 0;
+
+	for (uint32_t i = 0; i < cnt; i++) {
+		uint64_t bit, dod = 0;
+		int width = 0;
+
+		if (!i) {
+			if (_get_bits(&bs, 64, &out[0]))
+				return SLURM_ERROR;
+			continue;
+		}
+
+		/* Count the leading ones of the prefix, at most four */
+		while (width < 4) {
+			if (_get_bits(&bs, 1, &bit))
+				return SLURM_ERROR;
+			if (!bit)
+				break;
+			width++;
+		}
+		switch (width) {
+		case 0:
+			break;
+		case 1:
+			width = 7;
+			break;
+		case 2:
+			width = 9;
+			break;
+		case 3:
+			width = 12;
+			break;
+		default:
+			width = 64;
+			break;
+		}
+		if (width && _get_bits(&bs, width, &dod))
+			return SLURM_ERROR;
+
+		delta += (uint64_t) _unzigzag(dod);
+		out[i] = out[i - 1] + delta;
+	}
+
+	return SLURM_SUCCESS;
+}
+
+static void _put_varint(bit_stream_t *bs, uint64_t val)
+{
+	while (val >= 0x80) {
+		_put_bits(bs, (val & 0x7f) | 0x80, 8);
+		val >>= 7;
+	}
+	_put_bits(bs, val, 8);
+}
+
+static int _get_varint(bit_stream_t *bs, uint64_t *val)
+{
+	uint64_t byte, v = 0;
+
+	for (int shift = 0; shift < 64; shift += 7) {
+		if (_get_bits(bs, 8, &byte))
+			return SLURM_ERROR;
+		v |= (byte & 0x7f) << shift;
+		if (!(byte & 0x80)) {
+			*val = v;
+			return SLURM_SUCCESS;
+		}
+	}
+
+	return SLURM_ERROR;
+}
+
+/*
+ * Counters: zigzag varint of the difference to the previous row. Both
+ * cumulative counters and gauges move by small amounts between samples.
+ */
+static uint8_t *_encode_uint64(uint64_t *values, uint32_t cnt, uint32_t *len)
+{
+	bit_stream_t bs = { 0 };
+	uint64_t prev = 0;
+
+	for (uint32_t i = 0; i < cnt; i++) {
+		_put_varint(&bs, _zigzag((int64_t) (values[i] - prev)));
+		prev = values[i];
+	}
+
+	return _bits_done(&bs, len);
+}
+
+static int _decode_uint64(char *data, uint32_t len, uint32_t cnt,
+			  uint64_t *out)
+{
+	bit_stream_t bs = { .data = (uint8_t *) data, .bits = len * 8 };
+	uint64_t prev = 0, zz;
+
+	for (uint32_t i = 0; i < cnt; i++) {
+		if (_get_varint(&bs, &zz))
+			return SLURM_ERROR;
+		out[i] = prev + (uint64_t) _unzigzag(zz);
+		prev = out[i];
+	}
+
+	return SLURM_SUCCESS;
+}
+
+/*
+ * Doubles: Gorilla XOR encoding. An unchanged value costs one bit, a value
+ * whose meaningful bits fit in the previous window costs two bits plus the
+ * window, otherwise the new window is stored (5 bits of leading zeros and 6
+ * bits of length) ahead of the meaningful bits.
+ */
+static uint8_t *_encode_double(uint64_t *values, uint32_t cnt, uint32_t *len)
+{
+	bit_stream_t bs = { 0 };
+	int prev_lead = -1, prev_trail = 0;
+
+	for (uint32_t i = 0; i < cnt; i++) {
+		uint64_t xor;
+		int lead, trail, sig;
+
+		if (!i) {
+			_put_bits(&bs, values[0], 64);
+			continue;
+		}
+
+		if (!(xor = values[i] ^ values[i - 1])) {
+			_put_bits(&bs, 0, 1);
+			continue;
+		}
+		_put_bits(&bs, 1, 1);
+
+		lead = MIN(__builtin_clzll(xor), 31);
+		trail = __builtin_ctzll(xor);
+
+		if ((prev_lead >= 0) && (lead >= prev_lead) &&
+		    (trail >= prev_trail)) {
+			_put_bits(&bs, 0, 1);
+			_put_bits(&bs, xor >> prev_trail,
+				  64 - prev_lead - prev_trail);
+			continue;
+		}
+
+		sig = 64 - lead - trail;
+		_put_bits(&bs, 1, 1);
+		_put_bits(&bs, lead, 5);
+		_put_bits(&bs, sig - 1, 6);
+		_put_bits(&bs, xor >> trail, sig);
+		prev_lead = lead;
+		prev_trail = trail;
+	}
+
+	return _bits_done(&bs, len);
+}
+
+static int _decode_double(char *data, uint32_t len, uint32_t cnt,
+			  uint64_t *out)
+{
+	bit_stream_t bs = { .data = (uint8_t *) data, .bits = len * 8 };
+	int lead = -1, trail = 0;
+
+	for (uint32_t i = 0; i < cnt; i++) {
+		uint64_t bit, val;
+
+		if (!i) {
+			if (_get_bits(&bs, 64, &out[0]))
+				return SLURM_ERROR;
+			continue;
+		}
+
+		if (_get_bits(&bs, 1, &bit))
+			return SLURM_ERROR;
+		if (!bit) {
+			out[i] = out[i - 1];
+			continue;
+		}
+
+		if (_get_bits(&bs, 1, &bit))
+			return SLURM_ERROR;
+		if (bit) {
+			uint64_t l, s;
+
+			if (_get_bits(&bs, 5, &l) || _get_bits(&bs, 6, &s))
+				return SLURM_ERROR;
+			lead = l;
+			trail = 64 - lead - (s + 1);
+			if (trail < 0)
+				return SLURM_ERROR;
+		} else if (lead < 0) {
+			return SLURM_ERROR;
+		}
+
+		if (_get_bits(&bs, 64 - lead - trail, &val))
+			return SLURM_ERROR;
+		out[i] = out[i - 1] ^ (val << trail);
+	}
+
+	return SLURM_SUCCESS;
+}
+
+static void _free_dataset_members(columnar_dataset_t *ds)
+{
+	for (uint32_t i = 0; i < ds->field_cnt; i++)
+		xfree(ds->field_names[i]);
+	xfree(ds->field_names);
+	xfree(ds->field_types);
+	xfree(ds->group);
+	xfree(ds->name);
+}
+
+static buf_t *_rec_init(columnar_rec_type_t type)
+{
+	buf_t *buf = init_buf(BUF_SIZE);
+
+	pack8(type, buf);
+	pack32(0, buf);		/* length, set by _rec_write() */
+
+	return buf;
+}
+
+static int _rec_write(int fd, buf_t *buf)
+{
+	uint32_t len = get_buf_offset(buf);
+
+	set_buf_offset(buf, 1);
+	pack32(len - REC_HDR_LEN, buf);
+	set_buf_offset(buf, len);
+
+	/* One write per record keeps concurrent readers consistent */
+	safe_write(fd, get_buf_data(buf), len);
+	free_buf(buf);
+	return SLURM_SUCCESS;
+
+rwfail:
+	free_buf(buf);
+	return SLURM_ERROR;
+}
+
+extern int columnar_write_header(int fd)
+{
+	buf_t *buf = init_buf(MAGIC_LEN + sizeof(uint32_t));
+
+	memcpy(get_buf_data(buf), COLUMNAR_MAGIC, MAGIC_LEN);
+	set_buf_offset(buf, MAGIC_LEN);
+	pack32(COLUMNAR_VERSION, buf);
+
+	safe_write(fd, get_buf_data(buf), get_buf_offset(buf));
+	free_buf(buf);
+	return SLURM_SUCCESS;
+
+rwfail:
+	free_buf(buf);
+	return SLURM_ERROR;
+}
+
+extern columnar_writer_t *columnar_writer_open(const char *path,
+					       columnar_node_t *node,
+					       uint32_t chunk_rows)
+{
+	columnar_writer_t *writer;
+	buf_t *buf;
+	int fd;
+
+	if ((fd = open(path, O_CREAT | O_WRONLY | O_TRUNC | O_CLOEXEC,
+		       0600)) < 0) {
+		error("%s: open(%s): %m", __func__, path);
+		return NULL;
+	}
+
+	buf = _rec_init(COLUMNAR_REC_NODE);
+	pack32(node->job_id, buf);
+	pack32(node->step_id, buf);
+	pack32(node->nodeid, buf);
+	pack32(node->ntasks, buf);
+	pack32(node->cpus_per_task, buf);
+	pack_time(node->start_time, buf);
+	packstr(node->node_name, buf);
+
+	if (columnar_write_header(fd) || _rec_write(fd, buf)) {
+		error("%s: unable to write header to %s: %m", __func__, path);
+		close(fd);
+		return NULL;
+	}
+
+	writer = xmalloc(sizeof(*writer));
+	writer->chunk_rows = chunk_rows ? chunk_rows : COLUMNAR_CHUNK_ROWS;
+	writer->fd = fd;
+
+	return writer;
+}
+
+extern int columnar_writer_add_dataset(columnar_writer_t *writer,
+				       const char *group, const char *name,
+				       acct_gather_profile_dataset_t *fields)
+{
+	writer_dataset_t *wds;
+	columnar_dataset_t *ds;
+	buf_t *buf;
+
+	xrecalloc(writer->datasets, writer->dataset_cnt + 1,
+		  sizeof(*writer->datasets));
+	wds = &writer->datasets[writer->dataset_cnt];
+	ds = &wds->ds;
+	ds->id = writer->dataset_cnt;
+	ds->group = xstrdup(group);
+	ds->name = xstrdup(name);
+
+	for (; fields && (fields->type != PROFILE_FIELD_NOT_SET); fields++) {
+		xrecalloc(ds->field_names, ds->field_cnt + 1, sizeof(char *));
+		xrecalloc(ds->field_types, ds->field_cnt + 1,
+			  sizeof(*ds->field_types));
+		ds->field_names[ds->field_cnt] = xstrdup(fields->name);
+		ds->field_types[ds->field_cnt] = fields->type;
+		ds->field_cnt++;
+	}
+
+	buf = _rec_init(COLUMNAR_REC_DATASET);
+	pack32(ds->id, buf);
+	packstr(ds->group, buf);
+	packstr(ds->name, buf);
+	pack32(ds->field_cnt, buf);
+	for (uint32_t i = 0; i < ds->field_cnt; i++) {
+		pack8(ds->field_types[i], buf);
+		packstr(ds->field_names[i], buf);
+	}
+
+	if (_rec_write(writer->fd, buf)) {
+		error("%s: unable to write dataset %s: %m", __func__, name);
+		_free_dataset_members(ds);
+		return SLURM_ERROR;
+	}
+
+	return writer->dataset_cnt++;
+}
+
+static int _flush_dataset(columnar_writer_t *writer, writer_dataset_t *wds)
+{
+	columnar_dataset_t *ds = &wds->ds;
+	uint32_t len;
+	uint8_t *data;
+	buf_t *buf;
+
+	if (!wds->rows)
+		return SLURM_SUCCESS;
+
+	buf = _rec_init(COLUMNAR_REC_CHUNK);
+	pack32(ds->id, buf);
+	pack32(wds->rows, buf);
+
+	data = _encode_time(wds->time, wds->rows, &len);
+	packmem((char *) data, len, buf);
+	xfree(data);
+
+	for (uint32_t i = 0; i < ds->field_cnt; i++) {
+		if (ds->field_types[i] == PROFILE_FIELD_DOUBLE)
+			data = _encode_double(wds->columns[i], wds->rows,
+					      &len);
+		else
+			data = _encode_uint64(wds->columns[i], wds->rows,
+					      &len);
+		packmem((char *) data, len, buf);
+		xfree(data);
+	}
+
+	wds->rows = 0;
+
+	return _rec_write(writer->fd, buf);
+}
+
+extern int columnar_writer_append(columnar_writer_t *writer, int dataset_id,
+				  time_t sample_time, void *data)
+{
+	writer_dataset_t *wds;
+	uint64_t *values = data;
+
+	if ((dataset_id < 0) || (dataset_id >= writer->dataset_cnt))
+		return SLURM_ERROR;
+	wds = &writer->datasets[dataset_id];
+
+	if (!wds->time) {
+		wds->time = xcalloc(writer->chunk_rows, sizeof(uint64_t));
+		wds->columns = xcalloc(wds->ds.field_cnt, sizeof(uint64_t *));
+		for (uint32_t i = 0; i < wds->ds.field_cnt; i++)
+			wds->columns[i] = xcalloc(writer->chunk_rows,
+						  sizeof(uint64_t));
+	}
+
+	wds->time[wds->rows] = sample_time;
+	for (uint32_t i = 0; i < wds->ds.field_cnt; i++)
+		memcpy(&wds->columns[i][wds->rows], &values[i],
+		       sizeof(uint64_t));
+
+	if (++wds->rows >= writer->chunk_rows)
+		return _flush_dataset(writer, wds);
+
+	return SLURM_SUCCESS;
+}
+
+extern int columnar_writer_flush(columnar_writer_t *writer)
+{
+	int rc = SLURM_SUCCESS;
+
+	for (uint32_t i = 0; i < writer->dataset_cnt; i++) {
+		if (_flush_dataset(writer, &writer->datasets[i]))
+			rc = SLURM_ERROR;
+	}
+
+	return rc;
+}
+
+static void _writer_free(columnar_writer_t *writer)
+{
+	for (uint32_t i = 0; i < writer->dataset_cnt; i++) {
+		writer_dataset_t *wds = &writer->datasets[i];
+
+		if (wds->columns) {
+			for (uint32_t j = 0; j < wds->ds.field_cnt; j++)
+				xfree(wds->columns[j]);
+			xfree(wds->columns);
+		}
+		xfree(wds->time);
+		_free_dataset_members(&wds->ds);
+	}
+	xfree(writer->datasets);
+	xfree(writer);
+}
+
+extern int columnar_writer_close(columnar_writer_t *writer)
+{
+	int rc;
+
+	if (!writer)
+		return SLURM_SUCCESS;
+
+	rc = columnar_writer_flush(writer);
+	if (close(writer->fd) < 0) {
+		error("%s: close(): %m", __func__);
+		rc = SLURM_ERROR;
+	}
+	_writer_free(writer);
+
+	return rc;
+}
+
+extern void columnar_writer_abandon(columnar_writer_t *writer)
+{
+	if (!writer)
+		return;
+
+	close(writer->fd);
+	_writer_free(writer);
+}
+
+static void _reader_reset_node(columnar_reader_t *reader)
+{
+	for (uint32_t i = 0; i < reader->dataset_cnt; i++) {
+		if (!reader->datasets[i])
+			continue;
+		_free_dataset_members(reader->datasets[i]);
+		xfree(reader->datasets[i]);
+	}
+	xfree(reader->datasets);
+	reader->dataset_cnt = 0;
+	xfree(reader->node.node_name);
+	reader->have_node = false;
+}
+
+static void _reader_reset_chunk(columnar_reader_t *reader)
+{
+	reader->cur_ds = NULL;
+	reader->chunk_rows = 0;
+	xfree(reader->col_len);
+	xfree(reader->col_ptr);
+	FREE_NULL_BUFFER(reader->buf);
+}
+
+static ssize_t _read_full(int fd, char *data, uint32_t len, off_t offset)
+{
+	ssize_t got = 0, rc;
+
+	while (got < len) {
+		rc = pread(fd, data + got, len - got, offset + got);
+		if ((rc < 0) && ((errno == EINTR) || (errno == EAGAIN)))
+			continue;
+		if (rc <= 0)
+			break;
+		got += rc;
+	}
+
+	return got;
+}
+
+extern columnar_reader_t *columnar_reader_open(const char *path,
+					       off_t offset)
+{
+	columnar_reader_t *reader;
+	char hdr[MAGIC_LEN + sizeof(uint32_t)];
+	uint32_t version;
+	int fd;
+
+	if ((fd = open(path, O_RDONLY | O_CLOEXEC)) < 0) {
+		error("%s: open(%s): %m", __func__, path);
+		return NULL;
+	}
+
+	if (_read_full(fd, hdr, sizeof(hdr), 0) != sizeof(hdr)) {
+		error("%s: unable to read header of %s", __func__, path);
+		goto fail;
+	}
+	if (memcmp(hdr, COLUMNAR_MAGIC, MAGIC_LEN)) {
+		error("%s: %s is not a profile file", __func__, path);
+		goto fail;
+	}
+	memcpy(&version, hdr + MAGIC_LEN, sizeof(version));
+	if (ntohl(version) != COLUMNAR_VERSION) {
+		error("%s: %s has unsupported version %u",
+		      __func__, path, ntohl(version));
+		goto fail;
+	}
+
+	reader = xmalloc(sizeof(*reader));
+	reader->fd = fd;
+	reader->filter = -1;
+	reader->own_fd = true;
+	reader->pos = offset ? offset : sizeof(hdr);
+	return reader;
+
+fail:
+	close(fd);
+	return NULL;
+}
+
+extern columnar_reader_t *columnar_reader_clone(columnar_reader_t *reader,
+						off_t offset)
+{
+	columnar_reader_t *clone = xmalloc(sizeof(*clone));
+
+	clone->fd = reader->fd;
+	clone->filter = -1;
+	clone->pos = offset;
+
+	return clone;
+}
+
+extern void columnar_reader_filter(columnar_reader_t *reader, int dataset_id)
+{
+	reader->filter = dataset_id;
+}
+
+extern void columnar_reader_close(columnar_reader_t *reader)
+{
+	if (!reader)
+		return;
+
+	_reader_reset_chunk(reader);
+	_reader_reset_node(reader);
+	if (reader->own_fd)
+		close(reader->fd);
+	xfree(reader);
+}
+
+static int _unpack_node(columnar_reader_t *reader)
+{
+	columnar_node_t *node = &reader->node;
+	buf_t *buf = reader->buf;
+	uint32_t uint32_tmp;
+
+	_reader_reset_node(reader);
+
+	safe_unpack32(&node->job_id, buf);
+	safe_unpack32(&node->step_id, buf);
+	safe_unpack32(&node->nodeid, buf);
+	safe_unpack32(&node->ntasks, buf);
+	safe_unpack32(&node->cpus_per_task, buf);
+	safe_unpack_time(&node->start_time, buf);
+	safe_unpackstr_xmalloc(&node->node_name, &uint32_tmp, buf);
+	reader->have_node = true;
+
+	return COLUMNAR_REC_NODE;
+
+unpack_error:
+	return SLURM_ERROR;
+}
+
+static int _unpack_dataset(columnar_reader_t *reader)
+{
+	columnar_dataset_t *ds = xmalloc(sizeof(*ds));
+	buf_t *buf = reader->buf;
+	uint32_t uint32_tmp;
+
+	safe_unpack32(&ds->id, buf);
+	safe_unpackstr_xmalloc(&ds->group, &uint32_tmp, buf);
+	safe_unpackstr_xmalloc(&ds->name, &uint32_tmp, buf);
+	safe_unpack32(&ds->field_cnt, buf);
+	if (ds->field_cnt > MAX_PACK_ARRAY_LEN)
+		goto unpack_error;
+
+	ds->field_names = xcalloc(ds->field_cnt, sizeof(char *));
+	ds->field_types = xcalloc(ds->field_cnt, sizeof(*ds->field_types));
+	for (uint32_t i = 0; i < ds->field_cnt; i++) {
+		uint8_t type;
+
+		safe_unpack8(&type, buf);
+		ds->field_types[i] = type;
+		safe_unpackstr_xmalloc(&ds->field_names[i], &uint32_tmp, buf);
+	}
+
+	if ((ds->id >= MAX_PACK_ARRAY_LEN) ||
+	    ((ds->id < reader->dataset_cnt) && reader->datasets[ds->id]))
+		goto unpack_error;
+	if (ds->id >= reader->dataset_cnt) {
+		xrecalloc(reader->datasets, ds->id + 1,
+			  sizeof(*reader->datasets));
+		reader->dataset_cnt = ds->id + 1;
+	}
+	reader->datasets[ds->id] = ds;
+	reader->cur_ds = ds;
+
+	return COLUMNAR_REC_DATASET;
+
+unpack_error:
+	_free_dataset_members(ds);
+	xfree(ds);
+	return SLURM_ERROR;
+}
+
+static int _unpack_chunk(columnar_reader_t *reader)
+{
+	buf_t *buf = reader->buf;
+	uint32_t id;
+
+	safe_unpack32(&id, buf);
+	safe_unpack32(&reader->chunk_rows, buf);
+	if (reader->chunk_rows > MAX_PACK_ARRAY_LEN)
+		goto unpack_error;
+	if (!(reader->cur_ds = columnar_reader_dataset(reader, id)))
+		goto unpack_error;
+
+	/* Only locate the columns, they are decoded on demand */
+	reader->col_len = xcalloc(reader->cur_ds->field_cnt + 1,
+				  sizeof(uint32_t));
+	reader->col_ptr = xcalloc(reader->cur_ds->field_cnt + 1,
+				  sizeof(char *));
+	for (uint32_t i = 0; i <= reader->cur_ds->field_cnt; i++)
+		safe_unpackmem_ptr(&reader->col_ptr[i], &reader->col_len[i],
+				   buf);
+
+	return COLUMNAR_REC_CHUNK;
+
+unpack_error:
+	return SLURM_ERROR;
+}
+
+extern int columnar_reader_next(columnar_reader_t *reader)
+{
+	uint32_t len;
+	char *data;
+	ssize_t rc;
+
+	_reader_reset_chunk(reader);
+
+again:
+	reader->offset = reader->pos;
+	rc = _read_full(reader->fd, (char *) reader->rec_hdr, REC_HDR_LEN,
+			reader->pos);
+	if (!rc)
+		return COLUMNAR_REC_NONE;
+	if (rc != REC_HDR_LEN) {
+		debug("%s: ignoring truncated record header", __func__);
+		return COLUMNAR_REC_NONE;
+	}
+	reader->pos += REC_HDR_LEN;
+
+	memcpy(&len, reader->rec_hdr + 1, sizeof(len));
+	len = ntohl(len);
+	if (len > MAX_BUF_SIZE)
+		return SLURM_ERROR;
+
+	/* Skip filtered out chunks by only peeking at their dataset id */
+	if ((reader->filter >= 0) &&
+	    (reader->rec_hdr[0] == COLUMNAR_REC_CHUNK) &&
+	    (len >= sizeof(uint32_t))) {
+		uint32_t id;
+
+		if (_read_full(reader->fd, (char *) &id, sizeof(id),
+			       reader->pos) != sizeof(id))
+			return COLUMNAR_REC_NONE;
+		if (ntohl(id) != reader->filter) {
+			reader->pos += len;
+			goto again;
+		}
+	}
+
+	data = xmalloc_nz(len ? len : 1);
+	if (_read_full(reader->fd, data, len, reader->pos) != len) {
+		debug("%s: ignoring truncated record", __func__);
+		xfree(data);
+		return COLUMNAR_REC_NONE;
+	}
+	reader->pos += len;
+	reader->buf = create_buf(data, len);
+
+	switch (reader->rec_hdr[0]) {
+	case COLUMNAR_REC_NODE:
+		return _unpack_node(reader);
+	case COLUMNAR_REC_DATASET:
+		if (!reader->have_node)
+			return SLURM_ERROR;
+		return _unpack_dataset(reader);
+	case COLUMNAR_REC_CHUNK:
+		if (!reader->have_node)
+			return SLURM_ERROR;
+		return _unpack_chunk(reader);
+	default:
+		error("%s: unknown record type %u",
+		      __func__, reader->rec_hdr[0]);
+		return SLURM_ERROR;
+	}
+}
+
+extern off_t columnar_reader_offset(columnar_reader_t *reader)
+{
+	return reader->offset;
+}
+
+extern int columnar_reader_copy(columnar_reader_t *reader, int fd)
+{
+	if (!reader->buf)
+		return SLURM_ERROR;
+
+	safe_write(fd, reader->rec_hdr, REC_HDR_LEN);
+	safe_write(fd, get_buf_data(reader->buf), size_buf(reader->buf));
+	return SLURM_SUCCESS;
+
+rwfail:
+	return SLURM_ERROR;
+}
+
+extern columnar_node_t *columnar_reader_node(columnar_reader_t *reader)
+{
+	return reader->have_node ? &reader->node : NULL;
+}
+
+extern columnar_dataset_t *columnar_reader_dataset(columnar_reader_t *reader,
+						   int id)
+{
+	if (id < 0)
+		return reader->cur_ds;
+	if (id >= reader->dataset_cnt)
+		return NULL;
+	return reader->datasets[id];
+}
+
+extern uint32_t columnar_reader_rows(columnar_reader_t *reader)
+{
+	return reader->chunk_rows;
+}
+
+extern int columnar_reader_time(columnar_reader_t *reader, uint64_t *out)
+{
+	if (!reader->col_ptr)
+		return SLURM_ERROR;
+
+	return _decode_time(reader->col_ptr[0], reader->col_len[0],
+			    reader->chunk_rows, out);
+}
+
+extern int columnar_reader_column(columnar_reader_t *reader, uint32_t field,
+				  uint64_t *out)
+{
+	columnar_dataset_t *ds = reader->cur_ds;
+
+	if (!reader->col_ptr || (field >= ds->field_cnt))
+		return SLURM_ERROR;
+
+	if (ds->field_types[field] == PROFILE_FIELD_DOUBLE)
+		return _decode_double(reader->col_ptr[field + 1],
+				      reader->col_len[field + 1],
+				      reader->chunk_rows, out);
+
+	return _decode_uint64(reader->col_ptr[field + 1],
+			      reader->col_len[field + 1],
+			      reader->chunk_rows, out);
+}
+
+extern char *columnar_series_name(columnar_dataset_t *dataset)
+{
+	if (!xstrcmp(dataset->group, TASK_GROUP))
+		return xstrdup_printf("%s_%s", GRP_TASK, dataset->name);
+
+	return xstrdup(dataset->name);
+}
@@ -0,0 +1,229 @@
+/*****************************************************************************\
+ *  columnar_api.h - columnar time-series store for acct_gather_profile
+ *****************************************************************************
+ *  Copyright (C) 2021 SchedMD LLC.
+ *
+ *  This file is part of Slurm, a resource management program.
+ *  For details, see <https://slurm.schedmd.com>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  Slurm is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  Slurm is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with Slurm; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+/*
+ * File layout
+ *
+ * A profile file starts with COLUMNAR_MAGIC and a 32 bit format version,
+ * followed by a sequence of self-delimited records:
+ *
+ *	uint8  record type (columnar_rec_type_t)
+ *	uint32 payload length
+ *	payload
+ *
+ * A NODE record opens a node section, DATASET records declare the series
+ * of that section and CHUNK records hold up to chunk_rows samples of one
+ * dataset stored column by column:
+ *
+ *	EpochTime - delta-of-delta, Gorilla style variable bit width
+ *	uint64    - zigzag varint delta from the previous row
+ *	double    - Gorilla XOR against the previous row
+ *
+ * Every column is prefixed by its encoded length so readers can skip the
+ * columns they do not need. Dataset ids are only unique within a node
+ * section, which lets merged job files be built by plain concatenation of
+ * node-step files. A truncated trailing record (e.g. slurmstepd was killed
+ * mid-write) is silently ignored by the reader.
+ */
+
+#ifndef _ACCT_GATHER_PROFILE_COLUMNAR_API_H
+#define _ACCT_GATHER_PROFILE_COLUMNAR_API_H
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <sys/types.h>
+#include <time.h>
+
+#include "src/common/slurm_acct_gather_profile.h"
+
+#define COLUMNAR_MAGIC		"SPRF"
+#define COLUMNAR_VERSION	1
+#define COLUMNAR_SUFFIX		"sprof"
+#define COLUMNAR_CHUNK_ROWS	32
+
+#define GRP_ENERGY "Energy"
+#define GRP_FILESYSTEM "Filesystem"
+#define GRP_NETWORK "Network"
+#define GRP_TASK "Task"
+
+typedef enum {
+	COLUMNAR_REC_NONE,
+	COLUMNAR_REC_NODE,
+	COLUMNAR_REC_DATASET,
+	COLUMNAR_REC_CHUNK,
+} columnar_rec_type_t;
+
+typedef struct {
+	uint32_t cpus_per_task;
+	uint32_t job_id;
+	char *node_name;
+	uint32_t nodeid;
+	uint32_t ntasks;
+	time_t start_time;
+	uint32_t step_id;
+} columnar_node_t;
+
+typedef struct {
+	uint32_t field_cnt;
+	char **field_names;
+	acct_gather_profile_field_type_t *field_types;
+	char *group;		/* NULL if attached to the node itself */
+	uint32_t id;
+	char *name;
+} columnar_dataset_t;
+
+typedef struct columnar_writer columnar_writer_t;
+typedef struct columnar_reader columnar_reader_t;
+
+/*
+ * Create (truncate) a profile file and write the node section header.
+ * chunk_rows is the number of samples buffered per dataset before they are
+ * encoded and written out.
+ * RET writer or NULL on error
+ */
+extern columnar_writer_t *columnar_writer_open(const char *path,
+					       columnar_node_t *node,
+					       uint32_t chunk_rows);
+
+/*
+ * Declare a new dataset in the current node section.
+ * IN fields - terminated by a PROFILE_FIELD_NOT_SET entry
+ * RET dataset id or SLURM_ERROR
+ */
+extern int columnar_writer_add_dataset(columnar_writer_t *writer,
+				       const char *group, const char *name,
+				       acct_gather_profile_dataset_t *fields);
+
+/*
+ * Append one sample. data holds one 8 byte value per field, in the order
+ * given to columnar_writer_add_dataset().
+ */
+extern int columnar_writer_append(columnar_writer_t *writer, int dataset_id,
+				  time_t sample_time, void *data);
+
+/* Encode and write out all buffered samples */
+extern int columnar_writer_flush(columnar_writer_t *writer);
+
+/* Flush and close, the writer is freed */
+extern int columnar_writer_close(columnar_writer_t *writer);
+
+/* Close the file descriptor without flushing, for use in forked children */
+extern void columnar_writer_abandon(columnar_writer_t *writer);
+
+/* Write the file magic and version, for tools building merged files */
+extern int columnar_write_header(int fd);
+
+/*
+ * Open a profile file for sequential reading, starting at the record at
+ * byte offset (0 for the beginning of the file).
+ * RET reader or NULL on error
+ */
+extern columnar_reader_t *columnar_reader_open(const char *path,
+					       off_t offset);
+
+/*
+ * Create an independent reader on the same open file, starting at the
+ * record at byte offset. Reads are positioned so any number of readers can
+ * share one file descriptor, the clones must be closed before the original.
+ */
+extern columnar_reader_t *columnar_reader_clone(columnar_reader_t *reader,
+						off_t offset);
+
+/*
+ * Only return the CHUNK records of dataset_id (< 0 for all). Other chunks
+ * are skipped without being read.
+ */
+extern void columnar_reader_filter(columnar_reader_t *reader, int dataset_id);
+
+extern void columnar_reader_close(columnar_reader_t *reader);
+
+/*
+ * Read the next record. NODE and DATASET records update the reader state
+ * returned by columnar_reader_node() and columnar_reader_dataset(), a
+ * CHUNK record is kept until the next call and can be decoded with
+ * columnar_reader_time() and columnar_reader_column().
+ * RET record type, COLUMNAR_REC_NONE at end of file or SLURM_ERROR
+ */
+extern int columnar_reader_next(columnar_reader_t *reader);
+
+/* Offset of the record last returned by columnar_reader_next() */
+extern off_t columnar_reader_offset(columnar_reader_t *reader);
+
+/* Write the record last returned by columnar_reader_next() to fd as is */
+extern int columnar_reader_copy(columnar_reader_t *reader, int fd);
+
+/* Current node section, NULL before the first NODE record */
+extern columnar_node_t *columnar_reader_node(columnar_reader_t *reader);
+
+/*
+ * Dataset of the current node section by id, or of the current DATASET or
+ * CHUNK record if id < 0.
+ */
+extern columnar_dataset_t *columnar_reader_dataset(columnar_reader_t *reader,
+						   int id);
+
+/* Number of rows in the current chunk */
+extern uint32_t columnar_reader_rows(columnar_reader_t *reader);
+
+/*
+ * Decode the EpochTime column of the current chunk into out, which must
+ * hold columnar_reader_rows() entries.
+ */
+extern int columnar_reader_time(columnar_reader_t *reader, uint64_t *out);
+
+/*
+ * Decode one field column of the current chunk. Double columns are
+ * returned as their bit pattern, see columnar_get_double().
+ */
+extern int columnar_reader_column(columnar_reader_t *reader, uint32_t field,
+				  uint64_t *out);
+
+/*
+ * Name of the series a dataset belongs to, as used by sprofile: "Task_<id>"
+ * for the per task datasets, the dataset name otherwise. xfree() the result.
+ */
+extern char *columnar_series_name(columnar_dataset_t *dataset);
+
+static inline double columnar_get_double(uint64_t bits)
+{
+	union {
+		uint64_t u;
+		double d;
+	} v = { .u = bits };
+
+	return v.d;
+}
+
+#endif
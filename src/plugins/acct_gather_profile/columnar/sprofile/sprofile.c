@@ -0,0 +1,1160 @@
+/*****************************************************************************\
+ *  sprofile.c - Utility to merge columnar node-step profile files into a job
+ *               file or extract data from a job file
+ *****************************************************************************
+ *  Copyright (C) 2021 SchedMD LLC.
+ *
+ *  This file is part of Slurm, a resource management program.
+ *  For details, see <https://slurm.schedmd.com>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  Slurm is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  Slurm is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with Slurm; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+ *
+\*****************************************************************************/
+
+#include "config.h"
+
+#define _GNU_SOURCE
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "src/common/list.h"
+#include "src/common/proc_args.h"
+#include "src/common/read_config.h"
+#include "src/common/slurm_acct_gather_profile.h"
+#include "src/common/uid.h"
+#include "src/common/xmalloc.h"
+#include "src/common/xstring.h"
+#include "../columnar_api.h"
+#include "sprofile.h"
+
+const char plugin_type[] = "";
+
+/* Dataset filter which no chunk matches, used to only walk the headers */
+#define SKIP_ALL_CHUNKS INT_MAX
+
+sprofile_opts_t params;
+
+typedef struct {
+	char *file_name;
+	char *node_name;
+	int step_id;
+} sprofile_file_t;
+
+/* One series of one node being merged by time with all the others */
+typedef struct {
+	uint64_t bucket_val;		/* last value seen in current bucket */
+	uint32_t field;
+	bool in_bucket;
+	char *label;
+	int node_recs;			/* NODE records read */
+	columnar_reader_t *reader;
+	uint32_t row;
+	uint32_t rows;
+	time_t start_time;
+	uint32_t step_id;
+	uint64_t *time;
+	uint64_t *value;
+} cursor_t;
+
+static void _cleanup(void);
+static int _set_options(const int argc, char **argv);
+static int _merge_step_files(void);
+static int _extract_series(void);
+static int _extract_item(void);
+static int _check_params(void);
+static void _free_options(void);
+static void _remove_empty_output(void);
+static int _list_items(void);
+
+static void _help_msg(void)
+{
+	printf("Usage sprofile [<OPTION>] -j <job[.stepid]>\n\n"
+	       "Valid <OPTION> values are:\n"
+	       " -L, --list           Print the items of a series contained in a job file.\n"
+	       "     -i, --input      merged file to extract from (default ./job_$jobid.sprof)\n"
+	       "     -s, --series     Name of series (default is all):\n"
+	       "                      Energy | Filesystem | Network | Task\n"
+	       " -E, --extract        Extract data series from job file.\n"
+	       "     -i, --input      merged file to extract from (default ./job_$jobid.sprof)\n"
+	       "     -N, --node       Node name to extract (default is all)\n"
+	       "     -s, --series     Name of series:\n"
+	       "                      Energy | Filesystem | Network | Task | Task_#\n"
+	       "                      'Task' is all tasks, Task_# is task_id (default is all)\n"
+	       " -I, --item-extract   Extract data item from one series from \n"
+	       "                      all samples on all nodes from the job file.\n"
+	       "     -i, --input      merged file to extract from (default ./job_$jobid.sprof)\n"
+	       "     -s, --series     Name of series:\n"
+	       "                      Energy | Filesystem | Network | Task | Task_#\n"
+	       "     -d, --data       Name of data item in series (see --list)\n"
+	       "     -N, --node       Node name to extract (default is all)\n"
+	       "     -b, --bucket     Width in seconds of the time buckets samples of\n"
+	       "                      different nodes are aggregated in (default 1)\n"
+	       " -j, --jobs           Format is <job(.step)>. Merge this job/step.\n"
+	       "                      This option is required.  Not specifying a step\n"
+	       "                      will result in all steps found to be processed.\n"
+	       " -h, --help           Print this description of use.\n"
+	       " -o, --output         Path to a file into which to write.\n"
+	       "                      Default for merge is ./job_$jobid.sprof\n"
+	       "                      Default for extract is ./extract_$jobid.csv\n"
+	       " -p, --profiledir     Profile directory location where node-step files exist\n"
+	       "		               default is what is set in acct_gather.conf\n"
+	       " -S, --savefiles      Don't remove node-step files after merging them \n"
+	       " --user               User who profiled job. (Handy for root user, defaults to \n"
+	       "		               user running this command.)\n"
+	       " --usage              Display brief usage message\n");
+}
+
+int
+main(int argc, char **argv)
+{
+	int cc;
+
+	slurm_conf_init(NULL);
+	cc = _set_options(argc, argv);
+	if (cc < 0)
+		goto ouch;
+
+	cc = _check_params();
+	if (cc < 0)
+		goto ouch;
+
+	switch (params.mode) {
+	case SPROFILE_MODE_MERGE:
+		info("Merging node-step files into %s",
+		     params.output);
+		cc = _merge_step_files();
+		break;
+	case SPROFILE_MODE_EXTRACT:
+		info("Extracting job data from %s into %s",
+		     params.input, params.output);
+		cc = _extract_series();
+		break;
+	case SPROFILE_MODE_ITEM_EXTRACT:
+		info("Extracting '%s' from '%s' data from %s into %s",
+		     params.data_item, params.series,
+		     params.input, params.output);
+		cc = _extract_item();
+		break;
+	case SPROFILE_MODE_ITEM_LIST:
+		info("Listing items from %s", params.input);
+		cc = _list_items();
+		break;
+	default:
+		error("Unknown type %d", params.mode);
+		break;
+	}
+
+ouch:
+	_cleanup();
+
+	return cc;
+}
+
+static void _destroy_sprofile_file(void *arg)
+{
+	sprofile_file_t *object = arg;
+
+	if (!object)
+		return;
+
+	xfree(object->file_name);
+	xfree(object->node_name);
+	xfree(object);
+}
+
+/* Step order, batch step first, then by node name */
+static int _sprofile_sort_files(void *s1, void *s2)
+{
+	sprofile_file_t *rec_a = *(sprofile_file_t **)s1;
+	sprofile_file_t *rec_b = *(sprofile_file_t **)s2;
+
+	if (rec_a->step_id < rec_b->step_id)
+		return -1;
+	else if (rec_a->step_id > rec_b->step_id)
+		return 1;
+
+	return xstrcmp(rec_a->node_name, rec_b->node_name);
+}
+
+static void _cleanup(void)
+{
+	_remove_empty_output();
+	_free_options();
+	log_fini();
+	slurm_conf_destroy();
+	acct_gather_profile_fini();
+	acct_gather_conf_destroy();
+}
+
+static void _free_options(void)
+{
+	xfree(params.data_item);
+	xfree(params.dir);
+	xfree(params.input);
+	xfree(params.node);
+	xfree(params.output);
+	xfree(params.series);
+	xfree(params.user);
+}
+
+static void _remove_empty_output(void)
+{
+	struct stat sb;
+
+	if (!params.output || (stat(params.output, &sb) == -1)) {
+		/*
+		 * Ignore the error as the file may have not been created yet.
+		 */
+		return;
+	}
+
+	/*
+	 * Remove the file if 0 size which means
+	 * the program failed somewhere along the
+	 * way and the file is just left hanging...
+	 */
+	if (!sb.st_size) {
+		info("Output file generated is empty, removing it: %s",
+		     params.output);
+		if (remove(params.output) == -1)
+			error("%s: remove(%s): %m", __func__, params.output);
+	}
+}
+
+static void _init_opts(void)
+{
+	memset(&params, 0, sizeof(sprofile_opts_t));
+	params.bucket = 1;
+	params.job_id = -1;
+	params.mode = SPROFILE_MODE_MERGE;
+	params.step_id = -1;
+}
+
+static int _set_options(const int argc, char **argv)
+{
+	int option_index = 0;
+	int cc;
+	log_options_t logopt = LOG_OPTS_STDERR_ONLY;
+	char *next_str = NULL;
+	uid_t u;
+
+	static struct option long_options[] = {
+		{"bucket", required_argument, 0, 'b'},
+		{"extract", no_argument, 0, 'E'},
+		{"item-extract", no_argument, 0, 'I'},
+		{"data", required_argument, 0, 'd'},
+		{"help", no_argument, 0, 'h'},
+		{"jobs", required_argument, 0, 'j'},
+		{"input", required_argument, 0, 'i'},
+		{"list", no_argument, 0, 'L'},
+		{"node", required_argument, 0, 'N'},
+		{"output", required_argument, 0, 'o'},
+		{"profiledir", required_argument, 0, 'p'},
+		{"series", required_argument, 0, 's'},
+		{"savefiles", no_argument, 0, 'S'},
+		{"usage", no_argument, 0, 'U'},
+		{"user", required_argument, 0, 'u'},
+		{"verbose", no_argument, 0, 'v'},
+		{"version", no_argument, 0, 'V'},
+		{0, 0, 0, 0}};
+
+	log_init(xbasename(argv[0]), logopt, 0, NULL);
+
+	_init_opts();
+
+	while ((cc = getopt_long(argc, argv, "b:d:Ehi:Ij:LN:o:p:s:Su:UvV",
+	                         long_options, &option_index)) != EOF) {
+		switch (cc) {
+		case 'b':
+			params.bucket = strtoul(optarg, &next_str, 10);
+			if (!params.bucket || next_str[0]) {
+				error("Bad value for --bucket=\"%s\"", optarg);
+				return -1;
+			}
+			break;
+		case 'd':
+			params.data_item = xstrdup(optarg);
+			break;
+		case 'E':
+			params.mode = SPROFILE_MODE_EXTRACT;
+			break;
+		case 'I':
+			params.mode = SPROFILE_MODE_ITEM_EXTRACT;
+			break;
+		case 'L':
+			params.mode = SPROFILE_MODE_ITEM_LIST;
+			break;
+		case 'h':
+			_help_msg();
+			return -1;
+			break;
+		case 'i':
+			params.input = xstrdup(optarg);
+			break;
+		case 'j':
+			params.job_id = strtol(optarg, &next_str, 10);
+			if (!xstrcmp(next_str, ".batch"))
+				params.step_id = (int) SLURM_BATCH_SCRIPT;
+			else if (next_str[0] == '.')
+				params.step_id =
+					strtol(next_str + 1, NULL, 10);
+			break;
+		case 'N':
+			params.node = xstrdup(optarg);
+			break;
+		case 'o':
+			params.output = xstrdup(optarg);
+			break;
+		case 'p':
+			params.dir = xstrdup(optarg);
+			break;
+		case 's':
+			if (xstrcmp(optarg, GRP_ENERGY)
+			    && xstrcmp(optarg, GRP_FILESYSTEM)
+			    && xstrcmp(optarg, GRP_NETWORK)
+			    && xstrncmp(optarg, GRP_TASK,
+					strlen(GRP_TASK))) {
+				error("Bad value for --series=\"%s\"",
+				      optarg);
+				return -1;
+			}
+			params.series = xstrdup(optarg);
+			break;
+		case 'S':
+			params.keepfiles = 1;
+			break;
+		case 'u':
+			if (uid_from_string(optarg, &u) < 0) {
+				error("No such user --uid=\"%s\"",
+				      optarg);
+				return -1;
+			}
+			params.user = uid_to_string(u);
+			break;
+		case 'U':
+			_help_msg();
+			return -1;
+			break;
+		case 'v':
+			params.verbose++;
+			break;
+		case 'V':
+			print_slurm_version();
+			return -1;
+			break;
+		case ':':
+		case '?': /* getopt() has explained it */
+			return -1;
+		}
+	}
+
+	if (params.verbose) {
+		logopt.stderr_level += params.verbose;
+		log_alter(logopt, SYSLOG_FACILITY_USER, NULL);
+	}
+
+	return 0;
+}
+
+static int _check_params(void)
+{
+	if (params.job_id == -1) {
+		error("JobID must be specified.");
+		return -1;
+	}
+
+	if (params.user == NULL)
+		params.user = uid_to_string(getuid());
+
+	if (params.mode == SPROFILE_MODE_MERGE) {
+		if (!params.dir)
+			acct_gather_profile_g_get(ACCT_GATHER_PROFILE_DIR,
+						  &params.dir);
+		if (!params.dir) {
+			error("Cannot read/parse acct_gather.conf");
+			return -1;
+		}
+	}
+
+	if (!params.input)
+		params.input = xstrdup_printf("./job_%d.%s", params.job_id,
+					      COLUMNAR_SUFFIX);
+
+	if (params.mode == SPROFILE_MODE_EXTRACT) {
+		if (!params.output)
+			params.output = xstrdup_printf(
+				"./extract_%d.csv", params.job_id);
+		if (!params.series)
+			fatal("Must specify series option --series");
+	}
+	if (params.mode == SPROFILE_MODE_ITEM_EXTRACT) {
+		if (!params.data_item)
+			fatal("Must specify data option --data ");
+
+		if (!params.series)
+			fatal("Must specify series option --series");
+
+		if (!params.output)
+			params.output = xstrdup_printf("./%s_%s_%d.csv",
+			                               params.series,
+			                               params.data_item,
+			                               params.job_id);
+	}
+
+	if (!params.output && (params.mode == SPROFILE_MODE_MERGE))
+		params.output = xstrdup_printf("./job_%d.%s", params.job_id,
+					       COLUMNAR_SUFFIX);
+
+	return 0;
+}
+
+static void _step_str(uint32_t step_id, char *buf, size_t size)
+{
+	if (step_id == SLURM_BATCH_SCRIPT)
+		snprintf(buf, size, "batch");
+	else
+		snprintf(buf, size, "%u", step_id);
+}
+
+static bool _step_match(columnar_node_t *node)
+{
+	return (params.step_id == -1) ||
+		(node->step_id == (uint32_t) params.step_id);
+}
+
+/* Does the dataset belong to the series requested with --series */
+static bool _series_match(columnar_dataset_t *ds)
+{
+	char *series;
+	bool match;
+
+	if (!params.series)
+		return true;
+
+	series = columnar_series_name(ds);
+	if (!xstrcmp(params.series, GRP_TASK))
+		match = !xstrncmp(series, GRP_TASK "_",
+				  strlen(GRP_TASK "_"));
+	else
+		match = !xstrcmp(series, params.series);
+	xfree(series);
+
+	return match;
+}
+
+/*
+ * Append every record of a node-step file to the job file. Records are
+ * validated while being read but copied verbatim, so only one record is
+ * ever held in memory no matter how large the file is.
+ */
+static int _merge_node_step_data(char *file_name, int fd)
+{
+	columnar_reader_t *reader;
+	int rc, nodes = 0;
+
+	if (!(reader = columnar_reader_open(file_name, 0)))
+		return SLURM_ERROR;
+
+	while ((rc = columnar_reader_next(reader)) > 0) {
+		if ((rc == COLUMNAR_REC_NODE) && (++nodes > 1)) {
+			error("%s holds more than one node, not a node-step file",
+			      file_name);
+			rc = SLURM_ERROR;
+			break;
+		}
+		if (columnar_reader_copy(reader, fd)) {
+			error("Failed to write to %s: %m", params.output);
+			rc = SLURM_ERROR;
+			break;
+		}
+	}
+	columnar_reader_close(reader);
+
+	if (rc < 0) {
+		error("Failed to merge %s", file_name);
+		return SLURM_ERROR;
+	}
+
+	if (!params.keepfiles && (remove(file_name) == -1))
+		error("%s: remove(%s): %m", __func__, file_name);
+
+	return SLURM_SUCCESS;
+}
+
+/* Look for step and node files and merge them together into one job file */
+static int _merge_step_files(void)
+{
+	DIR *dir;
+	struct dirent *de;
+	char *file_name = NULL, *pos_char, *step_dir, *step_path, *stepno;
+	int fd = -1, job_id, rc = SLURM_SUCCESS, step_cnt = 0;
+	int last_step = -1, node_cnt = 0;
+	ListIterator itr;
+	List file_list = NULL;
+	sprofile_file_t *sprofile_file;
+
+	step_dir = xstrdup_printf("%s/%s", params.dir, params.user);
+
+	if (!(dir = opendir(step_dir))) {
+		error("Cannot open %s job profile directory: %m",
+		      step_dir);
+		rc = -1;
+		goto endit;
+	}
+
+	while ((de = readdir(dir))) {
+		xfree(file_name);
+		file_name = xstrdup(de->d_name);
+
+		if (file_name[0] == '.')
+			continue;
+
+		pos_char = strstr(file_name, "." COLUMNAR_SUFFIX);
+		if (!pos_char || pos_char[strlen("." COLUMNAR_SUFFIX)])
+			continue;
+		*pos_char = 0;
+
+		pos_char = strchr(file_name, '_');
+		if (!pos_char)
+			continue;
+		*pos_char = 0;
+
+		job_id = strtol(file_name, NULL, 10);
+		if (job_id != params.job_id)
+			continue;
+
+		stepno = pos_char + 1;
+		pos_char = strchr(stepno, '_');
+		if (!pos_char)
+			continue;
+		*pos_char = 0;
+
+		sprofile_file = xmalloc(sizeof(sprofile_file_t));
+		if (!xstrcmp(stepno, "batch"))
+			sprofile_file->step_id = (int) SLURM_BATCH_SCRIPT;
+		else
+			sprofile_file->step_id = strtol(stepno, NULL, 10);
+
+		if ((params.step_id != -1) &&
+		    (sprofile_file->step_id != params.step_id)) {
+			xfree(sprofile_file);
+			continue;
+		}
+
+		sprofile_file->file_name = xstrdup_printf("%s/%s", step_dir,
+							  de->d_name);
+		sprofile_file->node_name = xstrdup(pos_char + 1);
+
+		if (!file_list)
+			file_list = list_create(_destroy_sprofile_file);
+		list_append(file_list, sprofile_file);
+	}
+	closedir(dir);
+
+	if (!file_list || !list_count(file_list)) {
+		info("No node-step files found for jobid %d", params.job_id);
+		goto endit;
+	}
+
+	if ((fd = open(params.output, O_CREAT | O_WRONLY | O_TRUNC | O_CLOEXEC,
+		       0600)) < 0) {
+		error("Failed create profile file %s: %m", params.output);
+		rc = -1;
+		goto endit;
+	}
+	if (columnar_write_header(fd)) {
+		error("Failed to write to %s: %m", params.output);
+		rc = -1;
+		goto endit;
+	}
+
+	/* sort the files so they are in step order */
+	list_sort(file_list, (ListCmpF) _sprofile_sort_files);
+
+	itr = list_iterator_create(file_list);
+	while ((sprofile_file = list_next(itr))) {
+		if (sprofile_file->step_id != last_step) {
+			if (step_cnt)
+				debug("Merged %d node files of step %d",
+				      node_cnt, last_step);
+			last_step = sprofile_file->step_id;
+			step_cnt++;
+			node_cnt = 0;
+		}
+
+		step_path = sprofile_file->file_name;
+		if (_merge_node_step_data(step_path, fd) == SLURM_SUCCESS)
+			node_cnt++;
+		else
+			rc = -1;
+	}
+	list_iterator_destroy(itr);
+	debug("Merged %d node files of step %d", node_cnt, last_step);
+
+endit:
+	if ((fd >= 0) && (close(fd) < 0)) {
+		error("Failed to close %s: %m", params.output);
+		rc = -1;
+	}
+	FREE_NULL_LIST(file_list);
+	xfree(file_name);
+	xfree(step_dir);
+
+	return rc;
+}
+
+/* ============================================================================
+ * ============================================================================
+ * Functions for data extraction
+ * ============================================================================
+ * ========================================================================= */
+
+static void _print_value(FILE *output, columnar_dataset_t *ds, uint32_t field,
+			 uint64_t value)
+{
+	if (ds->field_types[field] == PROFILE_FIELD_DOUBLE)
+		fprintf(output, ",%lf", columnar_get_double(value));
+	else
+		fprintf(output, ",%"PRIu64, value);
+}
+
+static int _extract_chunk(columnar_reader_t *reader, FILE *output)
+{
+	columnar_node_t *node = columnar_reader_node(reader);
+	columnar_dataset_t *ds = columnar_reader_dataset(reader, -1);
+	uint32_t rows = columnar_reader_rows(reader);
+	uint64_t *time, **columns;
+	char step[32], *series;
+	int rc = SLURM_SUCCESS;
+
+	time = xcalloc(rows, sizeof(uint64_t));
+	columns = xcalloc(ds->field_cnt, sizeof(uint64_t *));
+	if (columnar_reader_time(reader, time))
+		rc = SLURM_ERROR;
+	for (uint32_t i = 0; (rc == SLURM_SUCCESS) && (i < ds->field_cnt);
+	     i++) {
+		columns[i] = xcalloc(rows, sizeof(uint64_t));
+		if (columnar_reader_column(reader, i, columns[i]))
+			rc = SLURM_ERROR;
+	}
+
+	if (rc == SLURM_SUCCESS) {
+		_step_str(node->step_id, step, sizeof(step));
+		series = columnar_series_name(ds);
+		for (uint32_t r = 0; r < rows; r++) {
+			fprintf(output, "%s,%s,%s,%"PRIu64",%"PRIu64, step,
+				node->node_name, series,
+				time[r] - node->start_time, time[r]);
+			for (uint32_t i = 0; i < ds->field_cnt; i++)
+				_print_value(output, ds, i, columns[i][r]);
+			fputc('\n', output);
+		}
+		xfree(series);
+	}
+
+	for (uint32_t i = 0; i < ds->field_cnt; i++)
+		xfree(columns[i]);
+	xfree(columns);
+	xfree(time);
+
+	return rc;
+}
+
+/*
+ * Stream the job file once, decoding only the chunks of the requested
+ * step, node and series.
+ */
+static int _extract_series(void)
+{
+	columnar_reader_t *reader = NULL;
+	columnar_node_t *node = NULL;
+	columnar_dataset_t *ds;
+	FILE *output = NULL;
+	bool header = false, skip_node = true;
+	int rc = SLURM_ERROR, type;
+
+	if (!(reader = columnar_reader_open(params.input, 0)))
+		goto error;
+
+	if (!(output = fopen(params.output, "w"))) {
+		error("Failed to create output file %s -- %m",
+		      params.output);
+		goto error;
+	}
+
+	while ((type = columnar_reader_next(reader)) > 0) {
+		switch (type) {
+		case COLUMNAR_REC_NODE:
+			node = columnar_reader_node(reader);
+			skip_node = !_step_match(node) ||
+				(params.node &&
+				 xstrcmp(params.node, node->node_name));
+			/* Nothing to decode until the next node section */
+			columnar_reader_filter(reader, skip_node ?
+					       SKIP_ALL_CHUNKS : -1);
+			break;
+		case COLUMNAR_REC_CHUNK:
+			ds = columnar_reader_dataset(reader, -1);
+			if (skip_node || !_series_match(ds))
+				break;
+			if (!header) {
+				fprintf(output, "Step,Node,Series,"
+					"ElapsedTime,EpochTime");
+				for (uint32_t i = 0; i < ds->field_cnt; i++)
+					fprintf(output, ",%s",
+						ds->field_names[i]);
+				fputc('\n', output);
+				header = true;
+			}
+			if (_extract_chunk(reader, output)) {
+				error("Failed to decode a chunk of %s on %s",
+				      ds->name, node->node_name);
+				goto error;
+			}
+			break;
+		default:
+			break;
+		}
+	}
+	if (type < 0) {
+		error("Failed to read %s", params.input);
+		goto error;
+	}
+
+	rc = SLURM_SUCCESS;
+
+error:
+	columnar_reader_close(reader);
+	if (output)
+		fclose(output);
+	return rc;
+}
+
+/* ============================================================================
+ * ============================================================================
+ * Functions for data item extraction
+ * ============================================================================
+ * ========================================================================= */
+
+static void _cursor_free(void *x)
+{
+	cursor_t *cursor = x;
+
+	columnar_reader_close(cursor->reader);
+	xfree(cursor->label);
+	xfree(cursor->time);
+	xfree(cursor->value);
+	xfree(cursor);
+}
+
+/*
+ * Move the cursor to its next sample, decoding the next chunk of its
+ * dataset when the current one is exhausted.
+ * RET false once the node section has no more samples
+ */
+static bool _cursor_next(cursor_t *cursor)
+{
+	int type;
+
+	if (++cursor->row < cursor->rows)
+		return true;
+
+	while ((type = columnar_reader_next(cursor->reader)) > 0) {
+		/* The cursor starts on its own NODE record */
+		if ((type == COLUMNAR_REC_NODE) && (++cursor->node_recs > 1))
+			return false;
+		if (type != COLUMNAR_REC_CHUNK)
+			continue;
+
+		cursor->rows = columnar_reader_rows(cursor->reader);
+		cursor->row = 0;
+		xrecalloc(cursor->time, cursor->rows, sizeof(uint64_t));
+		xrecalloc(cursor->value, cursor->rows, sizeof(uint64_t));
+		if (columnar_reader_time(cursor->reader, cursor->time) ||
+		    columnar_reader_column(cursor->reader, cursor->field,
+					   cursor->value)) {
+			error("Failed to decode a chunk of %s", cursor->label);
+			return false;
+		}
+		if (cursor->rows)
+			return true;
+	}
+
+	return false;
+}
+
+static uint64_t _cursor_time(cursor_t *cursor)
+{
+	return cursor->time[cursor->row];
+}
+
+/* Binary min-heap of cursors ordered by the time of their current sample */
+static void _heap_push(cursor_t **heap, int *cnt, cursor_t *cursor)
+{
+	int i = (*cnt)++;
+
+	while (i) {
+		int parent = (i - 1) / 2;
+
+		if (_cursor_time(heap[parent]) <= _cursor_time(cursor))
+			break;
+		heap[i] = heap[parent];
+		i = parent;
+	}
+	heap[i] = cursor;
+}
+
+static cursor_t *_heap_pop(cursor_t **heap, int *cnt)
+{
+	cursor_t *top = heap[0], *last = heap[--(*cnt)];
+	int i = 0;
+
+	while (true) {
+		int child = (2 * i) + 1;
+
+		if (child >= *cnt)
+			break;
+		if (((child + 1) < *cnt) &&
+		    (_cursor_time(heap[child + 1]) < _cursor_time(heap[child])))
+			child++;
+		if (_cursor_time(last) <= _cursor_time(heap[child]))
+			break;
+		heap[i] = heap[child];
+		i = child;
+	}
+	if (*cnt)
+		heap[i] = last;
+
+	return top;
+}
+
+static int _find_step(void *x, void *key)
+{
+	return *(uint32_t *) x == *(uint32_t *) key;
+}
+
+static int _find_field(columnar_dataset_t *ds, const char *name)
+{
+	for (uint32_t i = 0; i < ds->field_cnt; i++) {
+		if (!xstrcasecmp(ds->field_names[i], name))
+			return i;
+	}
+
+	return -1;
+}
+
+/*
+ * Walk the record headers of the job file, without reading any chunk, and
+ * create one cursor per dataset of the requested series. The cursors
+ * start on the NODE record of their section, only read the chunks of their
+ * own dataset and all share the file descriptor of the index reader.
+ */
+static int _create_cursors(columnar_reader_t *index, List cursors,
+			   List steps, bool *is_double)
+{
+	columnar_dataset_t *ds;
+	columnar_node_t *node = NULL;
+	off_t section = 0;
+	int field, type;
+	bool have_type = false;
+
+	columnar_reader_filter(index, SKIP_ALL_CHUNKS);
+	while ((type = columnar_reader_next(index)) > 0) {
+		cursor_t *cursor;
+
+		if (type == COLUMNAR_REC_NODE) {
+			node = columnar_reader_node(index);
+			section = columnar_reader_offset(index);
+			continue;
+		}
+		if ((type != COLUMNAR_REC_DATASET) || !_step_match(node) ||
+		    (params.node && xstrcmp(params.node, node->node_name)))
+			continue;
+
+		ds = columnar_reader_dataset(index, -1);
+		if (!_series_match(ds))
+			continue;
+		if ((field = _find_field(ds, params.data_item)) < 0) {
+			debug("No data item %s in %s on %s",
+			      params.data_item, ds->name, node->node_name);
+			continue;
+		}
+		if (!have_type) {
+			*is_double = (ds->field_types[field] ==
+				      PROFILE_FIELD_DOUBLE);
+			have_type = true;
+		} else if (*is_double != (ds->field_types[field] ==
+					  PROFILE_FIELD_DOUBLE)) {
+			error("Data item %s has different types in %s",
+			      params.data_item, params.series);
+			return SLURM_ERROR;
+		}
+
+		cursor = xmalloc(sizeof(*cursor));
+		cursor->field = field;
+		if (!xstrcmp(params.series, GRP_TASK))
+			cursor->label = xstrdup_printf("%s %s_%s",
+						       node->node_name,
+						       GRP_TASK, ds->name);
+		else
+			cursor->label = xstrdup(node->node_name);
+		cursor->reader = columnar_reader_clone(index, section);
+		columnar_reader_filter(cursor->reader, ds->id);
+		cursor->start_time = node->start_time;
+		cursor->step_id = node->step_id;
+		list_append(cursors, cursor);
+
+		if (!list_find_first(steps, _find_step, &node->step_id)) {
+			uint32_t *step_id = xmalloc(sizeof(*step_id));
+			*step_id = node->step_id;
+			list_append(steps, step_id);
+		}
+	}
+
+	return (type < 0) ? SLURM_ERROR : SLURM_SUCCESS;
+}
+
+/*
+ * Aggregate the item over all the series of one step. The cursors are
+ * merged by time with a heap so that only one decoded chunk per series is
+ * held in memory, and the samples of the different nodes falling in the
+ * same --bucket wide time window are aggregated together.
+ */
+static void _item_analysis(List cursors, uint32_t step_id, bool is_double,
+			   FILE *output)
+{
+	ListIterator itr;
+	cursor_t *cursor, **heap, **in_bucket;
+	int heap_cnt = 0, bucket_cnt;
+	time_t start_time = 0;
+	uint64_t bucket, bucket_max = 0;
+	double sum_max = 0, avg_max = 0;
+	char step[32];
+
+	_step_str(step_id, step, sizeof(step));
+
+	heap = xcalloc(list_count(cursors), sizeof(cursor_t *));
+	in_bucket = xcalloc(list_count(cursors), sizeof(cursor_t *));
+
+	itr = list_iterator_create(cursors);
+	while ((cursor = list_next(itr))) {
+		if (cursor->step_id != step_id)
+			continue;
+		if (!start_time || (cursor->start_time < start_time))
+			start_time = cursor->start_time;
+		if (_cursor_next(cursor))
+			_heap_push(heap, &heap_cnt, cursor);
+	}
+	list_iterator_destroy(itr);
+
+	while (heap_cnt) {
+		cursor_t *min = NULL, *max = NULL;
+		double sum = 0, avg;
+
+		/* Buckets are aligned on the start of the step */
+		bucket = _cursor_time(heap[0]);
+		if (bucket > start_time)
+			bucket -= (bucket - start_time) % params.bucket;
+		bucket_cnt = 0;
+
+		/* Keep the last sample of each series in this bucket */
+		while (heap_cnt &&
+		       (_cursor_time(heap[0]) < (bucket + params.bucket))) {
+			cursor = _heap_pop(heap, &heap_cnt);
+			if (!cursor->in_bucket) {
+				cursor->in_bucket = true;
+				in_bucket[bucket_cnt++] = cursor;
+			}
+			cursor->bucket_val = cursor->value[cursor->row];
+			if (_cursor_next(cursor))
+				_heap_push(heap, &heap_cnt, cursor);
+		}
+
+		for (int i = 0; i < bucket_cnt; i++) {
+			double v;
+
+			cursor = in_bucket[i];
+			cursor->in_bucket = false;
+			if (is_double)
+				v = columnar_get_double(cursor->bucket_val);
+			else
+				v = cursor->bucket_val;
+			sum += v;
+			if (!min || (v < (is_double ?
+					  columnar_get_double(min->bucket_val) :
+					  min->bucket_val)))
+				min = cursor;
+			if (!max || (v > (is_double ?
+					  columnar_get_double(max->bucket_val) :
+					  max->bucket_val)))
+				max = cursor;
+		}
+		avg = sum / bucket_cnt;
+
+		if (sum > sum_max) {
+			sum_max = sum;
+			avg_max = avg;
+			bucket_max = bucket - start_time;
+		}
+
+		fprintf(output, "%s,%"PRIu64",%"PRIu64",%s", step,
+			bucket - start_time, bucket, min->label);
+		if (is_double)
+			fprintf(output, ",%lf,%s,%lf,%lf",
+				columnar_get_double(min->bucket_val),
+				max->label,
+				columnar_get_double(max->bucket_val), sum);
+		else
+			fprintf(output, ",%"PRIu64",%s,%"PRIu64",%.0lf",
+				min->bucket_val, max->label, max->bucket_val,
+				sum);
+		fprintf(output, ",%lf,%d\n", avg, bucket_cnt);
+	}
+
+	printf("    Step %s Maximum accumulated %s Value (%lf) occurred "
+	       "at Time=%"PRIu64", Ave Node %lf\n",
+	       step, params.data_item, sum_max, bucket_max, avg_max);
+
+	xfree(in_bucket);
+	xfree(heap);
+}
+
+static int _extract_item(void)
+{
+	columnar_reader_t *index;
+	List cursors = NULL, steps = NULL;
+	ListIterator itr;
+	FILE *output = NULL;
+	bool is_double = false;
+	uint32_t *step_id;
+	int rc = SLURM_ERROR;
+
+	if (!(index = columnar_reader_open(params.input, 0)))
+		return SLURM_ERROR;
+
+	/*
+	 * One cursor per node and task, all sharing the descriptor of the
+	 * index so large jobs do not need a raised open files limit.
+	 */
+	cursors = list_create(_cursor_free);
+	steps = list_create(xfree_ptr);
+	if (_create_cursors(index, cursors, steps, &is_double)) {
+		error("Failed to read %s", params.input);
+		goto error;
+	}
+	if (!list_count(cursors)) {
+		error("No data item %s found in series %s",
+		      params.data_item, params.series);
+		goto error;
+	}
+
+	if (!(output = fopen(params.output, "w"))) {
+		error("Failed to create output file %s -- %m",
+		      params.output);
+		goto error;
+	}
+
+	fprintf(output, "Step,ElapsedTime,EpochTime,Min Node,Min,"
+		"Max Node,Max,Sum,Avg,Num Series\n");
+
+	itr = list_iterator_create(steps);
+	while ((step_id = list_next(itr)))
+		_item_analysis(cursors, *step_id, is_double, output);
+	list_iterator_destroy(itr);
+
+	rc = SLURM_SUCCESS;
+
+error:
+	/* The cursors use the file descriptor of the index reader */
+	FREE_NULL_LIST(cursors);
+	FREE_NULL_LIST(steps);
+	columnar_reader_close(index);
+	if (output)
+		fclose(output);
+	return rc;
+}
+
+/* ============================================================================
+ * ============================================================================
+ * Functions for listing the items of a series
+ * ============================================================================
+ * ========================================================================= */
+
+static int _list_items(void)
+{
+	columnar_reader_t *reader;
+	columnar_dataset_t *ds;
+	List seen;
+	char *series;
+	int type;
+
+	if (!(reader = columnar_reader_open(params.input, 0)))
+		return SLURM_ERROR;
+
+	/* Datasets are all declared in the record headers */
+	columnar_reader_filter(reader, SKIP_ALL_CHUNKS);
+	seen = list_create(xfree_ptr);
+
+	while ((type = columnar_reader_next(reader)) > 0) {
+		if (type != COLUMNAR_REC_DATASET)
+			continue;
+		ds = columnar_reader_dataset(reader, -1);
+		if (!_series_match(ds))
+			continue;
+
+		/* All the task datasets share the same items */
+		series = columnar_series_name(ds);
+		if (!xstrncmp(series, GRP_TASK "_", strlen(GRP_TASK "_"))) {
+			xfree(series);
+			series = xstrdup(GRP_TASK);
+		}
+		if (list_find_first(seen, slurm_find_char_in_list,
+				    series)) {
+			xfree(series);
+			continue;
+		}
+		list_append(seen, series);
+
+		printf("%s\n", series);
+		for (uint32_t i = 0; i < ds->field_cnt; i++)
+			printf("    %s\n", ds->field_names[i]);
+	}
+
+	FREE_NULL_LIST(seen);
+	columnar_reader_close(reader);
+
+	return (type < 0) ? SLURM_ERROR : SLURM_SUCCESS;
+}
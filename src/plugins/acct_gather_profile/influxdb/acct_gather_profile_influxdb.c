@@ -45,8 +45,12 @@
  *  Copyright (C) 2002 The Regents of the University of California.
  \*****************************************************************************/
 
+#include "config.h"
+
+#include <dirent.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <sys/file.h>
 #include <sys/types.h>
 #include <sys/un.h>
 #include <sys/stat.h>
@@ -56,9 +60,13 @@
 #include <unistd.h>
 #include <math.h>
 #include <curl/curl.h>
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
 
 #include "src/common/slurm_xlator.h"
 #include "src/common/fd.h"
+#include "src/common/list.h"
 #include "src/common/slurm_acct_gather_profile.h"
 #include "src/common/slurm_protocol_api.h"
 #include "src/common/slurm_protocol_defs.h"
@@ -96,12 +104,29 @@ const char plugin_name[] = "AcctGatherProfile influxdb plugin";
 const char plugin_type[] = "acct_gather_profile/influxdb";
 const uint32_t plugin_version = SLURM_VERSION_NUMBER;
 
+/* Flush a partially filled batch after this many seconds */
+#define DEFAULT_INFLUXDB_FREQ 30
+/* Give up on a request after this many seconds */
+#define DEFAULT_INFLUXDB_TIMEOUT 10
+/* Queue a batch for sending once it holds this many bytes */
+#define BATCH_SIZE (64 * 1024)
+/* Batches waiting to be sent, older ones are spooled to disk */
+#define MAX_QUEUED_BATCHES 16
+/* Maximum delay in seconds between two attempts when InfluxDB is down */
+#define MAX_RETRY_DELAY 60
+
+#define SPOOL_PREFIX "influxdb."
+#define SPOOL_SUFFIX ".spool"
+
 typedef struct {
 	char *host;
 	char *database;
 	uint32_t def;
+	uint32_t freq;
 	char *password;
 	char *rt_policy;
+	char *spool_dir;
+	uint32_t timeout;
 	char *username;
 } slurm_influxdb_conf_t;
 
@@ -123,17 +148,54 @@ union data_t{
 	double	 d;
 };
 
+/* Line protocol batch ready to be sent */
+typedef struct {
+	char *data;
+	size_t len;
+} batch_t;
+
+/* Spool file holding batches which could not be sent */
+typedef struct {
+	int fd;
+	off_t offset;	/* data before offset has already been sent */
+	char *path;
+} spool_t;
+
 static slurm_influxdb_conf_t influxdb_conf;
 static uint32_t g_profile_running = ACCT_GATHER_PROFILE_NOT_SET;
 static stepd_step_rec_t *g_job = NULL;
 
-static char *datastr = NULL;
-static int datastrlen = 0;
-
 static table_t *tables = NULL;
 static size_t tables_max_len = 0;
 static size_t tables_cur_len = 0;
 
+/*
+ * Samples are formatted into the 'datastr' batch from the sampling path.
+ * Full batches are moved to 'queue' and sent by send_thread, so a slow or
+ * unreachable InfluxDB never blocks the threads gathering the samples.
+ * Everything below is protected by send_lock.
+ */
+static pthread_mutex_t send_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t send_cond = PTHREAD_COND_INITIALIZER;
+static pthread_t send_thread = 0;
+static bool send_shutdown = false;
+
+static char *datastr = NULL;
+static char *datastr_pos = NULL;
+static time_t datastr_time = 0;
+
+static batch_t queue[MAX_QUEUED_BATCHES];
+static int queue_cnt = 0;
+static int queue_head = 0;
+
+static spool_t *spool = NULL;
+static bool spool_pending = false;
+
+/* Only used by send_thread, or after it has been joined */
+static CURL *curl_handle = NULL;
+static int error_cnt = 0;
+static List orphan_spools = NULL;
+
 static void _free_tables(void)
 {
 	int i, j;
@@ -189,53 +251,71 @@ static size_t _write_callback(void *contents, size_t size, size_t nmemb,
 	return realsize;
 }
 
-/* Try to send data to influxdb */
-static int _send_data(const char *data)
+#ifdef HAVE_ZLIB
+/* Return a gzip copy of data, or NULL to send it uncompressed */
+static char *_compress(const char *data, size_t len, size_t *out_len)
+{
+	z_stream strm = { 0 };
+	char *out;
+	size_t size;
+
+	if (deflateInit2(&strm, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+			 (MAX_WBITS + 16), 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+		error("%s %s: deflateInit2 failed", plugin_type, __func__);
+		return NULL;
+	}
+
+	size = deflateBound(&strm, len);
+	out = xmalloc_nz(size);
+	strm.next_in = (Bytef *) data;
+	strm.avail_in = len;
+	strm.next_out = (Bytef *) out;
+	strm.avail_out = size;
+
+	if (deflate(&strm, Z_FINISH) != Z_STREAM_END) {
+		error("%s %s: deflate failed", plugin_type, __func__);
+		xfree(out);
+	} else
+		*out_len = strm.total_out;
+
+	deflateEnd(&strm);
+	return out;
+}
+#endif
+
+/*
+ * Try to send data to influxdb.
+ * RET SLURM_SUCCESS if the data does not need to be sent again
+ */
+static int _send_data(const char *data, size_t len)
 {
-	CURL *curl_handle = NULL;
 	CURLcode res;
+	struct curl_slist *headers = NULL;
 	struct http_response chunk;
 	int rc = SLURM_SUCCESS;
 	long response_code;
-	static int error_cnt = 0;
-	char *url = NULL;
-	size_t length;
+	char *url = NULL, *payload = NULL;
+	size_t payload_len = 0;
 
 	debug3("%s %s called", plugin_type, __func__);
 
-	/*
-	 * Every compute node which is sampling data will try to establish a
-	 * different connection to the influxdb server. In order to reduce the
-	 * number of connections, every time a new sampled data comes in, it
-	 * is saved in the 'datastr' buffer. Once this buffer is full, then we
-	 * try to open the connection and send this buffer, instead of opening
-	 * one per sample.
-	 */
-	if (data && ((datastrlen + strlen(data)) <= BUF_SIZE)) {
-		xstrcat(datastr, data);
-		length = strlen(data);
-		datastrlen += length;
-		log_flag(PROFILE, "%s %s: %zu bytes of data added to buffer. New buffer size: %d",
-			 plugin_type, __func__, length, datastrlen);
-		return rc;
-	}
-
 	DEF_TIMERS;
 	START_TIMER;
 
-	if (curl_global_init(CURL_GLOBAL_ALL) != 0) {
-		error("%s %s: curl_global_init: %m", plugin_type, __func__);
-		rc = SLURM_ERROR;
-		goto cleanup_global_init;
-	} else if ((curl_handle = curl_easy_init()) == NULL) {
+	/* Reuse the connection to InfluxDB between batches */
+	if (!curl_handle && !(curl_handle = curl_easy_init())) {
 		error("%s %s: curl_easy_init: %m", plugin_type, __func__);
-		rc = SLURM_ERROR;
-		goto cleanup_easy_init;
+		return SLURM_ERROR;
 	}
+	curl_easy_reset(curl_handle);
 
 	xstrfmtcat(url, "%s/write?db=%s&rp=%s&precision=s", influxdb_conf.host,
 		   influxdb_conf.database, influxdb_conf.rt_policy);
 
+#ifdef HAVE_ZLIB
+	payload = _compress(data, len, &payload_len);
+#endif
+
 	chunk.message = xmalloc(1);
 	chunk.size = 0;
 
@@ -244,17 +324,32 @@ static int _send_data(const char *data)
 		curl_easy_setopt(curl_handle, CURLOPT_PASSWORD,
 				 influxdb_conf.password);
 	curl_easy_setopt(curl_handle, CURLOPT_POST, 1);
-	curl_easy_setopt(curl_handle, CURLOPT_POSTFIELDS, datastr);
-	curl_easy_setopt(curl_handle, CURLOPT_POSTFIELDSIZE, strlen(datastr));
+	/* Do not wait for "100 Continue" before sending the batch */
+	headers = curl_slist_append(headers, "Expect:");
+	if (payload) {
+		headers = curl_slist_append(headers,
+					    "Content-Encoding: gzip");
+		curl_easy_setopt(curl_handle, CURLOPT_POSTFIELDS, payload);
+		curl_easy_setopt(curl_handle, CURLOPT_POSTFIELDSIZE,
+				 (long) payload_len);
+	} else {
+		curl_easy_setopt(curl_handle, CURLOPT_POSTFIELDS, data);
+		curl_easy_setopt(curl_handle, CURLOPT_POSTFIELDSIZE,
+				 (long) len);
+	}
+	curl_easy_setopt(curl_handle, CURLOPT_HTTPHEADER, headers);
 	if (influxdb_conf.username)
 		curl_easy_setopt(curl_handle, CURLOPT_USERNAME,
 				 influxdb_conf.username);
+	curl_easy_setopt(curl_handle, CURLOPT_NOSIGNAL, 1L);
+	curl_easy_setopt(curl_handle, CURLOPT_TIMEOUT,
+			 (long) influxdb_conf.timeout);
 	curl_easy_setopt(curl_handle, CURLOPT_WRITEFUNCTION, _write_callback);
 	curl_easy_setopt(curl_handle, CURLOPT_WRITEDATA, (void *) &chunk);
 
 	if ((res = curl_easy_perform(curl_handle)) != CURLE_OK) {
 		if ((error_cnt++ % 100) == 0)
-			error("%s %s: curl_easy_perform failed to send data (discarded). Reason: %s",
+			error("%s %s: curl_easy_perform failed to send data (will retry). Reason: %s",
 			      plugin_type, __func__, curl_easy_strerror(res));
 		rc = SLURM_ERROR;
 		goto cleanup;
@@ -279,41 +374,450 @@ static int _send_data(const char *data)
 		if (error_cnt > 0)
 			error_cnt = 0;
 	} else {
-		rc = SLURM_ERROR;
-		debug2("%s %s: data write failed, response code: %ld",
-		       plugin_type, __func__, response_code);
-		if (slurm_conf.debug_flags & DEBUG_FLAG_PROFILE) {
+		/*
+		 * InfluxDB will never accept a batch it could not parse, so
+		 * only retry the others.
+		 */
+		if (response_code == 400)
+			error("%s %s: data write failed (discarded), response code: %ld",
+			      plugin_type, __func__, response_code);
+		else {
+			rc = SLURM_ERROR;
+			debug2("%s %s: data write failed, response code: %ld",
+			       plugin_type, __func__, response_code);
+		}
+		if ((slurm_conf.debug_flags & DEBUG_FLAG_PROFILE) &&
+		    chunk.size) {
 			/* Strip any trailing newlines. */
-			while (chunk.message[strlen(chunk.message) - 1] == '\n')
-				chunk.message[strlen(chunk.message) - 1] = '\0';
+			while (chunk.size &&
+			       (chunk.message[chunk.size - 1] == '\n'))
+				chunk.message[--chunk.size] = '\0';
 			info("%s %s: JSON response body: %s", plugin_type,
 			     __func__, chunk.message);
 		}
 	}
 
 cleanup:
+	curl_slist_free_all(headers);
 	xfree(chunk.message);
+	xfree(payload);
 	xfree(url);
-cleanup_easy_init:
-	curl_easy_cleanup(curl_handle);
-cleanup_global_init:
-	curl_global_cleanup();
 
 	END_TIMER;
-	log_flag(PROFILE, "%s %s: took %s to send data",
-		 plugin_type, __func__, TIME_STR);
+	log_flag(PROFILE, "%s %s: took %s to send %zu bytes of data (%zu compressed)",
+		 plugin_type, __func__, TIME_STR, len, payload_len);
+
+	return rc;
+}
+
+/* Create this step's spool file. Call with send_lock held. */
+static int _spool_open(void)
+{
+	struct stat st;
+	int fd, retry;
+	char *path = NULL;
+
+	for (retry = 0; retry < 5; retry++) {
+		xfree(path);
+		path = xstrdup_printf("%s/%s%u.%u.%d.%d%s",
+				      influxdb_conf.spool_dir, SPOOL_PREFIX,
+				      g_job->step_id.job_id,
+				      g_job->step_id.step_id, (int) getpid(),
+				      retry, SPOOL_SUFFIX);
+		if ((fd = open(path, O_RDWR | O_CREAT | O_EXCL | O_APPEND |
+			       O_CLOEXEC, 0600)) < 0) {
+			if (errno == EEXIST)
+				continue;
+			error("%s %s: open(%s): %m",
+			      plugin_type, __func__, path);
+			break;
+		}
 
-	if (data) {
-		datastr = xstrdup(data);
-		datastrlen = strlen(data);
+		/*
+		 * The lock marks the file as owned by a running step. Another
+		 * step may have found the file before the lock was taken and
+		 * removed it as an empty orphan, so check it is still linked.
+		 */
+		if (flock(fd, LOCK_EX) || fstat(fd, &st)) {
+			error("%s %s: flock(%s): %m",
+			      plugin_type, __func__, path);
+			close(fd);
+			break;
+		}
+		if (!st.st_nlink) {
+			close(fd);
+			continue;
+		}
+
+		spool = xmalloc(sizeof(*spool));
+		spool->fd = fd;
+		spool->path = path;
+		log_flag(PROFILE, "%s %s: spooling data to %s",
+			 plugin_type, __func__, path);
+		return SLURM_SUCCESS;
+	}
+
+	xfree(path);
+	return SLURM_ERROR;
+}
+
+static void _spool_free(void *x)
+{
+	spool_t *sp = x;
+
+	if (!sp)
+		return;
+	if (sp->fd >= 0)
+		close(sp->fd);
+	xfree(sp->path);
+	xfree(sp);
+}
+
+/*
+ * Write a batch which could not be queued or sent to the spool file, or
+ * discard it if there is none. Call with send_lock held.
+ */
+static void _spill_batch(batch_t *batch)
+{
+	if (!influxdb_conf.spool_dir) {
+		if ((error_cnt++ % 100) == 0)
+			error("%s %s: InfluxDB is not keeping up, %zu bytes of data discarded",
+			      plugin_type, __func__, batch->len);
+	} else if (!spool && _spool_open()) {
+		error("%s %s: %zu bytes of data discarded",
+		      plugin_type, __func__, batch->len);
 	} else {
-		datastr[0] = '\0';
-		datastrlen = 0;
+		safe_write(spool->fd, batch->data, batch->len);
+		spool_pending = true;
+	}
+
+	xfree(batch->data);
+	batch->len = 0;
+	return;
+
+rwfail:
+	error("%s %s: write(%s): %m, %zu bytes of data discarded",
+	      plugin_type, __func__, spool->path, batch->len);
+	xfree(batch->data);
+	batch->len = 0;
+}
+
+/* Move the current batch to the send queue. Call with send_lock held. */
+static void _queue_batch(void)
+{
+	batch_t *batch;
+
+	if (!datastr)
+		return;
+
+	if (queue_cnt == MAX_QUEUED_BATCHES) {
+		_spill_batch(&queue[queue_head]);
+		queue_head = (queue_head + 1) % MAX_QUEUED_BATCHES;
+		queue_cnt--;
+	}
+
+	batch = &queue[(queue_head + queue_cnt) % MAX_QUEUED_BATCHES];
+	batch->data = datastr;
+	batch->len = datastr_pos - datastr;
+	queue_cnt++;
+
+	log_flag(PROFILE, "%s %s: %zu bytes of data queued, %d batches waiting",
+		 plugin_type, __func__, batch->len, queue_cnt);
+
+	datastr = datastr_pos = NULL;
+	slurm_cond_signal(&send_cond);
+}
+
+/*
+ * Put back a batch which failed to be sent at the front of the queue.
+ * Call with send_lock held.
+ */
+static void _requeue_batch(batch_t *batch)
+{
+	if (queue_cnt == MAX_QUEUED_BATCHES) {
+		_spill_batch(batch);
+		return;
+	}
+
+	queue_head = (queue_head + MAX_QUEUED_BATCHES - 1) %
+		MAX_QUEUED_BATCHES;
+	queue[queue_head] = *batch;
+	queue_cnt++;
+}
+
+/*
+ * Send the data of a spool file from its offset on, one batch at a time.
+ * Batches are cut at line boundaries. Resending lines which already made it
+ * to InfluxDB is harmless as points with the same series and time are
+ * overwritten.
+ */
+static int _send_spool(spool_t *sp)
+{
+	struct stat st;
+	char *buf, *end;
+	size_t len;
+	int rc = SLURM_SUCCESS;
+
+	while (true) {
+		/* The spool of this step is appended to under send_lock */
+		slurm_mutex_lock(&send_lock);
+		rc = fstat(sp->fd, &st);
+		slurm_mutex_unlock(&send_lock);
+		if (rc) {
+			error("%s %s: fstat(%s): %m",
+			      plugin_type, __func__, sp->path);
+			return SLURM_ERROR;
+		}
+
+		if (sp->offset >= st.st_size)
+			return SLURM_SUCCESS;
+
+		len = MIN(BATCH_SIZE, (st.st_size - sp->offset));
+		buf = xmalloc_nz(len);
+		if (pread(sp->fd, buf, len, sp->offset) != len) {
+			error("%s %s: pread(%s): %m",
+			      plugin_type, __func__, sp->path);
+			xfree(buf);
+			return SLURM_ERROR;
+		}
+		if ((sp->offset + len) < st.st_size) {
+			for (end = buf + len - 1; end > buf; end--)
+				if (*end == '\n')
+					break;
+			if (end > buf)
+				len = end - buf + 1;
+		}
+
+		rc = _send_data(buf, len);
+		xfree(buf);
+		if (rc != SLURM_SUCCESS)
+			return rc;
+		sp->offset += len;
+	}
+}
+
+/* Send the spool of this step, then the ones left behind by other steps */
+static int _send_spools(void)
+{
+	ListIterator itr;
+	spool_t *sp;
+	struct stat st;
+	int rc = SLURM_SUCCESS;
+
+	slurm_mutex_lock(&send_lock);
+	sp = spool_pending ? spool : NULL;
+	slurm_mutex_unlock(&send_lock);
+
+	if (sp) {
+		if ((rc = _send_spool(sp)))
+			return rc;
+
+		slurm_mutex_lock(&send_lock);
+		if (!fstat(spool->fd, &st) && (spool->offset >= st.st_size)) {
+			if (ftruncate(spool->fd, 0))
+				error("%s %s: ftruncate(%s): %m",
+				      plugin_type, __func__, spool->path);
+			spool->offset = 0;
+			spool_pending = false;
+		}
+		slurm_mutex_unlock(&send_lock);
+	}
+
+	if (!orphan_spools)
+		return SLURM_SUCCESS;
+
+	itr = list_iterator_create(orphan_spools);
+	while ((sp = list_next(itr))) {
+		if (sp->fd < 0) {
+			/*
+			 * The step which wrote the file holds a lock on it
+			 * while it runs, the file is only ours once that
+			 * lock can be taken.
+			 */
+			if ((sp->fd = open(sp->path, O_RDWR | O_CLOEXEC)) < 0) {
+				list_delete_item(itr);
+				continue;
+			}
+			if (flock(sp->fd, LOCK_EX | LOCK_NB) ||
+			    fstat(sp->fd, &st) || !st.st_nlink) {
+				list_delete_item(itr);
+				continue;
+			}
+		}
+
+		if ((rc = _send_spool(sp)))
+			break;
+
+		log_flag(PROFILE, "%s %s: sent data of %s",
+			 plugin_type, __func__, sp->path);
+		if (unlink(sp->path))
+			error("%s %s: unlink(%s): %m",
+			      plugin_type, __func__, sp->path);
+		list_delete_item(itr);
 	}
+	list_iterator_destroy(itr);
 
 	return rc;
 }
 
+/* Find the spool files left behind by steps which could not send them */
+static void _find_orphan_spools(void)
+{
+	DIR *dp;
+	struct dirent *ent;
+	spool_t *sp;
+	size_t len;
+
+	if (!influxdb_conf.spool_dir)
+		return;
+
+	if (!(dp = opendir(influxdb_conf.spool_dir))) {
+		error("%s %s: opendir(%s): %m",
+		      plugin_type, __func__, influxdb_conf.spool_dir);
+		return;
+	}
+
+	while ((ent = readdir(dp))) {
+		len = strlen(ent->d_name);
+		if (xstrncmp(ent->d_name, SPOOL_PREFIX, strlen(SPOOL_PREFIX)) ||
+		    (len <= strlen(SPOOL_SUFFIX)) ||
+		    xstrcmp(ent->d_name + len - strlen(SPOOL_SUFFIX),
+			    SPOOL_SUFFIX))
+			continue;
+
+		if (!orphan_spools)
+			orphan_spools = list_create(_spool_free);
+		sp = xmalloc(sizeof(*sp));
+		sp->fd = -1;
+		sp->path = xstrdup_printf("%s/%s", influxdb_conf.spool_dir,
+					  ent->d_name);
+		list_append(orphan_spools, sp);
+	}
+	closedir(dp);
+}
+
+static void *_send_thread(void *no_data)
+{
+	struct timespec ts = { 0, 0 };
+	batch_t batch;
+	time_t now, retry_time = 0;
+	int delay = 0, rc;
+
+	_find_orphan_spools();
+
+	slurm_mutex_lock(&send_lock);
+	while (!send_shutdown) {
+		now = time(NULL);
+
+		if (datastr &&
+		    ((datastr_time + influxdb_conf.freq) <= now))
+			_queue_batch();
+
+		if ((retry_time > now) ||
+		    (!queue_cnt && !spool_pending &&
+		     !(orphan_spools && list_count(orphan_spools)))) {
+			if (retry_time > now)
+				ts.tv_sec = retry_time;
+			else if (datastr)
+				ts.tv_sec = datastr_time + influxdb_conf.freq;
+			else
+				ts.tv_sec = now + influxdb_conf.freq;
+			slurm_cond_timedwait(&send_cond, &send_lock, &ts);
+			continue;
+		}
+
+		if (queue_cnt) {
+			batch = queue[queue_head];
+			queue_head = (queue_head + 1) % MAX_QUEUED_BATCHES;
+			queue_cnt--;
+
+			slurm_mutex_unlock(&send_lock);
+			rc = _send_data(batch.data, batch.len);
+			slurm_mutex_lock(&send_lock);
+
+			if (rc)
+				_requeue_batch(&batch);
+			else
+				xfree(batch.data);
+		} else {
+			slurm_mutex_unlock(&send_lock);
+			rc = _send_spools();
+			slurm_mutex_lock(&send_lock);
+		}
+
+		/* Back off exponentially while InfluxDB is unreachable */
+		if (rc) {
+			delay = delay ? MIN((delay * 2), MAX_RETRY_DELAY) : 1;
+			retry_time = time(NULL) + delay;
+			log_flag(PROFILE, "%s %s: retrying in %d seconds",
+				 plugin_type, __func__, delay);
+		} else
+			delay = retry_time = 0;
+	}
+	slurm_mutex_unlock(&send_lock);
+
+	return NULL;
+}
+
+/*
+ * Stop send_thread, then make one last attempt to send what is left and
+ * spool whatever could not be sent.
+ */
+static void _send_fini(void)
+{
+	batch_t batch;
+	int rc = SLURM_SUCCESS;
+
+	if (!send_thread)
+		return;
+
+	slurm_mutex_lock(&send_lock);
+	send_shutdown = true;
+	slurm_cond_broadcast(&send_cond);
+	slurm_mutex_unlock(&send_lock);
+	pthread_join(send_thread, NULL);
+	send_thread = 0;
+
+	slurm_mutex_lock(&send_lock);
+	_queue_batch();
+	while (queue_cnt) {
+		batch = queue[queue_head];
+		queue_head = (queue_head + 1) % MAX_QUEUED_BATCHES;
+		queue_cnt--;
+
+		if (!rc)
+			rc = _send_data(batch.data, batch.len);
+		if (rc)
+			_spill_batch(&batch);
+		else
+			xfree(batch.data);
+	}
+	slurm_mutex_unlock(&send_lock);
+
+	/* Leave the spools of other steps to the next step */
+	FREE_NULL_LIST(orphan_spools);
+	if (!rc && spool_pending)
+		rc = _send_spools();
+
+	if (spool) {
+		if (spool_pending)
+			info("%s %s: data which could not be sent to InfluxDB kept in %s",
+			     plugin_type, __func__, spool->path);
+		else if (unlink(spool->path))
+			error("%s %s: unlink(%s): %m",
+			      plugin_type, __func__, spool->path);
+		_spool_free(spool);
+		spool = NULL;
+		spool_pending = false;
+	}
+
+	if (curl_handle) {
+		curl_easy_cleanup(curl_handle);
+		curl_handle = NULL;
+	}
+	curl_global_cleanup();
+}
+
 /*
  * init() is called when the plugin is loaded, before any other functions
  * are called. Put global initialization here.
@@ -322,10 +826,6 @@ extern int init(void)
 {
 	debug3("%s %s called", plugin_type, __func__);
 
-	if (!running_in_slurmstepd())
-		return SLURM_SUCCESS;
-
-	datastr = xmalloc(BUF_SIZE);
 	return SLURM_SUCCESS;
 }
 
@@ -333,12 +833,14 @@ extern int fini(void)
 {
 	debug3("%s %s called", plugin_type, __func__);
 
+	_send_fini();
 	_free_tables();
 	xfree(datastr);
 	xfree(influxdb_conf.host);
 	xfree(influxdb_conf.database);
 	xfree(influxdb_conf.password);
 	xfree(influxdb_conf.rt_policy);
+	xfree(influxdb_conf.spool_dir);
 	xfree(influxdb_conf.username);
 	return SLURM_SUCCESS;
 }
@@ -352,8 +854,11 @@ extern void acct_gather_profile_p_conf_options(s_p_options_t **full_options,
 		{"ProfileInfluxDBHost", S_P_STRING},
 		{"ProfileInfluxDBDatabase", S_P_STRING},
 		{"ProfileInfluxDBDefault", S_P_STRING},
+		{"ProfileInfluxDBFrequency", S_P_UINT32},
 		{"ProfileInfluxDBPass", S_P_STRING},
 		{"ProfileInfluxDBRTPolicy", S_P_STRING},
+		{"ProfileInfluxDBSpoolDir", S_P_STRING},
+		{"ProfileInfluxDBTimeout", S_P_UINT32},
 		{"ProfileInfluxDBUser", S_P_STRING},
 		{NULL} };
 
@@ -368,6 +873,8 @@ extern void acct_gather_profile_p_conf_set(s_p_hashtbl_t *tbl)
 	debug3("%s %s called", plugin_type, __func__);
 
 	influxdb_conf.def = ACCT_GATHER_PROFILE_ALL;
+	influxdb_conf.freq = DEFAULT_INFLUXDB_FREQ;
+	influxdb_conf.timeout = DEFAULT_INFLUXDB_TIMEOUT;
 	if (tbl) {
 		s_p_get_string(&influxdb_conf.host, "ProfileInfluxDBHost", tbl);
 		if (s_p_get_string(&tmp, "ProfileInfluxDBDefault", tbl)) {
@@ -380,10 +887,16 @@ extern void acct_gather_profile_p_conf_set(s_p_hashtbl_t *tbl)
 		}
 		s_p_get_string(&influxdb_conf.database,
 			       "ProfileInfluxDBDatabase", tbl);
+		s_p_get_uint32(&influxdb_conf.freq,
+			       "ProfileInfluxDBFrequency", tbl);
 		s_p_get_string(&influxdb_conf.password,
 			       "ProfileInfluxDBPass", tbl);
 		s_p_get_string(&influxdb_conf.rt_policy,
 			       "ProfileInfluxDBRTPolicy", tbl);
+		s_p_get_string(&influxdb_conf.spool_dir,
+			       "ProfileInfluxDBSpoolDir", tbl);
+		s_p_get_uint32(&influxdb_conf.timeout,
+			       "ProfileInfluxDBTimeout", tbl);
 		s_p_get_string(&influxdb_conf.username,
 			       "ProfileInfluxDBUser", tbl);
 	}
@@ -404,6 +917,12 @@ extern void acct_gather_profile_p_conf_set(s_p_hashtbl_t *tbl)
 		fatal("No ProfileInfluxDBRTPolicy in your acct_gather.conf file. This is required to use the %s plugin",
 		      plugin_type);
 
+	if (!influxdb_conf.freq)
+		fatal("ProfileInfluxDBFrequency can not be 0");
+
+	if (!influxdb_conf.timeout)
+		fatal("ProfileInfluxDBTimeout can not be 0");
+
 	debug("%s loaded", plugin_name);
 }
 
@@ -445,6 +964,18 @@ extern int acct_gather_profile_p_node_step_start(stepd_step_rec_t* job)
 	debug2("%s %s: option --profile=%s", plugin_type, __func__,
 	       profile_str);
 	g_profile_running = _determine_profile();
+
+	if (g_profile_running <= ACCT_GATHER_PROFILE_NONE)
+		return rc;
+
+	if (curl_global_init(CURL_GLOBAL_ALL) != 0) {
+		error("%s %s: curl_global_init: %m", plugin_type, __func__);
+		return SLURM_ERROR;
+	}
+
+	send_shutdown = false;
+	slurm_thread_create(&send_thread, _send_thread, NULL);
+
 	return rc;
 }
 
@@ -461,6 +992,8 @@ extern int acct_gather_profile_p_node_step_end(void)
 
 	xassert(running_in_slurmstepd());
 
+	_send_fini();
+
 	return rc;
 }
 
@@ -486,7 +1019,10 @@ extern int acct_gather_profile_p_task_end(pid_t taskpid)
 {
 	debug3("%s %s called", plugin_type, __func__);
 
-	_send_data(NULL);
+	slurm_mutex_lock(&send_lock);
+	_queue_batch();
+	slurm_mutex_unlock(&send_lock);
+
 	return SLURM_SUCCESS;
 }
 
@@ -552,14 +1088,24 @@ extern int acct_gather_profile_p_add_sample_data(int table_id, void *data,
 {
 	table_t *table = &tables[table_id];
 	int i = 0;
-	char *str = NULL;
 
 	debug3("%s %s called", plugin_type, __func__);
 
+	/*
+	 * Every compute node which is sampling data will try to establish a
+	 * different connection to the influxdb server. In order to reduce the
+	 * number of connections, every time a new sampled data comes in, it
+	 * is saved in the 'datastr' buffer. Once this buffer is full, it is
+	 * handed over to send_thread which sends it.
+	 */
+	slurm_mutex_lock(&send_lock);
+	if (!datastr)
+		datastr_time = time(NULL);
+
 	for(; i < table->size; i++) {
 		switch (table->types[i]) {
 		case PROFILE_FIELD_UINT64:
-			xstrfmtcat(str, "%s,job=%d,step=%d,task=%s,"
+			xstrfmtcatat(datastr, &datastr_pos, "%s,job=%d,step=%d,task=%s,"
 				   "host=%s value=%"PRIu64" "
 				   "%"PRIu64"\n", table->names[i],
 				   g_job->step_id.job_id,
@@ -569,7 +1115,7 @@ extern int acct_gather_profile_p_add_sample_data(int table_id, void *data,
 				   (uint64_t)sample_time);
 			break;
 		case PROFILE_FIELD_DOUBLE:
-			xstrfmtcat(str, "%s,job=%d,step=%d,task=%s,"
+			xstrfmtcatat(datastr, &datastr_pos, "%s,job=%d,step=%d,task=%s,"
 				   "host=%s value=%.2f %"PRIu64""
 				   "\n", table->names[i],
 				   g_job->step_id.job_id,
@@ -583,8 +1129,9 @@ extern int acct_gather_profile_p_add_sample_data(int table_id, void *data,
 		}
 	}
 
-	_send_data(str);
-	xfree(str);
+	if ((datastr_pos - datastr) >= BATCH_SIZE)
+		_queue_batch();
+	slurm_mutex_unlock(&send_lock);
 
 	return SLURM_SUCCESS;
 }
@@ -613,6 +1160,11 @@ extern void acct_gather_profile_p_conf_values(List *data)
 		xstrdup(acct_gather_profile_to_string(influxdb_conf.def));
 	list_append(*data, key_pair);
 
+	key_pair = xmalloc(sizeof(config_key_pair_t));
+	key_pair->name = xstrdup("ProfileInfluxDBFrequency");
+	key_pair->value = xstrdup_printf("%u", influxdb_conf.freq);
+	list_append(*data, key_pair);
+
 	key_pair = xmalloc(sizeof(config_key_pair_t));
 	key_pair->name = xstrdup("ProfileInfluxDBPass");
 	key_pair->value = xstrdup(influxdb_conf.password);
@@ -623,6 +1175,16 @@ extern void acct_gather_profile_p_conf_values(List *data)
 	key_pair->value = xstrdup(influxdb_conf.rt_policy);
 	list_append(*data, key_pair);
 
+	key_pair = xmalloc(sizeof(config_key_pair_t));
+	key_pair->name = xstrdup("ProfileInfluxDBSpoolDir");
+	key_pair->value = xstrdup(influxdb_conf.spool_dir);
+	list_append(*data, key_pair);
+
+	key_pair = xmalloc(sizeof(config_key_pair_t));
+	key_pair->name = xstrdup("ProfileInfluxDBTimeout");
+	key_pair->value = xstrdup_printf("%u", influxdb_conf.timeout);
+	list_append(*data, key_pair);
+
 	key_pair = xmalloc(sizeof(config_key_pair_t));
 	key_pair->name = xstrdup("ProfileInfluxDBUser");
 	key_pair->value = xstrdup(influxdb_conf.username);
@@ -0,0 +1,1216 @@
+/*****************************************************************************\
+ *  cgroup_v2.c - Cgroup v2 plugin
+ *****************************************************************************
+ *  Copyright (C) 2021 SchedMD LLC
+ *
+ *  This file is part of Slurm, a resource management program.
+ *  For details, see <https://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  Slurm is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  Slurm is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with Slurm; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+#define _GNU_SOURCE
+
+#include "cgroup_v2.h"
+
+/*
+ * These variables are required by the generic plugin interface.  If they
+ * are not found in the plugin, the plugin loader will ignore it.
+ *
+ * plugin_name - a string giving a human-readable description of the
+ * plugin.  There is no maximum length, but the symbol must refer to
+ * a valid string.
+ *
+ * plugin_type - a string suggesting the type of the plugin or its
+ * applicability to a particular form of data or method of data handling.
+ * If the low-level plugin API is used, the contents of this string are
+ * unimportant and may be anything.  Slurm uses the higher-level plugin
+ * interface which requires this string to be of the form
+ *
+ *	<application>/<method>
+ *
+ * where <application> is a description of the intended application of
+ * the plugin (e.g., "select" for Slurm node selection) and <method>
+ * is a description of how this plugin satisfies that application.  Slurm will
+ * only load select plugins if the plugin_type string has a
+ * prefix of "select/".
+ *
+ * plugin_version - an unsigned 32-bit integer containing the Slurm version
+ * (major.minor.micro combined into a single number).
+ */
+const char plugin_name[] = "Cgroup v2 plugin";
+const char plugin_type[] = "cgroup/v2";
+const uint32_t plugin_version = SLURM_VERSION_NUMBER;
+
+/*
+ * Controller needed by each cgroup_ctl_type_t, NULL if the files used are
+ * always there. cpu.stat has the usage counters without the cpu controller.
+ */
+static const char *g_ctl_name[CG_CTL_CNT] = {
+	NULL,
+	"cpuset",
+	"memory",
+	NULL,
+	NULL
+};
+
+/* Controllers handed down to the children of every level when available */
+static const char *g_subtree_ctl[] = {
+	"cpuset",
+	"cpu",
+	"io",
+	"memory",
+	"pids",
+	NULL
+};
+
+static xcgroup_ns_t g_cg_ns;
+static char *g_avail_ctls = NULL;	/* cgroup.controllers of the root */
+static uint16_t g_step_active_cnt[CG_CTL_CNT];
+
+static xcgroup_t g_root_cg;
+static xcgroup_t g_sys_cg;
+static xcgroup_t g_user_cg;
+static xcgroup_t g_job_cg;
+static xcgroup_t g_step_cg;
+static xcgroup_t g_step_slurm_cg;	/* slurmstepd */
+static xcgroup_t g_step_user_cg;	/* parent of the task cgroups */
+static xcgroup_t g_task_special_cg;	/* pids not yet in a task */
+
+static bool oom_mgr_started = false;
+
+/* Accounting artifacts */
+static List g_task_acct_list = NULL;
+static uint32_t g_max_task_id = 0;
+static long g_clk_tck = 0;
+
+typedef struct {
+	xcgroup_t task_cg;
+	uint32_t taskid;
+} task_cg_info_t;
+
+static int _lock_cg(xcgroup_t *cg)
+{
+	if (!cg->path)
+		return SLURM_ERROR;
+
+	if ((cg->fd = open(cg->path, O_RDONLY | O_CLOEXEC)) < 0) {
+		debug2("error from open of cgroup '%s' : %m", cg->path);
+		return SLURM_ERROR;
+	}
+
+	if (flock(cg->fd, LOCK_EX) < 0) {
+		debug2("error locking cgroup '%s' : %m", cg->path);
+		close(cg->fd);
+		return SLURM_ERROR;
+	}
+
+	return SLURM_SUCCESS;
+}
+
+static void _unlock_cg(xcgroup_t *cg)
+{
+	if (flock(cg->fd, LOCK_UN) < 0)
+		debug2("error unlocking cgroup '%s' : %m", cg->path);
+	close(cg->fd);
+}
+
+static bool _ctl_available(const char *name)
+{
+	char *ptr = g_avail_ctls;
+	size_t len = strlen(name);
+
+	while (ptr && (ptr = strstr(ptr, name))) {
+		if (((ptr == g_avail_ctls) || (ptr[-1] == ' ')) &&
+		    ((ptr[len] == ' ') || (ptr[len] == '\n') || !ptr[len]))
+			return true;
+		ptr += len;
+	}
+
+	return false;
+}
+
+static int _cgroup_init(void)
+{
+	cgroup_conf_t *cg_conf;
+	struct statfs fs;
+	size_t sz;
+
+	if (g_cg_ns.mnt_point)
+		return SLURM_SUCCESS;
+
+	cg_conf = cgroup_get_conf();
+	g_cg_ns.mnt_point = xstrdup(cg_conf->cgroup_mountpoint);
+	g_cg_ns.subsystems = xstrdup("unified");
+	cgroup_free_conf(cg_conf);
+
+	if (statfs(g_cg_ns.mnt_point, &fs) < 0) {
+		error("unable to stat %s: %m", g_cg_ns.mnt_point);
+		goto fail;
+	}
+
+	if (!F_TYPE_EQUAL(fs.f_type, CGROUP2_SUPER_MAGIC)) {
+		error("%s is not a cgroup v2 filesystem", g_cg_ns.mnt_point);
+		goto fail;
+	}
+
+	if (common_cgroup_create(&g_cg_ns, &g_root_cg, "", 0, 0) !=
+	    SLURM_SUCCESS) {
+		error("unable to create root cgroup");
+		goto fail;
+	}
+
+	if (common_cgroup_get_param(&g_root_cg, "cgroup.controllers",
+				    &g_avail_ctls, &sz) != SLURM_SUCCESS) {
+		error("unable to read %s/cgroup.controllers",
+		      g_cg_ns.mnt_point);
+		common_cgroup_destroy(&g_root_cg);
+		goto fail;
+	}
+
+	debug("available controllers: %s", g_avail_ctls);
+
+	return SLURM_SUCCESS;
+
+fail:
+	common_cgroup_ns_destroy(&g_cg_ns);
+	return SLURM_ERROR;
+}
+
+/*
+ * Give the children of cg all the controllers we use. Controllers which can
+ * not be enabled are only logged, the limits needing them will fail later.
+ */
+static void _enable_subtree_ctls(xcgroup_t *cg)
+{
+	char buf[32];
+
+	for (int i = 0; g_subtree_ctl[i]; i++) {
+		if (!_ctl_available(g_subtree_ctl[i]))
+			continue;
+		snprintf(buf, sizeof(buf), "+%s", g_subtree_ctl[i]);
+		if (common_cgroup_set_param(cg, "cgroup.subtree_control", buf)
+		    != SLURM_SUCCESS)
+			debug("unable to enable %s controller in %s: %m",
+			      g_subtree_ctl[i], cg->path);
+	}
+}
+
+/* mkdir a cgroup relative to the root, it may already exist */
+static int _create_cg(xcgroup_t *cg, char *name, uid_t uid, gid_t gid)
+{
+	if (common_cgroup_create(&g_cg_ns, cg, name, uid, gid) !=
+	    SLURM_SUCCESS) {
+		error("unable to create cgroup %s", name);
+		return SLURM_ERROR;
+	}
+
+	if (common_cgroup_instantiate(cg) != SLURM_SUCCESS) {
+		error("unable to instantiate cgroup %s", name);
+		common_cgroup_destroy(cg);
+		return SLURM_ERROR;
+	}
+
+	return SLURM_SUCCESS;
+}
+
+/* Create the slurm cgroup and return its path relative to the root */
+static char *_create_slurm_cg(void)
+{
+	xcgroup_t slurm_cg;
+	cgroup_conf_t *cg_conf;
+	char *pre;
+
+	cg_conf = cgroup_get_conf();
+	pre = xstrdup(cg_conf->cgroup_prepend);
+	cgroup_free_conf(cg_conf);
+
+#ifdef MULTIPLE_SLURMD
+	if (conf->node_name) {
+		xstrsubstitute(pre, "%n", conf->node_name);
+	} else {
+		xfree(pre);
+		pre = xstrdup("/slurm");
+	}
+#endif
+
+	_enable_subtree_ctls(&g_root_cg);
+
+	if (_create_cg(&slurm_cg, pre, getuid(), getgid()) != SLURM_SUCCESS) {
+		xfree(pre);
+		return NULL;
+	}
+
+	_enable_subtree_ctls(&slurm_cg);
+	common_cgroup_destroy(&slurm_cg);
+
+	return pre;
+}
+
+static int _step_hierarchy_create(stepd_step_rec_t *job)
+{
+	char *slurm_cgpath = NULL, *path = NULL;
+	char step_str[64];
+	int rc = SLURM_ERROR;
+
+	/* Another controller already created it */
+	if (g_step_cg.path)
+		return SLURM_SUCCESS;
+
+	if (_lock_cg(&g_root_cg) != SLURM_SUCCESS) {
+		error("unable to lock root cgroup");
+		return SLURM_ERROR;
+	}
+
+	if (!(slurm_cgpath = _create_slurm_cg()))
+		goto end;
+
+	xstrfmtcat(path, "%s/uid_%u", slurm_cgpath, job->uid);
+	if (_create_cg(&g_user_cg, path, 0, 0) != SLURM_SUCCESS)
+		goto end;
+	_enable_subtree_ctls(&g_user_cg);
+
+	xstrfmtcat(path, "/job_%u", job->step_id.job_id);
+	if (_create_cg(&g_job_cg, path, 0, 0) != SLURM_SUCCESS)
+		goto fail_user;
+	_enable_subtree_ctls(&g_job_cg);
+
+	xstrfmtcat(path, "/step_%s",
+		   log_build_step_id_str(&job->step_id, step_str,
+					 sizeof(step_str),
+					 STEP_ID_FLAG_NO_PREFIX |
+					 STEP_ID_FLAG_NO_JOB));
+	if (_create_cg(&g_step_cg, path, job->uid, job->gid) != SLURM_SUCCESS)
+		goto fail_job;
+	_enable_subtree_ctls(&g_step_cg);
+
+	xstrcat(path, "/slurm");
+	if (_create_cg(&g_step_slurm_cg, path, 0, 0) != SLURM_SUCCESS)
+		goto fail_step;
+
+	xfree(path);
+	xstrfmtcat(path, "%s/user", g_step_cg.name);
+	if (_create_cg(&g_step_user_cg, path, job->uid, job->gid) !=
+	    SLURM_SUCCESS)
+		goto fail_step_slurm;
+	_enable_subtree_ctls(&g_step_user_cg);
+
+	xstrcat(path, "/task_special");
+	if (_create_cg(&g_task_special_cg, path, job->uid, job->gid) !=
+	    SLURM_SUCCESS)
+		goto fail_step_user;
+
+	rc = SLURM_SUCCESS;
+	goto end;
+
+	/* do not rmdir anything, other steps may be using the directories */
+fail_step_user:
+	common_cgroup_destroy(&g_step_user_cg);
+fail_step_slurm:
+	common_cgroup_destroy(&g_step_slurm_cg);
+fail_step:
+	common_cgroup_destroy(&g_step_cg);
+fail_job:
+	common_cgroup_destroy(&g_job_cg);
+fail_user:
+	common_cgroup_destroy(&g_user_cg);
+end:
+	_unlock_cg(&g_root_cg);
+	xfree(slurm_cgpath);
+	xfree(path);
+	return rc;
+}
+
+static int _rmdir_task(void *x, void *arg)
+{
+	task_cg_info_t *t = (task_cg_info_t *) x;
+
+	if (common_cgroup_delete(&t->task_cg) != SLURM_SUCCESS)
+		debug2("taskid: %d, failed to delete %s %m", t->taskid,
+		       t->task_cg.path);
+
+	return SLURM_SUCCESS;
+}
+
+static int _step_hierarchy_destroy(void)
+{
+	int rc = SLURM_SUCCESS;
+
+	if (!g_step_cg.path)
+		return SLURM_SUCCESS;
+
+	/*
+	 * The step cgroups can not be removed with slurmstepd in them, and
+	 * the root is the only place out of our hierarchy where it can go.
+	 */
+	if (common_cgroup_move_process(&g_root_cg, getpid()) !=
+	    SLURM_SUCCESS) {
+		error("Unable to move pid %d to root cgroup", getpid());
+		return SLURM_ERROR;
+	}
+
+	if (_lock_cg(&g_root_cg) != SLURM_SUCCESS) {
+		error("unable to lock root cgroup");
+		return SLURM_ERROR;
+	}
+
+	if (g_task_acct_list)
+		(void) list_for_each(g_task_acct_list, _rmdir_task, NULL);
+
+	if ((common_cgroup_delete(&g_task_special_cg) != SLURM_SUCCESS) ||
+	    (common_cgroup_delete(&g_step_user_cg) != SLURM_SUCCESS) ||
+	    (common_cgroup_delete(&g_step_slurm_cg) != SLURM_SUCCESS) ||
+	    (common_cgroup_delete(&g_step_cg) != SLURM_SUCCESS)) {
+		debug2("unable to remove step cg %s: %m", g_step_cg.path);
+		rc = SLURM_ERROR;
+		goto end;
+	}
+
+	/*
+	 * Best effort for the job and user cgroups, other steps of the job or
+	 * other jobs of the user may still be using them.
+	 */
+	if (common_cgroup_delete(&g_job_cg) != SLURM_SUCCESS)
+		debug2("not removing job cg %s: %m", g_job_cg.path);
+	else if (common_cgroup_delete(&g_user_cg) != SLURM_SUCCESS)
+		debug2("not removing user cg %s: %m", g_user_cg.path);
+
+	common_cgroup_destroy(&g_task_special_cg);
+	common_cgroup_destroy(&g_step_user_cg);
+	common_cgroup_destroy(&g_step_slurm_cg);
+	common_cgroup_destroy(&g_step_cg);
+	common_cgroup_destroy(&g_job_cg);
+	common_cgroup_destroy(&g_user_cg);
+
+end:
+	_unlock_cg(&g_root_cg);
+	return rc;
+}
+
+/*
+ * Get the cgroup of pid relative to the root of the hierarchy from the "0::"
+ * line of /proc/<pid>/cgroup. The string must be freed by the caller.
+ */
+static char *_get_pid_cg_name(pid_t pid)
+{
+	char *path = NULL, *content = NULL, *name = NULL, *ptr, *end;
+	size_t sz;
+
+	xstrfmtcat(path, "/proc/%d/cgroup", pid);
+	if (common_file_read_content(path, &content, &sz) != SLURM_SUCCESS) {
+		xfree(path);
+		return NULL;
+	}
+	xfree(path);
+
+	for (ptr = content; ptr; ptr = strchr(ptr, '\n')) {
+		if (*ptr == '\n')
+			ptr++;
+		if (!xstrncmp(ptr, "0::", 3)) {
+			ptr += 3;
+			if ((end = strchr(ptr, '\n')))
+				*end = '\0';
+			name = xstrdup(ptr);
+			break;
+		}
+	}
+
+	xfree(content);
+	return name;
+}
+
+/* Is pid in one of the task cgroups of this step? */
+static bool _pid_in_step(pid_t pid)
+{
+	char *name = _get_pid_cg_name(pid);
+	size_t len = strlen(g_step_user_cg.name);
+	bool rc;
+
+	rc = name && !xstrncmp(name, g_step_user_cg.name, len) &&
+		(name[len] == '/');
+
+	xfree(name);
+	return rc;
+}
+
+static int _set_memory_limits(xcgroup_t *cg, cgroup_limits_t *limits)
+{
+	int rc;
+
+	rc = common_cgroup_set_uint64_param(cg, "memory.max",
+					    limits->limit_in_bytes);
+
+	/* memory.swap.max only limits the swap, not memory plus swap */
+	if (limits->memsw_limit_in_bytes != NO_VAL64) {
+		uint64_t swap = 0;
+
+		if (limits->memsw_limit_in_bytes > limits->limit_in_bytes)
+			swap = limits->memsw_limit_in_bytes -
+				limits->limit_in_bytes;
+		rc += common_cgroup_set_uint64_param(cg, "memory.swap.max",
+						     swap);
+	}
+
+	if (limits->kmem_limit_in_bytes != NO_VAL64)
+		debug("kernel memory is not limited separately in cgroup v2");
+
+	return rc;
+}
+
+/*
+ * Find the value of a "key value" line as found in memory.stat, cpu.stat and
+ * memory.events.
+ */
+static bool _get_key_value(char *content, const char *key, uint64_t *value)
+{
+	size_t len = strlen(key);
+	char *ptr;
+
+	for (ptr = content; ptr && *ptr; ptr = strchr(ptr, '\n')) {
+		if (*ptr == '\n')
+			ptr++;
+		if (!strncmp(ptr, key, len) && (ptr[len] == ' ')) {
+			*value = strtoull(ptr + len + 1, NULL, 10);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static uint64_t _get_event(xcgroup_t *cg, char *file, const char *key)
+{
+	char *content = NULL;
+	uint64_t value = 0;
+	size_t sz;
+
+	if (!cg->path ||
+	    (common_cgroup_get_param(cg, file, &content, &sz) !=
+	     SLURM_SUCCESS)) {
+		debug2("unable to read '%s' from '%s'", file, cg->path);
+		return 0;
+	}
+
+	if (!_get_key_value(content, key, &value))
+		debug2("no '%s' in '%s/%s'", key, cg->path, file);
+
+	xfree(content);
+	return value;
+}
+
+extern int init(void)
+{
+	for (int i = 0; i < CG_CTL_CNT; i++)
+		g_step_active_cnt[i] = 0;
+
+	g_clk_tck = sysconf(_SC_CLK_TCK);
+	if (g_clk_tck < 1)
+		g_clk_tck = 100;
+
+	debug("%s loaded", plugin_name);
+	return SLURM_SUCCESS;
+}
+
+extern int fini(void)
+{
+	FREE_NULL_LIST(g_task_acct_list);
+	common_cgroup_destroy(&g_sys_cg);
+	common_cgroup_destroy(&g_root_cg);
+	common_cgroup_ns_destroy(&g_cg_ns);
+	xfree(g_avail_ctls);
+
+	debug("unloading %s", plugin_name);
+	return SLURM_SUCCESS;
+}
+
+extern int cgroup_p_initialize(cgroup_ctl_type_t sub)
+{
+	if (sub >= CG_CTL_CNT) {
+		error("cgroup subsystem %u not supported", sub);
+		return SLURM_ERROR;
+	}
+
+	if (sub == CG_DEVICES) {
+		error("device constraints need BPF programs in cgroup v2, which are not supported");
+		return SLURM_ERROR;
+	}
+
+	if (_cgroup_init() != SLURM_SUCCESS)
+		return SLURM_ERROR;
+
+	if (g_ctl_name[sub] && !_ctl_available(g_ctl_name[sub])) {
+		error("%s controller is not available in %s/cgroup.controllers",
+		      g_ctl_name[sub], g_cg_ns.mnt_point);
+		return SLURM_ERROR;
+	}
+
+	return SLURM_SUCCESS;
+}
+
+extern int cgroup_p_system_create(cgroup_ctl_type_t sub)
+{
+	char *slurm_cgpath, *sys_cgpath = NULL;
+	int rc;
+
+	switch (sub) {
+	case CG_CPUS:
+	case CG_MEMORY:
+		break;
+	default:
+		error("cgroup subsystem %u not supported", sub);
+		return SLURM_ERROR;
+	}
+
+	/* Both controllers share the same directory */
+	if (g_sys_cg.path)
+		return SLURM_SUCCESS;
+
+	if (!(slurm_cgpath = _create_slurm_cg()))
+		return SLURM_ERROR;
+
+	xstrfmtcat(sys_cgpath, "%s/system", slurm_cgpath);
+	rc = _create_cg(&g_sys_cg, sys_cgpath, getuid(), getgid());
+
+	xfree(sys_cgpath);
+	xfree(slurm_cgpath);
+	return rc;
+}
+
+extern int cgroup_p_system_addto(cgroup_ctl_type_t sub, pid_t *pids, int npids)
+{
+	switch (sub) {
+	case CG_TRACK:
+	case CG_CPUS:
+	case CG_MEMORY:
+		break;
+	default:
+		error("cgroup subsystem %u not supported", sub);
+		return SLURM_ERROR;
+	}
+
+	if (!g_sys_cg.path)
+		return SLURM_ERROR;
+
+	return common_cgroup_add_pids(&g_sys_cg, pids, npids);
+}
+
+extern int cgroup_p_system_destroy(cgroup_ctl_type_t sub)
+{
+	/* Another controller may have already destroyed it. */
+	if (!g_sys_cg.path)
+		return SLURM_SUCCESS;
+
+	if (common_cgroup_move_process(&g_root_cg, getpid()) !=
+	    SLURM_SUCCESS) {
+		error("Unable to move pid %d to root cgroup", getpid());
+		return SLURM_ERROR;
+	}
+
+	if (common_cgroup_delete(&g_sys_cg) != SLURM_SUCCESS) {
+		debug2("not removing system cg, there may be attached stepds: %m");
+		return SLURM_ERROR;
+	}
+
+	common_cgroup_destroy(&g_sys_cg);
+	return SLURM_SUCCESS;
+}
+
+extern int cgroup_p_step_create(cgroup_ctl_type_t sub, stepd_step_rec_t *job)
+{
+	switch (sub) {
+	case CG_TRACK:
+	case CG_CPUS:
+	case CG_MEMORY:
+		break;
+	default:
+		error("cgroup subsystem %u not supported", sub);
+		return SLURM_ERROR;
+	}
+
+	if (_step_hierarchy_create(job) != SLURM_SUCCESS)
+		return SLURM_ERROR;
+
+	/* Don't let other plugins destroy our structs. */
+	g_step_active_cnt[sub]++;
+
+	if (sub == CG_TRACK) {
+		/*
+		 * Keep slurmstepd out of the task cgroups, which can be frozen
+		 * to suspend the step.
+		 */
+		if (common_cgroup_add_pids(&g_step_slurm_cg, &job->jmgr_pid, 1)
+		    != SLURM_SUCCESS) {
+			cgroup_p_step_destroy(sub);
+			return SLURM_ERROR;
+		}
+
+		/* we use slurmstepd pid as the identifier of the container */
+		job->cont_id = (uint64_t)job->jmgr_pid;
+	}
+
+	return SLURM_SUCCESS;
+}
+
+extern int cgroup_p_step_addto(cgroup_ctl_type_t sub, pid_t *pids, int npids)
+{
+	int rc = SLURM_SUCCESS;
+
+	if (!g_task_special_cg.path)
+		return SLURM_ERROR;
+
+	switch (sub) {
+	case CG_TRACK:
+	case CG_CPUS:
+	case CG_MEMORY:
+		break;
+	default:
+		error("cgroup subsystem %u not supported", sub);
+		return SLURM_ERROR;
+	}
+
+	/*
+	 * All controllers share the directories, so a pid moved to its task
+	 * cgroup must not be sent back to task_special by another plugin.
+	 */
+	for (int i = 0; i < npids; i++) {
+		if (_pid_in_step(pids[i]))
+			continue;
+		if (common_cgroup_move_process(&g_task_special_cg, pids[i]) !=
+		    SLURM_SUCCESS)
+			rc = SLURM_ERROR;
+	}
+
+	return rc;
+}
+
+extern int cgroup_p_step_get_pids(pid_t **pids, int *npids)
+{
+	DIR *dir;
+	struct dirent *ent;
+	xcgroup_t cg;
+	pid_t *cg_pids;
+	int cg_npids;
+
+	if (!g_step_user_cg.path)
+		return SLURM_ERROR;
+
+	if (!(dir = opendir(g_step_user_cg.path))) {
+		error("unable to open %s: %m", g_step_user_cg.path);
+		return SLURM_ERROR;
+	}
+
+	*pids = NULL;
+	*npids = 0;
+
+	while ((ent = readdir(dir))) {
+		char *name = NULL;
+
+		if ((ent->d_type != DT_DIR) || (ent->d_name[0] == '.'))
+			continue;
+
+		xstrfmtcat(name, "%s/%s", g_step_user_cg.name, ent->d_name);
+		if (common_cgroup_create(&g_cg_ns, &cg, name, 0, 0) !=
+		    SLURM_SUCCESS) {
+			xfree(name);
+			continue;
+		}
+		xfree(name);
+
+		if ((common_cgroup_get_pids(&cg, &cg_pids, &cg_npids) ==
+		     SLURM_SUCCESS) && cg_npids) {
+			xrecalloc(*pids, (*npids + cg_npids), sizeof(pid_t));
+			memcpy(*pids + *npids, cg_pids,
+			       (cg_npids * sizeof(pid_t)));
+			*npids += cg_npids;
+		}
+		xfree(cg_pids);
+		common_cgroup_destroy(&cg);
+	}
+
+	closedir(dir);
+	return SLURM_SUCCESS;
+}
+
+extern int cgroup_p_step_suspend(void)
+{
+	if (!g_step_user_cg.path)
+		return SLURM_ERROR;
+
+	return common_cgroup_set_param(&g_step_user_cg, "cgroup.freeze", "1");
+}
+
+extern int cgroup_p_step_resume(void)
+{
+	if (!g_step_user_cg.path)
+		return SLURM_ERROR;
+
+	return common_cgroup_set_param(&g_step_user_cg, "cgroup.freeze", "0");
+}
+
+extern int cgroup_p_step_destroy(cgroup_ctl_type_t sub)
+{
+	int rc;
+
+	if (g_step_active_cnt[sub] == 0) {
+		debug("called without a previous init. This shouldn't happen!");
+		return SLURM_SUCCESS;
+	}
+
+	g_step_active_cnt[sub]--;
+
+	/* Only destroy the step if no controller is using it anymore. */
+	for (int i = 0; i < CG_CTL_CNT; i++) {
+		if (g_step_active_cnt[i]) {
+			debug2("Not destroying step dir, resource busy by %d other plugin",
+			       g_step_active_cnt[i]);
+			return SLURM_SUCCESS;
+		}
+	}
+
+	if ((rc = _step_hierarchy_destroy()) != SLURM_SUCCESS)
+		g_step_active_cnt[sub]++;
+
+	return rc;
+}
+
+extern bool cgroup_p_has_pid(pid_t pid)
+{
+	if (!g_step_user_cg.path)
+		return false;
+
+	return _pid_in_step(pid);
+}
+
+extern cgroup_limits_t *cgroup_p_root_constrain_get(cgroup_ctl_type_t sub)
+{
+	int rc = SLURM_SUCCESS;
+	cgroup_limits_t *limits = xmalloc(sizeof(*limits));
+
+	switch (sub) {
+	case CG_TRACK:
+		break;
+	case CG_CPUS:
+		/* The root cgroup only has the effective values */
+		rc = common_cgroup_get_param(&g_root_cg,
+					     "cpuset.cpus.effective",
+					     &limits->allow_cores,
+					     &limits->cores_size);
+
+		rc += common_cgroup_get_param(&g_root_cg,
+					      "cpuset.mems.effective",
+					      &limits->allow_mems,
+					      &limits->mems_size);
+
+		if (limits->cores_size > 0)
+			limits->allow_cores[(limits->cores_size)-1] = '\0';
+
+		if (limits->mems_size > 0)
+			limits->allow_mems[(limits->mems_size)-1] = '\0';
+
+		if (rc != SLURM_SUCCESS)
+			goto fail;
+		break;
+	case CG_MEMORY:
+		break;
+	default:
+		error("cgroup subsystem %u not supported", sub);
+		goto fail;
+	}
+
+	return limits;
+fail:
+	cgroup_free_limits(limits);
+	return NULL;
+}
+
+extern int cgroup_p_root_constrain_set(cgroup_ctl_type_t sub,
+				       cgroup_limits_t *limits)
+{
+	if (!limits)
+		return SLURM_ERROR;
+
+	switch (sub) {
+	case CG_TRACK:
+	case CG_CPUS:
+		break;
+	case CG_MEMORY:
+		debug("memory.swappiness does not exist in cgroup v2, ignoring MemorySwappiness");
+		break;
+	default:
+		error("cgroup subsystem %u not supported", sub);
+		return SLURM_ERROR;
+	}
+
+	return SLURM_SUCCESS;
+}
+
+extern cgroup_limits_t *cgroup_p_system_constrain_get(cgroup_ctl_type_t sub)
+{
+	switch (sub) {
+	case CG_TRACK:
+	case CG_CPUS:
+	case CG_MEMORY:
+		break;
+	default:
+		error("cgroup subsystem %u not supported", sub);
+		break;
+	}
+
+	return NULL;
+}
+
+extern int cgroup_p_system_constrain_set(cgroup_ctl_type_t sub,
+					 cgroup_limits_t *limits)
+{
+	int rc = SLURM_SUCCESS;
+
+	if (!limits)
+		return SLURM_ERROR;
+
+	switch (sub) {
+	case CG_TRACK:
+		break;
+	case CG_CPUS:
+		rc = common_cgroup_set_param(&g_sys_cg, "cpuset.cpus",
+					     limits->allow_cores);
+		break;
+	case CG_MEMORY:
+		rc = common_cgroup_set_uint64_param(&g_sys_cg, "memory.max",
+						    limits->limit_in_bytes);
+		break;
+	default:
+		error("cgroup subsystem %u not supported", sub);
+		rc = SLURM_ERROR;
+		break;
+	}
+
+	return rc;
+}
+
+extern int cgroup_p_user_constrain_set(cgroup_ctl_type_t sub,
+				       stepd_step_rec_t *job,
+				       cgroup_limits_t *limits)
+{
+	int rc = SLURM_SUCCESS;
+
+	if (!limits)
+		return SLURM_ERROR;
+
+	switch (sub) {
+	case CG_TRACK:
+		break;
+	case CG_CPUS:
+		rc = common_cgroup_set_param(&g_user_cg, "cpuset.cpus",
+					     limits->allow_cores);
+		rc += common_cgroup_set_param(&g_user_cg, "cpuset.mems",
+					      limits->allow_mems);
+		break;
+	case CG_MEMORY:
+		break;
+	default:
+		error("cgroup subsystem %u not supported", sub);
+		rc = SLURM_ERROR;
+		break;
+	}
+
+	return rc;
+}
+
+extern int cgroup_p_job_constrain_set(cgroup_ctl_type_t sub,
+				      stepd_step_rec_t *job,
+				      cgroup_limits_t *limits)
+{
+	int rc = SLURM_SUCCESS;
+
+	if (!limits)
+		return SLURM_ERROR;
+
+	switch (sub) {
+	case CG_TRACK:
+		break;
+	case CG_CPUS:
+		rc = common_cgroup_set_param(&g_job_cg, "cpuset.cpus",
+					     limits->allow_cores);
+		rc += common_cgroup_set_param(&g_job_cg, "cpuset.mems",
+					      limits->allow_mems);
+		break;
+	case CG_MEMORY:
+		rc = _set_memory_limits(&g_job_cg, limits);
+		break;
+	default:
+		error("cgroup subsystem %u not supported", sub);
+		rc = SLURM_ERROR;
+		break;
+	}
+
+	return rc;
+}
+
+extern int cgroup_p_step_constrain_set(cgroup_ctl_type_t sub,
+				       stepd_step_rec_t *job,
+				       cgroup_limits_t *limits)
+{
+	int rc = SLURM_SUCCESS;
+
+	if (!limits)
+		return SLURM_ERROR;
+
+	switch (sub) {
+	case CG_TRACK:
+		break;
+	case CG_CPUS:
+		rc = common_cgroup_set_param(&g_step_cg, "cpuset.cpus",
+					     limits->allow_cores);
+		rc += common_cgroup_set_param(&g_step_cg, "cpuset.mems",
+					      limits->allow_mems);
+		break;
+	case CG_MEMORY:
+		rc = _set_memory_limits(&g_step_cg, limits);
+		break;
+	default:
+		error("cgroup subsystem %u not supported", sub);
+		rc = SLURM_ERROR;
+		break;
+	}
+
+	return rc;
+}
+
+extern int cgroup_p_step_start_oom_mgr(void)
+{
+	oom_mgr_started = true;
+	return SLURM_SUCCESS;
+}
+
+extern cgroup_oom_t *cgroup_p_step_stop_oom_mgr(stepd_step_rec_t *job)
+{
+	cgroup_oom_t *results;
+
+	if (!oom_mgr_started) {
+		debug("OOM events were not monitored for %ps", &job->step_id);
+		return NULL;
+	}
+
+	/*
+	 * "max" counts the times the limit was hit, the equivalent of the v1
+	 * failcnt. The counters include the events of the child cgroups.
+	 */
+	results = xmalloc(sizeof(*results));
+	results->step_mem_failcnt = _get_event(&g_step_cg, "memory.events",
+					       "max");
+	results->step_memsw_failcnt = _get_event(&g_step_cg,
+						 "memory.swap.events", "max");
+	results->job_mem_failcnt = _get_event(&g_job_cg, "memory.events",
+					      "max");
+	results->job_memsw_failcnt = _get_event(&g_job_cg,
+						"memory.swap.events", "max");
+	results->oom_kill_cnt = _get_event(&g_step_cg, "memory.events",
+					   "oom_kill");
+
+	oom_mgr_started = false;
+	return results;
+}
+
+/***************************************
+ ***** CGROUP ACCOUNTING FUNCTIONS *****
+ **************************************/
+static int _find_task_cg_info(void *x, void *key)
+{
+	task_cg_info_t *task_cg = (task_cg_info_t*)x;
+	uint32_t taskid = *(uint32_t*)key;
+
+	if (task_cg->taskid == taskid)
+		return 1;
+
+	return 0;
+}
+
+static void _free_task_cg_info(void *object)
+{
+	task_cg_info_t *task_cg = (task_cg_info_t *)object;
+
+	if (task_cg) {
+		common_cgroup_destroy(&task_cg->task_cg);
+		xfree(task_cg);
+	}
+}
+
+extern int cgroup_p_accounting_init(void)
+{
+	int rc;
+
+	if ((rc = cgroup_p_initialize(CG_MEMORY)) != SLURM_SUCCESS) {
+		error("Cannot initialize cgroup memory accounting");
+		return rc;
+	}
+
+	g_step_active_cnt[CG_MEMORY]++;
+	g_step_active_cnt[CG_CPUACCT]++;
+
+	/* Create the list of tasks which will be accounted for*/
+	FREE_NULL_LIST(g_task_acct_list);
+	g_task_acct_list = list_create(_free_task_cg_info);
+
+	return rc;
+}
+
+extern int cgroup_p_accounting_fini(void)
+{
+	int rc;
+
+	/* Empty the list of accounted tasks, do a best effort in rmdir */
+	(void) list_for_each(g_task_acct_list, _rmdir_task, NULL);
+	list_flush(g_task_acct_list);
+
+	/* Remove job/uid/step directories */
+	rc = cgroup_p_step_destroy(CG_MEMORY);
+	rc += cgroup_p_step_destroy(CG_CPUACCT);
+
+	return rc;
+}
+
+extern int cgroup_p_task_addto_accounting(pid_t pid, stepd_step_rec_t *job,
+					  uint32_t task_id)
+{
+	task_cg_info_t *task_cg_info;
+	char *task_cgroup_path = NULL;
+	int rc;
+
+	if (task_id > g_max_task_id)
+		g_max_task_id = task_id;
+
+	debug("%ps taskid %u max_task_id %u", &job->step_id, task_id,
+	      g_max_task_id);
+
+	if (_step_hierarchy_create(job) != SLURM_SUCCESS)
+		return SLURM_ERROR;
+
+	if (!(task_cg_info = list_find_first(g_task_acct_list,
+					     _find_task_cg_info, &task_id))) {
+		task_cg_info = xmalloc(sizeof(*task_cg_info));
+		task_cg_info->taskid = task_id;
+
+		xstrfmtcat(task_cgroup_path, "%s/task_%u",
+			   g_step_user_cg.name, task_id);
+		rc = _create_cg(&task_cg_info->task_cg, task_cgroup_path,
+				job->uid, job->gid);
+		xfree(task_cgroup_path);
+
+		if (rc != SLURM_SUCCESS) {
+			xfree(task_cg_info);
+			error("unable to create task %u cgroup", task_id);
+			return SLURM_ERROR;
+		}
+
+		list_append(g_task_acct_list, task_cg_info);
+	}
+
+	/* Attach the pid to the corresponding step_x/user/task_y cgroup */
+	if ((rc = common_cgroup_move_process(&task_cg_info->task_cg, pid)) !=
+	    SLURM_SUCCESS)
+		error("Unable to move pid %d to %s cg", pid,
+		      task_cg_info->task_cg.path);
+
+	return rc;
+}
+
+extern cgroup_acct_t *cgroup_p_task_get_acct_data(uint32_t taskid)
+{
+	char *cpu_stat = NULL, *memory_stat = NULL, *memory_peak = NULL;
+	char *io_stat = NULL, *ptr;
+	size_t sz;
+	cgroup_acct_t *stats = NULL;
+	task_cg_info_t *task_cg_info;
+	uint64_t value;
+
+	if (!(task_cg_info = list_find_first(g_task_acct_list,
+					     _find_task_cg_info, &taskid))) {
+		error("Could not find task_cg_info, this should never happen");
+		return NULL;
+	}
+
+	/*
+	 * Initialize values, a NO_VAL64 will indicate to the caller that
+	 * something happened here.
+	 */
+	stats = xmalloc(sizeof(*stats));
+	stats->usec = NO_VAL64;
+	stats->ssec = NO_VAL64;
+	stats->total_rss = NO_VAL64;
+	stats->total_pgmajfault = NO_VAL64;
+	stats->memory_peak = NO_VAL64;
+	stats->total_read_bytes = NO_VAL64;
+	stats->total_write_bytes = NO_VAL64;
+
+	/* Times are in usec, callers expect clock ticks as in cpuacct.stat */
+	if (common_cgroup_get_param(&task_cg_info->task_cg, "cpu.stat",
+				    &cpu_stat, &sz) == SLURM_SUCCESS) {
+		if (_get_key_value(cpu_stat, "user_usec", &value))
+			stats->usec = value * g_clk_tck / USEC_IN_SEC;
+		if (_get_key_value(cpu_stat, "system_usec", &value))
+			stats->ssec = value * g_clk_tck / USEC_IN_SEC;
+	}
+
+	/* "anon" is what total_rss is in cgroup v1 */
+	if (common_cgroup_get_param(&task_cg_info->task_cg, "memory.stat",
+				    &memory_stat, &sz) == SLURM_SUCCESS) {
+		_get_key_value(memory_stat, "anon", &stats->total_rss);
+		_get_key_value(memory_stat, "pgmajfault",
+			       &stats->total_pgmajfault);
+	}
+
+	/* Only in kernels >= 5.19 */
+	if (common_cgroup_get_param(&task_cg_info->task_cg, "memory.peak",
+				    &memory_peak, &sz) == SLURM_SUCCESS)
+		stats->memory_peak = strtoull(memory_peak, NULL, 10);
+
+	/*
+	 * One line per device:
+	 * <major>:<minor> rbytes=<n> wbytes=<n> rios=<n> wios=<n> ...
+	 * Only there if the io controller is enabled.
+	 */
+	if (common_cgroup_get_param(&task_cg_info->task_cg, "io.stat",
+				    &io_stat, &sz) == SLURM_SUCCESS) {
+		stats->total_read_bytes = 0;
+		stats->total_write_bytes = 0;
+		for (ptr = io_stat; (ptr = strstr(ptr, "bytes=")); ptr += 6) {
+			if (ptr[-1] == 'r')
+				stats->total_read_bytes +=
+					strtoull(ptr + 6, NULL, 10);
+			else if (ptr[-1] == 'w')
+				stats->total_write_bytes +=
+					strtoull(ptr + 6, NULL, 10);
+		}
+	}
+
+	xfree(cpu_stat);
+	xfree(memory_stat);
+	xfree(memory_peak);
+	xfree(io_stat);
+
+	return stats;
+}
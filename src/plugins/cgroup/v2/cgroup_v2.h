@@ -0,0 +1,170 @@
+/*****************************************************************************\
+ *  cgroup_v2.h - Cgroup v2 plugin
+ *****************************************************************************
+ *  Copyright (C) 2021 SchedMD LLC
+ *
+ *  This file is part of Slurm, a resource management program.
+ *  For details, see <https://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  Slurm is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  Slurm is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with Slurm; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+#ifndef _CGROUP_V2_H
+#define _CGROUP_V2_H
+
+#include <dirent.h>
+
+#include "slurm/slurm.h"
+#include "slurm/slurm_errno.h"
+
+#include "src/common/cgroup.h"
+#include "src/common/list.h"
+#include "src/common/log.h"
+#include "src/common/xassert.h"
+#include "src/common/xmalloc.h"
+#include "src/common/xstring.h"
+#include "src/slurmd/slurmd/slurmd.h"
+#include "src/slurmd/slurmstepd/slurmstepd_job.h"
+#include "src/plugins/cgroup/common/cgroup_common.h"
+
+/*
+ * The unified hierarchy only has one tree, so all controllers share the same
+ * directories:
+ *
+ * <mnt>/<prepend>/system                         slurmd (specialized cores)
+ * <mnt>/<prepend>/uid_<uid>/job_<jobid>/step_<stepid>/slurm   slurmstepd
+ * <mnt>/<prepend>/uid_<uid>/job_<jobid>/step_<stepid>/user/task_<taskid>
+ * <mnt>/<prepend>/uid_<uid>/job_<jobid>/step_<stepid>/user/task_special
+ *
+ * Processes can only live in the leaves, since a cgroup distributing
+ * controllers to its children can not have processes of its own. Pids of the
+ * step not yet assigned to a task are kept in task_special.
+ *
+ * The functions below have the same interface as the ones described in
+ * cgroup_v1.h, only what is particular to cgroup v2 is documented here.
+ */
+
+/* Functions */
+extern int init(void);
+extern int fini(void);
+
+/*
+ * Load the unified hierarchy mounted at CgroupMountpoint. CG_DEVICES is not
+ * supported since device constraints need a BPF program in cgroup v2.
+ */
+extern int cgroup_p_initialize(cgroup_ctl_type_t sub);
+
+extern int cgroup_p_system_create(cgroup_ctl_type_t sub);
+
+extern int cgroup_p_system_addto(cgroup_ctl_type_t sub, pid_t *pids, int npids);
+
+extern int cgroup_p_system_destroy(cgroup_ctl_type_t sub);
+
+/*
+ * Create the step hierarchy the first time it is called for any controller
+ * and enable the available controllers on every level of it. CG_TRACK puts
+ * slurmstepd in the step's slurm leaf.
+ */
+extern int cgroup_p_step_create(cgroup_ctl_type_t sub, stepd_step_rec_t *job);
+
+/*
+ * Put pids in task_special unless they are already in a task cgroup of this
+ * step.
+ */
+extern int cgroup_p_step_addto(cgroup_ctl_type_t sub, pid_t *pids, int npids);
+
+/*
+ * Get the pids of all the task cgroups of the step. slurmstepd is not
+ * included.
+ */
+extern int cgroup_p_step_get_pids(pid_t **pids, int *npids);
+
+/* Freeze the tasks of the step with cgroup.freeze */
+extern int cgroup_p_step_suspend(void);
+
+/* Thaw the tasks of the step with cgroup.freeze */
+extern int cgroup_p_step_resume(void);
+
+/*
+ * Remove the step hierarchy once no controller uses it anymore.
+ */
+extern int cgroup_p_step_destroy(cgroup_ctl_type_t sub);
+
+extern bool cgroup_p_has_pid(pid_t pid);
+
+extern cgroup_limits_t *cgroup_p_root_constrain_get(cgroup_ctl_type_t sub);
+
+extern int cgroup_p_root_constrain_set(cgroup_ctl_type_t sub,
+				       cgroup_limits_t *limits);
+
+extern cgroup_limits_t *cgroup_p_system_constrain_get(cgroup_ctl_type_t sub);
+
+extern int cgroup_p_system_constrain_set(cgroup_ctl_type_t sub,
+					 cgroup_limits_t *limits);
+
+extern int cgroup_p_user_constrain_set(cgroup_ctl_type_t sub,
+				       stepd_step_rec_t *job,
+				       cgroup_limits_t *limits);
+
+/*
+ * Memory limits are set in memory.max and memory.swap.max. There is no kernel
+ * memory limit in cgroup v2.
+ */
+extern int cgroup_p_job_constrain_set(cgroup_ctl_type_t sub,
+				      stepd_step_rec_t *job,
+				      cgroup_limits_t *limits);
+
+extern int cgroup_p_step_constrain_set(cgroup_ctl_type_t sub,
+				       stepd_step_rec_t *job,
+				       cgroup_limits_t *limits);
+
+/*
+ * The kernel counts the OOM events in memory.events, so no monitoring thread
+ * is needed. The counters are read when the step finishes.
+ */
+extern int cgroup_p_step_start_oom_mgr(void);
+
+extern cgroup_oom_t *cgroup_p_step_stop_oom_mgr(stepd_step_rec_t *job);
+
+extern int cgroup_p_accounting_init(void);
+
+extern int cgroup_p_accounting_fini(void);
+
+/*
+ * Create the task_<task_id> leaf of the step and move pid into it.
+ */
+extern int cgroup_p_task_addto_accounting(pid_t pid, stepd_step_rec_t *job,
+					  uint32_t task_id);
+
+/*
+ * Read cpu.stat, memory.stat, memory.peak and io.stat of the task cgroup.
+ * These are kept by the kernel for all the processes of the task, so the cost
+ * does not depend on how many processes the task has.
+ */
+extern cgroup_acct_t *cgroup_p_task_get_acct_data(uint32_t taskid);
+
+#endif /* !_CGROUP_V2_H */
@@ -45,6 +45,8 @@
 #include "src/common/slurm_protocol_api.h"
 #include "src/common/slurm_protocol_defs.h"
 #include "src/common/slurm_acct_gather_energy.h"
+#include "src/common/slurm_acct_gather_filesystem.h"
+#include "src/common/slurm_acct_gather_interconnect.h"
 #include "src/common/xstring.h"
 #include "src/common/cgroup.h"
 #include "src/slurmd/common/proctrack.h"
@@ -82,6 +84,9 @@ const char plugin_name[] = "Job accounting gather cgroup plugin";
 const char plugin_type[] = "jobacct_gather/cgroup";
 const uint32_t plugin_version = SLURM_VERSION_NUMBER;
 
+/* Only read the task cgroups, not /proc (cgroup v2) */
+static bool use_task_cgroups = false;
+
 static void _prec_extra(jag_prec_t *prec, uint32_t taskid)
 {
 	cgroup_acct_t *cgroup_acct_data;
@@ -129,6 +134,65 @@ static void _prec_extra(jag_prec_t *prec, uint32_t taskid)
 	return;
 }
 
+/*
+ * With cgroup v2 the task cgroups have all the counters we need, including
+ * I/O and the peak memory, so there is no need to look at every process of
+ * the step. This makes polling cost O(tasks) instead of O(processes).
+ */
+static List _get_precs_cgroup(List task_list, bool pgid_plugin,
+			      uint64_t cont_id, jag_callbacks_t *callbacks)
+{
+	struct jobacctinfo *jobacct;
+	cgroup_acct_t *cgroup_acct_data;
+	ListIterator itr;
+	jag_prec_t *prec;
+
+	itr = list_iterator_create(task_list);
+	while ((jobacct = list_next(itr))) {
+		cgroup_acct_data =
+			cgroup_g_task_get_acct_data(jobacct->id.taskid);
+		if (!cgroup_acct_data) {
+			error("Cannot get cgroup accounting data for %d",
+			      jobacct->id.taskid);
+			continue;
+		}
+
+		prec = jag_common_add_prec(jobacct->pid, jobacct->tres_count);
+
+		if (cgroup_acct_data->usec != NO_VAL64)
+			prec->usec = cgroup_acct_data->usec;
+		if (cgroup_acct_data->ssec != NO_VAL64)
+			prec->ssec = cgroup_acct_data->ssec;
+		if (cgroup_acct_data->total_rss != NO_VAL64)
+			prec->tres_data[TRES_ARRAY_MEM].size_read =
+				cgroup_acct_data->total_rss;
+		if (cgroup_acct_data->total_pgmajfault != NO_VAL64)
+			prec->tres_data[TRES_ARRAY_PAGES].size_read =
+				cgroup_acct_data->total_pgmajfault;
+		if (cgroup_acct_data->memory_peak != NO_VAL64)
+			prec->mem_peak = cgroup_acct_data->memory_peak;
+
+		/* Bytes read from and written to block devices */
+		if (cgroup_acct_data->total_read_bytes != NO_VAL64)
+			prec->tres_data[TRES_ARRAY_FS_DISK].size_read =
+				cgroup_acct_data->total_read_bytes;
+		if (cgroup_acct_data->total_write_bytes != NO_VAL64)
+			prec->tres_data[TRES_ARRAY_FS_DISK].size_write =
+				cgroup_acct_data->total_write_bytes;
+
+		if (acct_gather_filesystem_g_get_data(prec->tres_data) < 0)
+			log_flag(JAG, "problem retrieving filesystem data");
+
+		if (acct_gather_interconnect_g_get_data(prec->tres_data) < 0)
+			log_flag(JAG, "problem retrieving interconnect data");
+
+		xfree(cgroup_acct_data);
+	}
+	list_iterator_destroy(itr);
+
+	return prec_list;
+}
+
 /*
  * init() is called when the plugin is loaded, before any other functions
  * are called.  Put global initialization here.
@@ -146,6 +210,8 @@ extern int init (void)
 			xcpuinfo_fini();
 			return SLURM_ERROR;
 		}
+
+		use_task_cgroups = cgroup_g_unified_hierarchy();
 	}
 
 	debug("%s loaded", plugin_name);
@@ -190,7 +256,10 @@ extern void jobacct_gather_p_poll_data(List task_list, bool pgid_plugin,
 	if (first) {
 		memset(&callbacks, 0, sizeof(jag_callbacks_t));
 		first = 0;
-		callbacks.prec_extra = _prec_extra;
+		if (use_task_cgroups)
+			callbacks.get_precs = _get_precs_cgroup;
+		else
+			callbacks.prec_extra = _prec_extra;
 	}
 
 	jag_common_poll_data(task_list, pgid_plugin, cont_id, &callbacks,
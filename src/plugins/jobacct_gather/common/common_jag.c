@@ -41,6 +41,7 @@
 #include <dirent.h>
 #include <fcntl.h>
 #include <signal.h>
+#include <sys/resource.h>
 #include <time.h>
 #include <ctype.h>
 
@@ -52,6 +53,7 @@
 #include "src/common/slurm_acct_gather_energy.h"
 #include "src/common/slurm_acct_gather_filesystem.h"
 #include "src/common/slurm_acct_gather_interconnect.h"
+#include "src/common/xhash.h"
 #include "src/common/xstring.h"
 #include "src/slurmd/common/proctrack.h"
 
@@ -78,6 +80,42 @@ static int my_pagesize = 0;
 static DIR  *slash_proc = NULL;
 static int energy_profile = ENERGY_DATA_NODE_ENERGY_UP;
 
+/*
+ * Files of /proc/<pid> read on every poll. They are kept open between polls
+ * for the pids of the proctrack container and read again with pread().
+ */
+enum {
+	JAG_PROC_STAT,
+	JAG_PROC_STATM,
+	JAG_PROC_IO,
+	JAG_PROC_PSS,
+	JAG_PROC_FILE_CNT
+};
+
+static const char *proc_file_names[JAG_PROC_FILE_CNT] = {
+	"stat", "statm", "io", "smaps_rollup"
+};
+
+typedef struct {
+	pid_t pid;
+	int fd[JAG_PROC_FILE_CNT];
+	int lwp;		/* _is_a_lwp() result, -1 if not known yet */
+	uint32_t poll_id;	/* last poll that saw this pid */
+	bool cached;		/* in proc_files and counted in cached_fds */
+} jag_proc_files_t;
+
+static xhash_t *proc_files = NULL;
+static int cached_fds = 0;
+static int max_cached_fds = 0;
+static uint32_t poll_id = 0;
+static bool use_smaps_rollup = false;
+
+/* sampling overhead */
+static uint64_t poll_count = 0;
+static uint64_t poll_usec_tot = 0;
+static uint64_t poll_usec_max = 0;
+static uint64_t sampled_pids = 0;
+
 static int _find_prec(void *x, void *key)
 {
 	jag_prec_t *prec = (jag_prec_t *) x;
@@ -141,65 +179,6 @@ inline static bool _get_freq(char *str)
 	return true;
 }
 
-/*
- * collects the Pss value from /proc/<pid>/smaps
- */
-static int _get_pss(char *proc_smaps_file, jag_prec_t *prec)
-{
-        uint64_t pss;
-	uint64_t p;
-        char line[128];
-        FILE *fp;
-	int i;
-
-	fp = fopen(proc_smaps_file, "r");
-        if (!fp) {
-                return -1;
-        }
-
-	if (fcntl(fileno(fp), F_SETFD, FD_CLOEXEC) == -1)
-		error("%s: fcntl(%s): %m", __func__, proc_smaps_file);
-	pss = 0;
-
-        while (fgets(line,sizeof(line),fp)) {
-
-                if (xstrncmp(line, "Pss:", 4) != 0) {
-                        continue;
-                }
-
-                for (i = 4; i < sizeof(line); i++) {
-
-                        if (!isdigit(line[i])) {
-                                continue;
-                        }
-                        if (sscanf(&line[i],"%"PRIu64"", &p) == 1) {
-                                pss += p;
-                        }
-                        break;
-                }
-        }
-
-	/* Check for error
-	 */
-	if (ferror(fp)) {
-		fclose(fp);
-		return -1;
-	}
-
-        fclose(fp);
-        /* Sanity checks */
-
-        if (pss > 0 && prec->tres_data[TRES_ARRAY_MEM].size_read > pss) {
-		pss *= 1024; /* Scale KB to B */
-                prec->tres_data[TRES_ARRAY_MEM].size_read = pss;
-        }
-
-	log_flag(JAG, "%s read pss %"PRIu64" for process %s",
-		 __func__, pss, proc_smaps_file);
-
-        return 0;
-}
-
 static int _get_sys_interface_freq_line(uint32_t cpu, char *filename,
 					char * sbuf)
 {
@@ -248,7 +227,251 @@ static int _get_sys_interface_freq_line(uint32_t cpu, char *filename,
 	return 0;
 }
 
-static int _is_a_lwp(uint32_t pid)
+static void _free_proc_files(void *object)
+{
+	jag_proc_files_t *files = object;
+
+	for (int i = 0; i < JAG_PROC_FILE_CNT; i++) {
+		if (files->fd[i] < 0)
+			continue;
+		(void) close(files->fd[i]);
+		if (files->cached)
+			cached_fds--;
+	}
+
+	xfree(files);
+}
+
+static void _proc_files_id(void *item, const char **key, uint32_t *key_len)
+{
+	jag_proc_files_t *files = item;
+
+	*key = (const char *) &files->pid;
+	*key_len = sizeof(files->pid);
+}
+
+static jag_proc_files_t *_new_proc_files(pid_t pid, bool cache)
+{
+	jag_proc_files_t *files = xmalloc(sizeof(*files));
+
+	files->pid = pid;
+	files->lwp = -1;
+	files->cached = cache;
+	for (int i = 0; i < JAG_PROC_FILE_CNT; i++)
+		files->fd[i] = -1;
+
+	if (cache)
+		xhash_add(proc_files, files);
+
+	return files;
+}
+
+/*
+ * Get the open files of a pid from proctrack, keeping them open for the next
+ * poll unless that would use too many file descriptors.
+ */
+static jag_proc_files_t *_get_proc_files(pid_t pid)
+{
+	jag_proc_files_t *files = xhash_get(proc_files, (const char *) &pid,
+					    sizeof(pid));
+
+	if (!files)
+		files = _new_proc_files(pid, ((cached_fds + JAG_PROC_FILE_CNT)
+					      <= max_cached_fds));
+
+	files->poll_id = poll_id;
+
+	return files;
+}
+
+static void _find_stale_proc_files(void *item, void *arg)
+{
+	jag_proc_files_t *files = item;
+
+	if (files->poll_id != poll_id)
+		list_append(arg, &files->pid);
+}
+
+/* Close the files of pids which are no longer in the container */
+static void _prune_proc_files(void)
+{
+	List stale;
+	pid_t *pid;
+
+	if (!xhash_count(proc_files))
+		return;
+
+	stale = list_create(NULL);
+	xhash_walk(proc_files, _find_stale_proc_files, stale);
+	while ((pid = list_pop(stale)))
+		xhash_delete(proc_files, (const char *) pid, sizeof(*pid));
+	FREE_NULL_LIST(stale);
+}
+
+static int _open_proc_file(pid_t pid, const char *name)
+{
+	char path[64];
+
+	snprintf(path, sizeof(path), "/proc/%d/%s", pid, name);
+
+	/* Never leak these into user tasks */
+	return open(path, (O_RDONLY | O_CLOEXEC));
+}
+
+/*
+ * Read /proc/<pid>/<file> into buf from the start with pread() so the file
+ * descriptor can be reused by the next poll.
+ * RET number of bytes read or -1 if the process went away
+ */
+static ssize_t _read_proc_file(jag_proc_files_t *files, int file, char *buf,
+			       size_t size)
+{
+	int *fd = &files->fd[file];
+	bool reopened = false;
+	int attempts = 1;
+	ssize_t n;
+
+	xassert(file < JAG_PROC_FILE_CNT);
+
+	if (*fd < 0) {
+again:
+		if ((*fd = _open_proc_file(files->pid,
+					   proc_file_names[file])) < 0)
+			return -1;
+		if (files->cached)
+			cached_fds++;
+		reopened = true;
+	}
+
+	while (((n = pread(*fd, buf, (size - 1), 0)) < 0) &&
+	       ((errno == EINTR) || (errno == EAGAIN)) && (attempts < 100))
+		attempts++;
+
+	if (n <= 0) {
+		(void) close(*fd);
+		*fd = -1;
+		if (files->cached)
+			cached_fds--;
+
+		/*
+		 * A file kept open from an earlier poll belongs to the process
+		 * that had the pid back then. If it went away and the pid was
+		 * reused, start over with the new process.
+		 */
+		if (!reopened) {
+			files->lwp = -1;
+			goto again;
+		}
+
+		return -1;
+	}
+
+	buf[n] = '\0';
+	return n;
+}
+
+/*
+ * Parse the next space separated integer in *ptr and advance *ptr past it.
+ * RET true on success or false if there is no integer
+ */
+static bool _next_int(char **ptr, int64_t *value)
+{
+	char *p = *ptr;
+	bool negative = false;
+	uint64_t v = 0;
+
+	while (*p == ' ')
+		p++;
+
+	if (*p == '-') {
+		negative = true;
+		p++;
+	}
+
+	if ((*p < '0') || (*p > '9'))
+		return false;
+
+	while ((*p >= '0') && (*p <= '9'))
+		v = (v * 10) + (*p++ - '0');
+
+	*value = negative ? -((int64_t) v) : (int64_t) v;
+	*ptr = p;
+
+	return true;
+}
+
+/*
+ * collects the Pss value from /proc/<pid>/smaps_rollup or /proc/<pid>/smaps
+ */
+static int _get_pss(jag_proc_files_t *files, jag_prec_t *prec)
+{
+	uint64_t pss = 0;
+	int64_t p;
+
+	if (use_smaps_rollup) {
+		char sbuf[4096], *ptr;
+
+		if (_read_proc_file(files, JAG_PROC_PSS, sbuf,
+				    sizeof(sbuf)) < 0)
+			return -1;
+
+		for (ptr = sbuf; ptr; ptr = strchr(ptr, '\n')) {
+			if (*ptr == '\n')
+				ptr++;
+			if (!xstrncmp(ptr, "Pss:", 4)) {
+				ptr += 4;
+				if (_next_int(&ptr, &p))
+					pss += p;
+			}
+		}
+	} else {
+		char proc_smaps_file[64];
+		char line[128];
+		FILE *fp;
+		int i;
+
+		snprintf(proc_smaps_file, sizeof(proc_smaps_file),
+			 "/proc/%d/smaps", files->pid);
+
+		if (!(fp = fopen(proc_smaps_file, "re")))
+			return -1;
+
+		while (fgets(line, sizeof(line), fp)) {
+			if (xstrncmp(line, "Pss:", 4) != 0)
+				continue;
+
+			for (i = 4; i < sizeof(line); i++) {
+				if (!isdigit(line[i]))
+					continue;
+				if (sscanf(&line[i], "%"PRIu64"",
+					   (uint64_t *) &p) == 1)
+					pss += p;
+				break;
+			}
+		}
+
+		/* Check for error */
+		if (ferror(fp)) {
+			fclose(fp);
+			return -1;
+		}
+
+		fclose(fp);
+	}
+
+	/* Sanity checks */
+	if (pss > 0 && prec->tres_data[TRES_ARRAY_MEM].size_read > pss) {
+		pss *= 1024; /* Scale KB to B */
+		prec->tres_data[TRES_ARRAY_MEM].size_read = pss;
+	}
+
+	log_flag(JAG, "%s read pss %"PRIu64" for process %d",
+		 __func__, pss, files->pid);
+
+	return 0;
+}
+
+static int _is_a_lwp(jag_proc_files_t *files)
 {
 	char *filename = NULL;
 	char bf[4096];
@@ -257,9 +480,13 @@ static int _is_a_lwp(uint32_t pid)
 	char *tgids = NULL;
 	pid_t tgid = -1;
 
-	xstrfmtcat(filename, "/proc/%u/status", pid);
+	/* only changes if the pid is reused */
+	if (files->lwp != -1)
+		return files->lwp;
 
-	fd = open(filename, O_RDONLY);
+	xstrfmtcat(filename, "/proc/%u/status", files->pid);
+
+	fd = open(filename, (O_RDONLY | O_CLOEXEC));
 	if (fd < 0) {
 		xfree(filename);
 		return SLURM_ERROR;
@@ -285,78 +512,69 @@ again:
 	if (tgids) {
 		tgids += 5; /* strlen("Tgid:") */
 		tgid = atoi(tgids);
-	} else
-		error("%s: Tgid: string not found for pid=%u", __func__, pid);
+	} else {
+		error("%s: Tgid: string not found for pid=%u",
+		      __func__, files->pid);
+		return SLURM_ERROR;
+	}
 
-	if (pid != (uint32_t)tgid) {
+	if (files->pid != tgid) {
 		log_flag(JAG, "pid=%u != tgid=%u is a lightweight process",
-			 pid, tgid);
-		return 1;
+			 files->pid, tgid);
+		files->lwp = 1;
 	} else {
 		log_flag(JAG, "pid=%u == tgid=%u is the leader LWP",
-			 pid, tgid);
-		return 0;
+			 files->pid, tgid);
+		files->lwp = 0;
 	}
+
+	return files->lwp;
 }
 
 /* _get_process_data_line() - get line of data from /proc/<pid>/stat
  *
- * IN:	in - input file descriptor
+ * IN:	files - open files of the process
  * OUT:	prec - the destination for the data
  *
  * RETVAL:	==0 - no valid data
  * 		!=0 - data are valid
  *
- * Based upon stat2proc() from the ps command. It can handle arbitrary
- * executable file basenames for `cmd', i.e. those with embedded whitespace or
- * embedded ')'s. Such names confuse %s (see scanf(3)), so the string is split
- * and %39c is used instead. (except for embedded ')' "(%[^)]c)" would work.
+ * The executable file basename (`cmd') can contain whitespace and ')' so the
+ * fields are parsed starting after the last ')' in the line.
  */
-static int _get_process_data_line(int in, jag_prec_t *prec) {
-	char sbuf[512], *tmp;
-	int num_read, nvals;
-	char cmd[40], state[1];
-	int ppid, pgrp, session, tty_nr, tpgid;
-	long unsigned flags, minflt, cminflt, majflt, cmajflt;
-	long unsigned utime, stime, starttime, vsize;
-	long int cutime, cstime, priority, nice, timeout, itrealvalue, rss;
-	long unsigned f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13;
-	int exit_signal, last_cpu;
-
-	num_read = read(in, sbuf, (sizeof(sbuf) - 1));
-	if (num_read <= 0)
-		return 0;
-	sbuf[num_read] = '\0';
-
+static int _get_process_data_line(jag_proc_files_t *files, jag_prec_t *prec)
+{
 	/*
-	 * split into "PID (cmd" and "<rest>" replace trailing ')' with NULL
+	 * Fields after "pid (cmd) state" in the order given by proc(5),
+	 * numbered from state. There are some additional fields, which we do
+	 * not parse or use.
 	 */
-	tmp = strrchr(sbuf, ')');
-	if (!tmp)
+	enum {
+		STAT_PPID = 1,
+		STAT_MAJFLT = 9,
+		STAT_UTIME = 11,
+		STAT_STIME = 12,
+		STAT_VSIZE = 20,
+		STAT_RSS = 21,
+		STAT_LAST_CPU = 36,
+		STAT_FIELDS
+	};
+	char sbuf[1024], *ptr;
+	int64_t fields[STAT_FIELDS];
+
+	if (_read_proc_file(files, JAG_PROC_STAT, sbuf, sizeof(sbuf)) <= 0)
 		return 0;
-	*tmp = '\0';
 
-	/* parse these two strings separately, skipping the leading "(". */
-	nvals = sscanf(sbuf, "%d (%39c", &prec->pid, cmd);
-	if (nvals < 2)
+	/* skip "PID (cmd) " and the single character state */
+	if (!(ptr = strrchr(sbuf, ')')) || (ptr[1] != ' ') || !ptr[2])
 		return 0;
+	ptr += 3;
 
-	nvals = sscanf(tmp + 2,	 /* skip space after ')' too */
-		       "%c %d %d %d %d %d "
-		       "%lu %lu %lu %lu %lu "
-		       "%lu %lu %ld %ld %ld %ld "
-		       "%ld %ld %lu %lu %ld "
-		       "%lu %lu %lu %lu %lu "
-		       "%lu %lu %lu %lu %lu "
-		       "%lu %lu %lu %d %d ",
-		       state, &ppid, &pgrp, &session, &tty_nr, &tpgid,
-		       &flags, &minflt, &cminflt, &majflt, &cmajflt,
-		       &utime, &stime, &cutime, &cstime, &priority, &nice,
-		       &timeout, &itrealvalue, &starttime, &vsize, &rss,
-		       &f1, &f2, &f3, &f4, &f5 ,&f6, &f7, &f8, &f9, &f10, &f11,
-		       &f12, &f13, &exit_signal, &last_cpu);
-	/* There are some additional fields, which we do not scan or use */
-	if ((nvals < 37) || (rss < 0))
+	for (int i = STAT_PPID; i < STAT_FIELDS; i++)
+		if (!_next_int(&ptr, &fields[i]))
+			return 0;
+
+	if (fields[STAT_RSS] < 0)
 		return 0;
 
 	/*
@@ -364,29 +582,31 @@ static int _get_process_data_line(int in, jag_prec_t *prec) {
 	 * or there was an error, skip it, we will only account the original
 	 * process (pid==tgid).
 	 */
-	if (_is_a_lwp(prec->pid))
+	if (_is_a_lwp(files))
 		return 0;
 
 	/* Copy the values that slurm records into our data structure */
-	prec->ppid  = ppid;
+	prec->pid = files->pid;
+	prec->ppid = fields[STAT_PPID];
 
-	prec->tres_data[TRES_ARRAY_PAGES].size_read = majflt;
-	prec->tres_data[TRES_ARRAY_VMEM].size_read = vsize;
-	prec->tres_data[TRES_ARRAY_MEM].size_read = rss * my_pagesize;
+	prec->tres_data[TRES_ARRAY_PAGES].size_read = fields[STAT_MAJFLT];
+	prec->tres_data[TRES_ARRAY_VMEM].size_read = fields[STAT_VSIZE];
+	prec->tres_data[TRES_ARRAY_MEM].size_read =
+		fields[STAT_RSS] * my_pagesize;
 
 	/*
 	 * Store unnormalized times, we will normalize in when
 	 * transfering to a struct jobacctinfo in job_common_poll_data()
 	 */
-	prec->usec = (double)utime;
-	prec->ssec = (double)stime;
-	prec->last_cpu = last_cpu;
+	prec->usec = (double) fields[STAT_UTIME];
+	prec->ssec = (double) fields[STAT_STIME];
+	prec->last_cpu = fields[STAT_LAST_CPU];
 	return 1;
 }
 
 /* _get_process_memory_line() - get line of data from /proc/<pid>/statm
  *
- * IN:	in - input file descriptor
+ * IN:	files - open files of the process
  * OUT:	prec - the destination for the data
  *
  * RETVAL:	==0 - no valid data
@@ -397,58 +617,37 @@ static int _get_process_data_line(int in, jag_prec_t *prec) {
  * and return the updated struct.
  *
  */
-static int _get_process_memory_line(int in, jag_prec_t *prec)
+static int _get_process_memory_line(jag_proc_files_t *files,
+				    jag_prec_t *prec)
 {
-	char sbuf[256];
-	int num_read, nvals;
-	long int size, rss, share, text, lib, data, dt;
+	char sbuf[256], *ptr = sbuf;
+	/* size, rss, share, text, lib, data, dt */
+	int64_t fields[7];
 
-	num_read = read(in, sbuf, (sizeof(sbuf) - 1));
-	if (num_read <= 0)
+	if (_read_proc_file(files, JAG_PROC_STATM, sbuf, sizeof(sbuf)) <= 0)
 		return 0;
-	sbuf[num_read] = '\0';
 
-	nvals = sscanf(sbuf,
-		       "%ld %ld %ld %ld %ld %ld %ld",
-		       &size, &rss, &share, &text, &lib, &data, &dt);
 	/* There are some additional fields, which we do not scan or use */
-	if (nvals != 7)
-		return 0;
+	for (int i = 0; i < ARRAY_SIZE(fields); i++)
+		if (!_next_int(&ptr, &fields[i]))
+			return 0;
 
 	/* If shared > rss then there is a problem, give up... */
-	if (share > rss) {
+	if (fields[2] > fields[1]) {
 		log_flag(JAG, "share > rss - bail!");
 		return 0;
 	}
 
 	/* Copy the values that slurm records into our data structure */
 	prec->tres_data[TRES_ARRAY_MEM].size_read =
-		(rss - share) * my_pagesize;;
+		(fields[1] - fields[2]) * my_pagesize;
 
 	return 1;
 }
 
-static int _remove_share_data(char *proc_stat_file, jag_prec_t *prec)
-{
-	FILE *statm_fp = NULL;
-	char proc_statm_file[256];	/* Allow ~20x extra length */
-	int rc = 0, fd;
-
-	snprintf(proc_statm_file, sizeof(proc_statm_file), "%sm",
-		 proc_stat_file);
-	if (!(statm_fp = fopen(proc_statm_file, "r")))
-		return rc;  /* Assume the process went away */
-	fd = fileno(statm_fp);
-	if (fcntl(fd, F_SETFD, FD_CLOEXEC) == -1)
-		error("%s: fcntl(%s): %m", __func__, proc_statm_file);
-	rc = _get_process_memory_line(fd, prec);
-	fclose(statm_fp);
-	return rc;
-}
-
 /* _get_process_io_data_line() - get line of data from /proc/<pid>/io
  *
- * IN:	in - input file descriptor
+ * IN:	files - open files of the process
  * OUT:	prec - the destination for the data
  *
  * RETVAL:	==0 - no valid data
@@ -459,23 +658,25 @@ static int _remove_share_data(char *proc_stat_file, jag_prec_t *prec)
  * wrchar: <# of characters written>
  *   . . .
  */
-static int _get_process_io_data_line(int in, jag_prec_t *prec) {
-	char sbuf[256];
-	char f1[7], f3[7];
-	int num_read, nvals;
-	uint64_t rchar, wchar;
-
-	num_read = read(in, sbuf, (sizeof(sbuf) - 1));
-	if (num_read <= 0)
+static int _get_process_io_data_line(jag_proc_files_t *files,
+				     jag_prec_t *prec)
+{
+	char sbuf[256], *ptr;
+	int64_t rchar, wchar;
+
+	if (_read_proc_file(files, JAG_PROC_IO, sbuf, sizeof(sbuf)) <= 0)
 		return 0;
-	sbuf[num_read] = '\0';
 
-	nvals = sscanf(sbuf, "%s %"PRIu64" %s %"PRIu64"",
-		       f1, &rchar, f3, &wchar);
-	if (nvals < 4)
+	if (!(ptr = strchr(sbuf, ':')))
+		return 0;
+	ptr++;
+	if (!_next_int(&ptr, &rchar) || !(ptr = strchr(ptr, ':')))
+		return 0;
+	ptr++;
+	if (!_next_int(&ptr, &wchar))
 		return 0;
 
-	if (_is_a_lwp(prec->pid))
+	if (_is_a_lwp(files))
 		return 0;
 
 	/* keep real value here since we aren't doubles */
@@ -498,15 +699,11 @@ static int _init_tres(jag_prec_t *prec, void *empty)
 	return SLURM_SUCCESS;
 }
 
-static void _handle_stats(char *proc_stat_file, char *proc_io_file,
-			  char *proc_smaps_file, jag_callbacks_t *callbacks,
+static void _handle_stats(jag_proc_files_t *files, jag_callbacks_t *callbacks,
 			  int tres_count)
 {
 	static int no_share_data = -1;
 	static int use_pss = -1;
-	FILE *stat_fp = NULL;
-	FILE *io_fp = NULL;
-	int fd, fd2;
 	jag_prec_t *prec = NULL;
 
 	if (no_share_data == -1) {
@@ -521,22 +718,6 @@ static void _handle_stats(char *proc_stat_file, char *proc_io_file,
 			use_pss = 0;
 	}
 
-	if (!(stat_fp = fopen(proc_stat_file, "r")))
-		return;  /* Assume the process went away */
-	/*
-	 * Close the file on exec() of user tasks.
-	 *
-	 * NOTE: If we fork() slurmstepd after the
-	 * fopen() above and before the fcntl() below,
-	 * then the user task may have this extra file
-	 * open, which can cause problems for
-	 * checkpoint/restart, but this should be a very rare
-	 * problem in practice.
-	 */
-	fd = fileno(stat_fp);
-	if (fcntl(fd, F_SETFD, FD_CLOEXEC) == -1)
-		error("%s: fcntl(%s): %m", __func__, proc_stat_file);
-
 	prec = xmalloc(sizeof(jag_prec_t));
 
 	if (!tres_count) {
@@ -554,12 +735,8 @@ static void _handle_stats(char *proc_stat_file, char *proc_io_file,
 
 	(void)_init_tres(prec, NULL);
 
-	if (!_get_process_data_line(fd, prec)) {
-		fclose(stat_fp);
+	if (!_get_process_data_line(files, prec))
 		goto bail_out;
-	}
-
-	fclose(stat_fp);
 
 	if (acct_gather_filesystem_g_get_data(prec->tres_data) < 0) {
 		log_flag(JAG, "problem retrieving filesystem data");
@@ -570,23 +747,20 @@ static void _handle_stats(char *proc_stat_file, char *proc_io_file,
 	}
 
 	/* Remove shared data from rss */
-	if (no_share_data && !_remove_share_data(proc_stat_file, prec))
+	if (no_share_data && !_get_process_memory_line(files, prec))
 		goto bail_out;
 
 	/* Use PSS instead if RSS */
-	if (use_pss && _get_pss(proc_smaps_file, prec) == -1)
+	if (use_pss && _get_pss(files, prec) == -1)
 		goto bail_out;
 
-	if ((io_fp = fopen(proc_io_file, "r"))) {
-		fd2 = fileno(io_fp);
-		if (fcntl(fd2, F_SETFD, FD_CLOEXEC) == -1)
-			error("%s: fcntl: %m", __func__);
-		if (!_get_process_io_data_line(fd2, prec)) {
-			fclose(io_fp);
-			goto bail_out;
-		}
-		fclose(io_fp);
-	}
+	/*
+	 * /proc/<pid>/io is not always readable, only give up if it was read
+	 * but could not be parsed.
+	 */
+	if (!_get_process_io_data_line(files, prec) &&
+	    (files->fd[JAG_PROC_IO] >= 0))
+		goto bail_out;
 
 	destroy_jag_prec(list_remove_first(prec_list, _find_prec, &prec->pid));
 	list_append(prec_list, prec);
@@ -601,16 +775,15 @@ bail_out:
 static List _get_precs(List task_list, bool pgid_plugin, uint64_t cont_id,
 		       jag_callbacks_t *callbacks)
 {
-	char	proc_stat_file[256];	/* Allow ~20x extra length */
-	char	proc_io_file[256];	/* Allow ~20x extra length */
-	char	proc_smaps_file[256];	/* Allow ~20x extra length */
 	static	int	slash_proc_open = 0;
 	int i;
 	struct jobacctinfo *jobacct = NULL;
+	jag_proc_files_t *files;
 
 	xassert(task_list);
 
 	jobacct = list_peek(task_list);
+	poll_id++;
 
 	if (!pgid_plugin) {
 		pid_t *pids = NULL;
@@ -639,17 +812,18 @@ static List _get_precs(List task_list, bool pgid_plugin, uint64_t cont_id,
 			goto finished;
 		}
 		for (i = 0; i < npids; i++) {
-			snprintf(proc_stat_file, 256, "/proc/%d/stat", pids[i]);
-			snprintf(proc_io_file, 256, "/proc/%d/io", pids[i]);
-			snprintf(proc_smaps_file, 256, "/proc/%d/smaps", pids[i]);
-			_handle_stats(proc_stat_file, proc_io_file,
-				      proc_smaps_file, callbacks,
+			files = _get_proc_files(pids[i]);
+			_handle_stats(files, callbacks,
 				      jobacct ? jobacct->tres_count : 0);
+			if (!files->cached)
+				_free_proc_files(files);
 		}
+		sampled_pids += npids;
 		xfree(pids);
 	} else {
 		struct dirent *slash_proc_entry;
-		char  *iptr = NULL, *optr = NULL, *optr2 = NULL;
+		char *end;
+		long pid;
 
 		if (slash_proc_open) {
 			rewinddir(slash_proc);
@@ -661,84 +835,30 @@ static List _get_precs(List task_list, bool pgid_plugin, uint64_t cont_id,
 			}
 			slash_proc_open=1;
 		}
-		strcpy(proc_stat_file, "/proc/");
-		strcpy(proc_io_file, "/proc/");
-		strcpy(proc_smaps_file, "/proc/");
 
+		/*
+		 * Every process on the node has to be looked at to find the
+		 * descendants of the tasks so files are not kept open.
+		 */
 		while ((slash_proc_entry = readdir(slash_proc))) {
-
-			/* Save a few cyles by simulating
-			 * strcat(statFileName, slash_proc_entry->d_name);
-			 * strcat(statFileName, "/stat");
-			 * while checking for a numeric filename (which really
-			 * should be a pid). Then do the same for the
-			 * /proc/<pid>/io file name.
-			 */
-			optr = proc_stat_file + sizeof("/proc");
-			iptr = slash_proc_entry->d_name;
-			i = 0;
-			do {
-				if ((*iptr < '0') ||
-				    ((*optr++ = *iptr++) > '9')) {
-					i = -1;
-					break;
-				}
-			} while (*iptr);
-
-			if (i == -1)
+			/* only numeric names are pids */
+			if ((slash_proc_entry->d_name[0] < '0') ||
+			    (slash_proc_entry->d_name[0] > '9'))
 				continue;
-			iptr = (char*)"/stat";
-
-			do {
-				*optr++ = *iptr++;
-			} while (*iptr);
-			*optr = 0;
-
-			optr2 = proc_io_file + sizeof("/proc");
-			iptr = slash_proc_entry->d_name;
-			i = 0;
-			do {
-				if ((*iptr < '0') ||
-				    ((*optr2++ = *iptr++) > '9')) {
-					i = -1;
-					break;
-				}
-			} while (*iptr);
-			if (i == -1)
-				continue;
-			iptr = (char*)"/io";
-
-			do {
-				*optr2++ = *iptr++;
-			} while (*iptr);
-			*optr2 = 0;
-
-			optr2 = proc_smaps_file + sizeof("/proc");
-			iptr = slash_proc_entry->d_name;
-			i = 0;
-			do {
-				if ((*iptr < '0') ||
-				    ((*optr2++ = *iptr++) > '9')) {
-					i = -1;
-					break;
-				}
-			} while (*iptr);
-			if (i == -1)
+			pid = strtol(slash_proc_entry->d_name, &end, 10);
+			if (*end || (pid <= 0))
 				continue;
-			iptr = (char*)"/smaps";
 
-			do {
-				*optr2++ = *iptr++;
-			} while (*iptr);
-			*optr2 = 0;
-
-			_handle_stats(proc_stat_file, proc_io_file,
-				      proc_smaps_file, callbacks,
+			files = _new_proc_files(pid, false);
+			_handle_stats(files, callbacks,
 				      jobacct ? jobacct->tres_count : 0);
+			_free_proc_files(files);
+			sampled_pids++;
 		}
 	}
 
 finished:
+	_prune_proc_files();
 
 	return prec_list;
 }
@@ -861,6 +981,7 @@ static void _record_profile(struct jobacctinfo *jobacct)
 extern void jag_common_init(long in_hertz)
 {
 	uint32_t profile_opt;
+	struct rlimit rlim;
 
 	prec_list = list_create(destroy_jag_prec);
 
@@ -885,10 +1006,26 @@ extern void jag_common_init(long in_hertz)
 	}
 
 	my_pagesize = getpagesize();
+
+	/* Leave most of the file descriptors to the step */
+	if (getrlimit(RLIMIT_NOFILE, &rlim) || (rlim.rlim_cur == RLIM_INFINITY))
+		max_cached_fds = 1024;
+	else
+		max_cached_fds = rlim.rlim_cur / 4;
+
+	use_smaps_rollup = !access("/proc/self/smaps_rollup", R_OK);
+
+	proc_files = xhash_init(_proc_files_id, _free_proc_files);
 }
 
 extern void jag_common_fini(void)
 {
+	if (poll_count)
+		debug("%s: %"PRIu64" polls of %"PRIu64" pids took %"PRIu64" usec of CPU time (avg %"PRIu64" max %"PRIu64")",
+		      __func__, poll_count, sampled_pids, poll_usec_tot,
+		      poll_usec_tot / poll_count, poll_usec_max);
+
+	xhash_free(proc_files);
 	FREE_NULL_LIST(prec_list);
 
 	if (slash_proc)
@@ -907,6 +1044,21 @@ extern void destroy_jag_prec(void *object)
 	return;
 }
 
+extern jag_prec_t *jag_common_add_prec(pid_t pid, int tres_count)
+{
+	jag_prec_t *prec = xmalloc(sizeof(*prec));
+
+	prec->pid = pid;
+	prec->tres_count = tres_count;
+	prec->tres_data = xcalloc(tres_count, sizeof(acct_gather_data_t));
+	(void) _init_tres(prec, NULL);
+
+	destroy_jag_prec(list_remove_first(prec_list, _find_prec, &pid));
+	list_append(prec_list, prec);
+
+	return prec;
+}
+
 static void _print_jag_prec(jag_prec_t *prec)
 {
 	int i;
@@ -946,6 +1098,8 @@ extern void jag_common_poll_data(
 	jag_prec_t *prec = NULL, tmp_prec;
 	struct jobacctinfo *jobacct = NULL;
 	static int processing = 0;
+	struct timespec cpu_start, cpu_end;
+	uint64_t poll_usec;
 	char sbuf[72];
 	int energy_counted = 0;
 	time_t ct;
@@ -970,7 +1124,17 @@ extern void jag_common_poll_data(
 	ct = time(NULL);
 
 	(void)list_for_each(prec_list, (ListForF)_init_tres, NULL);
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu_start);
 	(*(callbacks->get_precs))(task_list, pgid_plugin, cont_id, callbacks);
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu_end);
+
+	poll_usec = ((cpu_end.tv_sec - cpu_start.tv_sec) * USEC_IN_SEC) +
+		    ((cpu_end.tv_nsec - cpu_start.tv_nsec) / NSEC_IN_USEC);
+	poll_count++;
+	poll_usec_tot += poll_usec;
+	poll_usec_max = MAX(poll_usec_max, poll_usec);
+	log_flag(JAG, "sampling %d processes took %"PRIu64" usec of CPU time, %d files kept open",
+		 list_count(prec_list), poll_usec, cached_fds);
 
 	if (!list_count(prec_list) || !task_list || !list_count(task_list))
 		goto finished;	/* We have no business being here! */
@@ -1095,6 +1259,18 @@ extern void jag_common_poll_data(
 				prec->tres_data[i].size_write;
 		}
 
+		/* The kernel also saw the peaks between two polls */
+		if (prec->mem_peak &&
+		    ((jobacct->tres_usage_in_max[TRES_ARRAY_MEM] ==
+		      INFINITE64) ||
+		     (prec->mem_peak >
+		      jobacct->tres_usage_in_max[TRES_ARRAY_MEM]))) {
+			jobacct->tres_usage_in_max[TRES_ARRAY_MEM] =
+				prec->mem_peak;
+			jobacct->tres_usage_in_min[TRES_ARRAY_MEM] =
+				prec->mem_peak;
+		}
+
 		total_job_mem += jobacct->tres_usage_in_tot[TRES_ARRAY_MEM];
 		total_job_vsize += jobacct->tres_usage_in_tot[TRES_ARRAY_VMEM];
 
@@ -54,6 +54,7 @@ typedef struct jag_prec {	/* process record */
 	int     tres_count; /* count of tres in the tres_data */
 	acct_gather_data_t *tres_data; /* array of tres data */
 	double  usec; /* user cpu time: To normalize divide by system hertz */
+	uint64_t mem_peak; /* peak memory kept by the kernel, 0 if unknown */
 } jag_prec_t;
 
 typedef struct jag_callbacks {
@@ -64,10 +65,19 @@ typedef struct jag_callbacks {
 				    jag_prec_t *ancestor, pid_t pid);
 } jag_callbacks_t;
 
+/* Records of the last poll, one per process */
+extern List prec_list;
+
 extern void jag_common_init(long in_hertz);
 extern void jag_common_fini(void);
 extern void destroy_jag_prec(void *object);
 
+/*
+ * Add a record for pid with all its TRES data unset, replacing the one of the
+ * last poll. For get_precs callbacks not reading /proc.
+ */
+extern jag_prec_t *jag_common_add_prec(pid_t pid, int tres_count);
+
 extern void jag_common_poll_data(
 	List task_list, bool pgid_plugin, uint64_t cont_id,
 	jag_callbacks_t *callbacks, bool profile);
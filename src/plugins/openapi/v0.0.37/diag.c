@@ -49,6 +49,7 @@
 #include "src/common/xstring.h"
 
 #include "src/slurmrestd/operations.h"
+#include "src/slurmrestd/query_cache.h"
 
 #include "src/plugins/openapi/v0.0.37/api.h"
 
@@ -58,6 +59,21 @@ typedef enum {
 	URL_TAG_PING,
 } url_tag_t;
 
+static void _dump_query_cache(data_t *d)
+{
+	query_cache_stats_t stats;
+
+	query_cache_get_stats(&stats);
+
+	data_set_int(data_key_set(d, "hits"), stats.hits);
+	data_set_int(data_key_set(d, "misses"), stats.misses);
+	data_set_int(data_key_set(d, "coalesced"), stats.coalesced);
+	data_set_int(data_key_set(d, "unchanged"), stats.unchanged);
+	data_set_int(data_key_set(d, "errors"), stats.errors);
+	data_set_int(data_key_set(d, "entries"), stats.entries);
+	data_set_int(data_key_set(d, "ttl"), stats.ttl);
+}
+
 static int _op_handler_diag(const char *context_id,
 			    http_request_method_t method, data_t *parameters,
 			    data_t *query, int tag, data_t *p,
@@ -144,6 +160,8 @@ static int _op_handler_diag(const char *context_id,
 		     resp->bf_when_last_cycle);
 	data_set_bool(data_key_set(d, "bf_active"), (resp->bf_active != 0));
 
+	_dump_query_cache(data_set_dict(data_key_set(d, "rest_cache")));
+
 cleanup:
 	if (rc) {
 		data_t *e = data_set_dict(data_list_append(errors));
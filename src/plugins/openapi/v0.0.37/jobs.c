@@ -65,6 +65,7 @@
 
 #include "src/slurmrestd/openapi.h"
 #include "src/slurmrestd/operations.h"
+#include "src/slurmrestd/query_cache.h"
 
 #include "src/plugins/openapi/v0.0.37/api.h"
 
@@ -1166,6 +1167,7 @@ static int _op_handler_jobs(const char *context_id,
 {
 	int rc = SLURM_SUCCESS;
 	job_info_msg_t *job_info_ptr = NULL;
+	query_cache_ref_t *ref = NULL;
 	data_t *errors = populate_response_format(resp);
 	data_t *jobs = data_set_list(data_key_set(resp, "jobs"));
 	time_t update_time = 0; /* default to unix epoch */
@@ -1175,8 +1177,8 @@ static int _op_handler_jobs(const char *context_id,
 	if ((rc = get_date_param(query, "update_time", &update_time)))
 	    goto done;
 
-	rc = slurm_load_jobs(update_time, &job_info_ptr,
-			     SHOW_ALL | SHOW_DETAIL);
+	rc = query_cache_load_jobs(auth, update_time, (SHOW_ALL | SHOW_DETAIL),
+				   &job_info_ptr, &ref);
 
 	if (rc == SLURM_NO_CHANGE_IN_DATA) {
 		/* no-op: nothing to do here */
@@ -1192,7 +1194,8 @@ static int _op_handler_jobs(const char *context_id,
 	}
 
 done:
-	slurm_free_job_info_msg(job_info_ptr);
+	/* job_info_ptr is shared with other requests */
+	query_cache_release(ref);
 
 	return rc;
 }
@@ -54,6 +54,7 @@
 
 #include "src/slurmrestd/openapi.h"
 #include "src/slurmrestd/operations.h"
+#include "src/slurmrestd/query_cache.h"
 
 #include "src/plugins/openapi/v0.0.37/api.h"
 
@@ -260,13 +261,15 @@ static int _op_handler_nodes(const char *context_id,
 	data_t *errors = populate_response_format(d);
 	data_t *nodes = data_set_list(data_key_set(d, "nodes"));
 	node_info_msg_t *node_info_ptr = NULL;
+	query_cache_ref_t *ref = NULL;
 	time_t update_time = 0;
 
 	if (tag == URL_TAG_NODES) {
 		if ((rc = get_date_param(query, "update_time", &update_time)))
 			goto done;
-		rc = slurm_load_node(update_time, &node_info_ptr,
-				     SHOW_ALL|SHOW_DETAIL);
+		rc = query_cache_load_nodes(auth, update_time,
+					    (SHOW_ALL | SHOW_DETAIL),
+					    &node_info_ptr, &ref);
 	} else if (tag == URL_TAG_NODE) {
 		const data_t *node_name = data_key_get_const(parameters,
 							     "node_name");
@@ -282,9 +285,10 @@ static int _op_handler_nodes(const char *context_id,
 	} else
 		rc = SLURM_ERROR;
 
-	if (errno == SLURM_NO_CHANGE_IN_DATA) {
+	if ((rc == SLURM_NO_CHANGE_IN_DATA) ||
+	    (errno == SLURM_NO_CHANGE_IN_DATA)) {
 		/* no-op: nothing to do here */
-		rc = errno;
+		rc = SLURM_NO_CHANGE_IN_DATA;
 		goto done;
 	} else if (!rc && node_info_ptr && node_info_ptr->record_count)
 		for (int i = 0; !rc && i < node_info_ptr->record_count; i++)
@@ -302,7 +306,10 @@ static int _op_handler_nodes(const char *context_id,
 	}
 
 done:
-	slurm_free_node_info_msg(node_info_ptr);
+	if (ref)
+		query_cache_release(ref);
+	else
+		slurm_free_node_info_msg(node_info_ptr);
 	return rc;
 }
 
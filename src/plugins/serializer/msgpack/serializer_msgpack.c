@@ -0,0 +1,669 @@
+/*****************************************************************************\
+ *  serializer_msgpack.c - Serializer for MessagePack.
+ *****************************************************************************
+ *  Copyright (C) 2021 SchedMD LLC.
+ *
+ *  This file is part of Slurm, a resource management program.
+ *  For details, see <https://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  Slurm is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  Slurm is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with Slurm; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+
+#include "config.h"
+
+#include <inttypes.h>
+
+#include "slurm/slurm.h"
+
+#include "src/common/slurm_xlator.h"
+#include "src/common/data.h"
+#include "src/common/log.h"
+#include "src/common/xassert.h"
+#include "src/common/xmalloc.h"
+#include "src/common/xstring.h"
+
+/*
+ * These variables are required by the generic plugin interface.  If they
+ * are not found in the plugin, the plugin loader will ignore it.
+ *
+ * plugin_name - A string giving a human-readable description of the
+ * plugin.  There is no maximum length, but the symbol must refer to
+ * a valid string.
+ *
+ * plugin_type - A string suggesting the type of the plugin or its
+ * applicability to a particular form of data or method of data handling.
+ * If the low-level plugin API is used, the contents of this string are
+ * unimportant and may be anything.  Slurm uses the higher-level plugin
+ * interface which requires this string to be of the form
+ *
+ *	<application>/<method>
+ *
+ * where <application> is a description of the intended application of
+ * the plugin (e.g., "auth" for Slurm authentication) and <method> is a
+ * description of how this plugin satisfies that application.  Slurm will
+ * only load authentication plugins if the plugin_type string has a prefix
+ * of "auth/".
+ *
+ * plugin_version - an unsigned 32-bit integer containing the Slurm version
+ * (major.minor.micro combined into a single number).
+ */
+const char *plugin_name = "Serializer MessagePack plugin";
+const char plugin_type[] = "serializer/msgpack";
+const uint32_t plugin_version = SLURM_VERSION_NUMBER;
+const char *mime_types[] = {
+	"application/x-msgpack",
+	"application/msgpack",
+	"application/vnd.msgpack",
+	NULL
+};
+
+/* Bytes of output to collect before handing them to a stream writer */
+#define MSGPACK_STREAM_CHUNK (64 * 1024)
+/* Maximum nesting of arrays and maps accepted when deserializing */
+#define MSGPACK_MAX_DEPTH 128
+
+/*
+ * MessagePack format markers.
+ * See https://github.com/msgpack/msgpack/blob/master/spec.md
+ */
+#define MP_POSITIVE_FIXINT_MAX 0x7f
+#define MP_FIXMAP 0x80
+#define MP_FIXMAP_MAX 0x8f
+#define MP_FIXARRAY 0x90
+#define MP_FIXARRAY_MAX 0x9f
+#define MP_FIXSTR 0xa0
+#define MP_FIXSTR_MAX 0xbf
+#define MP_NIL 0xc0
+#define MP_FALSE 0xc2
+#define MP_TRUE 0xc3
+#define MP_BIN8 0xc4
+#define MP_BIN16 0xc5
+#define MP_BIN32 0xc6
+#define MP_FLOAT32 0xca
+#define MP_FLOAT64 0xcb
+#define MP_UINT8 0xcc
+#define MP_UINT16 0xcd
+#define MP_UINT32 0xce
+#define MP_UINT64 0xcf
+#define MP_INT8 0xd0
+#define MP_INT16 0xd1
+#define MP_INT32 0xd2
+#define MP_INT64 0xd3
+#define MP_STR8 0xd9
+#define MP_STR16 0xda
+#define MP_STR32 0xdb
+#define MP_ARRAY16 0xdc
+#define MP_ARRAY32 0xdd
+#define MP_MAP16 0xde
+#define MP_MAP32 0xdf
+#define MP_NEGATIVE_FIXINT 0xe0
+
+/* Destination of serialized output: either a buffer or a writer callback */
+typedef struct {
+	char *buf; /* pending output */
+	size_t len; /* bytes of output in buf */
+	size_t size; /* bytes allocated for buf */
+	data_serializer_write_t writer; /* callback or NULL to only fill buf */
+	void *arg; /* arg for writer */
+	int rc; /* first error from writer or encoding */
+} mp_out_t;
+
+/* Source of deserialized input */
+typedef struct {
+	const uint8_t *pos; /* next byte to decode */
+	const uint8_t *end; /* end of input */
+	int depth; /* current nesting of arrays and maps */
+} mp_in_t;
+
+static void _data_to_msgpack(const data_t *d, mp_out_t *out);
+static int _msgpack_to_data(mp_in_t *in, data_t *d);
+
+extern int serializer_p_init(void)
+{
+	log_flag(DATA, "loaded");
+
+	return SLURM_SUCCESS;
+}
+
+extern int serializer_p_fini(void)
+{
+	log_flag(DATA, "unloaded");
+
+	return SLURM_SUCCESS;
+}
+
+static void _flush(mp_out_t *out)
+{
+	if (out->len && !out->rc)
+		out->rc = out->writer(out->buf, out->len, out->arg);
+	out->len = 0;
+}
+
+static void _append(mp_out_t *out, const void *ptr, size_t len)
+{
+	if ((out->len + len + 1) > out->size) {
+		out->size = MAX((out->size * 2), (out->len + len + 1));
+		xrealloc_nz(out->buf, out->size);
+	}
+
+	memcpy((out->buf + out->len), ptr, len);
+	out->len += len;
+	/* always terminate for callers of serializer_p_serialize() */
+	out->buf[out->len] = '\0';
+
+	if (out->writer && (out->len >= MSGPACK_STREAM_CHUNK))
+		_flush(out);
+}
+
+/* Append marker followed by bytes of value in network (big endian) order */
+static void _append_be(mp_out_t *out, uint8_t marker, uint64_t value,
+		       int bytes)
+{
+	uint8_t buf[9];
+
+	xassert(bytes <= 8);
+
+	buf[0] = marker;
+	for (int i = bytes; i > 0; i--) {
+		buf[i] = value & 0xff;
+		value >>= 8;
+	}
+
+	_append(out, buf, (bytes + 1));
+}
+
+static void _append_uint(mp_out_t *out, uint64_t value)
+{
+	if (value <= MP_POSITIVE_FIXINT_MAX)
+		_append_be(out, value, 0, 0);
+	else if (value <= UINT8_MAX)
+		_append_be(out, MP_UINT8, value, 1);
+	else if (value <= UINT16_MAX)
+		_append_be(out, MP_UINT16, value, 2);
+	else if (value <= UINT32_MAX)
+		_append_be(out, MP_UINT32, value, 4);
+	else
+		_append_be(out, MP_UINT64, value, 8);
+}
+
+/* Use the smallest encoding that holds value as required by the spec */
+static void _append_int(mp_out_t *out, int64_t value)
+{
+	if (value >= 0)
+		_append_uint(out, value);
+	else if (value >= -32)
+		_append_be(out, (uint8_t) value, 0, 0);
+	else if (value >= INT8_MIN)
+		_append_be(out, MP_INT8, (uint8_t) value, 1);
+	else if (value >= INT16_MIN)
+		_append_be(out, MP_INT16, (uint16_t) value, 2);
+	else if (value >= INT32_MIN)
+		_append_be(out, MP_INT32, (uint32_t) value, 4);
+	else
+		_append_be(out, MP_INT64, (uint64_t) value, 8);
+}
+
+static void _append_float(mp_out_t *out, double value)
+{
+	uint64_t bits;
+
+	memcpy(&bits, &value, sizeof(bits));
+	_append_be(out, MP_FLOAT64, bits, 8);
+}
+
+static void _append_str(mp_out_t *out, const char *str)
+{
+	size_t len = strlen(str);
+
+	if (len <= (MP_FIXSTR_MAX - MP_FIXSTR)) {
+		_append_be(out, (MP_FIXSTR | len), 0, 0);
+	} else if (len <= UINT8_MAX) {
+		_append_be(out, MP_STR8, len, 1);
+	} else if (len <= UINT16_MAX) {
+		_append_be(out, MP_STR16, len, 2);
+	} else if (len <= UINT32_MAX) {
+		_append_be(out, MP_STR32, len, 4);
+	} else {
+		error("%s: unable to serialize string of %zu bytes",
+		      __func__, len);
+		if (!out->rc)
+			out->rc = ESLURM_DATA_TOO_LARGE;
+		return;
+	}
+
+	_append(out, str, len);
+}
+
+/* Append header for container with count entries */
+static void _append_container(mp_out_t *out, size_t count, uint8_t fix,
+			      uint8_t fix_max, uint8_t marker16,
+			      uint8_t marker32)
+{
+	if (count <= (fix_max - fix)) {
+		_append_be(out, (fix | count), 0, 0);
+	} else if (count <= UINT16_MAX) {
+		_append_be(out, marker16, count, 2);
+	} else if (count <= UINT32_MAX) {
+		_append_be(out, marker32, count, 4);
+	} else {
+		error("%s: unable to serialize container with %zu entries",
+		      __func__, count);
+		if (!out->rc)
+			out->rc = ESLURM_DATA_TOO_LARGE;
+	}
+}
+
+static data_for_each_cmd_t _convert_dict_msgpack(const char *key,
+						 const data_t *data,
+						 void *arg)
+{
+	mp_out_t *out = arg;
+
+	_append_str(out, key);
+	_data_to_msgpack(data, out);
+
+	return out->rc ? DATA_FOR_EACH_FAIL : DATA_FOR_EACH_CONT;
+}
+
+static data_for_each_cmd_t _convert_list_msgpack(const data_t *data,
+						 void *arg)
+{
+	mp_out_t *out = arg;
+
+	_data_to_msgpack(data, out);
+
+	return out->rc ? DATA_FOR_EACH_FAIL : DATA_FOR_EACH_CONT;
+}
+
+/* Write MessagePack for data directly into out as the tree is walked */
+static void _data_to_msgpack(const data_t *d, mp_out_t *out)
+{
+	if (out->rc)
+		return;
+
+	if (!d) {
+		_append_be(out, MP_NIL, 0, 0);
+		return;
+	}
+
+	switch (data_get_type(d)) {
+	case DATA_TYPE_NULL:
+		_append_be(out, MP_NIL, 0, 0);
+		break;
+	case DATA_TYPE_BOOL:
+		_append_be(out, (data_get_bool(d) ? MP_TRUE : MP_FALSE), 0, 0);
+		break;
+	case DATA_TYPE_FLOAT:
+		_append_float(out, data_get_float(d));
+		break;
+	case DATA_TYPE_INT_64:
+		_append_int(out, data_get_int(d));
+		break;
+	case DATA_TYPE_DICT:
+		_append_container(out, data_get_dict_length(d), MP_FIXMAP,
+				  MP_FIXMAP_MAX, MP_MAP16, MP_MAP32);
+		if (!out->rc &&
+		    (data_dict_for_each_const(d, _convert_dict_msgpack,
+					      out) < 0))
+			error("%s: unexpected error calling _convert_dict_msgpack()",
+			      __func__);
+		break;
+	case DATA_TYPE_LIST:
+		_append_container(out, data_get_list_length(d), MP_FIXARRAY,
+				  MP_FIXARRAY_MAX, MP_ARRAY16, MP_ARRAY32);
+		if (!out->rc &&
+		    (data_list_for_each_const(d, _convert_list_msgpack,
+					      out) < 0))
+			error("%s: unexpected error calling _convert_list_msgpack()",
+			      __func__);
+		break;
+	case DATA_TYPE_STRING:
+	{
+		const char *str = data_get_string_const(d);
+		_append_str(out, (str ? str : ""));
+		break;
+	}
+	default:
+		fatal_abort("%s: unknown type", __func__);
+	};
+}
+
+/*
+ * MessagePack output may contain NUL bytes. The returned string is always
+ * terminated but callers that need the length must use
+ * data_g_serialize_length().
+ */
+extern int serializer_p_serialize(char **dest, const data_t *data,
+				  data_serializer_flags_t flags)
+{
+	mp_out_t out = { 0 };
+
+	/* there is no pretty form of a binary format */
+	_data_to_msgpack(data, &out);
+
+	if (out.rc)
+		xfree(out.buf);
+	else
+		*dest = out.buf;
+
+	return out.rc;
+}
+
+extern int serializer_p_serialize_stream(const data_t *data,
+					 data_serializer_flags_t flags,
+					 data_serializer_write_t writer,
+					 void *arg)
+{
+	mp_out_t out = {
+		.writer = writer,
+		.arg = arg,
+	};
+
+	_data_to_msgpack(data, &out);
+	_flush(&out);
+	xfree(out.buf);
+
+	return out.rc;
+}
+
+static int _need(mp_in_t *in, uint64_t bytes)
+{
+	if (bytes > (in->end - in->pos)) {
+		debug("MessagePack truncated: need %"PRIu64" bytes but only %zu remain",
+		      bytes, (size_t) (in->end - in->pos));
+		return ESLURM_DATA_CONV_FAILED;
+	}
+
+	return SLURM_SUCCESS;
+}
+
+/* Read unsigned value of bytes length in network (big endian) order */
+static int _read_be(mp_in_t *in, int bytes, uint64_t *value)
+{
+	int rc;
+
+	if ((rc = _need(in, bytes)))
+		return rc;
+
+	*value = 0;
+	for (int i = 0; i < bytes; i++)
+		*value = (*value << 8) | *in->pos++;
+
+	return SLURM_SUCCESS;
+}
+
+/* Read string or binary of len bytes into d */
+static int _read_str(mp_in_t *in, uint64_t len, data_t *d)
+{
+	int rc;
+	char *str;
+
+	if ((rc = _need(in, len)))
+		return rc;
+
+	str = xmalloc_nz(len + 1);
+	memcpy(str, in->pos, len);
+	str[len] = '\0';
+	in->pos += len;
+
+	data_set_string_own(d, str);
+
+	return SLURM_SUCCESS;
+}
+
+/* Read length of string or binary if marker is one else return false */
+static bool _read_str_len(mp_in_t *in, uint8_t marker, uint64_t *len,
+			  int *rc)
+{
+	if ((marker >= MP_FIXSTR) && (marker <= MP_FIXSTR_MAX)) {
+		*len = marker - MP_FIXSTR;
+		*rc = SLURM_SUCCESS;
+		return true;
+	}
+
+	switch (marker) {
+	case MP_STR8:
+	case MP_BIN8:
+		*rc = _read_be(in, 1, len);
+		return true;
+	case MP_STR16:
+	case MP_BIN16:
+		*rc = _read_be(in, 2, len);
+		return true;
+	case MP_STR32:
+	case MP_BIN32:
+		*rc = _read_be(in, 4, len);
+		return true;
+	}
+
+	return false;
+}
+
+static int _read_list(mp_in_t *in, uint64_t count, data_t *d)
+{
+	int rc = SLURM_SUCCESS;
+
+	data_set_list(d);
+
+	/* every entry needs at least one byte */
+	if ((rc = _need(in, count)))
+		return rc;
+
+	for (uint64_t i = 0; !rc && (i < count); i++)
+		rc = _msgpack_to_data(in, data_list_append(d));
+
+	return rc;
+}
+
+static int _read_dict(mp_in_t *in, uint64_t count, data_t *d)
+{
+	int rc = SLURM_SUCCESS;
+
+	data_set_dict(d);
+
+	/* every entry needs at least one byte for key and value */
+	if ((rc = _need(in, (count * 2))))
+		return rc;
+
+	for (uint64_t i = 0; !rc && (i < count); i++) {
+		data_t *key = data_new();
+
+		if ((rc = _msgpack_to_data(in, key))) {
+			/* nothing to add */
+		} else if (data_convert_type(key, DATA_TYPE_STRING) !=
+			   DATA_TYPE_STRING) {
+			/* keys are always strings in data_t */
+			debug("unable to use MessagePack %s as map key",
+			      data_type_to_string(data_get_type(key)));
+			rc = ESLURM_DATA_CONV_FAILED;
+		} else {
+			rc = _msgpack_to_data(in, data_key_set(
+				d, data_get_string(key)));
+		}
+
+		FREE_NULL_DATA(key);
+	}
+
+	return rc;
+}
+
+static int _msgpack_to_data(mp_in_t *in, data_t *d)
+{
+	int rc = SLURM_SUCCESS;
+	uint64_t value;
+	uint8_t marker;
+
+	if ((rc = _need(in, 1)))
+		return rc;
+
+	marker = *in->pos++;
+
+	if (marker <= MP_POSITIVE_FIXINT_MAX) {
+		data_set_int(d, marker);
+		return SLURM_SUCCESS;
+	} else if (marker >= MP_NEGATIVE_FIXINT) {
+		data_set_int(d, (int8_t) marker);
+		return SLURM_SUCCESS;
+	} else if (_read_str_len(in, marker, &value, &rc)) {
+		if (rc)
+			return rc;
+		return _read_str(in, value, d);
+	} else if ((marker == MP_NIL) || (marker == MP_FALSE) ||
+		   (marker == MP_TRUE)) {
+		if (marker == MP_NIL)
+			data_set_null(d);
+		else
+			data_set_bool(d, (marker == MP_TRUE));
+		return SLURM_SUCCESS;
+	}
+
+	if (((marker >= MP_FIXMAP) && (marker <= MP_FIXARRAY_MAX)) ||
+	    (marker == MP_ARRAY16) || (marker == MP_ARRAY32) ||
+	    (marker == MP_MAP16) || (marker == MP_MAP32)) {
+		if (in->depth >= MSGPACK_MAX_DEPTH) {
+			debug("MessagePack nested deeper than %d",
+			      MSGPACK_MAX_DEPTH);
+			return ESLURM_DATA_CONV_FAILED;
+		}
+
+		in->depth++;
+
+		if (marker <= MP_FIXMAP_MAX)
+			rc = _read_dict(in, (marker - MP_FIXMAP), d);
+		else if (marker <= MP_FIXARRAY_MAX)
+			rc = _read_list(in, (marker - MP_FIXARRAY), d);
+		else if (!(rc = _read_be(in, (((marker == MP_ARRAY16) ||
+					       (marker == MP_MAP16)) ?
+					      2 : 4), &value))) {
+			if ((marker == MP_ARRAY16) || (marker == MP_ARRAY32))
+				rc = _read_list(in, value, d);
+			else
+				rc = _read_dict(in, value, d);
+		}
+
+		in->depth--;
+
+		return rc;
+	}
+
+	switch (marker) {
+	case MP_FLOAT32:
+	{
+		uint32_t bits;
+		float f;
+
+		if ((rc = _read_be(in, 4, &value)))
+			return rc;
+
+		bits = value;
+		memcpy(&f, &bits, sizeof(f));
+		data_set_float(d, f);
+		break;
+	}
+	case MP_FLOAT64:
+	{
+		double f;
+
+		if ((rc = _read_be(in, 8, &value)))
+			return rc;
+
+		memcpy(&f, &value, sizeof(f));
+		data_set_float(d, f);
+		break;
+	}
+	case MP_UINT8:
+	case MP_UINT16:
+	case MP_UINT32:
+	case MP_UINT64:
+		if ((rc = _read_be(in, (1 << (marker - MP_UINT8)), &value)))
+			return rc;
+
+		/* data_t has no unsigned type: keep magnitude as float */
+		if (value > INT64_MAX)
+			data_set_float(d, value);
+		else
+			data_set_int(d, value);
+		break;
+	case MP_INT8:
+		if (!(rc = _read_be(in, 1, &value)))
+			data_set_int(d, (int8_t) value);
+		break;
+	case MP_INT16:
+		if (!(rc = _read_be(in, 2, &value)))
+			data_set_int(d, (int16_t) value);
+		break;
+	case MP_INT32:
+		if (!(rc = _read_be(in, 4, &value)))
+			data_set_int(d, (int32_t) value);
+		break;
+	case MP_INT64:
+		if (!(rc = _read_be(in, 8, &value)))
+			data_set_int(d, (int64_t) value);
+		break;
+	default:
+		/* extension types and the never used 0xc1 marker */
+		debug("unsupported MessagePack type 0x%02x", marker);
+		rc = ESLURM_DATA_CONV_FAILED;
+	}
+
+	return rc;
+}
+
+extern int serializer_p_deserialize(data_t **dest, const char *src,
+				    size_t len)
+{
+	int rc;
+	data_t *data;
+	mp_in_t in = {
+		.pos = (const uint8_t *) src,
+		.end = (const uint8_t *) src + len,
+	};
+
+	if (!src)
+		return ESLURM_DATA_PTR_NULL;
+
+	data = data_new();
+
+	if ((rc = _msgpack_to_data(&in, data))) {
+		error("%s: unable to parse MessagePack: %s",
+		      __func__, slurm_strerror(rc));
+		FREE_NULL_DATA(data);
+		return rc;
+	}
+
+	/* callers may count the string terminator in len */
+	if (((in.end - in.pos) == 1) && (*in.pos == '\0'))
+		in.pos++;
+
+	if (in.pos < in.end)
+		info("WARNING: Extra %zu bytes after MessagePack detected",
+		     (size_t) (in.end - in.pos));
+
+	*dest = data;
+	return SLURM_SUCCESS;
+}
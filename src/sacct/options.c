@@ -42,6 +42,7 @@
 #include "src/common/proc_args.h"
 #include "src/common/read_config.h"
 #include "src/common/slurm_time.h"
+#include "src/common/slurmdb_export.h"
 #include "src/common/xstring.h"
 #include "sacct.h"
 #include <time.h>
@@ -56,6 +57,8 @@
 #define OPT_LONG_WHETJOB   0x106
 #define OPT_LONG_LOCAL_UID 0x107
 #define OPT_LONG_ENV       0x108
+#define OPT_LONG_EXPORT    0x109
+#define OPT_LONG_IMPORT    0x10a
 
 #define JOB_HASH_SIZE 1000
 
@@ -73,6 +76,7 @@ ListIterator print_fields_itr = NULL;
 int field_count = 0;
 List g_qos_list = NULL;
 List g_tres_list = NULL;
+static slurmdb_export_file_t *import_file = NULL;
 
 static List _build_cluster_list(slurmdb_federation_rec_t *fed)
 {
@@ -359,6 +363,10 @@ sacct [<OPTION>]                                                            \n \
                    NOTE: AccountingStoreFlags=job_env is required for this  \n\
                    NOTE: Requesting specific job(s) with '-j' is required   \n\
                          for this.                                          \n\
+         --export=file:                                                     \n\
+                   Write the selected jobs and steps to file in a columnar  \n\
+                   format instead of printing them, to be read back later   \n\
+                   with --import.                                           \n\
          --federation: Report jobs from federation if a member of a one.    \n\
      -f, --file=file:                                                       \n\
 	           Read data from the specified file, rather than Slurm's   \n\
@@ -369,6 +377,10 @@ sacct [<OPTION>]                                                            \n \
                    to select jobs to display.  By default, all groups are   \n\
                    selected.                                                \n\
      -h, --help:   Print this description of use.                           \n\
+         --import=file:                                                     \n\
+                   Read jobs from a file written with --export rather than  \n\
+                   from the database. All job selection options except      \n\
+                   --ncpus apply.                                           \n\
      -i, --nnodes=N:                                                        \n\
                    Return jobs which ran on this many nodes (N = min[-max]) \n\
      -I, --ncpus=N:                                                         \n\
@@ -607,7 +619,20 @@ static void _remove_duplicate_fed_jobs(List jobs)
 	xfree(hash_job);
 }
 
-extern int get_data(void)
+/*
+ * The jobs are printed as they come from the slurmdbd in chunks, unless the
+ * duplicate federated jobs need to be removed from all of them at once.
+ */
+static bool _get_chunks(void)
+{
+	if (params.opt_import)
+		return false;
+
+	return (!params.cluster_name ||
+		(params.job_cond->flags & JOBCOND_FLAG_DUP));
+}
+
+static void _process_jobs(void)
 {
 	slurmdb_job_rec_t *job = NULL;
 	slurmdb_step_rec_t *step = NULL;
@@ -617,16 +642,6 @@ extern int get_data(void)
 	int cnt;
 	char *tmp_usage;
 
-	if (params.opt_completion) {
-		jobs = slurmdb_jobcomp_jobs_get(job_cond);
-		return SLURM_SUCCESS;
-	} else {
-		jobs = slurmdb_jobs_get(acct_db_conn, job_cond);
-	}
-
-	if (!jobs)
-		return SLURM_ERROR;
-
 	/*
 	 * Remove duplicate federated jobs. The db will remove duplicates for
 	 * one cluster but not when jobs for multiple clusters are requested.
@@ -640,6 +655,10 @@ extern int get_data(void)
 	else
 		list_sort(jobs, _sort_desc_submit_time);
 
+	/* The steps are exported as they are, to be aggregated on import */
+	if (params.opt_export)
+		return;
+
 	itr = list_iterator_create(jobs);
 	while ((job = list_next(itr))) {
 
@@ -680,6 +699,27 @@ extern int get_data(void)
 		list_iterator_destroy(itr_step);
 	}
 	list_iterator_destroy(itr);
+}
+
+extern int get_data(void)
+{
+	slurmdb_job_cond_t *job_cond = params.job_cond;
+
+	if (params.opt_completion) {
+		jobs = slurmdb_jobcomp_jobs_get(job_cond);
+		return SLURM_SUCCESS;
+	} else if (params.opt_import) {
+		jobs = slurmdb_export_get_jobs(import_file, job_cond);
+	} else if (_get_chunks()) {
+		jobs = slurmdb_jobs_get_chunk(acct_db_conn, job_cond);
+	} else {
+		jobs = slurmdb_jobs_get(acct_db_conn, job_cond);
+	}
+
+	if (!jobs)
+		return SLURM_ERROR;
+
+	_process_jobs();
 
 	return SLURM_SUCCESS;
 }
@@ -718,11 +758,13 @@ extern void parse_command_line(int argc, char **argv)
                 {"help-fields",    no_argument,       0,    'e'},
                 {"endtime",        required_argument, 0,    'E'},
                 {"env-vars",       no_argument,       0,    OPT_LONG_ENV},
+                {"export",         required_argument, 0,    OPT_LONG_EXPORT},
                 {"file",           required_argument, 0,    'f'},
                 {"flags",          required_argument, 0,    'F'},
                 {"gid",            required_argument, 0,    'g'},
                 {"group",          required_argument, 0,    'g'},
                 {"help",           no_argument,       0,    'h'},
+                {"import",         required_argument, 0,    OPT_LONG_IMPORT},
                 {"local",          no_argument,       0,    OPT_LONG_LOCAL},
                 {"name",           required_argument, 0,    OPT_LONG_NAME},
                 {"nnodes",         required_argument, 0,    'i'},
@@ -836,6 +878,10 @@ extern void parse_command_line(int argc, char **argv)
 			job_cond->flags |= JOBCOND_FLAG_ENV;
 			job_cond->flags |= JOBCOND_FLAG_NO_STEP;
 			break;
+		case OPT_LONG_EXPORT:
+			xfree(params.opt_export);
+			params.opt_export = xstrdup(optarg);
+			break;
 		case 'f':
 			xfree(params.opt_filein);
 			params.opt_filein = xstrdup(optarg);
@@ -855,6 +901,10 @@ extern void parse_command_line(int argc, char **argv)
 		case 'h':
 			params.opt_help = 1;
 			break;
+		case OPT_LONG_IMPORT:
+			xfree(params.opt_import);
+			params.opt_import = xstrdup(optarg);
+			break;
 		case 'i':
 			set = get_resource_arg_range(
 				optarg,
@@ -1063,6 +1113,14 @@ extern void parse_command_line(int argc, char **argv)
 		fatal("Options --batch-script and --env-vars are mutually exclusive");
 
 
+	if (params.opt_export && params.opt_import)
+		fatal("Options --export and --import are mutually exclusive");
+
+	if ((params.opt_export || params.opt_import) &&
+	    (params.opt_completion ||
+	     (job_cond->flags & (JOBCOND_FLAG_SCRIPT | JOBCOND_FLAG_ENV))))
+		fatal("Options --export and --import can not be used with --completion, --batch-script or --env-vars");
+
 	if (long_output && params.opt_field_list)
 		fatal("Options -o(--format) and -l(--long) are mutually exclusive. Please remove one and retry.");
 
@@ -1145,6 +1203,11 @@ extern void parse_command_line(int argc, char **argv)
 			fprintf(stderr, "Slurm job completion is disabled\n");
 			exit(1);
 		}
+	} else if (params.opt_import) {
+		if (!(import_file = slurmdb_export_open(params.opt_import,
+							&g_tres_list,
+							&g_qos_list)))
+			exit(1);
 	} else {
 		if (slurm_acct_storage_init() != SLURM_SUCCESS) {
 			fprintf(stderr, "Slurm unable to initialize storage plugin\n");
@@ -1185,7 +1248,7 @@ extern void parse_command_line(int argc, char **argv)
 
 	/* specific clusters requested? */
 	if (params.opt_federation && !all_clusters && !job_cond->cluster_list &&
-	    !params.opt_local) {
+	    !params.opt_local && !params.opt_import) {
 		/* Test if in federated cluster and if so, get information from
 		 * all clusters in that federation */
 		slurmdb_federation_rec_t *fed = NULL;
@@ -1484,15 +1547,7 @@ static void _print_env(slurmdb_job_rec_t *job)
 	return;
 }
 
-/* do_list() -- List the assembled data
- *
- * In:	Nothing explicit.
- * Out:	void.
- *
- * At this point, we have already selected the desired data,
- * so we just need to print it for the user.
- */
-extern void do_list(void)
+static void _list_jobs(void)
 {
 	ListIterator itr = NULL;
 	ListIterator itr_step = NULL;
@@ -1500,9 +1555,6 @@ extern void do_list(void)
 	slurmdb_step_rec_t *step = NULL;
 	slurmdb_job_cond_t *job_cond = params.job_cond;
 
-	if (!jobs)
-		return;
-
 	itr = list_iterator_create(jobs);
 	while ((job = list_next(itr))) {
 		if ((params.cluster_name) &&
@@ -1535,6 +1587,82 @@ extern void do_list(void)
 	list_iterator_destroy(itr);
 }
 
+/* do_list() -- List the assembled data
+ *
+ * In:	Nothing explicit.
+ * Out:	SLURM_SUCCESS, or SLURM_ERROR if a chunk couldn't be retrieved.
+ *
+ * At this point, we have already selected the desired data, or its
+ * first chunk, so we just need to print it for the user.
+ */
+extern int do_list(void)
+{
+	if (!jobs)
+		return SLURM_SUCCESS;
+
+	while (true) {
+		_list_jobs();
+
+		if (!_get_chunks() || !list_count(jobs))
+			break;
+
+		FREE_NULL_LIST(jobs);
+		if (!(jobs = slurmdb_jobs_get_chunk(acct_db_conn, NULL)))
+			return SLURM_ERROR;
+		_process_jobs();
+	}
+
+	return SLURM_SUCCESS;
+}
+
+/* do_export() -- Export the assembled data
+ *
+ * In:	Nothing explicit.
+ * Out:	SLURM_SUCCESS, or SLURM_ERROR if a chunk couldn't be retrieved or
+ *	the file couldn't be written.
+ *
+ * The jobs are written to the export file as they come from the slurmdbd,
+ * followed by the TRES and QOS tables needed to print them.
+ */
+extern int do_export(void)
+{
+	slurmdb_export_t *exp;
+	slurmdb_tres_cond_t tres_cond;
+	slurmdb_qos_cond_t qos_cond;
+
+	if (!(exp = slurmdb_export_create(params.opt_export)))
+		return SLURM_ERROR;
+
+	while (jobs && list_count(jobs)) {
+		if (slurmdb_export_add_jobs(exp, jobs) != SLURM_SUCCESS) {
+			slurmdb_export_destroy(exp);
+			return SLURM_ERROR;
+		}
+
+		if (!_get_chunks())
+			break;
+
+		FREE_NULL_LIST(jobs);
+		if (!(jobs = slurmdb_jobs_get_chunk(acct_db_conn, NULL))) {
+			slurmdb_export_destroy(exp);
+			return SLURM_ERROR;
+		}
+	}
+
+	if (!g_tres_list) {
+		memset(&tres_cond, 0, sizeof(slurmdb_tres_cond_t));
+		tres_cond.with_deleted = 1;
+		g_tres_list = slurmdb_tres_get(acct_db_conn, &tres_cond);
+	}
+	if (!g_qos_list) {
+		memset(&qos_cond, 0, sizeof(slurmdb_qos_cond_t));
+		qos_cond.with_deleted = 1;
+		g_qos_list = slurmdb_qos_get(acct_db_conn, &qos_cond);
+	}
+
+	return slurmdb_export_finish(exp, g_tres_list, g_qos_list);
+}
+
 /* do_list_completion() -- List the assembled data
  *
  * In:	Nothing explicit.
@@ -1577,11 +1705,15 @@ extern void sacct_fini(void)
 
 	if (params.opt_completion)
 		slurmdb_jobcomp_fini();
+	else if (params.opt_import)
+		slurmdb_export_close(import_file);
 	else {
 		slurmdb_connection_close(&acct_db_conn);
 		slurm_acct_storage_fini();
 	}
+	xfree(params.opt_export);
 	xfree(params.opt_field_list);
 	xfree(params.opt_filein);
+	xfree(params.opt_import);
 	slurmdb_destroy_job_cond(params.job_cond);
 }
@@ -181,6 +181,12 @@ int main(int argc, char **argv)
 
 	switch (op) {
 	case SACCT_LIST:
+		if (params.opt_export) {
+			if ((get_data() == SLURM_ERROR) ||
+			    (do_export() == SLURM_ERROR))
+				exit(errno);
+			break;
+		}
 		if (!(params.job_cond->flags & JOBCOND_FLAG_SCRIPT) &&
 		    !(params.job_cond->flags & JOBCOND_FLAG_ENV))
 			print_fields_header(print_fields_list);
@@ -188,8 +194,8 @@ int main(int argc, char **argv)
 			exit(errno);
 		if (params.opt_completion)
 			do_list_completion();
-		else
-			do_list();
+		else if (do_list() == SLURM_ERROR)
+			exit(errno);
 		break;
 	case SACCT_HELP:
 		do_help();
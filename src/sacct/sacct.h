@@ -201,11 +201,13 @@ typedef struct {
 	uint32_t convert_flags;	/* --noconvert */
 	slurmdb_job_cond_t *job_cond;
 	int opt_completion;	/* --completion */
+	char *opt_export;	/* --export */
 	bool opt_federation;	/* --federation */
 	char *opt_field_list;	/* --fields= */
 	char *opt_filein;	/* --file */
 	int opt_gid;		/* running persons gid */
 	int opt_help;		/* --help */
+	char *opt_import;	/* --import */
 	bool opt_local;		/* --local */
 	int opt_noheader;	/* can only be cleared */
 	int opt_uid;		/* running persons uid */
@@ -233,7 +235,8 @@ void print_fields(type_t type, void *object);
 int  get_data(void);
 void parse_command_line(int argc, char **argv);
 void do_help(void);
-void do_list(void);
+int  do_export(void);
+int  do_list(void);
 void do_list_completion(void);
 void sacct_init(void);
 void sacct_fini(void);
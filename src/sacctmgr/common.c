@@ -979,7 +979,7 @@ extern int sacctmgr_remove_assoc_usage(slurmdb_assoc_cond_t *assoc_cond)
 				update_list, cluster,
 				cluster_rec->control_host,
 				cluster_rec->control_port,
-				cluster_rec->rpc_version);
+				cluster_rec->rpc_version, 0, 0);
 		} else {
 			slurmdb_destroy_update_object(update_obj);
 		}
@@ -1071,7 +1071,7 @@ extern int sacctmgr_remove_qos_usage(slurmdb_qos_cond_t *qos_cond)
 				update_list, cluster_name,
 				cluster_rec->control_host,
 				cluster_rec->control_port,
-				cluster_rec->rpc_version);
+				cluster_rec->rpc_version, 0, 0);
 		} else {
 			slurmdb_destroy_update_object(update_obj);
 		}
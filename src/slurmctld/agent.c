@@ -852,6 +852,27 @@ static int _wif_status(void)
 	return rc;
 }
 
+/*
+ * Record node state carried in a REQUEST_PING or REQUEST_ACCT_GATHER_UPDATE
+ * reply. Call with node write lock held.
+ */
+static int _update_node_from_resp(void *x, void *arg)
+{
+	ret_data_info_t *ret_data_info = x;
+
+	if (ret_data_info->type == RESPONSE_PING_SLURMD) {
+		ping_slurmd_resp_msg_t *ping_resp = ret_data_info->data;
+
+		reset_node_load(ret_data_info->node_name, ping_resp->cpu_load);
+		reset_node_free_mem(ret_data_info->node_name,
+				    ping_resp->free_mem);
+	} else if (ret_data_info->type == RESPONSE_ACCT_GATHER_UPDATE) {
+		update_node_record_acct_gather_data(ret_data_info->data);
+	}
+
+	return 0;
+}
+
 /*
  * _thread_per_group_rpc - thread to issue an RPC for a group of nodes
  *                         sending message out to one and forwarding it to
@@ -984,22 +1005,23 @@ static void *_thread_per_group_rpc(void *args)
 	}
 
 	//info("got %d messages back", list_count(ret_list));
+
+	/*
+	 * SPECIAL CASE: Record node's CPU load, free memory and acct_gather
+	 * data. ret_list holds the replies of every node this message was
+	 * forwarded to, so record them all under a single node write lock.
+	 */
+	if ((msg_type == REQUEST_PING) ||
+	    (msg_type == REQUEST_ACCT_GATHER_UPDATE)) {
+		lock_slurmctld(node_write_lock);
+		(void) list_for_each(ret_list, _update_node_from_resp, NULL);
+		unlock_slurmctld(node_write_lock);
+	}
+
 	itr = list_iterator_create(ret_list);
 	while ((ret_data_info = list_next(itr))) {
 		rc = slurm_get_return_code(ret_data_info->type,
 					   ret_data_info->data);
-		/* SPECIAL CASE: Record node's CPU load */
-		if (ret_data_info->type == RESPONSE_PING_SLURMD) {
-			ping_slurmd_resp_msg_t *ping_resp;
-			ping_resp = (ping_slurmd_resp_msg_t *)
-				    ret_data_info->data;
-			lock_slurmctld(node_write_lock);
-			reset_node_load(ret_data_info->node_name,
-					ping_resp->cpu_load);
-			reset_node_free_mem(ret_data_info->node_name,
-					    ping_resp->free_mem);
-			unlock_slurmctld(node_write_lock);
-		}
 		/* SPECIAL CASE: Mark node as IDLE if job already complete */
 		if (is_kill_msg &&
 		    (rc == ESLURMD_KILL_JOB_ALREADY_COMPLETE)) {
@@ -1014,14 +1036,6 @@ static void *_thread_per_group_rpc(void *args)
 			unlock_slurmctld(job_write_lock);
 		}
 
-		/* SPECIAL CASE: Record node's CPU load */
-		if (ret_data_info->type == RESPONSE_ACCT_GATHER_UPDATE) {
-			lock_slurmctld(node_write_lock);
-			update_node_record_acct_gather_data(
-				ret_data_info->data);
-			unlock_slurmctld(node_write_lock);
-		}
-
 		/* SPECIAL CASE: Requeue/hold non-startable batch job,
 		 * Requeue job prolog failure or duplicate job ID */
 		if ((msg_type == REQUEST_BATCH_JOB_LAUNCH) &&
@@ -61,6 +61,7 @@
 #include "src/common/assoc_mgr.h"
 #include "src/common/daemonize.h"
 #include "src/common/fd.h"
+#include "src/common/forward.h"
 #include "src/common/gres.h"
 #include "src/common/group_cache.h"
 #include "src/common/hostlist.h"
@@ -903,6 +904,7 @@ int main(int argc, char **argv)
 	slurm_auth_fini();
 	switch_fini();
 	route_fini();
+	forward_fini();
 
 	/* purge remaining data structures */
 	group_cache_purge();
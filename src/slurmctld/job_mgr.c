@@ -179,6 +179,16 @@ static bitstr_t *requeue_exit = NULL;
 static bitstr_t *requeue_exit_hold = NULL;
 static bool     validate_cfgd_licenses = true;
 
+/*
+ * Jobs allocated to each node, built once per batch of node registrations
+ * (see validate_jobs_batch_begin()) so that _purge_missing_jobs() does not
+ * walk the whole job_list for every registering node. The jobs of node i are
+ * node_job_index[node_job_offset[i]] to node_job_index[node_job_offset[i+1]-1].
+ */
+static bool     node_job_batch = false;
+static job_record_t **node_job_index = NULL;
+static int     *node_job_offset = NULL;
+
 /* Local functions */
 static void _add_job_hash(job_record_t *job_ptr);
 static void _add_job_array_hash(job_record_t *job_ptr);
@@ -228,6 +238,7 @@ static void _pack_default_job_details(job_record_t *job_ptr, buf_t *buffer,
 static void _pack_pending_job_details(struct job_details *detail_ptr,
 				      buf_t *buffer, uint16_t protocol_version);
 static bool _parse_array_tok(char *tok, bitstr_t *array_bitmap, uint32_t max);
+static void _build_node_job_index(void);
 static void _purge_missing_jobs(int node_inx, time_t now);
 static int  _read_data_array_from_file(int fd, char *file_name, char ***data,
 				       uint32_t *size, job_record_t *job_ptr);
@@ -15132,10 +15143,11 @@ validate_jobs_on_node(slurm_node_registration_status_msg_t *reg_msg)
  * but are not found. */
 static void _purge_missing_jobs(int node_inx, time_t now)
 {
-	ListIterator job_iterator;
+	ListIterator job_iterator = NULL;
 	job_record_t *job_ptr;
 	node_record_t *node_ptr = node_record_table_ptr + node_inx;
 	time_t batch_startup_time, node_boot_time = (time_t) 0, startup_time;
+	int i = 0, last = 0;
 
 	if (node_ptr->boot_time > (slurm_conf.msg_timeout + 5)) {
 		/* allow for message timeout and other delays */
@@ -15145,8 +15157,22 @@ static void _purge_missing_jobs(int node_inx, time_t now)
 	batch_startup_time  = now - slurm_conf.batch_start_timeout;
 	batch_startup_time -= MIN(DEFAULT_MSG_TIMEOUT, slurm_conf.msg_timeout);
 
-	job_iterator = list_iterator_create(job_list);
-	while ((job_ptr = list_next(job_iterator))) {
+	if (node_job_batch) {
+		if (!node_job_index)
+			_build_node_job_index();
+		i = node_job_offset[node_inx];
+		last = node_job_offset[node_inx + 1];
+	} else
+		job_iterator = list_iterator_create(job_list);
+
+	while (1) {
+		if (job_iterator)
+			job_ptr = list_next(job_iterator);
+		else
+			job_ptr = (i < last) ? node_job_index[i++] : NULL;
+		if (!job_ptr)
+			break;
+
 		if ((IS_JOB_CONFIGURING(job_ptr) ||
 		    (!IS_JOB_RUNNING(job_ptr) && !IS_JOB_SUSPENDED(job_ptr))) ||
 		    (!bit_test(job_ptr->node_bitmap, node_inx)))
@@ -15180,7 +15206,96 @@ static void _purge_missing_jobs(int node_inx, time_t now)
 						  now, node_boot_time);
 		}
 	}
-	list_iterator_destroy(job_iterator);
+	if (job_iterator)
+		list_iterator_destroy(job_iterator);
+}
+
+static int _count_node_jobs(void *x, void *arg)
+{
+	job_record_t *job_ptr = x;
+	int *cnt = arg;
+	int first, last;
+
+	if ((!IS_JOB_RUNNING(job_ptr) && !IS_JOB_SUSPENDED(job_ptr)) ||
+	    !job_ptr->node_bitmap || ((first = bit_ffs(job_ptr->node_bitmap)) < 0))
+		return 0;
+
+	last = bit_fls(job_ptr->node_bitmap);
+	for (int i = first; i <= last; i++) {
+		if (bit_test(job_ptr->node_bitmap, i))
+			cnt[i + 1]++;
+	}
+
+	return 0;
+}
+
+static int _index_node_jobs(void *x, void *arg)
+{
+	job_record_t *job_ptr = x;
+	int *next = arg;
+	int first, last;
+
+	if ((!IS_JOB_RUNNING(job_ptr) && !IS_JOB_SUSPENDED(job_ptr)) ||
+	    !job_ptr->node_bitmap || ((first = bit_ffs(job_ptr->node_bitmap)) < 0))
+		return 0;
+
+	last = bit_fls(job_ptr->node_bitmap);
+	for (int i = first; i <= last; i++) {
+		if (bit_test(job_ptr->node_bitmap, i))
+			node_job_index[next[i]++] = job_ptr;
+	}
+
+	return 0;
+}
+
+/* Build node_job_index/node_job_offset from job_list in two passes */
+static void _build_node_job_index(void)
+{
+	int *next;
+
+	node_job_offset = xcalloc(node_record_count + 1, sizeof(int));
+	(void) list_for_each(job_list, _count_node_jobs, node_job_offset);
+	for (int i = 0; i < node_record_count; i++)
+		node_job_offset[i + 1] += node_job_offset[i];
+
+	node_job_index = xcalloc(node_job_offset[node_record_count] + 1,
+				 sizeof(job_record_t *));
+	next = xcalloc(node_record_count, sizeof(int));
+	memcpy(next, node_job_offset, node_record_count * sizeof(int));
+	(void) list_for_each(job_list, _index_node_jobs, next);
+	xfree(next);
+
+	log_flag(PROTOCOL, "%s: indexed %d job allocations over %d nodes",
+		 __func__, node_job_offset[node_record_count],
+		 node_record_count);
+}
+
+/*
+ * validate_jobs_batch_begin - start processing a batch of node registrations
+ *	under a single job write lock. Until validate_jobs_batch_end() is
+ *	called, validate_jobs_on_node() looks up the jobs allocated to a node
+ *	from an index built once for the batch rather than walking job_list for
+ *	every registering node.
+ */
+extern void validate_jobs_batch_begin(void)
+{
+	xassert(verify_lock(JOB_LOCK, WRITE_LOCK));
+	xassert(!node_job_batch);
+
+	node_job_batch = true;
+}
+
+/*
+ * validate_jobs_batch_end - end a batch started by validate_jobs_batch_begin()
+ *	must be called before the job write lock is released.
+ */
+extern void validate_jobs_batch_end(void)
+{
+	xassert(verify_lock(JOB_LOCK, WRITE_LOCK));
+
+	node_job_batch = false;
+	xfree(node_job_index);
+	xfree(node_job_offset);
 }
 
 static void _notify_srun_missing_step(job_record_t *job_ptr, int node_inx,
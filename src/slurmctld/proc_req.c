@@ -2003,6 +2003,67 @@ static void  _slurm_rpc_epilog_complete(slurm_msg_t *msg)
 	/* NOTE: RPC has no response */
 }
 
+/*
+ * _slurm_rpc_composite_epilog_complete - process RPC noting the completion of
+ * the epilog of several jobs on one node, all under one lock acquisition
+ */
+static void _slurm_rpc_composite_epilog_complete(slurm_msg_t *msg)
+{
+	static int active_rpc_cnt = 0;
+	static time_t config_update = 0;
+	static bool defer_sched = false;
+	DEF_TIMERS;
+	/* Locks: Read configuration, write job, write node */
+	slurmctld_lock_t job_write_lock = {
+		READ_LOCK, WRITE_LOCK, WRITE_LOCK, NO_LOCK, NO_LOCK };
+	composite_epilog_msg_t *comp_msg = msg->data;
+	bool run_scheduler = false;
+
+	START_TIMER;
+	if (!validate_slurm_user(msg->auth_uid)) {
+		error("Security violation, COMPOSITE_EPILOG_COMPLETE RPC from uid=%u",
+		      msg->auth_uid);
+		return;
+	}
+
+	if (config_update != slurm_conf.last_update) {
+		defer_sched = (xstrcasestr(slurm_conf.sched_params, "defer"));
+		config_update = slurm_conf.last_update;
+	}
+
+	_throttle_start(&active_rpc_cnt);
+	lock_slurmctld(job_write_lock);
+	for (int i = 0; i < comp_msg->job_cnt; i++) {
+		if (job_epilog_complete(comp_msg->job_id[i],
+					comp_msg->node_name,
+					comp_msg->return_code[i]))
+			run_scheduler = true;
+
+		if (comp_msg->return_code[i])
+			error("%s: epilog error JobId=%u Node=%s Err=%s",
+			      __func__, comp_msg->job_id[i],
+			      comp_msg->node_name,
+			      slurm_strerror(comp_msg->return_code[i]));
+	}
+	unlock_slurmctld(job_write_lock);
+	_throttle_fini(&active_rpc_cnt);
+	END_TIMER2("_slurm_rpc_composite_epilog_complete");
+
+	debug2("%s: %u jobs Node=%s %s",
+	       __func__, comp_msg->job_cnt, comp_msg->node_name, TIME_STR);
+
+	/* Functions below provide their own locking */
+	if (run_scheduler) {
+		/* See _slurm_rpc_epilog_complete() */
+		if (!LOTS_OF_AGENTS && !defer_sched)
+			(void) schedule(0);	/* Has own locking */
+		schedule_node_save();		/* Has own locking */
+		schedule_job_save();		/* Has own locking */
+	}
+
+	/* NOTE: RPC has no response */
+}
+
 /* _slurm_rpc_job_step_kill - process RPC to cancel an entire job or
  * an individual job step */
 static void _slurm_rpc_job_step_kill(slurm_msg_t *msg)
@@ -5218,7 +5279,8 @@ static void _slurm_rpc_accounting_update_msg(slurm_msg_t *msg)
 			fed_mgr_update_feds(object);
 		}
 
-		rc = assoc_mgr_update(update_ptr->update_list, 0);
+		rc = assoc_mgr_update_state(update_ptr->update_list,
+					    update_ptr->epoch, update_ptr->gen);
 	}
 	_throttle_fini(&active_rpc_cnt);
 
@@ -6210,6 +6272,9 @@ slurmctld_rpc_t slurmctld_rpcs[] =
 	},{
 		.msg_type = MESSAGE_EPILOG_COMPLETE,
 		.func = _slurm_rpc_epilog_complete,
+	},{
+		.msg_type = MESSAGE_COMPOSITE_EPILOG_COMPLETE,
+		.func = _slurm_rpc_composite_epilog_complete,
 	},{
 		.msg_type = REQUEST_CANCEL_JOB_STEP,
 		.func = _slurm_rpc_job_step_kill,
@@ -6259,6 +6324,8 @@ slurmctld_rpc_t slurmctld_rpcs[] =
 		.msg_type = MESSAGE_NODE_REGISTRATION_STATUS,
 		.func = _slurm_rpc_node_registration,
 		.queue_enabled = true,
+		.batch_begin = validate_jobs_batch_begin,
+		.batch_end = validate_jobs_batch_end,
 		.locks = {
 			.conf = READ_LOCK,
 			.job = WRITE_LOCK,
@@ -6406,6 +6473,9 @@ slurmctld_rpc_t slurmctld_rpcs[] =
 	},{
 		.msg_type = ACCOUNTING_UPDATE_MSG,
 		.func = _slurm_rpc_accounting_update_msg,
+	},{
+		.msg_type = ACCOUNTING_UPDATE_LOG_MSG,
+		.func = _slurm_rpc_accounting_update_msg,
 	},{
 		.msg_type = ACCOUNTING_FIRST_REG,
 		.func = _slurm_rpc_accounting_first_reg,
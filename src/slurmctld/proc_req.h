@@ -50,6 +50,13 @@ typedef struct {
 	void (*func)(slurm_msg_t *msg);
 	slurmctld_lock_t locks;
 
+	/*
+	 * Optional, called with locks held before the first and after the
+	 * last message processed in one lock acquisition by the queue.
+	 */
+	void (*batch_begin)(void);
+	void (*batch_end)(void);
+
 	/* Queue structual elements */
 	char *msg_name; /* automatically derived from msg_type */
 
@@ -75,6 +75,8 @@ static void *_rpc_queue_worker(void *arg)
 	 * On rpc_queue_init() this will proceed directly to slurm_cond_wait().
 	 */
 	lock_slurmctld(q->locks);
+	if (q->batch_begin)
+		q->batch_begin();
 
 	/*
 	 * Process as many queued messages as possible in one slurmctld_lock()
@@ -84,6 +86,8 @@ static void *_rpc_queue_worker(void *arg)
 		msg = list_dequeue(q->work);
 
 		if (!msg) {
+			if (q->batch_end)
+				q->batch_end();
 			unlock_slurmctld(q->locks);
 
 			log_flag(PROTOCOL, "%s(%s): sleeping after processing %d",
@@ -125,6 +129,8 @@ static void *_rpc_queue_worker(void *arg)
 			log_flag(PROTOCOL, "%s(%s): woke up",
 				 __func__, q->msg_name);
 			lock_slurmctld(q->locks);
+			if (q->batch_begin)
+				q->batch_begin();
 		} else {
 			DEF_TIMERS;
 			START_TIMER;
@@ -2564,6 +2564,14 @@ extern int validate_job_create_req(job_desc_msg_t * job_desc, uid_t submit_uid,
  */
 extern void validate_jobs_on_node(slurm_node_registration_status_msg_t *reg_msg);
 
+/*
+ * validate_jobs_batch_begin - start processing a batch of node registrations
+ *	under a single job write lock, see validate_jobs_on_node()
+ * validate_jobs_batch_end - end the batch, call before releasing the lock
+ */
+extern void validate_jobs_batch_begin(void);
+extern void validate_jobs_batch_end(void);
+
 /*
  * validate_node_specs - validate the node's specifications as valid,
  *	if not set state to down, in any case update last_response
@@ -251,6 +251,14 @@ static List file_bcast_list = NULL;
 
 static pthread_mutex_t waiter_mutex = PTHREAD_MUTEX_INITIALIZER;
 
+/*
+ * Epilog complete messages waiting to be sent as a single
+ * MESSAGE_COMPOSITE_EPILOG_COMPLETE, see SlurmdParameters=epilog_msg_window
+ */
+static pthread_mutex_t epilog_comp_mutex = PTHREAD_MUTEX_INITIALIZER;
+static composite_epilog_msg_t *epilog_comp_pend = NULL;
+static uint32_t epilog_comp_alloc = 0;
+
 void
 slurmd_req(slurm_msg_t *msg)
 {
@@ -4534,9 +4542,57 @@ static void _epilog_complete_msg_setup(
 	msg->data        = req;
 }
 
+/*
+ * Wait for epilog_msg_window to collect the epilog completions of other jobs
+ * ending on this node, then send them to the controller in one message.
+ */
+static void *_epilog_complete_agent(void *arg)
+{
+	composite_epilog_msg_t *comp_msg;
+	slurm_msg_t msg;
+
+	usleep(conf->epilog_msg_window * 1000);
+
+	slurm_mutex_lock(&epilog_comp_mutex);
+	comp_msg = epilog_comp_pend;
+	epilog_comp_pend = NULL;
+	epilog_comp_alloc = 0;
+	slurm_mutex_unlock(&epilog_comp_mutex);
+
+	if (!comp_msg)
+		return NULL;
+
+	if (comp_msg->job_cnt == 1) {
+		epilog_complete_msg_t req;
+
+		_epilog_complete_msg_setup(&msg, &req, comp_msg->job_id[0],
+					   comp_msg->return_code[0]);
+	} else {
+		slurm_msg_t_init(&msg);
+		msg.msg_type = MESSAGE_COMPOSITE_EPILOG_COMPLETE;
+		msg.data = comp_msg;
+	}
+
+	/*
+	 * Note: No return code from message, slurmctld will resend
+	 * TERMINATE_JOB request if message send fails.
+	 */
+	if (slurm_send_only_controller_msg(&msg, working_cluster_rec) < 0)
+		error("Unable to send epilog complete message for %u jobs: %m",
+		      comp_msg->job_cnt);
+	else
+		debug("sent epilog complete msg for %u jobs",
+		      comp_msg->job_cnt);
+
+	slurm_free_composite_epilog_msg(comp_msg);
+
+	return NULL;
+}
+
 /*
  *  Send epilog complete message to currently active controller.
- *   Returns SLURM_SUCCESS if message sent successfully,
+ *   Returns SLURM_SUCCESS if message sent successfully (or queued to be sent
+ *           with other jobs' epilog complete messages),
  *           SLURM_ERROR if epilog complete message fails to be sent.
  */
 static int _epilog_complete(uint32_t jobid, int rc)
@@ -4544,6 +4600,32 @@ static int _epilog_complete(uint32_t jobid, int rc)
 	slurm_msg_t msg;
 	epilog_complete_msg_t req;
 
+	if (conf->epilog_msg_window) {
+		slurm_mutex_lock(&epilog_comp_mutex);
+		if (!epilog_comp_pend) {
+			epilog_comp_pend = xmalloc(sizeof(*epilog_comp_pend));
+			epilog_comp_pend->node_name = xstrdup(conf->node_name);
+			slurm_thread_create_detached(NULL,
+						     _epilog_complete_agent,
+						     NULL);
+		}
+		if (epilog_comp_pend->job_cnt >= epilog_comp_alloc) {
+			epilog_comp_alloc = MAX(16, epilog_comp_alloc * 2);
+			xrecalloc(epilog_comp_pend->job_id, epilog_comp_alloc,
+				  sizeof(uint32_t));
+			xrecalloc(epilog_comp_pend->return_code,
+				  epilog_comp_alloc, sizeof(uint32_t));
+		}
+		epilog_comp_pend->job_id[epilog_comp_pend->job_cnt] = jobid;
+		epilog_comp_pend->return_code[epilog_comp_pend->job_cnt] = rc;
+		epilog_comp_pend->job_cnt++;
+		slurm_mutex_unlock(&epilog_comp_mutex);
+
+		debug("JobId=%u: queued epilog complete msg: rc = %d",
+		      jobid, rc);
+		return SLURM_SUCCESS;
+	}
+
 	_epilog_complete_msg_setup(&msg, &req, jobid, rc);
 
 	/*
@@ -855,7 +855,7 @@ static void
 _read_config(void)
 {
 	char *bcast_address;
-	char *path_pubkey = NULL;
+	char *path_pubkey = NULL, *tmp_ptr;
 	slurm_conf_t *cf = NULL;
 	int cc;
 	bool cgroup_mem_confinement = false;
@@ -1061,6 +1061,16 @@ _read_config(void)
 	if (cc != -1)
 		conf->acct_freq_task = cc;
 
+	conf->epilog_msg_window = 0;
+	if ((tmp_ptr = xstrcasestr(cf->slurmd_params, "epilog_msg_window="))) {
+		cc = atoi(tmp_ptr + 18);
+		if ((cc < 0) || (cc > 10000))
+			error("Invalid SlurmdParameters epilog_msg_window=%d, must be between 0 and 10000 msec",
+			      cc);
+		else
+			conf->epilog_msg_window = cc;
+	}
+
 	if (cf->control_addr == NULL)
 		fatal("Unable to establish controller machine");
 	if (cf->slurmctld_port == 0)
@@ -1944,6 +1954,7 @@ _slurmd_fini(void)
 	fini_system_cgroup();
 	cgroup_g_fini();
 	route_fini();
+	forward_fini();
 	xcpuinfo_fini();
 	slurm_mutex_lock(&fini_job_mutex);
 	xfree(fini_job_id);
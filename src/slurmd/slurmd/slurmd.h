@@ -135,6 +135,8 @@ typedef struct slurmd_config {
 
 	pthread_mutex_t config_mutex;	/* lock for slurmd_config access   */
 	uint16_t        acct_freq_task;
+	uint32_t        epilog_msg_window; /* msec to aggregate epilog
+					    * complete messages */
 
 	List		starting_steps; /* steps that are starting but cannot
 					   receive RPCs yet */
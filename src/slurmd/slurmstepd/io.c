@@ -56,6 +56,7 @@
 #include <sys/socket.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <termios.h>
 #include <unistd.h>
 
@@ -94,6 +95,13 @@ struct io_operations client_ops = {
 };
 
 #define CLIENT_IO_MAGIC 0x10102
+/*
+ * Flow control watermarks, see SlurmdParameters=stdio_task_buffer and
+ * stdio_msg_buffers. Set in io_init_tasks_stdio().
+ */
+static int task_buf_max = STDIO_TASK_BUF_MAX;	/* bytes per task stream */
+static int msg_buf_max = STDIO_MAX_FREE_BUF;	/* message buffers per dir */
+
 struct client_io_info {
 	int                   magic;
 	stepd_step_rec_t    *job;		 /* pointer back to job data   */
@@ -422,14 +430,29 @@ _client_read(eio_obj_t *obj, List objs)
 }
 
 /*
- * Write outgoing packed messages to the client socket.
+ * Put messages which could not be written back at the head of the queue,
+ * preserving their order.
+ */
+static void _requeue_outgoing_msgs(struct client_io_info *client,
+				   struct io_buf **msgs, int cnt)
+{
+	while (cnt-- > 0)
+		list_push(client->msg_queue, msgs[cnt]);
+}
+
+/*
+ * Write outgoing packed messages to the client socket. Messages already
+ * waiting in the queue are coalesced into a single writev() so that many
+ * small task output frames do not each cost a system call and a packet.
  */
 static int
 _client_write(eio_obj_t *obj, List objs)
 {
 	struct client_io_info *client = (struct client_io_info *) obj->arg;
-	void *buf;
-	int n;
+	struct io_buf *msgs[STDIO_MAX_IOV];
+	struct iovec iov[STDIO_MAX_IOV];
+	ssize_t n;
+	int cnt, i;
 
 	xassert(client->magic == CLIENT_IO_MAGIC);
 
@@ -452,35 +475,51 @@ _client_write(eio_obj_t *obj, List objs)
 
 	debug5("  client->out_remaining = %d", client->out_remaining);
 
+	msgs[0] = client->out_msg;
+	iov[0].iov_base = client->out_msg->data +
+		(client->out_msg->length - client->out_remaining);
+	iov[0].iov_len = client->out_remaining;
+	for (cnt = 1; cnt < STDIO_MAX_IOV; cnt++) {
+		if (!(msgs[cnt] = list_dequeue(client->msg_queue)))
+			break;
+		iov[cnt].iov_base = msgs[cnt]->data;
+		iov[cnt].iov_len = msgs[cnt]->length;
+	}
+
 	/*
-	 * Write message to socket.
+	 * Write messages to socket.
 	 */
-	buf = client->out_msg->data +
-		(client->out_msg->length - client->out_remaining);
 again:
-	if ((n = write(obj->fd, buf, client->out_remaining)) < 0) {
+	if ((n = writev(obj->fd, iov, cnt)) < 0) {
 		if (errno == EINTR) {
 			goto again;
 		} else if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
 			debug5("_client_write returned EAGAIN");
+			_requeue_outgoing_msgs(client, msgs + 1, cnt - 1);
 			return SLURM_SUCCESS;
 		} else {
 			client->out_eof = true;
+			_requeue_outgoing_msgs(client, msgs + 1, cnt - 1);
 			_free_all_outgoing_msgs(client->msg_queue, client->job);
 			return SLURM_SUCCESS;
 		}
 	}
-	if (n < client->out_remaining) {
-		error("Only wrote %d of %d bytes to socket",
-		      n, client->out_remaining);
-	} else
-		debug5("Wrote %d bytes to socket", n);
-	client->out_remaining -= n;
-	if (client->out_remaining > 0)
-		return SLURM_SUCCESS;
+	debug5("Wrote %zd bytes from %d messages to socket", n, cnt);
+
+	/* Release every message which has been written completely */
+	for (i = 0; i < cnt; i++) {
+		if ((size_t) n < iov[i].iov_len)
+			break;
+		n -= iov[i].iov_len;
+		_free_outgoing_msg(msgs[i], client->job);
+	}
 
-	_free_outgoing_msg(client->out_msg, client->job);
-	client->out_msg = NULL;
+	if (i < cnt) {
+		client->out_msg = msgs[i];
+		client->out_remaining = iov[i].iov_len - n;
+		_requeue_outgoing_msgs(client, msgs + i + 1, cnt - i - 1);
+	} else
+		client->out_msg = NULL;
 
 	return SLURM_SUCCESS;
 }
@@ -708,7 +747,7 @@ _create_task_out_eio(int fd, uint16_t type,
 	out->gtaskid = task->gtid;
 	out->ltaskid = task->id;
 	out->job = job;
-	out->buf = cbuf_create(MAX_MSG_LEN, MAX_MSG_LEN*4);
+	out->buf = cbuf_create(MAX_MSG_LEN, task_buf_max);
 	out->eof = false;
 	out->eof_msg_sent = false;
 	if (cbuf_opt_set(out->buf, CBUF_OPT_OVERWRITE, CBUF_NO_DROP) == -1)
@@ -1163,11 +1202,41 @@ _init_task_stdio_fds(stepd_step_task_info_t *task, stepd_step_rec_t *job)
 	return SLURM_SUCCESS;
 }
 
+/*
+ * Read the stdio flow control watermarks from SlurmdParameters
+ */
+static void _init_stdio_params(void)
+{
+	char *tmp_ptr;
+
+	if ((tmp_ptr = xstrcasestr(slurm_conf.slurmd_params,
+				   "stdio_task_buffer="))) {
+		int val = atoi(tmp_ptr + 18);
+		if (val < MAX_MSG_LEN)
+			error("SlurmdParameters option stdio_task_buffer=%d is less than %d, ignored",
+			      val, MAX_MSG_LEN);
+		else
+			task_buf_max = val;
+	}
+	if ((tmp_ptr = xstrcasestr(slurm_conf.slurmd_params,
+				   "stdio_msg_buffers="))) {
+		int val = atoi(tmp_ptr + 18);
+		/* The message cache uses up free message buffers */
+		if (val <= STDIO_MAX_MSG_CACHE)
+			error("SlurmdParameters option stdio_msg_buffers=%d is not more than %d, ignored",
+			      val, STDIO_MAX_MSG_CACHE);
+		else
+			msg_buf_max = val;
+	}
+}
+
 int
 io_init_tasks_stdio(stepd_step_rec_t *job)
 {
 	int i, rc = SLURM_SUCCESS, tmprc;
 
+	_init_stdio_params();
+
 	for (i = 0; i < job->node_tasks; i++) {
 		tmprc = _init_task_stdio_fds(job->task[i], job);
 		if (tmprc != SLURM_SUCCESS)
@@ -1875,7 +1944,7 @@ _incoming_buf_free(stepd_step_rec_t *job)
 
 	if (list_count(job->free_incoming) > 0) {
 		return true;
-	} else if (job->incoming_count < STDIO_MAX_FREE_BUF) {
+	} else if (job->incoming_count < msg_buf_max) {
 		buf = alloc_io_buf();
 		if (buf != NULL) {
 			list_enqueue(job->free_incoming, buf);
@@ -1894,7 +1963,7 @@ _outgoing_buf_free(stepd_step_rec_t *job)
 
 	if (list_count(job->free_outgoing) > 0) {
 		return true;
-	} else if (job->outgoing_count < STDIO_MAX_FREE_BUF) {
+	} else if (job->outgoing_count < msg_buf_max) {
 		buf = alloc_io_buf();
 		if (buf != NULL) {
 			list_enqueue(job->free_outgoing, buf);
@@ -50,6 +50,12 @@
 #define STDIO_MAX_FREE_BUF 1024
 #define STDIO_MAX_MSG_CACHE 128
 
+/* Default maximum bytes of unsent output buffered per task stream */
+#define STDIO_TASK_BUF_MAX (MAX_MSG_LEN * 4)
+
+/* Maximum number of queued messages coalesced into one writev() */
+#define STDIO_MAX_IOV 64
+
 struct io_buf {
 	int ref_count;
 	uint32_t length;
@@ -40,10 +40,6 @@
 
 #include <signal.h>
 
-#if HAVE_SYS_PRCTL_H
-  #include <sys/prctl.h>
-#endif
-
 #include "src/common/slurm_auth.h"
 #include "src/common/gres.h"
 #include "src/common/macros.h"
@@ -193,15 +189,6 @@ static int _handle_init_msg(slurmdbd_conn_t *slurmdbd_conn,
 
 	*uid = init_msg->uid;
 
-#if HAVE_SYS_PRCTL_H
-	{
-	char *name = xstrdup_printf("p-%s", init_msg->cluster_name);
-	if (prctl(PR_SET_NAME, name, NULL, NULL, NULL) < 0)
-		error("%s: cannot set my name to %s %m", __func__, name);
-	xfree(name);
-	}
-#endif
-
 	debug("REQUEST_PERSIST_INIT: CLUSTER:%s VERSION:%u UID:%u IP:%s CONN:%d",
 	      init_msg->cluster_name, init_msg->version, init_msg->uid,
 	      slurmdbd_conn->conn->rem_host, slurmdbd_conn->conn->fd);
@@ -926,7 +913,9 @@ static int _get_jobs_cond(slurmdbd_conn_t *slurmdbd_conn, persist_msg_t *msg,
 	slurmdb_job_cond_t *job_cond = cond_msg->cond;
 	int rc = SLURM_SUCCESS;
 
-	debug2("DBD_GET_JOBS_COND: called in CONN %d", slurmdbd_conn->conn->fd);
+	debug2("%s: called in CONN %d",
+	       slurmdbd_msg_type_2_str(msg->msg_type, 1),
+	       slurmdbd_conn->conn->fd);
 
 	/* fail early if requesting runaways and not super user */
 	if ((job_cond->flags & JOBCOND_FLAG_RUNAWAY) &&
@@ -936,7 +925,7 @@ static int _get_jobs_cond(slurmdbd_conn_t *slurmdbd_conn, persist_msg_t *msg,
 			slurmdbd_conn->conn,
 			ESLURM_ACCESS_DENIED,
 			"You must have an AdminLevel>=Operator to fix runaway jobs",
-			DBD_GET_JOBS_COND);
+			msg->msg_type);
 		return SLURM_ERROR;
 	}
 	/* fail early if too wide a query */
@@ -957,13 +946,50 @@ static int _get_jobs_cond(slurmdbd_conn_t *slurmdbd_conn, persist_msg_t *msg,
 			*out_buffer = slurm_persist_make_rc_msg(slurmdbd_conn->conn,
 								ESLURM_DB_QUERY_TOO_WIDE,
 								slurm_strerror(ESLURM_DB_QUERY_TOO_WIDE),
-								DBD_GET_JOBS_COND);
+								msg->msg_type);
 			return SLURM_ERROR;
 		}
 	}
 
-	list_msg.my_list = jobacct_storage_g_get_jobs_cond(
-		slurmdbd_conn->db_conn, *uid, job_cond);
+	if (msg->msg_type == DBD_GET_JOBS_CHUNK)
+		list_msg.my_list = jobacct_storage_g_get_jobs_chunk(
+			slurmdbd_conn->db_conn, *uid, job_cond);
+	else
+		list_msg.my_list = jobacct_storage_g_get_jobs_cond(
+			slurmdbd_conn->db_conn, *uid, job_cond);
+
+	if (!errno) {
+		if (!list_msg.my_list)
+			list_msg.my_list = list_create(NULL);
+		*out_buffer = init_buf(1024);
+		pack16((uint16_t) DBD_GOT_JOBS, *out_buffer);
+		slurmdbd_pack_list_msg(&list_msg, slurmdbd_conn->conn->version,
+				       DBD_GOT_JOBS, *out_buffer);
+	} else {
+		*out_buffer = slurm_persist_make_rc_msg(slurmdbd_conn->conn,
+							errno,
+							slurm_strerror(errno),
+							msg->msg_type);
+		rc = SLURM_ERROR;
+	}
+
+	FREE_NULL_LIST(list_msg.my_list);
+
+	return rc;
+}
+
+/* Get the next chunk of the jobs of a DBD_GET_JOBS_CHUNK */
+static int _get_jobs_next(slurmdbd_conn_t *slurmdbd_conn, persist_msg_t *msg,
+			  buf_t **out_buffer, uint32_t *uid)
+{
+	dbd_list_msg_t list_msg = { NULL };
+	int rc = SLURM_SUCCESS;
+
+	debug2("DBD_GET_JOBS_NEXT: called in CONN %d",
+	       slurmdbd_conn->conn->fd);
+
+	list_msg.my_list = jobacct_storage_g_get_jobs_chunk(
+		slurmdbd_conn->db_conn, *uid, NULL);
 
 	if (!errno) {
 		if (!list_msg.my_list)
@@ -976,7 +1002,7 @@ static int _get_jobs_cond(slurmdbd_conn_t *slurmdbd_conn, persist_msg_t *msg,
 		*out_buffer = slurm_persist_make_rc_msg(slurmdbd_conn->conn,
 							errno,
 							slurm_strerror(errno),
-							DBD_GET_JOBS_COND);
+							DBD_GET_JOBS_NEXT);
 		rc = SLURM_ERROR;
 	}
 
@@ -1116,6 +1142,53 @@ static int _get_txn(slurmdbd_conn_t *slurmdbd_conn, persist_msg_t *msg,
 	return rc;
 }
 
+static int _get_updates(slurmdbd_conn_t *slurmdbd_conn, persist_msg_t *msg,
+			buf_t **out_buffer, uint32_t *uid)
+{
+	dbd_updates_msg_t *get_msg = msg->data;
+	dbd_updates_msg_t got_msg;
+	int rc = SLURM_SUCCESS;
+	char *comment = NULL;
+
+	if (!_validate_slurm_user(*uid)) {
+		comment = "DBD_GET_UPDATES message from invalid uid";
+		error("CONN:%d %s %u",
+		      slurmdbd_conn->conn->fd, comment, *uid);
+		*out_buffer = slurm_persist_make_rc_msg(slurmdbd_conn->conn,
+							ESLURM_ACCESS_DENIED,
+							comment,
+							DBD_GET_UPDATES);
+		return SLURM_ERROR;
+	}
+
+	debug2("DBD_GET_UPDATES: called in CONN %d for %u:%"PRIu64,
+	       slurmdbd_conn->conn->fd, get_msg->epoch, get_msg->gen);
+
+	memset(&got_msg, 0, sizeof(dbd_updates_msg_t));
+	got_msg.epoch = get_msg->epoch;
+	got_msg.gen = get_msg->gen;
+	rc = acct_storage_g_get_updates(slurmdbd_conn->db_conn, *uid,
+					&got_msg.epoch, &got_msg.gen,
+					&got_msg.update_list);
+
+	if (rc == SLURM_SUCCESS) {
+		*out_buffer = init_buf(1024);
+		pack16((uint16_t) DBD_GOT_UPDATES, *out_buffer);
+		slurmdbd_pack_updates_msg(&got_msg,
+					  slurmdbd_conn->conn->version,
+					  *out_buffer);
+	} else {
+		*out_buffer = slurm_persist_make_rc_msg(slurmdbd_conn->conn,
+							rc,
+							slurm_strerror(rc),
+							DBD_GET_UPDATES);
+	}
+
+	FREE_NULL_LIST(got_msg.update_list);
+
+	return rc;
+}
+
 static int _get_usage(slurmdbd_conn_t *slurmdbd_conn, persist_msg_t *msg,
 		      buf_t **out_buffer, uint32_t *uid)
 {
@@ -2875,7 +2948,7 @@ static int _send_mult_msg(slurmdbd_conn_t *slurmdbd_conn, persist_msg_t *msg,
 	ListIterator itr = NULL;
 	buf_t *req_buf = NULL, *ret_buf = NULL;
 	int rc = SLURM_SUCCESS;
-	/* DEF_TIMERS; */
+	DEF_TIMERS;
 
 	if (!_validate_slurm_user(*uid)) {
 		comment = "DBD_SEND_MULT_MSG message from invalid uid";
@@ -2888,7 +2961,13 @@ static int _send_mult_msg(slurmdbd_conn_t *slurmdbd_conn, persist_msg_t *msg,
 	}
 
 	list_msg.my_list = list_create(slurmdbd_free_buffer);
-	/* START_TIMER; */
+	START_TIMER;
+	/*
+	 * Let the storage plugin group the job and step records of the
+	 * messages and commit them together once they are all processed.
+	 */
+	slurmdbd_conn->batch = true;
+	(void) acct_storage_g_batch(slurmdbd_conn->db_conn, true);
 	itr = list_iterator_create(get_msg->my_list);
 	while ((req_buf = list_next(itr))) {
 		persist_msg_t sub_msg;
@@ -2911,8 +2990,23 @@ static int _send_mult_msg(slurmdbd_conn_t *slurmdbd_conn, persist_msg_t *msg,
 			break;
 	}
 	list_iterator_destroy(itr);
-	/* END_TIMER; */
-	/* info("%d multi took %s", list_count(get_msg->my_list), TIME_STR); */
+	slurmdbd_conn->batch = false;
+	if (acct_storage_g_batch(slurmdbd_conn->db_conn, false) !=
+	    SLURM_SUCCESS) {
+		/*
+		 * Records of the batch may not have been written. Acknowledge
+		 * none of the messages so the slurmctld sends them all again,
+		 * the job and step records are written with "insert ... on
+		 * duplicate key update" or "update" so this is harmless.
+		 */
+		error("CONN:%d DBD_SEND_MULT_MSG: could not write the records of %d messages, asking for them again",
+		      slurmdbd_conn->conn->fd, list_count(list_msg.my_list));
+		list_flush(list_msg.my_list);
+	}
+	END_TIMER;
+	debug2("DBD_SEND_MULT_MSG: %d of %d messages processed in CONN %d took %s",
+	       list_count(list_msg.my_list), list_count(get_msg->my_list),
+	       slurmdbd_conn->conn->fd, TIME_STR);
 
 	*out_buffer = init_buf(1024);
 	pack16((uint16_t) DBD_GOT_MULT_MSG, *out_buffer);
@@ -3242,8 +3336,12 @@ extern int proc_req(void *conn, persist_msg_t *msg, buf_t **out_buffer,
 		rc = _get_events(slurmdbd_conn, msg, out_buffer, uid);
 		break;
 	case DBD_GET_JOBS_COND:
+	case DBD_GET_JOBS_CHUNK:
 		rc = _get_jobs_cond(slurmdbd_conn, msg, out_buffer, uid);
 		break;
+	case DBD_GET_JOBS_NEXT:
+		rc = _get_jobs_next(slurmdbd_conn, msg, out_buffer, uid);
+		break;
 	case DBD_GET_PROBS:
 		rc = _get_probs(slurmdbd_conn, msg, out_buffer, uid);
 		break;
@@ -3256,6 +3354,9 @@ extern int proc_req(void *conn, persist_msg_t *msg, buf_t **out_buffer,
 	case DBD_GET_TXN:
 		rc = _get_txn(slurmdbd_conn, msg, out_buffer, uid);
 		break;
+	case DBD_GET_UPDATES:
+		rc = _get_updates(slurmdbd_conn, msg, out_buffer, uid);
+		break;
 	case DBD_GET_WCKEYS:
 		rc = _get_wckeys(slurmdbd_conn, msg, out_buffer, uid);
 		break;
@@ -3392,11 +3493,13 @@ extern int proc_req(void *conn, persist_msg_t *msg, buf_t **out_buffer,
 		      slurmdbd_conn->conn->fd,
 		      slurmdbd_msg_type_2_str(msg->msg_type, 1));
 	else if (slurmdbd_conn->conn->rem_port
-		 && !slurmdbd_conf->commit_delay) {
+		 && !slurmdbd_conf->commit_delay && !slurmdbd_conn->batch) {
 		/* If we are dealing with the slurmctld do the
 		   commit (SUCCESS or NOT) afterwards since we
 		   do transactions for performance reasons.
 		   (don't ever use autocommit with innodb)
+		   The messages of a DBD_SEND_MULT_MSG are committed
+		   together once the whole message is processed.
 		*/
 		acct_storage_g_commit(slurmdbd_conn->db_conn, 1);
 	}
@@ -44,6 +44,7 @@
 #include "src/common/slurm_protocol_defs.h"
 
 typedef struct {
+	bool batch; /* processing the messages of a DBD_SEND_MULT_MSG */
 	slurm_persist_conn_t *conn;
 	void *db_conn; /* database connection */
 	char *tres_str;
@@ -107,9 +107,12 @@ static void _clear_slurmdbd_conf(void)
 		slurmdbd_conf->purge_suspend = 0;
 		slurmdbd_conf->purge_txn = 0;
 		slurmdbd_conf->purge_usage = 0;
+		slurmdbd_conf->rollup_threads = 0;
+		slurmdbd_conf->rpc_threads = 0;
 		xfree(slurmdbd_conf->storage_loc);
 		slurmdbd_conf->track_wckey = 0;
 		slurmdbd_conf->track_ctld = 0;
+		slurmdbd_conf->usage_cache_days = NO_VAL16;
 	}
 }
 
@@ -332,10 +335,39 @@ extern int read_slurmdbd_conf(void)
 
 		s_p_get_string(&slurmdbd_conf->parameters, "Parameters", tbl);
 		if (slurmdbd_conf->parameters) {
+			char *tmp_ptr;
+
 			if (xstrcasestr(slurmdbd_conf->parameters,
 					"PreserveCaseUser"))
 				slurmdbd_conf->persist_conn_rc_flags |=
 					PERSIST_FLAG_P_USER_CASE;
+			if ((tmp_ptr = xstrcasestr(slurmdbd_conf->parameters,
+						   "RollupThreads="))) {
+				int threads = atoi(tmp_ptr + 14);
+
+				if (threads < 1)
+					fatal("Invalid RollupThreads=%d",
+					      threads);
+				slurmdbd_conf->rollup_threads = threads;
+			}
+			if ((tmp_ptr = xstrcasestr(slurmdbd_conf->parameters,
+						   "RpcThreads="))) {
+				int threads = atoi(tmp_ptr + 11);
+
+				if ((threads < 1) || (threads >= NO_VAL16))
+					fatal("Invalid RpcThreads=%d",
+					      threads);
+				slurmdbd_conf->rpc_threads = threads;
+			}
+			if ((tmp_ptr = xstrcasestr(slurmdbd_conf->parameters,
+						   "UsageCacheDays="))) {
+				int days = atoi(tmp_ptr + 15);
+
+				if ((days < 0) || (days >= NO_VAL16))
+					fatal("Invalid UsageCacheDays=%d",
+					      days);
+				slurmdbd_conf->usage_cache_days = days;
+			}
 		}
 
 		s_p_get_string(&slurmdbd_conf->pid_file, "PidFile", tbl);
@@ -659,6 +691,13 @@ extern int read_slurmdbd_conf(void)
 		slurmdbd_conf->purge_txn = NO_VAL;
 	if (!slurmdbd_conf->purge_usage)
 		slurmdbd_conf->purge_usage = NO_VAL;
+	if (!slurmdbd_conf->rollup_threads)
+		slurmdbd_conf->rollup_threads = DEFAULT_SLURMDBD_ROLLUP_THREADS;
+	if (!slurmdbd_conf->rpc_threads)
+		slurmdbd_conf->rpc_threads = DEFAULT_SLURMDBD_RPC_THREADS;
+	if (slurmdbd_conf->usage_cache_days == NO_VAL16)
+		slurmdbd_conf->usage_cache_days =
+			DEFAULT_SLURMDBD_USAGE_CACHE_DAYS;
 
 	slurm_mutex_unlock(&conf_mutex);
 	return SLURM_SUCCESS;
@@ -727,6 +766,9 @@ extern void log_config(void)
 			     tmp_str, sizeof(tmp_str), 1);
 	debug2("PurgeUsageAfter = %s", tmp_str);
 
+	debug2("RollupThreads     = %u", slurmdbd_conf->rollup_threads);
+	debug2("RpcThreads        = %u", slurmdbd_conf->rpc_threads);
+
 	debug2("SlurmUser         = %s(%u)",
 	       slurm_conf.slurm_user_name, slurm_conf.slurm_user_id);
 
@@ -746,6 +788,7 @@ extern void log_config(void)
 
 	debug2("TrackWCKey        = %u", slurmdbd_conf->track_wckey);
 	debug2("TrackSlurmctldDown= %u", slurmdbd_conf->track_ctld);
+	debug2("UsageCacheDays    = %u", slurmdbd_conf->usage_cache_days);
 }
 
 /* Dump the configuration in name,value pairs for output to
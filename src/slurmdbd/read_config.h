@@ -50,6 +50,9 @@
 //#define DEFAULT_SLURMDBD_JOB_PURGE	12
 #define DEFAULT_SLURMDBD_PIDFILE	"/var/run/slurmdbd.pid"
 #define DEFAULT_SLURMDBD_ARCHIVE_DIR	"/tmp"
+#define DEFAULT_SLURMDBD_ROLLUP_THREADS	4
+#define DEFAULT_SLURMDBD_RPC_THREADS	16
+#define DEFAULT_SLURMDBD_USAGE_CACHE_DAYS 0
 //#define DEFAULT_SLURMDBD_STEP_PURGE	1
 
 /* SlurmDBD configuration parameters */
@@ -88,11 +91,16 @@ typedef struct {
 					 * than this in months or days	*/
 	uint32_t        purge_usage;    /* purge usage data older
 					 * than this in months or days	*/
+	uint16_t	rollup_threads;	/* threads rolling up the hours
+					 * of a cluster			*/
+	uint16_t	rpc_threads;	/* threads processing RPCs	*/
 	char *		storage_loc;	/* database name		*/
 	uint16_t	syslog_debug;	/* output to both logfile and syslog*/
 	uint16_t        track_wckey;    /* Whether or not to track wckey*/
 	uint16_t        track_ctld;     /* Whether or not track when a
 					 * slurmctld goes down or not   */
+	uint16_t	usage_cache_days; /* days of usage kept in memory
+					   * for usage queries, 0 if none */
 } slurmdbd_conf_t;
 
 extern pthread_mutex_t conf_mutex;
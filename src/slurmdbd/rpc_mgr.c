@@ -37,13 +37,21 @@
  *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
 \*****************************************************************************/
 
+#include "config.h"
+
 #include <arpa/inet.h>
 #include <poll.h>
 #include <pthread.h>
 #include <signal.h>
+#include <string.h>
 #include <sys/socket.h>
 #include <sys/time.h>
 #include <sys/types.h>
+#include <unistd.h>
+
+#if HAVE_SYS_PRCTL_H
+  #include <sys/prctl.h>
+#endif
 
 #include "src/common/fd.h"
 #include "src/common/log.h"
@@ -58,19 +66,238 @@
 #include "src/slurmdbd/rpc_mgr.h"
 #include "src/slurmdbd/slurmdbd.h"
 
+/*
+ * The rpc_mgr thread polls the listening socket and the idle connections.
+ * Once a connection is readable it is queued for the worker threads, which
+ * process one message of it and give it back to rpc_mgr. A connection is
+ * either polled, queued or being processed, so its messages are still
+ * processed one at a time and in order. Messages from a slurmctld are queued
+ * before the ones of users, so heavy user queries can't hold up job
+ * accounting, only one user message is let through every RPC_HIGH_BURST
+ * slurmctld ones so users are slowed down and not starved. A user message can
+ * take long (sacct, archive), so user messages are never processed by more
+ * than low_max workers at once, the others are kept for the slurmctlds.
+ */
+#define RPC_HIGH_BURST 8
+
+typedef struct {
+	slurmdbd_conn_t *conn;
+	bool low;		/* message processed as a user one */
+	uint32_t uid;		/* user of the connection */
+} rpc_conn_t;
+
 /* Local functions */
 static void _connection_fini_callback(void *arg);
 
 /* Local variables */
 static pthread_t       master_thread_id = 0;
+static pthread_mutex_t rpc_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  rpc_cond = PTHREAD_COND_INITIALIZER;
+static List            ready_high = NULL;	/* rpc_conn_t of slurmctlds */
+static List            ready_low = NULL;	/* rpc_conn_t of users */
+static List            returned = NULL;	/* rpc_conn_t to poll again */
+static int             high_in_row = 0;
+static int             low_running = 0;	/* workers on ready_low messages */
+static int             low_max = 1;
+static bool            workers_stop = false;
+static int             wake_fd[2] = { -1, -1 };
 
-/* Process incoming RPCs. Meant to execute as a pthread */
-extern void *rpc_mgr(void *no_data)
+static void _wake_rpc_mgr(void)
+{
+	char c = 0;
+
+	if ((wake_fd[1] >= 0) && (write(wake_fd[1], &c, 1) < 0) &&
+	    (errno != EAGAIN))
+		error("%s: write: %m", __func__);
+}
+
+static void _close_conn(rpc_conn_t *rpc_conn)
+{
+	slurm_persist_conn_t *persist_conn = rpc_conn->conn->conn;
+
+	/* rpc_conn->conn is freed inside here */
+	_connection_fini_callback(rpc_conn->conn);
+	slurm_persist_conn_destroy(persist_conn);
+	xfree(rpc_conn);
+}
+
+static void _destroy_rpc_conn(void *object)
+{
+	_close_conn(object);
+}
+
+/* Messages from a slurmctld, keeping the accounting of jobs up to date */
+static bool _high_priority(rpc_conn_t *rpc_conn)
+{
+	slurm_persist_conn_t *persist_conn = rpc_conn->conn->conn;
+	char peek[sizeof(uint32_t) + sizeof(uint16_t)];
+	uint16_t nw_type;
+
+	if (persist_conn->rem_port)
+		return true;
+
+	/* The first message is REQUEST_PERSIST_INIT, with a different header */
+	if (!(persist_conn->flags & PERSIST_FLAG_ALREADY_INITED))
+		return false;
+
+	/* Look at the type after the message size without reading it */
+	if (recv(persist_conn->fd, peek, sizeof(peek),
+		 MSG_PEEK | MSG_DONTWAIT) != sizeof(peek))
+		return false;
+	memcpy(&nw_type, peek + sizeof(uint32_t), sizeof(nw_type));
+
+	switch (ntohs(nw_type)) {
+	case DBD_CLUSTER_TRES:
+	case DBD_FLUSH_JOBS:
+	case DBD_GET_UPDATES:
+	case DBD_JOB_COMPLETE:
+	case DBD_JOB_START:
+	case DBD_JOB_SUSPEND:
+	case DBD_NODE_STATE:
+	case DBD_REGISTER_CTLD:
+	case DBD_SEND_MULT_JOB_START:
+	case DBD_SEND_MULT_MSG:
+	case DBD_STEP_COMPLETE:
+	case DBD_STEP_START:
+		return true;
+	default:
+		return false;
+	}
+}
+
+static void _queue_conn(rpc_conn_t *rpc_conn)
+{
+	bool high = _high_priority(rpc_conn);
+
+	slurm_mutex_lock(&rpc_lock);
+	list_append(high ? ready_high : ready_low, rpc_conn);
+	slurm_cond_signal(&rpc_cond);
+	slurm_mutex_unlock(&rpc_lock);
+}
+
+/* RET next connection to process or NULL when shutting down */
+static rpc_conn_t *_dequeue_conn(void)
+{
+	rpc_conn_t *rpc_conn = NULL;
+
+	slurm_mutex_lock(&rpc_lock);
+	while (!workers_stop) {
+		bool low_ok = (low_running < low_max) && list_count(ready_low);
+
+		if (list_count(ready_high) &&
+		    ((high_in_row < RPC_HIGH_BURST) || !low_ok)) {
+			rpc_conn = list_pop(ready_high);
+			rpc_conn->low = false;
+			high_in_row++;
+			break;
+		}
+		if (low_ok) {
+			rpc_conn = list_pop(ready_low);
+			rpc_conn->low = true;
+			low_running++;
+			high_in_row = 0;
+			break;
+		}
+		slurm_cond_wait(&rpc_cond, &rpc_lock);
+	}
+	slurm_mutex_unlock(&rpc_lock);
+
+	return rpc_conn;
+}
+
+static void *_rpc_worker(void *no_data)
+{
+	rpc_conn_t *rpc_conn;
+
+#if HAVE_SYS_PRCTL_H
+	if (prctl(PR_SET_NAME, "dbd-rpc", NULL, NULL, NULL) < 0)
+		error("%s: cannot set my name to %s %m", __func__, "dbd-rpc");
+#endif
+
+	while ((rpc_conn = _dequeue_conn())) {
+		bool low = rpc_conn->low;
+
+		if ((slurm_persist_conn_process_one(rpc_conn->conn->conn,
+						    rpc_conn->conn,
+						    &rpc_conn->uid) !=
+		     SLURM_SUCCESS) || shutdown_time) {
+			_close_conn(rpc_conn);
+			rpc_conn = NULL;
+		}
+
+		slurm_mutex_lock(&rpc_lock);
+		if (low) {
+			low_running--;
+			slurm_cond_signal(&rpc_cond);
+		}
+		if (rpc_conn)
+			list_append(returned, rpc_conn);
+		slurm_mutex_unlock(&rpc_lock);
+		if (rpc_conn)
+			_wake_rpc_mgr();
+	}
+
+	return NULL;
+}
+
+static rpc_conn_t *_accept_conn(int sockfd)
 {
-	int sockfd, newsockfd;
-	int i;
+	int newsockfd;
 	slurm_addr_t cli_addr;
 	slurmdbd_conn_t *conn_arg = NULL;
+	rpc_conn_t *rpc_conn;
+
+	/*
+	 * accept needed for stream implementation is a no-op in
+	 * message implementation that just passes sockfd to newsockfd
+	 */
+	if ((newsockfd = slurm_accept_msg_conn(sockfd, &cli_addr)) ==
+	    SLURM_ERROR) {
+		if (errno != EINTR)
+			error("slurm_accept_msg_conn: %m");
+		return NULL;
+	}
+	fd_set_nonblocking(newsockfd);
+
+	conn_arg = xmalloc(sizeof(slurmdbd_conn_t));
+	conn_arg->conn = xmalloc(sizeof(slurm_persist_conn_t));
+	conn_arg->conn->fd = newsockfd;
+	conn_arg->conn->flags = PERSIST_FLAG_DBD;
+	conn_arg->conn->callback_proc = proc_req;
+	conn_arg->conn->callback_fini = _connection_fini_callback;
+	conn_arg->conn->shutdown = &shutdown_time;
+	conn_arg->conn->version = SLURM_MIN_PROTOCOL_VERSION;
+	conn_arg->conn->rem_host = xmalloc(INET6_ADDRSTRLEN);
+	/*
+	 * Only wait for the rest of a message once it started to arrive, so a
+	 * stalled client can't keep a worker.
+	 */
+	conn_arg->conn->timeout = slurm_conf.msg_timeout * 1000;
+	/* Don't fill in the rem_port here.  It will be filled in
+	 * later if it is a slurmctld connection. */
+	slurm_get_ip_str(&cli_addr, conn_arg->conn->rem_host,
+			 INET6_ADDRSTRLEN);
+
+	log_flag(NET, "%s: Opened connection %d from %s",
+		 __func__, newsockfd, conn_arg->conn->rem_host);
+
+	rpc_conn = xmalloc(sizeof(*rpc_conn));
+	rpc_conn->conn = conn_arg;
+	rpc_conn->uid = NO_VAL;
+
+	return rpc_conn;
+}
+
+/* Process incoming RPCs. Meant to execute as a pthread */
+extern void *rpc_mgr(void *no_data)
+{
+	int sockfd, i, rc;
+	int worker_cnt = slurmdbd_conf->rpc_threads;
+	pthread_t *workers;
+	rpc_conn_t **idle = NULL;
+	int idle_cnt = 0, idle_size = 0;
+	struct pollfd *ufds = NULL;
+	List closing;
 
 	master_thread_id = pthread_self();
 
@@ -79,57 +306,131 @@ extern void *rpc_mgr(void *no_data)
 	    == SLURM_ERROR)
 		fatal("slurm_init_msg_engine_port error %m");
 
+	if (pipe(wake_fd) < 0)
+		fatal("%s: pipe: %m", __func__);
+	fd_set_nonblocking(wake_fd[0]);
+	fd_set_nonblocking(wake_fd[1]);
+	fd_set_close_on_exec(wake_fd[0]);
+	fd_set_close_on_exec(wake_fd[1]);
+
 	slurm_persist_conn_recv_server_init();
 
+	ready_high = list_create(NULL);
+	ready_low = list_create(NULL);
+	returned = list_create(NULL);
+	high_in_row = 0;
+	low_running = 0;
+	/* Keep a quarter of the workers, at least one, for the slurmctlds */
+	low_max = MAX(1, worker_cnt - MAX(1, worker_cnt / 4));
+	workers_stop = false;
+
+	workers = xcalloc(worker_cnt, sizeof(pthread_t));
+	for (i = 0; i < worker_cnt; i++)
+		slurm_thread_create(&workers[i], _rpc_worker, NULL);
+
 	/*
 	 * Process incoming RPCs until told to shutdown
 	 */
-	while (!shutdown_time &&
-	       (i = slurm_persist_conn_wait_for_thread_loc()) >= 0) {
+	while (!shutdown_time) {
+		rpc_conn_t *rpc_conn;
+		int nfds = 0;
+
+		/* Poll again the connections done with their message */
+		slurm_mutex_lock(&rpc_lock);
+		while ((rpc_conn = list_pop(returned))) {
+			if (idle_cnt >= idle_size) {
+				idle_size = idle_size ? (idle_size * 2) : 64;
+				xrealloc(idle, sizeof(*idle) * idle_size);
+			}
+			idle[idle_cnt++] = rpc_conn;
+		}
+		slurm_mutex_unlock(&rpc_lock);
+
+		xrealloc(ufds, sizeof(*ufds) * (idle_cnt + 2));
+		ufds[nfds].fd = sockfd;
+		ufds[nfds++].events = POLLIN;
+		ufds[nfds].fd = wake_fd[0];
+		ufds[nfds++].events = POLLIN;
+		for (i = 0; i < idle_cnt; i++) {
+			ufds[nfds].fd = idle[i]->conn->conn->fd;
+			ufds[nfds++].events = POLLIN;
+		}
+
+		if ((rc = poll(ufds, nfds, -1)) < 0) {
+			if ((errno != EINTR) && (errno != EAGAIN))
+				error("%s: poll: %m", __func__);
+			continue;
+		}
+
+		if (ufds[1].revents) {
+			char buf[64];
+
+			while (read(wake_fd[0], buf, sizeof(buf)) > 0)
+				;
+		}
+
 		/*
-		 * accept needed for stream implementation is a no-op in
-		 * message implementation that just passes sockfd to newsockfd
+		 * Hangups and errors are queued too, the worker closes the
+		 * connection when reading from it fails.
 		 */
-		if ((newsockfd = slurm_accept_msg_conn(sockfd,
-						       &cli_addr)) ==
-		    SLURM_ERROR) {
-			slurm_persist_conn_free_thread_loc(i);
-			if (errno != EINTR)
-				error("slurm_accept_msg_conn: %m");
-			continue;
+		rc = 0;
+		for (i = 0; i < idle_cnt; i++) {
+			if (ufds[i + 2].revents)
+				_queue_conn(idle[i]);
+			else
+				idle[rc++] = idle[i];
+		}
+		idle_cnt = rc;
+
+		if (ufds[0].revents && !shutdown_time &&
+		    (rpc_conn = _accept_conn(sockfd))) {
+			if (idle_cnt >= idle_size) {
+				idle_size = idle_size ? (idle_size * 2) : 64;
+				xrealloc(idle, sizeof(*idle) * idle_size);
+			}
+			idle[idle_cnt++] = rpc_conn;
 		}
-		fd_set_nonblocking(newsockfd);
-
-		conn_arg = xmalloc(sizeof(slurmdbd_conn_t));
-		conn_arg->conn = xmalloc(sizeof(slurm_persist_conn_t));
-		conn_arg->conn->fd = newsockfd;
-		conn_arg->conn->flags = PERSIST_FLAG_DBD;
-		conn_arg->conn->callback_proc = proc_req;
-		conn_arg->conn->callback_fini = _connection_fini_callback;
-		conn_arg->conn->shutdown = &shutdown_time;
-		conn_arg->conn->version = SLURM_MIN_PROTOCOL_VERSION;
-		conn_arg->conn->rem_host = xmalloc(INET6_ADDRSTRLEN);
-		/* Don't fill in the rem_port here.  It will be filled in
-		 * later if it is a slurmctld connection. */
-		slurm_get_ip_str(&cli_addr, conn_arg->conn->rem_host,
-				 INET6_ADDRSTRLEN);
-
-		slurm_persist_conn_recv_thread_init(
-			conn_arg->conn, i, conn_arg);
 	}
 
 	debug("rpc_mgr shutting down");
 	close(sockfd);
+
+	slurm_mutex_lock(&rpc_lock);
+	workers_stop = true;
+	slurm_cond_broadcast(&rpc_cond);
+	slurm_mutex_unlock(&rpc_lock);
+	for (i = 0; i < worker_cnt; i++)
+		pthread_join(workers[i], NULL);
+	xfree(workers);
+
+	/* Do the final commit of all the connections left */
+	closing = list_create(_destroy_rpc_conn);
+	list_transfer(closing, ready_high);
+	list_transfer(closing, ready_low);
+	list_transfer(closing, returned);
+	for (i = 0; i < idle_cnt; i++)
+		list_append(closing, idle[i]);
+	FREE_NULL_LIST(closing);
+	FREE_NULL_LIST(ready_high);
+	FREE_NULL_LIST(ready_low);
+	FREE_NULL_LIST(returned);
+	xfree(idle);
+	xfree(ufds);
+
+	close(wake_fd[0]);
+	close(wake_fd[1]);
+	wake_fd[0] = wake_fd[1] = -1;
+
 	pthread_exit((void *) 0);
 	return NULL;
 }
 
-/* Wake up the RPC manager and all spawned threads so they can exit */
+/* Wake up the RPC manager so it can stop the workers and exit */
 extern void rpc_mgr_wake(void)
 {
 	if (master_thread_id)
 		pthread_kill(master_thread_id, SIGUSR1);
-	slurm_persist_conn_recv_server_fini();
+	_wake_rpc_mgr();
 }
 
 static void _connection_fini_callback(void *arg)
@@ -40,7 +40,9 @@
 #include <netdb.h>
 #include <poll.h>
 #include <signal.h>
+#include <sys/epoll.h>
 #include <sys/ioctl.h>
+#include <sys/resource.h>
 #include <sys/socket.h>
 #include <sys/stat.h>
 #include <sys/types.h>
@@ -55,6 +57,7 @@
 #include "src/common/pack.h"
 #include "src/common/read_config.h"
 #include "src/common/slurm_protocol_common.h"
+#include "src/common/slurm_rlimits_info.h"
 #include "src/common/strlcpy.h"
 #include "src/common/timers.h"
 #include "src/common/workq.h"
@@ -70,7 +73,16 @@
 #define MAGIC_WRAP_WORK 0xD231444A
 /* Default buffer to 1 page */
 #define BUFFER_START_SIZE 4096
+/* Max size of a buffer to keep for the next connection */
+#define BUFFER_POOL_MAX_SIZE (BUFFER_START_SIZE * 16)
+/* Max number of buffers to keep for the next connections */
+#define BUFFER_POOL_MAX_COUNT 1024
+/* Min number of connections before deferring accept() */
 #define MAX_OPEN_CONNECTIONS 124
+/* Max number of events to process per epoll_wait() */
+#define MAX_EPOLL_EVENTS 256
+/* Wake up every second to check for idle connections */
+#define POLL_TIMEOUT_MS 1000
 
 /*
  * there can only be 1 SIGINT handler, so we are using a mutex to protect
@@ -102,6 +114,7 @@ typedef struct {
 	con_mgr_t *mgr;
 	struct pollfd *fds;
 	int nfds;
+	struct epoll_event *events;
 } poll_args_t;
 
 #ifndef NDEBUG
@@ -160,6 +173,104 @@ static inline void _check_magic_fd(con_mgr_fd_t *con)
 	}
 }
 
+static void _free_buffer(void *x)
+{
+	buf_t *buf = x;
+
+	FREE_NULL_BUFFER(buf);
+}
+
+/*
+ * Get empty buffer for a new connection, recycling a previous connection's
+ * buffer when possible.
+ */
+static buf_t *_get_buffer(con_mgr_t *mgr)
+{
+	buf_t *buf;
+
+	if ((buf = list_pop(mgr->buffers))) {
+		set_buf_offset(buf, 0);
+		return buf;
+	}
+
+	return create_buf(xmalloc(BUFFER_START_SIZE), BUFFER_START_SIZE);
+}
+
+/* Return buffer of closed connection to be recycled */
+static void _put_buffer(con_mgr_t *mgr, buf_t *buf)
+{
+	if (!buf)
+		return;
+
+	/* avoid holding onto large buffers from a few big requests */
+	if ((size_buf(buf) > BUFFER_POOL_MAX_SIZE) ||
+	    (list_count(mgr->buffers) >= BUFFER_POOL_MAX_COUNT)) {
+		free_buf(buf);
+		return;
+	}
+
+	list_push(mgr->buffers, buf);
+}
+
+/*
+ * Add connection fd to epoll as edge triggered.
+ * mgr must be locked.
+ */
+static void _add_epoll_fd(con_mgr_t *mgr, con_mgr_fd_t *con, int fd,
+			  uint32_t events)
+{
+	struct epoll_event ev = {
+		.events = (events | EPOLLET),
+		.data.fd = fd,
+	};
+
+	if (fd >= mgr->fd_cons_size) {
+		int size = MAX((fd + 1), (mgr->fd_cons_size * 2));
+
+		xrecalloc(mgr->fd_cons, size, sizeof(*mgr->fd_cons));
+		mgr->fd_cons_size = size;
+	}
+
+	mgr->fd_cons[fd] = con;
+
+	if (!epoll_ctl(mgr->epoll_fd, EPOLL_CTL_ADD, fd, &ev))
+		return;
+
+	if (errno != EPERM)
+		fatal("%s: [%s] unable to add fd %d to epoll: %m",
+		      __func__, con->name, fd);
+
+	/* regular files do not support polling but are always ready */
+	log_flag(NET, "%s: [%s] fd %d can not be polled",
+		 __func__, con->name, fd);
+
+	if (events & EPOLLIN) {
+		con->input_no_poll = true;
+		con->can_read = true;
+	}
+	if (events & EPOLLOUT) {
+		con->output_no_poll = true;
+		con->can_write = true;
+	}
+}
+
+/*
+ * Remove connection fd from epoll before it is closed.
+ * mgr must be locked.
+ */
+static void _del_epoll_fd(con_mgr_t *mgr, int fd)
+{
+	if ((fd < 0) || (fd >= mgr->fd_cons_size) || !mgr->fd_cons[fd])
+		return;
+
+	mgr->fd_cons[fd] = NULL;
+
+	if (epoll_ctl(mgr->epoll_fd, EPOLL_CTL_DEL, fd, NULL) &&
+	    (errno != EPERM) && (errno != ENOENT))
+		log_flag(NET, "%s: unable to remove fd %d from epoll: %m",
+			 __func__, fd);
+}
+
 static void _connection_fd_delete(void *x)
 {
 	con_mgr_fd_t *con = x;
@@ -181,8 +292,10 @@ static void _connection_fd_delete(void *x)
 	else
 		xassert(!list_remove_first(mgr->connections, _find_by_ptr,
 					   con));
-	FREE_NULL_BUFFER(con->in);
-	FREE_NULL_BUFFER(con->out);
+	_put_buffer(mgr, con->in);
+	con->in = NULL;
+	_put_buffer(mgr, con->out);
+	con->out = NULL;
 	FREE_NULL_LIST(con->work);
 	xfree(con->name);
 	xfree(con->unix_socket);
@@ -214,10 +327,23 @@ try_again:
 extern con_mgr_t *init_con_mgr(int thread_count)
 {
 	con_mgr_t *mgr = xmalloc(sizeof(*mgr));
+	struct epoll_event ev = { .events = EPOLLIN };
+	struct rlimit rlim;
 
 	mgr->magic = MAGIC_CON_MGR;
 	mgr->connections = list_create(NULL);
 	mgr->listen = list_create(NULL);
+	mgr->buffers = list_create(_free_buffer);
+
+	/*
+	 * Each connection may need another fd while being processed (such as
+	 * talking to slurmctld), so only allow half the fds to be connections.
+	 */
+	rlimits_adjust_nofile();
+	mgr->max_connections = MAX_OPEN_CONNECTIONS;
+	if (!getrlimit(RLIMIT_NOFILE, &rlim) &&
+	    ((rlim.rlim_cur / 2) > MAX_OPEN_CONNECTIONS))
+		mgr->max_connections = (rlim.rlim_cur / 2);
 
 	slurm_mutex_init(&mgr->mutex);
 	slurm_cond_init(&mgr->cond, NULL);
@@ -236,6 +362,18 @@ extern con_mgr_t *init_con_mgr(int thread_count)
 	fd_set_blocking(mgr->sigint_fd[0]);
 	fd_set_blocking(mgr->sigint_fd[1]);
 
+	if ((mgr->epoll_fd = epoll_create1(EPOLL_CLOEXEC)) < 0)
+		fatal("%s: unable to create epoll: %m", __func__);
+
+	/* signal pipes are level triggered to match _watch() draining them */
+	ev.data.fd = mgr->sigint_fd[0];
+	if (epoll_ctl(mgr->epoll_fd, EPOLL_CTL_ADD, mgr->sigint_fd[0], &ev))
+		fatal("%s: unable to add signal pipe to epoll: %m", __func__);
+
+	ev.data.fd = mgr->event_fd[0];
+	if (epoll_ctl(mgr->epoll_fd, EPOLL_CTL_ADD, mgr->event_fd[0], &ev))
+		fatal("%s: unable to add event pipe to epoll: %m", __func__);
+
 	_check_magic_mgr(mgr);
 
 	return mgr;
@@ -341,6 +479,8 @@ extern void free_con_mgr(con_mgr_t *mgr)
 	xassert(list_is_empty(mgr->listen));
 	FREE_NULL_LIST(mgr->connections);
 	FREE_NULL_LIST(mgr->listen);
+	FREE_NULL_LIST(mgr->buffers);
+	xfree(mgr->fd_cons);
 
 	slurm_mutex_destroy(&mgr->mutex);
 	slurm_cond_destroy(&mgr->cond);
@@ -351,6 +491,9 @@ extern void free_con_mgr(con_mgr_t *mgr)
 	if (close(mgr->sigint_fd[0]) || close(mgr->sigint_fd[1]))
 		error("%s: unable to close sigint_fd: %m", __func__);
 
+	if (close(mgr->epoll_fd))
+		error("%s: unable to close epoll_fd: %m", __func__);
+
 	mgr->magic = ~MAGIC_CON_MGR;
 	xfree(mgr);
 }
@@ -394,6 +537,7 @@ static void _close_con(bool locked, con_mgr_fd_t *con)
 		con->output_fd = -1;
 	} else if (con->input_fd != con->output_fd) {
 		/* different input FD, we can close it now */
+		_del_epoll_fd(con->mgr, con->input_fd);
 		if (close(con->input_fd) == -1)
 			log_flag(NET, "%s: [%s] unable to close input fd %d: %m",
 				 __func__, con->name, con->output_fd);
@@ -455,10 +599,9 @@ static con_mgr_fd_t *_add_connection(con_mgr_t *mgr, con_mgr_fd_t *source,
 	};
 
 	if (!is_listen) {
-		con->in = create_buf(xmalloc(BUFFER_START_SIZE),
-				     BUFFER_START_SIZE);
-		con->out = create_buf(xmalloc(BUFFER_START_SIZE),
-				      BUFFER_START_SIZE);
+		con->in = _get_buffer(mgr);
+		con->out = _get_buffer(mgr);
+		con->last_active = time(NULL);
 	}
 
 	/* listen on unix socket */
@@ -533,10 +676,20 @@ static con_mgr_fd_t *_add_connection(con_mgr_t *mgr, con_mgr_fd_t *source,
 		 __func__, con->name, input_fd, output_fd);
 
 	slurm_mutex_lock(&mgr->mutex);
-	if (is_listen)
+	if (is_listen) {
 		list_append(mgr->listen, con);
-	else
+	} else {
 		list_append(mgr->connections, con);
+
+		if (input_fd == output_fd) {
+			_add_epoll_fd(mgr, con, input_fd,
+				      (EPOLLIN | EPOLLRDHUP | EPOLLOUT));
+		} else {
+			_add_epoll_fd(mgr, con, input_fd,
+				      (EPOLLIN | EPOLLRDHUP));
+			_add_epoll_fd(mgr, con, output_fd, EPOLLOUT);
+		}
+	}
 	slurm_mutex_unlock(&mgr->mutex);
 
 	_check_magic_fd(con);
@@ -658,10 +811,18 @@ static void _handle_read(void *x)
 	ssize_t read_c;
 	int readable;
 
-	con->can_read = false;
 	_check_magic_fd(con);
 	_check_magic_mgr(con->mgr);
 
+	/*
+	 * Clear before reading: any edge from epoll while reading will set it
+	 * again to avoid losing the event.
+	 */
+	slurm_mutex_lock(&con->mgr->mutex);
+	if (!con->input_no_poll)
+		con->can_read = false;
+	slurm_mutex_unlock(&con->mgr->mutex);
+
 	if (con->input_fd < 0) {
 		xassert(con->read_eof);
 		log_flag(NET, "%s: [%s] called on closed connection",
@@ -729,6 +890,12 @@ static void _handle_read(void *x)
 			     read_c, "%s: [%s] read", __func__, con->name);
 
 		get_buf_offset(con->in) += read_c;
+
+		/* keep reading until the kernel buffer is drained */
+		slurm_mutex_lock(&con->mgr->mutex);
+		con->can_read = true;
+		con->last_active = time(NULL);
+		slurm_mutex_unlock(&con->mgr->mutex);
 	}
 }
 
@@ -749,6 +916,12 @@ static void _handle_write(void *x)
 	log_flag(NET, "%s: [%s] attempting to write %u bytes to fd %u",
 		 __func__, con->name, get_buf_offset(con->out), con->output_fd);
 
+	/* Clear before writing to avoid losing any edge from epoll */
+	slurm_mutex_lock(&con->mgr->mutex);
+	if (!con->output_no_poll)
+		con->can_write = false;
+	slurm_mutex_unlock(&con->mgr->mutex);
+
 	xassert(fcntl(con->output_fd, F_GETFL) & O_NONBLOCK);
 	xassert(con->output_fd != -1);
 	/* write in non-blocking fashion as we can always continue later */
@@ -783,6 +956,13 @@ static void _handle_write(void *x)
 	log_flag_hex(NET_RAW, get_buf_data(con->out), wrote,
 		     "%s: [%s] wrote", __func__, con->name);
 
+	slurm_mutex_lock(&con->mgr->mutex);
+	con->last_active = time(NULL);
+	/* socket only has more space if everything was written */
+	if (wrote == get_buf_offset(con->out))
+		con->can_write = true;
+	slurm_mutex_unlock(&con->mgr->mutex);
+
 	if (wrote != get_buf_offset(con->out)) {
 		/*
 		 * not all data written, need to shift it to start of
@@ -988,41 +1168,39 @@ extern int con_mgr_process_fd_unix_listen(con_mgr_t *mgr, int fd,
 }
 
 /*
- * Event on a processing socket.
+ * Edge triggered epoll event on a processing connection.
  * mgr must be locked.
  */
 static inline void _handle_poll_event(con_mgr_t *mgr, int fd, con_mgr_fd_t *con,
-				      short revents)
+				      uint32_t events)
 {
-	con->can_read = false;
-	con->can_write = false;
-
-	if (revents & POLLNVAL) {
-		error("%s: [%s] connection invalid", __func__, con->name);
-		_close_con(true, con);
-		return;
-	}
-	if (revents & POLLERR) {
+	if (events & EPOLLERR) {
 		int err = SLURM_ERROR;
 
 		if (con->is_socket)
 			/* connection may have got RST */
-			fd_get_socket_error(con->input_fd, &err);
+			fd_get_socket_error(fd, &err);
 
 		error("%s: [%s] poll error: %s",
 		      __func__, con->name, slurm_strerror(err));
 
-		_close_con(true, con);
+		if (con->has_work)
+			/* worker owns the connection, close once it is done */
+			con->poll_error = true;
+		else
+			_close_con(true, con);
 		return;
 	}
 
-	if (fd == con->input_fd)
-		con->can_read = revents & POLLIN || revents & POLLHUP;
-	if (fd == con->output_fd)
-		con->can_write = revents & POLLOUT;
+	/* only set: cleared once read() or write() would block */
+	if ((fd == con->input_fd) &&
+	    (events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP)))
+		con->can_read = true;
+	if ((fd == con->output_fd) && (events & (EPOLLOUT | EPOLLHUP)))
+		con->can_write = true;
 
-	log_flag(NET, "%s: [%s] fd=%u can_read=%s can_write=%s",
-		 __func__, con->name, fd, (con->can_read ? "T" : "F"),
+	log_flag(NET, "%s: [%s] fd=%u events=0x%"PRIx32" can_read=%s can_write=%s",
+		 __func__, con->name, fd, events, (con->can_read ? "T" : "F"),
 		 (con->can_write ? "T" : "F"));
 }
 
@@ -1058,6 +1236,12 @@ static int _handle_connection(void *x, void *arg)
 		return 0;
 	}
 
+	/* poll error seen while work was running */
+	if (con->poll_error) {
+		con->poll_error = false;
+		_close_con(true, con);
+	}
+
 	/* always do work first */
 	if ((count = list_count(con->work))) {
 		wrap_work_arg_t *args = list_pop(con->work);
@@ -1109,14 +1293,23 @@ static int _handle_connection(void *x, void *arg)
 	if (!con->read_eof) {
 		xassert(con->input_fd != -1);
 		/* must wait until poll allows read from this socket */
-		if (con->is_listen)
+		if (con->is_listen) {
 			log_flag(NET, "%s: [%s] waiting for new connection",
 				 __func__, con->name);
-		else
+		} else if (con->idle_timeout && !get_buf_offset(con->in) &&
+			   ((time(NULL) - con->last_active) >=
+			    con->idle_timeout)) {
+			log_flag(NET, "%s: [%s] closing connection idle for %ds",
+				 __func__, con->name, con->idle_timeout);
+			_close_con(true, con);
+			/* inspect again to finish closing */
+			_signal_change(mgr, true);
+		} else {
 			log_flag(NET, "%s: [%s] waiting to read pending_read=%u pending_write=%u has_work=%c",
 				 __func__, con->name, get_buf_offset(con->in),
 				 get_buf_offset(con->out),
 				 (con->has_work ? 'T' : 'F'));
+		}
 		return 0;
 	}
 
@@ -1146,6 +1339,8 @@ static int _handle_connection(void *x, void *arg)
 		 __func__, con->name, con->input_fd, con->output_fd);
 
 	/* close any open file descriptors */
+	_del_epoll_fd(mgr, con->input_fd);
+	_del_epoll_fd(mgr, con->output_fd);
 	if (con->input_fd != -1) {
 		if (close(con->input_fd) == -1)
 			log_flag(NET, "%s: [%s] unable to close input fd %d: %m",
@@ -1318,109 +1513,73 @@ static inline void _poll(con_mgr_t *mgr, poll_args_t *args, List fds,
 }
 
 /*
- * Poll all processing connections sockets and
- * signal_fd and event_fd.
+ * Wait for events on all processing connections and signal_fd and event_fd.
+ *
+ * Connections stay registered with epoll for their lifetime instead of
+ * building a new poll() set every time, and only the connections with events
+ * are handed back.
  */
 static void _poll_connections(void *x)
 {
 	poll_args_t *args = x;
 	con_mgr_t *mgr = args->mgr;
-	struct pollfd *fds_ptr = NULL;
-	con_mgr_fd_t *con;
-	int count;
-	ListIterator itr;
+	struct epoll_event *ev;
+	int nevents;
+	bool handled = false;
 
 	_check_magic_mgr(mgr);
 
-	slurm_mutex_lock(&mgr->mutex);
-
-	/* grab counts once */
-	count = list_count(mgr->connections);
-
-	fds_ptr = args->fds;
-
-	xrecalloc(args->fds, ((count * 2) + 2), sizeof(*args->fds));
-	xassert(sizeof(*fds_ptr) == sizeof(*args->fds));
-
-	args->nfds = 0;
-	fds_ptr = args->fds;
-
-	/* Add signal fd */
-	fds_ptr->fd = mgr->sigint_fd[0];
-	fds_ptr->events = POLLIN;
-	fds_ptr++;
-	args->nfds++;
-
-	/* Add event fd */
-	fds_ptr->fd = mgr->event_fd[0];
-	fds_ptr->events = POLLIN;
-	fds_ptr++;
-	args->nfds++;
+	if (!args->events)
+		args->events = xcalloc(MAX_EPOLL_EVENTS, sizeof(*args->events));
 
-	/*
-	 * populate sockets with !has_work
-	 */
-	itr = list_iterator_create(mgr->connections);
-	while ((con = list_next(itr))) {
-		_check_magic_fd(con);
-
-		if (con->has_work)
-			continue;
+	log_flag(NET, "%s: waiting for events", __func__);
 
-		log_flag(NET, "%s: [%s] poll read_eof=%s input=%u output=%u has_work=%c",
-			 __func__, con->name, (con->read_eof ? "T" : "F"),
-			 get_buf_offset(con->in), get_buf_offset(con->out),
-			 (con->has_work ? 'T' : 'F'));
+	nevents = epoll_wait(mgr->epoll_fd, args->events, MAX_EPOLL_EVENTS,
+			     POLL_TIMEOUT_MS);
+	if ((nevents == -1) && (errno != EINTR))
+		fatal("%s: unable to wait for connection events: %m",
+		      __func__);
 
-		if (con->input_fd == con->output_fd) {
-			/* if fd is same, only poll it */
-			fds_ptr->fd = con->input_fd;
-			fds_ptr->events = 0;
+	slurm_mutex_lock(&mgr->mutex);
 
-			if (con->input_fd != -1)
-				fds_ptr->events |= POLLIN;
-			if (get_buf_offset(con->out))
-				fds_ptr->events |= POLLOUT;
+	ev = args->events;
+	for (int i = 0; i < nevents; i++, ev++) {
+		const int fd = ev->data.fd;
 
-			fds_ptr++;
-			args->nfds++;
+		if (fd == mgr->sigint_fd[0]) {
+			if (!mgr->shutdown)
+				info("%s: caught SIGINT. Shutting down.",
+				     __func__);
+			mgr->shutdown = true;
+			handled = true;
+		} else if (fd == mgr->event_fd[0]) {
+			log_flag(NET, "%s: signal pipe CHANGE_EVENT events=0x%"PRIx32,
+				 __func__, ev->events);
+		} else if ((fd < mgr->fd_cons_size) && mgr->fd_cons[fd]) {
+			_handle_poll_event(mgr, fd, mgr->fd_cons[fd],
+					   ev->events);
+			handled = true;
 		} else {
-			/*
-			 * Account for fd being different
-			 * for input and output.
-			 */
-			if (con->input_fd != -1) {
-				fds_ptr->fd = con->input_fd;
-				fds_ptr->events = POLLIN;
-				fds_ptr++;
-				args->nfds++;
-			}
-
-			if (get_buf_offset(con->out)) {
-				fds_ptr->fd = con->output_fd;
-				fds_ptr->events = POLLOUT;
-				fds_ptr++;
-				args->nfds++;
-			}
+			/* FD probably got closed between epoll and now */
+			log_flag(NET, "%s: unable to find connection for fd=%u",
+				 __func__, fd);
 		}
 	}
-	list_iterator_destroy(itr);
 
-	xassert(args->nfds >= 2);
-	xassert(args->nfds <= ((count * 2) + 2));
-	slurm_mutex_unlock(&mgr->mutex);
-
-	log_flag(NET, "%s: polling %u file descriptors for %u connections",
-		 __func__, args->nfds, count);
-
-	_poll(mgr, args, mgr->connections, &_handle_poll_event, __func__);
+	/*
+	 * signal that something happened and to restart polling. A timeout
+	 * needs no signal, the broadcast below is enough for _watch() to
+	 * inspect idle connections and poll again.
+	 */
+	if (handled)
+		_signal_change(mgr, true);
 
 	mgr->poll_active = false;
-	/* notify _watch it can run but don't send signal to event PIPE*/
+	/* notify _watch it can run */
 	slurm_cond_broadcast(&mgr->cond);
 	slurm_mutex_unlock(&mgr->mutex);
 
-	log_flag(NET, "%s: poll done", __func__);
+	log_flag(NET, "%s: poll done with %d events", __func__, nevents);
 }
 
 /*
@@ -1563,9 +1722,9 @@ watch:
 
 		if (!mgr->listen_active) {
 			/* only try to listen if number connections is below limit */
-			if (count >= MAX_OPEN_CONNECTIONS)
+			if (count >= mgr->max_connections)
 				log_flag(NET, "%s: deferring accepting new connections until count is below max: %u/%u",
-					 __func__, count, MAX_OPEN_CONNECTIONS);
+					 __func__, count, mgr->max_connections);
 			else { /* request a listen thread to run */
 				log_flag(NET, "%s: queuing up listen", __func__);
 				mgr->listen_active = true;
@@ -1623,6 +1782,7 @@ watch:
 
 	if (poll_args) {
 		xfree(poll_args->fds);
+		xfree(poll_args->events);
 		xfree(poll_args);
 	}
 
@@ -1767,6 +1927,14 @@ extern int con_mgr_queue_write_fd(con_mgr_fd_t *con, const void *buffer,
 	return SLURM_SUCCESS;
 }
 
+extern void con_mgr_set_idle_timeout(con_mgr_fd_t *con, int timeout)
+{
+	slurm_mutex_lock(&con->mgr->mutex);
+	con->idle_timeout = timeout;
+	con->last_active = time(NULL);
+	slurm_mutex_unlock(&con->mgr->mutex);
+}
+
 extern void con_mgr_queue_close_fd(con_mgr_fd_t *con)
 {
 	_check_magic_fd(con);
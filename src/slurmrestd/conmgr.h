@@ -120,12 +120,28 @@ struct con_mgr_fd_s {
 	char *unix_socket;
 	/* this is a listen only socket */
 	bool is_listen;
-	/* poll has indicated write is possible */
+	/*
+	 * epoll has indicated write is possible. Connections are edge
+	 * triggered, so this stays set until a write would block.
+	 */
 	bool can_write;
-	/* poll has indicated read is possible */
+	/*
+	 * epoll has indicated read is possible. Connections are edge
+	 * triggered, so this stays set until a read would block.
+	 */
 	bool can_read;
+	/* input_fd can not be polled (regular file) and is always readable */
+	bool input_no_poll;
+	/* output_fd can not be polled (regular file) and is always writable */
+	bool output_no_poll;
+	/* last time data was read or written */
+	time_t last_active;
+	/* seconds to wait for new data before closing or 0 to never close */
+	int idle_timeout;
 	/* has this connection received read EOF */
 	bool read_eof;
+	/* epoll reported an error while has_work was set: close when done */
+	bool poll_error;
 	/* has this connection called on_connection */
 	bool is_connected;
 	/*
@@ -189,6 +205,18 @@ struct con_mgr_s {
 	int event_signaled;
 	/* Event PIPE used to break out of poll */
 	int event_fd[2];
+	/* epoll instance watching all processing connections */
+	int epoll_fd;
+	/* processing connection by fd for epoll events */
+	con_mgr_fd_t **fd_cons;
+	int fd_cons_size;
+	/* max number of processing connections before deferring accept() */
+	int max_connections;
+	/*
+	 * list of unused connection buffers to recycle
+	 * type: buf_t
+	 */
+	List buffers;
 	/* Signal PIPE to catch SIGINT */
 	int sigint_fd[2];
 	/* Caller requests finish on error */
@@ -264,6 +292,14 @@ extern int con_mgr_process_fd_unix_listen(con_mgr_t *mgr, int fd,
 extern int con_mgr_queue_write_fd(con_mgr_fd_t *con, const void *buffer,
 				  const size_t bytes);
 
+/*
+ * Close connection after no data has been read or written for timeout seconds
+ * NOTE: only call from within a callback
+ * IN con connection manager connection struct
+ * IN timeout seconds to wait or 0 to disable
+ */
+extern void con_mgr_set_idle_timeout(con_mgr_fd_t *con, int timeout);
+
 /*
  * Request soft close of connection
  * NOTE: only call from within a callback
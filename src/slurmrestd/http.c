@@ -74,7 +74,7 @@ typedef struct {
 	List headers;
 	/* state tracking of last header received */
 	char *last_header;
-	/* client requested to keep_alive header or -1 to disable */
+	/* seconds to keep connection open or -1 if not requested */
 	int keep_alive;
 	/* RFC7230-6.1 "Connection: Close" */
 	bool connection_close;
@@ -128,6 +128,18 @@ static void _free_request_t(request_t *request)
 	xfree(request);
 }
 
+static request_t *_new_request(http_context_t *context)
+{
+	request_t *request = xmalloc(sizeof(*request));
+
+	request->magic = MAGIC_REQUEST_T;
+	request->headers = list_create(_free_http_header);
+	request->keep_alive = -1;
+	request->context = context;
+
+	return request;
+}
+
 static void _http_parser_url_init(struct http_parser_url *url)
 {
 #if (HTTP_PARSER_VERSION_MAJOR == 2 && HTTP_PARSER_VERSION_MINOR >= 6) || \
@@ -320,7 +332,7 @@ static int _on_headers_complete(http_parser *parser)
 		       __func__, request->context->con->name);
 
 		/* 1.0 defaults to close w/o keep_alive */
-		if (!request->keep_alive)
+		if (request->keep_alive == -1)
 			request->connection_close = true;
 	} else if (parser->http_major == 1 && parser->http_minor == 1) {
 		debug3("%s: [%s] HTTP/1.1 connection",
@@ -730,23 +742,21 @@ static int _on_message_complete(http_parser *parser)
 	if ((rc = _on_message_complete_request(parser, method, request)))
 		return rc;
 
-	if (request->keep_alive) {
-		//TODO: implement keep alive correctly
-		debug2("%s: [%s] keep alive not currently implemented",
-		       __func__, request->context->con->name);
-	}
-
 	if (!request->connection_close) {
 		/*
 		 * Create a new HTTP request to allow persistent connections to
-		 * continue but without inheirting previous requests.
+		 * continue but without inheirting previous requests. Any
+		 * pipelined request already in the buffer will be parsed next.
 		 */
-		request_t *nrequest = xmalloc(sizeof(*request));
-		nrequest->magic = MAGIC_REQUEST_T;
-		nrequest->headers = list_create(_free_http_header);
-		nrequest->context = request->context;
+		request_t *nrequest = _new_request(request->context);
 		request->context->request = nrequest;
 		parser->data = nrequest;
+
+		/* close connection if client goes idle */
+		if (request->keep_alive > 0)
+			con_mgr_set_idle_timeout(request->context->con,
+						 request->keep_alive);
+
 		_free_request_t(request);
 	} else {
 		/* Notify client that this connection will be closed now */
@@ -758,6 +768,9 @@ static int _on_message_complete(http_parser *parser)
 		request->context->request = NULL;
 		_free_request_t(request);
 		parser->data = NULL;
+
+		/* ignore any pipelined requests after close */
+		http_parser_pause(parser, 1);
 	}
 
 	return 0;
@@ -803,9 +816,10 @@ extern int parse_http(con_mgr_fd_t *con, void *x)
 	if (!request) {
 		/* Connection has already been closed */
 		rest_auth_g_clear();
-		debug("%s: [%s] Rejecting continued HTTP connection",
-		      __func__, con->name);
-		return SLURM_UNEXPECTED_MSG_ERROR;
+		debug("%s: [%s] Ignoring %u bytes after connection close",
+		      __func__, con->name, size_buf(buffer));
+		set_buf_offset(buffer, size_buf(buffer));
+		return SLURM_SUCCESS;
 	}
 
 	xassert(request->magic == MAGIC_REQUEST_T);
@@ -1050,16 +1064,13 @@ extern http_context_t *setup_http_context(con_mgr_fd_t *con,
 					  on_http_request_t on_http_request)
 {
 	http_context_t *context = _http_context_new();
-	request_t *request = xmalloc(sizeof(*request));
 
 	xassert(context->magic == MAGIC);
 	xassert(!context->con);
 	xassert(!context->request);
-	request->magic = MAGIC_REQUEST_T;
 	context->con = con;
 	context->on_http_request = on_http_request;
-	context->request = request;
-	request->headers = list_create(_free_http_header);
+	context->request = _new_request(context);
 
 	return context;
 }
@@ -44,8 +44,11 @@
 #include "src/common/list.h"
 #include "src/common/log.h"
 #include "src/common/plugin.h"
+#include "src/common/read_config.h"
 #include "src/common/ref.h"
+#include "src/common/timers.h"
 #include "src/common/xassert.h"
+#include "src/common/xhash.h"
 #include "src/common/xmalloc.h"
 #include "src/common/xstring.h"
 
@@ -117,15 +120,35 @@ typedef struct {
 	http_request_method_t method;
 } entry_method_t;
 
+typedef struct path_node_s path_node_t;
+
 typedef struct {
 	entry_method_t *methods;
 	int tag;
+	char *str_path; /* path as registered */
+	path_node_t *node; /* node of route trie holding this path */
 } path_t;
 
+/*
+ * Route trie compiled from the registered paths. Each node is one path
+ * entry: static entries are looked up by name and every parameter entry
+ * ("{name}") shares a single child, whose typed captures are checked by the
+ * paths ending under it.
+ */
+struct path_node_s {
+	char *entry; /* static entry or NULL for parameter */
+	xhash_t *children; /* static entry -> path_node_t */
+	path_node_t *param; /* child for parameter entry */
+	List paths; /* path_t ending at this node (not owned) */
+};
+
+static path_node_t *path_root = NULL;
+
 static void _free_entry_list(entry_t *entry, path_t *path,
 			     entry_method_t *method);
 static data_for_each_cmd_t _match_server_path_string(const data_t *data,
 						     void *arg);
+static path_node_t *_add_path_node(const entry_t *entry);
 
 /*
  * Parse OAS type.
@@ -551,8 +574,11 @@ extern int register_path_tag(const char *str_path)
 
 	path = xmalloc(sizeof(*path));
 	path->tag = path_tag_counter++;
+	path->str_path = xstrdup(str_path);
 	path->methods = xcalloc((data_get_dict_length(spec_entry) + 1),
 				sizeof(*path->methods));
+	/* entries are unlinked while populating methods */
+	path->node = _add_path_node(entries);
 
 	args.method = path->methods;
 	args.entries = entries;
@@ -561,6 +587,7 @@ extern int register_path_tag(const char *str_path)
 		fatal_abort("%s: failed", __func__);
 
 	list_append(paths, path);
+	list_append(path->node->paths, path);
 
 	rc = path->tag;
 
@@ -705,19 +732,21 @@ static data_for_each_cmd_t _match_path(const data_t *data, void *y)
 	return DATA_FOR_EACH_CONT;
 }
 
-static int _match_path_from_data(void *x, void *key)
+static bool _match_path_from_data(path_t *path, match_path_from_data_t *args)
 {
-	match_path_from_data_t *args = key;
-	path_t *path = x;
 	entry_method_t *method;
 
 	args->path = path;
+	args->matched = false;
 	for (method = path->methods; method->entries; method++) {
 		args->entry = method->entries;
 		data_list_for_each_const(args->dpath, _match_path, args);
 
-		if (args->matched)
+		/* all entries must be consumed */
+		if (args->matched && !args->entry->type)
 			break;
+
+		args->matched = false;
 	}
 
 	if (get_log_level() >= LOG_LEVEL_DEBUG5) {
@@ -737,28 +766,159 @@ static int _match_path_from_data(void *x, void *key)
 		xfree(str_path);
 	}
 
-	return (args->matched ? 1 : 0);
+	return args->matched;
+}
+
+static void _path_node_identify(void *item, const char **key,
+				uint32_t *key_len)
+{
+	path_node_t *node = item;
+
+	*key = node->entry;
+	*key_len = strlen(node->entry);
+}
+
+static void _free_path_node(void *x)
+{
+	path_node_t *node = x;
+
+	if (!node)
+		return;
+
+	xhash_free(node->children);
+	_free_path_node(node->param);
+	FREE_NULL_LIST(node->paths);
+	xfree(node->entry);
+	xfree(node);
+}
+
+static path_node_t *_new_path_node(const char *entry)
+{
+	path_node_t *node = xmalloc(sizeof(*node));
+
+	node->entry = xstrdup(entry);
+	node->paths = list_create(NULL);
+
+	return node;
+}
+
+/* Find or create the trie node for the given path entries */
+static path_node_t *_add_path_node(const entry_t *entry)
+{
+	path_node_t *node;
+
+	if (!path_root)
+		path_root = _new_path_node(NULL);
+
+	for (node = path_root; entry->type; entry++) {
+		path_node_t *child;
+
+		if (entry->type == OPENAPI_PATH_ENTRY_MATCH_PARAMETER) {
+			if (!node->param)
+				node->param = _new_path_node(NULL);
+			node = node->param;
+			continue;
+		}
+
+		if (!node->children)
+			node->children = xhash_init(_path_node_identify,
+						    _free_path_node);
+
+		if (!(child = xhash_get_str(node->children, entry->entry))) {
+			child = _new_path_node(entry->entry);
+			xhash_add(node->children, child);
+		}
+
+		node = child;
+	}
+
+	return node;
+}
+
+/*
+ * Walk trie using the path entries, preferring static entries over
+ * parameters, and return the first registered path ending at the reached
+ * node whose parameter types match.
+ */
+static path_t *_find_path_node(const path_node_t *node, const char **entries,
+			       match_path_from_data_t *args)
+{
+	path_node_t *child;
+	path_t *path;
+
+	if (!*entries) {
+		ListIterator itr = list_iterator_create(node->paths);
+		while ((path = list_next(itr)))
+			if (_match_path_from_data(path, args))
+				break;
+		list_iterator_destroy(itr);
+		return path;
+	}
+
+	if (node->children &&
+	    (child = xhash_get_str(node->children, *entries)) &&
+	    (path = _find_path_node(child, (entries + 1), args)))
+		return path;
+
+	if (node->param)
+		return _find_path_node(node->param, (entries + 1), args);
+
+	return NULL;
+}
+
+static data_for_each_cmd_t _list_path_entries(const data_t *data, void *arg)
+{
+	const char ***entries = arg;
+
+	if (data_get_type(data) != DATA_TYPE_STRING)
+		return DATA_FOR_EACH_FAIL;
+
+	**entries = data_get_string_const(data);
+	(*entries)++;
+
+	return DATA_FOR_EACH_CONT;
 }
 
 extern int find_path_tag(const data_t *dpath, data_t *params,
 			 http_request_method_t method)
 {
-	path_t *path;
+	path_t *path = NULL;
 	int tag = -1;
+	const char **entries, **end;
 	match_path_from_data_t args = {
 		.params = params,
 		.dpath = dpath,
 	};
+	DEF_TIMERS;
 
 	xassert(data_get_type(params) == DATA_TYPE_DICT);
+
+	if (data_get_type(dpath) != DATA_TYPE_LIST)
+		return -1;
+
+	START_TIMER;
+
+	end = entries = xcalloc((data_get_list_length(dpath) + 1),
+				sizeof(*entries));
+	if (data_list_for_each_const(dpath, _list_path_entries, &end) < 0) {
+		xfree(entries);
+		return -1;
+	}
+
 	slurm_rwlock_rdlock(&paths_lock);
 
-	path = list_find_first(paths, _match_path_from_data, &args);
-	if (path)
+	if (path_root && (path = _find_path_node(path_root, entries, &args)))
 		tag = path->tag;
 
+	END_TIMER;
+
+	if (path)
+		log_flag(NET, "%s: matched path %s tag %d in %s",
+			 __func__, path->str_path, tag, TIME_STR);
+
 	slurm_rwlock_unlock(&paths_lock);
 
+	xfree(entries);
 	return tag;
 }
 
@@ -1105,6 +1265,10 @@ static void _list_delete_path_t(void *x)
 		method++;
 	}
 
+	if (path->node)
+		list_delete_ptr(path->node->paths, path);
+
+	xfree(path->str_path);
 	xfree(path->methods);
 	xfree(path);
 }
@@ -1195,6 +1359,8 @@ extern void destroy_openapi(void)
 	g_context_cnt = -1;
 
 	FREE_NULL_LIST(paths);
+	_free_path_node(path_root);
+	path_root = NULL;
 
 	for (size_t i = 0; spec[i]; i++)
 		FREE_NULL_DATA(spec[i]);
@@ -228,15 +228,16 @@ static int _operations_router_reject(const on_http_request_args_t *args,
 static int _resolve_path(on_http_request_args_t *args, int *path_tag,
 			 data_t *params)
 {
-	data_t *path = parse_url_path(args->path, true, false);
+	data_t *path = parse_url_path(args->path, false, false);
 	if (!path)
 		return _operations_router_reject(
 			args, "Unable to parse URL path.",
 			HTTP_STATUS_CODE_ERROR_BAD_REQUEST, NULL);
 
-	/* attempt to identify path leaf types */
-	(void) data_convert_tree(path, DATA_TYPE_NONE);
-
+	/*
+	 * Path entries are left as strings: parameters are converted by
+	 * find_path_tag() to the type declared for them in the OAS.
+	 */
 	*path_tag = find_path_tag(path, params, args->method);
 
 	FREE_NULL_DATA(path);
@@ -433,6 +434,7 @@ static int _call_handler(on_http_request_args_t *args, data_t *params,
 	int rc;
 	data_t *resp = data_new();
 	char *body = NULL;
+	size_t body_length = 0;
 
 	rc = callback(args->context->con->name, args->method, params, query,
 		      callback_tag, resp, args->context->auth);
@@ -440,8 +442,9 @@ static int _call_handler(on_http_request_args_t *args, data_t *params,
 	if (data_get_type(resp) == DATA_TYPE_NULL)
 		/* no op */;
 	else
-		rc = data_g_serialize(&body, resp, write_mime,
-				      DATA_SER_FLAGS_PRETTY);
+		/* keep length as binary formats may contain NUL bytes */
+		rc = data_g_serialize_length(&body, &body_length, resp,
+					     write_mime, DATA_SER_FLAGS_PRETTY);
 
 	if (rc == SLURM_NO_CHANGE_IN_DATA) {
 		/*
@@ -470,7 +473,7 @@ static int _call_handler(on_http_request_args_t *args, data_t *params,
 		else if (rc == ESLURM_DATA_UNKNOWN_MIME_TYPE)
 			e = HTTP_STATUS_CODE_ERROR_UNSUPPORTED_MEDIA_TYPE;
 
-		rc = _operations_router_reject(args, body, e, write_mime);
+		rc = _operations_router_reject(args, NULL, e, write_mime);
 	} else {
 		send_http_response_args_t send_args = {
 			.con = args->context->con,
@@ -481,9 +484,9 @@ static int _call_handler(on_http_request_args_t *args, data_t *params,
 			.body_length = 0,
 		};
 
-		if (body) {
+		if (body && body_length) {
 			send_args.body = body;
-			send_args.body_length = strlen(body);
+			send_args.body_length = body_length;
 			send_args.body_encoding = write_mime;
 		}
 
@@ -155,6 +155,16 @@ extern void slurm_rest_auth_p_free(rest_auth_context_t *context)
 	xfree(context->plugin_data);
 }
 
+extern char *slurm_rest_auth_p_get_identity(rest_auth_context_t *context)
+{
+	plugin_data_t *data = context->plugin_data;
+	xassert(context->plugin_id == plugin_id);
+	xassert(data->magic == MAGIC);
+
+	/* token has not been verified: only the same token is the same user */
+	return xstrdup_printf("%s:%s", context->user_name, data->token);
+}
+
 extern void *slurm_rest_auth_p_get_db_conn(rest_auth_context_t *context)
 {
 	plugin_data_t *data = context->plugin_data;
@@ -282,6 +282,15 @@ extern int slurm_rest_auth_p_apply(rest_auth_context_t *context)
 	return rc;
 }
 
+extern char *slurm_rest_auth_p_get_identity(rest_auth_context_t *context)
+{
+	xassert(((plugin_data_t *) context->plugin_data)->magic == MAGIC);
+	xassert(context->plugin_id == plugin_id);
+
+	/* only the running user is ever allowed by slurm_rest_auth_p_apply() */
+	return xstrdup(context->user_name);
+}
+
 extern void slurm_rest_auth_p_free(rest_auth_context_t *context)
 {
 	plugin_data_t *data = context->plugin_data;
@@ -0,0 +1,453 @@
+/*****************************************************************************\
+ *  query_cache.c - cache and coalesce slurmctld queries
+ *****************************************************************************
+ *  Copyright (C) 2021 SchedMD LLC.
+ *
+ *  This file is part of Slurm, a resource management program.
+ *  For details, see <https://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  Slurm is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  Slurm is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with Slurm; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+#include "config.h"
+
+#include <pthread.h>
+#include <time.h>
+
+#include "slurm/slurm.h"
+
+#include "src/common/list.h"
+#include "src/common/log.h"
+#include "src/common/macros.h"
+#include "src/common/read_config.h"
+#include "src/common/xassert.h"
+#include "src/common/xmalloc.h"
+#include "src/common/xstring.h"
+
+#include "src/slurmrestd/query_cache.h"
+
+#define MAGIC_ENTRY 0x1abe2ea1
+#define MAGIC_REF 0x1abe2ea2
+/* Forget results that have not been requested in this many seconds */
+#define ENTRY_EXPIRE 60
+
+typedef enum {
+	QUERY_INVALID = 0,
+	QUERY_JOBS,
+	QUERY_NODES,
+} query_type_t;
+
+struct query_cache_ref_s {
+	int magic;
+	query_type_t type;
+	/* number of holders including the cache entry itself */
+	int refs;
+	/* controller time of last change in msg */
+	time_t last_update;
+	/* job_info_msg_t or node_info_msg_t */
+	void *msg;
+};
+
+typedef struct {
+	int magic;
+	query_type_t type;
+	uint16_t show_flags;
+	/* rest_auth_g_get_identity() of client */
+	char *identity;
+	/* a thread is currently querying slurmctld */
+	bool loading;
+	/* threads waiting for the current query */
+	int waiters;
+	/* incremented every time a query completes */
+	uint32_t generation;
+	/* result of last query */
+	int rc;
+	/* last successful result or NULL */
+	query_cache_ref_t *ref;
+	/* when ref was last loaded or confirmed unchanged */
+	time_t loaded;
+	/* when this entry was last requested */
+	time_t last_used;
+} entry_t;
+
+typedef struct {
+	query_type_t type;
+	uint16_t show_flags;
+	char *identity;
+} find_entry_t;
+
+static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
+/* signaled every time a query completes */
+static pthread_cond_t cache_cond = PTHREAD_COND_INITIALIZER;
+/* list of entry_t */
+static List entries = NULL;
+static query_cache_stats_t stats = { 0 };
+
+static const char *_query_type_string(query_type_t type)
+{
+	switch (type) {
+	case QUERY_JOBS:
+		return "jobs";
+	case QUERY_NODES:
+		return "nodes";
+	case QUERY_INVALID:
+		break;
+	}
+
+	return "INVALID";
+}
+
+/* cache_lock must be locked */
+static void _release_ref(query_cache_ref_t *ref)
+{
+	if (!ref)
+		return;
+
+	xassert(ref->magic == MAGIC_REF);
+	xassert(ref->refs > 0);
+
+	if (--ref->refs)
+		return;
+
+	switch (ref->type) {
+	case QUERY_JOBS:
+		slurm_free_job_info_msg(ref->msg);
+		break;
+	case QUERY_NODES:
+		slurm_free_node_info_msg(ref->msg);
+		break;
+	case QUERY_INVALID:
+		fatal_abort("%s: invalid query type", __func__);
+	}
+
+	ref->magic = ~MAGIC_REF;
+	xfree(ref);
+}
+
+static void _free_entry(void *x)
+{
+	entry_t *entry = x;
+
+	if (!entry)
+		return;
+
+	xassert(entry->magic == MAGIC_ENTRY);
+	xassert(!entry->loading);
+	xassert(!entry->waiters);
+
+	_release_ref(entry->ref);
+	xfree(entry->identity);
+	entry->magic = ~MAGIC_ENTRY;
+	xfree(entry);
+}
+
+static int _find_entry(void *x, void *key)
+{
+	entry_t *entry = x;
+	find_entry_t *args = key;
+
+	xassert(entry->magic == MAGIC_ENTRY);
+
+	return ((entry->type == args->type) &&
+		(entry->show_flags == args->show_flags) &&
+		!xstrcmp(entry->identity, args->identity));
+}
+
+static int _expire_entry(void *x, void *key)
+{
+	entry_t *entry = x;
+	time_t *now = key;
+
+	return (!entry->loading && !entry->waiters &&
+		((*now - entry->last_used) >= ENTRY_EXPIRE));
+}
+
+/* Query slurmctld without holding any locks */
+static int _query(query_type_t type, time_t update_time, uint16_t show_flags,
+		  void **msg_ptr)
+{
+	int rc = SLURM_ERROR;
+
+	errno = 0;
+
+	switch (type) {
+	case QUERY_JOBS:
+		rc = slurm_load_jobs(update_time, (job_info_msg_t **) msg_ptr,
+				     show_flags);
+		break;
+	case QUERY_NODES:
+		rc = slurm_load_node(update_time, (node_info_msg_t **) msg_ptr,
+				     show_flags);
+		break;
+	case QUERY_INVALID:
+		fatal_abort("%s: invalid query type", __func__);
+	}
+
+	/* API functions return SLURM_ERROR with the cause in errno */
+	if (rc && errno)
+		rc = errno;
+
+	return rc;
+}
+
+static time_t _get_last_update(query_type_t type, void *msg)
+{
+	switch (type) {
+	case QUERY_JOBS:
+		return ((job_info_msg_t *) msg)->last_update;
+	case QUERY_NODES:
+		return ((node_info_msg_t *) msg)->last_update;
+	case QUERY_INVALID:
+		break;
+	}
+
+	fatal_abort("%s: invalid query type", __func__);
+}
+
+/* Query slurmctld for this request only, the result is never shared */
+static int _load_uncached(query_type_t type, time_t update_time,
+			  uint16_t show_flags, void **msg_ptr,
+			  query_cache_ref_t **ref_ptr)
+{
+	query_cache_ref_t *ref;
+	void *msg = NULL;
+	int rc;
+
+	if ((rc = _query(type, update_time, show_flags, &msg)))
+		return rc;
+
+	ref = xmalloc(sizeof(*ref));
+	ref->magic = MAGIC_REF;
+	ref->type = type;
+	ref->refs = 1;
+	ref->msg = msg;
+	ref->last_update = _get_last_update(type, msg);
+
+	*msg_ptr = msg;
+	*ref_ptr = ref;
+	return SLURM_SUCCESS;
+}
+
+static int _load(query_type_t type, rest_auth_context_t *auth,
+		 time_t update_time, uint16_t show_flags, void **msg_ptr,
+		 query_cache_ref_t **ref_ptr)
+{
+	int rc = SLURM_SUCCESS;
+	bool waited = false;
+	uint32_t generation = 0;
+	entry_t *entry;
+	query_cache_ref_t *ref = NULL;
+	time_t now;
+	find_entry_t key = {
+		.type = type,
+		.show_flags = show_flags,
+	};
+
+	*msg_ptr = NULL;
+	*ref_ptr = NULL;
+
+	if (stats.ttl == QUERY_CACHE_DISABLED)
+		return _load_uncached(type, update_time, show_flags, msg_ptr,
+				      ref_ptr);
+
+	/*
+	 * Results are only shared between requests with the same credentials,
+	 * so slurmctld has already authorized every client of a result.
+	 */
+	if (!(key.identity = rest_auth_g_get_identity(auth))) {
+		log_flag(NET, "%s: no identity for %s, not caching %s query",
+			 __func__, auth->user_name, _query_type_string(type));
+		return _load_uncached(type, update_time, show_flags, msg_ptr,
+				      ref_ptr);
+	}
+
+	slurm_mutex_lock(&cache_lock);
+	xassert(entries);
+
+	now = time(NULL);
+	list_delete_all(entries, _expire_entry, &now);
+
+	if (!(entry = list_find_first(entries, _find_entry, &key))) {
+		entry = xmalloc(sizeof(*entry));
+		entry->magic = MAGIC_ENTRY;
+		entry->type = type;
+		entry->show_flags = show_flags;
+		entry->identity = key.identity;
+		key.identity = NULL;
+		list_append(entries, entry);
+	}
+
+	while (entry->loading) {
+		/* another thread is already asking slurmctld: use its result */
+		if (!waited) {
+			waited = true;
+			generation = entry->generation;
+			stats.coalesced++;
+		}
+
+		entry->waiters++;
+		slurm_cond_wait(&cache_cond, &cache_lock);
+		entry->waiters--;
+	}
+
+	now = time(NULL);
+	entry->last_used = now;
+
+	if (waited && (generation != entry->generation) && entry->rc) {
+		/* avoid every waiter retrying the same failed query */
+		rc = entry->rc;
+	} else if (entry->ref &&
+		   ((waited && (generation != entry->generation)) ||
+		    ((now - entry->loaded) < stats.ttl))) {
+		if (!waited)
+			stats.hits++;
+		ref = entry->ref;
+		ref->refs++;
+	} else {
+		void *msg = NULL;
+		/* only ask for changes since the cached result */
+		time_t last_update = (entry->ref ? entry->ref->last_update : 0);
+
+		stats.misses++;
+		entry->loading = true;
+		slurm_mutex_unlock(&cache_lock);
+
+		rc = _query(type, last_update, show_flags, &msg);
+
+		slurm_mutex_lock(&cache_lock);
+		entry->loading = false;
+		entry->generation++;
+
+		if ((rc == SLURM_NO_CHANGE_IN_DATA) && entry->ref) {
+			stats.unchanged++;
+			rc = SLURM_SUCCESS;
+			entry->loaded = time(NULL);
+		} else if (!rc) {
+			_release_ref(entry->ref);
+			entry->ref = xmalloc(sizeof(*entry->ref));
+			entry->ref->magic = MAGIC_REF;
+			entry->ref->type = type;
+			entry->ref->refs = 1;
+			entry->ref->msg = msg;
+			entry->ref->last_update = _get_last_update(type, msg);
+			entry->loaded = time(NULL);
+		} else {
+			stats.errors++;
+		}
+
+		entry->rc = rc;
+		slurm_cond_broadcast(&cache_cond);
+
+		if (!rc) {
+			ref = entry->ref;
+			ref->refs++;
+		}
+	}
+
+	stats.entries = list_count(entries);
+	slurm_mutex_unlock(&cache_lock);
+
+	log_flag(NET, "%s: %s query for %s show_flags=0x%x: %s%s",
+		 __func__, _query_type_string(type), auth->user_name,
+		 show_flags, slurm_strerror(rc),
+		 (waited ? " (coalesced)" : ""));
+
+	xfree(key.identity);
+
+	if (rc)
+		return rc;
+
+	/* match slurmctld's check of update_time against the result */
+	if (update_time && ((update_time - 1) >= ref->last_update)) {
+		query_cache_release(ref);
+		return SLURM_NO_CHANGE_IN_DATA;
+	}
+
+	*msg_ptr = ref->msg;
+	*ref_ptr = ref;
+	return SLURM_SUCCESS;
+}
+
+extern int query_cache_load_jobs(rest_auth_context_t *auth,
+				 time_t update_time, uint16_t show_flags,
+				 job_info_msg_t **msg_ptr,
+				 query_cache_ref_t **ref_ptr)
+{
+	return _load(QUERY_JOBS, auth, update_time, show_flags,
+		     (void **) msg_ptr, ref_ptr);
+}
+
+extern int query_cache_load_nodes(rest_auth_context_t *auth,
+				  time_t update_time, uint16_t show_flags,
+				  node_info_msg_t **msg_ptr,
+				  query_cache_ref_t **ref_ptr)
+{
+	return _load(QUERY_NODES, auth, update_time, show_flags,
+		     (void **) msg_ptr, ref_ptr);
+}
+
+extern void query_cache_release(query_cache_ref_t *ref)
+{
+	if (!ref)
+		return;
+
+	slurm_mutex_lock(&cache_lock);
+	_release_ref(ref);
+	slurm_mutex_unlock(&cache_lock);
+}
+
+extern void query_cache_get_stats(query_cache_stats_t *stats_ptr)
+{
+	slurm_mutex_lock(&cache_lock);
+	*stats_ptr = stats;
+	slurm_mutex_unlock(&cache_lock);
+}
+
+extern void init_query_cache(int ttl)
+{
+	slurm_mutex_lock(&cache_lock);
+	xassert(!entries);
+	entries = list_create(_free_entry);
+	stats.ttl = ttl;
+	slurm_mutex_unlock(&cache_lock);
+
+	if (ttl == QUERY_CACHE_DISABLED)
+		debug("%s: not caching slurmctld query results", __func__);
+	else
+		debug("%s: caching slurmctld query results for %d seconds",
+		      __func__, ttl);
+}
+
+extern void destroy_query_cache(void)
+{
+	slurm_mutex_lock(&cache_lock);
+	debug("%s: hits=%"PRIu64" misses=%"PRIu64" coalesced=%"PRIu64" unchanged=%"PRIu64" errors=%"PRIu64,
+	      __func__, stats.hits, stats.misses, stats.coalesced,
+	      stats.unchanged, stats.errors);
+	FREE_NULL_LIST(entries);
+	slurm_mutex_unlock(&cache_lock);
+}
@@ -0,0 +1,114 @@
+/*****************************************************************************\
+ *  query_cache.h - cache and coalesce slurmctld queries
+ *****************************************************************************
+ *  Copyright (C) 2021 SchedMD LLC.
+ *
+ *  This file is part of Slurm, a resource management program.
+ *  For details, see <https://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  Slurm is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  Slurm is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with Slurm; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+#ifndef SLURMRESTD_QUERY_CACHE_H
+#define SLURMRESTD_QUERY_CACHE_H
+
+#include "slurm/slurm.h"
+
+#include "src/slurmrestd/rest_auth.h"
+
+/* Never share query results between requests */
+#define QUERY_CACHE_DISABLED -1
+
+/* Reference to shared (read only) query result */
+typedef struct query_cache_ref_s query_cache_ref_t;
+
+typedef struct {
+	uint64_t hits; /* requests served from cache */
+	uint64_t misses; /* requests that required an RPC */
+	uint64_t coalesced; /* requests that waited on another's RPC */
+	uint64_t unchanged; /* RPCs that only confirmed cached result */
+	uint64_t errors; /* RPCs that failed */
+	uint32_t entries; /* cached results */
+	int ttl; /* seconds to reuse a result or QUERY_CACHE_DISABLED */
+} query_cache_stats_t;
+
+/*
+ * Setup query cache
+ * only call once!
+ * IN ttl - seconds to reuse a query result, 0 to only coalesce
+ *	concurrent queries or QUERY_CACHE_DISABLED to always query slurmctld
+ */
+extern void init_query_cache(int ttl);
+extern void destroy_query_cache(void);
+
+/*
+ * Load all jobs as slurm_load_jobs() would for the client, sharing the result
+ * with concurrent and recent identical queries from the same client identity.
+ * Nothing is shared if the cache is disabled or the client has no identity.
+ *
+ * IN auth - auth context of client (must already be applied)
+ * IN update_time - only return jobs if changed since update_time
+ * IN show_flags - job filtering options
+ * OUT msg_ptr - job info which must not be modified
+ * OUT ref_ptr - reference to release with query_cache_release()
+ * RET SLURM_SUCCESS, SLURM_NO_CHANGE_IN_DATA or error
+ */
+extern int query_cache_load_jobs(rest_auth_context_t *auth,
+				 time_t update_time, uint16_t show_flags,
+				 job_info_msg_t **msg_ptr,
+				 query_cache_ref_t **ref_ptr);
+
+/*
+ * Load all nodes as slurm_load_node() would for the client, sharing the result
+ * with concurrent and recent identical queries from the same client identity.
+ * Nothing is shared if the cache is disabled or the client has no identity.
+ *
+ * IN auth - auth context of client (must already be applied)
+ * IN update_time - only return nodes if changed since update_time
+ * IN show_flags - node filtering options
+ * OUT msg_ptr - node info which must not be modified
+ * OUT ref_ptr - reference to release with query_cache_release()
+ * RET SLURM_SUCCESS, SLURM_NO_CHANGE_IN_DATA or error
+ */
+extern int query_cache_load_nodes(rest_auth_context_t *auth,
+				  time_t update_time, uint16_t show_flags,
+				  node_info_msg_t **msg_ptr,
+				  query_cache_ref_t **ref_ptr);
+
+/*
+ * Release reference to query result
+ * IN ref - reference from query_cache_load_*() or NULL
+ */
+extern void query_cache_release(query_cache_ref_t *ref);
+
+/*
+ * Get snapshot of query cache statistics
+ * OUT stats - statistics to populate
+ */
+extern void query_cache_get_stats(query_cache_stats_t *stats);
+
+#endif /* SLURMRESTD_QUERY_CACHE_H */
@@ -60,6 +60,8 @@ typedef struct {
 	void *(*db_conn)(rest_auth_context_t *context);
 	int (*apply)(rest_auth_context_t *context);
 	void (*free)(rest_auth_context_t *context);
+	/* optional: NULL if plugin results must never be shared */
+	char *(*identity)(rest_auth_context_t *context);
 } slurm_rest_auth_ops_t;
 
 /*
@@ -140,6 +142,9 @@ extern int init_rest_auth(const plugin_handle_t *plugin_handles,
 		    < (sizeof(syms)/sizeof(syms[0])))
 			fatal("Incomplete plugin detected");
 
+		ops[g_context_cnt].identity = plugin_get_sym(plugin_handles[i],
+			"slurm_rest_auth_p_get_identity");
+
 		id_ptr = plugin_get_sym(plugin_handles[i], "plugin_id");
 		if (!id_ptr)
 			fatal("%s: unable to find plugin_id symbol",
@@ -269,6 +274,31 @@ extern void *rest_auth_g_get_db_conn(rest_auth_context_t *context)
 	return NULL;
 }
 
+extern char *rest_auth_g_get_identity(rest_auth_context_t *context)
+{
+	_check_magic(context);
+
+	if (!context->plugin_id)
+		return NULL;
+
+	for (int i = 0; (g_context_cnt > 0) && (i < g_context_cnt); i++) {
+		if (context->plugin_id == plugin_ids[i]) {
+			char *plugin_identity, *identity;
+
+			if (!ops[i].identity ||
+			    !(plugin_identity = (*(ops[i].identity))(context)))
+				return NULL;
+
+			identity = xstrdup_printf("%u:%s", context->plugin_id,
+						  plugin_identity);
+			xfree(plugin_identity);
+			return identity;
+		}
+	}
+
+	return NULL;
+}
+
 extern void rest_auth_g_free(rest_auth_context_t *context)
 {
 	bool found = false;
@@ -89,6 +89,16 @@ extern int rest_auth_g_apply(rest_auth_context_t *context);
  */
 extern void *rest_auth_g_get_db_conn(rest_auth_context_t *context);
 
+/*
+ * Get identity of credentials in auth context.
+ * Contexts with the same identity were authenticated with the same
+ * credentials and are treated as the same client.
+ * IN context - auth context
+ * RET identity string (must xfree()) or NULL on error or if the auth plugin
+ *	does not provide slurm_rest_auth_p_get_identity()
+ */
+extern char *rest_auth_g_get_identity(rest_auth_context_t *context);
+
 /*
  * Clear current auth context
  * will fatal on error
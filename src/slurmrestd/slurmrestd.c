@@ -69,6 +69,7 @@
 #include "src/slurmrestd/http.h"
 #include "src/slurmrestd/openapi.h"
 #include "src/slurmrestd/operations.h"
+#include "src/slurmrestd/query_cache.h"
 #include "src/slurmrestd/rest_auth.h"
 
 decl_static_data(usage_txt);
@@ -91,6 +92,8 @@ static List socket_listen = NULL;
 static char *slurm_conf_filename = NULL;
 /* Number of requested threads */
 static int thread_count = 20;
+/* Seconds to reuse slurmctld query results */
+static int cache_ttl = QUERY_CACHE_DISABLED;
 /* User to become once loaded */
 static uid_t uid = 0;
 static gid_t gid = 0;
@@ -126,6 +129,16 @@ static void _parse_env(void)
 			fatal("Invalid env SLURMRESTD_DEBUG: %s", buffer);
 	}
 
+	if ((buffer = getenv("SLURMRESTD_CACHE_TTL"))) {
+		char *end = NULL;
+
+		cache_ttl = strtol(buffer, &end, 10);
+
+		if ((cache_ttl < 0) || !end || (*end != '\0') ||
+		    (end == buffer))
+			fatal("Invalid env SLURMRESTD_CACHE_TTL: %s", buffer);
+	}
+
 	if ((buffer = getenv("SLURMRESTD_LISTEN")) != NULL) {
 		/* split comma delimited list */
 		char *toklist = xstrdup(buffer);
@@ -403,6 +416,8 @@ int main(int argc, char **argv)
 	if (init_operations())
 		fatal("Unable to initialize operations structures");
 
+	init_query_cache(cache_ttl);
+
 	auth_rack = plugrack_create("rest_auth");
 	plugrack_read_dir(auth_rack, slurm_conf.plugindir);
 
@@ -546,6 +561,7 @@ int main(int argc, char **argv)
 	/* cleanup everything */
 	destroy_rest_auth();
 	destroy_operations();
+	destroy_query_cache();
 	destroy_openapi();
 	free_con_mgr(conmgr);
 	data_destroy_static();
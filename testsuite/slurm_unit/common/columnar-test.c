@@ -0,0 +1,323 @@
+/*****************************************************************************\
+ *  Copyright (C) 2021 SchedMD LLC.
+ *
+ *  This file is part of Slurm, a resource management program.
+ *  For details, see <https://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  Slurm is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  Slurm is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with Slurm; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+#include "config.h"
+
+#include <check.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "slurm/slurm_errno.h"
+#include "src/common/xmalloc.h"
+#include "src/common/xstring.h"
+#include "src/plugins/acct_gather_profile/columnar/columnar_api.h"
+
+/* not a multiple of the chunk size so the last chunk is a partial one */
+#define ROW_CNT 1000
+#define CHUNK_ROWS 32
+#define BASE_TIME 1600000000
+
+enum {
+	FIELD_COUNTER,
+	FIELD_GAUGE,
+	FIELD_DOUBLE,
+	FIELD_CNT
+};
+
+static char file[] = "/tmp/columnar-test.XXXXXX";
+
+static acct_gather_profile_dataset_t fields[] = {
+	{ "Counter", PROFILE_FIELD_UINT64 },
+	{ "Gauge", PROFILE_FIELD_UINT64 },
+	{ "Double", PROFILE_FIELD_DOUBLE },
+	{ NULL, PROFILE_FIELD_NOT_SET }
+};
+
+static columnar_node_t node = {
+	.cpus_per_task = 2,
+	.job_id = 1234,
+	.node_name = "node1",
+	.nodeid = 0,
+	.ntasks = 4,
+	.start_time = BASE_TIME,
+	.step_id = 0,
+};
+
+static uint64_t _double_bits(double d)
+{
+	union {
+		uint64_t u;
+		double d;
+	} v = { .d = d };
+
+	return v.u;
+}
+
+/*
+ * Sample times with regular intervals, jitter, large jumps both ways and
+ * repeated timestamps, to hit every delta-of-delta bit width.
+ */
+static time_t _row_time(int i)
+{
+	time_t t = BASE_TIME + (i * 30);
+
+	if (i % 7 == 3)
+		t += 1;
+	if (i % 97 == 50)
+		t += 100000;
+	if (i >= 500)
+		t += (time_t) 1 << 40;
+	if (i % 211 == 100)
+		t -= 5000;
+	if (i % 53 == 10)
+		t = _row_time(i - 1);
+
+	return t;
+}
+
+static void _row_data(int i, uint64_t *data)
+{
+	static const double specials[] = {
+		0.0, -0.0, INFINITY, -INFINITY, NAN, 1e-310, -1.5, 1e308
+	};
+
+	/* increasing with occasional resets and wrap around the limits */
+	data[FIELD_COUNTER] = (uint64_t) i * 4096;
+	if (i % 50 == 0)
+		data[FIELD_COUNTER] = 0;
+	else if (i % 50 == 1)
+		data[FIELD_COUNTER] = UINT64_MAX;
+	else if (i % 50 == 2)
+		data[FIELD_COUNTER] = UINT64_MAX - 1;
+
+	/* varying both ways */
+	data[FIELD_GAUGE] = (i % 2) ? (uint64_t) i * i : 1000000 - i;
+	if (i % 33 == 0)
+		data[FIELD_GAUGE] = data[FIELD_GAUGE - 1];
+
+	if (i % 10 < 8)
+		data[FIELD_DOUBLE] = _double_bits(specials[i % 8]);
+	else if (i % 3)
+		data[FIELD_DOUBLE] = _double_bits(i / 7.0);
+	else	/* repeated value */
+		data[FIELD_DOUBLE] = _double_bits(42.42);
+}
+
+static void _write_file(void)
+{
+	columnar_writer_t *writer;
+	uint64_t data[FIELD_CNT], other;
+	int id, other_id, fd;
+
+	strcpy(file, "/tmp/columnar-test.XXXXXX");
+	ck_assert_int_ge((fd = mkstemp(file)), 0);
+	close(fd);
+
+	writer = columnar_writer_open(file, &node, CHUNK_ROWS);
+	ck_assert_ptr_ne(writer, NULL);
+	id = columnar_writer_add_dataset(writer, GRP_TASK, "0", fields);
+	ck_assert_int_ge(id, 0);
+	other_id = columnar_writer_add_dataset(writer, NULL, "Other", fields);
+	ck_assert_int_ge(other_id, 0);
+	ck_assert_int_ne(id, other_id);
+
+	for (int i = 0; i < ROW_CNT; i++) {
+		_row_data(i, data);
+		ck_assert_int_eq(columnar_writer_append(writer, id,
+							_row_time(i), data),
+				 SLURM_SUCCESS);
+		/* interleave the chunks of another dataset */
+		if (i % 3)
+			continue;
+		other = i;
+		memset(data, 0, sizeof(data));
+		data[FIELD_COUNTER] = other;
+		ck_assert_int_eq(columnar_writer_append(writer, other_id,
+							BASE_TIME + i, data),
+				 SLURM_SUCCESS);
+	}
+
+	ck_assert_int_eq(columnar_writer_close(writer), SLURM_SUCCESS);
+}
+
+/*
+ * Read back the rows of the "0" dataset and check them against the ones
+ * written. RET number of rows read
+ */
+static int _read_file(void)
+{
+	columnar_reader_t *reader;
+	columnar_dataset_t *ds;
+	columnar_node_t *rnode;
+	uint64_t times[CHUNK_ROWS], col[FIELD_CNT][CHUNK_ROWS];
+	uint64_t data[FIELD_CNT];
+	int type, row = 0, other_rows = 0;
+	uint32_t rows;
+
+	reader = columnar_reader_open(file, 0);
+	ck_assert_ptr_ne(reader, NULL);
+
+	while ((type = columnar_reader_next(reader)) > 0) {
+		switch (type) {
+		case COLUMNAR_REC_NODE:
+			rnode = columnar_reader_node(reader);
+			ck_assert_ptr_ne(rnode, NULL);
+			ck_assert_str_eq(rnode->node_name, node.node_name);
+			ck_assert_int_eq(rnode->job_id, node.job_id);
+			ck_assert_int_eq(rnode->ntasks, node.ntasks);
+			ck_assert_int_eq(rnode->start_time, node.start_time);
+			break;
+		case COLUMNAR_REC_DATASET:
+			ds = columnar_reader_dataset(reader, -1);
+			ck_assert_int_eq(ds->field_cnt, FIELD_CNT);
+			for (int f = 0; f < FIELD_CNT; f++) {
+				ck_assert_str_eq(ds->field_names[f],
+						 fields[f].name);
+				ck_assert_int_eq(ds->field_types[f],
+						 fields[f].type);
+			}
+			break;
+		case COLUMNAR_REC_CHUNK:
+			ds = columnar_reader_dataset(reader, -1);
+			rows = columnar_reader_rows(reader);
+			ck_assert_int_gt(rows, 0);
+			ck_assert_int_le(rows, CHUNK_ROWS);
+			ck_assert_int_eq(columnar_reader_time(reader, times),
+					 SLURM_SUCCESS);
+			for (int f = 0; f < FIELD_CNT; f++)
+				ck_assert_int_eq(
+					columnar_reader_column(reader, f,
+							       col[f]),
+					SLURM_SUCCESS);
+
+			if (!xstrcmp(ds->name, "Other")) {
+				for (int r = 0; r < rows; r++) {
+					ck_assert_uint_eq(col[FIELD_COUNTER][r],
+							  other_rows * 3);
+					ck_assert_uint_eq(times[r], BASE_TIME +
+							  (other_rows * 3));
+					other_rows++;
+				}
+				break;
+			}
+
+			ck_assert_str_eq(ds->group, GRP_TASK);
+			for (int r = 0; r < rows; r++, row++) {
+				_row_data(row, data);
+				ck_assert_msg(times[r] == _row_time(row),
+					      "row %d time %"PRIu64" != %"PRIu64,
+					      row, times[r],
+					      (uint64_t) _row_time(row));
+				/* compare bits, NaN and -0.0 included */
+				for (int f = 0; f < FIELD_CNT; f++)
+					ck_assert_msg(col[f][r] == data[f],
+						      "row %d field %d %"PRIx64
+						      " != %"PRIx64, row, f,
+						      col[f][r], data[f]);
+			}
+			break;
+		default:
+			ck_abort_msg("unexpected record type %d", type);
+		}
+	}
+	ck_assert_int_eq(type, COLUMNAR_REC_NONE);
+
+	columnar_reader_close(reader);
+
+	return row;
+}
+
+START_TEST(test_round_trip)
+{
+	_write_file();
+	ck_assert_int_eq(_read_file(), ROW_CNT);
+	ck_assert(isnan(columnar_get_double(_double_bits(NAN))));
+	ck_assert(signbit(columnar_get_double(_double_bits(-0.0))));
+	unlink(file);
+}
+END_TEST
+
+START_TEST(test_truncated)
+{
+	struct stat stat_buf;
+	int rows, last_rows = ROW_CNT;
+
+	_write_file();
+
+	/*
+	 * Cut the file at every byte of its tail: the complete records must
+	 * still be read back and the trailing partial one ignored.
+	 */
+	ck_assert_int_eq(stat(file, &stat_buf), 0);
+	for (off_t size = stat_buf.st_size - 1;
+	     size > stat_buf.st_size - 1024; size--) {
+		ck_assert_int_eq(truncate(file, size), 0);
+		rows = _read_file();
+		ck_assert_int_le(rows, last_rows);
+		last_rows = rows;
+	}
+	ck_assert_int_lt(last_rows, ROW_CNT);
+	ck_assert_int_eq(last_rows % CHUNK_ROWS, 0);
+
+	ck_assert_ptr_eq(columnar_reader_open("/nonexistent", 0), NULL);
+	unlink(file);
+}
+END_TEST
+
+Suite *suite_columnar(void)
+{
+	Suite *s = suite_create("columnar");
+	TCase *tc_core = tcase_create("columnar");
+
+	tcase_add_test(tc_core, test_round_trip);
+	tcase_add_test(tc_core, test_truncated);
+
+	suite_add_tcase(s, tc_core);
+	return s;
+}
+
+int main(void)
+{
+	int number_failed;
+	SRunner *sr = srunner_create(suite_columnar());
+
+	srunner_run_all(sr, CK_ENV);
+	number_failed = srunner_ntests_failed(sr);
+	srunner_free(sr);
+
+	return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
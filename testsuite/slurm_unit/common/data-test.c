@@ -40,6 +40,7 @@
 #include "slurm/slurm_errno.h"
 #include "src/common/data.h"
 #include "src/common/log.h"
+#include "src/common/timers.h"
 #include "src/common/xmalloc.h"
 #include "src/common/xstring.h"
 
@@ -236,6 +237,62 @@ START_TEST(test_dict_iteration)
 }
 END_TEST
 
+static data_for_each_cmd_t _del_dict_odd(const char *key, data_t *data,
+					  void *arg)
+{
+	int *deleted = arg;
+
+	if (!(data_get_int(data) % 2))
+		return DATA_FOR_EACH_CONT;
+
+	(*deleted)++;
+	return DATA_FOR_EACH_DELETE;
+}
+
+START_TEST(test_dict_large)
+{
+	const int count = 20000;
+	int deleted = 0;
+	data_t *d = data_set_dict(data_new());
+	DEF_TIMERS;
+
+	START_TIMER;
+	for (int i = 0; i < count; i++)
+		data_set_int(data_key_set_int(d, i), i);
+	END_TIMER;
+	debug("%s: set %d keys in %s", __func__, count, TIME_STR);
+	ck_assert_msg(data_get_dict_length(d) == count, "dict cardinality");
+
+	START_TIMER;
+	for (int i = 0; i < count; i++) {
+		char key[32];
+		data_t *v;
+
+		snprintf(key, sizeof(key), "%d", i);
+		v = data_key_get(d, key);
+		ck_assert_msg(v && (data_get_int(v) == i), "find key %s", key);
+	}
+	END_TIMER;
+	debug("%s: found %d keys in %s", __func__, count, TIME_STR);
+	ck_assert_msg(!data_key_get(d, "-1"), "missing key");
+
+	ck_assert_msg(data_dict_for_each(d, _del_dict_odd, &deleted) == count,
+		      "delete odd");
+	ck_assert_msg(deleted == (count / 2), "deleted odd");
+	ck_assert_msg(data_get_dict_length(d) == (count / 2),
+		      "dict cardinality after delete");
+	ck_assert_msg(!data_key_get(d, "1"), "deleted key");
+	ck_assert_msg(data_key_get(d, "2"), "kept key");
+	ck_assert_msg(data_key_unset(d, "2"), "unset key");
+	ck_assert_msg(!data_key_get(d, "2"), "unset key gone");
+
+	START_TIMER;
+	FREE_NULL_DATA(d);
+	END_TIMER;
+	debug("%s: freed dict in %s", __func__, TIME_STR);
+}
+END_TEST
+
 START_TEST(test_dict_typeset)
 {
 	data_t *d = data_new();
@@ -341,6 +398,7 @@ Suite *suite_data(void)
 	tcase_add_test(tc_core, test_detection);
 	tcase_add_test(tc_core, test_dict_typeset);
 	tcase_add_test(tc_core, test_dict_iteration);
+	tcase_add_test(tc_core, test_dict_large);
 	tcase_add_test(tc_core, test_list_iteration);
 
 	suite_add_tcase(s, tc_core);
@@ -0,0 +1,473 @@
+/*****************************************************************************\
+ *  Copyright (C) 2021 SchedMD LLC.
+ *
+ *  This file is part of Slurm, a resource management program.
+ *  For details, see <https://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  Slurm is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  Slurm is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with Slurm; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+#include "config.h"
+
+#include <dirent.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <check.h>
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#include "slurm/slurm_errno.h"
+#include "src/common/log.h"
+#include "src/common/macros.h"
+#include "src/common/parse_config.h"
+#include "src/common/plugin.h"
+#include "src/common/read_config.h"
+#include "src/common/slurm_acct_gather_profile.h"
+#include "src/common/xmalloc.h"
+#include "src/common/xstring.h"
+#include "src/slurmd/slurmstepd/slurmstepd_job.h"
+
+#define FIELD_CNT 2
+#define MAX_SAMPLES 20000
+#define WAIT_SECS 30
+
+/*
+ * Local stand-in for InfluxDB: accepts line protocol writes and records
+ * which sample values it got.
+ */
+typedef struct {
+	int fail;		/* answer 503 to so many requests, -1 for all */
+	int gzip_requests;
+	int listen_fd;
+	pthread_mutex_t lock;
+	uint16_t port;
+	int requests;
+	uint8_t seen[MAX_SAMPLES * FIELD_CNT];
+	int unique;		/* number of different values received */
+} sink_t;
+
+static sink_t sink;
+
+static const char *syms[] = {
+	"acct_gather_profile_p_conf_options",
+	"acct_gather_profile_p_conf_set",
+	"acct_gather_profile_p_node_step_start",
+	"acct_gather_profile_p_node_step_end",
+	"acct_gather_profile_p_create_dataset",
+	"acct_gather_profile_p_add_sample_data",
+};
+
+static struct {
+	void (*conf_options)(s_p_options_t **full_options,
+			     int *full_options_cnt);
+	void (*conf_set)(s_p_hashtbl_t *tbl);
+	int (*node_step_start)(stepd_step_rec_t *job);
+	int (*node_step_end)(void);
+	int (*create_dataset)(const char *name, int64_t parent,
+			      acct_gather_profile_dataset_t *dataset);
+	int (*add_sample_data)(int dataset_id, void *data, time_t sample_time);
+} ops;
+
+static plugin_handle_t plugin = PLUGIN_INVALID_HANDLE;
+
+static void _sink_lines(const char *data, size_t len)
+{
+	const char *p = data, *end = data + len;
+	char *line, *val;
+	uint64_t value;
+
+	while (p < end) {
+		const char *eol = memchr(p, '\n', (end - p));
+
+		if (!eol)
+			eol = end;
+		line = xstrndup(p, (eol - p));
+		if ((val = xstrstr(line, " value=")) &&
+		    (sscanf(val + 7, "%"SCNu64, &value) == 1) &&
+		    (value < (MAX_SAMPLES * FIELD_CNT)) &&
+		    !sink.seen[value]++)
+			sink.unique++;
+		xfree(line);
+		p = eol + 1;
+	}
+}
+
+#ifdef HAVE_ZLIB
+static char *_inflate(const char *data, size_t len, size_t *out_len)
+{
+	z_stream strm = { 0 };
+	char *out = NULL;
+	size_t size = 0;
+	int rc;
+
+	ck_assert(inflateInit2(&strm, (MAX_WBITS + 16)) == Z_OK);
+	strm.next_in = (Bytef *) data;
+	strm.avail_in = len;
+	do {
+		size += (len * 4) + 1024;
+		xrealloc(out, size);
+		strm.next_out = (Bytef *) (out + strm.total_out);
+		strm.avail_out = size - strm.total_out;
+		rc = inflate(&strm, Z_NO_FLUSH);
+	} while (rc == Z_OK);
+	ck_assert_msg(rc == Z_STREAM_END, "inflate: %d", rc);
+	*out_len = strm.total_out;
+	inflateEnd(&strm);
+
+	return out;
+}
+#endif
+
+/* Serve one connection, which may carry several requests */
+static void _sink_conn(int fd)
+{
+	char *buf = NULL, *hdr_end, *p, *body;
+	size_t size = 0, len = 0, body_len;
+	ssize_t n;
+
+	while (true) {
+		bool gzip;
+		const char *resp;
+
+		while (!(buf && (hdr_end = xstrstr(buf, "\r\n\r\n")))) {
+			if (len + 4096 >= size) {
+				size += 64 * 1024;
+				xrealloc(buf, size);
+			}
+			if ((n = read(fd, buf + len, size - len - 1)) <= 0)
+				goto end;
+			len += n;
+			buf[len] = '\0';
+		}
+		*hdr_end = '\0';
+		body = hdr_end + 4;
+
+		ck_assert_msg(!xstrncmp(buf, "POST /write?db=slurm&", 21),
+			      "unexpected request: %s", buf);
+		ck_assert((p = xstrcasestr(buf, "Content-Length:")));
+		body_len = strtoul(p + 15, NULL, 10);
+		gzip = xstrcasestr(buf, "Content-Encoding: gzip");
+
+		while ((body - buf) + body_len > len) {
+			size_t off = body - buf;
+
+			if (len + 4096 >= size) {
+				size += body_len + 4096;
+				xrealloc(buf, size);
+				body = buf + off;
+			}
+			if ((n = read(fd, buf + len, size - len - 1)) <= 0)
+				goto end;
+			len += n;
+		}
+
+		slurm_mutex_lock(&sink.lock);
+		sink.requests++;
+		if (sink.fail) {
+			if (sink.fail > 0)
+				sink.fail--;
+			resp = "HTTP/1.1 503 Service Unavailable\r\nContent-Length: 0\r\n\r\n";
+		} else {
+			if (gzip) {
+#ifdef HAVE_ZLIB
+				size_t out_len;
+				char *out = _inflate(body, body_len, &out_len);
+				_sink_lines(out, out_len);
+				xfree(out);
+#else
+				ck_abort_msg("unexpected gzip request");
+#endif
+				sink.gzip_requests++;
+			} else
+				_sink_lines(body, body_len);
+			resp = "HTTP/1.1 204 No Content\r\nContent-Length: 0\r\n\r\n";
+		}
+		slurm_mutex_unlock(&sink.lock);
+
+		ck_assert(write(fd, resp, strlen(resp)) == strlen(resp));
+
+		/* keep what is left for the next request */
+		len -= (body - buf) + body_len;
+		memmove(buf, body + body_len, len);
+		buf[len] = '\0';
+	}
+
+end:
+	xfree(buf);
+	close(fd);
+}
+
+static void *_sink_thread(void *arg)
+{
+	int fd;
+
+	while ((fd = accept(sink.listen_fd, NULL, NULL)) >= 0)
+		_sink_conn(fd);
+
+	return NULL;
+}
+
+static void _sink_start(int fail)
+{
+	struct sockaddr_in addr = { 0 };
+	socklen_t addr_len = sizeof(addr);
+	pthread_t tid;
+
+	slurm_mutex_init(&sink.lock);
+	sink.fail = fail;
+
+	sink.listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+	ck_assert(sink.listen_fd >= 0);
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	ck_assert(!bind(sink.listen_fd, (struct sockaddr *) &addr,
+			sizeof(addr)));
+	ck_assert(!listen(sink.listen_fd, 8));
+	ck_assert(!getsockname(sink.listen_fd, (struct sockaddr *) &addr,
+			       &addr_len));
+	sink.port = ntohs(addr.sin_port);
+
+	slurm_thread_create_detached(&tid, _sink_thread, NULL);
+}
+
+static int _sink_unique(void)
+{
+	int unique;
+
+	slurm_mutex_lock(&sink.lock);
+	unique = sink.unique;
+	slurm_mutex_unlock(&sink.lock);
+
+	return unique;
+}
+
+/* Wait for the sink to have received cnt different values */
+static bool _sink_wait(int cnt)
+{
+	for (int i = 0; i < (WAIT_SECS * 10); i++) {
+		if (_sink_unique() >= cnt)
+			return true;
+		usleep(100000);
+	}
+	return false;
+}
+
+static void _conf_set(const char *spool_dir)
+{
+	s_p_options_t *full_options = NULL;
+	s_p_hashtbl_t *tbl;
+	int full_options_cnt = 0;
+	char *line = NULL, *leftover = NULL;
+
+	ops.conf_options(&full_options, &full_options_cnt);
+	xrealloc(full_options,
+		 ((full_options_cnt + 1) * sizeof(s_p_options_t)));
+	tbl = s_p_hashtbl_create(full_options);
+
+	xstrfmtcat(line, "ProfileInfluxDBHost=http://127.0.0.1:%hu ProfileInfluxDBDatabase=slurm ProfileInfluxDBRTPolicy=autogen ProfileInfluxDBFrequency=1 ProfileInfluxDBTimeout=5",
+		   sink.port);
+	if (spool_dir)
+		xstrfmtcat(line, " ProfileInfluxDBSpoolDir=%s", spool_dir);
+	ck_assert(s_p_parse_line(tbl, line, &leftover));
+	ops.conf_set(tbl);
+
+	xfree(line);
+	s_p_hashtbl_destroy(tbl);
+	for (int i = 0; i < full_options_cnt; i++)
+		xfree(full_options[i].key);
+	xfree(full_options);
+}
+
+/* Start a step of job 1234 on node1 */
+static void _step_start(stepd_step_rec_t *job, uint32_t step_id)
+{
+	memset(job, 0, sizeof(*job));
+	job->node_name = "node1";
+	job->profile = ACCT_GATHER_PROFILE_TASK;
+	job->step_id.job_id = 1234;
+	job->step_id.step_id = step_id;
+
+	ck_assert(ops.node_step_start(job) == SLURM_SUCCESS);
+}
+
+static void _add_samples(int first, int cnt)
+{
+	static int dataset_id = -1;
+	acct_gather_profile_dataset_t dataset[] = {
+		{ "CPUTime", PROFILE_FIELD_UINT64 },
+		{ "RSS", PROFILE_FIELD_UINT64 },
+		{ NULL, PROFILE_FIELD_NOT_SET }
+	};
+	uint64_t data[FIELD_CNT];
+
+	if (dataset_id < 0)
+		dataset_id = ops.create_dataset("0", -1, dataset);
+	ck_assert(dataset_id >= 0);
+
+	for (int i = first; i < (first + cnt); i++) {
+		data[0] = i * FIELD_CNT;
+		data[1] = (i * FIELD_CNT) + 1;
+		ck_assert(ops.add_sample_data(dataset_id, data, i) ==
+			  SLURM_SUCCESS);
+	}
+}
+
+static int _spool_files(const char *dir)
+{
+	DIR *dp = opendir(dir);
+	struct dirent *ent;
+	int cnt = 0;
+
+	ck_assert(dp);
+	while ((ent = readdir(dp)))
+		if (xstrstr(ent->d_name, ".spool"))
+			cnt++;
+	closedir(dp);
+
+	return cnt;
+}
+
+START_TEST(test_send)
+{
+	stepd_step_rec_t job;
+	int cnt = 5000;
+
+	_sink_start(0);
+	_conf_set(NULL);
+	_step_start(&job, 0);
+
+	_add_samples(0, cnt);
+	ck_assert(ops.node_step_end() == SLURM_SUCCESS);
+
+	ck_assert_int_eq(_sink_unique(), (cnt * FIELD_CNT));
+#ifdef HAVE_ZLIB
+	ck_assert_int_eq(sink.gzip_requests, sink.requests);
+#endif
+}
+END_TEST
+
+START_TEST(test_retry)
+{
+	stepd_step_rec_t job;
+	int cnt = 100;
+
+	/* fail the first attempts, the batch must be sent while running */
+	_sink_start(2);
+	_conf_set(NULL);
+	_step_start(&job, 0);
+
+	_add_samples(0, cnt);
+	ck_assert_msg(_sink_wait(cnt * FIELD_CNT),
+		      "got %d of %d values", _sink_unique(), (cnt * FIELD_CNT));
+	ck_assert_int_eq(sink.requests, 3);
+
+	ck_assert(ops.node_step_end() == SLURM_SUCCESS);
+}
+END_TEST
+
+START_TEST(test_spool)
+{
+	stepd_step_rec_t job;
+	char spool_dir[] = "/tmp/influxdb-test.XXXXXX";
+	int cnt = MAX_SAMPLES;
+
+	ck_assert(mkdtemp(spool_dir));
+
+	/* InfluxDB is down for the whole step, everything is spooled */
+	_sink_start(-1);
+	_conf_set(spool_dir);
+	_step_start(&job, 0);
+
+	_add_samples(0, cnt);
+	ck_assert(ops.node_step_end() == SLURM_SUCCESS);
+	ck_assert_int_eq(_sink_unique(), 0);
+	ck_assert_int_eq(_spool_files(spool_dir), 1);
+
+	/* the next step sends the data left behind by the first one */
+	slurm_mutex_lock(&sink.lock);
+	sink.fail = 0;
+	slurm_mutex_unlock(&sink.lock);
+	_step_start(&job, 1);
+
+	ck_assert_msg(_sink_wait(cnt * FIELD_CNT),
+		      "got %d of %d values", _sink_unique(), (cnt * FIELD_CNT));
+	ck_assert(ops.node_step_end() == SLURM_SUCCESS);
+	ck_assert_int_eq(_spool_files(spool_dir), 0);
+
+	ck_assert(!rmdir(spool_dir));
+}
+END_TEST
+
+Suite *suite_influxdb(void)
+{
+	Suite *s = suite_create("InfluxDB");
+	TCase *tc_core = tcase_create("InfluxDB");
+
+	tcase_set_timeout(tc_core, (WAIT_SECS * 2));
+
+	tcase_add_test(tc_core, test_send);
+	tcase_add_test(tc_core, test_retry);
+	tcase_add_test(tc_core, test_spool);
+
+	suite_add_tcase(s, tc_core);
+	return s;
+}
+
+int main(void)
+{
+	int number_failed;
+
+	/* the plugin only sends data from slurmstepd */
+	log_options_t log_opts = LOG_OPTS_INITIALIZER;
+	log_opts.stderr_level = LOG_LEVEL_DEBUG;
+	log_init("slurmstepd", log_opts, 0, NULL);
+
+	/* load the plugin from the build tree */
+	slurm_conf.plugindir = xstrdup(INFLUXDB_PLUGIN_DIR);
+	plugin = plugin_load_and_link("acct_gather_profile/influxdb",
+				      ARRAY_SIZE(syms), syms, (void **) &ops);
+	if (plugin == PLUGIN_INVALID_HANDLE) {
+		error("unable to load acct_gather_profile/influxdb");
+		return EXIT_FAILURE;
+	}
+
+	SRunner *sr = srunner_create(suite_influxdb());
+
+	srunner_run_all(sr, CK_ENV);
+	number_failed = srunner_ntests_failed(sr);
+	srunner_free(sr);
+
+	plugin_unload(plugin);
+	xfree(slurm_conf.plugindir);
+	return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,347 @@
+/*****************************************************************************\
+ *  Copyright (C) 2021 SchedMD LLC.
+ *  Written by Nathan Rini <nate@schedmd.com>
+ *
+ *  This file is part of Slurm, a resource management program.
+ *  For details, see <https://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  Slurm is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  Slurm is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with Slurm; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <check.h>
+
+#include "slurm/slurm_errno.h"
+#include "src/common/data.h"
+#include "src/common/log.h"
+#include "src/common/read_config.h"
+#include "src/common/timers.h"
+#include "src/common/xmalloc.h"
+#include "src/common/xstring.h"
+
+typedef struct {
+	char *buf;
+	size_t len;
+} out_t;
+
+static void _serialize(const data_t *d, const char *mime_type, out_t *out)
+{
+	int rc;
+
+	xfree(out->buf);
+	out->len = 0;
+
+	rc = data_g_serialize_length(&out->buf, &out->len, d, mime_type,
+				     DATA_SER_FLAGS_COMPACT);
+	ck_assert_msg(!rc, "serialize %s: %s", mime_type, slurm_strerror(rc));
+}
+
+static data_t *_deserialize(const out_t *out, const char *mime_type)
+{
+	data_t *d = NULL;
+	int rc = data_g_deserialize(&d, out->buf, out->len, mime_type);
+
+	ck_assert_msg(!rc && d, "deserialize %s: %s",
+		      mime_type, slurm_strerror(rc));
+
+	return d;
+}
+
+static void _check_bytes(const data_t *d, const char *expected, size_t len)
+{
+	out_t out = { 0 };
+
+	_serialize(d, MIME_TYPE_MSGPACK, &out);
+	ck_assert_msg(out.len == len, "encoded length %zu != %zu",
+		      out.len, len);
+	ck_assert_msg(!memcmp(out.buf, expected, len), "encoded bytes");
+
+	xfree(out.buf);
+}
+
+/* every test needs the msgpack plugin from the build tree */
+static void _check_plugin_loaded(void)
+{
+	ck_assert_msg(data_resolve_mime_type(MIME_TYPE_MSGPACK),
+		      "%s plugin not loaded from %s",
+		      MIME_TYPE_MSGPACK_PLUGIN, slurm_conf.plugindir);
+}
+
+START_TEST(test_encoding)
+{
+	data_t *d = data_new();
+
+	_check_bytes(data_set_null(d), "\xc0", 1);
+	_check_bytes(data_set_bool(d, true), "\xc3", 1);
+	_check_bytes(data_set_bool(d, false), "\xc2", 1);
+	_check_bytes(data_set_int(d, 0), "\x00", 1);
+	_check_bytes(data_set_int(d, 127), "\x7f", 1);
+	_check_bytes(data_set_int(d, 128), "\xcc\x80", 2);
+	_check_bytes(data_set_int(d, 65536), "\xce\x00\x01\x00\x00", 5);
+	_check_bytes(data_set_int(d, -1), "\xff", 1);
+	_check_bytes(data_set_int(d, -32), "\xe0", 1);
+	_check_bytes(data_set_int(d, -33), "\xd0\xdf", 2);
+	_check_bytes(data_set_int(d, -129), "\xd1\xff\x7f", 3);
+	_check_bytes(data_set_float(d, 1.5),
+		     "\xcb\x3f\xf8\x00\x00\x00\x00\x00\x00", 9);
+	_check_bytes(data_set_string(d, "abc"), "\xa3" "abc", 4);
+
+	data_set_dict(d);
+	data_set_int(data_key_set(d, "a"), 1);
+	data_set_list(data_key_set(d, "b"));
+	_check_bytes(d, "\x82\xa1" "a" "\x01\xa1" "b" "\x90", 7);
+
+	FREE_NULL_DATA(d);
+}
+END_TEST
+
+START_TEST(test_roundtrip)
+{
+	const int64_t ints[] = {
+		0, 1, 127, 128, 255, 256, 65535, 65536, 4294967295LL,
+		4294967296LL, INT64_MAX, -1, -32, -33, -128, -129, -32768,
+		-32769, INT32_MIN, (INT32_MIN - 1LL), INT64_MIN,
+	};
+	const size_t str_lens[] = { 0, 31, 32, 255, 256, 65535, 65536 };
+	data_t *d = data_set_dict(data_new());
+	data_t *ints_list = data_set_list(data_key_set(d, "ints"));
+	data_t *strs = data_set_list(data_key_set(d, "strings"));
+	data_t *floats = data_set_list(data_key_set(d, "floats"));
+	data_t *big_list = data_set_list(data_key_set(d, "big_list"));
+	data_t *big_dict = data_set_dict(data_key_set(d, "big_dict"));
+	data_t *nested = d, *r;
+	out_t out = { 0 }, out2 = { 0 };
+
+	for (int i = 0; i < ARRAY_SIZE(ints); i++)
+		data_set_int(data_list_append(ints_list), ints[i]);
+
+	for (int i = 0; i < ARRAY_SIZE(str_lens); i++) {
+		char *str = xmalloc(str_lens[i] + 1);
+		memset(str, 'x', str_lens[i]);
+		data_set_string_own(data_list_append(strs), str);
+	}
+
+	data_set_float(data_list_append(floats), 0.0);
+	data_set_float(data_list_append(floats), -1.25e-300);
+	data_set_float(data_list_append(floats), INFINITY);
+
+	for (int i = 0; i < 70000; i++)
+		data_set_int(data_list_append(big_list), i);
+	for (int i = 0; i < 20; i++)
+		data_set_bool(data_key_set_int(big_dict, i), (i % 2));
+
+	for (int i = 0; i < 100; i++)
+		nested = data_set_dict(data_key_set(nested, "nested"));
+	data_set_null(data_key_set(nested, "null"));
+
+	_serialize(d, MIME_TYPE_MSGPACK, &out);
+	r = _deserialize(&out, MIME_TYPE_MSGPACK);
+
+	/* dictionary order is kept so output must be identical */
+	_serialize(r, MIME_TYPE_MSGPACK, &out2);
+	ck_assert_msg((out.len == out2.len) &&
+		      !memcmp(out.buf, out2.buf, out.len), "round trip");
+
+	ck_assert_msg(data_get_list_length(data_key_get(r, "ints")) ==
+		      ARRAY_SIZE(ints), "ints");
+	ck_assert_msg(data_get_list_length(data_key_get(r, "big_list")) ==
+		      70000, "big list");
+	ck_assert_msg(data_get_dict_length(data_key_get(r, "big_dict")) == 20,
+		      "big dict");
+
+	/* callers may count the string terminator */
+	FREE_NULL_DATA(r);
+	out.len++;
+	r = _deserialize(&out, MIME_TYPE_MSGPACK);
+	FREE_NULL_DATA(r);
+	out.len--;
+
+	/* every truncation of the input must be rejected */
+	for (size_t len = 0; len < out.len; len += ((len < 256) ? 1 : 4093)) {
+		ck_assert_msg(data_g_deserialize(&r, out.buf, len,
+						 MIME_TYPE_MSGPACK),
+			      "truncated to %zu bytes", len);
+		ck_assert_msg(!r, "no data when truncated");
+	}
+
+	xfree(out.buf);
+	xfree(out2.buf);
+	FREE_NULL_DATA(d);
+}
+END_TEST
+
+START_TEST(test_invalid)
+{
+	data_t *r = NULL;
+	/* reserved marker, extension type, map with list key, huge array */
+	const char *invalid[] = { "\xc1", "\xd4\x01\x00", "\x81\x90\x01",
+				  "\xdd\xff\xff\xff\xff" };
+	const size_t len[] = { 1, 3, 3, 5 };
+	char deep[1024];
+
+	for (int i = 0; i < ARRAY_SIZE(invalid); i++) {
+		ck_assert_msg(data_g_deserialize(&r, invalid[i], len[i],
+						 MIME_TYPE_MSGPACK),
+			      "invalid input %d", i);
+		ck_assert_msg(!r, "no data for invalid input %d", i);
+	}
+
+	/* nesting limit */
+	memset(deep, 0x91, sizeof(deep));
+	deep[sizeof(deep) - 1] = 0xc0;
+	ck_assert_msg(data_g_deserialize(&r, deep, sizeof(deep),
+					 MIME_TYPE_MSGPACK), "too deep");
+}
+END_TEST
+
+/* Build something shaped like a large job listing from slurmrestd */
+static data_t *_fake_jobs(int count)
+{
+	data_t *d = data_set_dict(data_new());
+	data_t *jobs = data_set_list(data_key_set(d, "jobs"));
+
+	for (int i = 0; i < count; i++) {
+		data_t *job = data_set_dict(data_list_append(jobs));
+		data_t *nodes = data_set_list(data_key_set(job, "nodes"));
+
+		data_set_int(data_key_set(job, "job_id"), (1000000 + i));
+		data_set_string(data_key_set(job, "name"), "benchmark_job");
+		data_set_string(data_key_set(job, "account"), "research");
+		data_set_string(data_key_set(job, "partition"), "compute");
+		data_set_string(data_key_set(job, "job_state"), "RUNNING");
+		data_set_int(data_key_set(job, "user_id"), (1000 + (i % 50)));
+		data_set_int(data_key_set(job, "submit_time"),
+			     (1620000000 + i));
+		data_set_int(data_key_set(job, "time_limit"), 1440);
+		data_set_int(data_key_set(job, "cpus"), (i % 128));
+		data_set_float(data_key_set(job, "billable_tres"), (i * 0.5));
+		data_set_bool(data_key_set(job, "requeue"), (i % 2));
+		data_set_null(data_key_set(job, "comment"));
+		for (int n = 0; n < 4; n++)
+			data_set_string_fmt(data_list_append(nodes), "node%04d",
+					    ((i + n) % 2048));
+	}
+
+	return d;
+}
+
+START_TEST(test_throughput)
+{
+	const int count = 20000;
+	data_t *d = _fake_jobs(count);
+	const char *mime_types[] = { MIME_TYPE_MSGPACK, MIME_TYPE_JSON };
+	size_t sizes[ARRAY_SIZE(mime_types)] = { 0 };
+
+	for (int i = 0; i < ARRAY_SIZE(mime_types); i++) {
+		out_t out = { 0 };
+		data_t *r;
+		DEF_TIMERS;
+
+		if (!data_resolve_mime_type(mime_types[i])) {
+			debug("%s: skipping %s: plugin not loaded",
+			      __func__, mime_types[i]);
+			continue;
+		}
+
+		START_TIMER;
+		_serialize(d, mime_types[i], &out);
+		END_TIMER;
+		debug("%s: %s serialized %d jobs into %zu bytes in %s",
+		      __func__, mime_types[i], count, out.len, TIME_STR);
+
+		START_TIMER;
+		r = _deserialize(&out, mime_types[i]);
+		END_TIMER;
+		debug("%s: %s deserialized %d jobs in %s",
+		      __func__, mime_types[i], count, TIME_STR);
+
+		ck_assert_msg(data_get_list_length(data_key_get(r, "jobs")) ==
+			      count, "%s job count", mime_types[i]);
+
+		sizes[i] = out.len;
+		FREE_NULL_DATA(r);
+		xfree(out.buf);
+	}
+
+	if (sizes[1])
+		ck_assert_msg(sizes[0] < sizes[1], "MessagePack is smaller");
+
+	FREE_NULL_DATA(d);
+}
+END_TEST
+
+Suite *suite_serializer(void)
+{
+	Suite *s = suite_create("Serializer");
+	TCase *tc_core = tcase_create("Serializer");
+
+	/* throughput test can be slow with debugging enabled */
+	tcase_set_timeout(tc_core, 60);
+	tcase_add_checked_fixture(tc_core, _check_plugin_loaded, NULL);
+
+	tcase_add_test(tc_core, test_encoding);
+	tcase_add_test(tc_core, test_roundtrip);
+	tcase_add_test(tc_core, test_invalid);
+	tcase_add_test(tc_core, test_throughput);
+
+	suite_add_tcase(s, tc_core);
+	return s;
+}
+
+int main(void)
+{
+	int number_failed;
+
+	log_options_t log_opts = LOG_OPTS_INITIALIZER;
+	log_opts.stderr_level = LOG_LEVEL_DEBUG;
+	log_init("serializer-test", log_opts, 0, NULL);
+
+	/* load the plugins from the build tree */
+	slurm_conf.plugindir = xstrdup(MSGPACK_PLUGIN_DIR);
+#ifdef JSON_PLUGIN_DIR
+	xstrcat(slurm_conf.plugindir, ":" JSON_PLUGIN_DIR);
+#endif
+
+	if (data_init(NULL, NULL)) {
+		error("data_init() failed");
+		return EXIT_FAILURE;
+	}
+
+	SRunner *sr = srunner_create(suite_serializer());
+
+	srunner_run_all(sr, CK_ENV);
+	number_failed = srunner_ntests_failed(sr);
+	srunner_free(sr);
+
+	data_destroy_static();
+	xfree(slurm_conf.plugindir);
+	return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,411 @@
+/*****************************************************************************\
+ *  Copyright (C) 2021 SchedMD LLC.
+ *
+ *  This file is part of Slurm, a resource management program.
+ *  For details, see <https://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  Slurm is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  Slurm is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with Slurm; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+#include "config.h"
+
+#include <check.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "slurm/slurm_errno.h"
+#include "src/common/list.h"
+#include "src/common/pack.h"
+#include "src/common/slurm_protocol_defs.h"
+#include "src/common/slurmdb_defs.h"
+#include "src/common/slurmdb_export.h"
+#include "src/common/slurmdb_pack.h"
+#include "src/common/xmalloc.h"
+#include "src/common/xstring.h"
+
+#define JOB_CNT 2500
+#define BASE_TIME 1600000000
+
+static char file[] = "/tmp/slurmdb_export-test.XXXXXX";
+
+static char *tres_strs[] = {
+	NULL,
+	"",
+	"1=4,2=4096,4=1",
+	"1=18446744073709551614,1001=0",
+	"cpu=4,mem=1G",		/* not in id=count form */
+	"1=04",			/* would not be printed back the same */
+	"1=2,",
+};
+
+static slurmdb_job_rec_t *_create_job(int i)
+{
+	slurmdb_job_rec_t *job = xmalloc(sizeof(*job));
+
+	job->account = xstrdup_printf("acct%d", i % 7);
+	job->alloc_nodes = i % 5;
+	job->array_task_id = (i % 3) ? NO_VAL : i;
+	job->array_job_id = (i % 3) ? 0 : 1000;
+	job->cluster = xstrdup("cluster");
+	job->constraints = (i % 4) ? NULL : xstrdup("");
+	job->db_index = 5000 + i;
+	job->submit = BASE_TIME + (i * 60);
+	job->eligible = job->submit + 10;
+	job->start = (i % 10) ? job->eligible + 100 : 0;
+	job->end = (i % 10) && (i % 11) ? job->start + 3600 : 0;
+	job->elapsed = job->end ? 3600 : 0;
+	job->exitcode = i % 2;
+	job->jobid = 1000 + i;
+	job->jobname = xstrdup_printf("job%d", i % 50);
+	job->nodes = xstrdup_printf("node[%d-%d]", i % 20, (i % 20) + 3);
+	job->partition = xstrdup((i % 2) ? "debug" : "batch");
+	job->priority = i * 3;
+	job->qosid = 1 + (i % 2);
+	job->req_mem = 0x8000000000000000 | i;
+	job->show_full = 1;
+	job->script = (i % 100) ? NULL :
+		xstrdup_printf("#!/bin/sh\n%d\n", i);
+	job->state = job->end ? JOB_COMPLETE : JOB_RUNNING;
+	job->stats.act_cpufreq = 1.5;
+	job->stats.consumed_energy = NO_VAL64;
+	job->stats.tres_usage_in_ave =
+		xstrdup(tres_strs[i % ARRAY_SIZE(tres_strs)]);
+	job->timelimit = INFINITE;
+	job->track_steps = i % 2;
+	job->tres_alloc_str =
+		xstrdup(tres_strs[(i + 2) % ARRAY_SIZE(tres_strs)]);
+	job->tres_req_str =
+		xstrdup(tres_strs[(i + 3) % ARRAY_SIZE(tres_strs)]);
+	job->uid = 1000 + (i % 4);
+	job->user = xstrdup_printf("user%d", i % 4);
+	job->steps = list_create(slurmdb_destroy_step_rec);
+
+	for (int s = 0; s < (i % 4); s++) {
+		slurmdb_step_rec_t *step = xmalloc(sizeof(*step));
+
+		step->job_ptr = job;
+		step->step_id.job_id = job->jobid;
+		step->step_id.step_id = s ? s - 1 : SLURM_BATCH_SCRIPT;
+		step->step_id.step_het_comp = NO_VAL;
+		step->stepname = xstrdup(s ? "srun" : "batch");
+		step->nodes = xstrdup(job->nodes);
+		step->start = job->start;
+		step->end = job->end;
+		step->exitcode = -s;
+		step->state = job->state;
+		step->req_cpufreq_min = NO_VAL;
+		step->stats.tres_usage_in_max = xstrdup_printf("1=%d,2=%d",
+							       i, s);
+		step->tres_alloc_str = xstrdup(job->tres_alloc_str);
+		step->user_cpu_sec = i * s;
+		if (!job->first_step_ptr)
+			job->first_step_ptr = step;
+		list_append(job->steps, step);
+	}
+
+	return job;
+}
+
+static List _create_jobs(void)
+{
+	List jobs = list_create(slurmdb_destroy_job_rec);
+
+	for (int i = 0; i < JOB_CNT; i++)
+		list_append(jobs, _create_job(i));
+
+	return jobs;
+}
+
+static List _create_tres(void)
+{
+	List tres_list = list_create(slurmdb_destroy_tres_rec);
+	slurmdb_tres_rec_t *tres = xmalloc(sizeof(*tres));
+
+	tres->id = 1;
+	tres->type = xstrdup("cpu");
+	list_append(tres_list, tres);
+
+	return tres_list;
+}
+
+/* Compare the packed form of both lists of jobs */
+static void _compare_jobs(List jobs, List loaded)
+{
+	slurmdb_job_rec_t *job, *loaded_job;
+	ListIterator itr, loaded_itr;
+	buf_t *buf, *loaded_buf;
+
+	ck_assert_int_eq(list_count(jobs), list_count(loaded));
+
+	itr = list_iterator_create(jobs);
+	loaded_itr = list_iterator_create(loaded);
+	while ((job = list_next(itr))) {
+		loaded_job = list_next(loaded_itr);
+
+		buf = init_buf(BUF_SIZE);
+		loaded_buf = init_buf(BUF_SIZE);
+		slurmdb_pack_job_rec(job, SLURM_PROTOCOL_VERSION, buf);
+		slurmdb_pack_job_rec(loaded_job, SLURM_PROTOCOL_VERSION,
+				     loaded_buf);
+		ck_assert_int_eq(get_buf_offset(buf),
+				 get_buf_offset(loaded_buf));
+		ck_assert_msg(!memcmp(get_buf_data(buf),
+				      get_buf_data(loaded_buf),
+				      get_buf_offset(buf)),
+			      "job %u differs", job->jobid);
+		FREE_NULL_BUFFER(buf);
+		FREE_NULL_BUFFER(loaded_buf);
+
+		if (list_count(loaded_job->steps))
+			ck_assert_ptr_eq(loaded_job->first_step_ptr,
+					 list_peek(loaded_job->steps));
+	}
+	list_iterator_destroy(loaded_itr);
+	list_iterator_destroy(itr);
+}
+
+static void _export(List jobs)
+{
+	slurmdb_export_t *exp;
+	List tres_list = _create_tres();
+	List chunk = list_create(NULL);
+	ListIterator itr = list_iterator_create(jobs);
+	void *job;
+	int fd;
+
+	strcpy(file, "/tmp/slurmdb_export-test.XXXXXX");
+	ck_assert_int_ge((fd = mkstemp(file)), 0);
+	close(fd);
+
+	ck_assert_ptr_ne((exp = slurmdb_export_create(file)), NULL);
+	/* chunks of a few hundred jobs, as sent by slurmdbd */
+	while ((job = list_next(itr))) {
+		list_append(chunk, job);
+		if (list_count(chunk) < 300)
+			continue;
+		ck_assert_int_eq(slurmdb_export_add_jobs(exp, chunk),
+				 SLURM_SUCCESS);
+		list_flush(chunk);
+	}
+	ck_assert_int_eq(slurmdb_export_add_jobs(exp, chunk),
+			 SLURM_SUCCESS);
+	ck_assert_int_eq(slurmdb_export_finish(exp, tres_list, NULL),
+			 SLURM_SUCCESS);
+
+	list_iterator_destroy(itr);
+	FREE_NULL_LIST(chunk);
+	FREE_NULL_LIST(tres_list);
+}
+
+START_TEST(test_round_trip)
+{
+	List jobs = _create_jobs(), loaded, tres_list, qos_list;
+	slurmdb_export_file_t *ef;
+	slurmdb_tres_rec_t *tres;
+
+	_export(jobs);
+
+	ef = slurmdb_export_open(file, &tres_list, &qos_list);
+	ck_assert_ptr_ne(ef, NULL);
+	ck_assert_int_eq(list_count(tres_list), 1);
+	tres = list_peek(tres_list);
+	ck_assert_str_eq(tres->type, "cpu");
+	ck_assert_int_eq(list_count(qos_list), 0);
+
+	loaded = slurmdb_export_get_jobs(ef, NULL);
+	ck_assert_ptr_ne(loaded, NULL);
+	_compare_jobs(jobs, loaded);
+
+	FREE_NULL_LIST(loaded);
+	FREE_NULL_LIST(tres_list);
+	FREE_NULL_LIST(qos_list);
+	slurmdb_export_close(ef);
+	FREE_NULL_LIST(jobs);
+	unlink(file);
+}
+END_TEST
+
+static int _match(void *x, void *arg)
+{
+	slurmdb_job_rec_t *job = x;
+	slurmdb_job_cond_t *job_cond = arg;
+
+	return ((job->uid == 1001) && !xstrcmp(job->partition, "debug") &&
+		job->eligible && (job->eligible < job_cond->usage_end) &&
+		(!job->end || (job->end >= job_cond->usage_start)));
+}
+
+START_TEST(test_job_cond)
+{
+	List jobs = _create_jobs(), loaded, tres_list, qos_list;
+	slurmdb_job_cond_t job_cond;
+	slurmdb_export_file_t *ef;
+	slurmdb_job_rec_t *job;
+
+	_export(jobs);
+
+	memset(&job_cond, 0, sizeof(job_cond));
+	job_cond.db_flags = SLURMDB_JOB_FLAG_NOTSET;
+	job_cond.usage_start = BASE_TIME + (JOB_CNT * 60 / 2);
+	job_cond.usage_end = job_cond.usage_start + 7200;
+	job_cond.userid_list = list_create(xfree_ptr);
+	list_append(job_cond.userid_list, xstrdup("1001"));
+	job_cond.partition_list = list_create(xfree_ptr);
+	list_append(job_cond.partition_list, xstrdup("debug"));
+	job_cond.flags = JOBCOND_FLAG_NO_STEP;
+
+	ef = slurmdb_export_open(file, &tres_list, &qos_list);
+	ck_assert_ptr_ne(ef, NULL);
+	loaded = slurmdb_export_get_jobs(ef, &job_cond);
+	ck_assert_ptr_ne(loaded, NULL);
+
+	/* jobs still running (no end) from the start of the file match */
+	list_delete_all(jobs, _match, &job_cond);
+	ck_assert_int_gt(list_count(loaded), 0);
+	ck_assert_int_eq(list_count(loaded),
+			 JOB_CNT - list_count(jobs));
+	while ((job = list_pop(loaded))) {
+		ck_assert_msg(_match(job, &job_cond), "job %u does not match",
+			      job->jobid);
+		ck_assert_int_eq(list_count(job->steps), 0);
+		slurmdb_destroy_job_rec(job);
+	}
+
+	FREE_NULL_LIST(job_cond.userid_list);
+	FREE_NULL_LIST(job_cond.partition_list);
+	FREE_NULL_LIST(loaded);
+	FREE_NULL_LIST(tres_list);
+	FREE_NULL_LIST(qos_list);
+	slurmdb_export_close(ef);
+	FREE_NULL_LIST(jobs);
+	unlink(file);
+}
+END_TEST
+
+static int _find_job(void *x, void *key)
+{
+	slurmdb_job_rec_t *job = x;
+
+	return (job->jobid == *(uint32_t *) key);
+}
+
+START_TEST(test_step_list)
+{
+	List jobs = _create_jobs(), loaded, tres_list, qos_list;
+	slurmdb_job_cond_t job_cond;
+	slurmdb_export_file_t *ef;
+	slurmdb_job_rec_t *job;
+	slurmdb_step_rec_t *step;
+
+	_export(jobs);
+	FREE_NULL_LIST(jobs);
+
+	memset(&job_cond, 0, sizeof(job_cond));
+	job_cond.db_flags = SLURMDB_JOB_FLAG_NOTSET;
+	job_cond.flags = JOBCOND_FLAG_NO_DEFAULT_USAGE;
+	job_cond.step_list = list_create(xfree_ptr);
+	slurm_addto_step_list(job_cond.step_list, "1003.0,1007");
+
+	ef = slurmdb_export_open(file, &tres_list, &qos_list);
+	ck_assert_ptr_ne(ef, NULL);
+	loaded = slurmdb_export_get_jobs(ef, &job_cond);
+	ck_assert_ptr_ne(loaded, NULL);
+	ck_assert_int_eq(list_count(loaded), 2);
+
+	/* only step 0 of job 1003 is shown */
+	job = list_find_first(loaded, _find_job, &(uint32_t){1003});
+	ck_assert_ptr_ne(job, NULL);
+	ck_assert_int_eq(job->show_full, 0);
+	ck_assert_int_eq(list_count(job->steps), 1);
+	step = list_peek(job->steps);
+	ck_assert_int_eq(step->step_id.step_id, 0);
+	ck_assert_ptr_eq(job->first_step_ptr, step);
+
+	/* all of job 1007 is shown */
+	job = list_find_first(loaded, _find_job, &(uint32_t){1007});
+	ck_assert_ptr_ne(job, NULL);
+	ck_assert_int_eq(job->show_full, 1);
+	ck_assert_int_eq(list_count(job->steps), 3);
+
+	FREE_NULL_LIST(job_cond.step_list);
+	FREE_NULL_LIST(loaded);
+	FREE_NULL_LIST(tres_list);
+	FREE_NULL_LIST(qos_list);
+	slurmdb_export_close(ef);
+	unlink(file);
+}
+END_TEST
+
+START_TEST(test_corrupted)
+{
+	List jobs = _create_jobs(), tres_list, qos_list;
+	struct stat stat_buf;
+
+	_export(jobs);
+	FREE_NULL_LIST(jobs);
+
+	/* the index is at the end of the file */
+	ck_assert_int_eq(stat(file, &stat_buf), 0);
+	ck_assert_int_eq(truncate(file, stat_buf.st_size - 1), 0);
+	ck_assert_ptr_eq(slurmdb_export_open(file, &tres_list, &qos_list),
+			 NULL);
+	ck_assert_ptr_eq(tres_list, NULL);
+	ck_assert_ptr_eq(qos_list, NULL);
+
+	ck_assert_ptr_eq(slurmdb_export_open("/nonexistent", &tres_list,
+					     &qos_list), NULL);
+	unlink(file);
+}
+END_TEST
+
+Suite *suite_slurmdb_export(void)
+{
+	Suite *s = suite_create("slurmdb_export");
+	TCase *tc_core = tcase_create("slurmdb_export");
+
+	tcase_add_test(tc_core, test_round_trip);
+	tcase_add_test(tc_core, test_job_cond);
+	tcase_add_test(tc_core, test_step_list);
+	tcase_add_test(tc_core, test_corrupted);
+
+	suite_add_tcase(s, tc_core);
+	return s;
+}
+
+int main(void)
+{
+	int number_failed;
+	SRunner *sr = srunner_create(suite_slurmdb_export());
+
+	srunner_run_all(sr, CK_ENV);
+	number_failed = srunner_ntests_failed(sr);
+	srunner_free(sr);
+
+	return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}